@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "histogram.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Log2 of the number of sub-buckets in a bucket.
+ */
+#define SUB_BUCKET_BITS 8
+
+/**
+ * @brief Number of sub-buckets in the first bucket.
+ */
+#define SUB_BUCKET_COUNT (1ULL << SUB_BUCKET_BITS)
+
+/**
+ * @brief Number of sub-buckets in every other bucket.
+ */
+#define SUB_BUCKET_HALF_COUNT (SUB_BUCKET_COUNT >> 1)
+
+/**
+ * @brief Number of buckets that are needed to cover all 64-bit values, not counting the first one.
+ */
+#define NUM_BUCKETS (64 - SUB_BUCKET_BITS)
+
+/**
+ * @brief Total number of counters in a histogram.
+ */
+#define NUM_COUNTERS (SUB_BUCKET_COUNT + NUM_BUCKETS * SUB_BUCKET_HALF_COUNT)
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Returns the position of the most significant bit that is set in a non-zero value.
+ */
+static unsigned msb(uint64_t value)
+{
+    assert(value != 0);
+#ifdef _WIN32
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return ((unsigned)index);
+#else
+    return (63 - (unsigned)__builtin_clzll(value));
+#endif
+}
+
+/**
+ * @brief Returns the index of the counter that records a value.
+ */
+static size_t index_of(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT)
+        return ((size_t)value);
+
+    // Drop enough low-order bits to bring the value into the upper half of a sub-bucket range.
+    const unsigned shift = msb(value) - SUB_BUCKET_BITS + 1;
+    const uint64_t sub_bucket = value >> shift;
+
+    return ((size_t)(SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF_COUNT + (sub_bucket - SUB_BUCKET_HALF_COUNT)));
+}
+
+/**
+ * @brief Returns the highest value that is recorded by a counter.
+ */
+static uint64_t highest_equivalent_of(size_t index)
+{
+    if (index < SUB_BUCKET_COUNT)
+        return ((uint64_t)index);
+
+    const size_t offset = index - SUB_BUCKET_COUNT;
+    const unsigned shift = (unsigned)(offset / SUB_BUCKET_HALF_COUNT) + 1;
+    const uint64_t sub_bucket = (offset % SUB_BUCKET_HALF_COUNT) + SUB_BUCKET_HALF_COUNT;
+
+    return (((sub_bucket + 1) << shift) - 1);
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Initializes a histogram.
+ */
+void histogram_init(struct histogram *h, const char *name)
+{
+    assert(h != NULL);
+
+    assert((h->counts = calloc(NUM_COUNTERS, sizeof(uint64_t))) != NULL);
+    h->name = name;
+    histogram_reset(h);
+}
+
+/**
+ * @brief Releases the resources of a histogram.
+ */
+void histogram_free(struct histogram *h)
+{
+    assert(h != NULL);
+
+    free(h->counts);
+    h->counts = NULL;
+}
+
+/**
+ * @brief Drops all samples of a histogram.
+ */
+void histogram_reset(struct histogram *h)
+{
+    assert(h != NULL);
+    assert(h->counts != NULL);
+
+    memset(h->counts, 0, NUM_COUNTERS * sizeof(uint64_t));
+    h->total = 0;
+    h->sum = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+}
+
+/**
+ * @brief Records a sample in a histogram.
+ */
+void histogram_record(struct histogram *h, uint64_t value)
+{
+    h->counts[index_of(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+/**
+ * @brief Returns the value at a given percentile of a histogram.
+ */
+uint64_t histogram_percentile(const struct histogram *h, double percentile)
+{
+    assert(h != NULL);
+    assert(percentile >= 0.0 && percentile <= 100.0);
+
+    if (h->total == 0)
+        return (0);
+
+    // Rank of the target sample, counting from one.
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)h->total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_COUNTERS; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            const uint64_t value = highest_equivalent_of(i);
+            return (value < h->max ? value : h->max);
+        }
+    }
+
+    return (h->max);
+}
+
+/**
+ * @brief Reports a histogram as a single line of JSON.
+ */
+void histogram_report(const struct histogram *h, FILE *fp)
+{
+    assert(h != NULL);
+    assert(fp != NULL);
+
+    fprintf(fp,
+            "{\"benchmark\": \"%s\", \"unit\": \"ns\", \"count\": %" PRIu64 ", \"min\": %" PRIu64
+            ", \"mean\": %" PRIu64 ", \"p50\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"p99.9\": %" PRIu64
+            ", \"max\": %" PRIu64 "}\n",
+            h->name, h->total, (h->total > 0) ? h->min : 0, (h->total > 0) ? h->sum / h->total : 0,
+            histogram_percentile(h, 50.0), histogram_percentile(h, 99.0), histogram_percentile(h, 99.9), h->max);
+    fflush(fp);
+}
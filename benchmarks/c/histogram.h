@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Latency histogram.
+ *
+ * Values are stored in log-linear buckets in the style of HdrHistogram: values below 256 are recorded exactly and
+ * larger values are recorded with a relative error of at most 1/128, regardless of their magnitude.
+ */
+struct histogram
+{
+    const char *name; /** Name of the benchmark. */
+    uint64_t *counts; /** Bucket counters.       */
+    uint64_t total;   /** Number of samples.     */
+    uint64_t sum;     /** Sum of all samples.    */
+    uint64_t min;     /** Smallest sample.       */
+    uint64_t max;     /** Largest sample.        */
+};
+
+/**
+ * @brief Initializes a histogram.
+ *
+ * @param h    Target histogram.
+ * @param name Name of the benchmark that is reported with the histogram.
+ */
+extern void histogram_init(struct histogram *h, const char *name);
+
+/**
+ * @brief Releases the resources of a histogram.
+ *
+ * @param h Target histogram.
+ */
+extern void histogram_free(struct histogram *h);
+
+/**
+ * @brief Drops all samples of a histogram.
+ *
+ * @param h Target histogram.
+ */
+extern void histogram_reset(struct histogram *h);
+
+/**
+ * @brief Records a sample in a histogram.
+ *
+ * @param h     Target histogram.
+ * @param value Sample to record.
+ */
+extern void histogram_record(struct histogram *h, uint64_t value);
+
+/**
+ * @brief Returns the value at a given percentile of a histogram.
+ *
+ * @param h          Target histogram.
+ * @param percentile Target percentile, between 0 and 100.
+ *
+ * @return The highest value that is equivalent to the sample at the given percentile.
+ */
+extern uint64_t histogram_percentile(const struct histogram *h, double percentile);
+
+/**
+ * @brief Reports a histogram as a single line of JSON.
+ *
+ * @param h  Target histogram.
+ * @param fp Target output stream.
+ */
+extern void histogram_report(const struct histogram *h, FILE *fp);
+
+#endif /* !HISTOGRAM_H_ */
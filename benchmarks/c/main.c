@@ -7,6 +7,8 @@
  * Imports                                                                                                            *
  *====================================================================================================================*/
 
+#include "histogram.h"
+#include "pingpong.h"
 #include "stopwatch.h"
 #include <assert.h>
 #include <demi/libos.h>
@@ -18,6 +20,153 @@
 #include <string.h>
 #include <time.h>
 
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef _WIN32
+#include <WS2tcpip.h>
+#endif
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Data size.
+ */
+#define DATA_SIZE 64
+
+/**
+ * @brief Number of iterations of each microbenchmark.
+ */
+#define MICROBENCH_ITERATIONS 100000
+
+/**
+ * @brief Number of operations that are in flight in the demi_wait_next_n() microbenchmark.
+ */
+#define BATCH_SIZE 16
+
+/**
+ * @brief Default number of round trips of the UDP ping-pong benchmark. Matches examples/c/udp-ping-pong.c.
+ */
+#define UDP_MAX_ITERATIONS 1000000
+
+/**
+ * @brief Default number of round trips of the TCP ping-pong benchmark. Matches examples/c/tcp-ping-pong.c.
+ */
+#define TCP_MAX_MSGS 1024
+
+/*====================================================================================================================*
+ * System Calls in demi/sga.h                                                                                         *
+ *====================================================================================================================*/
+
+/**
+ * @brief Microbenchmark for demi_sgaalloc() and demi_sgafree().
+ */
+static void microbench_sgaalloc_sgafree(const unsigned NUM_ITERS, const size_t size)
+{
+    struct histogram alloc = {0};
+    struct histogram release = {0};
+
+    assert(NUM_ITERS > 0);
+
+    histogram_init(&alloc, "demi_sgaalloc");
+    histogram_init(&release, "demi_sgafree");
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_sgarray_t sga = {0};
+
+        stopwatch_reset(&alloc);
+        stopwatch_start();
+        sga = demi_sgaalloc(size);
+        stopwatch_stop();
+        assert(sga.sga_segs != 0);
+
+        stopwatch_reset(&release);
+        stopwatch_start();
+        assert(demi_sgafree(&sga) == 0);
+        stopwatch_stop();
+    }
+
+    histogram_report(&alloc, stdout);
+    histogram_report(&release, stdout);
+
+    // Release resources.
+    histogram_free(&alloc);
+    histogram_free(&release);
+}
+
+/*====================================================================================================================*
+ * System Calls in demi/libos.h                                                                                       *
+ *====================================================================================================================*/
+
+/**
+ * @brief Microbenchmark for demi_push(), demi_pop() and demi_wait().
+ *
+ * Datagrams are sent to the socket itself, so that each pop has data to complete with. The network stack of catnip
+ * and catpowder does not loop datagrams back to the host, so there the pops would never complete.
+ */
+static void microbench_push_pop_wait(const unsigned NUM_ITERS, int sockqd, const struct sockaddr_in *self)
+{
+    struct histogram push = {0};
+    struct histogram wait_push = {0};
+    struct histogram pop = {0};
+    struct histogram wait_pop = {0};
+
+    assert(NUM_ITERS > 0);
+
+    histogram_init(&push, "demi_push");
+    histogram_init(&wait_push, "demi_wait.push");
+    histogram_init(&pop, "demi_pop");
+    histogram_init(&wait_pop, "demi_wait.pop");
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_qtoken_t qt = -1;
+        demi_qresult_t qr = {0};
+        demi_sgarray_t sga = demi_sgaalloc(DATA_SIZE);
+        assert(sga.sga_segs != 0);
+
+        stopwatch_reset(&push);
+        stopwatch_start();
+        assert(demi_pushto(&qt, sockqd, &sga, (const struct sockaddr *)self, sizeof(struct sockaddr_in)) == 0);
+        stopwatch_stop();
+
+        stopwatch_reset(&wait_push);
+        stopwatch_start();
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        stopwatch_stop();
+        assert(qr.qr_opcode == DEMI_OPC_PUSH);
+        assert(demi_sgafree(&sga) == 0);
+
+        stopwatch_reset(&pop);
+        stopwatch_start();
+        assert(demi_pop(&qt, sockqd) == 0);
+        stopwatch_stop();
+
+        stopwatch_reset(&wait_pop);
+        stopwatch_start();
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        stopwatch_stop();
+        assert(qr.qr_opcode == DEMI_OPC_POP);
+        assert(demi_sgafree(&qr.qr_value.sga) == 0);
+    }
+
+    histogram_report(&push, stdout);
+    histogram_report(&wait_push, stdout);
+    histogram_report(&pop, stdout);
+    histogram_report(&wait_pop, stdout);
+
+    // Release resources.
+    histogram_free(&push);
+    histogram_free(&wait_push);
+    histogram_free(&pop);
+    histogram_free(&wait_pop);
+}
+
 /*====================================================================================================================*
  * System Calls in demi/wait.h                                                                                        *
  *====================================================================================================================*/
@@ -28,6 +177,7 @@
 static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS)
 {
     demi_qtoken_t *qts = NULL;
+    struct histogram hist = {0};
 
     assert(NUM_ITERS > 0);
     assert(NUM_QTS > 0);
@@ -35,7 +185,8 @@ static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS
     // Allocate an array of queue tokens.
     assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_QTS)) != NULL);
 
-    stopwatch_reset();
+    histogram_init(&hist, "demi_wait_any");
+    stopwatch_reset(&hist);
 
     memset(qts, 1, sizeof(demi_qtoken_t) * NUM_QTS);
 
@@ -50,12 +201,120 @@ static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS
         stopwatch_stop();
     }
 
-    printf("demi_wait_any() takes about %lld nanoseconds.\n", stopwatch_read());
+    histogram_report(&hist, stdout);
 
     // Release resources.
+    histogram_free(&hist);
     free(qts);
 }
 
+/**
+ * @brief Microbenchmark for demi_wait_next_n().
+ *
+ * Each round keeps BATCH_SIZE pushes and BATCH_SIZE pops in flight and harvests all of them. Every call to
+ * demi_wait_next_n() is measured on its own.
+ */
+static void microbench_wait_next_n(const unsigned NUM_ROUNDS, int sockqd, const struct sockaddr_in *self)
+{
+    struct histogram hist = {0};
+    demi_sgarray_t sgas[BATCH_SIZE];
+    demi_qresult_t qrs[2 * BATCH_SIZE];
+
+    assert(NUM_ROUNDS > 0);
+
+    histogram_init(&hist, "demi_wait_next_n");
+    stopwatch_reset(&hist);
+
+    for (unsigned i = 0; i < NUM_ROUNDS; i++)
+    {
+        int completed = 0;
+
+        for (int j = 0; j < BATCH_SIZE; j++)
+        {
+            demi_qtoken_t qt = -1;
+
+            sgas[j] = demi_sgaalloc(DATA_SIZE);
+            assert(sgas[j].sga_segs != 0);
+            assert(demi_pushto(&qt, sockqd, &sgas[j], (const struct sockaddr *)self, sizeof(struct sockaddr_in)) ==
+                   0);
+            assert(demi_pop(&qt, sockqd) == 0);
+        }
+
+        while (completed < 2 * BATCH_SIZE)
+        {
+            int nqrs = 0;
+
+            stopwatch_start();
+            assert(demi_wait_next_n(qrs, 2 * BATCH_SIZE - completed, &nqrs, NULL) == 0);
+            stopwatch_stop();
+
+            for (int j = 0; j < nqrs; j++)
+            {
+                if (qrs[j].qr_opcode == DEMI_OPC_POP)
+                    assert(demi_sgafree(&qrs[j].qr_value.sga) == 0);
+                else
+                    assert(qrs[j].qr_opcode == DEMI_OPC_PUSH);
+            }
+            completed += nqrs;
+        }
+
+        for (int j = 0; j < BATCH_SIZE; j++)
+            assert(demi_sgafree(&sgas[j]) == 0);
+    }
+
+    histogram_report(&hist, stdout);
+
+    // Release resources.
+    histogram_free(&hist);
+}
+
+/*====================================================================================================================*
+ * build_sockaddr()                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Builds a socket address.
+ *
+ * @param ip_str    String representation of an IP address.
+ * @param port_str  String representation of a port number.
+ * @param addr      Storage location for socket address.
+ */
+static void build_sockaddr(const char *const ip_str, const char *const port_str, struct sockaddr_in *const addr)
+{
+    int port = -1;
+
+    sscanf(port_str, "%d", &port);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    assert(inet_pton(AF_INET, ip_str, &addr->sin_addr) == 1);
+}
+
+/*====================================================================================================================*
+ * usage()                                                                                                            *
+ *====================================================================================================================*/
+
+/**
+ * @brief Prints program usage and exits.
+ *
+ * @param progname Program name.
+ */
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [--micro local-ipv4 local-port]\n", progname);
+    fprintf(stderr, "       %s --udp-ping-pong local-ipv4 local-port remote-ipv4 remote-port [size] [iterations]\n",
+            progname);
+    fprintf(stderr, "       %s --tcp-ping-pong remote-ipv4 remote-port [size] [iterations]\n", progname);
+    fprintf(stderr, "Modes:\n");
+    fprintf(stderr, "  --micro            Run microbenchmarks (default, on 127.0.0.1:12345).\n");
+    fprintf(stderr, "                     These send datagrams to themselves, so they need a LibOS that loops them\n");
+    fprintf(stderr, "                     back, such as catnap. Catnip and catpowder do not.\n");
+    fprintf(stderr, "  --udp-ping-pong    Run against the server of examples/c/udp-ping-pong.\n");
+    fprintf(stderr, "  --tcp-ping-pong    Run against the server of examples/c/tcp-ping-pong.\n");
+    fprintf(stderr, "Each benchmark reports its latency distribution as one line of JSON on stdout.\n");
+
+    exit(EXIT_FAILURE);
+}
+
 /*===================================================================================================================*
  * main()                                                                                                            *
  *===================================================================================================================*/
@@ -63,15 +322,15 @@ static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS
 /**
  * @brief Drives the application.
  *
- * @param argc Argument count (unused).
- * @param argv Argument vector (unused).
+ * @param argc Argument count.
+ * @param argv Argument vector.
  *
  * @return On successful completion EXIT_SUCCESS is returned.
  */
 int main(int argc, char *const argv[])
 {
-    ((void)argc);
-    ((void)argv);
+    const char *mode = (argc >= 2) ? argv[1] : "--micro";
+    size_t data_size = DATA_SIZE;
 
     // This shall never fail.
     const struct demi_args args = {
@@ -79,9 +338,62 @@ int main(int argc, char *const argv[])
         .argv = argv,
         .callback = NULL,
     };
-    assert(demi_init(&args) == 0);
 
-    microbench_wait_any(100000, 1048576);
+    if (!strcmp(mode, "--micro") && (argc == 1 || argc >= 4))
+    {
+        int sockqd = -1;
+        struct sockaddr_in self = {0};
+
+        build_sockaddr((argc >= 4) ? argv[2] : "127.0.0.1", (argc >= 4) ? argv[3] : "12345", &self);
+        assert(demi_init(&args) == 0);
+
+        assert(demi_socket(&sockqd, AF_INET, SOCK_DGRAM, 0) == 0);
+        assert(demi_bind(sockqd, (const struct sockaddr *)&self, sizeof(struct sockaddr_in)) == 0);
+
+        microbench_sgaalloc_sgafree(MICROBENCH_ITERATIONS, DATA_SIZE);
+        microbench_push_pop_wait(MICROBENCH_ITERATIONS, sockqd, &self);
+        microbench_wait_next_n(MICROBENCH_ITERATIONS / BATCH_SIZE, sockqd, &self);
+        microbench_wait_any(MICROBENCH_ITERATIONS, 1048576);
+
+        assert(demi_close(sockqd) == 0);
+        return (EXIT_SUCCESS);
+    }
+    else if (!strcmp(mode, "--udp-ping-pong") && argc >= 6)
+    {
+        struct sockaddr_in local = {0};
+        struct sockaddr_in remote = {0};
+        unsigned max_iterations = UDP_MAX_ITERATIONS;
+
+        build_sockaddr(argv[2], argv[3], &local);
+        build_sockaddr(argv[4], argv[5], &remote);
+        if (argc >= 7)
+            sscanf(argv[6], "%zu", &data_size);
+        if (argc >= 8)
+            sscanf(argv[7], "%u", &max_iterations);
+
+        assert(demi_init(&args) == 0);
+        bench_udp_ping_pong(&local, &remote, data_size, max_iterations);
+        return (EXIT_SUCCESS);
+    }
+    else if (!strcmp(mode, "--tcp-ping-pong") && argc >= 4)
+    {
+        struct sockaddr_in remote = {0};
+        unsigned max_msgs = TCP_MAX_MSGS;
+
+        build_sockaddr(argv[2], argv[3], &remote);
+        if (argc >= 5)
+            sscanf(argv[4], "%zu", &data_size);
+        if (argc >= 6)
+            sscanf(argv[5], "%u", &max_msgs);
+
+        assert(demi_init(&args) == 0);
+        bench_tcp_ping_pong(&remote, data_size, max_msgs);
+        return (EXIT_SUCCESS);
+    }
+
+    usage(argv[0]);
+
+    /* Never gets here. */
 
     return (EXIT_SUCCESS);
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "pingpong.h"
+#include "histogram.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <demi/libos.h>
+#include <demi/sga.h>
+#include <demi/wait.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Fraction of the round trips that warm up the stack and are left out of the histogram.
+ */
+#define WARMUP_DIVISOR 10
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Waits for an operation to complete and checks its opcode.
+ */
+static void wait_opcode(demi_qresult_t *qr, demi_qtoken_t qt, demi_opcode_t opcode)
+{
+    assert(demi_wait(qr, qt, NULL) == 0);
+    assert(qr->qr_opcode == opcode);
+}
+
+/**
+ * @brief Allocates a scatter-gather array that is filled with a byte pattern.
+ */
+static demi_sgarray_t alloc_message(size_t data_size, unsigned it)
+{
+    demi_sgarray_t sga = demi_sgaalloc(data_size);
+    assert(sga.sga_segs != 0);
+
+    for (uint32_t i = 0; i < sga.sga_numsegs; i++)
+        memset(sga.sga_segs[i].sgaseg_buf, it % 256, sga.sga_segs[i].sgaseg_len);
+
+    return (sga);
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures the round-trip time of UDP messages.
+ */
+void bench_udp_ping_pong(const struct sockaddr_in *local, const struct sockaddr_in *remote, size_t data_size,
+                         unsigned max_iterations)
+{
+    int sockqd = -1;
+    struct histogram rtt = {0};
+    const unsigned warmup = max_iterations / WARMUP_DIVISOR;
+
+    histogram_init(&rtt, "udp_ping_pong");
+    stopwatch_reset(&rtt);
+
+    /* Setup socket. */
+    assert(demi_socket(&sockqd, AF_INET, SOCK_DGRAM, 0) == 0);
+    assert(demi_bind(sockqd, (const struct sockaddr *)local, sizeof(struct sockaddr_in)) == 0);
+
+    for (unsigned it = 0; it < max_iterations; it++)
+    {
+        demi_qtoken_t qt = -1;
+        demi_qresult_t qr = {0};
+        demi_sgarray_t sga = alloc_message(data_size, it);
+
+        /* Measure from the push to the arrival of the echo. */
+        stopwatch_start();
+        assert(demi_pushto(&qt, sockqd, &sga, (const struct sockaddr *)remote, sizeof(struct sockaddr_in)) == 0);
+        wait_opcode(&qr, qt, DEMI_OPC_PUSH);
+        assert(demi_pop(&qt, sockqd) == 0);
+        wait_opcode(&qr, qt, DEMI_OPC_POP);
+        if (it >= warmup)
+            stopwatch_stop();
+
+        assert(demi_sgafree(&sga) == 0);
+        assert(demi_sgafree(&qr.qr_value.sga) == 0);
+    }
+
+    histogram_report(&rtt, stdout);
+    histogram_free(&rtt);
+    assert(demi_close(sockqd) == 0);
+}
+
+/**
+ * @brief Measures the round-trip time of TCP messages.
+ */
+void bench_tcp_ping_pong(const struct sockaddr_in *remote, size_t data_size, unsigned max_msgs)
+{
+    int sockqd = -1;
+    demi_qtoken_t qt = -1;
+    demi_qresult_t qr = {0};
+    struct histogram rtt = {0};
+    const unsigned warmup = max_msgs / WARMUP_DIVISOR;
+
+    histogram_init(&rtt, "tcp_ping_pong");
+    stopwatch_reset(&rtt);
+
+    /* Setup socket and connect to server. */
+    assert(demi_socket(&sockqd, AF_INET, SOCK_STREAM, 0) == 0);
+    assert(demi_connect(&qt, sockqd, (const struct sockaddr *)remote, sizeof(struct sockaddr_in)) == 0);
+    wait_opcode(&qr, qt, DEMI_OPC_CONNECT);
+
+    for (unsigned it = 0; it < max_msgs; it++)
+    {
+        size_t nbytes = 0;
+        demi_sgarray_t sga = alloc_message(data_size, it);
+
+        /* Measure from the push to the arrival of the full echo, which may come back in several segments. */
+        stopwatch_start();
+        assert(demi_push(&qt, sockqd, &sga) == 0);
+        wait_opcode(&qr, qt, DEMI_OPC_PUSH);
+        while (nbytes < data_size)
+        {
+            assert(demi_pop(&qt, sockqd) == 0);
+            wait_opcode(&qr, qt, DEMI_OPC_POP);
+
+            for (uint32_t i = 0; i < qr.qr_value.sga.sga_numsegs; i++)
+                nbytes += qr.qr_value.sga.sga_segs[i].sgaseg_len;
+            assert(demi_sgafree(&qr.qr_value.sga) == 0);
+        }
+        if (it >= warmup)
+            stopwatch_stop();
+
+        assert(demi_sgafree(&sga) == 0);
+    }
+
+    histogram_report(&rtt, stdout);
+    histogram_free(&rtt);
+    assert(demi_close(sockqd) == 0);
+}
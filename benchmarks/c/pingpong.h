@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef PINGPONG_H_
+#define PINGPONG_H_
+
+#include <stddef.h>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#endif
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#endif
+
+/**
+ * @brief Measures the round-trip time of UDP messages against the server of examples/c/udp-ping-pong.c.
+ *
+ * @param local          Local socket address.
+ * @param remote         Address of the echo server.
+ * @param data_size      Number of bytes in each message.
+ * @param max_iterations Number of round trips, which must match the iterations of the server.
+ */
+extern void bench_udp_ping_pong(const struct sockaddr_in *local, const struct sockaddr_in *remote, size_t data_size,
+                                unsigned max_iterations);
+
+/**
+ * @brief Measures the round-trip time of TCP messages against the server of examples/c/tcp-ping-pong.c.
+ *
+ * @param remote    Address of the echo server.
+ * @param data_size Number of bytes in each message.
+ * @param max_msgs  Number of round trips, which must match the messages expected by the server.
+ */
+extern void bench_tcp_ping_pong(const struct sockaddr_in *remote, size_t data_size, unsigned max_msgs);
+
+#endif /* !PINGPONG_H_ */
@@ -7,12 +7,20 @@
  * Imports                                                                                                            *
  *====================================================================================================================*/
 
-// This must come first.
-#define _POSIX_C_SOURCE 199309L
-
+#include "stopwatch.h"
 #include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAVE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
 /*====================================================================================================================*
  * Constants                                                                                                          *
  *====================================================================================================================*/
@@ -23,10 +31,15 @@
 #define GIGA 1000000000
 
 /**
- * @brief Number of iterations used to compute the average overhead of the stopwatch.
+ * @brief Number of iterations used to compute the overhead of the stopwatch.
  */
 #define NUM_ITER 100000
 
+/**
+ * @brief Duration of the time stamp counter calibration in nanoseconds.
+ */
+#define CALIBRATION_NS 50000000
+
 /*====================================================================================================================*
  * Private Variables                                                                                                  *
  *====================================================================================================================*/
@@ -36,66 +49,116 @@
  */
 static struct
 {
-    struct timespec start;    /** Start time.      */
-    struct timespec end;      /** End time.        */
-    long nstops;              /** Number of stops. */
-    long long total_time;     /** Total time.      */
-    long long total_overhead; /** Total overhead.  */
-} stopwatch = {.nstops = 0, .total_time = 0, .total_overhead = 0};
+    bool calibrated;        /** Has the stopwatch been calibrated? */
+    double ns_per_tick;     /** Length of a tick in nanoseconds.   */
+    uint64_t overhead;      /** Overhead of a start/stop in ticks. */
+    uint64_t start;         /** Start time in ticks.               */
+    struct histogram *hist; /** Where measurements are recorded.   */
+} stopwatch = {.calibrated = false, .ns_per_tick = 1.0, .overhead = 0, .start = 0, .hist = NULL};
 
 /*====================================================================================================================*
- * Public Functions                                                                                                   *
+ * Private Functions                                                                                                  *
  *====================================================================================================================*/
 
 /**
- * @brief Resets the stopwatch.
+ * @brief Reads the monotonic clock in nanoseconds.
+ */
+static uint64_t clock_read(void)
+{
+    struct timespec ts = {0};
+
+#ifdef _WIN32
+    assert(timespec_get(&ts, TIME_UTC) == TIME_UTC);
+#else
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+#endif
+
+    return ((uint64_t)ts.tv_sec * GIGA + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief Reads the time stamp counter, falling back to the monotonic clock where there is none.
+ *
+ * The fences keep the processor from moving the read across the code that is being measured.
  */
-void stopwatch_reset(void)
+static inline uint64_t ticks_read(void)
 {
-    stopwatch.nstops = 0;
-    stopwatch.total_time = 0;
-    stopwatch.total_overhead = 0;
+#ifdef HAVE_TSC
+    _mm_lfence();
+    const uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return (ticks);
+#else
+    return (clock_read());
+#endif
+}
 
-    // Compute average overhead.
+/**
+ * @brief Calibrates the time stamp counter and measures the overhead of the stopwatch.
+ */
+static void stopwatch_calibrate(void)
+{
+#ifdef HAVE_TSC
+    const uint64_t ns0 = clock_read();
+    const uint64_t ticks0 = ticks_read();
+    uint64_t ns1 = ns0;
+    while ((ns1 = clock_read()) - ns0 < CALIBRATION_NS)
+        ;
+    const uint64_t ticks1 = ticks_read();
+
+    assert(ticks1 > ticks0);
+    stopwatch.ns_per_tick = (double)(ns1 - ns0) / (double)(ticks1 - ticks0);
+#endif
+
+    // Use the smallest observed overhead, so that it is never subtracted from a measurement twice.
+    stopwatch.overhead = UINT64_MAX;
     for (int i = 0; i < NUM_ITER; i++)
     {
-        assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.start) == 0);
-        assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.end) == 0);
+        const uint64_t start = ticks_read();
+        const uint64_t end = ticks_read();
 
-        stopwatch.total_overhead +=
-            (stopwatch.end.tv_sec - stopwatch.start.tv_sec) * GIGA + (stopwatch.end.tv_nsec - stopwatch.start.tv_nsec);
+        if (end - start < stopwatch.overhead)
+            stopwatch.overhead = end - start;
     }
 
-    stopwatch.total_overhead /= NUM_ITER;
+    stopwatch.calibrated = true;
 }
 
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
 /**
- * @brief Starts the stopwatch.
+ * @brief Resets the stopwatch.
  */
-void stopwatch_start(void)
+void stopwatch_reset(struct histogram *h)
 {
-    assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.start) == 0);
+    assert(h != NULL);
+
+    if (!stopwatch.calibrated)
+        stopwatch_calibrate();
+
+    stopwatch.hist = h;
 }
 
 /**
- * @brief Stops the stopwatch.
+ * @brief Starts the stopwatch.
  */
-void stopwatch_stop(void)
+void stopwatch_start(void)
 {
-    assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.end) == 0);
-
-    stopwatch.nstops++;
-    stopwatch.total_time += (stopwatch.end.tv_sec - stopwatch.start.tv_sec) * GIGA +
-                            (stopwatch.end.tv_nsec - stopwatch.start.tv_nsec) - stopwatch.total_overhead;
+    stopwatch.start = ticks_read();
 }
 
 /**
- * @brief Returns the elapsed times in nanoseconds.
- *
- * @return The elapsed times in nanoseconds.
+ * @brief Stops the stopwatch and records the elapsed time in nanoseconds.
  */
-long long stopwatch_read(void)
+void stopwatch_stop(void)
 {
-    assert(stopwatch.nstops > 0);
-    return (stopwatch.total_time / stopwatch.nstops);
+    const uint64_t end = ticks_read();
+    assert(stopwatch.hist != NULL);
+
+    uint64_t ticks = end - stopwatch.start;
+    ticks = (ticks > stopwatch.overhead) ? ticks - stopwatch.overhead : 0;
+
+    histogram_record(stopwatch.hist, (uint64_t)((double)ticks * stopwatch.ns_per_tick));
 }
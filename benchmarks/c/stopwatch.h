@@ -6,10 +6,17 @@
 #ifndef STOPWATCH_H_
 #define STOPWATCH_H_
 
+#include "histogram.h"
+
 /**
  * @brief Resets the stopwatch.
+ *
+ * The first reset calibrates the time stamp counter against the monotonic clock and measures the overhead of a
+ * start/stop pair. Every reset then binds the stopwatch to a histogram where subsequent measurements are recorded.
+ *
+ * @param h Histogram where measurements are recorded.
  */
-extern void stopwatch_reset(void);
+extern void stopwatch_reset(struct histogram *h);
 
 /**
  * @brief Starts the stopwatch.
@@ -17,15 +24,8 @@ extern void stopwatch_reset(void);
 extern void stopwatch_start(void);
 
 /**
- * @brief Stops the stopwatch.
+ * @brief Stops the stopwatch and records the elapsed time in nanoseconds.
  */
 extern void stopwatch_stop(void);
 
-/**
- * @brief Returns the elapsed times in nanoseconds.
- *
- * @return The elapsed times in nanoseconds.
- */
-extern long long stopwatch_read(void);
-
 #endif /* !STOPWATCH_H_ */
@@ -3,17 +3,19 @@
 
 CC = cl
 
+OBJ = main.obj histogram.obj pingpong.obj stopwatch.obj
+
 all: benchmarks
 
-benchmarks: make-dirs benchmarks.obj
-	$(CC) benchmarks.obj $(LIBS) /Fe: $(BINDIR)\benchmarks.exe
+benchmarks: make-dirs $(OBJ)
+	$(CC) $(OBJ) $(LIBS) "WS2_32.lib" /Fe: $(BINDIR)\benchmarks.exe
 
 clean:
-	IF EXIST benchmarks.obj del /Q benchmarks.obj
+	IF EXIST main.obj del /Q $(OBJ)
 	IF EXIST $(BINDIR)\benchmarks.exe del /S /Q $(BINDIR)\benchmarks.exe
 
-benchmarks.obj:
-	$(CC) /I $(INCDIR) benchmarks\c\main.c /c
+$(OBJ):
+	$(CC) /I $(INCDIR) /std:c11 benchmarks\c\main.c benchmarks\c\histogram.c benchmarks\c\pingpong.c benchmarks\c\stopwatch.c /c
 
 make-dirs:
 	IF NOT EXIST $(BINDIR) mkdir $(BINDIR)
@@ -95,6 +95,8 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_dev_is_valid_port")
+        .allowlist_function("rte_eth_dev_rx_intr_disable")
+        .allowlist_function("rte_eth_dev_rx_intr_enable")
         .allowlist_function("rte_eth_dev_set_mtu")
         .allowlist_function("rte_eth_dev_socket_id")
         .allowlist_function("rte_eth_dev_start")
@@ -110,6 +112,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_mempool_create_empty")
         .allowlist_function("rte_mempool_free")
         .allowlist_function("rte_mempool_in_use_count")
+        .allowlist_function("rte_mempool_lookup")
         .allowlist_function("rte_mempool_mem_iter")
         .allowlist_function("rte_mempool_obj_iter")
         .allowlist_function("rte_mempool_populate_default")
@@ -120,6 +123,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_pktmbuf_prepend")
         .allowlist_function("rte_socket_id")
         .allowlist_function("rte_strerror")
+        .allowlist_function("rte_thread_register")
         .allowlist_type("rte_eth_fc_conf")
         .allowlist_type("rte_eth_rxconf")
         .allowlist_type("rte_eth_txconf")
@@ -136,8 +140,12 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_UDP_CKSUM")
+        .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_LRO")
+        .allowlist_var("RTE_ETH_RX_OFFLOAD_SCATTER")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_MULTI_SEGS")
+        .allowlist_var("RTE_ETH_TX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_TCP_CKSUM")
+        .allowlist_var("RTE_ETH_TX_OFFLOAD_TCP_TSO")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_UDP_CKSUM")
         .allowlist_var("RTE_ETHER_MAX_JUMBO_FRAME_LEN")
         .allowlist_var("RTE_ETHER_MAX_JUMBO_FRAME")
@@ -247,6 +255,8 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_dev_is_valid_port")
+        .allowlist_function("rte_eth_dev_rx_intr_disable")
+        .allowlist_function("rte_eth_dev_rx_intr_enable")
         .allowlist_function("rte_eth_dev_set_mtu")
         .allowlist_function("rte_eth_dev_socket_id")
         .allowlist_function("rte_eth_dev_start")
@@ -262,6 +272,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_mempool_create_empty")
         .allowlist_function("rte_mempool_free")
         .allowlist_function("rte_mempool_in_use_count")
+        .allowlist_function("rte_mempool_lookup")
         .allowlist_function("rte_mempool_mem_iter")
         .allowlist_function("rte_mempool_obj_iter")
         .allowlist_function("rte_mempool_populate_default")
@@ -272,6 +283,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_pktmbuf_prepend")
         .allowlist_function("rte_socket_id")
         .allowlist_function("rte_strerror")
+        .allowlist_function("rte_thread_register")
         .allowlist_type("rte_eth_fc_conf")
         .allowlist_type("rte_eth_rxconf")
         .allowlist_type("rte_eth_txconf")
@@ -288,8 +300,12 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_UDP_CKSUM")
+        .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_LRO")
+        .allowlist_var("RTE_ETH_RX_OFFLOAD_SCATTER")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_MULTI_SEGS")
+        .allowlist_var("RTE_ETH_TX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_TCP_CKSUM")
+        .allowlist_var("RTE_ETH_TX_OFFLOAD_TCP_TSO")
         .allowlist_var("RTE_ETH_TX_OFFLOAD_UDP_CKSUM")
         .allowlist_var("RTE_ETHER_MAX_JUMBO_FRAME_LEN")
         .allowlist_var("RTE_ETHER_MAX_JUMBO_FRAME")
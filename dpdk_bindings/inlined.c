@@ -6,7 +6,11 @@
 #include <rte_errno.h>
 #include <rte_ethdev.h>
 #include <rte_ether.h>
+#include <rte_flow.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_tcp.h>
 
 void rte_pktmbuf_free_(struct rte_mbuf *packet)
 {
@@ -93,12 +97,136 @@ int rte_eth_rx_offload_udp_cksum_()
     return RTE_ETH_RX_OFFLOAD_TCP_CKSUM;
 }
 
+int rte_eth_rx_offload_tcp_lro_()
+{
+    return RTE_ETH_RX_OFFLOAD_TCP_LRO;
+}
+
+int rte_eth_rx_offload_scatter_()
+{
+    return RTE_ETH_RX_OFFLOAD_SCATTER;
+}
+
 int rte_eth_tx_offload_multi_segs_()
 {
     return RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
 }
 
+int rte_eth_tx_offload_ipv4_cksum_()
+{
+    return RTE_ETH_TX_OFFLOAD_IPV4_CKSUM;
+}
+
+int rte_eth_tx_offload_tcp_tso_()
+{
+    return RTE_ETH_TX_OFFLOAD_TCP_TSO;
+}
+
+/*
+ * Asks the device to cut the IPv4/TCP packet in m into segments of m->tso_segsz bytes of payload. The device fills in
+ * the checksums of every segment, starting from the pseudo-header checksum that it expects in the TCP header.
+ */
+void rte_pktmbuf_set_tcp_tso_(struct rte_mbuf *m, uint16_t l2_len, uint16_t l3_len, uint16_t l4_len)
+{
+    struct rte_ipv4_hdr *ipv4_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, l2_len);
+    struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *, l2_len + l3_len);
+
+    m->l2_len = l2_len;
+    m->l3_len = l3_len;
+    m->l4_len = l4_len;
+    m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_TCP_SEG;
+    ipv4_hdr->hdr_checksum = 0;
+    tcp_hdr->cksum = rte_ipv4_phdr_cksum(ipv4_hdr, m->ol_flags);
+}
+
 char *rte_pktmbuf_prepend_(struct rte_mbuf *m, uint16_t len)
 {
     return rte_pktmbuf_prepend(m, len);
 }
+
+unsigned rte_lcore_id_()
+{
+    return rte_lcore_id();
+}
+
+int rte_eth_rx_queue_count_(uint16_t port_id, uint16_t queue_id)
+{
+    return rte_eth_rx_queue_count(port_id, queue_id);
+}
+
+/*
+ * Hooks the RX interrupt of a queue up to the epoll instance of the calling thread, which rte_epoll_wait_per_thread_()
+ * then waits on.
+ */
+int rte_eth_dev_rx_intr_ctl_q_per_thread_(uint16_t port_id, uint16_t queue_id)
+{
+    return rte_eth_dev_rx_intr_ctl_q(port_id, queue_id, RTE_EPOLL_PER_THREAD, RTE_INTR_EVENT_ADD, NULL);
+}
+
+/*
+ * Waits for up to timeout_ms milliseconds for an interrupt on the epoll instance of the calling thread.
+ */
+int rte_epoll_wait_per_thread_(int timeout_ms)
+{
+    struct rte_epoll_event event;
+    return rte_epoll_wait(RTE_EPOLL_PER_THREAD, &event, 1, timeout_ms);
+}
+
+/*
+ * Installs an ingress flow rule on port_id that steers ARP frames to queue_id. Returns 0 on success, or a negative
+ * error number.
+ */
+int rte_flow_steer_arp_(uint16_t port_id, uint16_t queue_id)
+{
+    struct rte_flow_attr attr = {.ingress = 1};
+    struct rte_flow_item_eth eth_spec = {.type = RTE_BE16(RTE_ETHER_TYPE_ARP)};
+    struct rte_flow_item_eth eth_mask = {.type = RTE_BE16(0xffff)};
+    struct rte_flow_item pattern[] = {
+        {.type = RTE_FLOW_ITEM_TYPE_ETH, .spec = &eth_spec, .mask = &eth_mask},
+        {.type = RTE_FLOW_ITEM_TYPE_END},
+    };
+    struct rte_flow_action_queue queue = {.index = queue_id};
+    struct rte_flow_action actions[] = {
+        {.type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue},
+        {.type = RTE_FLOW_ACTION_TYPE_END},
+    };
+    struct rte_flow_error error;
+
+    if (rte_flow_create(port_id, &attr, pattern, actions, &error) == NULL)
+        return -rte_errno;
+    return 0;
+}
+
+/*
+ * Installs an ingress flow rule on port_id that steers IPv4 TCP segments (or UDP datagrams, if udp is nonzero) whose
+ * destination port matches dst_port under dst_port_mask to queue_id. Returns 0 on success, or a negative error number.
+ */
+int rte_flow_steer_dst_port_(uint16_t port_id, int udp, uint16_t dst_port, uint16_t dst_port_mask, uint16_t queue_id)
+{
+    struct rte_flow_attr attr = {.ingress = 1};
+    struct rte_flow_item_tcp tcp_spec = {.hdr.dst_port = rte_cpu_to_be_16(dst_port)};
+    struct rte_flow_item_tcp tcp_mask = {.hdr.dst_port = rte_cpu_to_be_16(dst_port_mask)};
+    struct rte_flow_item_udp udp_spec = {.hdr.dst_port = rte_cpu_to_be_16(dst_port)};
+    struct rte_flow_item_udp udp_mask = {.hdr.dst_port = rte_cpu_to_be_16(dst_port_mask)};
+    struct rte_flow_item pattern[] = {
+        {.type = RTE_FLOW_ITEM_TYPE_ETH},
+        {.type = RTE_FLOW_ITEM_TYPE_IPV4},
+        {.type = RTE_FLOW_ITEM_TYPE_TCP, .spec = &tcp_spec, .mask = &tcp_mask},
+        {.type = RTE_FLOW_ITEM_TYPE_END},
+    };
+    struct rte_flow_action_queue queue = {.index = queue_id};
+    struct rte_flow_action actions[] = {
+        {.type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue},
+        {.type = RTE_FLOW_ACTION_TYPE_END},
+    };
+    struct rte_flow_error error;
+
+    if (udp) {
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+        pattern[2].spec = &udp_spec;
+        pattern[2].mask = &udp_mask;
+    }
+    if (rte_flow_create(port_id, &attr, pattern, actions, &error) == NULL)
+        return -rte_errno;
+    return 0;
+}
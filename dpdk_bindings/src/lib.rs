@@ -28,8 +28,19 @@ extern "C" {
     fn rte_eth_tx_offload_udp_cksum_() -> c_int;
     fn rte_eth_rx_offload_tcp_cksum_() -> c_int;
     fn rte_eth_rx_offload_udp_cksum_() -> c_int;
+    fn rte_eth_rx_offload_tcp_lro_() -> c_int;
+    fn rte_eth_rx_offload_scatter_() -> c_int;
     fn rte_eth_tx_offload_multi_segs_() -> c_int;
+    fn rte_eth_tx_offload_ipv4_cksum_() -> c_int;
+    fn rte_eth_tx_offload_tcp_tso_() -> c_int;
+    fn rte_pktmbuf_set_tcp_tso_(m: *mut rte_mbuf, l2_len: u16, l3_len: u16, l4_len: u16);
     fn rte_pktmbuf_prepend_(m: *mut rte_mbuf, len: u16) -> *mut c_char;
+    fn rte_lcore_id_() -> u32;
+    fn rte_eth_rx_queue_count_(port_id: u16, queue_id: u16) -> c_int;
+    fn rte_eth_dev_rx_intr_ctl_q_per_thread_(port_id: u16, queue_id: u16) -> c_int;
+    fn rte_epoll_wait_per_thread_(timeout_ms: c_int) -> c_int;
+    fn rte_flow_steer_arp_(port_id: u16, queue_id: u16) -> c_int;
+    fn rte_flow_steer_dst_port_(port_id: u16, udp: c_int, dst_port: u16, dst_port_mask: u16, queue_id: u16) -> c_int;
 }
 
 #[cfg(all(feature = "mlx5", target_os = "windows"))]
@@ -147,12 +158,73 @@ pub unsafe fn rte_eth_rx_offload_udp_cksum() -> c_int {
     rte_eth_rx_offload_udp_cksum_()
 }
 
+#[inline]
+pub unsafe fn rte_eth_rx_offload_tcp_lro() -> c_int {
+    rte_eth_rx_offload_tcp_lro_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_rx_offload_scatter() -> c_int {
+    rte_eth_rx_offload_scatter_()
+}
+
 #[inline]
 pub unsafe fn rte_eth_tx_offload_multi_segs() -> c_int {
     rte_eth_tx_offload_multi_segs_()
 }
 
+#[inline]
+pub unsafe fn rte_eth_tx_offload_ipv4_cksum() -> c_int {
+    rte_eth_tx_offload_ipv4_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_tx_offload_tcp_tso() -> c_int {
+    rte_eth_tx_offload_tcp_tso_()
+}
+
+#[inline]
+pub unsafe fn rte_pktmbuf_set_tcp_tso(m: *mut rte_mbuf, l2_len: u16, l3_len: u16, l4_len: u16) {
+    rte_pktmbuf_set_tcp_tso_(m, l2_len, l3_len, l4_len)
+}
+
 #[inline]
 pub unsafe fn rte_pktmbuf_prepend(m: *mut rte_mbuf, len: u16) -> *mut c_char {
     rte_pktmbuf_prepend_(m, len)
 }
+
+#[inline]
+pub unsafe fn rte_lcore_id() -> u32 {
+    rte_lcore_id_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_rx_queue_count(port_id: u16, queue_id: u16) -> c_int {
+    rte_eth_rx_queue_count_(port_id, queue_id)
+}
+
+#[inline]
+pub unsafe fn rte_eth_dev_rx_intr_ctl_q_per_thread(port_id: u16, queue_id: u16) -> c_int {
+    rte_eth_dev_rx_intr_ctl_q_per_thread_(port_id, queue_id)
+}
+
+#[inline]
+pub unsafe fn rte_epoll_wait_per_thread(timeout_ms: c_int) -> c_int {
+    rte_epoll_wait_per_thread_(timeout_ms)
+}
+
+#[inline]
+pub unsafe fn rte_flow_steer_arp(port_id: u16, queue_id: u16) -> c_int {
+    rte_flow_steer_arp_(port_id, queue_id)
+}
+
+#[inline]
+pub unsafe fn rte_flow_steer_dst_port(
+    port_id: u16,
+    udp: bool,
+    dst_port: u16,
+    dst_port_mask: u16,
+    queue_id: u16,
+) -> c_int {
+    rte_flow_steer_dst_port_(port_id, udp as c_int, dst_port, dst_port_mask, queue_id)
+}
@@ -189,7 +189,8 @@ static void server(int argc, char *const argv[], struct sockaddr_in *local, size
         /* Extract received scatter-gather array. */
         memcpy(&sga, &qr.qr_value.sga, sizeof(demi_sgarray_t));
 
-        nbytes += sga.sga_segs[0].sgaseg_len;
+        for (uint32_t i = 0; i < sga.sga_numsegs; i++)
+            nbytes += sga.sga_segs[i].sgaseg_len;
 
         /* Push scatter-gather array. */
         push_wait(qd, &sga, &qr);
@@ -258,9 +259,12 @@ static void client(int argc, char *const argv[], const struct sockaddr_in *remot
         pop_wait(sockqd, &qr);
 
         /* Check payload. */
-        for (uint32_t i = 0; i < qr.qr_value.sga.sga_segs[0].sgaseg_len; i++)
-            assert(((char *)qr.qr_value.sga.sga_segs[0].sgaseg_buf)[i] == 1);
-        nbytes += qr.qr_value.sga.sga_segs[0].sgaseg_len;
+        for (uint32_t j = 0; j < qr.qr_value.sga.sga_numsegs; j++)
+        {
+            for (uint32_t i = 0; i < qr.qr_value.sga.sga_segs[j].sgaseg_len; i++)
+                assert(((char *)qr.qr_value.sga.sga_segs[j].sgaseg_buf)[i] == 1);
+            nbytes += qr.qr_value.sga.sga_segs[j].sgaseg_len;
+        }
 
         /* Release received scatter-gather array. */
         assert(demi_sgafree(&qr.qr_value.sga) == 0);
@@ -53,7 +53,8 @@ static int pop_get_received_nbytes(int sockqd)
     assert(demi_wait(&res, tok, NULL) == 0);
     assert(res.qr_opcode == DEMI_OPC_POP);
     assert(res.qr_value.sga.sga_segs != 0);
-    recv_bytes = res.qr_value.sga.sga_segs[0].sgaseg_len;
+    for (uint32_t i = 0; i < res.qr_value.sga.sga_numsegs; i++)
+        recv_bytes += res.qr_value.sga.sga_segs[i].sgaseg_len;
     assert(demi_sgafree(&res.qr_value.sga) == 0);
     return recv_bytes;
 }
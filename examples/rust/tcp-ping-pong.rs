@@ -124,12 +124,14 @@ fn pop_and_wait(libos: &mut LibOS, sockqd: QDesc, recvbuf: &mut [u8]) -> Result<
         };
 
         // Copy data.
-        let ptr: *mut u8 = sga.sga_segs[0].sgaseg_buf as *mut u8;
-        let len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, len) };
-        for x in slice {
-            recvbuf[index] = *x;
-            index += 1;
+        for seg in &sga.sga_segs[..sga.sga_numsegs as usize] {
+            let ptr: *mut u8 = seg.sgaseg_buf as *mut u8;
+            let len: usize = seg.sgaseg_len as usize;
+            let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, len) };
+            for x in slice {
+                recvbuf[index] = *x;
+                index += 1;
+            }
         }
 
         if let Err(e) = libos.sgafree(sga) {
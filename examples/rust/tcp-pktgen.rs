@@ -239,7 +239,9 @@ impl Application {
                     },
                 };
 
-                num_bytes += sga.sga_segs[0].sgaseg_len as usize;
+                for seg in &sga.sga_segs[..sga.sga_numsegs as usize] {
+                    num_bytes += seg.sgaseg_len as usize;
+                }
                 if let Err(e) = self.libos.sgafree(sga) {
                     println!("ERROR: sgafree() failed (error={:?})", e);
                     println!("WARN: leaking sga");
@@ -144,15 +144,18 @@ impl TcpServer {
             };
 
             // Sanity check received data.
-            let ptr: *mut u8 = self.sga.expect("should be a valid sgarray").sga_segs[0].sgaseg_buf as *mut u8;
-            let len: usize = self.sga.expect("should be a valid sgarray").sga_segs[0].sgaseg_len as usize;
-            let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, len) };
+            let sga: demi_sgarray_t = self.sga.expect("should be a valid sgarray");
+            for seg in &sga.sga_segs[..sga.sga_numsegs as usize] {
+                let ptr: *mut u8 = seg.sgaseg_buf as *mut u8;
+                let len: usize = seg.sgaseg_len as usize;
+                let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, len) };
 
-            for x in slice {
-                demikernel::ensure_eq!(*x, fill_char);
-            }
+                for x in slice {
+                    demikernel::ensure_eq!(*x, fill_char);
+                }
 
-            i += self.sga.expect("should be a valid sgarray").sga_segs[0].sgaseg_len as usize;
+                i += len;
+            }
 
             match self.libos.sgafree(self.sga.expect("should be a valid sgarray")) {
                 Ok(_) => self.sga = None,
@@ -305,10 +305,14 @@ impl TcpEchoClient {
                 .ok_or(anyhow::anyhow!("unregistered socket"))?;
 
             // Copy data.
-            let ptr: *mut u8 = sga.sga_segs[0].sgaseg_buf as *mut u8;
-            let len: usize = sga.sga_segs[0].sgaseg_len as usize;
-            let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, len) };
-            recvbuf[*index..(*index + len)].copy_from_slice(slice);
+            let mut len: usize = 0;
+            for seg in &sga.sga_segs[..sga.sga_numsegs as usize] {
+                let ptr: *mut u8 = seg.sgaseg_buf as *mut u8;
+                let seglen: usize = seg.sgaseg_len as usize;
+                let slice: &mut [u8] = unsafe { slice::from_raw_parts_mut(ptr, seglen) };
+                recvbuf[(*index + len)..(*index + len + seglen)].copy_from_slice(slice);
+                len += seglen;
+            }
 
             *index += len;
 
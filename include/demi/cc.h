@@ -12,6 +12,7 @@
 #define _In_opt_
 #define _In_reads_(s)
 #define _In_reads_bytes_(b)
+#define _Inout_
 #define _Out_
 #define _Out_writes_to_(s, c)
 #define _Deref_pre_z_
@@ -24,13 +25,16 @@
 // w.r.t. SAL, so supporting both is complex.
 #define ATTR_NONNULL(...) __attribute__((nonnull(__VA_ARGS__)))
 #define ATTR_NODISCARD __attribute__((warn_unused_result))
+#define ATTR_ALIGNED(n) __attribute__((aligned(n)))
 #elif defined(_MSC_VER)
 // MSVC uses SAL; NONNULL is supported via _In_/_Out_/etc.
 #define ATTR_NONNULL(...)
 #define ATTR_NODISCARD _Check_return_
+#define ATTR_ALIGNED(n) __declspec(align(n))
 #else
 #define ATTR_NONNULL(...)
 #define ATTR_NODISCARD _Check_return_
+#define ATTR_ALIGNED(n)
 
 // Force inline
 #define inline __attribute__((always_inline))
@@ -0,0 +1,128 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef DEMI_CHANNEL_H_IS_INCLUDED
+#define DEMI_CHANNEL_H_IS_INCLUDED
+
+#include <demi/types.h>
+#include <demi/cc.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Creates a channel through which other threads submit I/O operations to this thread. Must be called from
+     * the thread that runs Demikernel.
+     *
+     * @param ch_out      Store location for the new channel.
+     * @param num_entries Number of operations that the channel holds in each direction.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_channel_create(_Out_ demi_channel_t **ch_out, _In_ uint32_t num_entries);
+
+    /**
+     * @brief Issues the I/O operations submitted to all channels, and posts the results of completed ones. Must be
+     * called from the thread that runs Demikernel. A new submission to any channel ends the wait early.
+     *
+     * @param timeout Timeout interval in seconds and nanoseconds to wait for the first operation to complete.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_channel_serve(_In_opt_ const struct timespec *timeout);
+
+    /**
+     * @brief Closes a channel. Results of operations that are still pending are discarded.
+     *
+     * @param ch Target channel.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_channel_close(_In_ demi_channel_t *ch);
+
+    /**
+     * @brief Submits a push operation through a channel.
+     *
+     * @param ch  Target channel.
+     * @param qd  Target I/O queue descriptor.
+     * @param sga Scatter-gather array to push.
+     * @param tag Identifier of the operation, returned in place of the I/O queue token.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1, 3)
+    extern int demi_channel_push(_In_ demi_channel_t *ch, _In_ int qd, _In_ const demi_sgarray_t *sga,
+                                 _In_ uint64_t tag);
+
+    /**
+     * @brief Submits a pop operation through a channel.
+     *
+     * @param ch  Target channel.
+     * @param qd  Target I/O queue descriptor.
+     * @param tag Identifier of the operation, returned in place of the I/O queue token.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_channel_pop(_In_ demi_channel_t *ch, _In_ int qd, _In_ uint64_t tag);
+
+    /**
+     * @brief Submits an accept operation through a channel.
+     *
+     * @param ch     Target channel.
+     * @param sockqd I/O queue descriptor of the target listening socket.
+     * @param tag    Identifier of the operation, returned in place of the I/O queue token.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_channel_accept(_In_ demi_channel_t *ch, _In_ int sockqd, _In_ uint64_t tag);
+
+    /**
+     * @brief Submits the asynchronous close of an I/O queue through a channel.
+     *
+     * @param ch  Target channel.
+     * @param qd  Target I/O queue descriptor.
+     * @param tag Identifier of the operation, returned in place of the I/O queue token.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_channel_close_qd(_In_ demi_channel_t *ch, _In_ int qd, _In_ uint64_t tag);
+
+    /**
+     * @brief Submits the release of a scatter-gather array through a channel.
+     *
+     * @param ch  Target channel.
+     * @param sga Scatter-gather array to release.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1, 2)
+    extern int demi_channel_sgafree(_In_ demi_channel_t *ch, _In_ const demi_sgarray_t *sga);
+
+    /**
+     * @brief Takes the results of completed I/O operations from a channel, without waiting.
+     *
+     * @param ch          Target channel.
+     * @param qr_out      Store location for the results of completed I/O operations.
+     * @param num_qrs     The number of demi_qresult_t entries pointed to by qr_out.
+     * @param num_qrs_out The number of results written to qr_out, which is zero if there were none.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1, 2, 4)
+    extern int demi_channel_reap(_In_ demi_channel_t *ch, _Out_writes_to_(num_qrs, *num_qrs_out) demi_qresult_t *qr_out,
+                                 _In_ int num_qrs, _Out_ int *num_qrs_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEMI_CHANNEL_H_IS_INCLUDED */
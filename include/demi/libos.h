@@ -32,6 +32,17 @@ extern "C"
     ATTR_NONNULL(1)
     extern int demi_init(_In_ const struct demi_args *args);
 
+    /**
+     * @brief Initializes Demikernel on the calling thread, bound to one RX/TX queue pair of the NIC.
+     *
+     * @param args     Args
+     * @param queue_id NIC queue pair that the calling thread drives.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_init_on_queue(_In_ const struct demi_args *args, _In_ uint16_t queue_id);
+
     /**
      * @brief Creates a socket I/O queue.
      *
@@ -78,6 +89,21 @@ extern "C"
     ATTR_NONNULL(1)
     extern int demi_accept(_Out_ demi_qtoken_t *qt_out, _In_ int sockqd);
 
+    /**
+     * @brief Asynchronously accepts several connections on a socket I/O queue in a single call.
+     *
+     * @param qts_out Store location for I/O queue tokens.
+     * @param sockqd  I/O queue descriptor of the target socket.
+     * @param num     Number of accept operations.
+     * @param num_out Store location for the number of accept operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * only the first num_out operations were issued. Entries of qts_out past those are left untouched.
+     */
+    ATTR_NONNULL(1, 4)
+    extern int demi_accept_batch(_Out_writes_to_(num, *num_out) demi_qtoken_t qts_out[], _In_ int sockqd, _In_ int num,
+                                 _Out_ int *num_out);
+
     /**
      * @brief Asynchronously initiates a connection on a socket I/O queue.
      *
@@ -113,6 +139,22 @@ extern "C"
     ATTR_NONNULL(1, 3)
     extern int demi_push(_Out_ demi_qtoken_t *qt_out, _In_ int qd, _In_ const demi_sgarray_t *sga);
 
+    /**
+     * @brief Asynchronously pushes a range of a file to a TCP socket I/O queue, without copying it into a
+     * scatter-gather array.
+     *
+     * @param qt_out Store location for I/O queue token.
+     * @param qd     I/O queue descriptor of the target socket.
+     * @param fd     File descriptor of the file to push.
+     * @param offset Offset of the first byte to push in the file.
+     * @param len    Number of bytes to push.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_push_file(_Out_ demi_qtoken_t *qt_out, _In_ int qd, _In_ int fd, _In_ uint64_t offset,
+                              _In_ size_t len);
+
     /**
      * @brief Asynchronously pushes a scatter-gather array to a socket I/O queue.
      *
@@ -139,6 +181,37 @@ extern "C"
     ATTR_NONNULL(1)
     extern int demi_pop(_Out_ demi_qtoken_t *qt_out, _In_ int qd);
 
+    /**
+     * @brief Asynchronously pushes several scatter-gather arrays to I/O queues in a single call.
+     *
+     * @param qts_out Store location for I/O queue tokens.
+     * @param qds     Target I/O queue descriptors.
+     * @param sgas    Scatter-gather arrays to push, one for each I/O queue descriptor.
+     * @param num     Number of push operations.
+     * @param num_out Store location for the number of push operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * only the first num_out operations were issued. Entries of qts_out past those are left untouched.
+     */
+    ATTR_NONNULL(1, 2, 3, 5)
+    extern int demi_push_batch(_Out_writes_to_(num, *num_out) demi_qtoken_t qts_out[], _In_reads_(num) const int qds[],
+                               _In_reads_(num) const demi_sgarray_t sgas[], _In_ int num, _Out_ int *num_out);
+
+    /**
+     * @brief Asynchronously pops scatter-gather arrays from several I/O queues in a single call.
+     *
+     * @param qts_out Store location for I/O queue tokens.
+     * @param qds     Target I/O queue descriptors.
+     * @param num     Number of pop operations.
+     * @param num_out Store location for the number of pop operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * only the first num_out operations were issued. Entries of qts_out past those are left untouched.
+     */
+    ATTR_NONNULL(1, 2, 4)
+    extern int demi_pop_batch(_Out_writes_to_(num, *num_out) demi_qtoken_t qts_out[], _In_reads_(num) const int qds[],
+                              _In_ int num, _Out_ int *num_out);
+
     /**
      * @brief Sets socket options.
      *
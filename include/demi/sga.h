@@ -33,6 +33,25 @@ extern "C"
      */
     extern int demi_sgafree(_In_ demi_sgarray_t *sga);
 
+    /**
+     * @brief Registers an application memory region for zero-copy I/O.
+     *
+     * @param addr Start address of the memory region.
+     * @param len  Length of the memory region in bytes.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_mem_register(_In_ void *addr, _In_ size_t len);
+
+    /**
+     * @brief Unregisters an application memory region.
+     *
+     * @param addr Start address of the memory region.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_mem_unregister(_In_ void *addr);
+
 #ifdef __cplusplus
 }
 #endif
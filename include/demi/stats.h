@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef DEMI_STATS_H_IS_INCLUDED
+#define DEMI_STATS_H_IS_INCLUDED
+
+#include <demi/types.h>
+#include <demi/cc.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Copies the counters of the Demikernel instance that runs on the calling thread.
+     *
+     * @param stats_out Store location for the counters.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_get_stats(_Out_ demi_stats_t *stats_out);
+
+    /**
+     * @brief Gets the live counters of the Demikernel instance that runs on the calling thread. They remain valid until
+     * the thread exits, and other threads may read them at any time.
+     *
+     * @param stats_out Store location for the address of the counters.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_stats_map(_Out_ const demi_stats_t **stats_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEMI_STATS_H_IS_INCLUDED */
@@ -22,10 +22,30 @@ extern "C"
 {
 #endif
 
+/**
+ * @brief Layout of public structures.
+ *
+ * By default, public structures are packed. If DEMI_ABI_ALIGNED is defined, they are naturally aligned instead, and
+ * demi_qresult_t is aligned to a cache line, so that its leading fields (opcode, queue descriptor, queue token and
+ * return code) share a single line. Demikernel must be built with the matching layout (the "abi-aligned" feature).
+ */
+#define DEMI_CACHE_LINE_SIZE 64
+#if defined(DEMI_ABI_ALIGNED)
+#define DEMI_PACKED
+#define DEMI_RESULT_ALIGNED ATTR_ALIGNED(DEMI_CACHE_LINE_SIZE)
+#elif defined(_WIN32)
+#define DEMI_PACK_PRAGMA
+#define DEMI_PACKED
+#define DEMI_RESULT_ALIGNED
+#else
+#define DEMI_PACKED __attribute__((__packed__))
+#define DEMI_RESULT_ALIGNED
+#endif
+
 /**
  * @brief Maximum number of segments in a scatter-gather array.
  */
-#define DEMI_SGARRAY_MAXSIZE 1
+#define DEMI_SGARRAY_MAXSIZE 16
 
     /**
      * @brief An I/O queue token.
@@ -35,38 +55,32 @@ extern "C"
 /**
  * @brief A segment of a scatter-gather array.
  */
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(push, 1)
-    typedef struct demi_sgaseg
-#endif
-#ifdef __linux__
-        typedef struct __attribute__((__packed__)) demi_sgaseg
 #endif
+    typedef struct DEMI_PACKED demi_sgaseg
     {
         void *sgaseg_buf;    /**< Underlying data.       */
         uint32_t sgaseg_len; /**< Size in bytes of data. */
     } demi_sgaseg_t;
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(pop)
 #endif
 
 /**
  * @brief A scatter-gather array.
  */
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(push, 1)
-    typedef struct demi_sgarray
-#endif
-#ifdef __linux__
-        typedef struct __attribute__((__packed__)) demi_sgarray
 #endif
+    typedef struct DEMI_PACKED demi_sgarray
     {
         void *sga_buf;                                /**< Reserved.                                       */
         uint32_t sga_numsegs;                         /**< Number of segments in the scatter-gather array. */
         demi_sgaseg_t sga_segs[DEMI_SGARRAY_MAXSIZE]; /**< Scatter-gather array segments.                  */
         struct sockaddr_in sga_addr;                  /**< Source address of scatter-gather array.         */
     } demi_sgarray_t;
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(pop)
 #endif
 
@@ -87,31 +101,25 @@ extern "C"
 /**
  * @brief Result value for an accept operation.
  */
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(push, 1)
-    typedef struct demi_accept_result
-#endif
-#ifdef __linux__
-        typedef struct __attribute__((__packed__)) demi_accept_result
 #endif
+    typedef struct DEMI_PACKED demi_accept_result
     {
         int32_t qd;              /**< Socket I/O queue descriptor of accepted connection. */
         struct sockaddr_in addr; /**< Remote address of accepted connection.              */
     } demi_accept_result_t;
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(pop)
 #endif
 
 /**
  * @brief Result value for an asynchronous I/O operation.
  */
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(push, 1)
-    typedef struct demi_qresult
-#endif
-#ifdef __linux__
-        typedef struct __attribute__((__packed__)) demi_qresult
 #endif
+    typedef struct DEMI_PACKED DEMI_RESULT_ALIGNED demi_qresult
     {
         enum demi_opcode qr_opcode; /**< Opcode of completed operation.                              */
         int32_t qr_qd;              /**< I/O queue descriptor associated to the completed operation. */
@@ -127,28 +135,95 @@ extern "C"
             demi_accept_result_t ares; /**< Accept result.                      */
         } qr_value;
     } demi_qresult_t;
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
+#pragma pack(pop)
+#endif
+
+/**
+ * @brief A completion ring.
+ *
+ * The application allocates the ring and its entries. Demikernel writes the results of completed operations at
+ * cq_tail, and the application consumes them from cq_head. Both indexes increase monotonically and wrap around, so
+ * entry i lives at cq_entries[i & (cq_size - 1)].
+ *
+ * Entries are full demi_qresult_t records rather than compact completions, so each takes sizeof(demi_qresult_t) bytes
+ * (a few hundred bytes, mostly the scatter-gather array of a pop). This lets a pop hand over its data in the entry
+ * itself, with no handle to resolve through a further call, and lets entries be handled just like the results of
+ * demi_wait().
+ */
+#ifdef DEMI_PACK_PRAGMA
+#pragma pack(push, 1)
+#endif
+    typedef struct DEMI_PACKED demi_cqring
+    {
+        uint32_t cq_head;           /**< Index of the next result to consume. Written by the application. */
+        uint32_t cq_tail;           /**< Index of the next result to produce. Written by Demikernel.      */
+        uint32_t cq_size;           /**< Number of entries. Must be a power of two.                      */
+        demi_qresult_t *cq_entries; /**< Ring entries.                                                   */
+    } demi_cqring_t;
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(pop)
 #endif
 
+/**
+ * @brief A channel through which application threads submit I/O operations to the thread that runs Demikernel. Its
+ * contents are opaque to the application.
+ */
+    typedef struct demi_channel demi_channel_t;
+
+/**
+ * @brief Number of buckets in the histogram of scheduler polls.
+ */
+#define DEMI_STATS_POLL_BUCKETS 8
+
+    /**
+     * @brief Counters of the Demikernel instance that runs on a thread, and thus of the device queue that it binds.
+     *
+     * Unlike other public structures, this one is never packed: all fields are naturally aligned 64-bit counters, so
+     * that other threads may read each of them with a single load while Demikernel updates them.
+     */
+    typedef struct demi_stats
+    {
+        uint64_t rx_packets;           /**< Number of packets received from the device.                              */
+        uint64_t rx_bursts;            /**< Number of receive bursts, including empty ones.                          */
+        uint64_t rx_empty_bursts;      /**< Number of receive bursts that came back empty.                           */
+        uint64_t tx_packets;           /**< Number of packets handed to the device.                                  */
+        uint64_t tx_bursts;            /**< Number of transmit bursts that the device accepted.                      */
+        uint64_t tx_drops;             /**< Number of packets dropped because the transmit ring was full.            */
+        uint64_t mempool_misses;       /**< Number of buffers that could not be taken from a memory pool.            */
+        uint64_t tcp_retransmits;      /**< Number of TCP segments that were sent again.                             */
+        uint64_t tcp_rto_fires;        /**< Number of TCP retransmission timeouts.                                   */
+        uint64_t wait_any_scans;       /**< Number of times that a wait went through a list of queue tokens.         */
+        uint64_t wait_any_scanned_qts; /**< Total number of queue tokens in the lists that these scans went through. */
+        uint64_t timer_arms;           /**< Number of timers that were armed.                                        */
+        uint64_t timer_cancels;        /**< Number of timers that were cancelled before they fired.                  */
+        uint64_t timer_fires;          /**< Number of timers that fired.                                             */
+
+        /**
+         * @brief Number of scheduler polls by number of tasks run. Bucket 0 counts polls that ran no task, and bucket i
+         * counts polls that ran between 2^(i-1) and 2^i - 1 tasks. The last bucket counts all larger polls.
+         */
+        uint64_t poll_histogram[DEMI_STATS_POLL_BUCKETS];
+    } demi_stats_t;
+
     // Callback Function.
     typedef void (*demi_callback_t)(const char *, uint32_t, uint64_t);
 
 /**
  * @brief Arguments for Demikernel.
  */
-#ifdef _WIN32
+#ifdef DEMI_PACK_PRAGMA
 #pragma pack(push, 1)
-    struct demi_args
-#endif
-#ifdef __linux__
-        struct __attribute__((__packed__)) demi_args
 #endif
+    struct DEMI_PACKED demi_args
     {
         int argc;                 /**< Number of command-line arguments. */
         char *const *argv;        /**< Command-line Arguments.           */
         demi_callback_t callback; /**< Callback Function.                */
     };
+#ifdef DEMI_PACK_PRAGMA
+#pragma pack(pop)
+#endif
 
 #ifdef __cplusplus
 }
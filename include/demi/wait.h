@@ -57,6 +57,69 @@ extern "C"
     extern int demi_wait_next_n(_Out_writes_to_(num_qrs, *ready_offset) demi_qresult_t *qr_out, _In_ int num_qrs,
                                 _Out_ int *num_qrs_out, _In_opt_ const struct timespec *timeout);
 
+    /**
+     * @brief Waits for asynchronous I/O operations to complete and writes their results to a completion ring.
+     *
+     * @param cq      Target completion ring.
+     * @param timeout Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_wait_ring(_Inout_ demi_cqring_t *cq, _In_opt_ const struct timespec *timeout);
+
+    /**
+     * @brief Creates an empty set of I/O queue tokens.
+     *
+     * @param set_out Store location for the identifier of the new set.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_qtset_create(_Out_ int *set_out);
+
+    /**
+     * @brief Releases a set of I/O queue tokens.
+     *
+     * @param set Identifier of the target set.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_qtset_free(_In_ int set);
+
+    /**
+     * @brief Adds an I/O queue token to a set. The I/O queue token leaves the set once its operation completes and
+     * its result is returned.
+     *
+     * @param set Identifier of the target set.
+     * @param qt  I/O queue token to add.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_qtset_add(_In_ int set, _In_ demi_qtoken_t qt);
+
+    /**
+     * @brief Removes a pending I/O queue token from a set.
+     *
+     * @param set Identifier of the target set.
+     * @param qt  I/O queue token to remove.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_qtset_remove(_In_ int set, _In_ demi_qtoken_t qt);
+
+    /**
+     * @brief Waits for the first asynchronous I/O operation in a set to complete.
+     *
+     * @param qr_out  Store location for the result of the completed I/O operation.
+     * @param set     Identifier of the set of I/O queue tokens to wait for completion.
+     * @param timeout Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_wait_set(_Out_ demi_qresult_t *qr_out, _In_ int set, _In_opt_ const struct timespec *timeout);
+
 #ifdef __cplusplus
 }
 #endif
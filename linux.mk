@@ -78,6 +78,14 @@ endif
 
 CARGO_FEATURES += $(FEATURES)
 
+# Optional Linux backends, which replace the default transport of a libOS and are only built on request.
+ifeq ($(LIBOS),catnap)
+export BACKEND_FEATURES ?= --features=catnap-uring
+endif
+ifeq ($(LIBOS),catpowder)
+export BACKEND_FEATURES ?= --features=catpowder-xdp
+endif
+
 #=======================================================================================================================
 # Targets
 #=======================================================================================================================
@@ -204,12 +212,16 @@ test-system: test-system-rust
 test-system-rust:
 	timeout $(TIMEOUT_SECONDS) $(BINDIR)/examples/rust/$(TEST).elf $(ARGS)
 
+test-system-c:
+	timeout $(TIMEOUT_SECONDS) $(BINDIR)/examples/c/$(TEST).elf $(ARGS)
+
 test-unit: test-unit-rust
 
 test-unit-c: all-tests test-unit-c-sizes test-unit-c-syscalls
 
-test-unit-c-sizes: all-tests $(BINDIR)/sizes.elf
+test-unit-c-sizes: all-tests $(BINDIR)/sizes.elf $(BINDIR)/sizes-aligned.elf
 	timeout $(TIMEOUT_SECONDS) $(BINDIR)/sizes.elf
+	timeout $(TIMEOUT_SECONDS) $(BINDIR)/sizes-aligned.elf
 
 test-unit-c-syscalls: all-tests $(BINDIR)/syscalls.elf
 	timeout $(TIMEOUT_SECONDS) $(BINDIR)/syscalls.elf
@@ -222,6 +234,11 @@ test-unit-rust: test-unit-rust-lib test-unit-rust-udp test-unit-rust-tcp
 	timeout $(TIMEOUT_SECONDS) $(CARGO) test --test sga $(BUILD) $(CARGO_FEATURES) -- --nocapture --test-threads=1 test_unit_sga_alloc_free_loop_tight_big
 	timeout $(TIMEOUT_SECONDS) $(CARGO) test --test sga $(BUILD) $(CARGO_FEATURES) -- --nocapture --test-threads=1 test_unit_sga_alloc_free_loop_decoupled_big
 
+# Builds the optional backend of the libOS and runs the unit tests against it.
+test-unit-rust-backend:
+	$(CARGO) build --lib $(CARGO_FEATURES) $(BACKEND_FEATURES) $(CARGO_FLAGS)
+	timeout $(TIMEOUT_SECONDS) $(CARGO) test --lib $(CARGO_FLAGS) $(CARGO_FEATURES) $(BACKEND_FEATURES) -- --nocapture $(TEST_UNIT)
+
 test-unit-rust-lib: all-tests-rust
 	timeout $(TIMEOUT_SECONDS) $(CARGO) test --lib $(CARGO_FLAGS) $(CARGO_FEATURES) -- --nocapture $(TEST_UNIT)
 
@@ -241,5 +258,8 @@ test-clean:
 # Benchmarks
 #=======================================================================================================================
 
-run-benchmarks-c: all-benchmarks-c $(BINDIR)/syscalls.elf
-	timeout $(TIMEOUT_SECONDS) $(BINDIR)/benchmarks.elf
+run-benchmarks-c: all-benchmarks-c
+	timeout $(TIMEOUT_SECONDS) $(BINDIR)/benchmarks.elf $(ARGS)
+
+run-benchmarks-sim: all-tests-rust
+	DEMIKERNEL_PERF_REPORT=1 timeout $(TIMEOUT_SECONDS) $(CARGO) test --lib $(CARGO_FLAGS) $(CARGO_FEATURES) -- --nocapture --test-threads=1 $(TEST_UNIT)
@@ -8,11 +8,26 @@
 use crate::{
     catnap::transport::get_libc_err,
     collections::{async_queue::AsyncQueue, async_value::SharedAsyncValue},
-    expect_ok,
+    expect_ok, expect_some,
     runtime::{fail::Fail, limits, memory::DemiBuffer, DemiRuntime},
 };
-use ::socket2::Socket;
-use ::std::{cmp::min, io, mem::MaybeUninit, net::SocketAddr};
+use ::arrayvec::ArrayVec;
+use ::socket2::{SockAddr, Socket, Type};
+use ::std::{
+    cmp::min,
+    io,
+    mem::{self, MaybeUninit},
+    net::SocketAddr,
+    os::fd::{AsRawFd, RawFd},
+    ptr,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Maximum number of datagrams that we move with a single system call.
+const DATAGRAM_BATCH_SIZE: usize = 32;
 
 //======================================================================================================================
 // Structures
@@ -22,15 +37,31 @@ use ::std::{cmp::min, io, mem::MaybeUninit, net::SocketAddr};
 struct Outgoing {
     addr: Option<SocketAddr>,
     buf: DemiBuffer,
+    /// Range of a file that goes out instead of `buf`, which is then empty.
+    file: Option<OutgoingFile>,
     result: SharedAsyncValue<Option<Result<(), Fail>>>,
 }
 
+/// This structure represents a range of a file that the kernel sends straight from the page cache.
+struct OutgoingFile {
+    fd: RawFd,
+    offset: libc::off_t,
+    len: usize,
+}
+
 /// This structure represents the metadata for an active established socket: the socket itself and the queue of
 /// outgoing messages and incoming ones.
 pub struct ActiveSocketData {
     socket: Socket,
+    /// Whether this is a datagram socket, which sends and receives in batches.
+    datagram: bool,
     send_queue: AsyncQueue<Outgoing>,
     recv_queue: AsyncQueue<Result<(Option<SocketAddr>, DemiBuffer), Fail>>,
+    /// Receive buffers that the last batch of datagrams did not fill, kept for the next one.
+    recv_spare: ArrayVec<DemiBuffer, DATAGRAM_BATCH_SIZE>,
+    /// Number of datagrams that the next batch receives at most. This follows the load of the socket, so that a quiet
+    /// socket holds on to a single receive buffer rather than to a full batch of them.
+    recv_batch_size: usize,
     closed: bool,
 }
 
@@ -40,10 +71,14 @@ pub struct ActiveSocketData {
 
 impl ActiveSocketData {
     pub fn new(socket: Socket) -> Self {
+        let datagram: bool = matches!(socket.r#type(), Ok(Type::DGRAM));
         Self {
             socket,
+            datagram,
             send_queue: AsyncQueue::default(),
             recv_queue: AsyncQueue::default(),
+            recv_spare: ArrayVec::new(),
+            recv_batch_size: 1,
             closed: false,
         }
     }
@@ -52,12 +87,19 @@ impl ActiveSocketData {
     /// buffer for write to indicate that we want to know when the socket is ready for writing but do not have data to
     /// write (i.e., to detect when connect finishes).
     pub fn poll_send(&mut self) {
+        if self.datagram {
+            return self.poll_send_batch();
+        }
         if let Some(Outgoing {
             addr,
             mut buf,
+            file,
             mut result,
         }) = self.send_queue.try_pop()
         {
+            if let Some(file) = file {
+                return self.poll_send_file(buf, file, result);
+            }
             // A dummy request to detect when the socket has connected.
             if buf.is_empty() {
                 result.set(Some(Ok(())));
@@ -81,14 +123,24 @@ impl ActiveSocketData {
                         result.set(Some(Ok(())));
                     } else {
                         // Only sent part of the buffer so try again later.
-                        self.send_queue.push_front(Outgoing { addr, buf, result });
+                        self.send_queue.push_front(Outgoing {
+                            addr,
+                            buf,
+                            file: None,
+                            result,
+                        });
                     }
                 },
                 Err(e) => {
                     let errno: i32 = get_libc_err(e);
                     if DemiRuntime::should_retry(errno) {
                         // Put the buffer back and try again later.
-                        self.send_queue.push_front(Outgoing { addr, buf, result });
+                        self.send_queue.push_front(Outgoing {
+                            addr,
+                            buf,
+                            file: None,
+                            result,
+                        });
                     } else {
                         let cause: String = format!("failed to send on socket: {:?}", errno);
                         error!("poll_send(): {}", cause);
@@ -99,10 +151,62 @@ impl ActiveSocketData {
         }
     }
 
+    /// Sends as much of a range of a file as the socket takes, without copying it to user space.
+    fn poll_send_file(
+        &mut self,
+        buf: DemiBuffer,
+        mut file: OutgoingFile,
+        mut result: SharedAsyncValue<Option<Result<(), Fail>>>,
+    ) {
+        // Safety: sendfile() only reads from the file and advances the offset that we hand it.
+        match unsafe { libc::sendfile(self.socket.as_raw_fd(), file.fd, &mut file.offset, file.len) } {
+            // The file ended before the range did.
+            0 => {
+                let cause: String = format!("file is shorter than the range to send (fd={:?})", file.fd);
+                error!("poll_send_file(): {}", cause);
+                result.set(Some(Err(Fail::new(libc::EINVAL, &cause))));
+            },
+            nbytes if nbytes > 0 => {
+                trace!("file data pushed ({:?}/{:?} bytes)", nbytes, file.len);
+                file.len -= nbytes as usize;
+                if file.len == 0 {
+                    result.set(Some(Ok(())));
+                } else {
+                    // Only sent part of the range so try again later.
+                    self.send_queue.push_front(Outgoing {
+                        addr: None,
+                        buf,
+                        file: Some(file),
+                        result,
+                    });
+                }
+            },
+            _ => {
+                let errno: i32 = get_libc_err(io::Error::last_os_error());
+                if DemiRuntime::should_retry(errno) {
+                    // Put the range back and try again later.
+                    self.send_queue.push_front(Outgoing {
+                        addr: None,
+                        buf,
+                        file: Some(file),
+                        result,
+                    });
+                } else {
+                    let cause: String = format!("failed to send file on socket: {:?}", errno);
+                    error!("poll_send_file(): {}", cause);
+                    result.set(Some(Err(Fail::new(errno, &cause))));
+                }
+            },
+        }
+    }
+
     /// Polls the socket for incoming data on an incoming epoll event. Inserts any received data into the incoming
     /// queue.
     /// TODO: Incoming queue should possibly be byte oriented.
     pub fn poll_recv(&mut self) {
+        if self.datagram {
+            return self.poll_recv_batch();
+        }
         let mut buf: DemiBuffer = DemiBuffer::new(limits::POP_SIZE_MAX as u16);
         if self.closed {
             return;
@@ -134,14 +238,200 @@ impl ActiveSocketData {
         }
     }
 
+    /// Sends all queued datagrams, up to [DATAGRAM_BATCH_SIZE], with a single system call. Datagrams are sent whole or
+    /// not at all.
+    fn poll_send_batch(&mut self) {
+        let mut addrs: ArrayVec<Option<SockAddr>, DATAGRAM_BATCH_SIZE> = ArrayVec::new();
+        let mut iovecs: ArrayVec<libc::iovec, DATAGRAM_BATCH_SIZE> = ArrayVec::new();
+        for outgoing in self.send_queue.get_values().take(DATAGRAM_BATCH_SIZE) {
+            // A dummy request to detect when the socket is writable ends the batch.
+            if outgoing.buf.is_empty() {
+                break;
+            }
+            addrs.push(outgoing.addr.map(SockAddr::from));
+            iovecs.push(libc::iovec {
+                iov_base: outgoing.buf.as_ptr() as *mut libc::c_void,
+                iov_len: outgoing.buf.len(),
+            });
+        }
+        if iovecs.is_empty() {
+            // Complete the dummy request, if any.
+            if let Some(mut outgoing) = self.send_queue.try_pop() {
+                outgoing.result.set(Some(Ok(())));
+            }
+            return;
+        }
+
+        let mut msgs: ArrayVec<libc::mmsghdr, DATAGRAM_BATCH_SIZE> = ArrayVec::new();
+        for (iovec, addr) in iovecs.iter_mut().zip(addrs.iter()) {
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            if let Some(addr) = addr {
+                msg.msg_hdr.msg_name = addr.as_ptr() as *mut libc::c_void;
+                msg.msg_hdr.msg_namelen = addr.len();
+            }
+            msg.msg_hdr.msg_iov = iovec as *mut libc::iovec;
+            msg.msg_hdr.msg_iovlen = 1;
+            msgs.push(msg);
+        }
+
+        match unsafe {
+            libc::sendmmsg(
+                self.socket.as_raw_fd(),
+                msgs.as_mut_ptr(),
+                msgs.len() as libc::c_uint,
+                libc::MSG_DONTWAIT,
+            )
+        } {
+            nr_sent if nr_sent >= 0 => {
+                trace!("datagrams pushed ({:?}/{:?})", nr_sent, msgs.len());
+                for _ in 0..nr_sent {
+                    let mut outgoing: Outgoing = expect_some!(self.send_queue.try_pop(), "should have been queued");
+                    outgoing.result.set(Some(Ok(())));
+                }
+            },
+            _ => {
+                let errno: i32 = get_libc_err(io::Error::last_os_error());
+                // Leave the datagrams queued and try again later.
+                if !DemiRuntime::should_retry(errno) {
+                    // The first datagram is the one that failed.
+                    let cause: String = format!("failed to send on socket: {:?}", errno);
+                    error!("poll_send_batch(): {}", cause);
+                    let mut outgoing: Outgoing = expect_some!(self.send_queue.try_pop(), "should have been queued");
+                    outgoing.result.set(Some(Err(Fail::new(errno, &cause))));
+                }
+            },
+        }
+    }
+
+    /// Receives up to [DATAGRAM_BATCH_SIZE] datagrams with a single system call and inserts them into the incoming
+    /// queue. Datagrams are received straight into the buffers that we hand to the application.
+    fn poll_recv_batch(&mut self) {
+        while self.recv_spare.len() < self.recv_batch_size {
+            self.recv_spare.push(DemiBuffer::new(limits::POP_SIZE_MAX as u16));
+        }
+        let mut addrs: [libc::sockaddr_storage; DATAGRAM_BATCH_SIZE] = unsafe { mem::zeroed() };
+        let mut iovecs: ArrayVec<libc::iovec, DATAGRAM_BATCH_SIZE> = ArrayVec::new();
+        for buf in self.recv_spare.iter_mut() {
+            iovecs.push(libc::iovec {
+                iov_base: buf.as_mut_ptr() as *mut libc::c_void,
+                iov_len: buf.len(),
+            });
+        }
+        let mut msgs: ArrayVec<libc::mmsghdr, DATAGRAM_BATCH_SIZE> = ArrayVec::new();
+        for (iovec, addr) in iovecs.iter_mut().zip(addrs.iter_mut()) {
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            msg.msg_hdr.msg_name = addr as *mut libc::sockaddr_storage as *mut libc::c_void;
+            msg.msg_hdr.msg_namelen = mem::size_of::<libc::sockaddr_storage>() as libc::socklen_t;
+            msg.msg_hdr.msg_iov = iovec as *mut libc::iovec;
+            msg.msg_hdr.msg_iovlen = 1;
+            msgs.push(msg);
+        }
+
+        match unsafe {
+            libc::recvmmsg(
+                self.socket.as_raw_fd(),
+                msgs.as_mut_ptr(),
+                msgs.len() as libc::c_uint,
+                libc::MSG_DONTWAIT,
+                ptr::null_mut(),
+            )
+        } {
+            nr_received if nr_received >= 0 => {
+                let nr_received: usize = nr_received as usize;
+                trace!("datagrams popped ({:?})", nr_received);
+                for ((mut buf, msg), addr) in self.recv_spare.drain(..nr_received).zip(&msgs).zip(&addrs) {
+                    if let Err(e) = buf.trim(buf.len() - msg.msg_len as usize) {
+                        self.recv_queue.push(Err(e));
+                        continue;
+                    }
+                    let addr: SockAddr = unsafe { SockAddr::new(*addr, msg.msg_hdr.msg_namelen) };
+                    self.recv_queue.push(Ok((addr.as_socket(), buf)));
+                }
+                // Grow the batch while datagrams fill it and shrink it down to what arrived otherwise.
+                self.recv_batch_size = if nr_received == self.recv_batch_size {
+                    min(2 * self.recv_batch_size, DATAGRAM_BATCH_SIZE)
+                } else {
+                    nr_received.max(1)
+                };
+                self.recv_spare.truncate(self.recv_batch_size);
+            },
+            _ => {
+                let errno: i32 = get_libc_err(io::Error::last_os_error());
+                if !DemiRuntime::should_retry(errno) {
+                    let cause: String = format!("failed to receive on socket: {:?}", errno);
+                    error!("poll_recv_batch(): {}", cause);
+                    self.recv_queue.push(Err(Fail::new(errno, &cause)));
+                }
+                // Nothing arrived, so keep a single receive buffer around.
+                self.recv_batch_size = 1;
+                self.recv_spare.truncate(1);
+            },
+        }
+    }
+
     /// Pushes data to the socket. Blocks until completion.
-    pub async fn push(&mut self, addr: Option<SocketAddr>, buf: DemiBuffer) -> Result<(), Fail> {
-        let mut result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
+    pub async fn push(&mut self, addr: Option<SocketAddr>, mut buf: DemiBuffer) -> Result<(), Fail> {
+        if buf.num_segments() == 1 {
+            return self.push_outgoing(addr, buf, None).await;
+        }
+        // Queue all segments of a chain at once, so they go out back to back, and then wait for them in order.
+        let mut results: Vec<SharedAsyncValue<Option<Result<(), Fail>>>> = Vec::with_capacity(buf.num_segments());
+        loop {
+            let tail: Option<DemiBuffer> = buf.detach_tail();
+            // Empty segments would pass for the dummy request that detects connection.
+            if !buf.is_empty() {
+                results.push(self.queue_outgoing(addr, buf, None));
+            }
+            match tail {
+                Some(tail) => buf = tail,
+                None => break,
+            }
+        }
+        for result in results {
+            Self::wait_outgoing(result).await?;
+        }
+        Ok(())
+    }
+
+    /// Pushes `len` bytes of the file `fd`, starting at `offset`, to the socket. Blocks until completion.
+    pub async fn push_file(&mut self, fd: RawFd, offset: u64, len: usize) -> Result<(), Fail> {
+        let offset: libc::off_t = offset
+            .try_into()
+            .map_err(|_| Fail::new(libc::EINVAL, "file offset is too large"))?;
+        let file: OutgoingFile = OutgoingFile { fd, offset, len };
+        self.push_outgoing(None, DemiBuffer::new(0), Some(file)).await
+    }
+
+    /// Queues outgoing data and waits until it has been sent.
+    async fn push_outgoing(
+        &mut self,
+        addr: Option<SocketAddr>,
+        buf: DemiBuffer,
+        file: Option<OutgoingFile>,
+    ) -> Result<(), Fail> {
+        let result: SharedAsyncValue<Option<Result<(), Fail>>> = self.queue_outgoing(addr, buf, file);
+        Self::wait_outgoing(result).await
+    }
+
+    /// Queues outgoing data and returns the value that is set once it has been sent.
+    fn queue_outgoing(
+        &mut self,
+        addr: Option<SocketAddr>,
+        buf: DemiBuffer,
+        file: Option<OutgoingFile>,
+    ) -> SharedAsyncValue<Option<Result<(), Fail>>> {
+        let result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
         self.send_queue.push(Outgoing {
             addr,
             buf,
+            file,
             result: result.clone(),
         });
+        result
+    }
+
+    /// Waits until the outgoing data of `result` has been sent.
+    async fn wait_outgoing(mut result: SharedAsyncValue<Option<Result<(), Fail>>>) -> Result<(), Fail> {
         loop {
             match result.get() {
                 Some(result) => return result,
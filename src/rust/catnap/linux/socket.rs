@@ -105,6 +105,15 @@ impl SharedSocketData {
         }
     }
 
+    /// Push a range of a file to an active established connection.
+    pub async fn push_file(&mut self, fd: RawFd, offset: u64, len: usize) -> Result<(), Fail> {
+        match self.deref_mut() {
+            SocketData::Inactive(_) => unreachable!("Cannot write to an inactive socket"),
+            SocketData::Active(data) => data.push_file(fd, offset, len).await,
+            SocketData::Passive(_) => unreachable!("Cannot write to a passive socket"),
+        }
+    }
+
     /// Accept a new connection on an passive listening socket.
     pub async fn accept(&mut self) -> Result<(Socket, SocketAddr), Fail> {
         match self.deref_mut() {
@@ -0,0 +1,254 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Synchronous socket operations that do not depend on how the Linux transport waits for I/O.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    expect_some,
+    runtime::{
+        fail::Fail,
+        network::socket::option::{SocketOption, TcpSocketOptions},
+    },
+};
+use ::socket2::{Domain, Protocol, Socket, Type};
+use ::std::{
+    io,
+    net::{Shutdown, SocketAddr, SocketAddrV4},
+    os::fd::AsRawFd,
+};
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Internal function to extract the raw OS error code.
+pub fn get_libc_err(e: io::Error) -> i32 {
+    expect_some!(e.raw_os_error(), "should have an os error code")
+}
+
+/// Creates a non-blocking socket. We only support IPv4 and UDP and TCP sockets for now.
+pub fn new_socket(domain: Domain, typ: Type, options: &TcpSocketOptions) -> Result<Socket, Fail> {
+    // Select protocol.
+    let protocol: Protocol = match typ {
+        Type::STREAM => Protocol::TCP,
+        Type::DGRAM => Protocol::UDP,
+        _ => {
+            let cause: String = format!("socket type not supported: {:?}", typ);
+            error!("socket(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        },
+    };
+
+    // Attempts to shutdown a socket. If we fail, log a warn message and do not overwrite the original error.
+    let attempt_shutdown = |socket: Socket| {
+        if let Err(e) = socket.shutdown(Shutdown::Both) {
+            let cause: String = format!("cannot shutdown socket: {:?}", e);
+            warn!("socket(): {}", cause);
+        }
+    };
+
+    // Create socket.
+    match socket2::Socket::new(domain, typ, Some(protocol)) {
+        Ok(socket) => {
+            // Set socket options.
+            if let Err(e) = socket.set_reuse_address(true) {
+                let cause: String = format!("cannot set REUSE_ADDRESS option: {:?}", e);
+                let errno: i32 = get_libc_err(e);
+                error!("socket(): {}", cause);
+                attempt_shutdown(socket);
+                return Err(Fail::new(errno, &cause));
+            }
+
+            let socket_fd = socket.as_raw_fd();
+            let flags = unsafe { libc::fcntl(socket_fd, libc::F_GETFL) };
+            if flags & libc::O_NONBLOCK == 0 {
+                if let Err(e) = socket.set_nonblocking(true) {
+                    let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
+                    let errno: i32 = get_libc_err(e);
+                    error!("socket(): {}", cause);
+                    attempt_shutdown(socket);
+                    return Err(Fail::new(errno, &cause));
+                }
+            }
+
+            // Set TCP socket options
+            if typ == Type::STREAM {
+                if let Err(e) = socket.set_nodelay(options.get_nodelay()) {
+                    let cause: String = format!("cannot set TCP_NODELAY option: {:?}", e);
+                    let errno: i32 = get_libc_err(e);
+                    error!("socket(): {}", cause);
+                    attempt_shutdown(socket);
+                    return Err(Fail::new(errno, &cause));
+                }
+            }
+
+            Ok(socket)
+        },
+        Err(e) => {
+            let cause: String = format!("failed to create socket: {:?}", e);
+            error!("{}", cause);
+            Err(Fail::new(get_libc_err(e), &cause))
+        },
+    }
+}
+
+/// Sets the options of a newly accepted connection.
+pub fn set_accepted_socket_options(new_socket: &Socket) -> Result<(), Fail> {
+    if let Err(e) = new_socket.set_reuse_address(true) {
+        let cause: String = format!("cannot set REUSE_ADDRESS option: {:?}", e);
+        new_socket.shutdown(Shutdown::Both)?;
+        error!("accept(): {}", cause);
+        return Err(Fail::new(get_libc_err(e), &cause));
+    }
+    if let Err(e) = new_socket.set_nodelay(true) {
+        let cause: String = format!("cannot set TCP_NODELAY option: {:?}", e);
+        new_socket.shutdown(Shutdown::Both)?;
+        error!("accept(): {}", cause);
+        return Err(Fail::new(get_libc_err(e), &cause));
+    }
+    if let Err(e) = new_socket.set_nonblocking(true) {
+        let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
+        new_socket.shutdown(Shutdown::Both)?;
+        error!("accept(): {}", cause);
+        return Err(Fail::new(get_libc_err(e), &cause));
+    }
+    Ok(())
+}
+
+/// Set an SO_* option on the socket.
+pub fn set_socket_option(socket: &mut Socket, option: SocketOption) -> Result<(), Fail> {
+    trace!("Set socket option to {:?}", option);
+    match option {
+        SocketOption::Linger(linger) => {
+            if let Err(e) = socket.set_linger(linger) {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_LINGER failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            } else {
+                Ok(())
+            }
+        },
+        SocketOption::KeepAlive(alive) => {
+            if let Err(e) = socket.set_keepalive(alive) {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_KEEPALIVE failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            } else {
+                Ok(())
+            }
+        },
+        SocketOption::NoDelay(nagle_off) => {
+            if let Err(e) = socket.set_nodelay(nagle_off) {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_TCP_NO_DELAY failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            } else {
+                Ok(())
+            }
+        },
+        SocketOption::CongestionControl(algorithm) => {
+            let cause: String = format!("congestion control is up to the kernel (algorithm={})", algorithm);
+            error!("set_socket_option(): {}", cause);
+            Err(Fail::new(libc::ENOTSUP, &cause))
+        },
+    }
+}
+
+/// Gets an SO_* option on the socket. The option should be passed in as [option] and the value returned is either
+/// an error or must match [option] with a value.
+pub fn get_socket_option(socket: &mut Socket, option: SocketOption) -> Result<SocketOption, Fail> {
+    trace!("Set socket option to {:?}", option);
+    match option {
+        SocketOption::Linger(_) => match socket.linger() {
+            Ok(linger) => Ok(SocketOption::Linger(linger)),
+            Err(e) => {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_LINGER failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+        },
+        SocketOption::KeepAlive(_) => match socket.keepalive() {
+            Ok(keepalive) => Ok(SocketOption::KeepAlive(keepalive)),
+            Err(e) => {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_KEEPALIVE failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+        },
+        SocketOption::NoDelay(_) => match socket.nodelay() {
+            Ok(nagle_off) => Ok(SocketOption::NoDelay(nagle_off)),
+            Err(e) => {
+                let errno: i32 = get_libc_err(e);
+                let cause: String = format!("SO_TCP_NO_DELAY failed: {:?}", errno);
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+        },
+        SocketOption::CongestionControl(_) => {
+            let cause: String = format!("congestion control is up to the kernel");
+            error!("get_socket_option(): {}", cause);
+            Err(Fail::new(libc::ENOTSUP, &cause))
+        },
+    }
+}
+
+// Gets peer name of connected socket.
+pub fn getpeername(socket: &mut Socket) -> Result<SocketAddrV4, Fail> {
+    match socket.peer_addr() {
+        Ok(addr) => match addr.as_socket_ipv4() {
+            Some(ipv4_addr) => Ok(ipv4_addr),
+            None => {
+                let cause: String = format!("invalid IPv4 address");
+                error!("getpeername(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        },
+        Err(e) => {
+            let errno: i32 = get_libc_err(e);
+            let cause: String = format!("failed to get peer name (errno={:?})", errno);
+            error!("getpeername(): {}", cause);
+            Err(Fail::new(errno, &cause))
+        },
+    }
+}
+
+/// Binds a socket to [local], allowing other sockets to reuse the port.
+pub fn bind(socket: &mut Socket, local: SocketAddr) -> Result<(), Fail> {
+    trace!("Bind to {:?}", local);
+
+    // Set SO_REUSE_PORT.
+    let optval: libc::c_int = 1;
+    let optval_len: libc::socklen_t = std::mem::size_of_val(&optval) as libc::socklen_t;
+    if unsafe {
+        libc::setsockopt(
+            socket.as_raw_fd(),
+            libc::SOL_SOCKET,
+            libc::SO_REUSEPORT,
+            &optval as *const _ as *const libc::c_void,
+            optval_len,
+        )
+    } < 0
+    {
+        let e: i32 = get_libc_err(io::Error::last_os_error());
+        let cause: String = format!("failed to bind socket: {:?}", e);
+        error!("bind(): {}", cause);
+        return Err(Fail::new(e, &cause));
+    }
+
+    if let Err(e) = socket.bind(&local.into()) {
+        let cause: String = format!("failed to bind socket: {:?}", e);
+        error!("bind(): {}", cause);
+        Err(Fail::new(get_libc_err(e), &cause))
+    } else {
+        Ok(())
+    }
+}
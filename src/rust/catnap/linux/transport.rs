@@ -8,13 +8,17 @@
 mod active_socket;
 mod passive_socket;
 mod socket;
+mod socket_ops;
 
 //======================================================================================================================
 // Imports
 //======================================================================================================================
 
 use crate::{
-    catnap::transport::socket::{SharedSocketData, SocketData},
+    catnap::transport::{
+        socket::{SharedSocketData, SocketData},
+        socket_ops::{self, get_libc_err},
+    },
     demikernel::config::Config,
     expect_ok, expect_some,
     runtime::{
@@ -30,9 +34,8 @@ use crate::{
 };
 use ::futures::FutureExt;
 use ::slab::Slab;
-use ::socket2::{Domain, Protocol, Socket, Type};
+use ::socket2::{Domain, Socket, Type};
 use ::std::{
-    io,
     net::{Shutdown, SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
     os::fd::{AsRawFd, RawFd},
@@ -89,10 +92,7 @@ impl SharedCatnapTransport {
             options: TcpSocketOptions::new(config)?,
         }));
         let mut me2: Self = me.clone();
-        runtime.insert_background_coroutine(
-            "bgc::catnap::transport::epoll",
-            Box::pin(async move { me2.poll().await }.fuse()),
-        )?;
+        runtime.insert_background_coroutine("bgc::catnap::transport::epoll", async move { me2.poll().await }.fuse())?;
         Ok(me)
     }
 
@@ -220,15 +220,6 @@ impl SharedCatnapTransport {
     }
 }
 
-//======================================================================================================================
-// Standalone functions
-//======================================================================================================================
-
-/// Internal function to extract the raw OS error code.
-fn get_libc_err(e: io::Error) -> i32 {
-    expect_some!(e.raw_os_error(), "should have an os error code")
-}
-
 //======================================================================================================================
 // Trait implementation
 //======================================================================================================================
@@ -255,68 +246,7 @@ impl NetworkTransport for SharedCatnapTransport {
     /// Creates a new socket on the underlying network transport. We only support IPv4 and UDP and TCP sockets for now.
     fn socket(&mut self, domain: Domain, typ: Type) -> Result<Self::SocketDescriptor, Fail> {
         timer!("catnap::linux::transport::socket");
-        // Select protocol.
-        let protocol: Protocol = match typ {
-            Type::STREAM => Protocol::TCP,
-            Type::DGRAM => Protocol::UDP,
-            _ => {
-                let cause: String = format!("socket type not supported: {:?}", typ);
-                error!("socket(): {}", cause);
-                return Err(Fail::new(libc::ENOTSUP, &cause));
-            },
-        };
-
-        // Attempts to shutdown a socket. If we fail, log a warn message and do not overwrite the original error.
-        let attempt_shutdown = |socket: Socket| {
-            if let Err(e) = socket.shutdown(Shutdown::Both) {
-                let cause: String = format!("cannot shutdown socket: {:?}", e);
-                warn!("socket(): {}", cause);
-            }
-        };
-
-        // Create socket.
-        let socket: Socket = match socket2::Socket::new(domain, typ, Some(protocol)) {
-            Ok(socket) => {
-                // Set socket options.
-                if let Err(e) = socket.set_reuse_address(true) {
-                    let cause: String = format!("cannot set REUSE_ADDRESS option: {:?}", e);
-                    let errno: i32 = get_libc_err(e);
-                    error!("socket(): {}", cause);
-                    attempt_shutdown(socket);
-                    return Err(Fail::new(errno, &cause));
-                }
-
-                let socket_fd = socket.as_raw_fd();
-                let flags = unsafe { libc::fcntl(socket_fd, libc::F_GETFL) };
-                if flags & libc::O_NONBLOCK == 0 {
-                    if let Err(e) = socket.set_nonblocking(true) {
-                        let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
-                        let errno: i32 = get_libc_err(e);
-                        error!("socket(): {}", cause);
-                        attempt_shutdown(socket);
-                        return Err(Fail::new(errno, &cause));
-                    }
-                }
-
-                // Set TCP socket options
-                if typ == Type::STREAM {
-                    if let Err(e) = socket.set_nodelay(self.options.get_nodelay()) {
-                        let cause: String = format!("cannot set TCP_NODELAY option: {:?}", e);
-                        let errno: i32 = get_libc_err(e);
-                        error!("socket(): {}", cause);
-                        attempt_shutdown(socket);
-                        return Err(Fail::new(errno, &cause));
-                    }
-                }
-
-                socket
-            },
-            Err(e) => {
-                let cause: String = format!("failed to create socket: {:?}", e);
-                error!("{}", cause);
-                return Err(Fail::new(get_libc_err(e), &cause));
-            },
-        };
+        let socket: Socket = socket_ops::new_socket(domain, typ, &self.options)?;
         let sd: Self::SocketDescriptor = match typ {
             Type::STREAM => self.socket_table.insert(SharedSocketData::new_inactive(socket)),
             Type::DGRAM => {
@@ -331,40 +261,7 @@ impl NetworkTransport for SharedCatnapTransport {
 
     /// Set an SO_* option on the socket.
     fn set_socket_option(&mut self, sd: &mut Self::SocketDescriptor, option: SocketOption) -> Result<(), Fail> {
-        trace!("Set socket option to {:?}", option);
-        let socket: &mut Socket = self.socket_from_sd(sd);
-        match option {
-            SocketOption::Linger(linger) => {
-                if let Err(e) = socket.set_linger(linger) {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_LINGER failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                } else {
-                    Ok(())
-                }
-            },
-            SocketOption::KeepAlive(alive) => {
-                if let Err(e) = socket.set_keepalive(alive) {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_KEEPALIVE failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                } else {
-                    Ok(())
-                }
-            },
-            SocketOption::NoDelay(nagle_off) => {
-                if let Err(e) = socket.set_nodelay(nagle_off) {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_TCP_NO_DELAY failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                } else {
-                    Ok(())
-                }
-            },
-        }
+        socket_ops::set_socket_option(self.socket_from_sd(sd), option)
     }
 
     /// Gets an SO_* option on the socket. The option should be passed in as [option] and the value returned is either
@@ -374,92 +271,18 @@ impl NetworkTransport for SharedCatnapTransport {
         sd: &mut Self::SocketDescriptor,
         option: SocketOption,
     ) -> Result<SocketOption, Fail> {
-        trace!("Set socket option to {:?}", option);
-        let socket: &mut Socket = self.socket_from_sd(sd);
-        match option {
-            SocketOption::Linger(_) => match socket.linger() {
-                Ok(linger) => Ok(SocketOption::Linger(linger)),
-                Err(e) => {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_LINGER failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                },
-            },
-            SocketOption::KeepAlive(_) => match socket.keepalive() {
-                Ok(keepalive) => Ok(SocketOption::KeepAlive(keepalive)),
-                Err(e) => {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_KEEPALIVE failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                },
-            },
-            SocketOption::NoDelay(_) => match socket.nodelay() {
-                Ok(nagle_off) => Ok(SocketOption::NoDelay(nagle_off)),
-                Err(e) => {
-                    let errno: i32 = get_libc_err(e);
-                    let cause: String = format!("SO_TCP_NO_DELAY failed: {:?}", errno);
-                    error!("set_socket_option(): {}", cause);
-                    Err(Fail::new(errno, &cause))
-                },
-            },
-        }
+        socket_ops::get_socket_option(self.socket_from_sd(sd), option)
     }
 
     // Gets peer name of connected socket.
     fn getpeername(&mut self, sd: &mut Self::SocketDescriptor) -> Result<SocketAddrV4, Fail> {
-        let socket: &mut Socket = self.socket_from_sd(sd);
-        match socket.peer_addr() {
-            Ok(addr) => match addr.as_socket_ipv4() {
-                Some(ipv4_addr) => Ok(ipv4_addr),
-                None => {
-                    let cause: String = format!("invalid IPv4 address");
-                    error!("getpeername(): {}", cause);
-                    Err(Fail::new(libc::EINVAL, &cause))
-                },
-            },
-            Err(e) => {
-                let errno: i32 = get_libc_err(e);
-                let cause: String = format!("failed to get peer name (errno={:?})", errno);
-                error!("getpeername(): {}", cause);
-                Err(Fail::new(errno, &cause))
-            },
-        }
+        socket_ops::getpeername(self.socket_from_sd(sd))
     }
 
     /// Binds a socket to [local] on the underlying network transport.
     fn bind(&mut self, sd: &mut Self::SocketDescriptor, local: SocketAddr) -> Result<(), Fail> {
         timer!("catnap::linux::transport::bind");
-        trace!("Bind to {:?}", local);
-        let socket: &mut Socket = self.socket_from_sd(sd);
-
-        // Set SO_REUSE_PORT.
-        let optval: libc::c_int = 1;
-        let optval_len: libc::socklen_t = std::mem::size_of_val(&optval) as libc::socklen_t;
-        if unsafe {
-            libc::setsockopt(
-                socket.as_raw_fd(),
-                libc::SOL_SOCKET,
-                libc::SO_REUSEPORT,
-                &optval as *const _ as *const libc::c_void,
-                optval_len,
-            )
-        } < 0
-        {
-            let e: i32 = get_libc_err(io::Error::last_os_error());
-            let cause: String = format!("failed to bind socket: {:?}", e);
-            error!("bind(): {}", cause);
-            return Err(Fail::new(e, &cause));
-        }
-
-        if let Err(e) = socket.bind(&local.into()) {
-            let cause: String = format!("failed to bind socket: {:?}", e);
-            error!("bind(): {}", cause);
-            Err(Fail::new(get_libc_err(e), &cause))
-        } else {
-            Ok(())
-        }
+        socket_ops::bind(self.socket_from_sd(sd), local)
     }
 
     /// Sets a socket to passive listening on the underlying transport and registers it to accept incoming connections
@@ -485,25 +308,7 @@ impl NetworkTransport for SharedCatnapTransport {
     async fn accept(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(Self::SocketDescriptor, SocketAddr), Fail> {
         timer!("catnap::linux::transport::accept");
         let (new_socket, addr) = self.data_from_sd(sd).accept().await?;
-        // Set socket options.
-        if let Err(e) = new_socket.set_reuse_address(true) {
-            let cause: String = format!("cannot set REUSE_ADDRESS option: {:?}", e);
-            new_socket.shutdown(Shutdown::Both)?;
-            error!("accept(): {}", cause);
-            return Err(Fail::new(get_libc_err(e), &cause));
-        }
-        if let Err(e) = new_socket.set_nodelay(true) {
-            let cause: String = format!("cannot set TCP_NODELAY option: {:?}", e);
-            new_socket.shutdown(Shutdown::Both)?;
-            error!("accept(): {}", cause);
-            return Err(Fail::new(get_libc_err(e), &cause));
-        }
-        if let Err(e) = new_socket.set_nonblocking(true) {
-            let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
-            self.socket_from_sd(sd).shutdown(Shutdown::Both)?;
-            error!("accept(): {}", cause);
-            return Err(Fail::new(get_libc_err(e), &cause));
-        }
+        socket_ops::set_accepted_socket_options(&new_socket)?;
 
         let new_data: SharedSocketData = SharedSocketData::new_active(new_socket);
         let new_sd: usize = self.socket_table.insert(new_data);
@@ -580,12 +385,27 @@ impl NetworkTransport for SharedCatnapTransport {
         timer!("catnap::linux::transport::push");
         {
             self.data_from_sd(sd).push(addr, buf.clone()).await?;
-            // Clear out the original buffer.
+            // Clear out the original buffer, which may be a chain.
+            let _: Option<DemiBuffer> = buf.detach_tail();
             expect_ok!(buf.trim(buf.len()), "Should be able to empty the buffer");
             Ok(())
         }
     }
 
+    /// Push a range of a file to the underlying transport with sendfile(), so the data goes from the page cache to
+    /// the socket without passing through user space. This function blocks until the entire range has been written to
+    /// the socket.
+    async fn push_file(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        fd: libc::c_int,
+        offset: u64,
+        len: usize,
+    ) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::push_file");
+        self.data_from_sd(sd).push_file(fd, offset, len).await
+    }
+
     /// Pop a [buf] of at most [size] from the underlying transport. This function blocks until the socket has data to
     /// be read. For connected (i.e., TCP) sockets, this function returns Ok(None). For datagram (i.e., UDP) sockets,
     /// this function returns the remote address that is the source of the incoming data.
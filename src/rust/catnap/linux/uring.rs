@@ -0,0 +1,811 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Minimal io_uring bindings for the completion-based Catnap transport. We only wrap what the transport uses: the
+//! submission and completion rings, a sparse table of registered files and one ring of provided receive buffers.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::{
+    fail::Fail,
+    memory::{BufferPool, DemiBuffer},
+};
+use ::std::{
+    mem::{self, MaybeUninit},
+    num::NonZeroUsize,
+    ptr::{self, NonNull},
+    rc::Rc,
+    sync::atomic::{self, AtomicU16, AtomicU32, Ordering},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Offsets for mapping the rings, as in `linux/io_uring.h`.
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_CQ_RING: libc::off_t = 0x8000000;
+const IORING_OFF_SQES: libc::off_t = 0x10000000;
+
+/// Setup flags.
+const IORING_SETUP_SQPOLL: u32 = 1 << 1;
+
+/// Features reported by the kernel.
+const IORING_FEAT_SINGLE_MMAP: u32 = 1 << 0;
+
+/// Flags for `io_uring_enter()`.
+const IORING_ENTER_GETEVENTS: u32 = 1 << 0;
+const IORING_ENTER_SQ_WAKEUP: u32 = 1 << 1;
+
+/// Flags that the kernel sets in the submission ring.
+const IORING_SQ_NEED_WAKEUP: u32 = 1 << 0;
+
+/// Opcodes for `io_uring_register()`.
+const IORING_REGISTER_FILES: libc::c_uint = 2;
+const IORING_REGISTER_FILES_UPDATE: libc::c_uint = 6;
+const IORING_REGISTER_PBUF_RING: libc::c_uint = 22;
+
+/// Submission flags.
+pub const IOSQE_FIXED_FILE: u8 = 1 << 0;
+pub const IOSQE_BUFFER_SELECT: u8 = 1 << 5;
+
+/// Opcodes of the operations that we submit.
+pub const IORING_OP_SENDMSG: u8 = 9;
+pub const IORING_OP_RECVMSG: u8 = 10;
+pub const IORING_OP_ACCEPT: u8 = 13;
+pub const IORING_OP_ASYNC_CANCEL: u8 = 14;
+pub const IORING_OP_CONNECT: u8 = 16;
+pub const IORING_OP_SEND: u8 = 26;
+pub const IORING_OP_RECV: u8 = 27;
+
+/// Operation-specific flags, which go in the `ioprio` field.
+pub const IORING_RECV_MULTISHOT: u16 = 1 << 1;
+pub const IORING_ACCEPT_MULTISHOT: u16 = 1 << 0;
+
+/// Completion flags.
+pub const IORING_CQE_F_BUFFER: u32 = 1 << 0;
+pub const IORING_CQE_F_MORE: u32 = 1 << 1;
+const IORING_CQE_BUFFER_SHIFT: u32 = 16;
+
+/// Granularity at which we map memory.
+const PAGE_SIZE: usize = 4096;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Offsets of the submission ring fields (`struct io_sqring_offsets`).
+#[repr(C)]
+#[derive(Default)]
+struct SqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// Offsets of the completion ring fields (`struct io_cqring_offsets`).
+#[repr(C)]
+#[derive(Default)]
+struct CqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// Ring parameters (`struct io_uring_params`).
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqRingOffsets,
+    cq_off: CqRingOffsets,
+}
+
+/// Submission queue entry (`struct io_uring_sqe`).
+#[repr(C)]
+#[derive(Default)]
+pub struct Sqe {
+    pub opcode: u8,
+    pub flags: u8,
+    pub ioprio: u16,
+    pub fd: i32,
+    pub off: u64,
+    pub addr: u64,
+    pub len: u32,
+    pub op_flags: u32,
+    pub user_data: u64,
+    pub buf_group: u16,
+    pub personality: u16,
+    pub file_index: i32,
+    pub addr3: u64,
+    pad: u64,
+}
+
+/// Completion queue entry (`struct io_uring_cqe`).
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct Cqe {
+    pub user_data: u64,
+    pub res: i32,
+    pub flags: u32,
+}
+
+/// Argument of `IORING_REGISTER_FILES_UPDATE` (`struct io_uring_files_update`).
+#[repr(C)]
+struct FilesUpdate {
+    offset: u32,
+    resv: u32,
+    fds: u64,
+}
+
+/// Argument of `IORING_REGISTER_PBUF_RING` (`struct io_uring_buf_reg`).
+#[repr(C)]
+struct BufReg {
+    ring_addr: u64,
+    ring_entries: u32,
+    bgid: u16,
+    flags: u16,
+    resv: [u64; 3],
+}
+
+/// Entry of a provided buffer ring (`struct io_uring_buf`). The kernel reads the tail of the ring from the `resv`
+/// field of the first entry.
+#[repr(C)]
+struct Buf {
+    addr: u64,
+    len: u32,
+    bid: u16,
+    resv: u16,
+}
+
+/// A memory mapping that is unmapped when dropped.
+struct Mmap {
+    addr: *mut libc::c_void,
+    len: usize,
+}
+
+/// An io_uring instance.
+pub struct IoUring {
+    fd: libc::c_int,
+    sqpoll: bool,
+    /// Mappings of the rings, which we only hold on to so that they are unmapped on drop.
+    _sq_ring: Mmap,
+    _cq_ring: Option<Mmap>,
+    sqes: Mmap,
+    sq_head: *const AtomicU32,
+    sq_tail: *const AtomicU32,
+    sq_flags: *const AtomicU32,
+    sq_mask: u32,
+    sq_entries: u32,
+    sq_array: *mut u32,
+    cq_head: *const AtomicU32,
+    cq_tail: *const AtomicU32,
+    cq_mask: u32,
+    cqes: *const Cqe,
+    /// Tail of the entries that we have filled in but not yet published to the kernel.
+    sqe_tail: u32,
+    /// Number of entries that were published but not yet consumed by an `io_uring_enter()`.
+    to_submit: u32,
+}
+
+/// A ring of receive buffers that the kernel picks from for operations with `IOSQE_BUFFER_SELECT`. Each entry of the
+/// ring is a [DemiBuffer] of a pool that lives in memory that we map once, so the kernel receives straight into buffers
+/// that we then hand to the application, without copying them. Buffers go back to the pool when the application
+/// releases them, and we hand them to the kernel again with [refill](Self::refill). The pool has more buffers than the
+/// ring has entries, so that the kernel can keep receiving while the application holds on to some data.
+pub struct BufferRing {
+    ring: Mmap,
+    /// Memory of the buffers, which we only unmap once no buffer references it anymore.
+    region: Option<Mmap>,
+    pool: BufferPool,
+    /// Buffer that the kernel may receive into for each buffer identifier, if any.
+    slots: Vec<Option<DemiBuffer>>,
+    /// Buffer identifiers that are waiting for a buffer from the pool.
+    empty: Vec<u16>,
+    mask: u16,
+    tail: u16,
+    bgid: u16,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl IoUring {
+    /// Creates an io_uring with room for `entries` submissions. With `sqpoll`, a kernel thread polls the submission
+    /// ring, so that submitting does not take a system call while the thread is awake; it goes to sleep after
+    /// `sqpoll_idle_ms` without work.
+    pub fn new(entries: u32, sqpoll: bool, sqpoll_idle_ms: u32) -> Result<Self, Fail> {
+        let mut params: Params = Params::default();
+        if sqpoll {
+            params.flags |= IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = sqpoll_idle_ms;
+        }
+
+        let fd: libc::c_int = match unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_setup,
+                entries as libc::c_long,
+                &mut params as *mut Params,
+            )
+        } {
+            fd if fd >= 0 => fd as libc::c_int,
+            _ => return Err(last_fail("io_uring_setup")),
+        };
+
+        // Map the rings. Recent kernels share one mapping for both.
+        let sq_len: usize = params.sq_off.array as usize + params.sq_entries as usize * mem::size_of::<u32>();
+        let cq_len: usize = params.cq_off.cqes as usize + params.cq_entries as usize * mem::size_of::<Cqe>();
+        let single_mmap: bool = params.features & IORING_FEAT_SINGLE_MMAP != 0;
+        let sq_ring: Mmap = match Mmap::new(
+            fd,
+            if single_mmap { sq_len.max(cq_len) } else { sq_len },
+            IORING_OFF_SQ_RING,
+        ) {
+            Ok(mmap) => mmap,
+            Err(e) => {
+                unsafe { libc::close(fd) };
+                return Err(e);
+            },
+        };
+        let cq_ring: Option<Mmap> = if single_mmap {
+            None
+        } else {
+            match Mmap::new(fd, cq_len, IORING_OFF_CQ_RING) {
+                Ok(mmap) => Some(mmap),
+                Err(e) => {
+                    unsafe { libc::close(fd) };
+                    return Err(e);
+                },
+            }
+        };
+        let sqes: Mmap = match Mmap::new(fd, params.sq_entries as usize * mem::size_of::<Sqe>(), IORING_OFF_SQES) {
+            Ok(mmap) => mmap,
+            Err(e) => {
+                unsafe { libc::close(fd) };
+                return Err(e);
+            },
+        };
+
+        let sq_base: *mut u8 = sq_ring.addr as *mut u8;
+        let cq_base: *mut u8 = match cq_ring {
+            Some(ref mmap) => mmap.addr as *mut u8,
+            None => sq_base,
+        };
+
+        unsafe {
+            Ok(Self {
+                fd,
+                sqpoll,
+                sq_head: sq_base.add(params.sq_off.head as usize) as *const AtomicU32,
+                sq_tail: sq_base.add(params.sq_off.tail as usize) as *const AtomicU32,
+                sq_flags: sq_base.add(params.sq_off.flags as usize) as *const AtomicU32,
+                sq_mask: *(sq_base.add(params.sq_off.ring_mask as usize) as *const u32),
+                sq_entries: *(sq_base.add(params.sq_off.ring_entries as usize) as *const u32),
+                sq_array: sq_base.add(params.sq_off.array as usize) as *mut u32,
+                cq_head: cq_base.add(params.cq_off.head as usize) as *const AtomicU32,
+                cq_tail: cq_base.add(params.cq_off.tail as usize) as *const AtomicU32,
+                cq_mask: *(cq_base.add(params.cq_off.ring_mask as usize) as *const u32),
+                cqes: cq_base.add(params.cq_off.cqes as usize) as *const Cqe,
+                sqe_tail: (*(sq_base.add(params.sq_off.tail as usize) as *const AtomicU32)).load(Ordering::Relaxed),
+                to_submit: 0,
+                _sq_ring: sq_ring,
+                _cq_ring: cq_ring,
+                sqes,
+            })
+        }
+    }
+
+    /// Returns a cleared submission queue entry, or `None` if the submission ring is full. The entry is handed to the
+    /// kernel on the next call to `submit()`.
+    pub fn get_sqe(&mut self) -> Option<&mut Sqe> {
+        let head: u32 = unsafe { (*self.sq_head).load(Ordering::Acquire) };
+        if self.sqe_tail.wrapping_sub(head) >= self.sq_entries {
+            return None;
+        }
+        let index: u32 = self.sqe_tail & self.sq_mask;
+        self.sqe_tail = self.sqe_tail.wrapping_add(1);
+        unsafe {
+            *self.sq_array.add(index as usize) = index;
+            let sqe: &mut Sqe = &mut *(self.sqes.addr as *mut Sqe).add(index as usize);
+            *sqe = Sqe::default();
+            Some(sqe)
+        }
+    }
+
+    /// Returns the number of entries that `get_sqe()` can hand out before the next call to `submit()`.
+    pub fn sq_space_left(&self) -> u32 {
+        let head: u32 = unsafe { (*self.sq_head).load(Ordering::Acquire) };
+        self.sq_entries - self.sqe_tail.wrapping_sub(head)
+    }
+
+    /// Publishes all entries that were filled in since the last call and tells the kernel about them with a single
+    /// system call. With `get_events`, the call also runs pending completion work, so that completions become visible.
+    /// Returns the number of entries that the kernel consumed.
+    pub fn submit(&mut self, get_events: bool) -> Result<usize, Fail> {
+        let tail: u32 = unsafe { (*self.sq_tail).load(Ordering::Relaxed) };
+        self.to_submit += self.sqe_tail.wrapping_sub(tail);
+        unsafe { (*self.sq_tail).store(self.sqe_tail, Ordering::Release) };
+
+        let mut flags: u32 = 0;
+        if self.sqpoll {
+            // The kernel thread picks entries up on its own unless it has gone to sleep.
+            atomic::fence(Ordering::SeqCst);
+            if unsafe { (*self.sq_flags).load(Ordering::Relaxed) } & IORING_SQ_NEED_WAKEUP != 0 {
+                flags |= IORING_ENTER_SQ_WAKEUP;
+            }
+            let submitted: usize = self.to_submit as usize;
+            self.to_submit = 0;
+            if flags == 0 && !get_events {
+                return Ok(submitted);
+            }
+        } else if self.to_submit == 0 && !get_events {
+            return Ok(0);
+        }
+        if get_events {
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+
+        let to_submit: u32 = if self.sqpoll { 0 } else { self.to_submit };
+        match unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_enter,
+                self.fd as libc::c_long,
+                to_submit as libc::c_long,
+                0 as libc::c_long,
+                flags as libc::c_long,
+                ptr::null::<libc::sigset_t>(),
+                0 as libc::c_long,
+            )
+        } {
+            n if n >= 0 => {
+                if !self.sqpoll {
+                    self.to_submit -= n as u32;
+                }
+                Ok(n as usize)
+            },
+            _ => {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                if errno == libc::EINTR || errno == libc::EAGAIN || errno == libc::EBUSY {
+                    // The kernel is short on resources; we will try again on the next pass.
+                    return Ok(0);
+                }
+                Err(last_fail("io_uring_enter"))
+            },
+        }
+    }
+
+    /// Removes the next completion from the completion ring.
+    pub fn pop_cqe(&mut self) -> Option<Cqe> {
+        unsafe {
+            let head: u32 = (*self.cq_head).load(Ordering::Relaxed);
+            if head == (*self.cq_tail).load(Ordering::Acquire) {
+                return None;
+            }
+            let cqe: Cqe = *self.cqes.add((head & self.cq_mask) as usize);
+            (*self.cq_head).store(head.wrapping_add(1), Ordering::Release);
+            Some(cqe)
+        }
+    }
+
+    /// Registers a table of `nr_files` empty file slots. Slots are filled in with `update_file()` and are addressed
+    /// through `IOSQE_FIXED_FILE`, which spares the kernel a file table lookup on every operation.
+    pub fn register_files(&mut self, nr_files: u32) -> Result<(), Fail> {
+        let fds: Vec<i32> = vec![-1; nr_files as usize];
+        self.register(IORING_REGISTER_FILES, fds.as_ptr() as *const libc::c_void, nr_files)
+    }
+
+    /// Points a registered file slot to `fd`, or clears it when `fd` is -1.
+    pub fn update_file(&mut self, index: u32, fd: i32) -> Result<(), Fail> {
+        let update: FilesUpdate = FilesUpdate {
+            offset: index,
+            resv: 0,
+            fds: &fd as *const i32 as u64,
+        };
+        self.register(
+            IORING_REGISTER_FILES_UPDATE,
+            &update as *const FilesUpdate as *const libc::c_void,
+            1,
+        )
+    }
+
+    /// Internal function to issue an `io_uring_register()` system call.
+    fn register(&mut self, opcode: libc::c_uint, arg: *const libc::c_void, nr_args: u32) -> Result<(), Fail> {
+        match unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_register,
+                self.fd as libc::c_long,
+                opcode as libc::c_long,
+                arg,
+                nr_args as libc::c_long,
+            )
+        } {
+            n if n >= 0 => Ok(()),
+            _ => Err(last_fail("io_uring_register")),
+        }
+    }
+}
+
+impl BufferRing {
+    /// Size of a buffer along with its metadata. Buffers are an exact number of pages, so that they pack without gaps.
+    pub const FRAME_SIZE: usize = 2 * PAGE_SIZE;
+    /// Number of bytes that the kernel may receive into each buffer.
+    pub const DATA_SIZE: usize = Self::FRAME_SIZE - BufferPool::METADATA_SIZE;
+
+    /// Creates a ring of `nr_buffers` receive buffers and registers it with `ring` as buffer group `bgid`. The number
+    /// of buffers must be a power of two.
+    pub fn new(ring: &mut IoUring, nr_buffers: u16, bgid: u16) -> Result<Self, Fail> {
+        if !nr_buffers.is_power_of_two() {
+            let cause: String = format!("number of receive buffers must be a power of two (nr={:?})", nr_buffers);
+            error!("BufferRing::new(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let nr_frames: usize = 2 * nr_buffers as usize;
+        let region: Mmap = Mmap::anonymous(nr_frames * Self::FRAME_SIZE)?;
+        let pool: BufferPool = match BufferPool::new(Self::DATA_SIZE as u16) {
+            Ok(pool) => pool,
+            Err(_) => return Err(Fail::new(libc::EINVAL, "invalid receive buffer layout")),
+        };
+        // Safety: the region outlives the pool, as we only unmap it once nothing references the pool anymore.
+        unsafe {
+            pool.pool().populate(
+                NonNull::slice_from_raw_parts(NonNull::new_unchecked(region.addr as *mut MaybeUninit<u8>), region.len),
+                NonZeroUsize::new(PAGE_SIZE).unwrap(),
+            )?
+        };
+
+        let mut me: Self = Self {
+            ring: Mmap::anonymous(nr_buffers as usize * mem::size_of::<Buf>())?,
+            region: Some(region),
+            pool,
+            slots: (0..nr_buffers).map(|_| None).collect(),
+            empty: (0..nr_buffers).rev().collect(),
+            mask: nr_buffers - 1,
+            tail: 0,
+            bgid,
+        };
+
+        let reg: BufReg = BufReg {
+            ring_addr: me.ring.addr as u64,
+            ring_entries: nr_buffers as u32,
+            bgid,
+            flags: 0,
+            resv: [0; 3],
+        };
+        ring.register(
+            IORING_REGISTER_PBUF_RING,
+            &reg as *const BufReg as *const libc::c_void,
+            1,
+        )?;
+
+        me.refill();
+        Ok(me)
+    }
+
+    /// Returns the buffer group of this ring.
+    pub fn bgid(&self) -> u16 {
+        self.bgid
+    }
+
+    /// Takes the buffer that the kernel picked for a completion, trimmed to the `len` bytes that it received. The
+    /// identifier is handed back to the kernel on the next call to [refill](Self::refill).
+    pub fn take(&mut self, bid: u16, len: usize) -> Option<DemiBuffer> {
+        let mut buf: DemiBuffer = self.slots.get_mut(bid as usize)?.take()?;
+        self.empty.push(bid);
+        let excess: usize = buf.len() - len.min(buf.len());
+        if buf.trim(excess).is_err() {
+            return None;
+        }
+        Some(buf)
+    }
+
+    /// Returns whether the kernel has any buffer to receive into.
+    pub fn has_buffers(&self) -> bool {
+        self.empty.len() < self.slots.len()
+    }
+
+    /// Returns whether some buffer identifiers wait for a buffer.
+    pub fn needs_refill(&self) -> bool {
+        !self.empty.is_empty()
+    }
+
+    /// Hands free buffers of the pool to the kernel, for as many buffer identifiers as the kernel consumed. Returns
+    /// whether any buffer was handed over.
+    pub fn refill(&mut self) -> bool {
+        let mut refilled: bool = false;
+        while let Some(&bid) = self.empty.last() {
+            let buf: DemiBuffer = match DemiBuffer::new_in_pool(&self.pool) {
+                Some(buf) => buf,
+                // The application still holds all other buffers.
+                None => break,
+            };
+            self.empty.pop();
+            unsafe {
+                let entries: *mut Buf = self.ring.addr as *mut Buf;
+                let entry: &mut Buf = &mut *entries.add((self.tail & self.mask) as usize);
+                entry.addr = buf.as_ptr() as u64;
+                entry.len = buf.len() as u32;
+                entry.bid = bid;
+            }
+            self.slots[bid as usize] = Some(buf);
+            self.tail = self.tail.wrapping_add(1);
+            refilled = true;
+        }
+        if refilled {
+            // The tail aliases the reserved field of the first entry.
+            unsafe {
+                let entries: *mut Buf = self.ring.addr as *mut Buf;
+                (*(ptr::addr_of_mut!((*entries).resv) as *const AtomicU16)).store(self.tail, Ordering::Release);
+            }
+        }
+        refilled
+    }
+}
+
+impl Cqe {
+    /// Returns the identifier of the provided buffer that was consumed by this completion, if any.
+    pub fn buffer_id(&self) -> Option<u16> {
+        if self.flags & IORING_CQE_F_BUFFER != 0 {
+            Some((self.flags >> IORING_CQE_BUFFER_SHIFT) as u16)
+        } else {
+            None
+        }
+    }
+
+    /// Returns whether a multishot operation stays armed after this completion.
+    pub fn has_more(&self) -> bool {
+        self.flags & IORING_CQE_F_MORE != 0
+    }
+}
+
+impl Mmap {
+    /// Maps a region of an io_uring instance.
+    fn new(fd: libc::c_int, len: usize, offset: libc::off_t) -> Result<Self, Fail> {
+        Self::map(fd, len, offset, libc::MAP_SHARED | libc::MAP_POPULATE)
+    }
+
+    /// Maps zeroed, page-aligned memory that is shared with the kernel.
+    fn anonymous(len: usize) -> Result<Self, Fail> {
+        Self::map(-1, len, 0, libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_POPULATE)
+    }
+
+    /// Internal function to create a memory mapping.
+    fn map(fd: libc::c_int, len: usize, offset: libc::off_t, flags: libc::c_int) -> Result<Self, Fail> {
+        match unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                flags,
+                fd,
+                offset,
+            )
+        } {
+            libc::MAP_FAILED => Err(last_fail("mmap")),
+            addr => Ok(Self { addr, len }),
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Internal function to turn the errno of a failed system call into a failure.
+fn last_fail(syscall: &str) -> Fail {
+    let errno: libc::c_int = unsafe { *libc::__errno_location() };
+    let cause: String = format!("{} failed (errno={:?})", syscall, errno);
+    error!("{}", cause);
+    Fail::new(errno, &cause)
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        if unsafe { libc::munmap(self.addr, self.len) } != 0 {
+            warn!("failed to unmap io_uring memory");
+        }
+    }
+}
+
+impl Drop for BufferRing {
+    fn drop(&mut self) {
+        // The buffers that the kernel could still receive into are ours, but the application may hold on to others,
+        // in which case we leave their memory mapped.
+        self.slots.clear();
+        if Rc::strong_count(self.pool.pool()) > 1 {
+            warn!("receive buffers are still in use, leaving their memory mapped");
+            mem::forget(self.region.take());
+        }
+    }
+}
+
+impl Drop for IoUring {
+    fn drop(&mut self) {
+        if unsafe { libc::close(self.fd) } != 0 {
+            warn!("failed to close io_uring");
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{BufferRing, Cqe, IoUring, Sqe, IORING_OP_RECV, IORING_OP_SEND, IOSQE_BUFFER_SELECT};
+    use crate::runtime::memory::DemiBuffer;
+    use ::anyhow::Result;
+    use ::std::{
+        io::{Read, Write},
+        os::{fd::AsRawFd, unix::net::UnixStream},
+    };
+
+    /// Opcode of an operation that does nothing.
+    const IORING_OP_NOP: u8 = 0;
+
+    /// Buffer group that the tests register.
+    const BGID: u16 = 0;
+
+    /// Tests that entries that are queued together go to the kernel in one submission and each complete once.
+    #[test]
+    fn test_uring_submit_and_complete() -> Result<()> {
+        let mut ring: IoUring = IoUring::new(8, false, 0)?;
+        for user_data in 0..4 {
+            let sqe: &mut Sqe = crate::expect_some!(ring.get_sqe(), "ring should have room");
+            sqe.opcode = IORING_OP_NOP;
+            sqe.user_data = user_data;
+        }
+        crate::ensure_eq!(ring.sq_space_left(), 4);
+        crate::ensure_eq!(ring.submit(true)?, 4);
+        crate::ensure_eq!(ring.sq_space_left(), 8);
+
+        let mut completed: Vec<u64> = Vec::new();
+        while let Some(cqe) = ring.pop_cqe() {
+            crate::ensure_eq!(cqe.res, 0);
+            completed.push(cqe.user_data);
+        }
+        completed.sort();
+        crate::ensure_eq!(completed, vec![0, 1, 2, 3]);
+        // Nothing to submit and nothing left to complete.
+        crate::ensure_eq!(ring.submit(false)?, 0);
+        crate::ensure_eq!(ring.pop_cqe().is_none(), true);
+        Ok(())
+    }
+
+    /// Tests that the submission ring refuses entries once it is full, until they are submitted.
+    #[test]
+    fn test_uring_submission_ring_full() -> Result<()> {
+        let mut ring: IoUring = IoUring::new(4, false, 0)?;
+        for _ in 0..4 {
+            crate::ensure_eq!(ring.get_sqe().is_some(), true);
+        }
+        crate::ensure_eq!(ring.get_sqe().is_none(), true);
+        crate::ensure_eq!(ring.submit(true)?, 4);
+        crate::ensure_eq!(ring.get_sqe().is_some(), true);
+        Ok(())
+    }
+
+    /// Tests that a send goes out and that a receive lands in a buffer of the buffer ring, which we hand out as is.
+    #[test]
+    fn test_uring_send_and_recv_into_buffer_ring() -> Result<()> {
+        let mut ring: IoUring = IoUring::new(8, false, 0)?;
+        let mut buffers: BufferRing = BufferRing::new(&mut ring, 2, BGID)?;
+        let (local, mut remote): (UnixStream, UnixStream) = UnixStream::pair()?;
+
+        let data: &[u8] = b"hello";
+        let sqe: &mut Sqe = crate::expect_some!(ring.get_sqe(), "ring should have room");
+        sqe.opcode = IORING_OP_SEND;
+        sqe.fd = local.as_raw_fd();
+        sqe.addr = data.as_ptr() as u64;
+        sqe.len = data.len() as u32;
+        sqe.user_data = 1;
+        let cqe: Cqe = complete_one(&mut ring)?;
+        crate::ensure_eq!(cqe.user_data, 1);
+        crate::ensure_eq!(cqe.res, data.len() as i32);
+        let mut received: [u8; 5] = [0; 5];
+        remote.read_exact(&mut received)?;
+        crate::ensure_eq!(&received, data);
+
+        remote.write_all(data)?;
+        let cqe: Cqe = recv(&mut ring, &local, 2)?;
+        crate::ensure_eq!(cqe.res, data.len() as i32);
+        let bid: u16 = crate::expect_some!(cqe.buffer_id(), "kernel should have picked a buffer");
+        let buf: DemiBuffer = crate::expect_some!(buffers.take(bid, cqe.res as usize), "buffer should be in the ring");
+        crate::ensure_eq!(&buf[..], data);
+        Ok(())
+    }
+
+    /// Tests that receives fail with ENOBUFS while the application holds all buffers, and succeed again once it
+    /// releases one and the ring is refilled.
+    #[test]
+    fn test_uring_recv_without_buffers() -> Result<()> {
+        let mut ring: IoUring = IoUring::new(8, false, 0)?;
+        // One entry in the ring, backed by a pool of two buffers.
+        let mut buffers: BufferRing = BufferRing::new(&mut ring, 1, BGID)?;
+        let (local, mut remote): (UnixStream, UnixStream) = UnixStream::pair()?;
+
+        let mut held: Vec<DemiBuffer> = Vec::new();
+        for user_data in 0..2 {
+            remote.write_all(b"x")?;
+            let cqe: Cqe = recv(&mut ring, &local, user_data)?;
+            crate::ensure_eq!(cqe.res, 1);
+            let bid: u16 = crate::expect_some!(cqe.buffer_id(), "kernel should have picked a buffer");
+            held.push(crate::expect_some!(
+                buffers.take(bid, 1),
+                "buffer should be in the ring"
+            ));
+            crate::ensure_eq!(buffers.needs_refill(), true);
+            // The second refill finds the pool empty.
+            crate::ensure_eq!(buffers.refill(), user_data == 0);
+        }
+
+        remote.write_all(b"y")?;
+        let cqe: Cqe = recv(&mut ring, &local, 2)?;
+        crate::ensure_eq!(cqe.res, -libc::ENOBUFS);
+
+        held.pop();
+        crate::ensure_eq!(buffers.has_buffers(), false);
+        crate::ensure_eq!(buffers.refill(), true);
+        crate::ensure_eq!(buffers.needs_refill(), false);
+        crate::ensure_eq!(buffers.has_buffers(), true);
+        let cqe: Cqe = recv(&mut ring, &local, 3)?;
+        crate::ensure_eq!(cqe.res, 1);
+        let bid: u16 = crate::expect_some!(cqe.buffer_id(), "kernel should have picked a buffer");
+        let buf: DemiBuffer = crate::expect_some!(buffers.take(bid, 1), "buffer should be in the ring");
+        crate::ensure_eq!(&buf[..], b"y");
+        Ok(())
+    }
+
+    /// Submits a receive into the buffer ring and waits for its completion.
+    fn recv(ring: &mut IoUring, socket: &UnixStream, user_data: u64) -> Result<Cqe> {
+        let sqe: &mut Sqe = crate::expect_some!(ring.get_sqe(), "ring should have room");
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = socket.as_raw_fd();
+        sqe.flags |= IOSQE_BUFFER_SELECT;
+        sqe.buf_group = BGID;
+        sqe.user_data = user_data;
+        let cqe: Cqe = complete_one(ring)?;
+        crate::ensure_eq!(cqe.user_data, user_data);
+        Ok(cqe)
+    }
+
+    /// Submits what is queued and waits for the next completion.
+    fn complete_one(ring: &mut IoUring) -> Result<Cqe> {
+        ring.submit(true)?;
+        for _ in 0..1000 {
+            if let Some(cqe) = ring.pop_cqe() {
+                return Ok(cqe);
+            }
+            std::thread::sleep(std::time::Duration::from_millis(1));
+            ring.submit(true)?;
+        }
+        anyhow::bail!("operation did not complete")
+    }
+}
@@ -0,0 +1,858 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Completion-based Catnap transport on top of io_uring. Instead of waiting for readiness and then issuing a system
+//! call per operation, the transport queues submissions while coroutines run and hands them to the kernel with a
+//! single `io_uring_enter()` per scheduler pass. Listening and connected TCP sockets keep a multishot accept or
+//! receive armed, so that the kernel posts one completion per connection or segment without being asked again.
+
+//======================================================================================================================
+// Modules
+//======================================================================================================================
+
+mod socket_ops;
+mod uring;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catnap::transport::{
+        socket_ops::get_libc_err,
+        uring::{
+            BufferRing, Cqe, IoUring, Sqe, IORING_ACCEPT_MULTISHOT, IORING_OP_ACCEPT, IORING_OP_ASYNC_CANCEL,
+            IORING_OP_CONNECT, IORING_OP_RECV, IORING_OP_RECVMSG, IORING_OP_SEND, IORING_OP_SENDMSG,
+            IORING_RECV_MULTISHOT, IOSQE_BUFFER_SELECT, IOSQE_FIXED_FILE,
+        },
+    },
+    collections::{async_queue::AsyncQueue, async_value::SharedAsyncValue},
+    demikernel::config::Config,
+    expect_ok, expect_some,
+    runtime::{
+        fail::Fail,
+        limits,
+        memory::{DemiBuffer, MemoryRuntime},
+        network::{
+            socket::option::{SocketOption, TcpSocketOptions},
+            transport::NetworkTransport,
+        },
+        poll_yield, SharedDemiRuntime, SharedObject,
+    },
+    timer,
+};
+use ::futures::FutureExt;
+use ::slab::Slab;
+use ::socket2::{Domain, SockAddr, Socket, Type};
+use ::std::{
+    cmp::min,
+    collections::VecDeque,
+    mem,
+    net::{Shutdown, SocketAddr, SocketAddrV4},
+    ops::{Deref, DerefMut},
+    os::fd::{AsRawFd, FromRawFd, RawFd},
+    ptr,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Buffer group of the provided receive buffers.
+const RECV_BUFFER_GROUP: u16 = 0;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Message header of a datagram operation. It is boxed, so that it stays put until the kernel is done with it.
+struct Message {
+    hdr: libc::msghdr,
+    iov: libc::iovec,
+    addr: libc::sockaddr_storage,
+}
+
+/// An outgoing buffer and the result that the pushing coroutine waits on.
+struct Outgoing {
+    addr: Option<SocketAddr>,
+    buf: DemiBuffer,
+    result: SharedAsyncValue<Option<Result<(), Fail>>>,
+}
+
+/// Operations that the kernel may still be working on.
+enum Operation {
+    /// Multishot accept on a listening socket.
+    Accept,
+    /// Multishot receive into the provided buffer ring on a connected socket.
+    Recv,
+    /// Receive of a single datagram into `buf`.
+    RecvMsg { msg: Box<Message>, buf: DemiBuffer },
+    /// Send of `outgoing.buf`. Datagrams carry the destination in `msg`.
+    Send {
+        outgoing: Outgoing,
+        msg: Option<Box<Message>>,
+    },
+    /// Connection establishment.
+    Connect {
+        addr: Box<SockAddr>,
+        result: SharedAsyncValue<Option<Result<(), Fail>>>,
+    },
+    /// Cancellation of another operation.
+    Cancel,
+}
+
+/// An operation in flight, keyed in the request table by the user data of its submission.
+struct Request {
+    /// Socket that the operation belongs to, or `None` once the socket was closed and we only wait for the kernel to
+    /// let go of the memory of the operation.
+    sd: Option<SockDesc>,
+    op: Operation,
+}
+
+/// Per-socket state.
+struct UringSocket {
+    socket: Socket,
+    typ: Type,
+    /// Set once the socket is listening for connections.
+    listening: bool,
+    /// Slot of the socket in the registered file table, if there was room for it.
+    fixed_file: Option<u32>,
+    /// Armed accept or receive operation.
+    armed: Option<u64>,
+    /// Send operation in flight. We only have one per socket, so that partial sends cannot reorder a byte stream.
+    sending: Option<u64>,
+    /// Connect operation in flight.
+    connecting: Option<u64>,
+    send_queue: VecDeque<Outgoing>,
+    recv_queue: AsyncQueue<Result<(Option<SocketAddr>, DemiBuffer), Fail>>,
+    accept_queue: AsyncQueue<Result<(Socket, SocketAddr), Fail>>,
+    /// Set once the peer shut down its side of the connection.
+    closed: bool,
+}
+
+/// Shared socket state across coroutines.
+#[derive(Clone)]
+struct SharedUringSocket(SharedObject<UringSocket>);
+
+/// Underlying network transport.
+pub struct CatnapTransport {
+    ring: IoUring,
+    recv_buffers: BufferRing,
+    /// Connected sockets whose receive stopped because the buffer ring ran dry. They are re-armed once the application
+    /// releases buffers, rather than right away, which would only fail again.
+    starved: Vec<SockDesc>,
+    nr_fixed_files: u32,
+    socket_table: Slab<SharedUringSocket>,
+    requests: Slab<Request>,
+    runtime: SharedDemiRuntime,
+    options: TcpSocketOptions,
+}
+
+/// Shared network transport across coroutines.
+#[derive(Clone)]
+pub struct SharedCatnapTransport(SharedObject<CatnapTransport>);
+
+/// Short-hand for our socket descriptor.
+type SockDesc = <SharedCatnapTransport as NetworkTransport>::SocketDescriptor;
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl Message {
+    /// Creates a message header that points to `buf` and, for sends, to the destination `addr`. Receives leave room
+    /// for the address of the sender.
+    fn new(buf: &DemiBuffer, addr: Option<SocketAddr>) -> Box<Self> {
+        let mut msg: Box<Self> = Box::new(unsafe { mem::zeroed() });
+        msg.iov = libc::iovec {
+            iov_base: buf.as_ptr() as *mut libc::c_void,
+            iov_len: buf.len(),
+        };
+        msg.hdr.msg_iov = &mut msg.iov;
+        msg.hdr.msg_iovlen = 1;
+        msg.hdr.msg_name = &mut msg.addr as *mut libc::sockaddr_storage as *mut libc::c_void;
+        msg.hdr.msg_namelen = match addr {
+            Some(addr) => {
+                let addr: SockAddr = addr.into();
+                unsafe {
+                    ptr::copy_nonoverlapping(
+                        addr.as_ptr() as *const u8,
+                        &mut msg.addr as *mut libc::sockaddr_storage as *mut u8,
+                        addr.len() as usize,
+                    )
+                };
+                addr.len()
+            },
+            None => mem::size_of::<libc::sockaddr_storage>() as libc::socklen_t,
+        };
+        msg
+    }
+
+    /// Returns the address that the kernel filled in on a receive.
+    fn addr(&self) -> Option<SocketAddr> {
+        unsafe { SockAddr::new(self.addr, self.hdr.msg_namelen) }.as_socket()
+    }
+}
+
+impl SharedUringSocket {
+    fn new(socket: Socket, typ: Type) -> Self {
+        Self(SharedObject::new(UringSocket {
+            socket,
+            typ,
+            listening: false,
+            fixed_file: None,
+            armed: None,
+            sending: None,
+            connecting: None,
+            send_queue: VecDeque::new(),
+            recv_queue: AsyncQueue::default(),
+            accept_queue: AsyncQueue::default(),
+            closed: false,
+        }))
+    }
+
+    /// Points a submission to this socket, through the registered file table if possible.
+    fn set_target(&self, sqe: &mut Sqe) {
+        match self.fixed_file {
+            Some(index) => {
+                sqe.fd = index as i32;
+                sqe.flags |= IOSQE_FIXED_FILE;
+            },
+            None => sqe.fd = self.socket.as_raw_fd(),
+        }
+    }
+}
+
+impl SharedCatnapTransport {
+    /// Create a new io_uring-based network transport.
+    pub fn new(config: &Config, runtime: &mut SharedDemiRuntime) -> Result<Self, Fail> {
+        let mut ring: IoUring = IoUring::new(
+            config.io_uring_entries()?,
+            config.io_uring_sqpoll()?,
+            config.io_uring_sqpoll_idle()?,
+        )?;
+        let nr_fixed_files: u32 = config.io_uring_fixed_files()?;
+        if nr_fixed_files > 0 {
+            ring.register_files(nr_fixed_files)?;
+        }
+        let recv_buffers: BufferRing = BufferRing::new(&mut ring, config.io_uring_recv_buffers()?, RECV_BUFFER_GROUP)?;
+
+        // Set up background task for submitting and completing operations.
+        let me: Self = Self(SharedObject::new(CatnapTransport {
+            ring,
+            recv_buffers,
+            starved: Vec::new(),
+            nr_fixed_files,
+            socket_table: Slab::<SharedUringSocket>::new(),
+            requests: Slab::<Request>::new(),
+            runtime: runtime.clone(),
+            options: TcpSocketOptions::new(config)?,
+        }));
+        let mut me2: Self = me.clone();
+        runtime.insert_background_coroutine("bgc::catnap::transport::uring", async move { me2.poll().await }.fuse())?;
+        Ok(me)
+    }
+
+    /// Background function that submits the operations queued since the last pass and processes their completions.
+    async fn poll(&mut self) {
+        loop {
+            if let Err(e) = self.ring.submit(false) {
+                error!("poll(): {:?}", e);
+                break;
+            }
+            while let Some(cqe) = self.ring.pop_cqe() {
+                self.complete(cqe);
+            }
+            // Hand the buffers that the application released back to the kernel, and resume the receives that ran out.
+            if self.recv_buffers.needs_refill() {
+                self.recv_buffers.refill();
+            }
+            if !self.starved.is_empty() && self.recv_buffers.has_buffers() {
+                for sd in mem::take(&mut self.starved) {
+                    self.rearm(sd, 0);
+                }
+            }
+            // Yield for one iteration.
+            poll_yield().await;
+        }
+    }
+
+    /// Inserts a socket in the socket table and in the registered file table.
+    fn insert_socket(&mut self, socket: Socket, typ: Type) -> Result<SockDesc, Fail> {
+        let fd: RawFd = socket.as_raw_fd();
+        let sd: SockDesc = self.socket_table.insert(SharedUringSocket::new(socket, typ));
+        if (sd as u32) < self.nr_fixed_files {
+            if let Err(e) = self.ring.update_file(sd as u32, fd) {
+                self.socket_table.remove(sd);
+                return Err(e);
+            }
+            self.socket_from_sd(&sd).fixed_file = Some(sd as u32);
+        }
+        Ok(sd)
+    }
+
+    /// Queues a submission for `op` on `sd` and returns its user data. The submission ring is only flushed early if
+    /// it is full.
+    fn push_request(
+        &mut self,
+        sd: Option<SockDesc>,
+        op: Operation,
+        prepare: impl FnOnce(&mut Sqe, &Operation),
+    ) -> Result<u64, Fail> {
+        if self.ring.sq_space_left() == 0 {
+            self.ring.submit(false)?;
+        }
+        let user_data: u64 = self.requests.insert(Request { sd, op }) as u64;
+        let me: &mut CatnapTransport = self.deref_mut();
+        let request: &Request = expect_some!(me.requests.get(user_data as usize), "should have just been inserted");
+        match me.ring.get_sqe() {
+            Some(sqe) => {
+                sqe.user_data = user_data;
+                prepare(sqe, &request.op);
+                Ok(user_data)
+            },
+            None => {
+                me.requests.remove(user_data as usize);
+                let cause: String = format!("submission ring is full");
+                error!("submit(): {}", cause);
+                Err(Fail::new(libc::EBUSY, &cause))
+            },
+        }
+    }
+
+    /// Arms the receive side of a socket: a multishot accept or receive for TCP, and a single datagram for UDP.
+    fn arm(&mut self, sd: SockDesc) -> Result<(), Fail> {
+        let socket: SharedUringSocket = self.socket_from_sd(&sd).clone();
+        let bgid: u16 = self.recv_buffers.bgid();
+        let user_data: u64 = if socket.typ == Type::DGRAM {
+            let buf: DemiBuffer = DemiBuffer::new(limits::POP_SIZE_MAX as u16);
+            let msg: Box<Message> = Message::new(&buf, None);
+            self.push_request(Some(sd), Operation::RecvMsg { msg, buf }, |sqe, op| {
+                let msg: &Message = match op {
+                    Operation::RecvMsg { msg, .. } => msg,
+                    _ => unreachable!("should be a datagram receive"),
+                };
+                sqe.opcode = IORING_OP_RECVMSG;
+                socket.set_target(sqe);
+                sqe.addr = &msg.hdr as *const libc::msghdr as u64;
+                sqe.len = 1;
+            })?
+        } else if socket.listening {
+            self.push_request(Some(sd), Operation::Accept, |sqe, _| {
+                sqe.opcode = IORING_OP_ACCEPT;
+                socket.set_target(sqe);
+                sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+                sqe.op_flags = (libc::SOCK_NONBLOCK | libc::SOCK_CLOEXEC) as u32;
+            })?
+        } else {
+            self.push_request(Some(sd), Operation::Recv, |sqe, _| {
+                sqe.opcode = IORING_OP_RECV;
+                socket.set_target(sqe);
+                sqe.flags |= IOSQE_BUFFER_SELECT;
+                sqe.ioprio = IORING_RECV_MULTISHOT;
+                sqe.buf_group = bgid;
+            })?
+        };
+        self.socket_from_sd(&sd).armed = Some(user_data);
+        Ok(())
+    }
+
+    /// Submits the buffer at the head of the send queue of a socket, unless a send is already in flight. If the
+    /// submission fails, the push is failed and we move on to the next buffer.
+    fn send_next(&mut self, sd: SockDesc) {
+        let mut socket: SharedUringSocket = self.socket_from_sd(&sd).clone();
+        if socket.sending.is_some() {
+            return;
+        }
+        while let Some(outgoing) = socket.send_queue.pop_front() {
+            let mut result: SharedAsyncValue<Option<Result<(), Fail>>> = outgoing.result.clone();
+            let msg: Option<Box<Message>> = match outgoing.addr {
+                Some(addr) => Some(Message::new(&outgoing.buf, Some(addr))),
+                None => None,
+            };
+            match self.push_request(Some(sd), Operation::Send { outgoing, msg }, |sqe, op| {
+                let (outgoing, msg): (&Outgoing, &Option<Box<Message>>) = match op {
+                    Operation::Send { outgoing, msg } => (outgoing, msg),
+                    _ => unreachable!("should be a send"),
+                };
+                socket.set_target(sqe);
+                match msg {
+                    Some(msg) => {
+                        sqe.opcode = IORING_OP_SENDMSG;
+                        sqe.addr = &msg.hdr as *const libc::msghdr as u64;
+                        sqe.len = 1;
+                    },
+                    None => {
+                        sqe.opcode = IORING_OP_SEND;
+                        sqe.addr = outgoing.buf.as_ptr() as u64;
+                        sqe.len = outgoing.buf.len() as u32;
+                        sqe.op_flags = libc::MSG_NOSIGNAL as u32;
+                    },
+                }
+            }) {
+                Ok(user_data) => {
+                    socket.sending = Some(user_data);
+                    return;
+                },
+                Err(e) => result.set(Some(Err(e))),
+            }
+        }
+    }
+
+    /// Processes a completion.
+    fn complete(&mut self, cqe: Cqe) {
+        let index: usize = cqe.user_data as usize;
+        let more: bool = cqe.has_more();
+        // Multishot operations stay in the table until their last completion.
+        let request: Request = match self.requests.get(index) {
+            Some(Request {
+                sd,
+                op: Operation::Accept,
+            }) if more => Request {
+                sd: *sd,
+                op: Operation::Accept,
+            },
+            Some(Request {
+                sd,
+                op: Operation::Recv,
+            }) if more => Request {
+                sd: *sd,
+                op: Operation::Recv,
+            },
+            Some(_) if !more => self.requests.remove(index),
+            _ => {
+                warn!("completion for an unknown request (user_data={:?})", cqe.user_data);
+                return;
+            },
+        };
+
+        let sd: SockDesc = match request.sd {
+            Some(sd) => sd,
+            None => {
+                // The socket is gone, so just hand back any buffer that the kernel picked and wake up waiters.
+                if let Some(bid) = cqe.buffer_id() {
+                    self.recv_buffers.take(bid, 0);
+                }
+                match request.op {
+                    Operation::Send { mut outgoing, .. } => outgoing
+                        .result
+                        .set(Some(Err(Fail::new(libc::ECANCELED, "socket was closed")))),
+                    Operation::Connect { mut result, .. } => {
+                        result.set(Some(Err(Fail::new(libc::ECANCELED, "socket was closed"))))
+                    },
+                    _ => (),
+                }
+                return;
+            },
+        };
+        let mut socket: SharedUringSocket = self.socket_from_sd(&sd).clone();
+        if !more {
+            // The socket no longer has this operation in flight.
+            let state: &mut UringSocket = socket.deref_mut();
+            for in_flight in [&mut state.armed, &mut state.sending, &mut state.connecting] {
+                if *in_flight == Some(cqe.user_data) {
+                    *in_flight = None;
+                }
+            }
+        }
+
+        match request.op {
+            Operation::Accept => {
+                if cqe.res >= 0 {
+                    let new_socket: Socket = unsafe { Socket::from_raw_fd(cqe.res) };
+                    match new_socket.peer_addr() {
+                        Ok(saddr) => {
+                            trace!("connection accepted ({:?})", new_socket);
+                            let addr: SocketAddr = expect_some!(saddr.as_socket(), "not a SocketAddrV4");
+                            socket.accept_queue.push(Ok((new_socket, addr)));
+                        },
+                        // The connection was reset before we got to it.
+                        Err(e) => warn!("complete(): dropping accepted connection: {:?}", e),
+                    }
+                } else if cqe.res != -libc::ECANCELED {
+                    let cause: String = format!("failed to accept on socket: {:?}", -cqe.res);
+                    error!("complete(): {}", cause);
+                    socket.accept_queue.push(Err(Fail::new(-cqe.res, &cause)));
+                }
+                if !more {
+                    self.rearm(sd, cqe.res);
+                }
+            },
+            Operation::Recv => {
+                match cqe.buffer_id() {
+                    Some(bid) => {
+                        // The kernel received straight into a buffer of ours, which we hand on without copying it.
+                        let nbytes: usize = cqe.res as usize;
+                        let buf: DemiBuffer = expect_some!(
+                            self.recv_buffers.take(bid, nbytes),
+                            "kernel should have received into a buffer of the ring"
+                        );
+                        trace!("data popped ({:?} bytes)", nbytes);
+                        socket.recv_queue.push(Ok((None, buf)));
+                    },
+                    None if cqe.res == 0 => {
+                        socket.closed = true;
+                        socket.recv_queue.push(Ok((None, DemiBuffer::new(0))));
+                    },
+                    // We ran out of receive buffers, so the kernel stopped this receive. We re-arm it once buffers
+                    // come back.
+                    None if cqe.res == -libc::ENOBUFS => {
+                        if !more {
+                            self.starved.push(sd);
+                        }
+                        return;
+                    },
+                    None if cqe.res == -libc::ECANCELED => (),
+                    None => {
+                        let cause: String = format!("failed to receive on socket: {:?}", -cqe.res);
+                        error!("complete(): {}", cause);
+                        socket.recv_queue.push(Err(Fail::new(-cqe.res, &cause)));
+                    },
+                }
+                if !more && !socket.closed {
+                    self.rearm(sd, cqe.res);
+                }
+            },
+            Operation::RecvMsg { msg, mut buf } => {
+                if cqe.res >= 0 {
+                    expect_ok!(
+                        buf.trim(buf.len() - cqe.res as usize),
+                        "OS should not have received more bytes than in the buffer"
+                    );
+                    trace!("data popped ({:?} bytes)", cqe.res);
+                    socket.recv_queue.push(Ok((msg.addr(), buf)));
+                } else if cqe.res != -libc::ECANCELED {
+                    let cause: String = format!("failed to receive on socket: {:?}", -cqe.res);
+                    error!("complete(): {}", cause);
+                    socket.recv_queue.push(Err(Fail::new(-cqe.res, &cause)));
+                }
+                self.rearm(sd, cqe.res);
+            },
+            Operation::Send { mut outgoing, .. } => {
+                if cqe.res >= 0 {
+                    trace!("data pushed ({:?}/{:?} bytes)", cqe.res, outgoing.buf.len());
+                    expect_ok!(
+                        outgoing.buf.adjust(cqe.res as usize),
+                        "OS should not have sent more bytes than in the buffer"
+                    );
+                    if outgoing.buf.is_empty() {
+                        // Done sending this buffer
+                        outgoing.result.set(Some(Ok(())));
+                    } else {
+                        // Only sent part of the buffer so send the rest before anything else.
+                        socket.send_queue.push_front(outgoing);
+                    }
+                } else {
+                    let cause: String = format!("failed to send on socket: {:?}", -cqe.res);
+                    error!("complete(): {}", cause);
+                    outgoing.result.set(Some(Err(Fail::new(-cqe.res, &cause))));
+                }
+                self.send_next(sd);
+            },
+            Operation::Connect { mut result, .. } => {
+                if cqe.res < 0 {
+                    let cause: String = format!("failed to connect on socket: {:?}", -cqe.res);
+                    error!("complete(): {}", cause);
+                    result.set(Some(Err(Fail::new(-cqe.res, &cause))));
+                } else {
+                    result.set(Some(Ok(())));
+                    if let Err(e) = self.arm(sd) {
+                        socket.recv_queue.push(Err(e));
+                    }
+                }
+            },
+            Operation::Cancel => (),
+        }
+    }
+
+    /// Re-arms the receive side of a socket after its operation completed with `res`, unless it failed for good.
+    fn rearm(&mut self, sd: SockDesc, res: i32) {
+        let mut socket: SharedUringSocket = self.socket_from_sd(&sd).clone();
+        if res < 0 && res != -libc::EAGAIN && res != -libc::EINTR {
+            return;
+        }
+        if let Err(e) = self.arm(sd) {
+            if socket.listening {
+                socket.accept_queue.push(Err(e));
+            } else {
+                socket.recv_queue.push(Err(e));
+            }
+        }
+    }
+
+    /// Detaches all operations in flight from a socket and asks the kernel to cancel them, then removes the socket.
+    fn remove_socket(&mut self, sd: SockDesc) -> Result<(), Fail> {
+        let mut socket: SharedUringSocket = self.socket_from_sd(&sd).clone();
+        for user_data in [socket.armed.take(), socket.sending.take(), socket.connecting.take()]
+            .into_iter()
+            .flatten()
+        {
+            expect_some!(self.requests.get_mut(user_data as usize), "should be in flight").sd = None;
+            // If we cannot cancel the operation, it keeps running until the kernel notices that the socket is gone.
+            if let Err(e) = self.push_request(None, Operation::Cancel, |sqe, _| {
+                sqe.opcode = IORING_OP_ASYNC_CANCEL;
+                sqe.addr = user_data;
+            }) {
+                warn!(
+                    "remove_socket(): cannot cancel operation (user_data={:?}): {:?}",
+                    user_data, e
+                );
+            }
+        }
+        self.starved.retain(|starved| *starved != sd);
+        while let Some(mut outgoing) = socket.send_queue.pop_front() {
+            outgoing
+                .result
+                .set(Some(Err(Fail::new(libc::ECANCELED, "socket was closed"))));
+        }
+        if let Some(index) = socket.fixed_file {
+            // Pending operations hold their own reference to the file, so we can free the slot right away.
+            self.ring.update_file(index, -1)?;
+        }
+        self.socket_table.remove(sd);
+        Ok(())
+    }
+
+    /// Internal function to get the Socket from the metadata structure, given the socket descriptor.
+    fn socket_from_sd(&mut self, sd: &SockDesc) -> &mut SharedUringSocket {
+        expect_some!(self.socket_table.get_mut(*sd), "should have been allocated")
+    }
+}
+
+//======================================================================================================================
+// Trait implementation
+//======================================================================================================================
+
+/// Dereference a shared reference to the socket state.
+impl Deref for SharedUringSocket {
+    type Target = UringSocket;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+/// Dereference a shared mutable reference to the socket state.
+impl DerefMut for SharedUringSocket {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
+
+/// Dereference a shared reference to the underlying transport.
+impl Deref for SharedCatnapTransport {
+    type Target = CatnapTransport;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+/// Dereference a shared mutable reference to the underlying transport.
+impl DerefMut for SharedCatnapTransport {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
+
+impl NetworkTransport for SharedCatnapTransport {
+    type SocketDescriptor = usize;
+
+    /// Creates a new socket on the underlying network transport. We only support IPv4 and UDP and TCP sockets for now.
+    /// Datagram sockets start receiving right away.
+    fn socket(&mut self, domain: Domain, typ: Type) -> Result<Self::SocketDescriptor, Fail> {
+        timer!("catnap::linux::transport::socket");
+        let socket: Socket = socket_ops::new_socket(domain, typ, &self.options)?;
+        let sd: SockDesc = self.insert_socket(socket, typ)?;
+        if typ == Type::DGRAM {
+            if let Err(e) = self.arm(sd) {
+                self.remove_socket(sd)?;
+                return Err(e);
+            }
+        }
+        Ok(sd)
+    }
+
+    /// Set an SO_* option on the socket.
+    fn set_socket_option(&mut self, sd: &mut Self::SocketDescriptor, option: SocketOption) -> Result<(), Fail> {
+        socket_ops::set_socket_option(&mut self.socket_from_sd(sd).socket, option)
+    }
+
+    /// Gets an SO_* option on the socket. The option should be passed in as [option] and the value returned is either
+    /// an error or must match [option] with a value.
+    fn get_socket_option(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        option: SocketOption,
+    ) -> Result<SocketOption, Fail> {
+        socket_ops::get_socket_option(&mut self.socket_from_sd(sd).socket, option)
+    }
+
+    // Gets peer name of connected socket.
+    fn getpeername(&mut self, sd: &mut Self::SocketDescriptor) -> Result<SocketAddrV4, Fail> {
+        socket_ops::getpeername(&mut self.socket_from_sd(sd).socket)
+    }
+
+    /// Binds a socket to [local] on the underlying network transport.
+    fn bind(&mut self, sd: &mut Self::SocketDescriptor, local: SocketAddr) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::bind");
+        socket_ops::bind(&mut self.socket_from_sd(sd).socket, local)
+    }
+
+    /// Sets a socket to passive listening on the underlying transport and arms a multishot accept on it.
+    fn listen(&mut self, sd: &mut Self::SocketDescriptor, backlog: usize) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::listen");
+        trace!("Listen to");
+        if let Err(e) = self.socket_from_sd(sd).socket.listen(backlog as i32) {
+            let cause: String = format!("failed to listen on socket: {:?}", e);
+            error!("listen(): {}", cause);
+            return Err(Fail::new(get_libc_err(e), &cause));
+        }
+        self.socket_from_sd(sd).listening = true;
+        self.arm(*sd)
+    }
+
+    /// Accept the next incoming connection. This function blocks until a new connection arrives from the underlying
+    /// transport.
+    async fn accept(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(Self::SocketDescriptor, SocketAddr), Fail> {
+        timer!("catnap::linux::transport::accept");
+        let mut socket: SharedUringSocket = self.socket_from_sd(sd).clone();
+        let (new_socket, addr) = socket.accept_queue.pop(None).await??;
+        socket_ops::set_accepted_socket_options(&new_socket)?;
+
+        let new_sd: SockDesc = self.insert_socket(new_socket, Type::STREAM)?;
+        if let Err(e) = self.arm(new_sd) {
+            self.remove_socket(new_sd)?;
+            return Err(e);
+        }
+        Ok((new_sd, addr))
+    }
+
+    /// Connect to [remote] through the underlying transport. This function blocks until the connect succeeds or fails
+    /// with an error.
+    async fn connect(&mut self, sd: &mut Self::SocketDescriptor, remote: SocketAddr) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::connect");
+        let mut socket: SharedUringSocket = self.socket_from_sd(sd).clone();
+        let mut result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
+        let addr: Box<SockAddr> = Box::new(remote.into());
+        let user_data: u64 = self.push_request(
+            Some(*sd),
+            Operation::Connect {
+                addr,
+                result: result.clone(),
+            },
+            |sqe, op| {
+                let addr: &SockAddr = match op {
+                    Operation::Connect { addr, .. } => addr,
+                    _ => unreachable!("should be a connect"),
+                };
+                sqe.opcode = IORING_OP_CONNECT;
+                socket.set_target(sqe);
+                sqe.addr = addr.as_ptr() as u64;
+                // The kernel takes the length of the address from the offset field.
+                sqe.off = addr.len() as u64;
+            },
+        )?;
+        socket.connecting = Some(user_data);
+
+        loop {
+            match result.get() {
+                Some(result) => return result,
+                None => {
+                    result.wait_for_change(None).await?;
+                    continue;
+                },
+            }
+        }
+    }
+
+    /// Close the socket and block until close completes.
+    async fn close(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::close");
+        self.hard_close(sd)
+    }
+
+    /// Push [buf] to the underlying transport. This function blocks until the entire buffer has been written to the
+    /// socket. Returns Ok if successfully sent and an error if not.
+    async fn push(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        buf: &mut DemiBuffer,
+        addr: Option<SocketAddr>,
+    ) -> Result<(), Fail> {
+        timer!("catnap::linux::transport::push");
+        // Queue all segments of a chain at once, so they go out back to back, and then wait for them in order.
+        let mut results: Vec<SharedAsyncValue<Option<Result<(), Fail>>>> = Vec::with_capacity(buf.num_segments());
+        let mut segment: Option<DemiBuffer> = Some(buf.clone());
+        while let Some(mut this_segment) = segment {
+            segment = this_segment.detach_tail();
+            if this_segment.is_empty() && !results.is_empty() {
+                continue;
+            }
+            let result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
+            self.socket_from_sd(sd).send_queue.push_back(Outgoing {
+                addr,
+                buf: this_segment,
+                result: result.clone(),
+            });
+            results.push(result);
+        }
+        self.send_next(*sd);
+        for mut result in results {
+            loop {
+                match result.get() {
+                    Some(Ok(())) => break,
+                    Some(Err(e)) => return Err(e),
+                    None => {
+                        result.wait_for_change(None).await?;
+                        continue;
+                    },
+                }
+            }
+        }
+        // Clear out the original buffer, which may be a chain.
+        let _: Option<DemiBuffer> = buf.detach_tail();
+        expect_ok!(buf.trim(buf.len()), "Should be able to empty the buffer");
+        Ok(())
+    }
+
+    /// Pop a [buf] of at most [size] from the underlying transport. This function blocks until the socket has data to
+    /// be read. For connected (i.e., TCP) sockets, this function returns Ok(None). For datagram (i.e., UDP) sockets,
+    /// this function returns the remote address that is the source of the incoming data.
+    async fn pop(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        size: usize,
+    ) -> Result<(Option<SocketAddr>, DemiBuffer), Fail> {
+        timer!("catnap::linux::transport::pop");
+        let mut socket: SharedUringSocket = self.socket_from_sd(sd).clone();
+        let (addr, mut incoming): (Option<SocketAddr>, DemiBuffer) = socket.recv_queue.pop(None).await??;
+        // Figure out how much data we got.
+        let bytes_read: usize = min(incoming.len(), size);
+        // Trim the buffer and leave for next read if we got more than expected.
+        if let Ok(remainder) = incoming.split_back(bytes_read) {
+            if !remainder.is_empty() {
+                socket.recv_queue.push_front(Ok((addr.clone(), remainder)));
+            }
+        }
+        Ok((addr, incoming))
+    }
+
+    /// Close the socket on the underlying transport. Operations that are still in flight are cancelled.
+    fn hard_close(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(), Fail> {
+        // Close the socket.
+        if let Err(e) = self.socket_from_sd(sd).socket.shutdown(Shutdown::Both) {
+            let errno: i32 = get_libc_err(e);
+            if errno != libc::ENOTCONN {
+                return Err(Fail::new(errno, "operation failed"));
+            }
+        }
+        self.remove_socket(*sd)
+    }
+
+    fn get_runtime(&self) -> &SharedDemiRuntime {
+        &self.runtime
+    }
+}
+
+impl MemoryRuntime for SharedCatnapTransport {}
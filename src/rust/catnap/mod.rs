@@ -1,6 +1,10 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-#[cfg_attr(target_os = "linux", path = "linux/transport.rs")]
+#[cfg_attr(all(target_os = "linux", not(feature = "catnap-uring")), path = "linux/transport.rs")]
+#[cfg_attr(
+    all(target_os = "linux", feature = "catnap-uring"),
+    path = "linux/uring_transport.rs"
+)]
 #[cfg_attr(target_os = "windows", path = "win/transport.rs")]
 pub mod transport;
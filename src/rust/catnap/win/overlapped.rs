@@ -475,7 +475,7 @@ mod tests {
         })
         .fuse();
 
-        let server_task: QToken = runtime.insert_io_coroutine("ioc_server", Box::pin(server)).unwrap();
+        let server_task: QToken = runtime.insert_io_coroutine("ioc_server", server).unwrap();
         ensure!(runtime.run_any(&[server_task], Duration::ZERO).is_none());
         post_completion(&iocp, overlapped.as_mut().marshal(), COMPLETION_KEY)?;
 
@@ -520,69 +520,66 @@ mod tests {
         iocp.get_mut().associate_handle(server_pipe.0, COMPLETION_KEY)?;
         let iocp_ref: &mut IoCompletionPort<Rc<Vec<u8>>> = unsafe { &mut *iocp.get() };
 
-        let server = Box::pin(
-            run_as_io_op(async move {
-                unsafe {
-                    iocp_ref.do_io(
-                        Rc::new(Vec::<u8>::new()),
-                        |_: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
-                            server_state.fetch_add(1, Ordering::Relaxed);
-                            is_overlapped_ok(ConnectNamedPipe(server_pipe.0, Some(overlapped)))
-                        },
-                        |_: Pin<&mut Rc<Vec<u8>>>, result: OverlappedResult| -> Result<(), Fail> { result.ok() },
-                    )
-                }
-                .await?;
-
-                server_state.fetch_add(1, Ordering::Relaxed);
+        let server = run_as_io_op(async move {
+            unsafe {
+                iocp_ref.do_io(
+                    Rc::new(Vec::<u8>::new()),
+                    |_: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                        server_state.fetch_add(1, Ordering::Relaxed);
+                        is_overlapped_ok(ConnectNamedPipe(server_pipe.0, Some(overlapped)))
+                    },
+                    |_: Pin<&mut Rc<Vec<u8>>>, result: OverlappedResult| -> Result<(), Fail> { result.ok() },
+                )
+            }
+            .await?;
+
+            server_state.fetch_add(1, Ordering::Relaxed);
+
+            let mut buffer: Rc<Vec<u8>> = Rc::new(iter::repeat(0u8).take(BUFFER_SIZE as usize).collect::<Vec<u8>>());
+            buffer = unsafe {
+                iocp_ref.do_io(
+                    buffer,
+                    |state: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                        let vec: &mut Vec<u8> = Rc::get_mut(state.get_mut()).unwrap();
+                        vec.resize(BUFFER_SIZE as usize, 0u8);
+                        is_overlapped_ok(ReadFile(
+                            server_pipe.0,
+                            Some(vec.as_mut_slice()),
+                            None,
+                            Some(overlapped),
+                        ))
+                    },
+                    |mut state: Pin<&mut Rc<Vec<u8>>>, result: OverlappedResult| -> Result<Rc<Vec<u8>>, Fail> {
+                        match result.ok() {
+                            Ok(()) => {
+                                if result.bytes_transferred == 0 {
+                                    Err(Fail::new(libc::EINVAL, "not bytes received"))
+                                } else {
+                                    Rc::get_mut(state.as_mut().get_mut())
+                                        .unwrap()
+                                        .resize(result.bytes_transferred as usize, 0u8);
+                                    Ok(Rc::clone(Pin::get_mut(state)))
+                                }
+                            },
+
+                            Err(fail) => Err(fail),
+                        }
+                    },
+                )
+            }
+            .await?;
 
-                let mut buffer: Rc<Vec<u8>> =
-                    Rc::new(iter::repeat(0u8).take(BUFFER_SIZE as usize).collect::<Vec<u8>>());
-                buffer = unsafe {
-                    iocp_ref.do_io(
-                        buffer,
-                        |state: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
-                            let vec: &mut Vec<u8> = Rc::get_mut(state.get_mut()).unwrap();
-                            vec.resize(BUFFER_SIZE as usize, 0u8);
-                            is_overlapped_ok(ReadFile(
-                                server_pipe.0,
-                                Some(vec.as_mut_slice()),
-                                None,
-                                Some(overlapped),
-                            ))
-                        },
-                        |mut state: Pin<&mut Rc<Vec<u8>>>, result: OverlappedResult| -> Result<Rc<Vec<u8>>, Fail> {
-                            match result.ok() {
-                                Ok(()) => {
-                                    if result.bytes_transferred == 0 {
-                                        Err(Fail::new(libc::EINVAL, "not bytes received"))
-                                    } else {
-                                        Rc::get_mut(state.as_mut().get_mut())
-                                            .unwrap()
-                                            .resize(result.bytes_transferred as usize, 0u8);
-                                        Ok(Rc::clone(Pin::get_mut(state)))
-                                    }
-                                },
-
-                                Err(fail) => Err(fail),
-                            }
-                        },
-                    )
-                }
-                .await?;
-
-                let message: &str = std::str::from_utf8(buffer.as_slice())
-                    .map_err(|_| Fail::new(libc::EINVAL, "utf8 conversion failed"))?;
-                if message != MESSAGE {
-                    let err_msg: String = format!("expected \"{}\", got \"{}\"", MESSAGE, message);
-                    Err(Fail::new(libc::EINVAL, err_msg.as_str()))
-                } else {
-                    // Dummy result
-                    Ok(OperationResult::Close)
-                }
-            })
-            .fuse(),
-        );
+            let message: &str = std::str::from_utf8(buffer.as_slice())
+                .map_err(|_| Fail::new(libc::EINVAL, "utf8 conversion failed"))?;
+            if message != MESSAGE {
+                let err_msg: String = format!("expected \"{}\", got \"{}\"", MESSAGE, message);
+                Err(Fail::new(libc::EINVAL, err_msg.as_str()))
+            } else {
+                // Dummy result
+                Ok(OperationResult::Close)
+            }
+        })
+        .fuse();
 
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
         let server_task: QToken = runtime.insert_io_coroutine("ioc_server", server).unwrap();
@@ -691,7 +688,7 @@ mod tests {
         .fuse();
 
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
-        let server_task: QToken = runtime.insert_io_coroutine("ioc_server", Box::pin(server)).unwrap();
+        let server_task: QToken = runtime.insert_io_coroutine("ioc_server", server).unwrap();
 
         ensure!(
             server_state_view.load(Ordering::Relaxed) < 1,
@@ -75,13 +75,10 @@ impl SharedCatnapTransport {
             runtime: runtime.clone(),
         }));
 
-        runtime.insert_background_coroutine(
-            "bgc::catnap::transport::epoll",
-            Box::pin({
-                let mut me: Self = me.clone();
-                async move { me.run_event_processor().await }.fuse()
-            }),
-        )?;
+        runtime.insert_background_coroutine("bgc::catnap::transport::epoll", {
+            let mut me: Self = me.clone();
+            async move { me.run_event_processor().await }.fuse()
+        })?;
 
         Ok(me)
     }
@@ -134,6 +131,9 @@ impl NetworkTransport for SharedCatnapTransport {
             SocketOption::Linger(linger) => socket.set_linger(linger),
             SocketOption::KeepAlive(tcp_keepalive) => socket.set_tcp_keepalive(&tcp_keepalive),
             SocketOption::NoDelay(nagle_enabled) => socket.set_nagle(nagle_enabled),
+            SocketOption::CongestionControl(_) => {
+                Err(Fail::new(libc::ENOTSUP, "congestion control is up to the kernel"))
+            },
         }
     }
 
@@ -149,6 +149,9 @@ impl NetworkTransport for SharedCatnapTransport {
             SocketOption::Linger(_) => Ok(SocketOption::Linger(socket.get_linger()?)),
             SocketOption::KeepAlive(_) => Ok(SocketOption::KeepAlive(socket.get_tcp_keepalive()?)),
             SocketOption::NoDelay(_) => Ok(SocketOption::NoDelay(socket.get_nagle()?)),
+            SocketOption::CongestionControl(_) => {
+                Err(Fail::new(libc::ENOTSUP, "congestion control is up to the kernel"))
+            },
         }
     }
 
@@ -296,8 +299,12 @@ impl NetworkTransport for SharedCatnapTransport {
                 Ok(nbytes) => {
                     trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.len());
                     buf.adjust(nbytes)?;
-                    if buf.is_empty() {
-                        return Ok(());
+                    // Move on to the next segment of a chain, if any.
+                    while buf.is_empty() {
+                        match buf.detach_tail() {
+                            Some(tail) => *buf = tail,
+                            None => return Ok(()),
+                        }
                     }
                 },
 
@@ -6,22 +6,17 @@
 //======================================================================================================================
 
 use crate::{
-    catnip::runtime::memory::mempool::MemoryPool,
+    catnip::runtime::memory::mempool::{MemoryPool, MemoryPoolStats},
     inetstack::protocols::MAX_HEADER_SIZE,
     runtime::{
         fail::Fail,
         libdpdk::{rte_mbuf, rte_mempool},
-        memory::DemiBuffer,
-        types::{demi_sgarray_t, demi_sgaseg_t},
+        memory::{alloc_buffer_chain, buffer_into_sgarray, clone_sgarray, free_sgarray, DemiBuffer},
+        types::{demi_sgarray_t, DEMI_SGARRAY_MAXLEN},
     },
 };
 use ::anyhow::Error;
-use ::libc::c_void;
-use ::std::{
-    ffi::CString,
-    mem,
-    ptr::{self, NonNull},
-};
+use ::std::{ffi::CString, thread};
 
 //======================================================================================================================
 // Exports
@@ -49,35 +44,56 @@ pub struct MemoryManager {
 //======================================================================================================================
 
 impl MemoryManager {
-    pub fn new(max_body_size: usize) -> Result<Self, Error> {
+    /// Creates the memory manager for the NIC queue `queue_id`. Each queue gets its own body pool, so that libOS
+    /// instances that run on different queues do not share any memory. The pool lives on the NUMA node `socket_id`,
+    /// which should be that of the NIC.
+    pub fn new(max_body_size: usize, queue_id: u16, socket_id: i32) -> Result<Self, Error> {
         let config: MemoryConfig = MemoryConfig::new(Some(max_body_size), None, None);
         let body_pool: MemoryPool = MemoryPool::new(
-            CString::new("body_pool")?,
+            Self::body_pool_name(queue_id)?,
             config.get_max_body_size(),
             config.get_body_pool_size(),
             config.get_cache_size(),
+            socket_id,
         )?;
 
         Ok(Self { config, body_pool })
     }
 
-    pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
+    /// Attaches to the memory manager that was previously created for the NIC queue `queue_id`.
+    pub fn lookup(max_body_size: usize, queue_id: u16) -> Result<Self, Error> {
+        let config: MemoryConfig = MemoryConfig::new(Some(max_body_size), None, None);
+        let body_pool: MemoryPool = MemoryPool::lookup(Self::body_pool_name(queue_id)?)?;
 
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
+        Ok(Self { config, body_pool })
+    }
+
+    /// Warms up the body pools of `managers` in parallel, one thread per pool, and returns the number of buffers that
+    /// were warmed up. The pools run dry while this runs, so it has to happen before any device that takes buffers from
+    /// them starts, and nothing should allocate from them until this returns.
+    pub fn warm_up(managers: &[MemoryManager]) -> usize {
+        // Raw pointers cannot cross threads, so we hand over the addresses of the pools instead.
+        let pools: Vec<usize> = managers.iter().map(|manager| manager.body_pool() as usize).collect();
+        thread::scope(|scope| {
+            let warmers: Vec<thread::ScopedJoinHandle<usize>> = pools
+                .into_iter()
+                .map(|pool| {
+                    // Safety: the pools belong to `managers`, which outlive the scope of these threads.
+                    scope.spawn(move || unsafe { MemoryPool::warm_up(pool as *mut rte_mempool) })
+                })
+                .collect();
+            warmers.into_iter().map(|warmer| warmer.join().unwrap_or(0)).sum()
         })
     }
 
+    fn body_pool_name(queue_id: u16) -> Result<CString, Error> {
+        Ok(CString::new(format!("body_pool_{}", queue_id))?)
+    }
+
+    pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
+        buffer_into_sgarray(buf)
+    }
+
     /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
     pub fn alloc_body_mbuf(&self) -> Result<DemiBuffer, Fail> {
         let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(None)?;
@@ -85,121 +101,46 @@ impl MemoryManager {
     }
 
     pub fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = if size <= self.config.get_max_body_size() {
-            // Allocate a DPDK-managed buffer.
-            let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(Some(size))?;
-            // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
-            unsafe { DemiBuffer::from_mbuf(mbuf_ptr) }
+        // A buffer chain cannot mix DPDK-managed and heap-managed buffers. Anything that fits into as many body mbufs
+        // as a scatter-gather array has segments becomes a chain of those, so that it goes out without a copy. Larger
+        // arrays become a chain of heap-managed buffers.
+        let max_body_size: usize = self.config.get_max_body_size();
+        let buf: DemiBuffer = if size > 0 && size <= DEMI_SGARRAY_MAXLEN * max_body_size {
+            // Allocate DPDK-managed buffers.
+            alloc_buffer_chain(
+                size,
+                max_body_size as u16,
+                |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                    let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(Some(segment_size as usize))?;
+                    // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
+                    Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
+                },
+            )?
         } else {
-            // Allocate a heap-managed buffer.
-            DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16)
-        };
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
+            // Allocate heap-managed buffers.
+            alloc_buffer_chain(
+                size,
+                u16::MAX - MAX_HEADER_SIZE as u16,
+                |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                    Ok(DemiBuffer::new_with_headroom(segment_size, MAX_HEADER_SIZE as u16))
+                },
+            )?
         };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        buffer_into_sgarray(buf)
     }
 
     pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
-        // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        drop(buf);
-
-        Ok(())
+        free_sgarray(sga)
     }
 
     /// Clones a scatter-gather array into a DemiBuffer.
     pub fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
-        }
-
-        Ok(clone)
+        clone_sgarray(sga)
+    }
+
+    /// Gets the fill level and miss counters of the body pool.
+    pub fn body_pool_stats(&self) -> MemoryPoolStats {
+        self.body_pool.stats()
     }
 
     /// Returns a raw pointer to the underlying body pool.
@@ -5,13 +5,24 @@
 // Imports
 //======================================================================================================================
 
-use crate::runtime::{
-    fail::Fail,
-    libdpdk::{
-        rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_alloc, rte_pktmbuf_free, rte_pktmbuf_pool_create, rte_socket_id,
+use crate::{
+    perftools::stats,
+    runtime::{
+        fail::Fail,
+        libdpdk::{
+            rte_errno, rte_mbuf, rte_mempool, rte_mempool_avail_count, rte_mempool_in_use_count, rte_mempool_lookup,
+            rte_pktmbuf_alloc, rte_pktmbuf_free, rte_pktmbuf_pool_create,
+        },
     },
 };
-use ::std::ffi::CString;
+use ::std::{cell::Cell, ffi::CString, ptr};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Stride at which [MemoryPool::warm_up] touches the data room of buffers, which is the size of the smallest pages.
+const PAGE_SIZE: usize = 4096;
 
 //======================================================================================================================
 // Structures
@@ -22,6 +33,19 @@ use ::std::ffi::CString;
 pub struct MemoryPool {
     /// Underlying memory pool.
     pool: *mut rte_mempool,
+    /// Number of allocations that found the pool empty.
+    misses: Cell<u64>,
+}
+
+/// Fill level and miss counters of a memory pool.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MemoryPoolStats {
+    /// Number of free buffers, including those in the per-core caches.
+    pub available: usize,
+    /// Number of buffers that are in use.
+    pub in_use: usize,
+    /// Number of allocations that found the pool empty.
+    pub misses: u64,
 }
 
 //======================================================================================================================
@@ -30,8 +54,15 @@ pub struct MemoryPool {
 
 /// Associated functions for memory pool.
 impl MemoryPool {
-    /// Creates a new memory pool.
-    pub fn new(name: CString, data_room_size: usize, pool_size: usize, cache_size: usize) -> Result<Self, Fail> {
+    /// Creates a new memory pool on the NUMA node `socket_id`. Each core that is registered with the EAL gets a cache of
+    /// `cache_size` buffers in front of the pool, which it refills from and flushes to the pool in bulk.
+    pub fn new(
+        name: CString,
+        data_room_size: usize,
+        pool_size: usize,
+        cache_size: usize,
+        socket_id: i32,
+    ) -> Result<Self, Fail> {
         let pool: *mut rte_mempool = unsafe {
             rte_pktmbuf_pool_create(
                 name.as_ptr(),
@@ -39,7 +70,7 @@ impl MemoryPool {
                 cache_size as u32,
                 0,
                 data_room_size as u16,
-                rte_socket_id() as i32,
+                socket_id,
             )
         };
 
@@ -51,7 +82,27 @@ impl MemoryPool {
             return Err(Fail::new(libc::EAGAIN, &cause));
         }
 
-        Ok(Self { pool })
+        Ok(Self {
+            pool,
+            misses: Cell::new(0),
+        })
+    }
+
+    /// Looks up a memory pool that was previously created with [new](Self::new), possibly by another thread.
+    pub fn lookup(name: CString) -> Result<Self, Fail> {
+        let pool: *mut rte_mempool = unsafe { rte_mempool_lookup(name.as_ptr()) };
+
+        // Memory pool does not exist.
+        if pool.is_null() {
+            let cause: String = format!("failed to find memory pool: {:?}", name);
+            error!("lookup(): {}", cause);
+            return Err(Fail::new(libc::ENOENT, &cause));
+        }
+
+        Ok(Self {
+            pool,
+            misses: Cell::new(0),
+        })
     }
 
     /// Gets a raw pointer to the underlying memory pool.
@@ -67,6 +118,8 @@ impl MemoryPool {
         // Allocate mbuf.
         let mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(self.pool) };
         if mbuf_ptr.is_null() {
+            self.misses.set(self.misses.get() + 1);
+            stats::record_mempool_miss();
             let rte_errno: libc::c_int = unsafe { rte_errno() };
             let cause: String = format!("cannot allocate an mbuf at this time: {:?}", rte_errno);
             warn!("alloc_mbuf(): {}", cause);
@@ -93,4 +146,48 @@ impl MemoryPool {
 
         Ok(mbuf_ptr)
     }
+
+    /// Faults in the free buffers of the memory pool `pool` by taking all of them, writing to every page of their data
+    /// room, and giving them back, so that the first packets do not pay for page faults and cold TLBs. Returns the
+    /// number of buffers that were warmed up. The pool runs dry while this runs, so nothing else should allocate from it
+    /// in the meantime, and no started device should be refilling its RX rings from it. This takes a raw pointer so that it can run on a thread other than the one that owns the pool;
+    /// DPDK memory pools are thread safe, and threads that are not registered with the EAL bypass the per-core caches.
+    ///
+    /// # Safety
+    ///
+    /// `pool` must point to a memory pool of packet buffers that outlives this call.
+    pub unsafe fn warm_up(pool: *mut rte_mempool) -> usize {
+        let capacity: usize = unsafe { rte_mempool_avail_count(pool) } as usize;
+        let mut mbufs: Vec<*mut rte_mbuf> = Vec::<*mut rte_mbuf>::with_capacity(capacity);
+        loop {
+            let mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(pool) };
+            if mbuf_ptr.is_null() {
+                break;
+            }
+            // Safety: the mbuf is ours until we free it, and its data room spans `buf_len` bytes from `buf_addr`.
+            unsafe {
+                let buf_addr: *mut u8 = (*mbuf_ptr).buf_addr as *mut u8;
+                let buf_len: usize = (*mbuf_ptr).buf_len as usize;
+                for offset in (0..buf_len).step_by(PAGE_SIZE) {
+                    ptr::write_volatile(buf_addr.add(offset), 0);
+                }
+            }
+            mbufs.push(mbuf_ptr);
+        }
+        let num_buffers: usize = mbufs.len();
+        for mbuf_ptr in mbufs {
+            unsafe { rte_pktmbuf_free(mbuf_ptr) };
+        }
+        num_buffers
+    }
+
+    /// Gets the fill level and miss counters of the target memory pool. Counting free buffers walks the caches of all
+    /// cores, so this is not meant for the fast path.
+    pub fn stats(&self) -> MemoryPoolStats {
+        MemoryPoolStats {
+            available: unsafe { rte_mempool_avail_count(self.pool) } as usize,
+            in_use: unsafe { rte_mempool_in_use_count(self.pool) } as usize,
+            misses: self.misses.get(),
+        }
+    }
 }
@@ -10,7 +10,7 @@ mod mempool;
 // Exports
 //======================================================================================================================
 
-pub use self::manager::MemoryManager;
+pub use self::{manager::MemoryManager, mempool::MemoryPoolStats};
 
 //======================================================================================================================
 // Imports
@@ -7,27 +7,37 @@ pub mod memory;
 // Imports
 //======================================================================================================================
 
-use self::memory::{consts::DEFAULT_MAX_BODY_SIZE, MemoryManager};
+use self::memory::{consts::DEFAULT_MAX_BODY_SIZE, MemoryManager, MemoryPoolStats};
 use crate::{
     demikernel::config::Config,
     expect_some,
-    inetstack::protocols::layer1::PhysicalLayer,
+    inetstack::protocols::{
+        layer1::PhysicalLayer,
+        layer2::ETHERNET2_HEADER_SIZE,
+        layer4::ephemeral::{FIRST_PRIVATE_PORT_NUMBER, LAST_PRIVATE_PORT_NUMBER},
+    },
+    perftools::stats,
     runtime::{
         fail::Fail,
         libdpdk::{
-            rte_delay_us_block, rte_eal_init, rte_errno, rte_eth_conf, rte_eth_dev_configure, rte_eth_dev_count_avail,
-            rte_eth_dev_get_mtu, rte_eth_dev_info, rte_eth_dev_info_get, rte_eth_dev_is_valid_port,
-            rte_eth_dev_set_mtu, rte_eth_dev_start, rte_eth_find_next_owned_by, rte_eth_link, rte_eth_link_get_nowait,
+            rte_delay_us_block, rte_eal_init, rte_epoll_wait_per_thread, rte_errno, rte_eth_conf,
+            rte_eth_dev_configure, rte_eth_dev_count_avail, rte_eth_dev_get_mtu, rte_eth_dev_info,
+            rte_eth_dev_info_get, rte_eth_dev_is_valid_port, rte_eth_dev_rx_intr_ctl_q_per_thread,
+            rte_eth_dev_rx_intr_disable, rte_eth_dev_rx_intr_enable, rte_eth_dev_set_mtu, rte_eth_dev_socket_id,
+            rte_eth_dev_start, rte_eth_find_next_owned_by, rte_eth_link, rte_eth_link_get_nowait,
             rte_eth_promiscuous_enable, rte_eth_rss_ip, rte_eth_rx_burst,
-            rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS, rte_eth_rx_offload_tcp_cksum,
-            rte_eth_rx_offload_udp_cksum, rte_eth_rx_queue_setup, rte_eth_rxconf, rte_eth_tx_burst,
-            rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE, rte_eth_tx_offload_multi_segs,
-            rte_eth_tx_offload_tcp_cksum, rte_eth_tx_offload_udp_cksum, rte_eth_tx_queue_setup, rte_eth_txconf,
-            rte_mbuf, RTE_ETHER_MAX_JUMBO_FRAME_LEN, RTE_ETHER_MAX_LEN, RTE_ETH_DEV_NO_OWNER, RTE_ETH_LINK_FULL_DUPLEX,
-            RTE_ETH_LINK_UP, RTE_PKTMBUF_HEADROOM,
+            rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS, rte_eth_rx_offload_scatter,
+            rte_eth_rx_offload_tcp_cksum, rte_eth_rx_offload_tcp_lro, rte_eth_rx_offload_udp_cksum,
+            rte_eth_rx_queue_count, rte_eth_rx_queue_setup, rte_eth_rxconf, rte_eth_tx_burst,
+            rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE, rte_eth_tx_offload_ipv4_cksum,
+            rte_eth_tx_offload_multi_segs, rte_eth_tx_offload_tcp_cksum, rte_eth_tx_offload_tcp_tso,
+            rte_eth_tx_offload_udp_cksum, rte_eth_tx_queue_setup, rte_eth_txconf, rte_flow_steer_arp,
+            rte_flow_steer_dst_port, rte_lcore_id, rte_mbuf, rte_pktmbuf_free, rte_pktmbuf_set_tcp_tso, rte_socket_id,
+            rte_thread_register, RTE_ETHER_MAX_JUMBO_FRAME_LEN, RTE_ETHER_MAX_LEN, RTE_ETH_DEV_NO_OWNER,
+            RTE_ETH_LINK_FULL_DUPLEX, RTE_ETH_LINK_UP, RTE_PKTMBUF_HEADROOM,
         },
         memory::DemiBuffer,
-        network::consts::RECEIVE_BATCH_SIZE,
+        network::consts::{MAX_RECEIVE_BATCH_SIZE, TRANSMIT_BATCH_SIZE, TRANSMIT_BATCH_TIMEOUT},
         SharedObject,
     },
     timer,
@@ -35,12 +45,33 @@ use crate::{
 use ::arrayvec::ArrayVec;
 use ::std::{
     ffi::CString,
-    mem,
     mem::MaybeUninit,
     ops::{Deref, DerefMut},
-    time::Duration,
+    sync::OnceLock,
+    time::{Duration, Instant},
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Lcore identifier of threads that are not registered with the EAL.
+const LCORE_ID_ANY: u32 = u32::MAX;
+
+/// How long we wait for the link of the ethernet port to come up.
+const LINK_UP_TIMEOUT: Duration = Duration::from_secs(9);
+
+/// How often we check whether the link of the ethernet port is up. A short interval matters, since the link is often up
+/// already or comes up shortly after the port starts.
+const LINK_POLL_INTERVAL: Duration = Duration::from_millis(10);
+
+/// Queue that receives all ARP frames when the port has more than one queue pair.
+const ARP_QUEUE_ID: u16 = 0;
+
+// Flow rules tell apart the shares of the ephemeral port range by masking the low bits of the port, which only works if
+// the range is exactly the set of ports whose two top bits are set.
+const _: () = assert!(FIRST_PRIVATE_PORT_NUMBER == 0xC000 && LAST_PRIVATE_PORT_NUMBER == u16::MAX);
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -48,17 +79,40 @@ use ::std::{
 pub struct DPDKRuntime {
     mm: MemoryManager,
     port_id: u16,
+    /// RX/TX queue pair that this runtime owns.
+    queue_id: u16,
+    /// Number of RX/TX queue pairs of the port.
+    num_queues: u16,
+    /// Outgoing packets that have not yet been handed to the device.
+    tx_batch: ArrayVec<*mut rte_mbuf, TRANSMIT_BATCH_SIZE>,
+    /// Time at which the oldest packet in [tx_batch] was staged.
+    tx_batch_start: Option<Instant>,
+    /// Whether the device cuts large TCP segments into MSS-sized ones.
+    tcp_segmentation_offload: bool,
+    /// Whether the RX interrupt of our queue is hooked up to the epoll instance of this thread.
+    rx_interrupts: bool,
 }
 
 #[derive(Clone)]
 pub struct SharedDPDKRuntime(SharedObject<DPDKRuntime>);
 
+//======================================================================================================================
+// Static Variables
+//======================================================================================================================
+
+/// Ethernet port shared by all DPDK runtimes in this process along with whether it offloads TCP segmentation, or the
+/// reason why it could not be set up.
+static DPDK_PORT: OnceLock<Result<(u16, bool), Fail>> = OnceLock::new();
+
 //======================================================================================================================
 // Associate Functions
 //======================================================================================================================
 
 impl SharedDPDKRuntime {
-    pub fn new(config: &Config) -> Result<Self, Fail> {
+    /// Creates a DPDK runtime that drives the RX/TX queue pair `queue_id` of the NIC. The EAL and the ethernet port
+    /// are set up only once per process, by whichever thread gets here first; every other libOS instance then attaches
+    /// to its own queue pair and memory pool, so that instances on different cores share nothing.
+    pub fn new(config: &Config, queue_id: u16) -> Result<Self, Fail> {
         let tcp_offload: Option<bool> = match config.tcp_checksum_offload() {
             Ok(offload) => Some(offload),
             Err(_) => {
@@ -75,15 +129,94 @@ impl SharedDPDKRuntime {
             },
         };
 
-        let (mm, port_id): (MemoryManager, u16) = Self::initialize_dpdk(
-            &config.eal_init_args()?,
-            config.enable_jumbo_frames()?,
-            config.mtu()?,
-            tcp_offload.unwrap_or(false),
-            udp_offload.unwrap_or(false),
-        )?;
+        let tso: Option<bool> = match config.tcp_segmentation_offload() {
+            Ok(offload) => Some(offload),
+            Err(_) => {
+                warn!("No setting for TCP segmentation offload. Turning off by default.");
+                None
+            },
+        };
 
-        Ok(Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime { mm, port_id })))
+        let lro: Option<bool> = match config.tcp_receive_coalescing() {
+            Ok(coalescing) => Some(coalescing),
+            Err(_) => {
+                warn!("No setting for TCP receive coalescing. Turning off by default.");
+                None
+            },
+        };
+
+        let num_queues: Option<u16> = match config.num_queues() {
+            Ok(num_queues) => Some(num_queues),
+            Err(_) => {
+                warn!("No setting for number of queues. Using a single queue by default.");
+                None
+            },
+        };
+        let num_queues: u16 = num_queues.unwrap_or(1);
+
+        if queue_id >= num_queues {
+            let cause: String = format!(
+                "queue id is out of range (queue_id={:?}, num_queues={:?})",
+                queue_id, num_queues
+            );
+            error!("new(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let use_jumbo_frames: bool = config.enable_jumbo_frames()?;
+        let idle_wait: bool = config.idle_wait().unwrap_or(false);
+        let max_body_size: usize = if use_jumbo_frames {
+            (RTE_ETHER_MAX_JUMBO_FRAME_LEN + RTE_PKTMBUF_HEADROOM) as usize
+        } else {
+            DEFAULT_MAX_BODY_SIZE
+        };
+
+        let eal_init_args: Vec<CString> = config.eal_init_args()?;
+        let mtu: u16 = config.mtu()?;
+        let (port_id, tcp_segmentation_offload): (u16, bool) = DPDK_PORT
+            .get_or_init(|| {
+                Self::initialize_dpdk(
+                    &eal_init_args,
+                    use_jumbo_frames,
+                    mtu,
+                    tcp_offload.unwrap_or(false),
+                    udp_offload.unwrap_or(false),
+                    tso.unwrap_or(false),
+                    lro.unwrap_or(false),
+                    idle_wait,
+                    num_queues,
+                    max_body_size,
+                )
+            })
+            .clone()?;
+        Self::register_thread(port_id);
+        if num_queues > 1 && queue_id != ARP_QUEUE_ID {
+            warn!(
+                "new(): ARP frames go to queue {:?}, so this instance only reaches peers in the ARP table (queue_id={:?})",
+                ARP_QUEUE_ID, queue_id
+            );
+        }
+        let rx_interrupts: bool = idle_wait && Self::register_rx_interrupt(port_id, queue_id);
+
+        let mm: MemoryManager = match MemoryManager::lookup(max_body_size, queue_id) {
+            Ok(manager) => manager,
+            Err(e) => {
+                let cause: String = format!("Failed to attach to memory manager: {:?}", e);
+                error!("new(): {}", cause);
+                return Err(Fail::new(libc::EIO, &cause));
+            },
+        };
+
+        Ok(Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime {
+            mm,
+            port_id,
+            queue_id,
+            num_queues,
+            tx_batch: ArrayVec::new(),
+            tx_batch_start: None,
+            tcp_segmentation_offload,
+            rx_interrupts,
+        })))
     }
 
     fn initialize_dpdk(
@@ -92,10 +225,19 @@ impl SharedDPDKRuntime {
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(MemoryManager, u16), Fail> {
+        tcp_segmentation_offload: bool,
+        tcp_receive_coalescing: bool,
+        rx_interrupts: bool,
+        num_queues: u16,
+        max_body_size: usize,
+    ) -> Result<(u16, bool), Fail> {
         std::env::set_var("MLX5_SHUT_UP_BF", "1");
-        std::env::set_var("MLX5_SINGLE_THREADED", "1");
-        std::env::set_var("MLX4_SINGLE_THREADED", "1");
+        // Queues are driven from different threads when there is more than one of them.
+        if num_queues == 1 {
+            std::env::set_var("MLX5_SINGLE_THREADED", "1");
+            std::env::set_var("MLX4_SINGLE_THREADED", "1");
+        }
+        let init_start: Instant = Instant::now();
         let eal_init_refs = eal_init_args.iter().map(|s| s.as_ptr() as *mut u8).collect::<Vec<_>>();
         let ret: libc::c_int = unsafe { rte_eal_init(eal_init_refs.len() as i32, eal_init_refs.as_ptr() as *mut _) };
         if ret < 0 {
@@ -104,56 +246,89 @@ impl SharedDPDKRuntime {
             error!("initialize_dpdk(): {}", cause);
             return Err(Fail::new(libc::EIO, &cause));
         }
+        let eal_time: Duration = init_start.elapsed();
         let nb_ports: u16 = unsafe { rte_eth_dev_count_avail() };
         if nb_ports == 0 {
             return Err(Fail::new(libc::EIO, "No ethernet ports available"));
         }
         trace!("DPDK reports that {} ports (interfaces) are available.", nb_ports);
 
-        let max_body_size: usize = if use_jumbo_frames {
-            (RTE_ETHER_MAX_JUMBO_FRAME_LEN + RTE_PKTMBUF_HEADROOM) as usize
-        } else {
-            DEFAULT_MAX_BODY_SIZE
-        };
-
-        let memory_manager = match MemoryManager::new(max_body_size) {
-            Ok(manager) => manager,
-            Err(e) => {
-                let cause: String = format!("Failed to set up memory manager: {:?}", e);
-                error!("initialize_dpdk(): {}", cause);
-                return Err(Fail::new(libc::EIO, &cause));
-            },
-        };
-
         let owner: u64 = RTE_ETH_DEV_NO_OWNER as u64;
         let port_id: u16 = unsafe { rte_eth_find_next_owned_by(0, owner) as u16 };
-        Self::initialize_dpdk_port(
+        // This is SOCKET_ID_ANY if the NUMA node of the device is unknown.
+        let socket_id: i32 = unsafe { rte_eth_dev_socket_id(port_id) };
+
+        // Create one memory pool per queue on the NUMA node of the device, so that neither the device nor the cores
+        // that serve it reach across sockets for buffers. Each libOS instance later attaches to the pool of its own
+        // queue.
+        let phase_start: Instant = Instant::now();
+        let mut memory_managers: Vec<MemoryManager> = Vec::<MemoryManager>::with_capacity(num_queues as usize);
+        for queue_id in 0..num_queues {
+            match MemoryManager::new(max_body_size, queue_id, socket_id) {
+                Ok(manager) => memory_managers.push(manager),
+                Err(e) => {
+                    let cause: String = format!("Failed to set up memory manager: {:?}", e);
+                    error!("initialize_dpdk(): {}", cause);
+                    return Err(Fail::new(libc::EIO, &cause));
+                },
+            };
+        }
+        let mempool_time: Duration = phase_start.elapsed();
+
+        // Fault in the buffers of the memory pools before the port starts. Warming up takes every free buffer of a pool
+        // for a while, which would starve a started device that refills its RX rings from it when the link comes up.
+        let phase_start: Instant = Instant::now();
+        let num_buffers: usize = MemoryManager::warm_up(&memory_managers);
+        let warm_up_time: Duration = phase_start.elapsed();
+
+        let phase_start: Instant = Instant::now();
+        let tcp_segmentation_offload: bool = Self::initialize_dpdk_port(
             port_id,
-            &memory_manager,
+            socket_id,
+            &memory_managers,
             use_jumbo_frames,
             mtu,
             tcp_checksum_offload,
             udp_checksum_offload,
+            tcp_segmentation_offload,
+            tcp_receive_coalescing,
+            rx_interrupts,
         )?;
-
-        // TODO: Where is this function?
-        // if unsafe { rte_lcore_count() } > 1 {
-        //     eprintln!("WARNING: Too many lcores enabled. Only 1 used.");
-        // }
-
-        Ok((memory_manager, port_id))
+        let port_time: Duration = phase_start.elapsed();
+
+        let phase_start: Instant = Instant::now();
+        Self::wait_for_link(port_id)?;
+        let link_time: Duration = phase_start.elapsed();
+
+        info!(
+            "initialize_dpdk(): done in {:?} (eal={:?}, mempools={:?}, warm_up={:?}, buffers={}, port={:?}, link={:?})",
+            init_start.elapsed(),
+            eal_time,
+            mempool_time,
+            warm_up_time,
+            num_buffers,
+            port_time,
+            link_time
+        );
+
+        Ok((port_id, tcp_segmentation_offload))
     }
 
     fn initialize_dpdk_port(
         port_id: u16,
-        memory_manager: &MemoryManager,
+        socket_id: i32,
+        memory_managers: &[MemoryManager],
         use_jumbo_frames: bool,
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(), Fail> {
-        let rx_rings: u16 = 1;
-        let tx_rings: u16 = 1;
+        tcp_segmentation_offload: bool,
+        tcp_receive_coalescing: bool,
+        rx_interrupts: bool,
+    ) -> Result<bool, Fail> {
+        // We set up one RX/TX queue pair for each memory manager.
+        let rx_rings: u16 = memory_managers.len() as u16;
+        let tx_rings: u16 = memory_managers.len() as u16;
         let rx_ring_size: u16 = 2048;
         let tx_ring_size: u16 = 2048;
         let nb_rxd: u16 = rx_ring_size;
@@ -174,6 +349,15 @@ impl SharedDPDKRuntime {
         };
 
         println!("dev_info: {:?}", dev_info);
+        if rx_rings > dev_info.max_rx_queues || tx_rings > dev_info.max_tx_queues {
+            let cause: String = format!(
+                "Not enough queues on ethernet device (requested={:?}, max_rx_queues={:?}, max_tx_queues={:?})",
+                rx_rings, dev_info.max_rx_queues, dev_info.max_tx_queues
+            );
+            error!("initialize_dpdk_port(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
         let mut port_conf: rte_eth_conf = unsafe { MaybeUninit::zeroed().assume_init() };
         port_conf.rxmode.max_lro_pkt_size = if use_jumbo_frames {
             RTE_ETHER_MAX_JUMBO_FRAME_LEN
@@ -186,6 +370,24 @@ impl SharedDPDKRuntime {
         if udp_checksum_offload {
             port_conf.rxmode.offloads |= unsafe { rte_eth_rx_offload_udp_cksum() as u64 };
         }
+        // We cannot verify the checksums of segments that the device coalesced, so it has to do that as well.
+        if tcp_receive_coalescing && tcp_checksum_offload {
+            let lro_offload: u64 = unsafe { rte_eth_rx_offload_tcp_lro() as u64 };
+            let scatter_offload: u64 = unsafe { rte_eth_rx_offload_scatter() as u64 };
+            if dev_info.rx_offload_capa & lro_offload == 0 {
+                warn!("initialize_dpdk_port(): device does not support large receive offload");
+            } else {
+                port_conf.rxmode.offloads |= lro_offload;
+                // Coalesced segments may not fit in a single mbuf.
+                if dev_info.rx_offload_capa & scatter_offload != 0 {
+                    port_conf.rxmode.offloads |= scatter_offload;
+                }
+            }
+        }
+        // Queues only raise interrupts once we arm them, which we do when the network stack goes idle.
+        if rx_interrupts {
+            port_conf.intr_conf.set_rxq(1);
+        }
         port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
         port_conf.rx_adv_conf.rss_conf.rss_hf = unsafe { rte_eth_rss_ip() as u64 } | dev_info.flow_type_rss_offloads;
 
@@ -197,6 +399,19 @@ impl SharedDPDKRuntime {
             port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_udp_cksum() as u64 };
         }
         port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_multi_segs() as u64 };
+        // The device fills in the checksums of the segments that it cuts, so segmentation needs checksum offloads too.
+        let tso_offloads: u64 = unsafe {
+            (rte_eth_tx_offload_tcp_tso() | rte_eth_tx_offload_ipv4_cksum() | rte_eth_tx_offload_tcp_cksum()) as u64
+        };
+        let tcp_segmentation_offload: bool = if !tcp_segmentation_offload {
+            false
+        } else if dev_info.tx_offload_capa & tso_offloads != tso_offloads {
+            warn!("initialize_dpdk_port(): device does not support TCP segmentation offload");
+            false
+        } else {
+            port_conf.txmode.offloads |= tso_offloads;
+            true
+        };
 
         let mut rx_conf: rte_eth_rxconf = unsafe { MaybeUninit::zeroed().assume_init() };
         rx_conf.rx_thresh.pthresh = rx_pthresh;
@@ -235,7 +450,8 @@ impl SharedDPDKRuntime {
             }
         }
 
-        let socket_id: u32 = 0;
+        // Descriptor rings go on the NUMA node of the device, just like the memory pools.
+        let socket_id: u32 = socket_id as u32;
 
         unsafe {
             for i in 0..rx_rings {
@@ -245,7 +461,7 @@ impl SharedDPDKRuntime {
                     nb_rxd,
                     socket_id,
                     &rx_conf as *const _,
-                    memory_manager.body_pool(),
+                    memory_managers[i as usize].body_pool(),
                 ) != 0
                 {
                     let cause: String = format!("Failed to set up rx queue");
@@ -274,37 +490,162 @@ impl SharedDPDKRuntime {
             return Err(Fail::new(libc::EIO, &cause));
         }
 
-        let sleep_duration: Duration = Duration::from_millis(100);
-        let mut retry_count: i32 = 90;
+        if rx_rings > 1 {
+            Self::steer_flows(port_id, rx_rings)?;
+        }
+
+        Ok(tcp_segmentation_offload)
+    }
+
+    /// Installs the flow rules that multiple queue pairs need. RSS spreads incoming flows across queues by their hash,
+    /// which is fine for flows that remote peers open, but sends the packets of a flow that a libOS instance opened to
+    /// whichever queue the hash picks. So each queue gets a share of the ephemeral ports (see
+    /// [PhysicalLayer::ephemeral_port_share]), and we steer TCP and UDP packets whose destination port falls in that
+    /// share to it. RSS cannot hash ARP frames either, so we steer them all to [ARP_QUEUE_ID], whose instance answers
+    /// requests for our address. The number of queues is a power of two, so a share is a value of the low bits of the
+    /// port.
+    fn steer_flows(port_id: u16, num_queues: u16) -> Result<(), Fail> {
+        let ret: libc::c_int = unsafe { rte_flow_steer_arp(port_id, ARP_QUEUE_ID) };
+        if ret != 0 {
+            let cause: String = format!("Failed to steer ARP frames to queue {:?} (ret={:?})", ARP_QUEUE_ID, ret);
+            error!("steer_flows(): {}", cause);
+            return Err(Fail::new(libc::EIO, &cause));
+        }
 
+        let mask: u16 = FIRST_PRIVATE_PORT_NUMBER | (num_queues - 1);
+        for queue_id in 0..num_queues {
+            for udp in [false, true] {
+                let ret: libc::c_int = unsafe {
+                    rte_flow_steer_dst_port(port_id, udp, FIRST_PRIVATE_PORT_NUMBER | queue_id, mask, queue_id)
+                };
+                if ret != 0 {
+                    let cause: String = format!(
+                        "Failed to steer ephemeral ports to queue {:?} (udp={:?}, ret={:?})",
+                        queue_id, udp, ret
+                    );
+                    error!("steer_flows(): {}", cause);
+                    return Err(Fail::new(libc::EIO, &cause));
+                }
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Waits for the link of port `port_id` to come up, giving up after [LINK_UP_TIMEOUT].
+    fn wait_for_link(port_id: u16) -> Result<(), Fail> {
+        let deadline: Instant = Instant::now() + LINK_UP_TIMEOUT;
         loop {
-            unsafe {
+            let link: rte_eth_link = unsafe {
                 let mut link: MaybeUninit<rte_eth_link> = MaybeUninit::zeroed();
                 rte_eth_link_get_nowait(port_id, link.as_mut_ptr());
-                let link: rte_eth_link = link.assume_init();
-                if link.link_status() as u32 == RTE_ETH_LINK_UP {
-                    let duplex: &str = if link.link_duplex() as u32 == RTE_ETH_LINK_FULL_DUPLEX {
-                        "full"
-                    } else {
-                        "half"
-                    };
-                    eprintln!(
-                        "Port {} Link Up - speed {} Mbps - {} duplex",
-                        port_id, link.link_speed, duplex
-                    );
-                    break;
-                }
-                rte_delay_us_block(sleep_duration.as_micros() as u32);
+                link.assume_init()
+            };
+            if link.link_status() as u32 == RTE_ETH_LINK_UP {
+                let duplex: &str = if link.link_duplex() as u32 == RTE_ETH_LINK_FULL_DUPLEX {
+                    "full"
+                } else {
+                    "half"
+                };
+                eprintln!(
+                    "Port {} Link Up - speed {} Mbps - {} duplex",
+                    port_id, link.link_speed, duplex
+                );
+                return Ok(());
             }
-            if retry_count == 0 {
+            if Instant::now() >= deadline {
                 let cause: String = format!("Link never came up");
-                error!("initialize_dpdk_port(): {}", cause);
+                error!("wait_for_link(): {}", cause);
                 return Err(Fail::new(libc::EIO, &cause));
             }
-            retry_count -= 1;
+            unsafe { rte_delay_us_block(LINK_POLL_INTERVAL.as_micros() as u32) };
         }
+    }
 
-        Ok(())
+    /// Registers the calling thread with the EAL, unless it already is. DPDK only keeps per-core caches in front of
+    /// memory pools for registered threads, without which every allocation and free of a buffer goes to the shared
+    /// pool.
+    fn register_thread(port_id: u16) {
+        if unsafe { rte_lcore_id() } == LCORE_ID_ANY && unsafe { rte_thread_register() } != 0 {
+            let rte_errno: libc::c_int = unsafe { rte_errno() };
+            warn!(
+                "register_thread(): failed to register thread, buffers will not be cached (rte_errno={:?})",
+                rte_errno
+            );
+        }
+        let socket_id: i32 = unsafe { rte_eth_dev_socket_id(port_id) };
+        let local_socket_id: i32 = unsafe { rte_socket_id() } as i32;
+        if socket_id >= 0 && socket_id != local_socket_id {
+            warn!(
+                "register_thread(): thread runs on a different NUMA node than the device (socket_id={:?}, device={:?})",
+                local_socket_id, socket_id
+            );
+        }
+    }
+
+    /// Hooks the RX interrupt of queue `queue_id` up to the epoll instance of the calling thread, so that the thread can
+    /// sleep until packets arrive. Returns whether this succeeded, which it does not if the device has no RX interrupts.
+    fn register_rx_interrupt(port_id: u16, queue_id: u16) -> bool {
+        let ret: libc::c_int = unsafe { rte_eth_dev_rx_intr_ctl_q_per_thread(port_id, queue_id) };
+        if ret != 0 {
+            warn!(
+                "register_rx_interrupt(): failed to set up rx interrupt, falling back to busy polling (ret={:?})",
+                ret
+            );
+            return false;
+        }
+        true
+    }
+
+    /// Gets the fill level and miss counters of the memory pool of this runtime.
+    pub fn body_pool_stats(&self) -> MemoryPoolStats {
+        self.mm.body_pool_stats()
+    }
+}
+
+impl DPDKRuntime {
+    /// Hands all staged outgoing packets to the device in as few bursts as possible. Packets that the device does not
+    /// accept are dropped, as the transmit ring is full and upper layers are expected to recover from the loss.
+    fn flush_tx_batch(&mut self) {
+        timer!("catnip::runtime::flush_tx_batch");
+        self.tx_batch_start = None;
+        if self.tx_batch.is_empty() {
+            return;
+        }
+
+        let nb_pkts: usize = self.tx_batch.len();
+        let mut nb_sent: usize = 0;
+        while nb_sent < nb_pkts {
+            let pkts: *mut *mut rte_mbuf = unsafe { self.tx_batch.as_mut_ptr().add(nb_sent) };
+            let n: u16 = unsafe { rte_eth_tx_burst(self.port_id, self.queue_id, pkts, (nb_pkts - nb_sent) as u16) };
+            if n == 0 {
+                break;
+            }
+            stats::record_tx_burst();
+            nb_sent += n as usize;
+        }
+
+        if nb_sent < nb_pkts {
+            stats::record_tx_drops(nb_pkts - nb_sent);
+            warn!(
+                "flush_tx_batch(): transmit ring is full, dropping packets (dropped={:?})",
+                nb_pkts - nb_sent
+            );
+            for &mbuf_ptr in &self.tx_batch[nb_sent..] {
+                // Safety: the device did not take ownership of this packet, so we still own it.
+                unsafe { rte_pktmbuf_free(mbuf_ptr) };
+            }
+        }
+
+        self.tx_batch.clear();
+    }
+
+    /// Gets the lengths of the Ethernet, IPv4 and TCP headers of `pkt`, which are all in its first segment.
+    fn tcp_headers_len(pkt: &DemiBuffer) -> (u16, u16, u16) {
+        let l2_len: usize = ETHERNET2_HEADER_SIZE;
+        let l3_len: usize = ((pkt[l2_len] & 0xf) as usize) * 4;
+        let l4_len: usize = ((pkt[l2_len + l3_len + 12] >> 4) as usize) * 4;
+        (l2_len as u16, l3_len as u16, l4_len as u16)
     }
 }
 
@@ -322,6 +663,13 @@ impl DerefMut for SharedDPDKRuntime {
     }
 }
 
+impl Drop for DPDKRuntime {
+    fn drop(&mut self) {
+        // Make sure that staged packets are not leaked.
+        self.flush_tx_batch();
+    }
+}
+
 impl PhysicalLayer for SharedDPDKRuntime {
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
         timer!("catnip::runtime::transmit");
@@ -330,37 +678,116 @@ impl PhysicalLayer for SharedDPDKRuntime {
         let outgoing_pkt: DemiBuffer = match pkt {
             buf if buf.is_dpdk_allocated() => buf,
             buf => {
+                // Heap-allocated packets may carry their payload in a separate segment (e.g., when it resides in
+                // registered application memory), so we gather all segments into the mbuf.
                 let mut mbuf: DemiBuffer = self.mm.alloc_body_mbuf().expect("should be able to allocate mbuf");
-                debug_assert!(buf.len() < mbuf.len());
-                mbuf.trim(mbuf.len() - buf.len()).expect("Should be able to trim");
-                mbuf.copy_from_slice(&buf);
+                debug_assert!(buf.chain_len() < mbuf.len());
+                mbuf.trim(mbuf.len() - buf.chain_len()).expect("Should be able to trim");
+                let mut offset: usize = 0;
+                for segment in buf.segments() {
+                    mbuf[offset..(offset + segment.len())].copy_from_slice(segment);
+                    offset += segment.len();
+                }
 
                 mbuf
             },
         };
 
-        let mut mbuf_ptr: *mut rte_mbuf = expect_some!(outgoing_pkt.into_mbuf(), "mbuf cannot be empty");
-        let num_sent: u16 = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut mbuf_ptr, 1) };
-        debug_assert_eq!(num_sent, 1);
+        // Only packets that were already in mbufs may still be marked for segmentation (see offloads_segmentation()).
+        let tso_headers_len: Option<(u16, u16, u16)> = match outgoing_pkt.tso_segment_size() {
+            0 => None,
+            _ => Some(DPDKRuntime::tcp_headers_len(&outgoing_pkt)),
+        };
+        let mbuf_ptr: *mut rte_mbuf = expect_some!(outgoing_pkt.into_mbuf(), "mbuf cannot be empty");
+        if let Some((l2_len, l3_len, l4_len)) = tso_headers_len {
+            // Safety: the headers are in the first segment of the mbuf, which we own.
+            unsafe { rte_pktmbuf_set_tcp_tso(mbuf_ptr, l2_len, l3_len, l4_len) };
+        }
+        self.tx_batch.push(mbuf_ptr);
+
+        // Flush the batch once it is full or once the oldest staged packet has waited long enough. Otherwise, the batch
+        // goes out when the network stack finishes its current pass over the scheduler.
+        match self.tx_batch_start {
+            _ if self.tx_batch.is_full() => self.flush_tx_batch(),
+            Some(start) if start.elapsed() >= TRANSMIT_BATCH_TIMEOUT => self.flush_tx_batch(),
+            Some(_) => (),
+            None => self.tx_batch_start = Some(Instant::now()),
+        }
+
         Ok(())
     }
 
-    fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
+    fn flush(&mut self) -> Result<(), Fail> {
+        self.flush_tx_batch();
+        Ok(())
+    }
+
+    fn offloads_segmentation(&self, pkt: &DemiBuffer) -> bool {
+        // Other packets get copied into a single mbuf, which may not fit a large segment.
+        self.tcp_segmentation_offload && pkt.is_dpdk_allocated()
+    }
+
+    fn ephemeral_port_share(&self) -> (u16, u16) {
+        // This matches the flow rules of steer_flows().
+        (self.queue_id, self.num_queues)
+    }
+
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
         timer!("catnip::runtime::receive");
 
-        let mut out = ArrayVec::new();
-        let mut packets: [*mut rte_mbuf; RECEIVE_BATCH_SIZE] = unsafe { mem::zeroed() };
-        let nb_rx = unsafe { rte_eth_rx_burst(self.port_id, 0, packets.as_mut_ptr(), RECEIVE_BATCH_SIZE as u16) };
-        assert!(nb_rx as usize <= RECEIVE_BATCH_SIZE);
+        let burst_size: usize = burst_size.min(batch.remaining_capacity());
+        if burst_size == 0 {
+            return Ok(());
+        }
 
-        {
-            for &packet in &packets[..nb_rx as usize] {
-                // Safety: `packet` is a valid pointer to a properly initialized `rte_mbuf` struct.
-                let buf: DemiBuffer = unsafe { DemiBuffer::from_mbuf(packet) };
-                out.push(buf);
-            }
+        // The device only writes the first `nb_rx` entries, so there is no need to initialize this array.
+        let mut packets: [MaybeUninit<*mut rte_mbuf>; MAX_RECEIVE_BATCH_SIZE] =
+            [MaybeUninit::uninit(); MAX_RECEIVE_BATCH_SIZE];
+        let nb_rx: u16 = unsafe {
+            rte_eth_rx_burst(
+                self.port_id,
+                self.queue_id,
+                packets.as_mut_ptr() as *mut *mut rte_mbuf,
+                burst_size as u16,
+            )
+        };
+        assert!(nb_rx as usize <= burst_size);
+
+        for packet in &packets[..nb_rx as usize] {
+            // Safety: the first `nb_rx` entries were initialized by the device with valid pointers to properly
+            // initialized `rte_mbuf` structs.
+            let buf: DemiBuffer = unsafe { DemiBuffer::from_mbuf(packet.assume_init()) };
+            batch.push(buf);
+        }
+
+        Ok(())
+    }
+
+    fn wait_for_packets(&mut self, timeout: Duration) -> Result<(), Fail> {
+        timer!("catnip::runtime::wait_for_packets");
+        // Interrupts come through epoll, which only takes whole milliseconds.
+        let timeout_ms: libc::c_int = timeout.as_millis().min(libc::c_int::MAX as u128) as libc::c_int;
+        if !self.rx_interrupts || timeout_ms == 0 {
+            return Ok(());
         }
 
-        Ok(out)
+        if unsafe { rte_eth_dev_rx_intr_enable(self.port_id, self.queue_id) } != 0 {
+            let cause: String = format!("failed to enable rx interrupt (queue_id={:?})", self.queue_id);
+            warn!("wait_for_packets(): {}", cause);
+            return Err(Fail::new(libc::EIO, &cause));
+        }
+        // Packets that arrived before we armed the interrupt do not raise it, so we only sleep if the queue is empty.
+        // Devices that cannot tell how many packets are in the queue report an error, in which case we sleep anyway.
+        if unsafe { rte_eth_rx_queue_count(self.port_id, self.queue_id) } <= 0 {
+            // Waking up early or on a spurious interrupt is harmless, as the network stack goes back to polling.
+            unsafe { rte_epoll_wait_per_thread(timeout_ms) };
+        }
+        unsafe { rte_eth_dev_rx_intr_disable(self.port_id, self.queue_id) };
+
+        Ok(())
     }
 }
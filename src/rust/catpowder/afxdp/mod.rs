@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Modules
+//======================================================================================================================
+
+mod program;
+mod ring;
+mod socket;
+mod umem;
+
+//======================================================================================================================
+// Exports
+//======================================================================================================================
+
+pub mod runtime;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::expect_some;
+use ::std::io;
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Gets the error code of the last system call that failed.
+fn last_errno() -> i32 {
+    expect_some!(
+        io::Error::last_os_error().raw_os_error(),
+        "should have an os error code"
+    )
+}
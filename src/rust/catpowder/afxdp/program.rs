@@ -0,0 +1,229 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{catpowder::afxdp::last_errno, runtime::fail::Fail};
+use ::std::mem;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Commands of the bpf() system call that we use.
+const BPF_MAP_CREATE: libc::c_int = 0;
+const BPF_MAP_UPDATE_ELEM: libc::c_int = 2;
+const BPF_PROG_LOAD: libc::c_int = 5;
+const BPF_LINK_CREATE: libc::c_int = 28;
+
+/// A map whose values are AF_XDP sockets.
+const BPF_MAP_TYPE_XSKMAP: u32 = 17;
+/// A program that runs on every packet that a network interface receives.
+const BPF_PROG_TYPE_XDP: u32 = 6;
+/// Attaches a program to the receive path of a network interface.
+const BPF_XDP: u32 = 37;
+/// Tells the kernel that the immediate of a 64-bit load is a map file descriptor.
+const BPF_PSEUDO_MAP_FD: u8 = 1;
+/// Helper that redirects a packet to the target entry of a map.
+const BPF_FUNC_REDIRECT_MAP: i32 = 51;
+/// Hands a packet to the kernel network stack.
+const XDP_PASS: i32 = 2;
+/// Offset of the receive queue index in the context of an XDP program.
+const XDP_MD_RX_QUEUE_INDEX: i16 = 16;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A BPF instruction.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct BpfInsn {
+    code: u8,
+    /// Destination register in the low nibble and source register in the high one.
+    regs: u8,
+    off: i16,
+    imm: i32,
+}
+
+/// Arguments of [BPF_MAP_CREATE].
+#[repr(C)]
+struct MapCreateAttr {
+    map_type: u32,
+    key_size: u32,
+    value_size: u32,
+    max_entries: u32,
+    map_flags: u32,
+}
+
+/// Arguments of [BPF_MAP_UPDATE_ELEM].
+#[repr(C)]
+struct MapUpdateAttr {
+    map_fd: u32,
+    _pad: u32,
+    key: u64,
+    value: u64,
+    flags: u64,
+}
+
+/// Arguments of [BPF_PROG_LOAD].
+#[repr(C)]
+struct ProgLoadAttr {
+    prog_type: u32,
+    insn_cnt: u32,
+    insns: u64,
+    license: u64,
+    log_level: u32,
+    log_size: u32,
+    log_buf: u64,
+    kern_version: u32,
+    prog_flags: u32,
+    prog_name: [u8; 16],
+}
+
+/// Arguments of [BPF_LINK_CREATE].
+#[repr(C)]
+struct LinkCreateAttr {
+    prog_fd: u32,
+    target_ifindex: u32,
+    attach_type: u32,
+    flags: u32,
+}
+
+/// An XDP program that redirects the packets that each queue of a network interface receives to the AF_XDP socket that
+/// is bound to that queue. Packets on queues without a socket go to the kernel network stack. The program stays
+/// attached to the network interface for as long as this structure lives.
+pub struct XdpProgram {
+    /// Map from queue indexes to sockets.
+    map_fd: libc::c_int,
+    /// Loaded program.
+    prog_fd: libc::c_int,
+    /// Attachment of the program to the network interface.
+    link_fd: libc::c_int,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl XdpProgram {
+    /// Loads the program and attaches it to the network interface `ifindex`, which has `nr_queues` queues.
+    pub fn new(ifindex: u32, nr_queues: u32) -> Result<Self, Fail> {
+        trace!("creating xdp program");
+        let mut program: Self = Self {
+            map_fd: -1,
+            prog_fd: -1,
+            link_fd: -1,
+        };
+
+        let map_attr: MapCreateAttr = MapCreateAttr {
+            map_type: BPF_MAP_TYPE_XSKMAP,
+            key_size: mem::size_of::<u32>() as u32,
+            value_size: mem::size_of::<u32>() as u32,
+            max_entries: nr_queues,
+            map_flags: 0,
+        };
+        program.map_fd = bpf(BPF_MAP_CREATE, &map_attr, "failed to create xsk map")?;
+
+        // r2 = ctx->rx_queue_index; r1 = map; r3 = XDP_PASS; return bpf_redirect_map(r1, r2, r3);
+        let insns: [BpfInsn; 6] = [
+            insn(0x61, 2, 1, XDP_MD_RX_QUEUE_INDEX, 0),
+            insn(0x18, 1, BPF_PSEUDO_MAP_FD, 0, program.map_fd),
+            insn(0x00, 0, 0, 0, 0),
+            insn(0xb7, 3, 0, 0, XDP_PASS),
+            insn(0x85, 0, 0, 0, BPF_FUNC_REDIRECT_MAP),
+            insn(0x95, 0, 0, 0, 0),
+        ];
+        let license: &[u8] = b"Dual MIT/GPL\0";
+        let mut prog_name: [u8; 16] = [0; 16];
+        prog_name[..11].copy_from_slice(b"demikernel\0");
+        let prog_attr: ProgLoadAttr = ProgLoadAttr {
+            prog_type: BPF_PROG_TYPE_XDP,
+            insn_cnt: insns.len() as u32,
+            insns: insns.as_ptr() as u64,
+            license: license.as_ptr() as u64,
+            log_level: 0,
+            log_size: 0,
+            log_buf: 0,
+            kern_version: 0,
+            prog_flags: 0,
+            prog_name,
+        };
+        program.prog_fd = bpf(BPF_PROG_LOAD, &prog_attr, "failed to load xdp program")?;
+
+        // Let the kernel pick native mode if the driver supports it and generic mode otherwise.
+        let link_attr: LinkCreateAttr = LinkCreateAttr {
+            prog_fd: program.prog_fd as u32,
+            target_ifindex: ifindex,
+            attach_type: BPF_XDP,
+            flags: 0,
+        };
+        program.link_fd = bpf(BPF_LINK_CREATE, &link_attr, "failed to attach xdp program")?;
+
+        Ok(program)
+    }
+
+    /// Redirects the packets of queue `queueid` to the AF_XDP socket `fd`.
+    pub fn insert(&mut self, queueid: u32, fd: libc::c_int) -> Result<(), Fail> {
+        let value: u32 = fd as u32;
+        let attr: MapUpdateAttr = MapUpdateAttr {
+            map_fd: self.map_fd as u32,
+            _pad: 0,
+            key: &queueid as *const u32 as u64,
+            value: &value as *const u32 as u64,
+            flags: 0,
+        };
+        bpf(BPF_MAP_UPDATE_ELEM, &attr, "failed to insert socket in xsk map")?;
+        Ok(())
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Builds a BPF instruction.
+const fn insn(code: u8, dst: u8, src: u8, off: i16, imm: i32) -> BpfInsn {
+    BpfInsn {
+        code,
+        regs: dst | (src << 4),
+        off,
+        imm,
+    }
+}
+
+/// Runs the bpf() system call `cmd` with the arguments in `attr`.
+fn bpf<T>(cmd: libc::c_int, attr: &T, what: &str) -> Result<libc::c_int, Fail> {
+    let ret: libc::c_long = unsafe {
+        libc::syscall(
+            libc::SYS_bpf,
+            cmd,
+            attr as *const T,
+            mem::size_of::<T>() as libc::c_uint,
+        )
+    };
+    if ret < 0 {
+        let errno: i32 = last_errno();
+        let cause: String = format!("{} (errno={:?})", what, errno);
+        error!("bpf(): {}", cause);
+        return Err(Fail::new(errno, &cause));
+    }
+    Ok(ret as libc::c_int)
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for XdpProgram {
+    fn drop(&mut self) {
+        // Closing the link detaches the program from the network interface.
+        for fd in [self.link_fd, self.prog_fd, self.map_fd] {
+            if fd >= 0 && unsafe { libc::close(fd) } != 0 {
+                warn!("drop(): failed to close bpf object");
+            }
+        }
+    }
+}
@@ -0,0 +1,241 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{catpowder::afxdp::last_errno, runtime::fail::Fail};
+use ::std::{
+    marker::PhantomData,
+    mem, ptr,
+    sync::atomic::{AtomicU32, Ordering},
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A single-producer single-consumer ring that an AF_XDP socket shares with the kernel through a memory mapping. We
+/// are the producer of the fill and tx rings and the consumer of the rx and completion rings.
+pub struct XdpRing<T> {
+    /// Start of the memory mapping.
+    mmap: *mut libc::c_void,
+    /// Length of the memory mapping.
+    mmap_len: usize,
+    /// Index of the next element that the producer will write.
+    producer: *const AtomicU32,
+    /// Index of the next element that the consumer will read.
+    consumer: *const AtomicU32,
+    /// Flags that the kernel sets on the ring (e.g., whether it needs a wakeup).
+    flags: *const AtomicU32,
+    /// Elements of the ring.
+    descs: *mut T,
+    /// Number of elements in the ring. This is a power of two.
+    size: u32,
+    /// Our view of the producer index, which runs ahead of the shared one for reserved elements.
+    cached_prod: u32,
+    /// Our view of the consumer index, which runs ahead of the shared one for reserved elements.
+    cached_cons: u32,
+    _phantom: PhantomData<T>,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl<T> XdpRing<T> {
+    /// Maps the ring with `size` elements that lives at page offset `pgoff` of the socket `fd`. The layout of the
+    /// mapping is described by `offsets`.
+    pub fn new(fd: libc::c_int, size: u32, pgoff: u64, offsets: &libc::xdp_ring_offset) -> Result<Self, Fail> {
+        let mmap_len: usize = offsets.desc as usize + size as usize * mem::size_of::<T>();
+        let mmap: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                mmap_len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                fd,
+                pgoff as libc::off_t,
+            )
+        };
+        if mmap == libc::MAP_FAILED {
+            let errno: i32 = last_errno();
+            let cause: String = format!("failed to map ring (errno={:?})", errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        let base: *mut u8 = mmap as *mut u8;
+        let producer: *const AtomicU32 = unsafe { base.add(offsets.producer as usize) } as *const AtomicU32;
+        let consumer: *const AtomicU32 = unsafe { base.add(offsets.consumer as usize) } as *const AtomicU32;
+        let (cached_prod, cached_cons): (u32, u32) =
+            unsafe { ((*producer).load(Ordering::Relaxed), (*consumer).load(Ordering::Relaxed)) };
+
+        Ok(Self {
+            mmap,
+            mmap_len,
+            producer,
+            consumer,
+            flags: unsafe { base.add(offsets.flags as usize) } as *const AtomicU32,
+            descs: unsafe { base.add(offsets.desc as usize) } as *mut T,
+            size,
+            cached_prod,
+            cached_cons,
+            _phantom: PhantomData,
+        })
+    }
+
+    /// Reserves up to `count` elements for the producer, starting at `idx`. Returns the number of elements reserved.
+    pub fn producer_reserve(&mut self, count: u32, idx: &mut u32) -> u32 {
+        let mut free: u32 = self.size - self.cached_prod.wrapping_sub(self.cached_cons);
+        if free < count {
+            self.cached_cons = unsafe { (*self.consumer).load(Ordering::Acquire) };
+            free = self.size - self.cached_prod.wrapping_sub(self.cached_cons);
+        }
+        let count: u32 = count.min(free);
+        *idx = self.cached_prod;
+        self.cached_prod = self.cached_prod.wrapping_add(count);
+        count
+    }
+
+    /// Hands `count` reserved elements over to the consumer.
+    pub fn producer_submit(&mut self, count: u32) {
+        unsafe {
+            let producer: u32 = (*self.producer).load(Ordering::Relaxed);
+            (*self.producer).store(producer.wrapping_add(count), Ordering::Release);
+        }
+    }
+
+    /// Reserves up to `count` elements for the consumer, starting at `idx`. Returns the number of elements reserved.
+    pub fn consumer_reserve(&mut self, count: u32, idx: &mut u32) -> u32 {
+        let mut available: u32 = self.cached_prod.wrapping_sub(self.cached_cons);
+        if available < count {
+            self.cached_prod = unsafe { (*self.producer).load(Ordering::Acquire) };
+            available = self.cached_prod.wrapping_sub(self.cached_cons);
+        }
+        let count: u32 = count.min(available);
+        *idx = self.cached_cons;
+        self.cached_cons = self.cached_cons.wrapping_add(count);
+        count
+    }
+
+    /// Hands `count` consumed elements back to the producer.
+    pub fn consumer_release(&mut self, count: u32) {
+        unsafe {
+            let consumer: u32 = (*self.consumer).load(Ordering::Relaxed);
+            (*self.consumer).store(consumer.wrapping_add(count), Ordering::Release);
+        }
+    }
+
+    /// Gets the element at the target index.
+    pub fn get_element(&mut self, idx: u32) -> &mut T {
+        unsafe { &mut *self.descs.add((idx & (self.size - 1)) as usize) }
+    }
+
+    /// Checks whether the kernel waits for a system call before it processes this ring again.
+    pub fn needs_wakeup(&self) -> bool {
+        unsafe { (*self.flags).load(Ordering::Relaxed) & libc::XDP_RING_NEED_WAKEUP != 0 }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl<T> Drop for XdpRing<T> {
+    fn drop(&mut self) {
+        if unsafe { libc::munmap(self.mmap, self.mmap_len) } != 0 {
+            warn!("drop(): failed to unmap ring");
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::XdpRing;
+    use crate::ensure_eq;
+    use ::anyhow::Result;
+
+    /// Size of the shared memory that backs the rings of these tests.
+    const MMAP_SIZE: usize = 4096;
+
+    /// Maps a producer and a consumer on the same ring of `size` elements, with the consumer standing in for the
+    /// kernel.
+    fn ring_pair(size: u32) -> Result<(XdpRing<u64>, XdpRing<u64>)> {
+        let fd: libc::c_int = unsafe { libc::memfd_create(c"xdp-ring".as_ptr(), 0) };
+        anyhow::ensure!(fd >= 0, "failed to create memory file");
+        anyhow::ensure!(unsafe { libc::ftruncate(fd, MMAP_SIZE as libc::off_t) } == 0);
+        let mut offsets: libc::xdp_ring_offset = unsafe { std::mem::zeroed() };
+        offsets.producer = 0;
+        offsets.consumer = 64;
+        offsets.flags = 128;
+        offsets.desc = 192;
+        let producer: XdpRing<u64> = XdpRing::new(fd, size, 0, &offsets)?;
+        let consumer: XdpRing<u64> = XdpRing::new(fd, size, 0, &offsets)?;
+        // The mappings keep the memory alive.
+        unsafe { libc::close(fd) };
+        Ok((producer, consumer))
+    }
+
+    /// Consumes all elements that are available and returns them.
+    fn consume_all(consumer: &mut XdpRing<u64>, size: u32) -> Vec<u64> {
+        let mut idx: u32 = 0;
+        let count: u32 = consumer.consumer_reserve(size, &mut idx);
+        let elements: Vec<u64> = (0..count).map(|i| *consumer.get_element(idx.wrapping_add(i))).collect();
+        consumer.consumer_release(count);
+        elements
+    }
+
+    /// Tests that reservations are cut to the room in the ring and that elements come out in order across the end of
+    /// the ring.
+    #[test]
+    fn test_xdp_ring_reserve_and_wrap_around() -> Result<()> {
+        const SIZE: u32 = 4;
+        let (mut producer, mut consumer): (XdpRing<u64>, XdpRing<u64>) = ring_pair(SIZE)?;
+        let mut idx: u32 = 0;
+
+        ensure_eq!(producer.producer_reserve(3, &mut idx), 3);
+        for i in 0..3 {
+            *producer.get_element(idx.wrapping_add(i)) = i as u64;
+        }
+        // Nothing is visible before the producer submits.
+        ensure_eq!(consume_all(&mut consumer, SIZE), vec![]);
+        producer.producer_submit(3);
+        ensure_eq!(consume_all(&mut consumer, SIZE), vec![0, 1, 2]);
+
+        // The consumer released all elements, so the ring has room for all of them again, across its end.
+        ensure_eq!(producer.producer_reserve(SIZE, &mut idx), SIZE);
+        for i in 0..SIZE {
+            *producer.get_element(idx.wrapping_add(i)) = 10 + i as u64;
+        }
+        producer.producer_submit(SIZE);
+        ensure_eq!(producer.producer_reserve(1, &mut idx), 0);
+        ensure_eq!(consume_all(&mut consumer, SIZE), vec![10, 11, 12, 13]);
+
+        Ok(())
+    }
+
+    /// Tests that the producer only reuses elements that the consumer has released.
+    #[test]
+    fn test_xdp_ring_partial_release() -> Result<()> {
+        const SIZE: u32 = 4;
+        let (mut producer, mut consumer): (XdpRing<u64>, XdpRing<u64>) = ring_pair(SIZE)?;
+        let mut idx: u32 = 0;
+
+        ensure_eq!(producer.producer_reserve(SIZE, &mut idx), SIZE);
+        producer.producer_submit(SIZE);
+
+        // The consumer reads two elements but only releases one of them.
+        ensure_eq!(consumer.consumer_reserve(2, &mut idx), 2);
+        consumer.consumer_release(1);
+        ensure_eq!(producer.producer_reserve(2, &mut idx), 1);
+        ensure_eq!(idx, SIZE);
+
+        Ok(())
+    }
+}
@@ -0,0 +1,343 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::afxdp::{program::XdpProgram, socket::XdpSocket, umem::Umem},
+    demi_sgarray_t,
+    demikernel::config::Config,
+    expect_ok, expect_some,
+    inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
+    runtime::{
+        fail::Fail,
+        memory::{alloc_buffer_chain, buffer_into_sgarray, DemiBuffer, MemoryRuntime},
+        network::consts::{MAX_RECEIVE_BATCH_SIZE, TRANSMIT_BATCH_SIZE, TRANSMIT_BATCH_TIMEOUT},
+        Runtime, SharedObject,
+    },
+    timer,
+};
+use ::arrayvec::ArrayVec;
+use ::std::{collections::VecDeque, ffi::CString, time::Instant};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A LibOS built on top of Linux AF_XDP sockets.
+#[derive(Clone)]
+pub struct SharedCatpowderRuntime(SharedObject<CatpowderRuntimeInner>);
+
+/// The inner state of the Catpowder runtime.
+struct CatpowderRuntimeInner {
+    /// One socket per queue of the network interface. Packets go out on the first one.
+    sockets: Vec<XdpSocket>,
+    /// Buffers of the frames that the kernel owns for receiving, indexed by frame.
+    rx_posted: Vec<Option<DemiBuffer>>,
+    /// Packets that the kernel may still be transmitting, along with their address, in the order that they were
+    /// handed to it.
+    tx_inflight: VecDeque<(u64, DemiBuffer)>,
+    /// Packets that did not fit in the tx ring, along with their address, in the order that they were sent. They are
+    /// bounded by the number of frames in the region.
+    tx_queued: VecDeque<(u64, DemiBuffer)>,
+    /// Number of packets in the tx ring that the kernel does not know about yet.
+    tx_pending: u32,
+    /// Time at which the oldest of these packets was staged.
+    tx_start: Option<Instant>,
+    /// Number of elements in each ring.
+    ring_size: u32,
+    /// Queue that we receive from first in the next burst, so that all queues get served.
+    next_rx_queue: usize,
+    /// Redirects packets to the sockets.
+    program: XdpProgram,
+    /// Frames that back all packets that we send and receive. This comes last, so that the frames that the sockets
+    /// hold are freed before the region is dropped.
+    umem: Umem,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl SharedCatpowderRuntime {
+    /// Instantiates a new AF_XDP runtime.
+    pub fn new(config: &Config) -> Result<Self, Fail> {
+        let ifname: String = config.local_interface_name()?;
+        let ifindex: u32 = match CString::new(ifname.clone()) {
+            Ok(ifname) => unsafe { libc::if_nametoindex(ifname.as_ptr()) },
+            Err(_) => 0,
+        };
+        if ifindex == 0 {
+            let cause: String = format!("invalid network interface: {:?}", ifname);
+            error!("new(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        let nr_queues: u32 = config.xdp_queue_count()?;
+        let ring_size: u32 = config.xdp_ring_size()?;
+
+        // Each queue holds frames in its fill and rx rings, the transmit path holds frames in the tx and completion
+        // rings, and the rest is left for the application.
+        let umem: Umem = Umem::new((nr_queues + 2) * 2 * ring_size)?;
+        let program: XdpProgram = XdpProgram::new(ifindex, nr_queues)?;
+        let mut sockets: Vec<XdpSocket> = Vec::with_capacity(nr_queues as usize);
+        for queueid in 0..nr_queues {
+            let socket: XdpSocket = XdpSocket::new(&umem, ifindex, queueid, ring_size, sockets.first())?;
+            sockets.push(socket);
+        }
+
+        let mut inner: CatpowderRuntimeInner = CatpowderRuntimeInner {
+            rx_posted: (0..umem.nr_frames()).map(|_| None).collect(),
+            sockets,
+            tx_inflight: VecDeque::with_capacity(ring_size as usize),
+            tx_queued: VecDeque::new(),
+            tx_pending: 0,
+            tx_start: None,
+            ring_size,
+            next_rx_queue: 0,
+            program,
+            umem,
+        };
+        // Give the kernel receive buffers before it starts to redirect packets to the sockets.
+        for queueid in 0..inner.sockets.len() {
+            inner.refill(queueid);
+            inner.program.insert(queueid as u32, inner.sockets[queueid].fd())?;
+        }
+        info!(
+            "catpowder runs on {:?} queues of {} (zero_copy={:?})",
+            nr_queues,
+            ifname,
+            inner.sockets[0].is_zero_copy()
+        );
+
+        Ok(Self(SharedObject::new(inner)))
+    }
+}
+
+impl CatpowderRuntimeInner {
+    /// Hands free frames to the kernel for receiving on queue `queueid`.
+    fn refill(&mut self, queueid: usize) {
+        let count: u32 = self.ring_size.min(self.umem.nr_free() as u32);
+        let mut idx: u32 = 0;
+        let socket: &mut XdpSocket = &mut self.sockets[queueid];
+        let count: u32 = socket.reserve_rx_fill(count, &mut idx);
+        if count == 0 {
+            return;
+        }
+        for i in 0..count {
+            let buf: DemiBuffer = expect_some!(self.umem.alloc(), "frames should be free");
+            let offset: u64 = expect_some!(self.umem.offset_of(&buf), "frame should be in the region");
+            let frame: usize = Umem::frame_index(offset);
+            socket.set_rx_fill(idx.wrapping_add(i), (frame * Umem::FRAME_SIZE) as u64);
+            self.rx_posted[frame] = Some(buf);
+        }
+        socket.submit_rx_fill(count);
+        socket.wakeup_rx_fill();
+    }
+
+    /// Takes back the frames of packets that the kernel has transmitted.
+    fn reap_tx_completions(&mut self) {
+        let mut idx: u32 = 0;
+        let socket: &mut XdpSocket = &mut self.sockets[0];
+        let count: u32 = socket.reserve_tx_completion(self.ring_size, &mut idx);
+        for i in 0..count {
+            let addr: u64 = socket.get_tx_completion(idx.wrapping_add(i));
+            // The kernel completes packets in the order that it got them. Dropping the buffer frees the frame.
+            let (expected, _): (u64, DemiBuffer) =
+                expect_some!(self.tx_inflight.pop_front(), "packet should be in flight");
+            debug_assert_eq!(addr, expected);
+        }
+        if count > 0 {
+            socket.release_tx_completion(count);
+        }
+    }
+
+    /// Moves queued packets into the tx ring, for as long as it has room.
+    fn stage_tx_queued(&mut self) {
+        let mut idx: u32 = 0;
+        let count: u32 = self.sockets[0].reserve_tx(self.tx_queued.len() as u32, &mut idx);
+        for i in 0..count {
+            let (addr, buf): (u64, DemiBuffer) = expect_some!(self.tx_queued.pop_front(), "packet should be queued");
+            self.sockets[0].set_tx(idx.wrapping_add(i), addr, buf.len() as u32);
+            self.tx_inflight.push_back((addr, buf));
+        }
+        self.tx_pending += count;
+    }
+
+    /// Hands all staged outgoing packets to the kernel.
+    fn flush_tx_batch(&mut self) -> Result<(), Fail> {
+        timer!("catpowder::afxdp::flush_tx_batch");
+        self.tx_start = None;
+        if self.tx_pending > 0 {
+            self.sockets[0].submit_tx(self.tx_pending);
+            self.tx_pending = 0;
+        }
+        // In copy mode, the kernel only transmits when we ask it to, so keep asking while packets are in flight.
+        if !self.tx_inflight.is_empty() {
+            self.sockets[0].wakeup_tx()?;
+        }
+        self.reap_tx_completions();
+
+        // Completions made room in the tx ring, so stage the packets that wait for it. They go out on the next flush.
+        if !self.tx_queued.is_empty() {
+            self.stage_tx_queued();
+            if self.tx_pending > 0 {
+                self.tx_start = Some(Instant::now());
+            }
+        }
+        Ok(())
+    }
+
+    /// Copies a packet into a free frame.
+    fn copy_to_frame(&mut self, pkt: &DemiBuffer) -> Result<DemiBuffer, Fail> {
+        let pkt_size: usize = pkt.chain_len();
+        let mut buf: DemiBuffer = match self.umem.alloc() {
+            Some(buf) => buf,
+            None => {
+                let cause: String = format!("no free frames");
+                warn!("copy_to_frame(): {}", cause);
+                return Err(Fail::new(libc::EAGAIN, &cause));
+            },
+        };
+        if pkt_size > buf.len() {
+            let cause: String = format!("packet is too large: {:?}", pkt_size);
+            warn!("copy_to_frame(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        }
+        let mut offset: usize = 0;
+        for segment in pkt.segments() {
+            buf[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
+        buf.trim(buf.len() - pkt_size)?;
+        Ok(buf)
+    }
+
+    /// Stages a packet in the tx ring. Packets that reside in a single frame are sent from it. Others are copied into
+    /// a free frame first.
+    fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        let buf: DemiBuffer = match (pkt.num_segments(), self.umem.offset_of(&pkt)) {
+            (1, Some(_)) => pkt,
+            _ => self.copy_to_frame(&pkt)?,
+        };
+        let addr: u64 = expect_some!(self.umem.offset_of(&buf), "packet should be in the region");
+
+        // Packets that wait for room in the tx ring go first, so that packets leave in order.
+        self.tx_queued.push_back((addr, buf));
+        self.stage_tx_queued();
+        if !self.tx_queued.is_empty() {
+            // The tx ring is full, so push what it holds to the kernel and reap what it has sent. Packets that still
+            // do not fit stay queued until a later flush makes room for them.
+            self.flush_tx_batch()?;
+        }
+
+        // Flush the batch once it is full or once the oldest staged packet has waited long enough. Otherwise, the
+        // batch goes out when the network stack finishes its current pass over the scheduler.
+        match self.tx_start {
+            _ if self.tx_pending as usize >= TRANSMIT_BATCH_SIZE => self.flush_tx_batch(),
+            Some(start) if start.elapsed() >= TRANSMIT_BATCH_TIMEOUT => self.flush_tx_batch(),
+            Some(_) => Ok(()),
+            None => {
+                self.tx_start = Some(Instant::now());
+                Ok(())
+            },
+        }
+    }
+
+    /// Polls for received packets. Packets are handed up the stack in the frames that the kernel wrote them to.
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
+        timer!("catpowder::afxdp::receive");
+        let burst_size: usize = burst_size.min(batch.remaining_capacity());
+        if burst_size == 0 {
+            return Ok(());
+        }
+
+        let nr_queues: usize = self.sockets.len();
+        let first_queue: usize = self.next_rx_queue;
+        self.next_rx_queue = (first_queue + 1) % nr_queues;
+        for i in 0..nr_queues {
+            let queueid: usize = (first_queue + i) % nr_queues;
+            let remaining: u32 = (burst_size - batch.len()) as u32;
+            let mut idx: u32 = 0;
+            let count: u32 = self.sockets[queueid].reserve_rx(remaining, &mut idx);
+            for j in 0..count {
+                let (addr, len): (u64, u32) = self.sockets[queueid].get_rx(idx.wrapping_add(j));
+                let frame: usize = Umem::frame_index(addr);
+                let mut buf: DemiBuffer = expect_some!(self.rx_posted[frame].take(), "frame should be posted");
+                expect_ok!(
+                    buf.adjust((addr - Umem::data_offset(frame)) as usize),
+                    "packet should be in its frame"
+                );
+                expect_ok!(buf.trim(buf.len() - len as usize), "packet should fit in its frame");
+                batch.push(buf);
+            }
+            if count > 0 {
+                self.sockets[queueid].release_rx(count);
+            }
+            self.refill(queueid);
+
+            if batch.len() == burst_size {
+                break;
+            }
+        }
+
+        Ok(())
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Physical layer trait implementation for AF_XDP Runtime.
+impl PhysicalLayer for SharedCatpowderRuntime {
+    fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        self.0.transmit(pkt)
+    }
+
+    fn flush(&mut self) -> Result<(), Fail> {
+        self.0.flush_tx_batch()
+    }
+
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
+        self.0.receive(batch, burst_size)
+    }
+}
+
+/// Memory runtime trait implementation for AF_XDP Runtime.
+impl MemoryRuntime for SharedCatpowderRuntime {
+    /// Allocates a scatter-gather array. Arrays that fit in a frame are allocated in one, so that they are sent without
+    /// copying.
+    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
+        if size > 0 && MAX_HEADER_SIZE + size <= Umem::DATA_SIZE {
+            if let Some(mut buf) = self.0.umem.alloc() {
+                // Always allocate with header space for now even if we do not need it.
+                expect_ok!(buf.adjust(MAX_HEADER_SIZE), "frame should have space for headers");
+                expect_ok!(buf.trim(buf.len() - size), "frame should have space for data");
+                return buffer_into_sgarray(buf);
+            }
+        }
+
+        // Always allocate with header space for now even if we do not need it.
+        let buf: DemiBuffer = alloc_buffer_chain(
+            size,
+            u16::MAX - MAX_HEADER_SIZE as u16,
+            |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(segment_size, MAX_HEADER_SIZE as u16))
+            },
+        )?;
+        buffer_into_sgarray(buf)
+    }
+}
+
+/// Runtime trait implementation for AF_XDP Runtime.
+impl Runtime for SharedCatpowderRuntime {}
@@ -0,0 +1,307 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::afxdp::{last_errno, ring::XdpRing, umem::Umem},
+    runtime::fail::Fail,
+};
+use ::std::{mem, ptr};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// An AF_XDP socket that is bound to one queue of a network interface, along with the rings that it shares with the
+/// kernel.
+pub struct XdpSocket {
+    /// Underlying file descriptor.
+    fd: libc::c_int,
+    /// A ring for receiving packets.
+    rx_ring: XdpRing<libc::xdp_desc>,
+    /// A ring for handing receive buffers to the kernel.
+    rx_fill_ring: XdpRing<u64>,
+    /// A ring for transmitting packets.
+    tx_ring: XdpRing<libc::xdp_desc>,
+    /// A ring for getting transmit buffers back from the kernel.
+    tx_completion_ring: XdpRing<u64>,
+    /// Whether the network interface reads and writes the user memory region directly.
+    zero_copy: bool,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl XdpSocket {
+    /// Creates a socket that exchanges packets with queue `queueid` of the network interface `ifindex`, with rings of
+    /// `length` elements. The first socket registers `umem` and the following ones share it with `owner`.
+    pub fn new(umem: &Umem, ifindex: u32, queueid: u32, length: u32, owner: Option<&XdpSocket>) -> Result<Self, Fail> {
+        trace!("creating xdp socket (queueid={:?})", queueid);
+        let fd: libc::c_int = unsafe { libc::socket(libc::AF_XDP, libc::SOCK_RAW | libc::SOCK_CLOEXEC, 0) };
+        if fd < 0 {
+            let errno: i32 = last_errno();
+            let cause: String = format!("failed to create xdp socket (errno={:?})", errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        match Self::setup(fd, umem, ifindex, queueid, length, owner) {
+            Ok(socket) => Ok(socket),
+            Err(e) => {
+                unsafe { libc::close(fd) };
+                Err(e)
+            },
+        }
+    }
+
+    /// Registers the rings of the socket with the kernel, maps them and binds the socket.
+    fn setup(
+        fd: libc::c_int,
+        umem: &Umem,
+        ifindex: u32,
+        queueid: u32,
+        length: u32,
+        owner: Option<&XdpSocket>,
+    ) -> Result<Self, Fail> {
+        if owner.is_none() {
+            trace!("registering umem region");
+            setsockopt(fd, libc::XDP_UMEM_REG, &umem.as_umem_reg())?;
+        }
+        // Every socket needs its own fill and completion rings, even when it shares the user memory region.
+        setsockopt(fd, libc::XDP_UMEM_FILL_RING, &length)?;
+        setsockopt(fd, libc::XDP_UMEM_COMPLETION_RING, &length)?;
+        setsockopt(fd, libc::XDP_RX_RING, &length)?;
+        setsockopt(fd, libc::XDP_TX_RING, &length)?;
+
+        let mut offsets: libc::xdp_mmap_offsets = unsafe { mem::zeroed() };
+        let mut optlen: libc::socklen_t = mem::size_of::<libc::xdp_mmap_offsets>() as libc::socklen_t;
+        if unsafe {
+            libc::getsockopt(
+                fd,
+                libc::SOL_XDP,
+                libc::XDP_MMAP_OFFSETS,
+                &mut offsets as *mut libc::xdp_mmap_offsets as *mut libc::c_void,
+                &mut optlen,
+            )
+        } != 0
+        {
+            let errno: i32 = last_errno();
+            let cause: String = format!("failed to get ring offsets (errno={:?})", errno);
+            error!("setup(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        // Kernels that report the older layout do not support the need-wakeup flag.
+        if optlen as usize != mem::size_of::<libc::xdp_mmap_offsets>() {
+            let cause: String = format!("kernel does not support xdp need-wakeup");
+            error!("setup(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        }
+
+        let rx_ring: XdpRing<libc::xdp_desc> = XdpRing::new(fd, length, libc::XDP_PGOFF_RX_RING as u64, &offsets.rx)?;
+        let tx_ring: XdpRing<libc::xdp_desc> = XdpRing::new(fd, length, libc::XDP_PGOFF_TX_RING as u64, &offsets.tx)?;
+        let rx_fill_ring: XdpRing<u64> = XdpRing::new(fd, length, libc::XDP_UMEM_PGOFF_FILL_RING as u64, &offsets.fr)?;
+        let tx_completion_ring: XdpRing<u64> =
+            XdpRing::new(fd, length, libc::XDP_UMEM_PGOFF_COMPLETION_RING as u64, &offsets.cr)?;
+
+        // Sockets that share the user memory region inherit its mode, so only the first one picks it. We prefer
+        // zero-copy mode and fall back to copy mode on network interfaces whose driver does not support it.
+        let zero_copy: bool = match owner {
+            Some(owner) => {
+                bind(fd, ifindex, queueid, libc::XDP_SHARED_UMEM, owner.fd as u32)?;
+                owner.zero_copy
+            },
+            None => match bind(fd, ifindex, queueid, libc::XDP_ZEROCOPY | libc::XDP_USE_NEED_WAKEUP, 0) {
+                Ok(()) => true,
+                Err(e) => {
+                    warn!(
+                        "setup(): zero-copy mode is not available, falling back to copy mode ({:?})",
+                        e
+                    );
+                    bind(fd, ifindex, queueid, libc::XDP_COPY | libc::XDP_USE_NEED_WAKEUP, 0)?;
+                    false
+                },
+            },
+        };
+
+        Ok(Self {
+            fd,
+            rx_ring,
+            rx_fill_ring,
+            tx_ring,
+            tx_completion_ring,
+            zero_copy,
+        })
+    }
+
+    /// Gets the underlying file descriptor.
+    pub fn fd(&self) -> libc::c_int {
+        self.fd
+    }
+
+    /// Checks whether the network interface reads and writes the user memory region directly.
+    pub fn is_zero_copy(&self) -> bool {
+        self.zero_copy
+    }
+
+    /// Reserves a consumer slot in the rx ring.
+    pub fn reserve_rx(&mut self, count: u32, idx: &mut u32) -> u32 {
+        self.rx_ring.consumer_reserve(count, idx)
+    }
+
+    /// Releases a consumer slot in the rx ring.
+    pub fn release_rx(&mut self, count: u32) {
+        self.rx_ring.consumer_release(count);
+    }
+
+    /// Gets the address and the length of the packet at the target index of the rx ring.
+    pub fn get_rx(&mut self, idx: u32) -> (u64, u32) {
+        let desc: &libc::xdp_desc = self.rx_ring.get_element(idx);
+        (desc.addr, desc.len)
+    }
+
+    /// Reserves a producer slot in the rx fill ring.
+    pub fn reserve_rx_fill(&mut self, count: u32, idx: &mut u32) -> u32 {
+        self.rx_fill_ring.producer_reserve(count, idx)
+    }
+
+    /// Submits a producer slot in the rx fill ring.
+    pub fn submit_rx_fill(&mut self, count: u32) {
+        self.rx_fill_ring.producer_submit(count);
+    }
+
+    /// Sets the address of the frame at the target index of the rx fill ring.
+    pub fn set_rx_fill(&mut self, idx: u32, addr: u64) {
+        *self.rx_fill_ring.get_element(idx) = addr;
+    }
+
+    /// Reserves a producer slot in the tx ring.
+    pub fn reserve_tx(&mut self, count: u32, idx: &mut u32) -> u32 {
+        self.tx_ring.producer_reserve(count, idx)
+    }
+
+    /// Submits a producer slot in the tx ring.
+    pub fn submit_tx(&mut self, count: u32) {
+        self.tx_ring.producer_submit(count);
+    }
+
+    /// Sets the descriptor at the target index of the tx ring.
+    pub fn set_tx(&mut self, idx: u32, addr: u64, len: u32) {
+        let desc: &mut libc::xdp_desc = self.tx_ring.get_element(idx);
+        desc.addr = addr;
+        desc.len = len;
+        desc.options = 0;
+    }
+
+    /// Reserves a consumer slot in the tx completion ring.
+    pub fn reserve_tx_completion(&mut self, count: u32, idx: &mut u32) -> u32 {
+        self.tx_completion_ring.consumer_reserve(count, idx)
+    }
+
+    /// Gets the address of the packet at the target index of the tx completion ring.
+    pub fn get_tx_completion(&mut self, idx: u32) -> u64 {
+        *self.tx_completion_ring.get_element(idx)
+    }
+
+    /// Releases a consumer slot in the tx completion ring.
+    pub fn release_tx_completion(&mut self, count: u32) {
+        self.tx_completion_ring.consumer_release(count);
+    }
+
+    /// Asks the kernel to transmit the packets in the tx ring, if it waits for us to do so.
+    pub fn wakeup_tx(&self) -> Result<(), Fail> {
+        if !self.tx_ring.needs_wakeup() {
+            return Ok(());
+        }
+        if unsafe { libc::sendto(self.fd, ptr::null(), 0, libc::MSG_DONTWAIT, ptr::null(), 0) } < 0 {
+            let errno: i32 = last_errno();
+            // The kernel is still busy with earlier packets, so it will pick up the new ones as well.
+            if !matches!(errno, libc::EAGAIN | libc::EBUSY | libc::ENOBUFS | libc::ENETDOWN) {
+                let cause: String = format!("failed to wake up xdp socket (errno={:?})", errno);
+                warn!("wakeup_tx(): {}", cause);
+                return Err(Fail::new(errno, &cause));
+            }
+        }
+        Ok(())
+    }
+
+    /// Asks the kernel to pick up the buffers in the rx fill ring, if it waits for us to do so.
+    pub fn wakeup_rx_fill(&self) {
+        if self.rx_fill_ring.needs_wakeup() {
+            // Nothing is read, so failures just mean that there was nothing to wake up.
+            unsafe {
+                libc::recvfrom(
+                    self.fd,
+                    ptr::null_mut(),
+                    0,
+                    libc::MSG_DONTWAIT,
+                    ptr::null_mut(),
+                    ptr::null_mut(),
+                )
+            };
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Sets an option of the XDP socket `fd`.
+fn setsockopt<T>(fd: libc::c_int, option: libc::c_int, value: &T) -> Result<(), Fail> {
+    if unsafe {
+        libc::setsockopt(
+            fd,
+            libc::SOL_XDP,
+            option,
+            value as *const T as *const libc::c_void,
+            mem::size_of::<T>() as libc::socklen_t,
+        )
+    } != 0
+    {
+        let errno: i32 = last_errno();
+        let cause: String = format!("failed to set xdp socket option {:?} (errno={:?})", option, errno);
+        error!("setsockopt(): {}", cause);
+        return Err(Fail::new(errno, &cause));
+    }
+    Ok(())
+}
+
+/// Binds the XDP socket `fd` to queue `queueid` of the network interface `ifindex`.
+fn bind(fd: libc::c_int, ifindex: u32, queueid: u32, flags: u16, shared_fd: u32) -> Result<(), Fail> {
+    let mut addr: libc::sockaddr_xdp = unsafe { mem::zeroed() };
+    addr.sxdp_family = libc::AF_XDP as u16;
+    addr.sxdp_flags = flags;
+    addr.sxdp_ifindex = ifindex;
+    addr.sxdp_queue_id = queueid;
+    addr.sxdp_shared_umem_fd = shared_fd;
+    if unsafe {
+        libc::bind(
+            fd,
+            &addr as *const libc::sockaddr_xdp as *const libc::sockaddr,
+            mem::size_of::<libc::sockaddr_xdp>() as libc::socklen_t,
+        )
+    } != 0
+    {
+        let errno: i32 = last_errno();
+        let cause: String = format!("failed to bind xdp socket (queueid={:?}, errno={:?})", queueid, errno);
+        warn!("bind(): {}", cause);
+        return Err(Fail::new(errno, &cause));
+    }
+    Ok(())
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for XdpSocket {
+    fn drop(&mut self) {
+        if unsafe { libc::close(self.fd) } != 0 {
+            warn!("drop(): failed to close xdp socket");
+        }
+    }
+}
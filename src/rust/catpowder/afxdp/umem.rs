@@ -0,0 +1,210 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::afxdp::last_errno,
+    runtime::{
+        fail::Fail,
+        memory::{BufferPool, DemiBuffer},
+    },
+};
+use ::std::{mem::MaybeUninit, num::NonZeroUsize, ptr, ptr::NonNull, rc::Rc};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A user memory region that AF_XDP sockets receive into and transmit from. The region is cut into frames that back
+/// [DemiBuffer]s directly, so packets are not copied between the region and the network stack. Each frame starts with
+/// the metadata of its buffer, which the kernel is told to skip as headroom.
+pub struct Umem {
+    /// Start of the region.
+    base: NonNull<u8>,
+    /// Size of the region in bytes.
+    len: usize,
+    /// Frames that are neither owned by the kernel nor by the network stack.
+    pool: BufferPool,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl Umem {
+    /// Size of a frame. This is the size of a page, so that no frame crosses a page boundary.
+    pub const FRAME_SIZE: usize = 4096;
+    /// Size of the buffer that covers a frame.
+    pub const DATA_SIZE: usize = Self::FRAME_SIZE - BufferPool::METADATA_SIZE;
+
+    /// Creates a user memory region with `nr_frames` frames. The region is unmapped when it is dropped, unless buffers
+    /// that the application still holds point into it.
+    pub fn new(nr_frames: u32) -> Result<Self, Fail> {
+        let len: usize = nr_frames as usize * Self::FRAME_SIZE;
+        let base: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_POPULATE,
+                -1,
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            let errno: i32 = last_errno();
+            let cause: String = format!("failed to map user memory region (errno={:?})", errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        let base: NonNull<u8> = NonNull::new(base as *mut u8).expect("mmap() should not return a null pointer");
+
+        let pool: BufferPool = match BufferPool::new(Self::DATA_SIZE as u16) {
+            Ok(pool) => pool,
+            Err(_) => return Err(Fail::new(libc::EINVAL, "invalid frame layout")),
+        };
+        // Safety: the region is only unmapped once no buffer of the pool is in use.
+        unsafe {
+            pool.pool().populate(
+                NonNull::slice_from_raw_parts(base.cast::<MaybeUninit<u8>>(), len),
+                NonZeroUsize::new(Self::FRAME_SIZE).unwrap(),
+            )?
+        };
+
+        Ok(Self { base, len, pool })
+    }
+
+    /// Describes the region to the kernel.
+    pub fn as_umem_reg(&self) -> libc::xdp_umem_reg {
+        let mut reg: libc::xdp_umem_reg = unsafe { std::mem::zeroed() };
+        reg.addr = self.base.as_ptr() as u64;
+        reg.len = self.len as u64;
+        reg.chunk_size = Self::FRAME_SIZE as u32;
+        reg.headroom = BufferPool::METADATA_SIZE as u32;
+        reg
+    }
+
+    /// Returns the number of frames in the region.
+    pub fn nr_frames(&self) -> usize {
+        self.len / Self::FRAME_SIZE
+    }
+
+    /// Returns the number of free frames.
+    pub fn nr_free(&self) -> usize {
+        self.pool.pool().len()
+    }
+
+    /// Takes a free frame. The buffer covers all of the frame but its metadata.
+    pub fn alloc(&self) -> Option<DemiBuffer> {
+        DemiBuffer::new_in_pool(&self.pool)
+    }
+
+    /// Gets the offset of the first segment of `buf` in the region, if it resides in it.
+    pub fn offset_of(&self, buf: &DemiBuffer) -> Option<u64> {
+        if buf.is_empty() {
+            return None;
+        }
+        let addr: usize = buf.as_ptr() as usize;
+        let base: usize = self.base.as_ptr() as usize;
+        if addr >= base && addr < base + self.len {
+            Some((addr - base) as u64)
+        } else {
+            None
+        }
+    }
+
+    /// Gets the index of the frame that contains the byte at `offset` in the region.
+    pub fn frame_index(offset: u64) -> usize {
+        offset as usize / Self::FRAME_SIZE
+    }
+
+    /// Gets the offset in the region of the data of a buffer that covers the frame at `frame_index`.
+    pub fn data_offset(frame_index: usize) -> u64 {
+        (frame_index * Self::FRAME_SIZE + BufferPool::METADATA_SIZE) as u64
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for Umem {
+    fn drop(&mut self) {
+        // Every buffer that is in use holds a reference to the pool.
+        if Rc::strong_count(self.pool.pool()) > 1 {
+            warn!("drop(): frames are still in use, leaving user memory region mapped");
+            return;
+        }
+        if unsafe { libc::munmap(self.base.as_ptr() as *mut libc::c_void, self.len) } != 0 {
+            warn!("drop(): failed to unmap user memory region");
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::Umem;
+    use crate::{
+        ensure_eq,
+        runtime::memory::{BufferPool, DemiBuffer},
+    };
+    use ::anyhow::{anyhow, ensure, Result};
+
+    /// Tests that buffers cover their frame but its metadata and that frames go back to the region once their buffer is
+    /// dropped.
+    #[test]
+    fn test_umem_alloc_and_free() -> Result<()> {
+        const NR_FRAMES: u32 = 4;
+        let umem: Umem = Umem::new(NR_FRAMES)?;
+        ensure_eq!(umem.nr_frames(), NR_FRAMES as usize);
+        ensure_eq!(umem.nr_free(), NR_FRAMES as usize);
+
+        let mut bufs: Vec<DemiBuffer> = Vec::new();
+        while let Some(buf) = umem.alloc() {
+            ensure_eq!(buf.len(), Umem::DATA_SIZE);
+            let offset: u64 = umem.offset_of(&buf).ok_or(anyhow!("buffer should be in the region"))?;
+            ensure_eq!(offset, Umem::data_offset(Umem::frame_index(offset)));
+            bufs.push(buf);
+        }
+        ensure_eq!(bufs.len(), NR_FRAMES as usize);
+        ensure_eq!(umem.nr_free(), 0);
+
+        // Buffers on the heap are not in the region.
+        ensure!(umem.offset_of(&DemiBuffer::new(64)).is_none());
+
+        bufs.clear();
+        ensure_eq!(umem.nr_free(), NR_FRAMES as usize);
+        Ok(())
+    }
+
+    /// Tests that offsets within a frame map back to the frame.
+    #[test]
+    fn test_umem_frame_offsets() -> Result<()> {
+        ensure_eq!(Umem::frame_index(0), 0);
+        ensure_eq!(Umem::frame_index((Umem::FRAME_SIZE - 1) as u64), 0);
+        ensure_eq!(Umem::frame_index(Umem::data_offset(3) + 42), 3);
+        ensure_eq!(
+            Umem::data_offset(1),
+            (Umem::FRAME_SIZE + BufferPool::METADATA_SIZE) as u64
+        );
+        Ok(())
+    }
+
+    /// Tests that the region stays mapped while a buffer still points into it.
+    #[test]
+    fn test_umem_drop_with_buffer_in_use() -> Result<()> {
+        let umem: Umem = Umem::new(2)?;
+        let mut buf: DemiBuffer = umem.alloc().ok_or(anyhow!("should have a free frame"))?;
+        drop(umem);
+        buf[0] = 42;
+        ensure_eq!(buf[0], 42);
+        Ok(())
+    }
+}
@@ -9,34 +9,41 @@ mod rawsocket;
 
 use crate::{
     catpowder::linux::rawsocket::{RawSocket, RawSocketAddr},
-    demi_sgarray_t, demi_sgaseg_t,
+    demi_sgarray_t,
     demikernel::config::Config,
     expect_ok,
     inetstack::protocols::{layer1::PhysicalLayer, layer2::Ethernet2Header, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
         limits,
-        memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        memory::{alloc_buffer_chain, buffer_into_sgarray, DemiBuffer, MemoryRuntime},
+        network::consts::{MAX_RECEIVE_BATCH_SIZE, TRANSMIT_BATCH_SIZE, TRANSMIT_BATCH_TIMEOUT},
         Runtime, SharedObject,
     },
+    timer,
 };
 use ::arrayvec::ArrayVec;
-use ::libc::c_void;
-use ::std::{
-    fs,
-    mem::{self, MaybeUninit},
-    num::ParseIntError,
-};
+use ::std::{fs, num::ParseIntError, time::Instant};
 
 //======================================================================================================================
 // Structures
 //======================================================================================================================
 
+/// Frames that are waiting for a system call on the raw socket.
+struct Batches {
+    /// Outgoing frames and their destinations, staged until the next flush.
+    tx: ArrayVec<(DemiBuffer, RawSocketAddr), TRANSMIT_BATCH_SIZE>,
+    /// Time at which the oldest frame in [tx] was staged.
+    tx_start: Option<Instant>,
+    /// Receive buffers that the last burst did not fill, kept for the next one.
+    rx_spare: ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+}
+
 #[derive(Clone)]
 pub struct LinuxRuntime {
     ifindex: i32,
     socket: SharedObject<RawSocket>,
+    batches: SharedObject<Batches>,
 }
 
 //======================================================================================================================
@@ -57,9 +64,70 @@ impl LinuxRuntime {
         Ok(Self {
             ifindex,
             socket: SharedObject::<RawSocket>::new(socket),
+            batches: SharedObject::<Batches>::new(Batches {
+                tx: ArrayVec::new(),
+                tx_start: None,
+                rx_spare: ArrayVec::new(),
+            }),
         })
     }
 
+    /// Hands all staged outgoing frames to the raw socket with as few system calls as possible. Frames that the socket
+    /// cannot take for now, because its transmit queue is full, stay staged for the next flush. Frames that the socket
+    /// refuses are dropped, as upper layers are expected to recover from the loss.
+    fn flush_tx_batch(&mut self) -> Result<(), Fail> {
+        timer!("catpowder::linux::flush_tx_batch");
+        let batches: &mut Batches = &mut self.batches;
+        batches.tx_start = None;
+        if batches.tx.is_empty() {
+            return Ok(());
+        }
+
+        let nr_frames: usize = batches.tx.len();
+        let mut bufs: ArrayVec<&[u8], TRANSMIT_BATCH_SIZE> = ArrayVec::new();
+        let mut rawaddrs: ArrayVec<RawSocketAddr, TRANSMIT_BATCH_SIZE> = ArrayVec::new();
+        for (pkt, rawaddr) in batches.tx.iter() {
+            bufs.push(&pkt[..]);
+            rawaddrs.push(*rawaddr);
+        }
+        // Resubmit from the first frame that a partial send left behind.
+        let mut nr_sent: usize = 0;
+        let mut errno: Option<i32> = None;
+        while nr_sent < nr_frames {
+            match self.socket.sendmmsg(&bufs[nr_sent..], &rawaddrs[nr_sent..]) {
+                Ok(n) if n > 0 => nr_sent += n,
+                Ok(_) => break,
+                Err(e) => {
+                    errno = Some(e.errno);
+                    break;
+                },
+            }
+        }
+        drop(bufs);
+        batches.tx.drain(..nr_sent);
+        if batches.tx.is_empty() {
+            return Ok(());
+        }
+
+        match errno {
+            Some(errno) if errno != libc::EAGAIN && errno != libc::ENOBUFS => {
+                let cause: String = format!("send failed (errno={:?}, dropped={:?})", errno, batches.tx.len());
+                warn!("flush_tx_batch(): {}", cause);
+                batches.tx.clear();
+                Err(Fail::new(libc::EIO, &cause))
+            },
+            _ => {
+                // Keep the rest of the batch and retry once the staged frames have waited long enough again.
+                trace!(
+                    "flush_tx_batch(): transmit queue is full (staged={:?})",
+                    batches.tx.len()
+                );
+                batches.tx_start = Some(Instant::now());
+                Ok(())
+            },
+        }
+    }
+
     fn get_ifindex(ifname: &str) -> Result<i32, ParseIntError> {
         let path: String = format!("/sys/class/net/{}/ifindex", ifname);
         expect_ok!(fs::read_to_string(path), "could not read ifname")
@@ -74,35 +142,15 @@ impl LinuxRuntime {
 
 impl MemoryRuntime for LinuxRuntime {
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
         // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        let buf: DemiBuffer = alloc_buffer_chain(
+            size,
+            u16::MAX - MAX_HEADER_SIZE as u16,
+            |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(segment_size, MAX_HEADER_SIZE as u16))
+            },
+        )?;
+        buffer_into_sgarray(buf)
     }
 }
 
@@ -110,51 +158,73 @@ impl Runtime for LinuxRuntime {}
 
 impl PhysicalLayer for LinuxRuntime {
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        // The raw socket takes a single contiguous frame, so gather packets that carry their payload in a separate
+        // segment (e.g., when it resides in registered application memory).
+        let pkt: DemiBuffer = if pkt.num_segments() > 1 { pkt.linearize(0)? } else { pkt };
         // We clone the packet so as to not remove the ethernet header from the outgoing message.
         let header = Ethernet2Header::parse_and_strip(&mut pkt.clone()).unwrap();
         let dest_addr_arr: [u8; 6] = header.dst_addr().to_array();
         let dest_sockaddr: RawSocketAddr = RawSocketAddr::new(self.ifindex, &dest_addr_arr);
-
-        match self.socket.sendto(&pkt, &dest_sockaddr) {
-            Ok(size) if size == pkt.len() => Ok(()),
-            Ok(size) => {
-                let cause = format!(
-                    "Incorrect number of bytes sent: packet_size={:?} sent={:?}",
-                    pkt.len(),
-                    size
-                );
-                warn!("{}", cause);
-                Err(Fail::new(libc::EAGAIN, &cause))
-            },
-            Err(e) => {
-                let cause = "send failed";
-                warn!("transmit(): {} {:?}", cause, e);
-                Err(Fail::new(libc::EIO, &cause))
+        // Frames that an earlier flush could not send may still fill the batch.
+        if self.batches.tx.is_full() {
+            self.flush_tx_batch()?;
+            if self.batches.tx.is_full() {
+                let cause: &str = "transmit queue is full";
+                warn!("transmit(): {}", cause);
+                return Err(Fail::new(libc::ENOBUFS, cause));
+            }
+        }
+        self.batches.tx.push((pkt, dest_sockaddr));
+
+        // Flush the batch once it is full or once the oldest staged frame has waited long enough. Otherwise, the batch
+        // goes out when the network stack finishes its current pass over the scheduler.
+        match self.batches.tx_start {
+            _ if self.batches.tx.is_full() => self.flush_tx_batch(),
+            Some(start) if start.elapsed() >= TRANSMIT_BATCH_TIMEOUT => self.flush_tx_batch(),
+            Some(_) => Ok(()),
+            None => {
+                self.batches.tx_start = Some(Instant::now());
+                Ok(())
             },
         }
     }
 
-    // TODO: This routine currently only tries to receive a single packet buffer, not a batch of them.
-    fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
-        // TODO: This routine contains an extra copy of the entire incoming packet that could potentially be removed.
-
-        // TODO: change this function to operate directly on DemiBuffer rather than on MaybeUninit<u8>.
-
-        // This use-case is an example for MaybeUninit in the docs.
-        let mut out: [MaybeUninit<u8>; limits::RECVBUF_SIZE_MAX] =
-            [unsafe { MaybeUninit::uninit().assume_init() }; limits::RECVBUF_SIZE_MAX];
-        if let Ok((nbytes, _origin_addr)) = self.socket.recvfrom(&mut out[..]) {
-            let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
-            unsafe {
-                let bytes: [u8; limits::RECVBUF_SIZE_MAX] =
-                    mem::transmute::<[MaybeUninit<u8>; limits::RECVBUF_SIZE_MAX], [u8; limits::RECVBUF_SIZE_MAX]>(out);
-                let mut dbuf: DemiBuffer = DemiBuffer::from_slice(&bytes)?;
-                dbuf.trim(limits::RECVBUF_SIZE_MAX - nbytes)?;
-                ret.push(dbuf);
-            }
-            Ok(ret)
-        } else {
-            Ok(ArrayVec::new())
+    fn flush(&mut self) -> Result<(), Fail> {
+        self.flush_tx_batch()
+    }
+
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
+        timer!("catpowder::linux::receive");
+        let burst_size: usize = burst_size.min(batch.remaining_capacity());
+        if burst_size == 0 {
+            return Ok(());
+        }
+
+        // Receive straight into buffers that we hand up the stack. Buffers that stay empty are kept for the next burst.
+        let batches: &mut Batches = &mut self.batches;
+        while batches.rx_spare.len() < burst_size {
+            batches.rx_spare.push(DemiBuffer::new(limits::RECVBUF_SIZE_MAX as u16));
+        }
+        let mut lens: [usize; MAX_RECEIVE_BATCH_SIZE] = [0; MAX_RECEIVE_BATCH_SIZE];
+        let mut bufs: ArrayVec<&mut [u8], MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for buf in batches.rx_spare.iter_mut().take(burst_size) {
+            bufs.push(&mut buf[..]);
+        }
+        // Stop on a failed read, as the socket is non-blocking and has no more frames for us.
+        let nr_frames: usize = match self.socket.recvmmsg(&mut bufs, &mut lens) {
+            Ok(nr_frames) => nr_frames,
+            Err(_) => 0,
+        };
+        drop(bufs);
+
+        for (mut dbuf, len) in batches.rx_spare.drain(..nr_frames).zip(&lens[..nr_frames]) {
+            dbuf.trim(dbuf.len() - len)?;
+            batch.push(dbuf);
         }
+        Ok(())
     }
 }
@@ -44,23 +44,4 @@ impl RawSocketAddr {
 
         (sockaddr_ptr, sockaddr_len)
     }
-
-    pub fn as_sockaddr_mut_ptr(&mut self) -> (*mut sockaddr, Socklen) {
-        let sockaddr_ptr: *mut sockaddr =
-            unsafe { mem::transmute::<*mut libc::sockaddr_ll, *mut sockaddr>(&mut self.0) };
-        let sockaddr_len: Socklen = mem::size_of::<libc::sockaddr_ll>() as u32;
-
-        (sockaddr_ptr, sockaddr_len)
-    }
-}
-
-//======================================================================================================================
-// Trait Implementations
-//======================================================================================================================
-
-impl Default for RawSocketAddr {
-    fn default() -> Self {
-        let addr: libc::sockaddr_ll = unsafe { mem::zeroed() };
-        Self(addr)
-    }
 }
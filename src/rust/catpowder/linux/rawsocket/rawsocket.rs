@@ -7,10 +7,14 @@
 
 use crate::{
     catpowder::linux::RawSocketAddr,
-    pal::{SockAddrIn, Socklen},
-    runtime::fail::Fail,
+    pal::Socklen,
+    runtime::{
+        fail::Fail,
+        network::consts::{MAX_RECEIVE_BATCH_SIZE, TRANSMIT_BATCH_SIZE},
+    },
 };
-use ::std::{mem, mem::MaybeUninit};
+use ::arrayvec::ArrayVec;
+use ::std::{io, mem, ptr};
 use libc::sockaddr;
 
 //======================================================================================================================
@@ -53,49 +57,90 @@ impl RawSocket {
         Ok(())
     }
 
-    /// Sends data through a raw socket.
-    pub fn sendto(&self, buf: &[u8], rawaddr: &RawSocketAddr) -> Result<usize, Fail> {
-        let buf_len: usize = buf.len();
-        let buf_ptr: *const libc::c_void = buf.as_ptr() as *const libc::c_void;
-        let (addr_ptr, addrlen): (*const sockaddr, Socklen) = rawaddr.as_sockaddr_ptr();
+    /// Sends a batch of frames through a raw socket with a single system call. Frame `i` goes to `rawaddrs[i]`. At most
+    /// [TRANSMIT_BATCH_SIZE] frames are sent. Returns the number of frames that were sent, which are always the first
+    /// ones of the batch.
+    pub fn sendmmsg(&self, bufs: &[&[u8]], rawaddrs: &[RawSocketAddr]) -> Result<usize, Fail> {
+        debug_assert_eq!(bufs.len(), rawaddrs.len());
+        let nr_frames: usize = bufs.len().min(TRANSMIT_BATCH_SIZE);
+        let mut iovecs: ArrayVec<libc::iovec, TRANSMIT_BATCH_SIZE> = ArrayVec::new();
+        for buf in &bufs[..nr_frames] {
+            iovecs.push(libc::iovec {
+                iov_base: buf.as_ptr() as *mut libc::c_void,
+                iov_len: buf.len(),
+            });
+        }
+        let mut msgs: ArrayVec<libc::mmsghdr, TRANSMIT_BATCH_SIZE> = ArrayVec::new();
+        for (iovec, rawaddr) in iovecs.iter_mut().zip(rawaddrs) {
+            let (addr_ptr, addrlen): (*const sockaddr, Socklen) = rawaddr.as_sockaddr_ptr();
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            msg.msg_hdr.msg_name = addr_ptr as *mut libc::c_void;
+            msg.msg_hdr.msg_namelen = addrlen;
+            msg.msg_hdr.msg_iov = iovec as *mut libc::iovec;
+            msg.msg_hdr.msg_iovlen = 1;
+            msgs.push(msg);
+        }
 
-        let nbytes: i32 =
-            unsafe { libc::sendto(self.0, buf_ptr, buf_len, libc::MSG_DONTWAIT, addr_ptr, addrlen) as i32 };
+        let nframes: i32 = unsafe {
+            libc::sendmmsg(
+                self.0,
+                msgs.as_mut_ptr(),
+                msgs.len() as libc::c_uint,
+                libc::MSG_DONTWAIT,
+            )
+        };
 
         // Check if we failed to send data through raw socket.
-        if nbytes == -1 {
-            return Err(Fail::new(libc::EAGAIN, "failed to send data through raw socket"));
+        if nframes == -1 {
+            // Report why, so that the caller can tell a full transmit queue from a fatal error.
+            let errno: i32 = io::Error::last_os_error().raw_os_error().unwrap_or(libc::EIO);
+            return Err(Fail::new(errno, "failed to send data through raw socket"));
         }
 
-        Ok(nbytes as usize)
+        Ok(nframes as usize)
     }
 
-    /// Receives data from a raw socket.
-    pub fn recvfrom(&self, buf: &[MaybeUninit<u8>]) -> Result<(usize, RawSocketAddr), Fail> {
-        let buf_ptr: *mut libc::c_void = buf.as_ptr() as *mut libc::c_void;
-        let buf_len: usize = buf.len();
-        let mut addrlen: Socklen = mem::size_of::<SockAddrIn>() as u32;
-        let mut rawaddr: RawSocketAddr = RawSocketAddr::default();
-        let addrlen_ptr: *mut Socklen = &mut addrlen as *mut Socklen;
-        let (addr_ptr, _): (*mut sockaddr, Socklen) = rawaddr.as_sockaddr_mut_ptr();
-
-        let nbytes: i32 = unsafe {
-            libc::recvfrom(
+    /// Receives a batch of frames from a raw socket with a single system call. Frame `i` is written to `bufs[i]` and
+    /// its length to `lens[i]`. At most [MAX_RECEIVE_BATCH_SIZE] frames are received. Returns the number of frames
+    /// that were received.
+    pub fn recvmmsg(&self, bufs: &mut [&mut [u8]], lens: &mut [usize]) -> Result<usize, Fail> {
+        debug_assert!(lens.len() >= bufs.len());
+        let nr_frames: usize = bufs.len().min(MAX_RECEIVE_BATCH_SIZE);
+        let mut iovecs: ArrayVec<libc::iovec, MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for buf in bufs[..nr_frames].iter_mut() {
+            iovecs.push(libc::iovec {
+                iov_base: buf.as_mut_ptr() as *mut libc::c_void,
+                iov_len: buf.len(),
+            });
+        }
+        let mut msgs: ArrayVec<libc::mmsghdr, MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for iovec in iovecs.iter_mut() {
+            // We do not need the origin of the frames.
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            msg.msg_hdr.msg_iov = iovec as *mut libc::iovec;
+            msg.msg_hdr.msg_iovlen = 1;
+            msgs.push(msg);
+        }
+
+        let nframes: i32 = unsafe {
+            libc::recvmmsg(
                 self.0,
-                buf_ptr,
-                buf_len,
+                msgs.as_mut_ptr(),
+                msgs.len() as libc::c_uint,
                 libc::MSG_DONTWAIT,
-                addr_ptr,
-                addrlen_ptr as *mut u32,
-            ) as i32
+                ptr::null_mut(),
+            )
         };
 
         // Check if we failed to receive data from raw socket.
-        if nbytes == -1 {
+        if nframes == -1 {
             return Err(Fail::new(libc::EAGAIN, "failed to receive data from raw socket"));
         }
 
-        Ok((nbytes as usize, rawaddr))
+        for (len, msg) in lens.iter_mut().zip(&msgs[..nframes as usize]) {
+            *len = msg.msg_len as usize;
+        }
+        Ok(nframes as usize)
     }
 }
 
@@ -7,8 +7,14 @@ mod win;
 #[cfg(target_os = "windows")]
 pub use win::runtime::SharedCatpowderRuntime;
 
-#[cfg(target_os = "linux")]
+#[cfg(all(target_os = "linux", not(feature = "catpowder-xdp")))]
 mod linux;
 
-#[cfg(target_os = "linux")]
+#[cfg(all(target_os = "linux", not(feature = "catpowder-xdp")))]
 pub use linux::LinuxRuntime as SharedCatpowderRuntime;
+
+#[cfg(all(target_os = "linux", feature = "catpowder-xdp"))]
+mod afxdp;
+
+#[cfg(all(target_os = "linux", feature = "catpowder-xdp"))]
+pub use afxdp::runtime::SharedCatpowderRuntime;
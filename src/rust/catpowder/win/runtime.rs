@@ -10,20 +10,19 @@ use crate::{
         api::XdpApi,
         ring::{RxRing, TxRing, XdpBuffer},
     },
-    demi_sgarray_t, demi_sgaseg_t,
+    demi_sgarray_t,
     demikernel::config::Config,
     inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
         libxdp,
-        memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        memory::{alloc_buffer_chain, buffer_into_sgarray, DemiBuffer, MemoryRuntime},
+        network::consts::MAX_RECEIVE_BATCH_SIZE,
         Runtime, SharedObject,
     },
 };
 use ::arrayvec::ArrayVec;
-use ::libc::c_void;
-use ::std::{borrow::BorrowMut, mem};
+use ::std::borrow::BorrowMut;
 use windows::Win32::{
     Foundation::ERROR_INSUFFICIENT_BUFFER,
     System::SystemInformation::{
@@ -81,7 +80,7 @@ impl SharedCatpowderRuntime {
 impl PhysicalLayer for SharedCatpowderRuntime {
     /// Transmits a packet.
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
-        let pkt_size: usize = pkt.len();
+        let pkt_size: usize = pkt.chain_len();
         trace!("transmit(): pkt_size={:?}", pkt_size);
         if pkt_size >= u16::MAX as usize {
             let cause = format!("packet is too large: {:?}", pkt_size);
@@ -98,7 +97,13 @@ impl PhysicalLayer for SharedCatpowderRuntime {
         }
 
         let mut buf: XdpBuffer = self.0.borrow_mut().tx.get_buffer(idx, pkt_size);
-        buf.copy_from_slice(&pkt);
+        // Gather packets that carry their payload in a separate segment (e.g., when it resides in registered
+        // application memory).
+        let mut offset: usize = 0;
+        for segment in pkt.segments() {
+            buf[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
 
         self.0.borrow_mut().tx.submit_tx(Self::RING_LENGTH);
 
@@ -130,30 +135,40 @@ impl PhysicalLayer for SharedCatpowderRuntime {
     }
 
     /// Polls for received packets.
-    fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
-        let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
+        let burst_size: usize = burst_size.min(batch.remaining_capacity());
+        let mut nr_received: usize = 0;
         let mut idx: u32 = 0;
 
+        if burst_size == 0 {
+            return Ok(());
+        }
+
         for rx in self.0.borrow_mut().rx_rings.iter_mut() {
             if rx.reserve_rx(Self::RING_LENGTH, &mut idx) == Self::RING_LENGTH {
                 let xdp_buffer: XdpBuffer = rx.get_buffer(idx);
                 let dbuf: DemiBuffer = DemiBuffer::from_slice(&*xdp_buffer)?;
                 rx.release_rx(Self::RING_LENGTH);
 
-                ret.push(dbuf);
+                batch.push(dbuf);
+                nr_received += 1;
 
                 rx.reserve_rx_fill(Self::RING_LENGTH, &mut idx);
                 // NB for now there is only ever one element in the fill ring, so we don't have to
                 // change the ring contents.
                 rx.submit_rx_fill(Self::RING_LENGTH);
 
-                if ret.is_full() {
+                if nr_received == burst_size {
                     break;
                 }
             }
         }
 
-        Ok(ret)
+        Ok(())
     }
 }
 
@@ -249,38 +264,15 @@ fn deduce_rss_settings(api: &mut XdpApi, ifindex: u32) -> Result<u32, Fail> {
 impl MemoryRuntime for SharedCatpowderRuntime {
     /// Allocates a scatter-gather array.
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate a zero-sized buffer.
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
         // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        let buf: DemiBuffer = alloc_buffer_chain(
+            size,
+            u16::MAX - MAX_HEADER_SIZE as u16,
+            |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(segment_size, MAX_HEADER_SIZE as u16))
+            },
+        )?;
+        buffer_into_sgarray(buf)
     }
 }
 
@@ -22,6 +22,15 @@ use ::std::{
 // The following value was chosen arbitrarily.
 const TIMEOUT_SECONDS: Duration = Duration::from_secs(1000);
 
+/// Capacity that a queue shrinks back to once it drains after a burst, so that long-lived but mostly idle owners, such
+/// as TCP connections, do not hold on to the peak.
+const MAX_IDLE_CAPACITY: usize = 16;
+
+/// Capacity past which a drained queue shrinks back to [MAX_IDLE_CAPACITY]. Queues that stay below it keep their
+/// memory, so that steady traffic does not reallocate them on every drain, and those that grow past it reallocate at
+/// most once per burst of this many items.
+const SHRINK_CAPACITY_THRESHOLD: usize = 4 * MAX_IDLE_CAPACITY;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -66,6 +75,7 @@ impl<T> AsyncQueue<T> {
         let wait_condition = async {
             loop {
                 if let Some(item) = self.queue.pop_front() {
+                    self.shrink_if_drained();
                     return item;
                 } else {
                     self.cond_var.wait().await;
@@ -77,7 +87,9 @@ impl<T> AsyncQueue<T> {
 
     /// Try to get the head of the queue.
     pub fn try_pop(&mut self) -> Option<T> {
-        self.queue.pop_front()
+        let item: Option<T> = self.queue.pop_front();
+        self.shrink_if_drained();
+        item
     }
 
     /// Get the length of the queue.
@@ -102,6 +114,17 @@ impl<T> AsyncQueue<T> {
         self.queue.iter_mut()
     }
 
+    /// Get mutable reference to the item at `index`.
+    pub fn get_mut(&mut self, index: usize) -> Option<&mut T> {
+        self.queue.get_mut(index)
+    }
+
+    /// Insert an item at `index`, ahead of the items from there on.
+    pub fn insert(&mut self, index: usize, item: T) {
+        self.queue.insert(index, item);
+        self.cond_var.signal();
+    }
+
     /// Get refernce to first item.
     pub fn get_front(&self) -> Option<&T> {
         self.queue.front()
@@ -111,6 +134,13 @@ impl<T> AsyncQueue<T> {
     pub fn get_front_mut(&mut self) -> Option<&mut T> {
         self.queue.front_mut()
     }
+
+    /// Releases the memory of an empty queue that grew past [SHRINK_CAPACITY_THRESHOLD].
+    fn shrink_if_drained(&mut self) {
+        if self.queue.is_empty() && self.queue.capacity() > SHRINK_CAPACITY_THRESHOLD {
+            self.queue.shrink_to(MAX_IDLE_CAPACITY);
+        }
+    }
 }
 
 impl<T> SharedAsyncQueue<T> {
@@ -159,3 +189,43 @@ impl<T> Clone for SharedAsyncQueue<T> {
         Self(self.0.clone())
     }
 }
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::collections::async_queue::{AsyncQueue, MAX_IDLE_CAPACITY, SHRINK_CAPACITY_THRESHOLD};
+    use ::anyhow::Result;
+
+    // Tests that a queue keeps its memory across drains while it stays small, and gives it back after a large burst.
+    #[test]
+    fn test_shrink_after_burst() -> Result<()> {
+        let mut queue: AsyncQueue<usize> = AsyncQueue::default();
+
+        // Steady traffic grows the queue once and then reuses its slots.
+        for _ in 0..8 {
+            for i in 0..SHRINK_CAPACITY_THRESHOLD / 2 {
+                queue.push(i);
+            }
+            while queue.try_pop().is_some() {}
+        }
+        let capacity: usize = queue.queue.capacity();
+        crate::ensure_eq!(capacity >= SHRINK_CAPACITY_THRESHOLD / 2, true);
+        crate::ensure_eq!(capacity <= SHRINK_CAPACITY_THRESHOLD, true);
+
+        // A burst past the threshold stays allocated until the queue drains.
+        for i in 0..4 * SHRINK_CAPACITY_THRESHOLD {
+            queue.push(i);
+        }
+        for _ in 0..4 * SHRINK_CAPACITY_THRESHOLD - 1 {
+            queue.try_pop();
+        }
+        crate::ensure_eq!(queue.queue.capacity() >= 4 * SHRINK_CAPACITY_THRESHOLD, true);
+        queue.try_pop();
+        crate::ensure_eq!(queue.queue.capacity() <= MAX_IDLE_CAPACITY, true);
+
+        Ok(())
+    }
+}
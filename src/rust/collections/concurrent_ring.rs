@@ -14,7 +14,10 @@ use ::core::{
     mem,
     sync::atomic::{self, AtomicU16, AtomicUsize},
 };
-use ::std::{alloc, ptr::copy};
+use ::std::{
+    alloc,
+    ptr::{copy, write_bytes},
+};
 
 use crate::timer;
 
@@ -94,12 +97,17 @@ impl ConcurrentRingBuffer {
             is_managed: true,
         };
 
-        // Initialize the first header to 0.
-        me.write_header(0, 0);
+        // Clear the whole buffer, so that the header of the next message reads as zero wherever that message goes.
+        me.clear(0, capacity);
 
         Ok(me)
     }
 
+    /// Returns the capacity in bytes that a ring buffer needs to hold [num_messages] messages of [len] bytes each.
+    pub fn required_capacity(num_messages: usize, len: usize) -> usize {
+        num_messages * align_header(len + HEADER_SIZE) + HEADER_SIZE
+    }
+
     /// Returns the effective capacity of the target ring buffer in bytes.
     #[allow(unused)]
     pub fn capacity(&self) -> usize {
@@ -154,8 +162,9 @@ impl ConcurrentRingBuffer {
 
             Ok(len)
         } else {
+            // A full ring is part of normal operation, so do not log this as an error.
             let cause: String = format!("no space in the ring buffer (len={})", len);
-            error!("try_push(): {}", &cause);
+            trace!("try_push(): {}", &cause);
             Err(Fail::new(libc::EAGAIN, &cause))
         }
     }
@@ -219,6 +228,12 @@ impl ConcurrentRingBuffer {
             }
         }
 
+        // Clear the payload before handing the space back, so that writers always find zeroed headers in free space.
+        self.clear(
+            (pop_offset + HEADER_SIZE) % self.capacity(),
+            align_header(pop_len + HEADER_SIZE) - HEADER_SIZE,
+        );
+
         // Move to next buffer.
         self.release_space(pop_offset, pop_len);
         Ok(pop_len)
@@ -245,7 +260,19 @@ impl ConcurrentRingBuffer {
         let buffer_ptr: *mut u8 = unsafe { self.buffer.get_mut() }.as_mut_ptr();
         let header_ptr: *mut u16 = unsafe { buffer_ptr.add(offset) } as *mut u16;
         let header: &AtomicU16 = unsafe { &*header_ptr.cast() };
-        header.swap(val as u16, atomic::Ordering::Relaxed) as usize
+        // Writing a header publishes or claims the payload behind it, so this must order the accesses to the payload.
+        header.swap(val as u16, atomic::Ordering::AcqRel) as usize
+    }
+
+    /// Zeroes [len] bytes of the ring buffer starting at [offset], wrapping around if needed.
+    fn clear(&self, offset: usize, len: usize) {
+        timer!("collections::concurrent_ring::clear");
+        let first_len: usize = len.min(self.capacity() - offset);
+        let ring_ptr: *mut u8 = unsafe { self.buffer.get_mut().as_mut_ptr() };
+        unsafe {
+            write_bytes(ring_ptr.add(offset), 0, first_len);
+            write_bytes(ring_ptr, 0, len - first_len);
+        }
     }
 
     /// Given a [push_offset] and [pop_offset] into the ring buffer, return available space for writing data. Always
@@ -272,14 +299,9 @@ impl ConcurrentRingBuffer {
         let new_offset: usize = (push_offset + len_) % self.capacity();
 
         debug_assert_ne!(new_offset, pop_offset);
-        // Queue has space after the enqueue pointer, so try to reserve space.
-        match check_and_set(self.push_offset, push_offset, new_offset) {
-            Ok(start) => {
-                self.write_header(new_offset, 0);
-                Some(start)
-            },
-            Err(_) => None,
-        }
+        // Queue has space after the enqueue pointer, so try to reserve space. We do not need to clear the header at
+        // [new_offset], because free space is always zeroed, and doing so here would race with the next writer.
+        check_and_set(self.push_offset, push_offset, new_offset).ok()
     }
 
     /// Frees [len] + HEADER_SIZE bytes from the ring buffer.
@@ -360,22 +382,21 @@ impl Ring for ConcurrentRingBuffer {
         let push_offset: *mut usize = buffer_ptr as *mut usize;
         buffer_ptr = unsafe { buffer_ptr.add(SIZE_OF_USIZE) };
 
-        // Initialize enqueue and dequeue pointers only if requested.
-        if init {
-            unsafe {
-                *push_offset = 0;
-                *pop_offset = 0;
-            }
-        }
-
         let me: Self = Self {
             push_offset,
             pop_offset,
             buffer: raw_array::RawArray::<u8>::from_raw_parts(buffer_ptr, capacity - size_of_ring)?,
             is_managed: false,
         };
-        // Intialize the header to 0.
-        me.write_header(0, 0);
+
+        // Initialize enqueue and dequeue pointers and clear the buffer only if requested.
+        if init {
+            unsafe {
+                *push_offset = 0;
+                *pop_offset = 0;
+            }
+            me.clear(0, me.capacity());
+        }
         Ok(me)
     }
 }
@@ -386,13 +407,14 @@ impl Ring for ConcurrentRingBuffer {
 /// Peeks at the value at [ptr] to check various constraints.
 fn peek(ptr: *mut usize) -> usize {
     let ptr: &AtomicUsize = unsafe { &*ptr.cast() };
-    ptr.load(atomic::Ordering::Relaxed)
+    ptr.load(atomic::Ordering::Acquire)
 }
 
-/// Compares and increments the value at [ptr] only if it has not changed since the last time we read it.
+/// Compares and increments the value at [ptr] only if it has not changed since the last time we read it. This must not
+/// fail spuriously, since [ConcurrentRingBuffer::release_space] expects it to succeed.
 fn check_and_set(ptr: *mut usize, current: usize, new: usize) -> Result<usize, usize> {
     let ptr: &AtomicUsize = unsafe { &*ptr.cast() };
-    ptr.compare_exchange_weak(current, new, atomic::Ordering::Acquire, atomic::Ordering::Relaxed)
+    ptr.compare_exchange(current, new, atomic::Ordering::AcqRel, atomic::Ordering::Acquire)
 }
 
 /// Align to [HEADER_SIZE] for the header offset.
@@ -6,15 +6,22 @@
 //======================================================================================================================
 
 use crate::{
-    demikernel::libos::{name::LibOSName, LibOS},
+    demikernel::{
+        channel::{Channel, ChannelServer},
+        libos::{name::LibOSName, LibOS},
+    },
     pal::{
         socketaddrv4_to_sockaddr, AddressFamily, Linger, SockAddrIn, SockAddrIn6, SockAddrStorage, Socklen, AF_INET,
         AF_INET6, SOL_SOCKET, SO_LINGER,
     },
+    perftools::stats,
     runtime::{
         fail::Fail,
         logging,
-        types::{demi_args_t, demi_callback_t, demi_qresult_t, demi_qtoken_t, demi_sgarray_t, demi_sgaseg_t},
+        types::{
+            demi_args_t, demi_callback_t, demi_cqring_t, demi_qresult_t, demi_qtoken_t, demi_sgarray_t, demi_sgaseg_t,
+            demi_stats_t, write_qresult, DEMI_SGARRAY_MAXLEN,
+        },
         QToken,
     },
     SocketOption,
@@ -26,20 +33,40 @@ use ::std::{
     mem::{self, MaybeUninit},
     net::{SocketAddr, SocketAddrV4},
     ptr, slice,
+    sync::Arc,
     time::Duration,
 };
 use libc::sockaddr;
 
+#[cfg(target_os = "linux")]
+use crate::{
+    pal::{IPPROTO_TCP, TCP_CA_NAME_MAX, TCP_CONGESTION},
+    runtime::network::socket::option::CongestionControlAlgorithm,
+};
+
 thread_local! {
     static THREAD_LOCAL_LIBOS: RefCell<Option<LibOS>> = RefCell::new(None);
+    static THREAD_LOCAL_CHANNELS: RefCell<ChannelServer> = RefCell::new(ChannelServer::default());
 }
 
-#[allow(unused)]
 #[no_mangle]
 pub extern "C" fn demi_init(args: *const demi_args_t) -> c_int {
     logging::initialize();
     trace!("demi_init()");
+    init_on_queue(args, 0)
+}
+
+/// Same as [demi_init], but binds the LibOS of the calling thread to the NIC queue `queue_id`. This is a separate
+/// entry point, so that the layout of `demi_args` stays that of earlier releases.
+#[no_mangle]
+pub extern "C" fn demi_init_on_queue(args: *const demi_args_t, queue_id: u16) -> c_int {
+    logging::initialize();
+    trace!("demi_init_on_queue() queue_id={:?}", queue_id);
+    init_on_queue(args, queue_id)
+}
 
+#[allow(unused)]
+fn init_on_queue(args: *const demi_args_t, queue_id: u16) -> c_int {
     let libos_name: LibOSName = match LibOSName::from_env() {
         Ok(libos_name) => libos_name.into(),
         Err(e) => panic!("{:?}", e),
@@ -62,7 +89,7 @@ pub extern "C" fn demi_init(args: *const demi_args_t) -> c_int {
         args.callback
     };
 
-    match LibOS::new(libos_name, perf_callback) {
+    match LibOS::new_on_queue(libos_name, perf_callback, queue_id) {
         Ok(libos) => {
             THREAD_LOCAL_LIBOS.with(move |demikernel_libos| {
                 *demikernel_libos.borrow_mut() = Some(libos);
@@ -187,6 +214,53 @@ pub extern "C" fn demi_accept(qtok_out: *mut demi_qtoken_t, sockqd: c_int) -> c_
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_accept_batch(
+    qtoks_out: *mut demi_qtoken_t,
+    sockqd: c_int,
+    num: c_int,
+    num_out: *mut c_int,
+) -> c_int {
+    trace!("demi_accept_batch() {:?} {:?}", sockqd, num);
+
+    // Check for invalid storage locations.
+    if qtoks_out.is_null() || num_out.is_null() {
+        warn!("demi_accept_batch() qtoks_out or num_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check arguments.
+    if num <= 0 {
+        return libc::EINVAL;
+    }
+
+    let qtoks_out: &mut [MaybeUninit<demi_qtoken_t>] =
+        unsafe { slice::from_raw_parts_mut(qtoks_out.cast(), num as usize) };
+    let mut num_issued: c_int = 0;
+
+    // Issue all accept operations at once, stopping at the first one that fails.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        for i in 0..num as usize {
+            match libos.accept(sockqd.into()) {
+                Ok(qt) => qtoks_out[i] = MaybeUninit::new(qt.into()),
+                Err(e) => {
+                    trace!("demi_accept_batch() failed: {:?}", e);
+                    return e.errno;
+                },
+            }
+            num_issued += 1;
+        }
+        0
+    });
+
+    unsafe { *num_out = num_issued };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_connect(
     qtok_out: *mut demi_qtoken_t,
@@ -342,6 +416,34 @@ pub extern "C" fn demi_push(qtok_out: *mut demi_qtoken_t, qd: c_int, sga: *const
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_push_file(qtok_out: *mut demi_qtoken_t, qd: c_int, fd: c_int, offset: u64, len: usize) -> c_int {
+    trace!("demi_push_file()");
+
+    // Check for invalid storage location.
+    if qtok_out.is_null() {
+        warn!("demi_push_file() qtok_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Issue push operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.push_file(qd.into(), fd, offset, len) {
+        Ok(qt) => {
+            unsafe { *qtok_out = qt.into() };
+            0
+        },
+        Err(e) => {
+            trace!("demi_push_file() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_pop(qtok_out: *mut demi_qtoken_t, qd: c_int) -> c_int {
     trace!("demi_pop()");
@@ -370,6 +472,104 @@ pub extern "C" fn demi_pop(qtok_out: *mut demi_qtoken_t, qd: c_int) -> c_int {
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_push_batch(
+    qtoks_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    sgas: *const demi_sgarray_t,
+    num: c_int,
+    num_out: *mut c_int,
+) -> c_int {
+    trace!("demi_push_batch() {:?}", num);
+
+    // Check for invalid storage locations.
+    if qtoks_out.is_null() || num_out.is_null() {
+        warn!("demi_push_batch() qtoks_out or num_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check arguments.
+    if qds.is_null() || sgas.is_null() || num <= 0 {
+        return libc::EINVAL;
+    }
+
+    let qds: &[c_int] = unsafe { slice::from_raw_parts(qds, num as usize) };
+    let sgas: &[demi_sgarray_t] = unsafe { slice::from_raw_parts(sgas, num as usize) };
+    let qtoks_out: &mut [MaybeUninit<demi_qtoken_t>] =
+        unsafe { slice::from_raw_parts_mut(qtoks_out.cast(), num as usize) };
+    let mut num_issued: c_int = 0;
+
+    // Issue all push operations at once, stopping at the first one that fails.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        for i in 0..num as usize {
+            match libos.push(qds[i].into(), &sgas[i]) {
+                Ok(qt) => qtoks_out[i] = MaybeUninit::new(qt.into()),
+                Err(e) => {
+                    trace!("demi_push_batch() failed: {:?}", e);
+                    return e.errno;
+                },
+            }
+            num_issued += 1;
+        }
+        0
+    });
+
+    unsafe { *num_out = num_issued };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_pop_batch(
+    qtoks_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    num: c_int,
+    num_out: *mut c_int,
+) -> c_int {
+    trace!("demi_pop_batch() {:?}", num);
+
+    // Check for invalid storage locations.
+    if qtoks_out.is_null() || num_out.is_null() {
+        warn!("demi_pop_batch() qtoks_out or num_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check arguments.
+    if qds.is_null() || num <= 0 {
+        return libc::EINVAL;
+    }
+
+    let qds: &[c_int] = unsafe { slice::from_raw_parts(qds, num as usize) };
+    let qtoks_out: &mut [MaybeUninit<demi_qtoken_t>] =
+        unsafe { slice::from_raw_parts_mut(qtoks_out.cast(), num as usize) };
+    let mut num_issued: c_int = 0;
+
+    // Issue all pop operations at once, stopping at the first one that fails.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        for i in 0..num as usize {
+            match libos.pop(qds[i].into(), None) {
+                Ok(qt) => qtoks_out[i] = MaybeUninit::new(qt.into()),
+                Err(e) => {
+                    trace!("demi_pop_batch() failed: {:?}", e);
+                    return e.errno;
+                },
+            }
+            num_issued += 1;
+        }
+        0
+    });
+
+    unsafe { *num_out = num_issued };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_wait(qr_out: *mut demi_qresult_t, qt: demi_qtoken_t, timeout: *const libc::timespec) -> c_int {
     trace!("demi_wait() {:?} {:?} {:?}", qr_out, qt, timeout);
@@ -391,7 +591,7 @@ pub extern "C" fn demi_wait(qr_out: *mut demi_qresult_t, qt: demi_qtoken_t, time
     // Issue wait operation.
     let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait(qt.into(), duration) {
         Ok(r) => {
-            unsafe { *qr_out = r };
+            unsafe { write_qresult(qr_out, 0, r) };
             0
         },
         Err(e) => {
@@ -449,7 +649,7 @@ pub extern "C" fn demi_wait_any(
     let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_any(&qts, duration) {
         Ok((ix, qr)) => {
             unsafe {
-                *qr_out = qr;
+                write_qresult(qr_out, 0, qr);
                 *ready_offset = ix as c_int;
             }
             0
@@ -499,11 +699,10 @@ pub extern "C" fn demi_wait_next_n(
         Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
     };
 
-    let out_slice: &mut [MaybeUninit<demi_qresult_t>] =
-        unsafe { slice::from_raw_parts_mut(qr_out.cast(), qr_out_size as usize) };
     let mut result_idx: c_int = 0;
     let wait_callback = |result: demi_qresult_t| -> bool {
-        out_slice[result_idx as usize] = MaybeUninit::new(result);
+        // Safety: The acceptor stops before the index goes past the end of the array.
+        unsafe { write_qresult(qr_out, result_idx as usize, result) };
         result_idx += 1;
         result_idx < qr_out_size
     };
@@ -526,55 +725,109 @@ pub extern "C" fn demi_wait_next_n(
 }
 
 #[no_mangle]
-pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
-    trace!("demi_sgaalloc()");
+pub extern "C" fn demi_wait_ring(cq: *mut demi_cqring_t, timeout: *const libc::timespec) -> c_int {
+    trace!("demi_wait_ring() {:?} {:?}", cq, timeout);
 
-    let null_sga: demi_sgarray_t = {
-        demi_sgarray_t {
-            sga_buf: ptr::null_mut() as *mut _,
-            sga_numsegs: 0,
-            sga_segs: [demi_sgaseg_t {
-                sgaseg_buf: ptr::null_mut() as *mut c_void,
-                sgaseg_len: 0,
-            }; 1],
-            sga_addr: unsafe { mem::zeroed() },
-        }
+    // Check for invalid completion ring.
+    if cq.is_null() {
+        warn!("cq is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a valid completion ring for us to dereference.
+    let (head, mut tail, size, entries): (u32, u32, u32, *mut demi_qresult_t) =
+        unsafe { ((*cq).cq_head, (*cq).cq_tail, (*cq).cq_size, (*cq).cq_entries) };
+    if entries.is_null() || !size.is_power_of_two() || tail.wrapping_sub(head) > size {
+        warn!("cq is not a valid completion ring");
+        return libc::EINVAL;
+    }
+
+    // Check if there is room for at least one result.
+    if tail.wrapping_sub(head) == size {
+        return libc::ENOBUFS;
+    }
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
     };
 
-    // Issue sgaalloc operation.
-    let ret: Result<demi_sgarray_t, Fail> = do_syscall(|libos| -> demi_sgarray_t {
-        match libos.sgaalloc(size) {
-            Ok(sga) => sga,
-            Err(e) => {
-                trace!("demi_sgaalloc() failed: {:?}", e);
-                null_sga
+    // Writes a result at the tail of the ring and returns whether there is room for more results.
+    let mut produce = |result: demi_qresult_t| -> bool {
+        // Safety: The entry is within the ring.
+        unsafe { write_qresult(entries, (tail & (size - 1)) as usize, result) };
+        tail = tail.wrapping_add(1);
+        tail.wrapping_sub(head) < size
+    };
+
+    // Wait for the first result, then collect all other completed results without waiting.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        let mut has_room: bool = true;
+        if let Err(e) = libos.wait_next_n(
+            |result| {
+                has_room = produce(result);
+                false
             },
+            duration,
+        ) {
+            trace!("demi_wait_ring() failed: {:?}", e);
+            return e.errno;
+        }
+        if has_room {
+            libos.take_completed_n(|result| produce(result));
         }
+        0
     });
 
+    // Publish the new results to the application.
+    unsafe { (*cq).cq_tail = tail };
+
     match ret {
         Ok(ret) => ret,
-        Err(e) => {
-            trace!("demi_sgaalloc() failed: {:?}", e);
-            null_sga
-        },
+        Err(e) => e.errno,
     }
 }
 
 #[no_mangle]
-pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
-    trace!("demi_sgfree()");
+pub extern "C" fn demi_qtset_create(set_out: *mut c_int) -> c_int {
+    trace!("demi_qtset_create() {:?}", set_out);
 
-    // Check if scatter-gather array is invalid.
-    if sga.is_null() {
+    // Check for invalid storage location for the queue token set.
+    if set_out.is_null() {
+        warn!("set_out is a null pointer");
         return libc::EINVAL;
     }
 
-    // Issue sgafree operation.
-    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.sgafree(unsafe { *sga }) {
+    // Issue qtset_create operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        let set: usize = libos.alloc_qtoken_set();
+        unsafe { *set_out = set as c_int };
+        0
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_qtset_free(set: c_int) -> c_int {
+    trace!("demi_qtset_free() {:?}", set);
+
+    // Check arguments.
+    if set < 0 {
+        return libc::EBADF;
+    }
+
+    // Issue qtset_free operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.free_qtoken_set(set as usize) {
         Ok(()) => 0,
         Err(e) => {
-            trace!("demi_sgafree() failed: {:?}", e);
+            trace!("demi_qtset_free() failed: {:?}", e);
             e.errno
         },
     });
@@ -585,93 +838,539 @@ pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
     }
 }
 
-#[allow(unused)]
-#[no_mangle]
-pub extern "C" fn demi_getsockname(qd: c_int, saddr: *mut sockaddr, size: *mut Socklen) -> c_int {
-    // TODO: Implement this system call.
-    libc::ENOSYS
-}
-
-#[allow(unused)]
 #[no_mangle]
-pub extern "C" fn demi_setsockopt(
-    qd: c_int,
-    level: c_int,
-    optname: c_int,
-    optval: *const c_void,
-    optlen: Socklen,
-) -> c_int {
-    trace!("demi_setsockopt()");
+pub extern "C" fn demi_qtset_add(set: c_int, qt: demi_qtoken_t) -> c_int {
+    trace!("demi_qtset_add() {:?} {:?}", set, qt);
 
-    // Check inputs.
-    if level != SOL_SOCKET {
-        error!("demi_setsockopt(): only options in SOL_SOCKET level are supported");
-        return libc::ENOTSUP;
+    // Check arguments.
+    if set < 0 {
+        return libc::EBADF;
     }
 
-    let opt: SocketOption = match optname {
-        SO_LINGER => {
-            // Check for invalid storage locations.
-            if optval.is_null() {
-                error!("demi_setsockopt(): linger value is a null pointer");
-                return libc::EINVAL;
-            }
-
-            if optlen as usize != mem::size_of::<Linger>() {
-                warn!("demi_setsockopt(): linger len is incorrect");
-                return libc::EINVAL;
-            }
-
-            let linger: Linger = unsafe { *(optval as *const Linger) };
-            match linger.l_onoff {
-                0 => SocketOption::Linger(None),
-                _ => SocketOption::Linger(Some(Duration::from_secs(linger.l_linger as u64))),
-            }
-        },
-        _ => {
-            error!("demi_setsockopt(): only SO_LINGER is supported right now");
-            return libc::ENOPROTOOPT;
-        },
-    };
-
-    // Issue socket operation.
-    let ret: Result<(), Fail> = match do_syscall(|libos| libos.set_socket_option(qd.into(), opt)) {
-        Ok(result) => result,
+    // Issue qtset_add operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.insert_into_qtoken_set(set as usize, qt.into()) {
+        Ok(()) => 0,
         Err(e) => {
-            trace!("demi_getsockopt(): {:?}", e);
-            return e.errno;
+            trace!("demi_qtset_add() failed: {:?}", e);
+            e.errno
         },
-    };
+    });
 
     match ret {
-        Ok(_) => 0,
-        Err(e) => {
-            trace!("demi_getsockopt(): {:?}", e);
-            e.errno
-        },
+        Ok(ret) => ret,
+        Err(e) => e.errno,
     }
 }
 
 #[no_mangle]
-pub extern "C" fn demi_getsockopt(
-    qd: c_int,
-    level: c_int,
-    optname: c_int,
-    optval: *mut c_void,
-    optlen: *mut Socklen,
-) -> c_int {
-    trace!("demi_getsockopt()");
+pub extern "C" fn demi_qtset_remove(set: c_int, qt: demi_qtoken_t) -> c_int {
+    trace!("demi_qtset_remove() {:?} {:?}", set, qt);
 
-    // Check inputs.
-    if level != SOL_SOCKET {
-        error!("demi_getsockopt(): only options in SOL_SOCKET level are supported");
-        return libc::ENOTSUP;
+    // Check arguments.
+    if set < 0 {
+        return libc::EBADF;
     }
 
-    let opt: SocketOption = match optname {
-        SO_LINGER => SocketOption::Linger(None),
-        _ => {
-            error!("demi_getsockopt(): only SO_LINGER is supported right now");
+    // Issue qtset_remove operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.remove_from_qtoken_set(set as usize, qt.into()) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_qtset_remove() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_wait_set(qr_out: *mut demi_qresult_t, set: c_int, timeout: *const libc::timespec) -> c_int {
+    trace!("demi_wait_set() {:?} {:?} {:?}", qr_out, set, timeout);
+
+    // Check for invalid storage location for queue result.
+    if qr_out.is_null() {
+        warn!("qr_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check arguments.
+    if set < 0 {
+        return libc::EBADF;
+    }
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue wait_set operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_any_set(set as usize, duration) {
+        Ok(qr) => {
+            unsafe { write_qresult(qr_out, 0, qr) };
+            0
+        },
+        Err(e) => {
+            trace!("demi_wait_set() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_create(ch_out: *mut *const Channel, num_entries: u32) -> c_int {
+    trace!("demi_channel_create() {:?} {:?}", ch_out, num_entries);
+
+    // Check for invalid storage location for the channel.
+    if ch_out.is_null() {
+        warn!("ch_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Issue channel_create operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        THREAD_LOCAL_CHANNELS.with(
+            |channels| match channels.borrow_mut().create(libos, num_entries as usize) {
+                Ok(channel) => {
+                    unsafe { *ch_out = Arc::into_raw(channel) };
+                    0
+                },
+                Err(e) => {
+                    trace!("demi_channel_create() failed: {:?}", e);
+                    e.errno
+                },
+            },
+        )
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_serve(timeout: *const libc::timespec) -> c_int {
+    trace!("demi_channel_serve() {:?}", timeout);
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue channel_serve operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        THREAD_LOCAL_CHANNELS.with(|channels| match channels.borrow_mut().serve(libos, duration) {
+            Ok(()) => 0,
+            Err(e) => {
+                trace!("demi_channel_serve() failed: {:?}", e);
+                e.errno
+            },
+        })
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_close(ch: *const Channel) -> c_int {
+    trace!("demi_channel_close() {:?}", ch);
+
+    // Check for invalid channel.
+    if ch.is_null() {
+        warn!("ch is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a channel that it has not closed yet.
+    let channel: Arc<Channel> = unsafe { Arc::from_raw(ch) };
+    channel.close();
+
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_push(ch: *const Channel, qd: c_int, sga: *const demi_sgarray_t, tag: u64) -> c_int {
+    trace!("demi_channel_push() {:?} {:?} {:?} {:?}", ch, qd, sga, tag);
+
+    // Check arguments.
+    if ch.is_null() || sga.is_null() {
+        warn!("ch or sga is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing valid pointers for us to dereference.
+    let (channel, sga): (&Channel, &demi_sgarray_t) = unsafe { (&*ch, &*sga) };
+    do_submit("demi_channel_push", || channel.submit_push(qd.into(), sga, tag))
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_pop(ch: *const Channel, qd: c_int, tag: u64) -> c_int {
+    trace!("demi_channel_pop() {:?} {:?} {:?}", ch, qd, tag);
+
+    // Check for invalid channel.
+    if ch.is_null() {
+        warn!("ch is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a valid channel for us to dereference.
+    let channel: &Channel = unsafe { &*ch };
+    do_submit("demi_channel_pop", || channel.submit_pop(qd.into(), tag))
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_accept(ch: *const Channel, sockqd: c_int, tag: u64) -> c_int {
+    trace!("demi_channel_accept() {:?} {:?} {:?}", ch, sockqd, tag);
+
+    // Check for invalid channel.
+    if ch.is_null() {
+        warn!("ch is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a valid channel for us to dereference.
+    let channel: &Channel = unsafe { &*ch };
+    do_submit("demi_channel_accept", || channel.submit_accept(sockqd.into(), tag))
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_close_qd(ch: *const Channel, qd: c_int, tag: u64) -> c_int {
+    trace!("demi_channel_close_qd() {:?} {:?} {:?}", ch, qd, tag);
+
+    // Check for invalid channel.
+    if ch.is_null() {
+        warn!("ch is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a valid channel for us to dereference.
+    let channel: &Channel = unsafe { &*ch };
+    do_submit("demi_channel_close_qd", || channel.submit_close(qd.into(), tag))
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_sgafree(ch: *const Channel, sga: *const demi_sgarray_t) -> c_int {
+    trace!("demi_channel_sgafree() {:?} {:?}", ch, sga);
+
+    // Check arguments.
+    if ch.is_null() || sga.is_null() {
+        warn!("ch or sga is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing valid pointers for us to dereference.
+    let (channel, sga): (&Channel, &demi_sgarray_t) = unsafe { (&*ch, &*sga) };
+    do_submit("demi_channel_sgafree", || channel.submit_sgafree(sga))
+}
+
+#[no_mangle]
+pub extern "C" fn demi_channel_reap(
+    ch: *const Channel,
+    qr_out: *mut demi_qresult_t,
+    num_qrs: c_int,
+    num_qrs_out: *mut c_int,
+) -> c_int {
+    trace!(
+        "demi_channel_reap() {:?} {:?} {:?} {:?}",
+        ch,
+        qr_out,
+        num_qrs,
+        num_qrs_out
+    );
+
+    // Check arguments.
+    if ch.is_null() || qr_out.is_null() || num_qrs_out.is_null() {
+        warn!("ch, qr_out, or num_qrs_out is a null pointer");
+        return libc::EINVAL;
+    }
+    if num_qrs <= 0 {
+        warn!("num_qrs is not positive");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing a valid channel for us to dereference.
+    let channel: &Channel = unsafe { &*ch };
+    let mut num_reaped: usize = 0;
+    while num_reaped < num_qrs as usize {
+        match channel.try_reap() {
+            // Safety: The entry is within the array that the user provided.
+            Some(qr) => unsafe { write_qresult(qr_out, num_reaped, qr) },
+            None => break,
+        }
+        num_reaped += 1;
+    }
+    unsafe { *num_qrs_out = num_reaped as c_int };
+
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn demi_get_stats(stats_out: *mut demi_stats_t) -> c_int {
+    trace!("demi_get_stats() {:?}", stats_out);
+
+    // Check for invalid storage location for the counters.
+    if stats_out.is_null() {
+        warn!("stats_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Counters are always on, so this does not need Demikernel to be initialized.
+    unsafe { *stats_out = stats::snapshot() };
+
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn demi_stats_map(stats_out: *mut *const demi_stats_t) -> c_int {
+    trace!("demi_stats_map() {:?}", stats_out);
+
+    // Check for invalid storage location for the counters.
+    if stats_out.is_null() {
+        warn!("stats_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    unsafe { *stats_out = stats::as_ptr() };
+
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
+    trace!("demi_sgaalloc()");
+
+    let null_sga: demi_sgarray_t = {
+        demi_sgarray_t {
+            sga_buf: ptr::null_mut() as *mut _,
+            sga_numsegs: 0,
+            sga_segs: [demi_sgaseg_t {
+                sgaseg_buf: ptr::null_mut() as *mut c_void,
+                sgaseg_len: 0,
+            }; DEMI_SGARRAY_MAXLEN],
+            sga_addr: unsafe { mem::zeroed() },
+        }
+    };
+
+    // Issue sgaalloc operation.
+    let ret: Result<demi_sgarray_t, Fail> = do_syscall(|libos| -> demi_sgarray_t {
+        match libos.sgaalloc(size) {
+            Ok(sga) => sga,
+            Err(e) => {
+                trace!("demi_sgaalloc() failed: {:?}", e);
+                null_sga
+            },
+        }
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => {
+            trace!("demi_sgaalloc() failed: {:?}", e);
+            null_sga
+        },
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
+    trace!("demi_sgfree()");
+
+    // Check if scatter-gather array is invalid.
+    if sga.is_null() {
+        return libc::EINVAL;
+    }
+
+    // Issue sgafree operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.sgafree(unsafe { *sga }) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_sgafree() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_mem_register(addr: *mut c_void, len: usize) -> c_int {
+    trace!("demi_mem_register()");
+
+    // Check if memory region is invalid.
+    if addr.is_null() || len == 0 {
+        return libc::EINVAL;
+    }
+
+    // Issue mem_register operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.mem_register(addr as *const u8, len) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_mem_register() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_mem_unregister(addr: *mut c_void) -> c_int {
+    trace!("demi_mem_unregister()");
+
+    // Check if memory region is invalid.
+    if addr.is_null() {
+        return libc::EINVAL;
+    }
+
+    // Issue mem_unregister operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.mem_unregister(addr as *const u8) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_mem_unregister() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[allow(unused)]
+#[no_mangle]
+pub extern "C" fn demi_getsockname(qd: c_int, saddr: *mut sockaddr, size: *mut Socklen) -> c_int {
+    // TODO: Implement this system call.
+    libc::ENOSYS
+}
+
+#[allow(unused)]
+#[no_mangle]
+pub extern "C" fn demi_setsockopt(
+    qd: c_int,
+    level: c_int,
+    optname: c_int,
+    optval: *const c_void,
+    optlen: Socklen,
+) -> c_int {
+    trace!("demi_setsockopt()");
+
+    // Check inputs.
+    if !is_supported_option_level(level) {
+        error!("demi_setsockopt(): only options in SOL_SOCKET and IPPROTO_TCP levels are supported");
+        return libc::ENOTSUP;
+    }
+
+    let opt: SocketOption = match (level, optname) {
+        (SOL_SOCKET, SO_LINGER) => {
+            // Check for invalid storage locations.
+            if optval.is_null() {
+                error!("demi_setsockopt(): linger value is a null pointer");
+                return libc::EINVAL;
+            }
+
+            if optlen as usize != mem::size_of::<Linger>() {
+                warn!("demi_setsockopt(): linger len is incorrect");
+                return libc::EINVAL;
+            }
+
+            let linger: Linger = unsafe { *(optval as *const Linger) };
+            match linger.l_onoff {
+                0 => SocketOption::Linger(None),
+                _ => SocketOption::Linger(Some(Duration::from_secs(linger.l_linger as u64))),
+            }
+        },
+        #[cfg(target_os = "linux")]
+        (IPPROTO_TCP, TCP_CONGESTION) => {
+            // Check for invalid storage locations.
+            if optval.is_null() {
+                error!("demi_setsockopt(): congestion control name is a null pointer");
+                return libc::EINVAL;
+            }
+
+            // As with Linux, the name need not be null-terminated.
+            let name: &[u8] = unsafe { slice::from_raw_parts(optval as *const u8, optlen as usize) };
+            let name: &[u8] = name.split(|c| *c == 0).next().unwrap_or(name);
+            match ::std::str::from_utf8(name) {
+                Ok(name) => match name.parse::<CongestionControlAlgorithm>() {
+                    Ok(algorithm) => SocketOption::CongestionControl(algorithm),
+                    Err(e) => return e.errno,
+                },
+                Err(_) => {
+                    warn!("demi_setsockopt(): congestion control name is not valid UTF-8");
+                    return libc::ENOENT;
+                },
+            }
+        },
+        _ => {
+            error!("demi_setsockopt(): only SO_LINGER and TCP_CONGESTION are supported right now");
+            return libc::ENOPROTOOPT;
+        },
+    };
+
+    // Issue socket operation.
+    let ret: Result<(), Fail> = match do_syscall(|libos| libos.set_socket_option(qd.into(), opt)) {
+        Ok(result) => result,
+        Err(e) => {
+            trace!("demi_getsockopt(): {:?}", e);
+            return e.errno;
+        },
+    };
+
+    match ret {
+        Ok(_) => 0,
+        Err(e) => {
+            trace!("demi_getsockopt(): {:?}", e);
+            e.errno
+        },
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_getsockopt(
+    qd: c_int,
+    level: c_int,
+    optname: c_int,
+    optval: *mut c_void,
+    optlen: *mut Socklen,
+) -> c_int {
+    trace!("demi_getsockopt()");
+
+    // Check inputs.
+    if !is_supported_option_level(level) {
+        error!("demi_getsockopt(): only options in SOL_SOCKET and IPPROTO_TCP levels are supported");
+        return libc::ENOTSUP;
+    }
+
+    let opt: SocketOption = match (level, optname) {
+        (SOL_SOCKET, SO_LINGER) => SocketOption::Linger(None),
+        #[cfg(target_os = "linux")]
+        (IPPROTO_TCP, TCP_CONGESTION) => SocketOption::CongestionControl(CongestionControlAlgorithm::None),
+        _ => {
+            error!("demi_getsockopt(): only SO_LINGER and TCP_CONGESTION are supported right now");
             return libc::ENOPROTOOPT;
         },
     };
@@ -698,7 +1397,7 @@ pub extern "C" fn demi_getsockopt(
 
     match ret {
         Ok(option) => {
-            // Unpack the value based on the option. We only support linger right now.
+            // Unpack the value based on the option.
             match option {
                 SocketOption::Linger(linger) => {
                     let result: Linger = match linger {
@@ -722,9 +1421,21 @@ pub extern "C" fn demi_getsockopt(
                         *optlen = result_length as Socklen;
                     }
                 },
+                #[cfg(target_os = "linux")]
+                SocketOption::CongestionControl(algorithm) => {
+                    // As with Linux, copy as much of the null-terminated name as fits.
+                    let mut result: [u8; TCP_CA_NAME_MAX] = [0; TCP_CA_NAME_MAX];
+                    let name: &[u8] = algorithm.name().as_bytes();
+                    result[..name.len()].copy_from_slice(name);
+                    let result_length: usize = unsafe { (*optlen as usize).min(TCP_CA_NAME_MAX) };
+                    unsafe {
+                        ptr::copy(result.as_ptr() as *const c_void, optval, result_length);
+                        *optlen = result_length as Socklen;
+                    }
+                },
                 _ => {
-                    let cause: String = format!("Only SO_LINGER is supported right now");
-                    error!("demi_setsockopt(): {}", cause);
+                    let cause: String = format!("only SO_LINGER and TCP_CONGESTION are supported right now");
+                    error!("demi_getsockopt(): {}", cause);
                     return libc::EINVAL;
                 },
             };
@@ -737,6 +1448,15 @@ pub extern "C" fn demi_getsockopt(
     }
 }
 
+/// Checks whether we support socket options at `level`.
+fn is_supported_option_level(level: c_int) -> bool {
+    #[cfg(target_os = "linux")]
+    if level == IPPROTO_TCP {
+        return true;
+    }
+    level == SOL_SOCKET
+}
+
 #[no_mangle]
 pub extern "C" fn demi_getpeername(qd: c_int, addr: *mut SockAddr, addrlen: *mut Socklen) -> c_int {
     trace!("demi_getpeername()");
@@ -806,6 +1526,17 @@ fn do_syscall<T>(f: impl FnOnce(&mut LibOS) -> T) -> Result<T, Fail> {
     })
 }
 
+/// Submits an operation through a channel. This runs on application threads, so it does not touch the libOS.
+fn do_submit(name: &str, submit: impl FnOnce() -> Result<(), Fail>) -> c_int {
+    match submit() {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("{}() failed: {:?}", name, e);
+            e.errno
+        },
+    }
+}
+
 fn sockaddr_to_socketaddr(saddr: *const sockaddr, size: Socklen) -> Result<SocketAddr, Fail> {
     let check_name_len = |len: usize, exact: bool| {
         if (size as usize) < len || (exact && size as usize != len) {
@@ -860,6 +1591,31 @@ mod test {
         ensure_eq, ensure_neq,
         pal::{AddressFamily, Linger, SockAddrStorage, Socklen, AF_INET, SOL_SOCKET, SO_LINGER},
     };
+    #[cfg(feature = "catnap-libos")]
+    use crate::{
+        demikernel::{
+            bindings::{
+                demi_accept, demi_bind, demi_channel_close, demi_channel_create, demi_channel_pop, demi_channel_push,
+                demi_channel_reap, demi_channel_serve, demi_channel_sgafree, demi_close, demi_connect, demi_listen,
+                demi_push_batch, demi_sgaalloc, demi_sgafree, demi_wait, demi_wait_ring,
+            },
+            channel::Channel,
+        },
+        runtime::types::{
+            demi_args_t, demi_cqring_t, demi_opcode_t, demi_qresult_t, demi_qtoken_t, demi_sgarray_t,
+            DEMI_QRESULT_T_SIZE,
+        },
+    };
+    #[cfg(feature = "catnap-libos")]
+    use ::std::{mem::MaybeUninit, slice, thread, time::Duration};
+
+    /// How long the tests below wait for an operation to complete.
+    #[cfg(feature = "catnap-libos")]
+    const TIMEOUT: libc::timespec = libc::timespec { tv_sec: 5, tv_nsec: 0 };
+
+    /// Size of the scatter-gather arrays that the tests below push.
+    #[cfg(feature = "catnap-libos")]
+    const PUSH_SIZE: usize = 64;
 
     #[test]
     fn test_sockaddr_to_socketaddr() {
@@ -1023,4 +1779,304 @@ mod test {
 
         Ok(())
     }
+
+    /// Tests that demi_wait_ring() places results by the wrapped-around indexes of the ring.
+    #[test]
+    #[cfg(feature = "catnap-libos")]
+    fn test_wait_ring_wraps_around() -> anyhow::Result<()> {
+        const RING_SIZE: u32 = 4;
+        const NUM_PUSHES: usize = 3;
+        // Start right before the indexes wrap around, so that results land in entries 2, 3 and 0.
+        const START: u32 = u32::MAX - 1;
+
+        let args: demi_args_t = demi_args_t::default();
+        ensure_eq!(demi_init(&args), 0);
+        let (_, qd): (c_int, c_int) = connect_pair(22441)?;
+        let qts: Vec<demi_qtoken_t> = push_batch(&[qd; NUM_PUSHES])?;
+
+        let mut entries: Vec<MaybeUninit<demi_qresult_t>> = new_entries(RING_SIZE);
+        let mut ring: demi_cqring_t = demi_cqring_t {
+            cq_head: START,
+            cq_tail: START,
+            cq_size: RING_SIZE,
+            cq_entries: entries.as_mut_ptr().cast(),
+        };
+        while ring_len(&ring) < NUM_PUSHES as u32 {
+            ensure_eq!(demi_wait_ring(&mut ring, &TIMEOUT), 0);
+        }
+        let tail: u32 = ring.cq_tail;
+        ensure_eq!(tail, START.wrapping_add(NUM_PUSHES as u32));
+        ensure_eq!(tail, 1);
+
+        let mut seen: Vec<demi_qtoken_t> = Vec::with_capacity(NUM_PUSHES);
+        for i in 0..NUM_PUSHES as u32 {
+            let qr: demi_qresult_t = read_entry(&entries, START.wrapping_add(i) & (RING_SIZE - 1));
+            ensure_eq!(qr.qr_opcode, demi_opcode_t::DEMI_OPC_PUSH);
+            seen.push(qr.qr_qt);
+        }
+        seen.sort();
+        ensure_eq!(seen, qts);
+
+        Ok(())
+    }
+
+    /// Tests that demi_wait_ring() fails with ENOBUFS on a full ring, and that it does not lose results meanwhile.
+    #[test]
+    #[cfg(feature = "catnap-libos")]
+    fn test_wait_ring_full() -> anyhow::Result<()> {
+        const RING_SIZE: u32 = 2;
+        const NUM_PUSHES: usize = 3;
+
+        let args: demi_args_t = demi_args_t::default();
+        ensure_eq!(demi_init(&args), 0);
+        let (_, qd): (c_int, c_int) = connect_pair(22442)?;
+        let qts: Vec<demi_qtoken_t> = push_batch(&[qd; NUM_PUSHES])?;
+
+        let mut entries: Vec<MaybeUninit<demi_qresult_t>> = new_entries(RING_SIZE);
+        let mut ring: demi_cqring_t = demi_cqring_t {
+            cq_head: 0,
+            cq_tail: 0,
+            cq_size: RING_SIZE,
+            cq_entries: entries.as_mut_ptr().cast(),
+        };
+        while ring_len(&ring) < RING_SIZE {
+            ensure_eq!(demi_wait_ring(&mut ring, &TIMEOUT), 0);
+        }
+        let tail: u32 = ring.cq_tail;
+        ensure_eq!(tail, RING_SIZE);
+
+        // The ring is full, so nothing more fits in until the application consumes a result.
+        ensure_eq!(demi_wait_ring(&mut ring, &TIMEOUT), libc::ENOBUFS);
+        let tail: u32 = ring.cq_tail;
+        ensure_eq!(tail, RING_SIZE);
+
+        let mut seen: Vec<demi_qtoken_t> = Vec::with_capacity(NUM_PUSHES);
+        for i in 0..RING_SIZE {
+            seen.push(read_entry(&entries, i).qr_qt);
+        }
+        ring.cq_head = RING_SIZE;
+        ensure_eq!(demi_wait_ring(&mut ring, &TIMEOUT), 0);
+        let tail: u32 = ring.cq_tail;
+        ensure_eq!(tail, RING_SIZE + 1);
+        let qr: demi_qresult_t = read_entry(&entries, RING_SIZE & (RING_SIZE - 1));
+        ensure_eq!(qr.qr_opcode, demi_opcode_t::DEMI_OPC_PUSH);
+        seen.push(qr.qr_qt);
+        seen.sort();
+        ensure_eq!(seen, qts);
+
+        Ok(())
+    }
+
+    /// Tests that demi_push_batch() issues the operations before the one that fails, and only those.
+    #[test]
+    #[cfg(feature = "catnap-libos")]
+    fn test_push_batch_fails_part_way() -> anyhow::Result<()> {
+        // Value of the queue tokens that the application did not get back.
+        const UNSET: demi_qtoken_t = demi_qtoken_t::MAX;
+
+        let args: demi_args_t = demi_args_t::default();
+        ensure_eq!(demi_init(&args), 0);
+        let (_, qd): (c_int, c_int) = connect_pair(22443)?;
+
+        // The third operation targets a queue that no longer exists.
+        let mut closed_qd: c_int = 0;
+        ensure_eq!(
+            demi_socket(
+                &mut closed_qd,
+                Domain::IPV4.into(),
+                Type::STREAM.into(),
+                Protocol::TCP.into()
+            ),
+            0
+        );
+        ensure_eq!(demi_close(closed_qd), 0);
+        let qds: [c_int; 4] = [qd, qd, closed_qd, qd];
+
+        let mut sgas: Vec<demi_sgarray_t> = (0..qds.len()).map(|_| demi_sgaalloc(PUSH_SIZE)).collect();
+        let mut qts: [demi_qtoken_t; 4] = [UNSET; 4];
+        let mut num_issued: c_int = -1;
+        let result: c_int = demi_push_batch(
+            qts.as_mut_ptr(),
+            qds.as_ptr(),
+            sgas.as_ptr(),
+            qds.len() as c_int,
+            &mut num_issued,
+        );
+        for sga in sgas.iter_mut() {
+            ensure_eq!(demi_sgafree(sga), 0);
+        }
+
+        // The caller learns how many operations went out, and the tokens past those are left as they were.
+        ensure_eq!(result, libc::EBADF);
+        ensure_eq!(num_issued, 2);
+        ensure_eq!(qts[2], UNSET);
+        ensure_eq!(qts[3], UNSET);
+        for qt in &qts[..2] {
+            ensure_eq!(wait(*qt)?.qr_opcode, demi_opcode_t::DEMI_OPC_PUSH);
+        }
+
+        Ok(())
+    }
+
+    /// Tests that the I/O core issues an operation submitted through a channel while it waits for another one without
+    /// a timeout, posts both results, and takes back the scatter-gather array of the pop.
+    #[test]
+    #[cfg(feature = "catnap-libos")]
+    fn test_channel_issue_complete_release() -> anyhow::Result<()> {
+        // A push that another thread submits through the channel.
+        struct Submission(*const Channel, demi_sgarray_t);
+        unsafe impl Send for Submission {}
+        const POP_TAG: u64 = 1;
+        const PUSH_TAG: u64 = 2;
+
+        let args: demi_args_t = demi_args_t::default();
+        ensure_eq!(demi_init(&args), 0);
+        let (server_qd, client_qd): (c_int, c_int) = connect_pair(22444)?;
+        let mut ch: *const Channel = ptr::null();
+        ensure_eq!(demi_channel_create(&mut ch, 8), 0);
+
+        // The pop only completes once the push goes through, which is submitted while the I/O core waits on the pop.
+        ensure_eq!(demi_channel_pop(ch, server_qd, POP_TAG), 0);
+        let mut pushed: demi_sgarray_t = demi_sgaalloc(PUSH_SIZE);
+        unsafe { ptr::write_bytes(pushed.sga_segs[0].sgaseg_buf as *mut u8, 0x5a, PUSH_SIZE) };
+        let submission: Submission = Submission(ch, pushed);
+        let submitter: thread::JoinHandle<c_int> = thread::spawn(move || {
+            let submission: Submission = submission;
+            thread::sleep(Duration::from_millis(50));
+            demi_channel_push(submission.0, client_qd, &submission.1, PUSH_TAG)
+        });
+        ensure_eq!(demi_channel_serve(ptr::null()), 0);
+        match submitter.join() {
+            Ok(result) => ensure_eq!(result, 0),
+            Err(_) => anyhow::bail!("submitting thread panicked"),
+        }
+
+        let mut entries: Vec<MaybeUninit<demi_qresult_t>> = new_entries(2);
+        let mut results: Vec<demi_qresult_t> = Vec::with_capacity(2);
+        while results.len() < 2 {
+            ensure_eq!(demi_channel_serve(&TIMEOUT), 0);
+            let mut num_reaped: c_int = 0;
+            ensure_eq!(
+                demi_channel_reap(ch, entries.as_mut_ptr().cast(), 2, &mut num_reaped),
+                0
+            );
+            for i in 0..num_reaped as u32 {
+                results.push(read_entry(&entries, i));
+            }
+        }
+        ensure_eq!(demi_sgafree(&mut pushed), 0);
+        results.sort_by_key(|qr| qr.qr_qt);
+        ensure_eq!(results[0].qr_qt, POP_TAG);
+        ensure_eq!(results[0].qr_opcode, demi_opcode_t::DEMI_OPC_POP);
+        ensure_eq!(results[1].qr_qt, PUSH_TAG);
+        ensure_eq!(results[1].qr_opcode, demi_opcode_t::DEMI_OPC_PUSH);
+
+        // The data arrives intact, and the application hands the buffer back through the channel.
+        let popped: demi_sgarray_t = unsafe { results[0].qr_value.sga };
+        let len: usize = popped.sga_segs[0].sgaseg_len as usize;
+        ensure_eq!(len, PUSH_SIZE);
+        let data: &[u8] = unsafe { slice::from_raw_parts(popped.sga_segs[0].sgaseg_buf as *const u8, len) };
+        ensure_eq!(data.iter().all(|byte| *byte == 0x5a), true);
+        ensure_eq!(demi_channel_sgafree(ch, &popped), 0);
+        ensure_eq!(demi_channel_serve(&TIMEOUT), 0);
+
+        // Once closed, the channel is retired in the next round.
+        ensure_eq!(demi_channel_close(ch), 0);
+        ensure_eq!(demi_channel_serve(&TIMEOUT), 0);
+
+        Ok(())
+    }
+
+    /// Connects a TCP socket to another one over the loopback interface and returns the queue descriptors of the
+    /// accepted socket and of the connected one.
+    #[cfg(feature = "catnap-libos")]
+    fn connect_pair(port: u16) -> anyhow::Result<(c_int, c_int)> {
+        let saddr: SockAddr = SockAddr::from(SocketAddrV4::new(Ipv4Addr::LOCALHOST, port));
+        let mut listen_qd: c_int = 0;
+        ensure_eq!(
+            demi_socket(
+                &mut listen_qd,
+                Domain::IPV4.into(),
+                Type::STREAM.into(),
+                Protocol::TCP.into()
+            ),
+            0
+        );
+        ensure_eq!(demi_bind(listen_qd, saddr.as_ptr().cast(), saddr.len()), 0);
+        ensure_eq!(demi_listen(listen_qd, 1), 0);
+        let mut accept_qt: demi_qtoken_t = 0;
+        ensure_eq!(demi_accept(&mut accept_qt, listen_qd), 0);
+
+        let mut qd: c_int = 0;
+        ensure_eq!(
+            demi_socket(&mut qd, Domain::IPV4.into(), Type::STREAM.into(), Protocol::TCP.into()),
+            0
+        );
+        let mut connect_qt: demi_qtoken_t = 0;
+        ensure_eq!(demi_connect(&mut connect_qt, qd, saddr.as_ptr().cast(), saddr.len()), 0);
+        ensure_eq!(wait(connect_qt)?.qr_opcode, demi_opcode_t::DEMI_OPC_CONNECT);
+        let qr: demi_qresult_t = wait(accept_qt)?;
+        ensure_eq!(qr.qr_opcode, demi_opcode_t::DEMI_OPC_ACCEPT);
+
+        Ok((unsafe { qr.qr_value.ares.qd }, qd))
+    }
+
+    /// Pushes a scatter-gather array to each of `qds` with demi_push_batch() and returns the sorted queue tokens.
+    #[cfg(feature = "catnap-libos")]
+    fn push_batch(qds: &[c_int]) -> anyhow::Result<Vec<demi_qtoken_t>> {
+        let mut sgas: Vec<demi_sgarray_t> = qds.iter().map(|_| demi_sgaalloc(PUSH_SIZE)).collect();
+        let mut qts: Vec<demi_qtoken_t> = vec![0; qds.len()];
+        let mut num_issued: c_int = 0;
+        let result: c_int = demi_push_batch(
+            qts.as_mut_ptr(),
+            qds.as_ptr(),
+            sgas.as_ptr(),
+            qds.len() as c_int,
+            &mut num_issued,
+        );
+        for sga in sgas.iter_mut() {
+            ensure_eq!(demi_sgafree(sga), 0);
+        }
+        ensure_eq!(result, 0);
+        ensure_eq!(num_issued, qds.len() as c_int);
+        qts.sort();
+        Ok(qts)
+    }
+
+    /// Waits for the operation of `qt` to complete.
+    #[cfg(feature = "catnap-libos")]
+    fn wait(qt: demi_qtoken_t) -> anyhow::Result<demi_qresult_t> {
+        let mut qr: MaybeUninit<demi_qresult_t> = MaybeUninit::zeroed();
+        ensure_eq!(demi_wait(qr.as_mut_ptr(), qt, &TIMEOUT), 0);
+        Ok(unsafe { qr.assume_init() })
+    }
+
+    /// Allocates the entries of a completion ring of `size` results.
+    #[cfg(feature = "catnap-libos")]
+    fn new_entries(size: u32) -> Vec<MaybeUninit<demi_qresult_t>> {
+        // Results are packed in C, so a ring of this many Rust results has room to spare.
+        (0..size).map(|_| MaybeUninit::zeroed()).collect()
+    }
+
+    /// Gets the number of results in `ring` that the application has not consumed yet.
+    #[cfg(feature = "catnap-libos")]
+    fn ring_len(ring: &demi_cqring_t) -> u32 {
+        let (head, tail): (u32, u32) = (ring.cq_head, ring.cq_tail);
+        tail.wrapping_sub(head)
+    }
+
+    /// Reads the result at `slot` of the entries of a completion ring, which are laid out as in C.
+    #[cfg(feature = "catnap-libos")]
+    fn read_entry(entries: &[MaybeUninit<demi_qresult_t>], slot: u32) -> demi_qresult_t {
+        let mut qr: MaybeUninit<demi_qresult_t> = MaybeUninit::zeroed();
+        // Safety: The slot is within the ring, whose entries are DEMI_QRESULT_T_SIZE bytes apart.
+        unsafe {
+            ptr::copy_nonoverlapping(
+                (entries.as_ptr() as *const u8).add(slot as usize * DEMI_QRESULT_T_SIZE),
+                qr.as_mut_ptr() as *mut u8,
+                DEMI_QRESULT_T_SIZE,
+            );
+            qr.assume_init()
+        }
+    }
 }
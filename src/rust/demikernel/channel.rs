@@ -0,0 +1,537 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Cross-thread submission and completion channels.
+//!
+//! Channels let application threads drive I/O operations on a Demikernel instance that runs on another thread, the I/O
+//! core. An application thread enqueues operations into the submission ring of a channel and reaps their results from
+//! the completion ring of the same channel, without ever touching the libOS. The I/O core drains the submission rings
+//! of all of its channels in batches, issues the operations, and posts each result back to the channel that submitted
+//! the operation. The libOS thus stays single-threaded, while any number of threads submit operations to it.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::concurrent_ring::ConcurrentRingBuffer,
+    demikernel::libos::LibOS,
+    expect_ok,
+    runtime::{
+        fail::Fail,
+        types::{demi_opcode_t, demi_qresult_t, demi_sgarray_t},
+        QDesc, QToken,
+    },
+};
+use ::slab::Slab;
+use ::std::{
+    collections::{HashMap, VecDeque},
+    mem::{self, MaybeUninit},
+    slice,
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc,
+    },
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Largest number of submissions that we take from each channel, and of results that we collect, in one round of
+/// [ChannelServer::serve]. This bounds how long one busy channel can hold up the others.
+const MAX_BATCH_SIZE: usize = 64;
+
+/// Longest time that [ChannelServer::serve] waits for pending operations before it checks whether a channel got new
+/// submissions. This bounds how long a submission can wait for the I/O core to pick it up.
+const WAKEUP_INTERVAL: Duration = Duration::from_micros(100);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Operations that can be submitted through a channel.
+#[repr(u32)]
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+enum SubmissionOpcode {
+    Push = 1,
+    Pop,
+    Accept,
+    Close,
+    SgaFree,
+}
+
+/// Entry of the submission ring of a channel. Entries travel through the ring as raw bytes, so this is plain old data.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct Submission {
+    opcode: SubmissionOpcode,
+    qd: QDesc,
+    /// Identifier of the operation chosen by the application, which we return instead of the queue token.
+    tag: u64,
+    /// Scatter-gather array to push or to release.
+    sga: demi_sgarray_t,
+}
+
+/// A pair of lock-free rings shared between application threads and the I/O core. Entries of the completion ring are
+/// [demi_qresult_t] structures whose queue token has been replaced by the tag of the operation.
+pub struct Channel {
+    submissions: ConcurrentRingBuffer,
+    completions: ConcurrentRingBuffer,
+    /// Set once the application has closed the channel.
+    closed: AtomicBool,
+    /// Flag shared by all channels of an I/O core, which a submission raises to cut the wait of the I/O core short.
+    doorbell: Arc<AtomicBool>,
+}
+
+/// State that the I/O core keeps for each channel.
+struct ChannelState {
+    channel: Arc<Channel>,
+    /// Number of operations that have been issued on behalf of this channel and have not completed yet.
+    num_pending: usize,
+    /// Results that did not fit in the completion ring, in order.
+    overflow: VecDeque<demi_qresult_t>,
+}
+
+/// The I/O core side of all channels of a Demikernel instance.
+#[derive(Default)]
+pub struct ChannelServer {
+    channels: Slab<ChannelState>,
+    /// Channel and tag of each pending operation.
+    pending: HashMap<QToken, (usize, u64)>,
+    /// Queue token set that holds all pending operations, allocated along with the first channel.
+    qtoken_set: Option<usize>,
+    /// Raised whenever any channel gets a submission.
+    doorbell: Arc<AtomicBool>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Channel {
+    /// Creates a channel with room for `num_entries` submissions and as many completions, which rings `doorbell` on
+    /// every submission.
+    fn new(num_entries: usize, doorbell: Arc<AtomicBool>) -> Result<Self, Fail> {
+        if num_entries == 0 {
+            let cause: String = format!("invalid number of entries (num_entries={:?})", num_entries);
+            error!("new(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let submissions_capacity: usize =
+            ConcurrentRingBuffer::required_capacity(num_entries, mem::size_of::<Submission>());
+        let completions_capacity: usize =
+            ConcurrentRingBuffer::required_capacity(num_entries, mem::size_of::<demi_qresult_t>());
+        Ok(Self {
+            submissions: ConcurrentRingBuffer::new(submissions_capacity)?,
+            completions: ConcurrentRingBuffer::new(completions_capacity)?,
+            closed: AtomicBool::new(false),
+            doorbell,
+        })
+    }
+
+    /// Submits a push of `sga` to the I/O queue `qd`.
+    pub fn submit_push(&self, qd: QDesc, sga: &demi_sgarray_t, tag: u64) -> Result<(), Fail> {
+        self.submit(SubmissionOpcode::Push, qd, tag, *sga)
+    }
+
+    /// Submits a pop from the I/O queue `qd`.
+    pub fn submit_pop(&self, qd: QDesc, tag: u64) -> Result<(), Fail> {
+        self.submit(SubmissionOpcode::Pop, qd, tag, unsafe { mem::zeroed() })
+    }
+
+    /// Submits an accept on the socket `qd`.
+    pub fn submit_accept(&self, qd: QDesc, tag: u64) -> Result<(), Fail> {
+        self.submit(SubmissionOpcode::Accept, qd, tag, unsafe { mem::zeroed() })
+    }
+
+    /// Submits an asynchronous close of the I/O queue `qd`.
+    pub fn submit_close(&self, qd: QDesc, tag: u64) -> Result<(), Fail> {
+        self.submit(SubmissionOpcode::Close, qd, tag, unsafe { mem::zeroed() })
+    }
+
+    /// Submits the release of a scatter-gather array that came out of a pop. This posts no result.
+    pub fn submit_sgafree(&self, sga: &demi_sgarray_t) -> Result<(), Fail> {
+        self.submit(SubmissionOpcode::SgaFree, QDesc::from(0), 0, *sga)
+    }
+
+    /// Takes the next result from the completion ring, if any.
+    pub fn try_reap(&self) -> Option<demi_qresult_t> {
+        // Safety: the completion ring only holds results that the I/O core has written there.
+        unsafe { try_pop_entry(&self.completions) }
+    }
+
+    /// Closes the channel. Operations that are still pending complete, but their results are released by the I/O core
+    /// instead of being posted.
+    pub fn close(&self) {
+        self.closed.store(true, Ordering::Release);
+    }
+
+    fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::Acquire)
+    }
+
+    fn submit(&self, opcode: SubmissionOpcode, qd: QDesc, tag: u64, sga: demi_sgarray_t) -> Result<(), Fail> {
+        if self.is_closed() {
+            let cause: &str = "channel is closed";
+            warn!("submit(): {}", cause);
+            return Err(Fail::new(libc::EBADF, cause));
+        }
+        let submission: Submission = Submission { opcode, qd, tag, sga };
+        self.submissions.try_push(as_bytes(&submission))?;
+        self.doorbell.store(true, Ordering::Release);
+        Ok(())
+    }
+
+    fn take_submission(&self) -> Option<Submission> {
+        // Safety: the submission ring only holds entries that submit() has written there.
+        unsafe { try_pop_entry(&self.submissions) }
+    }
+
+    fn post(&self, qr: &demi_qresult_t) -> Result<(), Fail> {
+        self.completions.try_push(as_bytes(qr))?;
+        Ok(())
+    }
+}
+
+impl ChannelState {
+    /// Posts a result, keeping it for later if the completion ring is full.
+    fn post(&mut self, qr: demi_qresult_t) {
+        if !self.overflow.is_empty() || self.channel.post(&qr).is_err() {
+            self.overflow.push_back(qr);
+        }
+    }
+
+    /// Posts as many of the results that did not fit earlier as the completion ring now has room for.
+    fn flush(&mut self) {
+        while let Some(qr) = self.overflow.front() {
+            if self.channel.post(qr).is_err() {
+                break;
+            }
+            self.overflow.pop_front();
+        }
+    }
+}
+
+impl ChannelServer {
+    /// Creates a channel with room for `num_entries` operations in each direction.
+    pub fn create(&mut self, libos: &mut LibOS, num_entries: usize) -> Result<Arc<Channel>, Fail> {
+        let channel: Arc<Channel> = Arc::new(Channel::new(num_entries, self.doorbell.clone())?);
+        if self.qtoken_set.is_none() {
+            self.qtoken_set = Some(libos.alloc_qtoken_set());
+        }
+        self.channels.insert(ChannelState {
+            channel: channel.clone(),
+            num_pending: 0,
+            overflow: VecDeque::new(),
+        });
+        Ok(channel)
+    }
+
+    /// Runs one round of the I/O core: issues the operations that have been submitted to all channels, then waits up to
+    /// `timeout` for the first of them to complete and posts the results of all operations that have completed. The
+    /// wait ends early, without an error, once a channel gets a new submission. If no operation is pending, this polls
+    /// the libOS once and returns without waiting, as submissions can arrive any time.
+    pub fn serve(&mut self, libos: &mut LibOS, timeout: Option<Duration>) -> Result<(), Fail> {
+        let set: usize = match self.qtoken_set {
+            Some(set) => set,
+            None => {
+                libos.poll();
+                return Ok(());
+            },
+        };
+
+        // 1. Issue new operations in batches, and retire channels that have been closed and have nothing left to do.
+        // Submissions that arrive while we drain the channels ring the doorbell again.
+        self.doorbell.swap(false, Ordering::AcqRel);
+        let pending: &mut HashMap<QToken, (usize, u64)> = &mut self.pending;
+        self.channels.retain(|index, state| {
+            state.flush();
+            let mut num_submissions: usize = 0;
+            while num_submissions < MAX_BATCH_SIZE {
+                match state.channel.take_submission() {
+                    Some(submission) => Self::issue(libos, set, pending, index, state, submission),
+                    None => break,
+                }
+                num_submissions += 1;
+            }
+            if !state.channel.is_closed() {
+                return true;
+            }
+            for qr in state.overflow.drain(..) {
+                Self::release(libos, qr);
+            }
+            while let Some(qr) = state.channel.try_reap() {
+                Self::release(libos, qr);
+            }
+            state.num_pending > 0 || num_submissions == MAX_BATCH_SIZE
+        });
+
+        if self.pending.is_empty() {
+            libos.poll();
+            return Ok(());
+        }
+
+        // 2. Wait for the first result a slice at a time, so that new submissions do not wait for pending operations.
+        // Waits too long to fit an Instant do not time out.
+        let deadline: Option<Instant> = timeout.and_then(|timeout| Instant::now().checked_add(timeout));
+        loop {
+            let slice: Duration = match deadline {
+                Some(deadline) => deadline.saturating_duration_since(Instant::now()).min(WAKEUP_INTERVAL),
+                None => WAKEUP_INTERVAL,
+            };
+            match libos.wait_any_set(set, Some(slice)) {
+                Ok(qr) => {
+                    self.complete(libos, qr);
+                    break;
+                },
+                Err(e) if e.errno == libc::ETIMEDOUT => {
+                    // A new submission cuts the wait short, and a zero timeout only polls.
+                    if self.doorbell.load(Ordering::Acquire) || timeout == Some(Duration::ZERO) {
+                        return Ok(());
+                    }
+                    if deadline.is_some_and(|deadline| Instant::now() >= deadline) {
+                        return Err(e);
+                    }
+                },
+                Err(e) => return Err(e),
+            }
+        }
+
+        // 3. Collect the results of other completed operations without waiting.
+        for _ in 1..MAX_BATCH_SIZE {
+            if self.pending.is_empty() {
+                break;
+            }
+            match libos.wait_any_set(set, Some(Duration::ZERO)) {
+                Ok(qr) => self.complete(libos, qr),
+                Err(e) if e.errno == libc::ETIMEDOUT => break,
+                Err(e) => return Err(e),
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Issues a submitted operation and adds it to the pending ones, or posts its failure right away.
+    fn issue(
+        libos: &mut LibOS,
+        set: usize,
+        pending: &mut HashMap<QToken, (usize, u64)>,
+        index: usize,
+        state: &mut ChannelState,
+        submission: Submission,
+    ) {
+        let result: Result<QToken, Fail> = match submission.opcode {
+            SubmissionOpcode::Push => libos.push(submission.qd, &submission.sga),
+            SubmissionOpcode::Pop => libos.pop(submission.qd, None),
+            SubmissionOpcode::Accept => libos.accept(submission.qd),
+            SubmissionOpcode::Close => libos.async_close(submission.qd),
+            SubmissionOpcode::SgaFree => {
+                if let Err(e) = libos.sgafree(submission.sga) {
+                    warn!("issue(): failed to release scatter-gather array: {:?}", e);
+                }
+                return;
+            },
+        };
+
+        match result {
+            Ok(qt) => {
+                expect_ok!(
+                    libos.insert_into_qtoken_set(set, qt),
+                    "the queue token set of channels should exist"
+                );
+                pending.insert(qt, (index, submission.tag));
+                state.num_pending += 1;
+            },
+            Err(e) => state.post(demi_qresult_t {
+                qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
+                qr_qd: submission.qd.into(),
+                qr_qt: submission.tag,
+                qr_ret: e.errno as i64,
+                qr_value: unsafe { mem::zeroed() },
+            }),
+        }
+    }
+
+    /// Posts the result of a completed operation to its channel, or releases it if the channel has been closed.
+    fn complete(&mut self, libos: &mut LibOS, mut qr: demi_qresult_t) {
+        let (index, tag): (usize, u64) = match self.pending.remove(&QToken::from(qr.qr_qt)) {
+            Some(pending) => pending,
+            None => {
+                warn!("complete(): result does not belong to any channel (qt={:?})", qr.qr_qt);
+                return;
+            },
+        };
+        let state: &mut ChannelState = &mut self.channels[index];
+        state.num_pending -= 1;
+        if state.channel.is_closed() {
+            Self::release(libos, qr);
+        } else {
+            qr.qr_qt = tag;
+            state.post(qr);
+        }
+    }
+
+    /// Releases the resources held by a result that nobody is going to reap.
+    fn release(libos: &mut LibOS, qr: demi_qresult_t) {
+        match qr.qr_opcode {
+            demi_opcode_t::DEMI_OPC_POP => {
+                if let Err(e) = libos.sgafree(unsafe { qr.qr_value.sga }) {
+                    warn!("release(): failed to release scatter-gather array: {:?}", e);
+                }
+            },
+            demi_opcode_t::DEMI_OPC_ACCEPT => {
+                if let Err(e) = libos.close(QDesc::from(unsafe { qr.qr_value.ares.qd })) {
+                    warn!("release(): failed to close accepted socket: {:?}", e);
+                }
+            },
+            _ => (),
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Views an entry as the raw bytes that go into a ring.
+fn as_bytes<T>(entry: &T) -> &[u8] {
+    unsafe { slice::from_raw_parts(entry as *const T as *const u8, mem::size_of::<T>()) }
+}
+
+/// Pops an entry out of a ring, if any.
+///
+/// # Safety
+///
+/// The ring must only hold entries of type `T` that have been pushed with [as_bytes].
+unsafe fn try_pop_entry<T>(ring: &ConcurrentRingBuffer) -> Option<T> {
+    let mut entry: MaybeUninit<T> = MaybeUninit::zeroed();
+    let buf: &mut [u8] = slice::from_raw_parts_mut(entry.as_mut_ptr() as *mut u8, mem::size_of::<T>());
+    match ring.try_pop(buf) {
+        Ok(len) => {
+            debug_assert_eq!(len, mem::size_of::<T>());
+            Some(entry.assume_init())
+        },
+        Err(_) => None,
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        demikernel::channel::{try_pop_entry, Channel, Submission, SubmissionOpcode},
+        runtime::{
+            types::{demi_opcode_t, demi_qresult_t, demi_sgarray_t},
+            QDesc,
+        },
+    };
+    use ::anyhow::Result;
+    use ::std::{mem, sync::Arc, thread};
+
+    const NUM_ENTRIES: usize = 8;
+
+    fn result(qd: u32, tag: u64) -> demi_qresult_t {
+        demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_PUSH,
+            qr_qd: qd,
+            qr_qt: tag,
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+        }
+    }
+
+    // Tests that submissions and results go through a channel unchanged, and that full rings push back.
+    #[test]
+    fn test_channel_roundtrip() -> Result<()> {
+        let channel: Channel = Channel::new(NUM_ENTRIES, Arc::default())?;
+        let mut sga: demi_sgarray_t = unsafe { mem::zeroed() };
+        sga.sga_numsegs = 1;
+        sga.sga_segs[0].sgaseg_len = 42;
+
+        for tag in 0..NUM_ENTRIES as u64 {
+            channel.submit_push(QDesc::from(7), &sga, tag)?;
+        }
+        crate::ensure_eq!(channel.submit_pop(QDesc::from(7), 0).is_err(), true);
+
+        for tag in 0..NUM_ENTRIES as u64 {
+            let submission: Submission = match channel.take_submission() {
+                Some(submission) => submission,
+                None => anyhow::bail!("submission ring should not be empty"),
+            };
+            crate::ensure_eq!(submission.opcode, SubmissionOpcode::Push);
+            crate::ensure_eq!(submission.qd, QDesc::from(7));
+            crate::ensure_eq!(submission.tag, tag);
+            crate::ensure_eq!({ submission.sga.sga_segs[0].sgaseg_len }, 42);
+            channel.post(&result(7, tag))?;
+        }
+        crate::ensure_eq!(channel.take_submission().is_none(), true);
+        crate::ensure_eq!(channel.post(&result(7, 0)).is_err(), true);
+
+        for tag in 0..NUM_ENTRIES as u64 {
+            let qr: demi_qresult_t = match channel.try_reap() {
+                Some(qr) => qr,
+                None => anyhow::bail!("completion ring should not be empty"),
+            };
+            crate::ensure_eq!(qr.qr_opcode, demi_opcode_t::DEMI_OPC_PUSH);
+            crate::ensure_eq!(qr.qr_qt, tag);
+        }
+        crate::ensure_eq!(channel.try_reap().is_none(), true);
+
+        // Nothing can be submitted after the channel is closed.
+        channel.close();
+        crate::ensure_eq!(channel.submit_pop(QDesc::from(7), 0).is_err(), true);
+
+        Ok(())
+    }
+
+    // Tests that several threads can submit operations to one channel at the same time.
+    #[test]
+    fn test_channel_concurrent_submissions() -> Result<()> {
+        const NUM_THREADS: u64 = 4;
+        const NUM_SUBMISSIONS: u64 = 1024;
+        let channel: Channel = Channel::new(NUM_ENTRIES, Arc::default())?;
+
+        let mut received: Vec<u64> = Vec::new();
+        thread::scope(|s| {
+            for thread_id in 0..NUM_THREADS {
+                let channel: &Channel = &channel;
+                s.spawn(move || {
+                    for i in 0..NUM_SUBMISSIONS {
+                        while channel
+                            .submit_pop(QDesc::from(1), thread_id * NUM_SUBMISSIONS + i)
+                            .is_err()
+                        {
+                            thread::yield_now();
+                        }
+                    }
+                });
+            }
+            while received.len() < (NUM_THREADS * NUM_SUBMISSIONS) as usize {
+                match unsafe { try_pop_entry::<Submission>(&channel.submissions) } {
+                    Some(submission) => received.push(submission.tag),
+                    None => thread::yield_now(),
+                }
+            }
+        });
+
+        // Every submission arrives exactly once, and those of each thread arrive in order.
+        for thread_id in 0..NUM_THREADS {
+            let tags: Vec<u64> = received
+                .iter()
+                .cloned()
+                .filter(|tag| tag / NUM_SUBMISSIONS == thread_id)
+                .collect();
+            let expected: Vec<u64> = (0..NUM_SUBMISSIONS).map(|i| thread_id * NUM_SUBMISSIONS + i).collect();
+            crate::ensure_eq!(tags, expected);
+        }
+
+        Ok(())
+    }
+}
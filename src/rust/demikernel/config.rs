@@ -5,7 +5,14 @@
 // Imports
 //======================================================================================================================
 
-use crate::{pal::KeepAlive, runtime::fail::Fail, MacAddress};
+use crate::{
+    pal::KeepAlive,
+    runtime::{
+        fail::Fail,
+        network::{consts::MAX_RECEIVE_BATCH_SIZE, socket::option::CongestionControlAlgorithm},
+    },
+    MacAddress,
+};
 #[cfg(any(feature = "catnip-libos"))]
 use ::std::ffi::CString;
 use ::std::{collections::HashMap, fs::File, io::Read, net::Ipv4Addr, ops::Index, str::FromStr, time::Duration};
@@ -31,6 +38,7 @@ mod tcp_socket_options {
     pub const KEEP_ALIVE: &str = "keepalive";
     pub const LINGER: &str = "linger";
     pub const NO_DELAY: &str = "nodelay";
+    pub const CONGESTION_CONTROL: &str = "congestion_control";
 }
 
 // These only apply to the inetstack.
@@ -45,6 +53,12 @@ mod inetstack_config {
     pub const ENABLE_JUMBO_FRAMES: &str = "enable_jumbo_frames";
     pub const UDP_CHECKSUM_OFFLOAD: &str = "udp_checksum_offload";
     pub const TCP_CHECKSUM_OFFLOAD: &str = "tcp_checksum_offload";
+    pub const TCP_SEGMENTATION_OFFLOAD: &str = "tcp_segmentation_offload";
+    pub const TCP_RECEIVE_COALESCING: &str = "tcp_receive_coalescing";
+    pub const TCP_SYN_COOKIE_THRESHOLD: &str = "tcp_syn_cookie_threshold";
+    pub const RECEIVE_BATCH_SIZE: &str = "receive_batch_size";
+    pub const ADAPTIVE_RECEIVE_BATCH: &str = "adaptive_receive_batch";
+    pub const IDLE_WAIT: &str = "idle_wait";
 }
 
 // DPDK options. These only apply to catnip.
@@ -52,6 +66,20 @@ mod inetstack_config {
 mod dpdk_config {
     pub const SECTION_NAME: &str = "dpdk";
     pub const EAL_INIT_ARGS: &str = "eal_init";
+    pub const NUM_QUEUES: &str = "num_queues";
+}
+
+// io_uring options. These only apply to catnap when built with the catnap-uring feature.
+#[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+mod catnap_config {
+    pub const SECTION_NAME: &str = "catnap";
+    pub const IO_URING_ENTRIES: &str = "io_uring_entries";
+    pub const IO_URING_SQPOLL: &str = "io_uring_sqpoll";
+    pub const IO_URING_SQPOLL_IDLE: &str = "io_uring_sqpoll_idle";
+    pub const IO_URING_FIXED_FILES: &str = "io_uring_fixed_files";
+    pub const IO_URING_RECV_BUFFERS: &str = "io_uring_recv_buffers";
+    // Largest submission ring that the kernel accepts.
+    pub const MAX_IO_URING_ENTRIES: u32 = 32768;
 }
 
 // Raw socket option. This only applies to catpowder.
@@ -62,6 +90,10 @@ mod raw_socket_config {
     pub const LOCAL_INTERFACE_NAME: &str = "linux_interface_name";
     #[cfg(target_os = "windows")]
     pub const LOCAL_INTERFACE_INDEX: &str = "xdp_interface_index";
+    #[cfg(all(feature = "catpowder-xdp", target_os = "linux"))]
+    pub const XDP_QUEUE_COUNT: &str = "xdp_queue_count";
+    #[cfg(all(feature = "catpowder-xdp", target_os = "linux"))]
+    pub const XDP_RING_SIZE: &str = "xdp_ring_size";
 }
 
 //======================================================================================================================
@@ -106,6 +138,11 @@ impl Config {
         Self::get_subsection(&self.0, dpdk_config::SECTION_NAME)
     }
 
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    fn get_catnap_config(&self) -> Result<&Yaml, Fail> {
+        Self::get_subsection(&self.0, catnap_config::SECTION_NAME)
+    }
+
     #[cfg(feature = "catpowder-libos")]
     fn get_raw_socket_config(&self) -> Result<&Yaml, Fail> {
         Self::get_subsection(&self.0, raw_socket_config::SECTION_NAME)
@@ -200,6 +237,26 @@ impl Config {
         }
     }
 
+    /// Tcp socket option: Reads the congestion control algorithm that TCP connections use, by name (e.g., "cubic").
+    /// Returns None if the configuration does not name one, and fails if it names one that we do not know.
+    pub fn congestion_control(&self) -> Result<Option<CongestionControlAlgorithm>, Fail> {
+        if let Some(congestion_control) = Self::get_typed_env_option(tcp_socket_options::CONGESTION_CONTROL)? {
+            return Ok(Some(congestion_control));
+        }
+        let section: &Yaml = match self.0.index(tcp_socket_options::SECTION_NAME) {
+            Yaml::BadValue => return Ok(None),
+            _ => self.get_tcp_socket_options()?,
+        };
+        match section.index(tcp_socket_options::CONGESTION_CONTROL) {
+            Yaml::BadValue => Ok(None),
+            _ => Ok(Some(Self::get_typed_str_option(
+                section,
+                tcp_socket_options::CONGESTION_CONTROL,
+                |name: &str| name.parse().ok(),
+            )?)),
+        }
+    }
+
     /// Tcp Config: Reads the "ARP table" parameter from the underlying configuration file. If no ARP table is present,
     /// then ARP is disabled. This cannot be passed in as an environment variable.
     pub fn arp_table(&self) -> Result<Option<HashMap<Ipv4Addr, MacAddress>>, Fail> {
@@ -292,6 +349,41 @@ impl Config {
         }
     }
 
+    #[cfg(all(feature = "catpowder-xdp", target_os = "linux"))]
+    /// Raw Socket Config: Reads the number of queues of the network interface that get an AF_XDP socket, starting at
+    /// queue zero.
+    pub fn xdp_queue_count(&self) -> Result<u32, Fail> {
+        let nr_queues: u32 = if let Some(nr_queues) = Self::get_typed_env_option(raw_socket_config::XDP_QUEUE_COUNT)? {
+            nr_queues
+        } else {
+            Self::get_int_option(self.get_raw_socket_config()?, raw_socket_config::XDP_QUEUE_COUNT)?
+        };
+
+        if nr_queues == 0 {
+            let cause: String = format!("Invalid number of queues");
+            error!("xdp_queue_count(): {:?}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(nr_queues)
+    }
+
+    #[cfg(all(feature = "catpowder-xdp", target_os = "linux"))]
+    /// Raw Socket Config: Reads the number of elements in each ring of an AF_XDP socket. This must be a power of two.
+    pub fn xdp_ring_size(&self) -> Result<u32, Fail> {
+        let ring_size: u32 = if let Some(ring_size) = Self::get_typed_env_option(raw_socket_config::XDP_RING_SIZE)? {
+            ring_size
+        } else {
+            Self::get_int_option(self.get_raw_socket_config()?, raw_socket_config::XDP_RING_SIZE)?
+        };
+
+        if !ring_size.is_power_of_two() {
+            let cause: String = format!("xdp ring size must be a power of two (size={:?})", ring_size);
+            error!("xdp_ring_size(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(ring_size)
+    }
+
     #[cfg(feature = "catnip-libos")]
     /// DPDK Config: Reads the "DPDK EAL" parameter the underlying configuration file.
     pub fn eal_init_args(&self) -> Result<Vec<CString>, Fail> {
@@ -325,6 +417,100 @@ impl Config {
         Ok(result)
     }
 
+    #[cfg(feature = "catnip-libos")]
+    /// DPDK Config: Reads the number of RX/TX queue pairs to set up on the NIC, which must be a power of two. Each queue
+    /// pair is meant to be driven by its own libOS instance (one per thread).
+    pub fn num_queues(&self) -> Result<u16, Fail> {
+        let num_queues: u16 = if let Some(num_queues) = Self::get_typed_env_option(dpdk_config::NUM_QUEUES)? {
+            num_queues
+        } else {
+            Self::get_int_option(self.get_dpdk_config()?, dpdk_config::NUM_QUEUES)?
+        };
+
+        // Flow rules split the ephemeral ports between queues by their low bits.
+        if !num_queues.is_power_of_two() {
+            let cause: String = format!("Number of queues must be a power of two (num_queues={:?})", num_queues);
+            error!("num_queues(): {:?}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(num_queues)
+    }
+
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    /// Catnap Config: Reads the number of entries in the io_uring submission ring. This bounds the number of operations
+    /// that are handed to the kernel in a single scheduler pass.
+    pub fn io_uring_entries(&self) -> Result<u32, Fail> {
+        let entries: u32 = if let Some(entries) = Self::get_typed_env_option(catnap_config::IO_URING_ENTRIES)? {
+            entries
+        } else {
+            Self::get_int_option(self.get_catnap_config()?, catnap_config::IO_URING_ENTRIES)?
+        };
+
+        if entries == 0 || entries > catnap_config::MAX_IO_URING_ENTRIES {
+            let cause: String = format!(
+                "io_uring entries must be between 1 and {} (entries={:?})",
+                catnap_config::MAX_IO_URING_ENTRIES,
+                entries
+            );
+            error!("io_uring_entries(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(entries)
+    }
+
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    /// Catnap Config: Reads whether a kernel thread should poll the io_uring submission ring, so that submitting does
+    /// not take a system call.
+    pub fn io_uring_sqpoll(&self) -> Result<bool, Fail> {
+        if let Some(sqpoll) = Self::get_typed_env_option(catnap_config::IO_URING_SQPOLL)? {
+            Ok(sqpoll)
+        } else {
+            Self::get_bool_option(self.get_catnap_config()?, catnap_config::IO_URING_SQPOLL)
+        }
+    }
+
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    /// Catnap Config: Reads the number of milliseconds without work after which the submission polling thread goes to
+    /// sleep.
+    pub fn io_uring_sqpoll_idle(&self) -> Result<u32, Fail> {
+        if let Some(idle) = Self::get_typed_env_option(catnap_config::IO_URING_SQPOLL_IDLE)? {
+            Ok(idle)
+        } else {
+            Self::get_int_option(self.get_catnap_config()?, catnap_config::IO_URING_SQPOLL_IDLE)
+        }
+    }
+
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    /// Catnap Config: Reads the number of sockets that are registered with io_uring. Sockets beyond this number still
+    /// work but pay for a file table lookup on every operation.
+    pub fn io_uring_fixed_files(&self) -> Result<u32, Fail> {
+        if let Some(nr_files) = Self::get_typed_env_option(catnap_config::IO_URING_FIXED_FILES)? {
+            Ok(nr_files)
+        } else {
+            Self::get_int_option(self.get_catnap_config()?, catnap_config::IO_URING_FIXED_FILES)
+        }
+    }
+
+    #[cfg(all(feature = "catnap-uring", target_os = "linux"))]
+    /// Catnap Config: Reads the number of receive buffers that the kernel can pick from, which are shared by all
+    /// connected sockets. This must be a power of two. Twice as many buffers are allocated, so that the kernel keeps
+    /// receiving while the application holds on to received data.
+    pub fn io_uring_recv_buffers(&self) -> Result<u16, Fail> {
+        let nr_buffers: u16 =
+            if let Some(nr_buffers) = Self::get_typed_env_option(catnap_config::IO_URING_RECV_BUFFERS)? {
+                nr_buffers
+            } else {
+                Self::get_int_option(self.get_catnap_config()?, catnap_config::IO_URING_RECV_BUFFERS)?
+            };
+
+        if !nr_buffers.is_power_of_two() {
+            let cause: String = format!("io_uring receive buffers must be a power of two (nr={:?})", nr_buffers);
+            error!("io_uring_recv_buffers(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(nr_buffers)
+    }
+
     pub fn mtu(&self) -> Result<u16, Fail> {
         if let Some(addr) = Self::get_typed_env_option(inetstack_config::MTU)? {
             Ok(addr)
@@ -341,6 +527,36 @@ impl Config {
         Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::TCP_CHECKSUM_OFFLOAD)
     }
 
+    /// Inetstack Config: Reads whether TCP hands segments larger than the MSS to the network stack, leaving it to the
+    /// NIC (or to software, when the NIC cannot do it) to cut them into MSS-sized segments.
+    pub fn tcp_segmentation_offload(&self) -> Result<bool, Fail> {
+        if let Some(offload) = Self::get_typed_env_option(inetstack_config::TCP_SEGMENTATION_OFFLOAD)? {
+            Ok(offload)
+        } else {
+            Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::TCP_SEGMENTATION_OFFLOAD)
+        }
+    }
+
+    /// Inetstack Config: Reads whether TCP merges in-order segments of the same connection that arrive in one receive
+    /// burst, and whether the NIC may do so in hardware when it supports it.
+    pub fn tcp_receive_coalescing(&self) -> Result<bool, Fail> {
+        if let Some(coalescing) = Self::get_typed_env_option(inetstack_config::TCP_RECEIVE_COALESCING)? {
+            Ok(coalescing)
+        } else {
+            Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::TCP_RECEIVE_COALESCING)
+        }
+    }
+
+    /// Inetstack Config: Reads the number of handshakes that a listening TCP socket keeps in flight before it answers
+    /// further SYNs with stateless SYN cookies.
+    pub fn tcp_syn_cookie_threshold(&self) -> Result<usize, Fail> {
+        if let Some(threshold) = Self::get_typed_env_option(inetstack_config::TCP_SYN_COOKIE_THRESHOLD)? {
+            Ok(threshold)
+        } else {
+            Self::get_int_option(self.get_inetstack_config()?, inetstack_config::TCP_SYN_COOKIE_THRESHOLD)
+        }
+    }
+
     pub fn udp_checksum_offload(&self) -> Result<bool, Fail> {
         Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::UDP_CHECKSUM_OFFLOAD)
     }
@@ -349,6 +565,47 @@ impl Config {
         Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::ENABLE_JUMBO_FRAMES)
     }
 
+    /// Inetstack Config: Reads the maximum number of packets to pull from the physical layer in a single receive burst.
+    pub fn receive_batch_size(&self) -> Result<usize, Fail> {
+        let batch_size: usize =
+            if let Some(batch_size) = Self::get_typed_env_option(inetstack_config::RECEIVE_BATCH_SIZE)? {
+                batch_size
+            } else {
+                Self::get_int_option(self.get_inetstack_config()?, inetstack_config::RECEIVE_BATCH_SIZE)?
+            };
+
+        if batch_size == 0 || batch_size > MAX_RECEIVE_BATCH_SIZE {
+            let cause: String = format!(
+                "receive batch size must be between 1 and {} (batch_size={:?})",
+                MAX_RECEIVE_BATCH_SIZE, batch_size
+            );
+            error!("receive_batch_size(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(batch_size)
+    }
+
+    /// Inetstack Config: Reads whether the receive burst size should adapt to the load, growing up to
+    /// `receive_batch_size` while bursts come back full and shrinking while they come back empty.
+    pub fn adaptive_receive_batch(&self) -> Result<bool, Fail> {
+        if let Some(adaptive) = Self::get_typed_env_option(inetstack_config::ADAPTIVE_RECEIVE_BATCH)? {
+            Ok(adaptive)
+        } else {
+            Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::ADAPTIVE_RECEIVE_BATCH)
+        }
+    }
+
+    /// Inetstack Config: Reads whether the network stack should stop busy polling once the device has been idle for a
+    /// while, first backing off between polls and then blocking until packets arrive or the next timer is due. Only
+    /// devices that can notify us of incoming packets (e.g., through RX interrupts in catnip) ever block.
+    pub fn idle_wait(&self) -> Result<bool, Fail> {
+        if let Some(idle_wait) = Self::get_typed_env_option(inetstack_config::IDLE_WAIT)? {
+            Ok(idle_wait)
+        } else {
+            Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::IDLE_WAIT)
+        }
+    }
+
     //======================================================================================================================
     // Static Functions
     //======================================================================================================================
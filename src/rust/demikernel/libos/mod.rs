@@ -56,7 +56,17 @@ pub enum LibOS {
 //======================================================================================================================
 
 impl LibOS {
-    pub fn new(libos_name: LibOSName, _perf_callback: Option<demi_callback_t>) -> Result<Self, Fail> {
+    pub fn new(libos_name: LibOSName, perf_callback: Option<demi_callback_t>) -> Result<Self, Fail> {
+        Self::new_on_queue(libos_name, perf_callback, 0)
+    }
+
+    /// Instantiates a LibOS that is bound to the NIC queue `queue_id`. Each thread that wants to drive its own queue
+    /// should instantiate its own LibOS. Only Catnip supports queues other than the first one.
+    pub fn new_on_queue(
+        libos_name: LibOSName,
+        _perf_callback: Option<demi_callback_t>,
+        queue_id: u16,
+    ) -> Result<Self, Fail> {
         timer!("demikernel::new");
 
         logging::initialize();
@@ -76,6 +86,13 @@ impl LibOS {
             set_callback(callback)
         };
 
+        #[cfg(not(feature = "catnip-libos"))]
+        if queue_id != 0 {
+            let cause: String = format!("binding to a NIC queue is not supported (queue_id={:?})", queue_id);
+            error!("new_on_queue(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        }
+
         let config: Config = Config::new(config_path)?;
         #[allow(unused_mut)]
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
@@ -103,7 +120,7 @@ impl LibOS {
             #[cfg(feature = "catnip-libos")]
             LibOSName::Catnip => {
                 // TODO: Remove some of these clones once we are done merging the libOSes.
-                let layer1_endpoint: SharedDPDKRuntime = SharedDPDKRuntime::new(&config)?;
+                let layer1_endpoint: SharedDPDKRuntime = SharedDPDKRuntime::new(&config, queue_id)?;
                 let inetstack: SharedInetStack =
                     SharedInetStack::new(&config, runtime.clone(), layer1_endpoint).unwrap();
 
@@ -278,6 +295,20 @@ impl LibOS {
         result
     }
 
+    /// Pushes a range of a file to a TCP socket.
+    pub fn push_file(&mut self, qd: QDesc, fd: libc::c_int, offset: u64, len: usize) -> Result<QToken, Fail> {
+        let result: Result<QToken, Fail> = {
+            timer!("demikernel::push_file");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.push_file(qd, fd, offset, len),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
     /// Pushes a scatter-gather array to a UDP socket.
     #[allow(unused_variables)]
     pub fn pushto(&mut self, qd: QDesc, sga: &demi_sgarray_t, to: SocketAddr) -> Result<QToken, Fail> {
@@ -335,6 +366,62 @@ impl LibOS {
         }
     }
 
+    /// Allocates a new empty queue token set and returns its identifier.
+    pub fn alloc_qtoken_set(&mut self) -> usize {
+        let result: usize = {
+            timer!("demikernel::alloc_qtoken_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.alloc_qtoken_set(),
+            }
+        };
+
+        result
+    }
+
+    /// Releases a queue token set.
+    pub fn free_qtoken_set(&mut self, set: usize) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::free_qtoken_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.free_qtoken_set(set),
+            }
+        };
+
+        result
+    }
+
+    /// Inserts a queue token into a queue token set.
+    pub fn insert_into_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::insert_into_qtoken_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.insert_into_qtoken_set(set, qt),
+            }
+        };
+
+        result
+    }
+
+    /// Removes a queue token from a queue token set.
+    pub fn remove_from_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::remove_from_qtoken_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.remove_from_qtoken_set(set, qt),
+            }
+        };
+
+        result
+    }
+
+    /// Waits for any of the pending I/O operations in a queue token set to complete or a timeout to expire.
+    pub fn wait_any_set(&mut self, set: usize, timeout: Option<Duration>) -> Result<demi_qresult_t, Fail> {
+        // No profiling scope here because we may enter a coroutine scope.
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.wait_any_set(set, timeout.unwrap_or(TIMEOUT_SECONDS)),
+        }
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -350,6 +437,16 @@ impl LibOS {
         }
     }
 
+    /// Polls once and passes the results of all completed I/O operations to `acceptor`, without waiting. This process
+    /// stops early if the acceptor returns false.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn take_completed_n<Acceptor: FnMut(demi_qresult_t) -> bool>(&mut self, acceptor: Acceptor) {
+        // No profiling scope here because we may enter a coroutine scope.
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.take_completed_n(acceptor),
+        }
+    }
+
     pub fn sgaalloc(&mut self, size: usize) -> Result<demi_sgarray_t, Fail> {
         let result: Result<demi_sgarray_t, Fail> = {
             timer!("demikernel::sgaalloc");
@@ -372,6 +469,30 @@ impl LibOS {
         result
     }
 
+    /// Registers the application memory region of `len` bytes that starts at `addr` for zero-copy I/O.
+    pub fn mem_register(&mut self, addr: *const u8, len: usize) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::mem_register");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.mem_register(addr, len),
+            }
+        };
+
+        result
+    }
+
+    /// Unregisters the application memory region that starts at `addr`.
+    pub fn mem_unregister(&mut self, addr: *const u8) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::mem_unregister");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.mem_unregister(addr),
+            }
+        };
+
+        result
+    }
+
     pub fn poll(&mut self) {
         // No profiling scope here because we may enter a coroutine scope.
         match self {
@@ -12,7 +12,7 @@ use crate::{
     runtime::{
         fail::Fail,
         limits,
-        memory::DemiBuffer,
+        memory::{DemiBuffer, MemoryRegistry},
         network::{
             socket::{option::SocketOption, SocketId},
             transport::NetworkTransport,
@@ -44,6 +44,8 @@ use ::std::{
 pub struct NetworkLibOS<T: NetworkTransport> {
     runtime: SharedDemiRuntime,
     transport: T,
+    /// Application memory regions that are registered for zero-copy I/O.
+    memory_regions: MemoryRegistry,
 }
 
 #[derive(Clone)]
@@ -58,6 +60,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         Self(SharedObject::new(NetworkLibOS::<T> {
             runtime: runtime.clone(),
             transport,
+            memory_regions: MemoryRegistry::default(),
         }))
     }
 
@@ -156,7 +159,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().accept_coroutine(qd).fuse());
+            let coroutine = self.clone().accept_coroutine(qd).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::accept", coroutine)
@@ -207,7 +210,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         // FIXME: add IPv6 support; https://github.com/microsoft/demikernel/issues/935
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().connect_coroutine(qd, remote).fuse());
+            let coroutine = self.clone().connect_coroutine(qd, remote).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::connect", coroutine)
@@ -247,7 +250,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().close_coroutine(qd).fuse());
+            let coroutine = self.clone().close_coroutine(qd).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::close", coroutine)
@@ -298,8 +301,8 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     /// coroutine that asynchronously runs the push and any synchronous multi-queue functionality before the push
     /// begins.
     pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
-        let buf: DemiBuffer = self.transport.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        let buf: DemiBuffer = self.clone_sgarray(sga)?;
+        if buf.chain_len() == 0 {
             let cause: String = format!("zero-length buffer");
             warn!("push(): {}", cause);
             return Err(Fail::new(libc::EINVAL, &cause));
@@ -307,7 +310,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().push_coroutine(qd, buf).fuse());
+            let coroutine = self.clone().push_coroutine(qd, buf).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::push", coroutine)
@@ -337,20 +340,80 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         }
     }
 
+    /// Synchronous code to push [len] bytes of the file [fd], starting at [offset], to a SharedNetworkQueue and its
+    /// underlying socket. This function schedules the coroutine that asynchronously streams the file. The data is never
+    /// copied into a scatter-gather array.
+    pub fn push_file(&mut self, qd: QDesc, fd: libc::c_int, offset: u64, len: usize) -> Result<QToken, Fail> {
+        trace!(
+            "push_file() qd={:?}, fd={:?}, offset={:?}, len={:?}",
+            qd,
+            fd,
+            offset,
+            len
+        );
+
+        if fd < 0 {
+            let cause: String = format!("invalid file descriptor (fd={:?})", fd);
+            warn!("push_file(): {}", cause);
+            return Err(Fail::new(libc::EBADF, &cause));
+        }
+        if len == 0 {
+            let cause: String = format!("zero-length file range");
+            warn!("push_file(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let coroutine_constructor = || -> Result<QToken, Fail> {
+            let coroutine = self.clone().push_file_coroutine(qd, fd, offset, len).fuse();
+            self.runtime
+                .clone()
+                .insert_io_coroutine("ioc::network::libos::push_file", coroutine)
+        };
+
+        queue.push(coroutine_constructor)
+    }
+
+    /// Asynchronous code to push a range of a file to a SharedNetworkQueue and its underlying socket. This function
+    /// returns a coroutine that runs asynchronously until the whole range has been pushed or the push fails.
+    async fn push_file_coroutine(
+        self,
+        qd: QDesc,
+        fd: libc::c_int,
+        offset: u64,
+        len: usize,
+    ) -> (QDesc, OperationResult) {
+        // Grab the queue, make sure it hasn't been closed in the meantime.
+        // This will bump the Rc refcount so the coroutine can have it's own reference to the shared queue data
+        // structure and the SharedNetworkQueue will not be freed until this coroutine finishes.
+        let mut queue: SharedNetworkQueue<T> = match self.get_shared_queue(&qd) {
+            Ok(queue) => queue,
+            Err(e) => return (qd, OperationResult::Failed(e)),
+        };
+        // Wait for push to complete.
+        match queue.push_file_coroutine(fd, offset, len).await {
+            Ok(()) => (qd, OperationResult::Push),
+            Err(e) => {
+                warn!("push_file() qd={:?}: {:?}", qd, &e);
+                (qd, OperationResult::Failed(e))
+            },
+        }
+    }
+
     /// Synchronous code to pushto [buf] to [remote] on a SharedNetworkQueue and its underlying POSIX socket. This
     /// function schedules the coroutine that asynchronously runs the pushto and any synchronous multi-queue
     /// functionality after pushto begins.
     pub fn pushto(&mut self, qd: QDesc, sga: &demi_sgarray_t, remote: SocketAddr) -> Result<QToken, Fail> {
         trace!("pushto() qd={:?}", qd);
 
-        let buf: DemiBuffer = self.transport.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        let buf: DemiBuffer = self.clone_sgarray(sga)?;
+        if buf.chain_len() == 0 {
             return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
         }
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().pushto_coroutine(qd, buf, remote).fuse());
+            let coroutine = self.clone().pushto_coroutine(qd, buf, remote).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::pushto", coroutine)
@@ -391,7 +454,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().pop_coroutine(qd, size).fuse());
+            let coroutine = self.clone().pop_coroutine(qd, size).fuse();
             self.runtime
                 .clone()
                 .insert_io_coroutine("ioc::network::libos::pop", coroutine)
@@ -443,10 +506,42 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
     /// Waits for any of the given pending I/O operations to complete or a timeout to expire.
     pub fn wait_any(&mut self, qts: &[QToken], timeout: Duration) -> Result<(usize, demi_qresult_t), Fail> {
-        let (offset, qt, qd, result) = self.runtime.wait_any(qts, timeout)?;
+        let ret: Result<(usize, QToken, QDesc, OperationResult), Fail> = self.runtime.wait_any(qts, timeout);
+        // Do not leave staged packets behind while the application is not polling us.
+        self.transport.flush();
+        let (offset, qt, qd, result) = ret?;
         Ok((offset, self.create_result(result, qd, qt)))
     }
 
+    /// Allocates a new empty queue token set and returns its identifier.
+    pub fn alloc_qtoken_set(&mut self) -> usize {
+        self.runtime.alloc_qtoken_set()
+    }
+
+    /// Releases a queue token set.
+    pub fn free_qtoken_set(&mut self, set: usize) -> Result<(), Fail> {
+        self.runtime.free_qtoken_set(set)
+    }
+
+    /// Inserts a queue token into a queue token set.
+    pub fn insert_into_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        self.runtime.insert_into_qtoken_set(set, qt)
+    }
+
+    /// Removes a queue token from a queue token set.
+    pub fn remove_from_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        self.runtime.remove_from_qtoken_set(set, qt)
+    }
+
+    /// Waits for any of the pending I/O operations in a queue token set to complete or a timeout to expire.
+    pub fn wait_any_set(&mut self, set: usize, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        let ret: Result<(QToken, QDesc, OperationResult), Fail> = self.runtime.wait_any_set(set, timeout);
+        // Do not leave staged packets behind while the application is not polling us.
+        self.transport.flush();
+        let (qt, qd, result) = ret?;
+        Ok(self.create_result(result, qd, qt))
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -455,9 +550,22 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         mut acceptor: Acceptor,
         timeout: Duration,
     ) -> Result<(), Fail> {
+        let ret: Result<(), Fail> = self
+            .runtime
+            .clone()
+            .wait_next_n(|qt, qd, result| acceptor(self.create_result(result, qd, qt)), timeout);
+        // Do not leave staged packets behind while the application is not polling us.
+        self.transport.flush();
+        ret
+    }
+
+    /// Polls once and passes the results of all completed I/O operations to `acceptor`, without waiting. This process
+    /// stops early if the acceptor returns false.
+    pub fn take_completed_n<Acceptor: FnMut(demi_qresult_t) -> bool>(&mut self, mut acceptor: Acceptor) {
         self.runtime
             .clone()
-            .wait_next_n(|qt, qd, result| acceptor(self.create_result(result, qd, qt)), timeout)
+            .take_completed_n(|qt, qd, result| acceptor(self.create_result(result, qd, qt)));
+        self.transport.flush();
     }
 
     pub fn create_result(&self, result: OperationResult, qd: QDesc, qt: QToken) -> demi_qresult_t {
@@ -544,7 +652,8 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
     /// Runs all runnable coroutines.
     pub fn poll(&mut self) {
-        self.runtime.poll()
+        self.runtime.poll();
+        self.transport.flush();
     }
 
     /// Releases a scatter-gather array.
@@ -552,6 +661,28 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         self.transport.sgafree(sga)
     }
 
+    /// Registers the application memory region of `len` bytes that starts at `addr` for zero-copy I/O.
+    pub fn mem_register(&mut self, addr: *const u8, len: usize) -> Result<(), Fail> {
+        trace!("mem_register() addr={:?}, len={:?}", addr, len);
+        self.memory_regions.register(addr, len)
+    }
+
+    /// Unregisters the application memory region that starts at `addr`.
+    pub fn mem_unregister(&mut self, addr: *const u8) -> Result<(), Fail> {
+        trace!("mem_unregister() addr={:?}", addr);
+        self.memory_regions.unregister(addr)
+    }
+
+    /// Gets a buffer for the data of a scatter-gather array that is about to be pushed. Scatter-gather arrays without a
+    /// buffer token were built by the application on top of registered memory.
+    fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+        if sga.sga_buf.is_null() {
+            self.memory_regions.clone_sgarray(sga)
+        } else {
+            self.transport.clone_sgarray(sga)
+        }
+    }
+
     /// This function gets a shared queue reference out of the I/O queue table. The type if a ref counted pointer to the
     /// queue itself.
     fn get_shared_queue(&self, qd: &QDesc) -> Result<SharedNetworkQueue<T>, Fail> {
@@ -192,6 +192,18 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Pushes a range of a file to a TCP socket.
+    pub fn push_file(&mut self, sockqd: QDesc, fd: libc::c_int, offset: u64, len: usize) -> Result<QToken, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.push_file(sockqd, fd, offset, len),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.push_file(sockqd, fd, offset, len),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.push_file(sockqd, fd, offset, len),
+        }
+    }
+
     /// Pushes a scatter-gather array to a UDP socket.
     #[allow(unused_variables)]
     pub fn pushto(&mut self, sockqd: QDesc, sga: &demi_sgarray_t, to: SocketAddr) -> Result<QToken, Fail> {
@@ -243,6 +255,66 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Allocates a new empty queue token set and returns its identifier.
+    pub fn alloc_qtoken_set(&mut self) -> usize {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.alloc_qtoken_set(),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.alloc_qtoken_set(),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.alloc_qtoken_set(),
+        }
+    }
+
+    /// Releases a queue token set.
+    pub fn free_qtoken_set(&mut self, set: usize) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.free_qtoken_set(set),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.free_qtoken_set(set),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.free_qtoken_set(set),
+        }
+    }
+
+    /// Inserts a queue token into a queue token set.
+    pub fn insert_into_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.insert_into_qtoken_set(set, qt),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.insert_into_qtoken_set(set, qt),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.insert_into_qtoken_set(set, qt),
+        }
+    }
+
+    /// Removes a queue token from a queue token set.
+    pub fn remove_from_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.remove_from_qtoken_set(set, qt),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.remove_from_qtoken_set(set, qt),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.remove_from_qtoken_set(set, qt),
+        }
+    }
+
+    /// Waits for any of the pending I/O operations in a queue token set to complete or a timeout to expire.
+    pub fn wait_any_set(&mut self, set: usize, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.wait_any_set(set, timeout),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.wait_any_set(set, timeout),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.wait_any_set(set, timeout),
+        }
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -261,6 +333,19 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Polls once and passes the results of all completed I/O operations to `acceptor`, without waiting. This process
+    /// stops early if the acceptor returns false.
+    pub fn take_completed_n<Acceptor: FnMut(demi_qresult_t) -> bool>(&mut self, acceptor: Acceptor) {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.take_completed_n(acceptor),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.take_completed_n(acceptor),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.take_completed_n(acceptor),
+        }
+    }
+
     /// Waits for any operation in an I/O queue.
     pub fn poll(&mut self) {
         match self {
@@ -300,4 +385,28 @@ impl NetworkLibOSWrapper {
             NetworkLibOSWrapper::Catnip(libos) => libos.sgafree(sga),
         }
     }
+
+    /// Registers an application memory region for zero-copy I/O.
+    pub fn mem_register(&mut self, addr: *const u8, len: usize) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.mem_register(addr, len),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.mem_register(addr, len),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.mem_register(addr, len),
+        }
+    }
+
+    /// Unregisters an application memory region.
+    pub fn mem_unregister(&mut self, addr: *const u8) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.mem_unregister(addr),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.mem_unregister(addr),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.mem_unregister(addr),
+        }
+    }
 }
@@ -5,16 +5,19 @@
 // Imports
 //======================================================================================================================
 
-use crate::runtime::{
-    fail::Fail,
-    limits,
-    memory::DemiBuffer,
-    network::{
-        socket::{operation::SocketOp, option::SocketOption, state::SocketStateMachine},
-        transport::NetworkTransport,
+use crate::{
+    inetstack::protocols::MAX_HEADER_SIZE,
+    runtime::{
+        fail::Fail,
+        limits,
+        memory::DemiBuffer,
+        network::{
+            socket::{operation::SocketOp, option::SocketOption, state::SocketStateMachine},
+            transport::NetworkTransport,
+        },
+        queue::{IoQueue, QType},
+        QToken, SharedObject,
     },
-    queue::{IoQueue, QType},
-    QToken, SharedObject,
 };
 use ::futures::{pin_mut, select_biased, FutureExt};
 use ::socket2::{Domain, Type};
@@ -279,6 +282,13 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     pub async fn push_coroutine(&mut self, buf: &mut DemiBuffer, addr: Option<SocketAddr>) -> Result<(), Fail> {
         self.state_machine.may_push()?;
 
+        // Buffers that back multi-segment scatter-gather arrays are chains. A datagram has to go out as a single
+        // packet, so we flatten the chain. A stream hands the whole chain to the transport in one push, which sends
+        // the segments one after the other.
+        if buf.num_segments() > 1 && self.qtype == QType::UdpSocket {
+            *buf = buf.linearize(MAX_HEADER_SIZE as u16)?;
+        }
+
         let result = {
             let mut state_machine: SocketStateMachine = self.state_machine.clone();
             let mut transport: T = self.transport.clone();
@@ -298,6 +308,29 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
         result
     }
 
+    /// Asynchronously push `len` bytes of the file `fd`, starting at `offset`, to the queue. Only streams carry files,
+    /// as a datagram cannot span a whole file.
+    pub async fn push_file_coroutine(&mut self, fd: libc::c_int, offset: u64, len: usize) -> Result<(), Fail> {
+        self.state_machine.may_push()?;
+        if self.qtype != QType::TcpSocket {
+            let cause: String = format!("files can only be pushed to TCP sockets (qtype={:?})", self.qtype);
+            warn!("push_file_coroutine(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        }
+
+        let mut state_machine: SocketStateMachine = self.state_machine.clone();
+        let mut transport: T = self.transport.clone();
+        let state_tracker = state_machine.while_may_push().fuse();
+        let operation = transport.push_file(&mut self.socket, fd, offset, len).fuse();
+        pin_mut!(state_tracker);
+        pin_mut!(operation);
+
+        select_biased! {
+            fail = state_tracker => Err(fail),
+            result = operation => result,
+        }
+    }
+
     /// Schedules a coroutine to pop from this queue. This function contains all of the single-queue,
     /// asynchronous code necessary to pop a buffer from this queue and any single-queue functionality after the pop
     /// completes.
@@ -2,5 +2,6 @@
 // Licensed under the MIT license.
 
 pub mod bindings;
+pub mod channel;
 pub mod config;
 pub mod libos;
@@ -13,21 +13,24 @@ use crate::{
     inetstack::protocols::layer4::{Peer, Socket},
     runtime::{
         fail::Fail,
-        memory::{DemiBuffer, MemoryRuntime},
+        limits,
+        memory::{DemiBuffer, MemoryRegion, MemoryRuntime},
         network::{socket::option::SocketOption, transport::NetworkTransport},
         poll_yield, SharedDemiRuntime, SharedObject,
     },
 };
 use ::socket2::{Domain, Type};
 #[cfg(test)]
-use ::std::{collections::HashMap, hash::RandomState, net::Ipv4Addr, time::Duration};
+use ::std::{collections::HashMap, hash::RandomState, net::Ipv4Addr};
 use protocols::{layer1::PhysicalLayer, layer2::SharedLayer2Endpoint, layer3::SharedLayer3Endpoint};
 
 use ::futures::FutureExt;
 use ::std::{
     fmt::Debug,
+    hint,
     net::{SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
+    time::Duration,
 };
 
 use crate::timer;
@@ -47,6 +50,12 @@ pub mod protocols;
 //======================================================================================================================
 
 const MAX_RECV_ITERS: usize = 2;
+/// Number of empty receive bursts in a row after which an idle network stack backs off between polls.
+const IDLE_PAUSE_POLLS: usize = 64;
+/// Number of empty receive bursts in a row after which an idle network stack blocks until packets arrive.
+const IDLE_WAIT_POLLS: usize = 4096;
+/// Longest that an idle network stack blocks at once, in case the device misses a notification.
+const MAX_IDLE_WAIT: Duration = Duration::from_millis(10);
 
 //======================================================================================================================
 // Structures
@@ -56,6 +65,8 @@ const MAX_RECV_ITERS: usize = 2;
 pub struct InetStack {
     runtime: SharedDemiRuntime,
     layer4_endpoint: Peer,
+    /// Whether we stop busy polling while the device is idle.
+    idle_wait: bool,
 }
 
 #[derive(Clone)]
@@ -80,15 +91,18 @@ impl SharedInetStack {
         layer1_endpoint: P,
     ) -> Result<Self, Fail> {
         let rng_seed: [u8; 32] = [0; 32];
+        let ephemeral_port_share: (u16, u16) = layer1_endpoint.ephemeral_port_share();
         let layer2_endpoint: SharedLayer2Endpoint = SharedLayer2Endpoint::new(config, layer1_endpoint)?;
         let layer3_endpoint: SharedLayer3Endpoint =
             SharedLayer3Endpoint::new(config, runtime.clone(), layer2_endpoint, rng_seed)?;
-        let layer4_endpoint: Peer = Peer::new(config, runtime.clone(), layer3_endpoint, rng_seed)?;
+        let layer4_endpoint: Peer =
+            Peer::new(config, runtime.clone(), layer3_endpoint, rng_seed, ephemeral_port_share)?;
         let me: Self = Self(SharedObject::<InetStack>::new(InetStack {
             runtime: runtime.clone(),
             layer4_endpoint,
+            idle_wait: config.idle_wait().unwrap_or(false),
         }));
-        runtime.insert_background_coroutine("bgc::inetstack::poll_recv", Box::pin(me.clone().poll().fuse()))?;
+        runtime.insert_background_coroutine("bgc::inetstack::poll_recv", me.clone().poll().fuse())?;
         Ok(me)
     }
 
@@ -101,10 +115,32 @@ impl SharedInetStack {
             for _ in 0..MAX_RECV_ITERS {
                 self.layer4_endpoint.poll_once();
             }
+            // Push out whatever was staged for transmission during this scheduler pass.
+            self.layer4_endpoint.flush();
+            if self.idle_wait {
+                self.idle();
+            }
             poll_yield().await;
         }
     }
 
+    /// Backs off from busy polling while the device stays idle. After a short run of empty receive bursts we pause the
+    /// CPU between polls, and after a long one we block until packets arrive, the next timer is due or the wait of the
+    /// application times out. A single packet brings us back to busy polling.
+    fn idle(&mut self) {
+        let idle_polls: usize = self.layer4_endpoint.idle_polls();
+        if idle_polls < IDLE_PAUSE_POLLS {
+            return;
+        }
+        if idle_polls < IDLE_WAIT_POLLS {
+            hint::spin_loop();
+            return;
+        }
+        if let Some(timeout) = self.runtime.get_idle_timeout(MAX_IDLE_WAIT) {
+            self.layer4_endpoint.wait_for_packets(timeout);
+        }
+    }
+
     #[cfg(test)]
     /// Schedule a ping.
     pub async fn ping(&mut self, addr: Ipv4Addr, timeout: Option<Duration>) -> Result<Duration, Fail> {
@@ -284,6 +320,30 @@ impl NetworkTransport for SharedInetStack {
         self.layer4_endpoint.push(sd, buf, addr).await
     }
 
+    /// Pushes a range of a file to a TCP socket. Each window of the file goes to the sender as a single chain of
+    /// external buffers, so the sender keeps a whole window in flight instead of waiting for each segment to be
+    /// acknowledged.
+    async fn push_file(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        fd: libc::c_int,
+        offset: u64,
+        len: usize,
+    ) -> Result<(), Fail> {
+        timer!("inetstack::push_file");
+
+        let mut offset: u64 = offset;
+        let mut remaining: usize = len;
+        while remaining > 0 {
+            let window: usize = remaining.min(limits::PUSH_FILE_WINDOW_SIZE);
+            let mut buf: DemiBuffer = MemoryRegion::map_file(fd, offset, window)?;
+            self.layer4_endpoint.push(sd, &mut buf, None).await?;
+            offset += window as u64;
+            remaining -= window;
+        }
+        Ok(())
+    }
+
     /// Create a pop request to write data from IO connection represented by `qd` into a buffer
     /// allocated by the application.
     async fn pop(
@@ -294,6 +354,11 @@ impl NetworkTransport for SharedInetStack {
         self.layer4_endpoint.pop(sd, size).await
     }
 
+    /// Flushes any packets that the physical layer has staged for transmission.
+    fn flush(&mut self) {
+        self.layer4_endpoint.flush()
+    }
+
     fn get_runtime(&self) -> &SharedDemiRuntime {
         &self.runtime
     }
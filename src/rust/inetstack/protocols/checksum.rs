@@ -0,0 +1,311 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Internet checksum (RFC 1071) shared by IPv4, ICMPv4, TCP and UDP.
+//!
+//! The ones' complement sum does not depend on byte order, so we add up words in the native (little-endian) byte order
+//! of the machine, many at a time, and swap the bytes of the folded result once at the end. On x86_64 we use AVX2 when
+//! the CPU has it, and on aarch64 we always use NEON. Short buffers (e.g., headers) take the scalar path.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+#[cfg(target_arch = "aarch64")]
+use ::std::arch::aarch64::{uint32x4_t, vdupq_n_u32, vld1q_u8, vpadalq_u16, vreinterpretq_u16_u8};
+#[cfg(target_arch = "x86_64")]
+use ::std::arch::x86_64::{
+    __m256i, _mm256_add_epi32, _mm256_and_si256, _mm256_loadu_si256, _mm256_set1_epi32, _mm256_setzero_si256,
+    _mm256_srli_epi32, _mm256_storeu_si256,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Buffers shorter than this are not worth the setup of the vector kernels.
+const MIN_VECTOR_SUM_SIZE: usize = 64;
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Computes the generic checksum of a bytes array.
+///
+/// This sums all 16-bit big-endian words of the array into a 32-bit variable, padding the last octet with zero if the
+/// array has an odd length. The sum starts from `start` if given, or from 0xFFFF (i.e., ones' complement zero)
+/// otherwise, so a nonzero start keeps the result nonzero. The result is congruent to the full sum modulo 0xFFFF and it
+/// fits in 16 bits, so callers may keep adding words to it before they fold it with [fold16].
+pub fn compute_generic_checksum(buf: &[u8], start: Option<u32>) -> u32 {
+    let state: u64 = match start {
+        Some(state) => state as u64,
+        None => 0xFFFF,
+    };
+    let sum: u64 = if buf.len() < MIN_VECTOR_SUM_SIZE {
+        scalar_sum(buf)
+    } else {
+        vector_sum(buf)
+    };
+    fold32(state + swap_sum(sum) as u64)
+}
+
+/// Computes the generic checksum of the concatenation of `segments` (e.g., the segments of a buffer chain), just as
+/// [compute_generic_checksum] would for a single array that holds them all. Segments may have any length: one that
+/// starts at an odd offset adds its words with their bytes swapped (RFC 1071, section 2.B).
+pub fn compute_segments_checksum<'a>(segments: impl Iterator<Item = &'a [u8]>, start: Option<u32>) -> u32 {
+    let mut state: u64 = match start {
+        Some(state) => state as u64,
+        None => 0xFFFF,
+    };
+    let mut odd_offset: bool = false;
+    for segment in segments {
+        // This fits in 16 bits, as the result of compute_generic_checksum() always does.
+        let sum: u16 = compute_generic_checksum(segment, Some(0)) as u16;
+        state += if odd_offset { sum.swap_bytes() } else { sum } as u64;
+        odd_offset ^= segment.len() % 2 == 1;
+    }
+    fold32(state)
+}
+
+/// Folds 32-bit sum into 16-bit checksum value.
+pub fn fold16(state: u32) -> u16 {
+    !(fold32(state as u64) as u16)
+}
+
+/// Updates `checksum` for a rewrite of the 16-bit word `old` into `new` anywhere in the data that it covers (RFC 1624,
+/// eqn. 3). This spares a full pass over the data when only a header field changes. As `checksum` comes from [fold16],
+/// it is never 0xFFFF, so the sum is nonzero and the result is the same that [fold16] would give.
+pub fn update_checksum(checksum: u16, old: u16, new: u16) -> u16 {
+    let state: u64 = (!checksum) as u64 + (!old) as u64 + new as u64;
+    !(fold32(state) as u16)
+}
+
+/// Updates `checksum` for a rewrite of the 32-bit word `old` into `new` (e.g., a TCP sequence number).
+pub fn update_checksum32(checksum: u16, old: u32, new: u32) -> u16 {
+    let checksum: u16 = update_checksum(checksum, (old >> 16) as u16, (new >> 16) as u16);
+    update_checksum(checksum, old as u16, new as u16)
+}
+
+/// Folds the carries of `state` back into it until it fits in 16 bits, which leaves its value modulo 0xFFFF and its
+/// being nonzero untouched.
+fn fold32(mut state: u64) -> u32 {
+    while state > 0xFFFF {
+        state = (state & 0xFFFF) + (state >> 16);
+    }
+    state as u32
+}
+
+/// Turns a sum of native-order words into the equivalent sum of big-endian words.
+fn swap_sum(sum: u64) -> u16 {
+    (fold32(sum) as u16).swap_bytes()
+}
+
+/// Sums the 16-bit words of `buf`, read in little-endian order, without folding the carries.
+#[cfg(target_arch = "x86_64")]
+fn vector_sum(buf: &[u8]) -> u64 {
+    if is_x86_feature_detected!("avx2") {
+        // Safety: we just checked that the CPU supports AVX2.
+        unsafe { avx2_sum(buf) }
+    } else {
+        scalar_sum(buf)
+    }
+}
+
+/// Sums the 16-bit words of `buf`, read in little-endian order, without folding the carries.
+#[cfg(target_arch = "aarch64")]
+fn vector_sum(buf: &[u8]) -> u64 {
+    // Safety: NEON is part of the baseline of aarch64.
+    unsafe { neon_sum(buf) }
+}
+
+/// Sums the 16-bit words of `buf`, read in little-endian order, without folding the carries.
+#[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+fn vector_sum(buf: &[u8]) -> u64 {
+    scalar_sum(buf)
+}
+
+/// Sums the 16-bit words of `buf` eight bytes at a time.
+fn scalar_sum(buf: &[u8]) -> u64 {
+    let mut sum: u64 = 0;
+    let mut chunks: ::std::slice::ChunksExact<u8> = buf.chunks_exact(8);
+    for chunk in &mut chunks {
+        // This unwrap won't panic, as chunks are exactly eight bytes long.
+        let word: u64 = u64::from_le_bytes(chunk.try_into().unwrap());
+        sum += (word & 0xFFFF_FFFF) + (word >> 32);
+    }
+    let mut words: ::std::slice::ChunksExact<u8> = chunks.remainder().chunks_exact(2);
+    for word in &mut words {
+        sum += u16::from_le_bytes([word[0], word[1]]) as u64;
+    }
+    // An odd byte at the end is the high-order byte of a big-endian word, which is the low-order byte here.
+    if let Some(&b) = words.remainder().get(0) {
+        sum += b as u64;
+    }
+    sum
+}
+
+/// Sums the 16-bit words of `buf` with AVX2, 32 bytes at a time.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn avx2_sum(buf: &[u8]) -> u64 {
+    // Each 32-bit lane takes two 16-bit words per iteration, so it cannot overflow within a block of this many.
+    const BLOCK_ITERATIONS: usize = 1 << 15;
+
+    let mut sum: u64 = 0;
+    let mut chunks: ::std::slice::ChunksExact<u8> = buf.chunks_exact(32);
+    let mask: __m256i = _mm256_set1_epi32(0xFFFF);
+    loop {
+        let mut acc: __m256i = _mm256_setzero_si256();
+        let mut iterations: usize = 0;
+        while iterations < BLOCK_ITERATIONS {
+            let Some(chunk) = chunks.next() else { break };
+            // Safety: the chunk is 32 bytes long, and unaligned loads are allowed.
+            let v: __m256i = _mm256_loadu_si256(chunk.as_ptr() as *const __m256i);
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, mask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+            iterations += 1;
+        }
+        let mut lanes: [u32; 8] = [0; 8];
+        _mm256_storeu_si256(lanes.as_mut_ptr() as *mut __m256i, acc);
+        sum += lanes.iter().map(|&lane| lane as u64).sum::<u64>();
+        if iterations < BLOCK_ITERATIONS {
+            break;
+        }
+    }
+    sum + scalar_sum(chunks.remainder())
+}
+
+/// Sums the 16-bit words of `buf` with NEON, 16 bytes at a time.
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn neon_sum(buf: &[u8]) -> u64 {
+    // Each 32-bit lane takes two 16-bit words per iteration, so it cannot overflow within a block of this many.
+    const BLOCK_ITERATIONS: usize = 1 << 15;
+
+    let mut sum: u64 = 0;
+    let mut chunks: ::std::slice::ChunksExact<u8> = buf.chunks_exact(16);
+    loop {
+        let mut acc: uint32x4_t = vdupq_n_u32(0);
+        let mut iterations: usize = 0;
+        while iterations < BLOCK_ITERATIONS {
+            let Some(chunk) = chunks.next() else { break };
+            // Safety: the chunk is 16 bytes long, and unaligned loads are allowed.
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(chunk.as_ptr())));
+            iterations += 1;
+        }
+        // Four lanes of at most 32 bits each cannot overflow a 64-bit sum, but they can overflow a 32-bit one.
+        let lanes: [u32; 4] = ::std::mem::transmute(acc);
+        sum += lanes.iter().map(|&lane| lane as u64).sum::<u64>();
+        if iterations < BLOCK_ITERATIONS {
+            break;
+        }
+    }
+    sum + scalar_sum(chunks.remainder())
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::checksum::{
+        compute_generic_checksum, compute_segments_checksum, fold16, update_checksum, update_checksum32,
+    };
+    use ::anyhow::Result;
+
+    // Computes the checksum of `buf` one big-endian word at a time, as RFC 1071 describes it.
+    fn reference_checksum(buf: &[u8], start: u32) -> u16 {
+        let mut state: u64 = start as u64;
+        for word in buf.chunks(2) {
+            state += u16::from_be_bytes([word[0], *word.get(1).unwrap_or(&0)]) as u64;
+        }
+        while state > 0xFFFF {
+            state -= 0xFFFF;
+        }
+        !state as u16
+    }
+
+    fn test_data(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i.wrapping_mul(2654435761) >> 7) as u8).collect()
+    }
+
+    // Tests that the checksum matches the reference for all lengths and alignments, including those that take the
+    // vector kernels and their scalar tails.
+    #[test]
+    fn test_checksum_matches_reference() -> Result<()> {
+        let data: Vec<u8> = test_data(4096);
+        for offset in 0..8 {
+            for len in (0..300).chain([1023, 1024, 1500, 4000].into_iter()) {
+                let buf: &[u8] = &data[offset..offset + len];
+                crate::ensure_eq!(
+                    fold16(compute_generic_checksum(buf, None)),
+                    reference_checksum(buf, 0xFFFF)
+                );
+                crate::ensure_eq!(
+                    fold16(compute_generic_checksum(buf, Some(7))),
+                    reference_checksum(buf, 7)
+                );
+            }
+        }
+
+        // All ones sum up to ones' complement zero.
+        crate::ensure_eq!(fold16(compute_generic_checksum(&[0xFF; 1024], None)), 0);
+
+        Ok(())
+    }
+
+    // Tests that the checksum of a buffer that is too large for a single block of the vector kernels is right.
+    #[test]
+    fn test_checksum_large_buffer() -> Result<()> {
+        let data: Vec<u8> = vec![0xFF; 3 << 20];
+        crate::ensure_eq!(
+            fold16(compute_generic_checksum(&data, None)),
+            reference_checksum(&data, 0xFFFF)
+        );
+        let data: Vec<u8> = test_data(3 << 20);
+        crate::ensure_eq!(
+            fold16(compute_generic_checksum(&data, None)),
+            reference_checksum(&data, 0xFFFF)
+        );
+        Ok(())
+    }
+
+    // Tests that the checksum of a buffer split into segments of any lengths, odd ones included, matches the checksum of
+    // the whole buffer.
+    #[test]
+    fn test_segments_checksum() -> Result<()> {
+        let data: Vec<u8> = test_data(1500);
+        for cuts in [[0, 0], [1, 2], [3, 4], [7, 100], [64, 65], [101, 1499], [1500, 1500]] {
+            let segments: [&[u8]; 3] = [&data[..cuts[0]], &data[cuts[0]..cuts[1]], &data[cuts[1]..]];
+            crate::ensure_eq!(
+                fold16(compute_segments_checksum(segments.into_iter(), None)),
+                fold16(compute_generic_checksum(&data, None))
+            );
+            crate::ensure_eq!(
+                fold16(compute_segments_checksum(segments.into_iter(), Some(7))),
+                reference_checksum(&data, 7)
+            );
+        }
+        Ok(())
+    }
+
+    // Tests that incremental updates agree with a checksum of the rewritten data.
+    #[test]
+    fn test_incremental_update() -> Result<()> {
+        let mut data: Vec<u8> = test_data(1500);
+        let checksum: u16 = fold16(compute_generic_checksum(&data, None));
+
+        let old: u16 = u16::from_be_bytes([data[2], data[3]]);
+        data[2..4].copy_from_slice(&0x1234u16.to_be_bytes());
+        let checksum: u16 = update_checksum(checksum, old, 0x1234);
+        crate::ensure_eq!(checksum, fold16(compute_generic_checksum(&data, None)));
+
+        let old: u32 = u32::from_be_bytes(data[100..104].try_into()?);
+        data[100..104].copy_from_slice(&0xdeadbeefu32.to_be_bytes());
+        let checksum: u16 = update_checksum32(checksum, old, 0xdeadbeef);
+        crate::ensure_eq!(checksum, fold16(compute_generic_checksum(&data, None)));
+
+        Ok(())
+    }
+}
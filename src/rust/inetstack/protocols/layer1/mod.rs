@@ -15,8 +15,9 @@ use arrayvec::ArrayVec;
 use crate::runtime::{
     fail::Fail,
     memory::{DemiBuffer, MemoryRuntime},
-    network::consts::RECEIVE_BATCH_SIZE,
+    network::consts::MAX_RECEIVE_BATCH_SIZE,
 };
+use ::std::time::Duration;
 
 //======================================================================================================================
 // Traits
@@ -25,9 +26,43 @@ use crate::runtime::{
 /// API for the Physical Layer for any underlying hardware that implements a raw NIC interface (e.g., DPDK, raw
 /// sockets).
 pub trait PhysicalLayer: 'static + MemoryRuntime {
-    /// Transmits a single [PacketBuf].
+    /// Transmits a single [PacketBuf]. Implementations may stage the packet and hand it to the device later, in which
+    /// case it goes out on the next call to [flush](Self::flush) at the latest.
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail>;
 
-    /// Receives a batch of [DemiBuffer].
-    fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail>;
+    /// Hands all packets staged by [transmit](Self::transmit) to the device. Physical layers that transmit packets
+    /// immediately do not need to override this.
+    fn flush(&mut self) -> Result<(), Fail> {
+        Ok(())
+    }
+
+    /// Checks whether the device cuts `pkt`, a TCP segment that is marked with a
+    /// [segment size](DemiBuffer::tso_segment_size), into segments of that size by itself. The network stack cuts the
+    /// segments that the device does not before handing them to [transmit](Self::transmit).
+    fn offloads_segmentation(&self, _pkt: &DemiBuffer) -> bool {
+        false
+    }
+
+    /// Gets the share of the ephemeral ports that the device delivers to this physical layer, as `(share, num_shares)`:
+    /// flows whose local port `p` is ephemeral arrive here if and only if `p % num_shares == share`. The network stack
+    /// only picks local ports from this share. Physical layers that receive every flow do not need to override this.
+    fn ephemeral_port_share(&self) -> (u16, u16) {
+        (0, 1)
+    }
+
+    /// Receives a burst of [DemiBuffer] and appends it to `batch`, which is owned by the caller and reused across calls.
+    /// Implementations append at most `burst_size` packets and never more than the remaining capacity of `batch`.
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail>;
+
+    /// Blocks until the device may have received packets or `timeout` elapses, whichever comes first. The network stack
+    /// calls this only when the device has been idle for a while and no coroutine has work to do, and goes back to
+    /// polling right after. Physical layers that cannot be notified of incoming packets do not need to override this,
+    /// and the network stack then keeps polling.
+    fn wait_for_packets(&mut self, _timeout: Duration) -> Result<(), Fail> {
+        Ok(())
+    }
 }
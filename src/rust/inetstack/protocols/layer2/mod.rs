@@ -6,6 +6,8 @@
 //======================================================================================================================
 
 pub mod ethernet2;
+mod segmentation;
+
 pub use self::ethernet2::{
     header::{Ethernet2Header, ETHERNET2_HEADER_SIZE, MIN_PAYLOAD_SIZE},
     protocol::EtherType2,
@@ -19,15 +21,29 @@ use crate::{
     demi_sgarray_t,
     demikernel::config::Config,
     inetstack::protocols::layer1::PhysicalLayer,
+    perftools::stats,
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::{consts::RECEIVE_BATCH_SIZE, types::MacAddress},
+        network::{
+            consts::{DEFAULT_RECEIVE_BATCH_SIZE, MAX_RECEIVE_BATCH_SIZE},
+            types::MacAddress,
+        },
         SharedObject,
     },
 };
 use ::arrayvec::ArrayVec;
-use ::std::ops::{Deref, DerefMut};
+use ::std::{
+    ops::{Deref, DerefMut},
+    time::Duration,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of packets that the adaptive receive burst never shrinks below.
+const MIN_ADAPTIVE_RECEIVE_BATCH_SIZE: usize = 4;
 
 //======================================================================================================================
 // Structures
@@ -36,6 +52,18 @@ use ::std::ops::{Deref, DerefMut};
 pub struct Layer2Endpoint {
     layer1_endpoint: Box<dyn PhysicalLayer>,
     local_link_addr: MacAddress,
+    /// Scratch batch handed to the physical layer on every receive, so that received packets are not copied around.
+    rx_batch: ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+    /// Number of packets requested from the physical layer on the next receive.
+    rx_burst_size: usize,
+    /// Upper bound for the receive burst size, as set in the configuration file.
+    max_rx_burst_size: usize,
+    /// Whether the receive burst size adapts to the load.
+    adaptive_rx_burst: bool,
+    /// Number of receive bursts in a row that came back empty.
+    idle_polls: usize,
+    /// Whether the device computes TCP checksums, which also applies to the segments that we cut in software.
+    tcp_tx_checksum_offload: bool,
 }
 
 #[derive(Clone)]
@@ -47,15 +75,51 @@ pub struct SharedLayer2Endpoint(SharedObject<Layer2Endpoint>);
 
 impl SharedLayer2Endpoint {
     pub fn new<P: PhysicalLayer>(config: &Config, layer1_endpoint: P) -> Result<Self, Fail> {
+        let max_rx_burst_size: usize = match config.receive_batch_size() {
+            Ok(batch_size) => batch_size,
+            Err(_) => {
+                warn!(
+                    "receive batch size not set or invalid, defaulting to {:?} packets",
+                    DEFAULT_RECEIVE_BATCH_SIZE
+                );
+                DEFAULT_RECEIVE_BATCH_SIZE
+            },
+        };
+        let adaptive_rx_burst: bool = config.adaptive_receive_batch().unwrap_or(false);
+        // When adapting, start small and let traffic grow the burst.
+        let rx_burst_size: usize = if adaptive_rx_burst {
+            MIN_ADAPTIVE_RECEIVE_BATCH_SIZE.min(max_rx_burst_size)
+        } else {
+            max_rx_burst_size
+        };
+
         Ok(Self(SharedObject::new(Layer2Endpoint {
             layer1_endpoint: Box::new(layer1_endpoint),
             local_link_addr: config.local_link_addr()?,
+            rx_batch: ArrayVec::new(),
+            rx_burst_size,
+            max_rx_burst_size,
+            adaptive_rx_burst,
+            idle_polls: 0,
+            tcp_tx_checksum_offload: config.tcp_checksum_offload().unwrap_or(false),
         })))
     }
+}
 
-    pub fn receive(&mut self) -> Result<ArrayVec<(EtherType2, DemiBuffer), RECEIVE_BATCH_SIZE>, Fail> {
-        let mut batch: ArrayVec<(EtherType2, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
-        for mut pkt in self.layer1_endpoint.receive()? {
+impl Layer2Endpoint {
+    pub fn receive(&mut self) -> Result<ArrayVec<(EtherType2, DemiBuffer), MAX_RECEIVE_BATCH_SIZE>, Fail> {
+        self.layer1_endpoint.receive(&mut self.rx_batch, self.rx_burst_size)?;
+        stats::record_rx_burst(self.rx_batch.len());
+        if self.adaptive_rx_burst {
+            self.adapt_rx_burst_size(self.rx_batch.len());
+        }
+        self.idle_polls = match self.rx_batch.len() {
+            0 => self.idle_polls.saturating_add(1),
+            _ => 0,
+        };
+
+        let mut batch: ArrayVec<(EtherType2, DemiBuffer), MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for mut pkt in self.rx_batch.drain(..) {
             let header: Ethernet2Header = match Ethernet2Header::parse_and_strip(&mut pkt) {
                 Ok(result) => result,
                 Err(e) => {
@@ -78,6 +142,18 @@ impl SharedLayer2Endpoint {
         Ok(batch)
     }
 
+    /// Doubles the receive burst size when the last burst came back full and halves it when it came back empty.
+    fn adapt_rx_burst_size(&mut self, nr_received: usize) {
+        if nr_received >= self.rx_burst_size {
+            self.rx_burst_size = (self.rx_burst_size * 2).min(self.max_rx_burst_size);
+        } else if nr_received == 0 {
+            self.rx_burst_size =
+                (self.rx_burst_size / 2).max(MIN_ADAPTIVE_RECEIVE_BATCH_SIZE.min(self.max_rx_burst_size));
+        }
+    }
+}
+
+impl SharedLayer2Endpoint {
     pub fn transmit_arp_packet(&mut self, remote_link_addr: MacAddress, pkt: DemiBuffer) -> Result<(), Fail> {
         self.transmit(remote_link_addr, EtherType2::Arp, pkt)
     }
@@ -94,9 +170,36 @@ impl SharedLayer2Endpoint {
     ) -> Result<(), Fail> {
         let eth2_header: Ethernet2Header = Ethernet2Header::new(remote_link_addr, self.local_link_addr, eth2_type);
         eth2_header.serialize_and_attach(&mut pkt);
+
+        // Cut large TCP segments that the device does not cut by itself.
+        let mss: u16 = pkt.tso_segment_size();
+        if mss != 0 && !self.layer1_endpoint.offloads_segmentation(&pkt) {
+            let tcp_tx_checksum_offload: bool = self.tcp_tx_checksum_offload;
+            let layer1_endpoint: &mut Box<dyn PhysicalLayer> = &mut self.layer1_endpoint;
+            return segmentation::segment(pkt, mss as usize, tcp_tx_checksum_offload, |frame| {
+                stats::record_tx_packet();
+                layer1_endpoint.transmit(frame)
+            });
+        }
+        stats::record_tx_packet();
         self.layer1_endpoint.transmit(pkt)
     }
 
+    /// Flushes any packets that the physical layer has staged for transmission.
+    pub fn flush(&mut self) -> Result<(), Fail> {
+        self.layer1_endpoint.flush()
+    }
+
+    /// Gets the number of receive bursts in a row that came back empty.
+    pub fn idle_polls(&self) -> usize {
+        self.idle_polls
+    }
+
+    /// Blocks until the physical layer may have received packets or `timeout` elapses.
+    pub fn wait_for_packets(&mut self, timeout: Duration) -> Result<(), Fail> {
+        self.layer1_endpoint.wait_for_packets(timeout)
+    }
+
     pub fn get_local_link_addr(&self) -> MacAddress {
         self.local_link_addr
     }
@@ -138,3 +241,92 @@ impl MemoryRuntime for Layer2Endpoint {
         self.layer1_endpoint.clone_sgarray(sga)
     }
 }
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        inetstack::{
+            protocols::layer2::{Layer2Endpoint, MIN_ADAPTIVE_RECEIVE_BATCH_SIZE},
+            test_helpers::{SharedTestPhysicalLayer, ALICE_MAC},
+        },
+        runtime::network::consts::DEFAULT_RECEIVE_BATCH_SIZE,
+    };
+    use ::anyhow::Result;
+    use ::arrayvec::ArrayVec;
+    use ::std::time::Instant;
+
+    // Builds an endpoint whose receive burst adapts up to `max_rx_burst_size` packets, starting small as configured.
+    fn adaptive_endpoint(max_rx_burst_size: usize) -> Layer2Endpoint {
+        Layer2Endpoint {
+            layer1_endpoint: Box::new(SharedTestPhysicalLayer::new_test(Instant::now())),
+            local_link_addr: ALICE_MAC,
+            rx_batch: ArrayVec::new(),
+            rx_burst_size: MIN_ADAPTIVE_RECEIVE_BATCH_SIZE.min(max_rx_burst_size),
+            max_rx_burst_size,
+            adaptive_rx_burst: true,
+            idle_polls: 0,
+            tcp_tx_checksum_offload: false,
+        }
+    }
+
+    // Tests that full bursts grow the receive burst up to its bound, partial ones keep it, and empty ones shrink it down
+    // to its floor.
+    #[test]
+    fn test_adapt_rx_burst_size() -> Result<()> {
+        let max: usize = DEFAULT_RECEIVE_BATCH_SIZE;
+        let mut endpoint: Layer2Endpoint = adaptive_endpoint(max);
+        crate::ensure_eq!(endpoint.rx_burst_size, MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+
+        // Full bursts double the burst size until it reaches the configured bound.
+        let mut expected: usize = MIN_ADAPTIVE_RECEIVE_BATCH_SIZE;
+        while expected < max {
+            endpoint.adapt_rx_burst_size(endpoint.rx_burst_size);
+            expected = (expected * 2).min(max);
+            crate::ensure_eq!(endpoint.rx_burst_size, expected);
+        }
+        endpoint.adapt_rx_burst_size(max);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+
+        // Partial bursts leave the burst size alone.
+        endpoint.adapt_rx_burst_size(1);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+        endpoint.adapt_rx_burst_size(max - 1);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+
+        // Empty bursts halve the burst size until it reaches its floor.
+        while expected > MIN_ADAPTIVE_RECEIVE_BATCH_SIZE {
+            endpoint.adapt_rx_burst_size(0);
+            expected = (expected / 2).max(MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+            crate::ensure_eq!(endpoint.rx_burst_size, expected);
+        }
+        endpoint.adapt_rx_burst_size(0);
+        crate::ensure_eq!(endpoint.rx_burst_size, MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+        endpoint.adapt_rx_burst_size(MIN_ADAPTIVE_RECEIVE_BATCH_SIZE - 1);
+        crate::ensure_eq!(endpoint.rx_burst_size, MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+
+        // A full burst after an idle period grows the burst size again.
+        endpoint.adapt_rx_burst_size(MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+        crate::ensure_eq!(endpoint.rx_burst_size, 2 * MIN_ADAPTIVE_RECEIVE_BATCH_SIZE);
+
+        Ok(())
+    }
+
+    // Tests that a configured bound below the floor holds in both directions.
+    #[test]
+    fn test_adapt_rx_burst_size_small_bound() -> Result<()> {
+        let max: usize = MIN_ADAPTIVE_RECEIVE_BATCH_SIZE / 2;
+        let mut endpoint: Layer2Endpoint = adaptive_endpoint(max);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+
+        endpoint.adapt_rx_burst_size(max);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+        endpoint.adapt_rx_burst_size(0);
+        crate::ensure_eq!(endpoint.rx_burst_size, max);
+
+        Ok(())
+    }
+}
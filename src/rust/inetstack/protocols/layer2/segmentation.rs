@@ -0,0 +1,223 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::protocols::{
+        checksum::update_checksum,
+        compute_generic_checksum, fold16,
+        layer2::ETHERNET2_HEADER_SIZE,
+        layer3::{
+            ip::IpProtocol,
+            ipv4::{Ipv4Header, IPV4_HEADER_MIN_SIZE},
+        },
+        layer4::tcp::header::MIN_TCP_HEADER_SIZE,
+        MAX_HEADER_SIZE,
+    },
+    runtime::{fail::Fail, memory::DemiBuffer},
+};
+use ::std::cmp;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// TCP flags that only the first segment of a train carries. CWR announces a single window reduction (RFC 3168,
+/// section 6.1.2).
+const TCP_FIRST_SEGMENT_FLAGS: u8 = TCP_FLAG_CWR;
+/// TCP flags that only the last segment of a train carries.
+const TCP_LAST_SEGMENT_FLAGS: u8 = TCP_FLAG_FIN | TCP_FLAG_PSH;
+const TCP_FLAG_FIN: u8 = 1 << 0;
+const TCP_FLAG_PSH: u8 = 1 << 3;
+const TCP_FLAG_CWR: u8 = 1 << 7;
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Cuts `pkt`, an Ethernet frame that carries an IPv4/TCP segment, into frames with up to `mss` bytes of payload each
+/// and hands them to `transmit` in order. The headers of `pkt` are a template for those of every frame: we patch only
+/// the IPv4 total length and checksum and the TCP sequence number, flags and checksum, and we sum the parts of the TCP
+/// checksum that all frames share only once. Payloads are not copied.
+pub fn segment<F>(mut pkt: DemiBuffer, mss: usize, tx_checksum_offload: bool, mut transmit: F) -> Result<(), Fail>
+where
+    F: FnMut(DemiBuffer) -> Result<(), Fail>,
+{
+    debug_assert_ne!(mss, 0);
+
+    // Locate the headers, which are all in the first segment.
+    let mut template: [u8; MAX_HEADER_SIZE] = [0; MAX_HEADER_SIZE];
+    let (ipv4_offset, tcp_offset, headers_len): (usize, usize, usize) = {
+        let head: &[u8] = &pkt[..];
+        let ipv4_offset: usize = ETHERNET2_HEADER_SIZE;
+        if head.len() < ipv4_offset + IPV4_HEADER_MIN_SIZE as usize {
+            return Err(Fail::new(libc::EINVAL, "frame is too small for an ipv4 header"));
+        }
+        let tcp_offset: usize = ipv4_offset + ((head[ipv4_offset] & 0xf) as usize) * 4;
+        if head.len() < tcp_offset + MIN_TCP_HEADER_SIZE {
+            return Err(Fail::new(libc::EINVAL, "frame is too small for a tcp header"));
+        }
+        let headers_len: usize = tcp_offset + ((head[tcp_offset + 12] >> 4) as usize) * 4;
+        if head.len() < headers_len || headers_len > MAX_HEADER_SIZE {
+            return Err(Fail::new(libc::EINVAL, "frame headers are malformed"));
+        }
+        template[..headers_len].copy_from_slice(&head[..headers_len]);
+        (ipv4_offset, tcp_offset, headers_len)
+    };
+    let template: &[u8] = &template[..headers_len];
+    let tcp_header_len: usize = headers_len - tcp_offset;
+    let seq_num: u32 = u32::from_be_bytes(template[tcp_offset + 4..tcp_offset + 8].try_into().unwrap());
+    let flags: u8 = template[tcp_offset + 13];
+    let template_ipv4_length: u16 = u16::from_be_bytes([template[ipv4_offset + 2], template[ipv4_offset + 3]]);
+    let template_ipv4_checksum: u16 = Ipv4Header::compute_checksum(&template[ipv4_offset..tcp_offset]);
+
+    // Sum the pseudo-header addresses and protocol, and the TCP header without the fields that differ across frames
+    // (sequence number, the word that holds the flags, and checksum).
+    let base_checksum: u32 = if tx_checksum_offload {
+        0
+    } else {
+        let mut tcp_header: [u8; MAX_HEADER_SIZE] = [0; MAX_HEADER_SIZE];
+        let tcp_header: &mut [u8] = &mut tcp_header[..tcp_header_len];
+        tcp_header.copy_from_slice(&template[tcp_offset..]);
+        tcp_header[4..8].fill(0);
+        tcp_header[12..14].fill(0);
+        tcp_header[16..18].fill(0);
+        let state: u32 = compute_generic_checksum(&template[ipv4_offset + 12..ipv4_offset + 20], None);
+        compute_generic_checksum(tcp_header, Some(state + IpProtocol::TCP as u32))
+    };
+
+    // Get the payload, which may already be in a segment of its own.
+    let mut payload: DemiBuffer = match pkt.detach_tail() {
+        Some(tail) => tail,
+        None => {
+            pkt.adjust(headers_len)?;
+            pkt
+        },
+    };
+    if payload.num_segments() > 1 {
+        payload = payload.linearize(0)?;
+    }
+
+    let mut offset: usize = 0;
+    let payload_len: usize = payload.len();
+    while offset < payload_len {
+        let len: usize = cmp::min(mss, payload_len - offset);
+        let is_last: bool = offset + len == payload_len;
+        let body: DemiBuffer = if is_last {
+            payload.clone()
+        } else {
+            payload.split_front(len)?
+        };
+
+        let seg_seq_num: u32 = seq_num.wrapping_add(offset as u32);
+        let mut seg_flags: u8 = flags;
+        if offset > 0 {
+            seg_flags &= !TCP_FIRST_SEGMENT_FLAGS;
+        }
+        if !is_last {
+            seg_flags &= !TCP_LAST_SEGMENT_FLAGS;
+        }
+        let checksum: u16 = if tx_checksum_offload {
+            0
+        } else {
+            let mut state: u32 = base_checksum;
+            state += seg_seq_num >> 16;
+            state += seg_seq_num & 0xffff;
+            state += u16::from_be_bytes([template[tcp_offset + 12], seg_flags]) as u32;
+            state += (tcp_header_len + len) as u32;
+            fold16(compute_generic_checksum(&body[..], Some(state)))
+        };
+
+        let mut frame: DemiBuffer = body.prepend_segment(headers_len as u16)?;
+        frame.prepend(headers_len)?;
+        frame.copy_from_slice(template);
+        // Only the total length differs from the template in the IPv4 header, so we update its checksum for that.
+        let ipv4_length: u16 = (headers_len - ipv4_offset + len) as u16;
+        let ipv4_checksum: u16 = update_checksum(template_ipv4_checksum, template_ipv4_length, ipv4_length);
+        frame[ipv4_offset + 2..ipv4_offset + 4].copy_from_slice(&ipv4_length.to_be_bytes());
+        frame[ipv4_offset + 10..ipv4_offset + 12].copy_from_slice(&ipv4_checksum.to_be_bytes());
+        frame[tcp_offset + 4..tcp_offset + 8].copy_from_slice(&seg_seq_num.to_be_bytes());
+        frame[tcp_offset + 13] = seg_flags;
+        frame[tcp_offset + 16..tcp_offset + 18].copy_from_slice(&checksum.to_be_bytes());
+
+        transmit(frame)?;
+        offset += len;
+    }
+
+    Ok(())
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        inetstack::protocols::{
+            layer2::{segmentation::segment, EtherType2, Ethernet2Header},
+            layer3::{ip::IpProtocol, ipv4::Ipv4Header},
+            layer4::tcp::{header::TcpHeader, SeqNumber},
+            MAX_HEADER_SIZE,
+        },
+        runtime::{memory::DemiBuffer, network::types::MacAddress},
+    };
+    use ::anyhow::Result;
+    use ::std::net::Ipv4Addr;
+
+    // Builds a frame that carries a TCP segment with `payload`, with all of its headers serialized the way the network
+    // stack does.
+    fn build_frame(src: Ipv4Addr, dst: Ipv4Addr, payload: &[u8]) -> Result<DemiBuffer> {
+        let mut pkt: DemiBuffer = DemiBuffer::from_slice_with_headroom(payload, MAX_HEADER_SIZE)?;
+        let mut header: TcpHeader = TcpHeader::new(443, 5000);
+        header.seq_num = SeqNumber::from(u32::MAX - 100);
+        header.ack = true;
+        header.psh = true;
+        header.cwr = true;
+        header.window_size = 1024;
+        header.serialize_and_attach(&mut pkt, &src, &dst, false);
+        Ipv4Header::new(src, dst, IpProtocol::TCP).serialize_and_attach(&mut pkt);
+        Ethernet2Header::new(MacAddress::broadcast(), MacAddress::broadcast(), EtherType2::Ipv4)
+            .serialize_and_attach(&mut pkt);
+        Ok(pkt)
+    }
+
+    // Tests that a large segment is cut into valid MSS-sized segments that carry the whole payload in order.
+    #[test]
+    fn test_segment() -> Result<()> {
+        let src: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 1);
+        let dst: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 2);
+        let payload: Vec<u8> = (0..5000).map(|i| (i % 251) as u8).collect();
+        let pkt: DemiBuffer = build_frame(src, dst, &payload)?;
+
+        let mut frames: Vec<DemiBuffer> = Vec::new();
+        segment(pkt, 1448, false, |frame| {
+            frames.push(frame);
+            Ok(())
+        })?;
+        crate::ensure_eq!(frames.len(), 4);
+
+        let mut received: Vec<u8> = Vec::new();
+        for (i, frame) in frames.iter().enumerate() {
+            let mut frame: DemiBuffer = frame.linearize(0)?;
+            Ethernet2Header::parse_and_strip(&mut frame)?;
+            crate::ensure_eq!(u16::from_be_bytes([frame[2], frame[3]]) as usize, frame.len());
+            Ipv4Header::parse_and_strip(&mut frame)?;
+            let header: TcpHeader = TcpHeader::parse_and_strip(&src, &dst, &mut frame, false)?;
+            crate::ensure_eq!(
+                header.seq_num,
+                SeqNumber::from((u32::MAX - 100).wrapping_add(received.len() as u32))
+            );
+            crate::ensure_eq!(header.ack, true);
+            crate::ensure_eq!(header.psh, i == frames.len() - 1);
+            crate::ensure_eq!(header.cwr, i == 0);
+            received.extend_from_slice(&frame[..]);
+        }
+        crate::ensure_eq!(received, payload);
+
+        Ok(())
+    }
+}
@@ -85,7 +85,7 @@ impl SharedArpPeer {
             recv_queue: AsyncQueue::<DemiBuffer>::default(),
         }));
         // This is a future returned by the async function.
-        runtime.insert_background_coroutine("bgc::inetstack::arp::background", Box::pin(peer.clone().poll().fuse()))?;
+        runtime.insert_background_coroutine("bgc::inetstack::arp::background", peer.clone().poll().fuse())?;
         Ok(peer.clone())
     }
 
@@ -99,8 +99,7 @@ impl SharedIcmpv4Peer {
             rng,
             inflight: HashMap::<(u16, u16), InflightRequest>::new(),
         }));
-        runtime
-            .insert_background_coroutine("bgc::inetstack::icmp::background", Box::pin(peer.clone().poll().fuse()))?;
+        runtime.insert_background_coroutine("bgc::inetstack::icmp::background", peer.clone().poll().fuse())?;
         Ok(peer)
     }
 
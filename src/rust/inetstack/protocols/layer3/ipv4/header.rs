@@ -6,7 +6,7 @@
 //======================================================================================================================
 
 use crate::{
-    inetstack::protocols::layer3::ip::IpProtocol,
+    inetstack::protocols::{compute_generic_checksum, fold16, layer3::ip::IpProtocol},
     runtime::{fail::Fail, memory::DemiBuffer},
 };
 use ::libc::{EBADMSG, ENOTSUP};
@@ -34,6 +34,12 @@ const DEFAULT_IPV4_TTL: u8 = 255;
 /// Version number for IPv4.
 const IPV4_VERSION: u8 = 4;
 
+/// ECN codepoint: ECN-capable transport, ECT(0) (see RFC 3168).
+pub const IPV4_ECN_ECT0: u8 = 0x2;
+
+/// ECN codepoint: congestion experienced (see RFC 3168).
+pub const IPV4_ECN_CE: u8 = 0x3;
+
 /// IPv4 Control Flag: Datagram has evil intent (see RFC 3514).
 const IPV4_CTRL_FLAG_EVIL: u8 = 0x4;
 
@@ -136,18 +142,15 @@ impl Ipv4Header {
             warn!("ignoring dscp field (dscp={:?})", dscp);
         }
 
-        // Explicit congestion notification.
+        // Explicit congestion notification. This is handed up to the transport protocol, which may react to it.
         let ecn: u8 = hdr_buf[1] & 3;
-        if ecn != 0 {
-            warn!("ignoring ecn field (ecn={:?})", ecn);
-        }
 
         let total_length: u16 = u16::from_be_bytes([hdr_buf[2], hdr_buf[3]]);
         if total_length < hdr_size {
             return Err(Fail::new(EBADMSG, "ipv4 datagram smaller than header"));
         }
-        // NOTE: there may be padding bytes in the buffer.
-        if (total_length as usize) > buf.len() {
+        // NOTE: there may be padding bytes in the buffer. Datagrams that the NIC coalesced may span several segments.
+        if (total_length as usize) > buf.chain_len() {
             return Err(Fail::new(EBADMSG, "ipv4 datagram size mismatch"));
         }
 
@@ -203,7 +206,7 @@ impl Ipv4Header {
         let dst_addr: Ipv4Addr = Ipv4Addr::new(hdr_buf[16], hdr_buf[17], hdr_buf[18], hdr_buf[19]);
 
         // Truncate datagram.
-        let padding_bytes: usize = buf.len() - (total_length as usize);
+        let padding_bytes: usize = buf.chain_len() - (total_length as usize);
         buf.adjust(hdr_size as usize)?;
         buf.trim(padding_bytes)?;
 
@@ -229,7 +232,7 @@ impl Ipv4Header {
     pub fn serialize_and_attach(&self, buf: &mut DemiBuffer) {
         buf.prepend(IPV4_HEADER_MIN_SIZE as usize)
             .expect("Should be sufficient headroom");
-        let pkt_size_bytes: usize = buf.len();
+        let pkt_size_bytes: usize = buf.chain_len();
 
         // Version + IHL.
         buf[0] = (self.version << 4) | self.ihl;
@@ -277,26 +280,28 @@ impl Ipv4Header {
         self.protocol
     }
 
-    pub fn compute_checksum(buf: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
+    /// Sets the explicit congestion notification codepoint of the datagram.
+    pub fn set_ecn(&mut self, ecn: u8) {
+        self.ecn = ecn & 3;
+    }
 
+    /// Checks whether a router marked the datagram as having experienced congestion.
+    pub fn is_congestion_experienced(&self) -> bool {
+        self.ecn == IPV4_ECN_CE
+    }
+
+    pub fn compute_checksum(buf: &[u8]) -> u16 {
         if buf.len() < IPV4_HEADER_MIN_SIZE as usize {
             // This should not happen by construction.
             warn!("compute_checksum: buffer is too small (len={})", buf.len());
             return 0;
         }
 
-        for i in 0..5 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        // Skip the 5th u16 since octets 10-12 are the header checksum, whose value should be zero when
-        // computing a checksum.
-        for i in 6..10 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        while state > 0xffff {
-            state -= 0xffff;
-        }
-        !state as u16
+        // Skip octets 10-12, which are the header checksum, whose value should be zero when computing a checksum.
+        let state: u32 = compute_generic_checksum(&buf[..10], None);
+        fold16(compute_generic_checksum(
+            &buf[12..IPV4_HEADER_MIN_SIZE as usize],
+            Some(state),
+        ))
     }
 }
@@ -7,7 +7,10 @@
 
 use crate::{
     inetstack::{
-        protocols::layer3::{ip::IpProtocol, ipv4::Ipv4Header},
+        protocols::layer3::{
+            ip::IpProtocol,
+            ipv4::{Ipv4Header, IPV4_ECN_CE},
+        },
         test_helpers::{ALICE_IPV4, BOB_IPV4},
     },
     runtime::memory::DemiBuffer,
@@ -453,16 +456,16 @@ fn test_ipv4_header_parse_unsupported_dscp() -> Result<()> {
     Ok(())
 }
 
-/// Parses a malformed IPv4 header with unsupported ECN field.
+/// Parses IPv4 headers with all ECN codepoints.
 #[test]
-fn test_ipv4_header_parse_unsupported_ecn() -> Result<()> {
+fn test_ipv4_header_parse_ecn() -> Result<()> {
     const HEADER_SIZE: usize = 20;
     const PAYLOAD_SIZE: usize = 0;
     const DATAGRAM_SIZE: usize = HEADER_SIZE + PAYLOAD_SIZE;
     let mut buf: [u8; DATAGRAM_SIZE] = [0; DATAGRAM_SIZE];
 
-    // Iterate over unsupported values for ECN.
-    for ecn in 1..3 {
+    // Iterate over all values for ECN.
+    for ecn in 0..4 {
         build_ipv4_header(
             &mut buf,
             4,
@@ -486,8 +489,8 @@ fn test_ipv4_header_parse_unsupported_ecn() -> Result<()> {
         };
 
         match Ipv4Header::parse_and_strip(&mut buf) {
-            Ok(_) => {},
-            Err(_) => anyhow::bail!("ecn field should be ignored (ecn={:?})", ecn),
+            Ok(header) => crate::ensure_eq!(header.is_congestion_experienced(), ecn == IPV4_ECN_CE),
+            Err(_) => anyhow::bail!("ecn field should be accepted (ecn={:?})", ecn),
         };
     }
 
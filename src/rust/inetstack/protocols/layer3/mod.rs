@@ -12,7 +12,12 @@ pub mod ipv4;
 
 use arrayvec::ArrayVec;
 
-pub use self::{arp::SharedArpPeer, icmpv4::SharedIcmpv4Peer, ip::IpProtocol, ipv4::Ipv4Header};
+pub use self::{
+    arp::SharedArpPeer,
+    icmpv4::SharedIcmpv4Peer,
+    ip::IpProtocol,
+    ipv4::{Ipv4Header, IPV4_ECN_ECT0},
+};
 
 use crate::{
     demi_sgarray_t,
@@ -21,16 +26,17 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        network::consts::MAX_RECEIVE_BATCH_SIZE,
         SharedDemiRuntime, SharedObject,
     },
     MacAddress,
 };
 #[cfg(test)]
-use ::std::{collections::HashMap, hash::RandomState, time::Duration};
+use ::std::{collections::HashMap, hash::RandomState};
 use ::std::{
     net::Ipv4Addr,
     ops::{Deref, DerefMut},
+    time::Duration,
 };
 
 //======================================================================================================================
@@ -68,8 +74,12 @@ impl SharedLayer3Endpoint {
         })))
     }
 
-    pub fn receive(&mut self) -> Result<ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE>, Fail> {
-        let mut batch: ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
+    /// Receives a burst of datagrams for the upper layers. Each comes with its source address, its protocol and whether
+    /// a router marked it as having experienced congestion.
+    pub fn receive(
+        &mut self,
+    ) -> Result<ArrayVec<(Ipv4Addr, IpProtocol, bool, DemiBuffer), MAX_RECEIVE_BATCH_SIZE>, Fail> {
+        let mut batch: ArrayVec<(Ipv4Addr, IpProtocol, bool, DemiBuffer), MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
         for (eth2_type, mut packet) in self.layer2_endpoint.receive()? {
             match eth2_type {
                 EtherType2::Arp => {
@@ -110,7 +120,12 @@ impl SharedLayer3Endpoint {
                             self.icmpv4.receive(header, packet);
                             continue;
                         },
-                        _ => batch.push((header.get_src_addr(), protocol, packet)),
+                        _ => batch.push((
+                            header.get_src_addr(),
+                            protocol,
+                            header.is_congestion_experienced(),
+                            packet,
+                        )),
                     }
                 },
                 EtherType2::Ipv6 => warn!("Ipv6 not supported yet"), // Ignore for now.
@@ -128,6 +143,24 @@ impl SharedLayer3Endpoint {
         self.transmit_packet(remote_ipv4_addr, remote_link_addr, IpProtocol::TCP, pkt)
     }
 
+    /// Same as [Self::transmit_tcp_packet_nonblocking], but marks the packet as ECN-capable (RFC 3168), so that routers
+    /// that run into congestion mark it instead of dropping it.
+    pub fn transmit_ecn_capable_tcp_packet_nonblocking(
+        &mut self,
+        remote_ipv4_addr: Ipv4Addr,
+        mut pkt: DemiBuffer,
+    ) -> Result<(), Fail> {
+        let remote_link_addr: MacAddress = match self.arp.try_query(remote_ipv4_addr) {
+            Some(addr) => addr,
+            _ => return Err(Fail::new(libc::EAGAIN, "destination not in ARP cache")),
+        };
+
+        let mut ipv4_header: Ipv4Header = Ipv4Header::new(self.local_ipv4_addr, remote_ipv4_addr, IpProtocol::TCP);
+        ipv4_header.set_ecn(IPV4_ECN_ECT0);
+        ipv4_header.serialize_and_attach(&mut pkt);
+        self.layer2_endpoint.transmit_ipv4_packet(remote_link_addr, pkt)
+    }
+
     pub async fn transmit_tcp_packet_blocking(
         &mut self,
         remote_ipv4_addr: Ipv4Addr,
@@ -160,6 +193,21 @@ impl SharedLayer3Endpoint {
         self.layer2_endpoint.transmit_ipv4_packet(remote_link_addr, pkt)
     }
 
+    /// Flushes any packets that the lower layers have staged for transmission.
+    pub fn flush(&mut self) -> Result<(), Fail> {
+        self.layer2_endpoint.flush()
+    }
+
+    /// Gets the number of receive bursts in a row that came back empty.
+    pub fn idle_polls(&self) -> usize {
+        self.layer2_endpoint.idle_polls()
+    }
+
+    /// Blocks until the lower layers may have received packets or `timeout` elapses.
+    pub fn wait_for_packets(&mut self, timeout: Duration) -> Result<(), Fail> {
+        self.layer2_endpoint.wait_for_packets(timeout)
+    }
+
     pub fn get_local_addr(&self) -> Ipv4Addr {
         self.local_ipv4_addr
     }
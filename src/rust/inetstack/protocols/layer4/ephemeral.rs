@@ -15,8 +15,8 @@ use ::std::collections::VecDeque;
 //======================================================================================================================
 
 /// https://datatracker.ietf.org/doc/html/rfc6335
-const FIRST_PRIVATE_PORT_NUMBER: u16 = 49152;
-const LAST_PRIVATE_PORT_NUMBER: u16 = 65535;
+pub const FIRST_PRIVATE_PORT_NUMBER: u16 = 49152;
+pub const LAST_PRIVATE_PORT_NUMBER: u16 = 65535;
 
 /// Seed number for ephemeral port allocator.
 #[cfg(not(debug_assertions))]
@@ -35,6 +35,25 @@ pub struct EphemeralPorts {
 //======================================================================================================================
 
 impl EphemeralPorts {
+    /// Creates a pool of the ephemeral ports `p` for which `p % num_shares == share`. Stacks that split the ephemeral
+    /// range between them, because the device delivers each share of it to a different one, take one share each.
+    pub fn new(share: u16, num_shares: u16) -> Self {
+        let mut port_numbers: Vec<u16> = Vec::<u16>::new();
+        for port_number in (FIRST_PRIVATE_PORT_NUMBER..=LAST_PRIVATE_PORT_NUMBER).rev() {
+            if port_number % num_shares == share {
+                port_numbers.push(port_number);
+            }
+        }
+        #[cfg(not(debug_assertions))]
+        {
+            let mut rng: SmallRng = SmallRng::seed_from_u64(EPHEMERAL_PORT_SEED);
+            port_numbers.shuffle(&mut rng);
+        }
+        Self {
+            port_numbers: VecDeque::from(port_numbers),
+        }
+    }
+
     pub fn is_private(port_number: u16) -> bool {
         port_number >= FIRST_PRIVATE_PORT_NUMBER
     }
@@ -83,18 +102,7 @@ impl EphemeralPorts {
 
 impl Default for EphemeralPorts {
     fn default() -> Self {
-        let mut port_numbers: Vec<u16> = Vec::<u16>::new();
-        for port_number in (FIRST_PRIVATE_PORT_NUMBER..=LAST_PRIVATE_PORT_NUMBER).rev() {
-            port_numbers.push(port_number);
-        }
-        #[cfg(not(debug_assertions))]
-        {
-            let mut rng: SmallRng = SmallRng::seed_from_u64(EPHEMERAL_PORT_SEED);
-            port_numbers.shuffle(&mut rng);
-        }
-        Self {
-            port_numbers: VecDeque::from(port_numbers),
-        }
+        Self::new(0, 1)
     }
 }
 
@@ -194,6 +202,25 @@ mod test {
         Ok(())
     }
 
+    #[test]
+    fn test_alloc_from_share() -> Result<()> {
+        let mut port_numbers: EphemeralPorts = EphemeralPorts::new(3, 4);
+        let num_ports: usize = (FIRST_PRIVATE_PORT_NUMBER..=LAST_PRIVATE_PORT_NUMBER).len() / 4;
+
+        for _ in 0..num_ports {
+            match port_numbers.alloc() {
+                Ok(port_number) => crate::ensure_eq!(port_number % 4, 3),
+                Err(e) => anyhow::bail!("failed to allocate an ephemeral port (error={:?})", &e),
+            }
+        }
+
+        if port_numbers.alloc().is_ok() {
+            anyhow::bail!("all ports of the share should be allocated");
+        }
+
+        Ok(())
+    }
+
     #[test]
     fn test_free_unallocated_port() -> Result<()> {
         let mut port_numbers: EphemeralPorts = EphemeralPorts::default();
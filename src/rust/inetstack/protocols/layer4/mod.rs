@@ -30,15 +30,18 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::{consts::RECEIVE_BATCH_SIZE, unwrap_socketaddr},
+        network::{consts::MAX_RECEIVE_BATCH_SIZE, unwrap_socketaddr},
         SharedDemiRuntime,
     },
     timer, SocketOption,
 };
 use ::socket2::{Domain, Type};
-use ::std::net::{Ipv4Addr, SocketAddr, SocketAddrV4};
 #[cfg(test)]
-use ::std::{collections::HashMap, hash::RandomState, time::Duration};
+use ::std::{collections::HashMap, hash::RandomState};
+use ::std::{
+    net::{Ipv4Addr, SocketAddr, SocketAddrV4},
+    time::Duration,
+};
 
 use arrayvec::ArrayVec;
 
@@ -70,6 +73,7 @@ impl Peer {
         runtime: SharedDemiRuntime,
         layer3_endpoint: SharedLayer3Endpoint,
         rng_seed: [u8; 32],
+        ephemeral_port_share: (u16, u16),
     ) -> Result<Self, Fail> {
         let udp: SharedUdpPeer = SharedUdpPeer::new(config, runtime.clone(), layer3_endpoint.clone())?;
         let tcp: SharedTcpPeer = SharedTcpPeer::new(config, runtime.clone(), layer3_endpoint.clone(), rng_seed)?;
@@ -78,7 +82,7 @@ impl Peer {
             tcp,
             udp,
             layer3_endpoint,
-            ephemeral_ports: EphemeralPorts::default(),
+            ephemeral_ports: EphemeralPorts::new(ephemeral_port_share.0, ephemeral_port_share.1),
         })
     }
 
@@ -94,16 +98,40 @@ impl Peer {
         }
     }
 
-    fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE>) {
+    /// Flushes any packets that the lower layers have staged for transmission.
+    pub fn flush(&mut self) {
+        if let Err(e) = self.layer3_endpoint.flush() {
+            warn!("Could not flush outgoing packets to network interface: {:?}", e);
+        }
+    }
+
+    /// Gets the number of receive bursts in a row that came back empty.
+    pub fn idle_polls(&self) -> usize {
+        self.layer3_endpoint.idle_polls()
+    }
+
+    /// Blocks until the network interface may have received packets or `timeout` elapses.
+    pub fn wait_for_packets(&mut self, timeout: Duration) {
+        if let Err(e) = self.layer3_endpoint.wait_for_packets(timeout) {
+            warn!("Could not wait for packets on network interface: {:?}", e);
+        }
+    }
+
+    fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Addr, IpProtocol, bool, DemiBuffer), MAX_RECEIVE_BATCH_SIZE>) {
         timer!("inetstack::poll_bg_work::for::for");
         trace!("found packets: {:?}", batch.len());
-        for (src_ipv4_addr, ip_type, payload) in batch {
+        // TCP segments are handed over as a batch, so that those of the same connection can be coalesced.
+        let mut tcp_batch: ArrayVec<(Ipv4Addr, bool, DemiBuffer), MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for (src_ipv4_addr, ip_type, congestion_experienced, payload) in batch {
             match ip_type {
-                IpProtocol::TCP => self.tcp.receive(src_ipv4_addr, payload),
+                IpProtocol::TCP => tcp_batch.push((src_ipv4_addr, congestion_experienced, payload)),
                 IpProtocol::UDP => self.udp.receive(src_ipv4_addr, payload),
                 _ => unreachable!("Should have been handled at a lower layer"),
             }
         }
+        if !tcp_batch.is_empty() {
+            self.tcp.receive_batch(tcp_batch);
+        }
     }
 
     pub fn socket(&mut self, domain: Domain, typ: Type) -> Result<Socket, Fail> {
@@ -12,10 +12,7 @@ use crate::{
         layer3::SharedLayer3Endpoint,
         layer4::tcp::{
             constants::{FALLBACK_MSS, MAX_WINDOW_SCALE},
-            established::{
-                congestion_control::{self, CongestionControl},
-                EstablishedSocket,
-            },
+            established::{congestion_control, EstablishedSocket},
             header::{TcpHeader, TcpOptions2},
             SeqNumber,
         },
@@ -127,6 +124,9 @@ impl SharedActiveOpenSocket {
 
         debug!("Received SYN+ACK: {:?}", header);
 
+        // Our peer agrees to use ECN if it sets ECE, but not CWR, on its SYN+ACK (RFC 3168, section 6.1.1).
+        let ecn_enabled: bool = self.requests_ecn() && header.ece && !header.cwr;
+
         let remote_seq_num = header.seq_num + SeqNumber::from(1);
 
         let mut tcp_hdr = TcpHeader::new(self.local.port(), self.remote.port());
@@ -149,6 +149,7 @@ impl SharedActiveOpenSocket {
 
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_enabled: bool = false;
         for option in header.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
@@ -159,6 +160,11 @@ impl SharedActiveOpenSocket {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
                 },
+                // We always offer selective acknowledgements, so we use them if our peer agrees (RFC 2018, section 2).
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_enabled = true;
+                },
                 _ => continue,
             }
         }
@@ -215,8 +221,10 @@ impl SharedActiveOpenSocket {
             tx_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            congestion_control::get_constructor(self.socket_options.get_congestion_control()),
             None,
+            ecn_enabled,
+            sack_enabled,
             self.dead_socket_tx.clone(),
             None,
         )?)
@@ -232,6 +240,11 @@ impl SharedActiveOpenSocket {
             // Set up SYN packet.
             let mut tcp_hdr = TcpHeader::new(self.local.port(), self.remote.port());
             tcp_hdr.syn = true;
+            // Ask for ECN if our congestion control uses it (RFC 3168, section 6.1.1).
+            if self.requests_ecn() {
+                tcp_hdr.ece = true;
+                tcp_hdr.cwr = true;
+            }
             tcp_hdr.seq_num = self.local_isn;
             tcp_hdr.window_size = self.tcp_config.get_receive_window_size();
 
@@ -242,6 +255,9 @@ impl SharedActiveOpenSocket {
             tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
             info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
 
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+            info!("Advertising SACK permitted");
+
             debug!("Sending SYN {:?}", tcp_hdr);
             let dst_ipv4_addr: Ipv4Addr = self.remote.ip().clone();
             let mut pkt: DemiBuffer = DemiBuffer::new_with_headroom(0, MAX_HEADER_SIZE as u16);
@@ -297,6 +313,11 @@ impl SharedActiveOpenSocket {
         self.state.set(State::Closed);
     }
 
+    /// Checks whether we ask our peer to use ECN on this connection.
+    fn requests_ecn(&self) -> bool {
+        congestion_control::uses_ecn(self.socket_options.get_congestion_control())
+    }
+
     /// Returns the addresses of the two ends of this connection.
     pub fn endpoints(&self) -> (SocketAddrV4, SocketAddrV4) {
         (self.local, self.remote)
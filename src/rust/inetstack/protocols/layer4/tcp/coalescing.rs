@@ -0,0 +1,180 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::protocols::layer4::tcp::{header::TcpHeader, SeqNumber},
+    runtime::memory::DemiBuffer,
+};
+use ::std::net::Ipv4Addr;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Largest payload that we coalesce into one segment. This keeps coalesced segments within the sizes that the control
+/// block can flatten if it has to trim them.
+pub const MAX_COALESCED_SIZE: usize = u16::MAX as usize;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Merges back-to-back in-order data segments of the same connection into one segment whose payload is a chain of
+/// their payloads, so that the control block processes and acknowledges them all at once. We hold on to the last
+/// segment that we have seen until we find out whether the next one can be appended to it.
+#[derive(Default)]
+pub struct ReceiveCoalescer {
+    /// Segment that further segments may be appended to.
+    held: Option<(Ipv4Addr, TcpHeader, DemiBuffer)>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl ReceiveCoalescer {
+    /// Offers a parsed segment to the coalescer. Returns the segment that it held before, if the new one could not be
+    /// appended to it and it is therefore ready for processing.
+    pub fn push(
+        &mut self,
+        src_ipv4_addr: Ipv4Addr,
+        tcp_hdr: TcpHeader,
+        buf: DemiBuffer,
+    ) -> Option<(Ipv4Addr, TcpHeader, DemiBuffer)> {
+        if let Some((held_ipv4_addr, held_hdr, held_buf)) = self.held.as_mut() {
+            if *held_ipv4_addr == src_ipv4_addr && Self::can_append(held_hdr, held_buf, &tcp_hdr, &buf) {
+                match held_buf.chain(buf) {
+                    Ok(()) => {
+                        held_hdr.psh = tcp_hdr.psh;
+                        return None;
+                    },
+                    // The segment is gone, so the sender will have to retransmit it.
+                    Err(e) => {
+                        warn!("push(): failed to coalesce segment: {:?}", e);
+                        return None;
+                    },
+                }
+            }
+        }
+        self.held.replace((src_ipv4_addr, tcp_hdr, buf))
+    }
+
+    /// Takes the segment that the coalescer holds, if any.
+    pub fn take(&mut self) -> Option<(Ipv4Addr, TcpHeader, DemiBuffer)> {
+        self.held.take()
+    }
+
+    /// Checks whether the segment with header `hdr` and payload `buf` carries the data that immediately follows that of
+    /// the held segment, and whether it is otherwise the same as it. Only plain data segments qualify, and nothing is
+    /// appended after a push. Segments with and without congestion marks are kept apart, so that their bytes are told
+    /// apart when they are acknowledged.
+    fn can_append(held_hdr: &TcpHeader, held_buf: &DemiBuffer, hdr: &TcpHeader, buf: &DemiBuffer) -> bool {
+        let is_plain = |hdr: &TcpHeader| -> bool {
+            hdr.ack && !(hdr.ns || hdr.cwr || hdr.ece || hdr.urg || hdr.rst || hdr.syn || hdr.fin)
+        };
+        let held_len: usize = held_buf.chain_len();
+
+        is_plain(held_hdr)
+            && is_plain(hdr)
+            && !held_hdr.psh
+            && held_len > 0
+            && buf.len() > 0
+            && held_len + buf.len() <= MAX_COALESCED_SIZE
+            && held_hdr.src_port == hdr.src_port
+            && held_hdr.dst_port == hdr.dst_port
+            && held_hdr.seq_num + SeqNumber::from(held_len as u32) == hdr.seq_num
+            && held_hdr.ack_num == hdr.ack_num
+            && held_hdr.window_size == hdr.window_size
+            && held_hdr.ce == hdr.ce
+            && held_hdr.option_list[..held_hdr.num_options] == hdr.option_list[..hdr.num_options]
+            && held_buf.is_heap_allocated() == buf.is_heap_allocated()
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        inetstack::protocols::layer4::tcp::{coalescing::ReceiveCoalescer, header::TcpHeader, SeqNumber},
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+    use ::std::net::Ipv4Addr;
+
+    const SRC: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 1);
+
+    // Builds a data segment that starts at `seq_num`.
+    fn segment(seq_num: u32, payload: &[u8]) -> Result<(TcpHeader, DemiBuffer)> {
+        let mut header: TcpHeader = TcpHeader::new(443, 5000);
+        header.seq_num = SeqNumber::from(seq_num);
+        header.ack = true;
+        header.window_size = 1024;
+        Ok((header, DemiBuffer::from_slice(payload)?))
+    }
+
+    // Tests that in-order segments are merged into one chained segment that ends at the first push.
+    #[test]
+    fn test_coalesce_in_order() -> Result<()> {
+        let mut coalescer: ReceiveCoalescer = ReceiveCoalescer::default();
+        let mut seq_num: u32 = u32::MAX - 10;
+        for i in 0..3 {
+            let (mut header, buf): (TcpHeader, DemiBuffer) = segment(seq_num, &[i; 100])?;
+            header.psh = i == 2;
+            crate::ensure_eq!(coalescer.push(SRC, header, buf).is_none(), true);
+            seq_num = seq_num.wrapping_add(100);
+        }
+        let (header, buf): (TcpHeader, DemiBuffer) = segment(seq_num, &[3; 100])?;
+        let (_, header, buf): (Ipv4Addr, TcpHeader, DemiBuffer) = match coalescer.push(SRC, header, buf) {
+            Some(held) => held,
+            None => anyhow::bail!("coalescer should have released the pushed segment"),
+        };
+
+        crate::ensure_eq!(header.seq_num, SeqNumber::from(u32::MAX - 10));
+        crate::ensure_eq!(header.psh, true);
+        crate::ensure_eq!(buf.num_segments(), 3);
+        crate::ensure_eq!(buf.chain_len(), 300);
+        for (i, data) in buf.segments().enumerate() {
+            crate::ensure_eq!(data, &[i as u8; 100][..]);
+        }
+        crate::ensure_eq!(
+            coalescer.take().map(|(_, header, _)| header.seq_num),
+            Some(SeqNumber::from(seq_num))
+        );
+
+        Ok(())
+    }
+
+    // Tests that segments that do not continue the held one are left alone.
+    #[test]
+    fn test_coalesce_out_of_order() -> Result<()> {
+        let mut coalescer: ReceiveCoalescer = ReceiveCoalescer::default();
+        let (header, buf): (TcpHeader, DemiBuffer) = segment(1000, &[0; 100])?;
+        crate::ensure_eq!(coalescer.push(SRC, header, buf).is_none(), true);
+
+        // A gap in the sequence space.
+        let (header, buf): (TcpHeader, DemiBuffer) = segment(1200, &[0; 100])?;
+        let held: Option<(Ipv4Addr, TcpHeader, DemiBuffer)> = coalescer.push(SRC, header, buf);
+        crate::ensure_eq!(
+            held.map(|(_, header, buf)| (header.seq_num, buf.num_segments())),
+            Some((SeqNumber::from(1000), 1))
+        );
+
+        // A segment that closes the connection.
+        let (mut header, buf): (TcpHeader, DemiBuffer) = segment(1300, &[0; 100])?;
+        header.fin = true;
+        let held: Option<(Ipv4Addr, TcpHeader, DemiBuffer)> = coalescer.push(SRC, header, buf);
+        crate::ensure_eq!(
+            held.map(|(_, header, buf)| (header.seq_num, buf.num_segments())),
+            Some((SeqNumber::from(1200), 1))
+        );
+
+        Ok(())
+    }
+}
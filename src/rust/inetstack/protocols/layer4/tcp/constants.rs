@@ -1,4 +1,11 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+use crate::inetstack::protocols::{layer3::ipv4::IPV4_HEADER_MAX_SIZE, layer4::tcp::header::MAX_TCP_HEADER_SIZE};
+
 pub use crate::runtime::network::consts::{DEFAULT_MSS, FALLBACK_MSS, MAX_MSS, MAX_WINDOW_SCALE, MIN_MSS, MSL};
+
+/// Largest payload of a TCP segment that is cut into MSS-sized segments on transmission. This keeps the total length of
+/// its IPv4 datagram within 16 bits.
+pub const MAX_SEGMENTATION_OFFLOAD_SIZE: usize =
+    u16::MAX as usize - IPV4_HEADER_MAX_SIZE as usize - MAX_TCP_HEADER_SIZE;
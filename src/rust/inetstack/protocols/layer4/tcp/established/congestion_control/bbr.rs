@@ -0,0 +1,494 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is a simplified implementation of BBR (version 1), as described in draft-cardwell-iccrg-bbr-congestion-control.
+// Instead of reacting to loss, BBR builds a model of the path out of the maximum delivery rate (the bottleneck
+// bandwidth) and the minimum round-trip time that it measures, paces sends at about the bottleneck bandwidth and keeps
+// about a BDP (bandwidth-delay product) in flight. It goes through four modes: Startup doubles the sending rate every
+// round until the bandwidth stops growing, Drain empties the queue that Startup built, ProbeBw cycles the pacing gain
+// around 1 to track changes in bandwidth, and ProbeRtt briefly drains the pipe to measure the minimum RTT anew.
+//
+// We sample the delivery rate once per round trip, from the bytes that are acknowledged in it. Loss only triggers fast
+// retransmit and, on RTO, a restart from a window of one segment; it does not change the model.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{
+            AckFeedback, CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, Pacing,
+            SlowStartCongestionAvoidance,
+        },
+        SeqNumber,
+    },
+};
+use ::std::{
+    cmp::{max, min},
+    fmt::Debug,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of rounds over which we take the maximum delivery rate as the bottleneck bandwidth.
+const BTL_BW_FILTER_ROUNDS: usize = 10;
+
+/// Gain of Startup, which is the smallest that doubles the sending rate every round (2/ln(2)).
+const HIGH_GAIN: f64 = 2.885;
+
+/// Pacing gains that ProbeBw cycles through, one minimum RTT each.
+const PROBE_BW_PACING_GAINS: [f64; 8] = [1.25, 0.75, 1., 1., 1., 1., 1., 1.];
+
+/// Gain of cwnd over the BDP in ProbeBw, which leaves room for delayed and stretched ACKs.
+const PROBE_BW_CWND_GAIN: f64 = 2.;
+
+/// Time after which we consider the minimum RTT stale and go measure it again.
+const MIN_RTT_EXPIRY: Duration = Duration::from_secs(10);
+
+/// Time that we spend in ProbeRtt with an almost empty pipe.
+const PROBE_RTT_DURATION: Duration = Duration::from_millis(200);
+
+/// Smallest cwnd, in segments, so that delayed ACKs cannot stall the connection.
+const MIN_PIPE_CWND_SEGMENTS: u32 = 4;
+
+/// Number of rounds without a 25% bandwidth growth after which Startup considers the pipe full.
+const FULL_BW_ROUNDS: u32 = 3;
+const FULL_BW_GROWTH: f64 = 1.25;
+
+const DUP_ACK_THRESHOLD: u32 = 3;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Mode {
+    Startup,
+    Drain,
+    ProbeBw,
+    ProbeRtt,
+}
+
+#[derive(Debug)]
+pub struct Bbr {
+    mss: u32,
+    cwnd: SharedAsyncValue<u32>, // Congestion window: Max number of bytes that may be in flight to prevent congestion.
+    mode: Mode,
+    pacing_gain: f64,
+    cwnd_gain: f64,
+
+    // Path Model.
+    btl_bw_samples: [u64; BTL_BW_FILTER_ROUNDS], // Delivery rates of the last rounds, in bytes per second.
+    min_rtt: Option<Duration>,                   // Minimum RTT in the last MIN_RTT_EXPIRY.
+    min_rtt_stamp: Option<Instant>,              // The moment at which we measured min_rtt.
+
+    // Round Trip Counting.
+    round_count: usize,           // Number of rounds so far.
+    round_end: SeqNumber,         // The current round ends when this is acknowledged.
+    round_start: Option<Instant>, // The moment at which the current round started.
+    round_bytes_acked: u64,       // Bytes acknowledged in the current round.
+
+    // Startup State.
+    full_bw: u64,       // Largest bottleneck bandwidth that grew by FULL_BW_GROWTH over the previous one.
+    full_bw_count: u32, // Number of rounds since full_bw last grew.
+    filled_pipe: bool,  // Did Startup find the bottleneck bandwidth?
+
+    // ProbeBw and ProbeRtt State.
+    cycle_index: usize,                    // Current phase of PROBE_BW_PACING_GAINS.
+    cycle_stamp: Option<Instant>,          // The moment at which the current phase started.
+    probe_rtt_done_stamp: Option<Instant>, // The moment at which ProbeRtt ends, once the pipe is almost empty.
+    prior_cwnd: u32,                       // cwnd before ProbeRtt or an RTO, to restore afterwards.
+
+    // Fast Recovery / Fast Retransmit State
+    duplicate_ack_count: u32, // The number of consecutive duplicate ACKs we've received.
+    fast_retransmit_now: SharedAsyncValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+    in_fast_recovery: bool,   // Are we currently in the `fast recovery` algorithm.
+    recover: SeqNumber,       // We leave fast recovery once the ACK reaches this (RFC 6582).
+
+    limited_transmit_cwnd_increase: SharedAsyncValue<u32>, // BBR does not use limited transmit, so this stays at 0.
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Bbr {
+    /// Gets the bottleneck bandwidth estimate, in bytes per second.
+    fn btl_bw(&self) -> u64 {
+        self.btl_bw_samples.iter().copied().max().unwrap_or(0)
+    }
+
+    /// Gets the estimate of the bandwidth-delay product, in bytes, if we have one.
+    fn bdp(&self) -> Option<u64> {
+        match (self.btl_bw(), self.min_rtt) {
+            (0, _) | (_, None) => None,
+            (btl_bw, Some(min_rtt)) => Some((btl_bw as u128 * min_rtt.as_nanos() / 1_000_000_000) as u64),
+        }
+    }
+
+    fn min_pipe_cwnd(&self) -> u32 {
+        MIN_PIPE_CWND_SEGMENTS * self.mss
+    }
+
+    /// Updates the minimum RTT and returns whether it had gone stale.
+    fn update_min_rtt(&mut self, feedback: &AckFeedback) -> bool {
+        let expired: bool = self
+            .min_rtt_stamp
+            .is_some_and(|stamp| feedback.now > stamp + MIN_RTT_EXPIRY);
+        if let Some(rtt) = feedback.rtt_sample {
+            if expired || self.min_rtt.map_or(true, |min_rtt| rtt <= min_rtt) {
+                self.min_rtt = Some(rtt);
+                self.min_rtt_stamp = Some(feedback.now);
+            }
+        }
+        expired
+    }
+
+    /// Accounts for the bytes that the ACK delivered and, if it ends the round, samples the delivery rate of the round
+    /// and starts the next one. Returns whether a round ended.
+    fn update_round(&mut self, feedback: &AckFeedback) -> bool {
+        self.round_bytes_acked += feedback.bytes_acked as u64;
+        let round_start: Instant = match self.round_start {
+            Some(round_start) if feedback.ack_seq_no >= self.round_end => round_start,
+            Some(_) => return false,
+            None => {
+                self.start_round(feedback);
+                return false;
+            },
+        };
+
+        let elapsed: Duration = feedback.now - round_start;
+        if !elapsed.is_zero() {
+            let delivery_rate: u64 = (self.round_bytes_acked as u128 * 1_000_000_000 / elapsed.as_nanos()) as u64;
+            self.btl_bw_samples[self.round_count % BTL_BW_FILTER_ROUNDS] = delivery_rate;
+            self.round_count += 1;
+        }
+        self.start_round(feedback);
+        true
+    }
+
+    fn start_round(&mut self, feedback: &AckFeedback) {
+        self.round_end = feedback.send_next;
+        self.round_start = Some(feedback.now);
+        self.round_bytes_acked = 0;
+    }
+
+    /// Checks, once per round, whether Startup has stopped finding more bandwidth.
+    fn check_full_pipe(&mut self) {
+        let btl_bw: u64 = self.btl_bw();
+        if btl_bw as f64 >= self.full_bw as f64 * FULL_BW_GROWTH {
+            self.full_bw = btl_bw;
+            self.full_bw_count = 0;
+        } else {
+            self.full_bw_count += 1;
+            self.filled_pipe = self.full_bw_count >= FULL_BW_ROUNDS;
+        }
+    }
+
+    fn enter_mode(&mut self, mode: Mode, now: Instant) {
+        self.mode = mode;
+        match mode {
+            Mode::Startup => {
+                self.pacing_gain = HIGH_GAIN;
+                self.cwnd_gain = HIGH_GAIN;
+            },
+            Mode::Drain => {
+                self.pacing_gain = 1. / HIGH_GAIN;
+                self.cwnd_gain = HIGH_GAIN;
+            },
+            Mode::ProbeBw => {
+                // Start in a phase that neither probes nor drains, so that we do not add to the queue right away.
+                self.cycle_index = 2;
+                self.cycle_stamp = Some(now);
+                self.pacing_gain = PROBE_BW_PACING_GAINS[self.cycle_index];
+                self.cwnd_gain = PROBE_BW_CWND_GAIN;
+            },
+            Mode::ProbeRtt => {
+                self.prior_cwnd = max(self.prior_cwnd, self.cwnd.get());
+                self.probe_rtt_done_stamp = None;
+                self.pacing_gain = 1.;
+                self.cwnd_gain = 1.;
+            },
+        }
+    }
+
+    fn update_mode(&mut self, feedback: &AckFeedback, round_ended: bool, min_rtt_expired: bool) {
+        let bytes_outstanding: u64 = Into::<u32>::into(feedback.send_next - feedback.ack_seq_no) as u64;
+        if min_rtt_expired && self.mode != Mode::ProbeRtt {
+            self.enter_mode(Mode::ProbeRtt, feedback.now);
+        }
+
+        match self.mode {
+            Mode::Startup => {
+                if round_ended {
+                    self.check_full_pipe();
+                }
+                if self.filled_pipe {
+                    self.enter_mode(Mode::Drain, feedback.now);
+                }
+            },
+            Mode::Drain => {
+                if self.bdp().map_or(true, |bdp| bytes_outstanding <= bdp) {
+                    self.enter_mode(Mode::ProbeBw, feedback.now);
+                }
+            },
+            Mode::ProbeBw => {
+                let min_rtt: Duration = self.min_rtt.unwrap_or_default();
+                if self.cycle_stamp.is_some_and(|stamp| feedback.now - stamp > min_rtt) {
+                    self.cycle_index = (self.cycle_index + 1) % PROBE_BW_PACING_GAINS.len();
+                    self.cycle_stamp = Some(feedback.now);
+                    self.pacing_gain = PROBE_BW_PACING_GAINS[self.cycle_index];
+                }
+            },
+            Mode::ProbeRtt => match self.probe_rtt_done_stamp {
+                None if bytes_outstanding <= self.min_pipe_cwnd() as u64 => {
+                    self.probe_rtt_done_stamp = Some(feedback.now + PROBE_RTT_DURATION);
+                },
+                Some(done_stamp) if feedback.now >= done_stamp => {
+                    // Whatever we measured in ProbeRtt is the minimum RTT now.
+                    self.min_rtt_stamp = Some(feedback.now);
+                    self.cwnd.set(max(self.cwnd.get(), self.prior_cwnd));
+                    self.prior_cwnd = 0;
+                    let mode: Mode = if self.filled_pipe { Mode::ProbeBw } else { Mode::Startup };
+                    self.enter_mode(mode, feedback.now);
+                },
+                _ => (),
+            },
+        }
+    }
+
+    fn update_cwnd(&mut self, bytes_acked: u32) {
+        let min_pipe_cwnd: u32 = self.min_pipe_cwnd();
+        if self.mode == Mode::ProbeRtt {
+            self.cwnd.set(min(self.cwnd.get(), min_pipe_cwnd));
+            return;
+        }
+        let cwnd: u32 = self.cwnd.get();
+        let cwnd: u32 = match self.bdp() {
+            Some(bdp) => {
+                let target: u32 =
+                    max((bdp as f64 * self.cwnd_gain) as u64, min_pipe_cwnd as u64).min(u32::MAX as u64) as u32;
+                if self.filled_pipe {
+                    min(cwnd.saturating_add(bytes_acked), target)
+                } else if cwnd < target {
+                    cwnd.saturating_add(bytes_acked)
+                } else {
+                    cwnd
+                }
+            },
+            // Without a model yet, grow as in slow start.
+            None => cwnd.saturating_add(bytes_acked),
+        };
+        self.cwnd.set(max(cwnd, min_pipe_cwnd));
+    }
+
+    fn on_dup_ack_received(&mut self, feedback: &AckFeedback) {
+        self.duplicate_ack_count += 1;
+        if self.duplicate_ack_count == DUP_ACK_THRESHOLD && !self.in_fast_recovery {
+            self.in_fast_recovery = true;
+            self.recover = feedback.send_next;
+            self.fast_retransmit_now.set(true);
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl CongestionControl for Bbr {
+    fn new(mss: usize, seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
+        let mss: u32 = mss.try_into().unwrap();
+        Box::new(Self {
+            mss,
+            cwnd: SharedAsyncValue::new(MIN_PIPE_CWND_SEGMENTS * mss),
+            mode: Mode::Startup,
+            pacing_gain: HIGH_GAIN,
+            cwnd_gain: HIGH_GAIN,
+            btl_bw_samples: [0; BTL_BW_FILTER_ROUNDS],
+            min_rtt: None,
+            min_rtt_stamp: None,
+            round_count: 0,
+            round_end: seq_no,
+            round_start: None,
+            round_bytes_acked: 0,
+            full_bw: 0,
+            full_bw_count: 0,
+            filled_pipe: false,
+            cycle_index: 0,
+            cycle_stamp: None,
+            probe_rtt_done_stamp: None,
+            prior_cwnd: 0,
+            duplicate_ack_count: 0,
+            fast_retransmit_now: SharedAsyncValue::new(false),
+            in_fast_recovery: false,
+            recover: seq_no,
+            limited_transmit_cwnd_increase: SharedAsyncValue::new(0),
+        })
+    }
+}
+
+impl SlowStartCongestionAvoidance for Bbr {
+    fn get_cwnd(&self) -> SharedAsyncValue<u32> {
+        self.cwnd.clone()
+    }
+
+    fn on_rto(&mut self, send_unacked: SeqNumber) {
+        // Restart from one segment, and grow back to the model as ACKs come.
+        self.prior_cwnd = max(self.prior_cwnd, self.cwnd.get());
+        self.cwnd.set(self.mss);
+        self.duplicate_ack_count = 0;
+        self.in_fast_recovery = false;
+        self.recover = send_unacked;
+    }
+
+    fn on_ack_feedback(&mut self, feedback: &AckFeedback) {
+        if feedback.duplicate {
+            self.on_dup_ack_received(feedback);
+            return;
+        }
+        if feedback.bytes_acked == 0 {
+            return;
+        }
+
+        self.duplicate_ack_count = 0;
+        if self.in_fast_recovery {
+            if feedback.ack_seq_no >= self.recover {
+                self.in_fast_recovery = false;
+            } else {
+                // Partial acknowledgement: the next hole was lost as well.
+                self.fast_retransmit_now.set(true);
+            }
+        }
+
+        let min_rtt_expired: bool = self.update_min_rtt(feedback);
+        let round_ended: bool = self.update_round(feedback);
+        self.update_mode(feedback, round_ended, min_rtt_expired);
+        self.update_cwnd(feedback.bytes_acked);
+    }
+}
+
+impl FastRetransmitRecovery for Bbr {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count
+    }
+
+    fn get_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
+        self.fast_retransmit_now.clone()
+    }
+
+    fn on_fast_retransmit(&mut self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Bbr {
+    fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32> {
+        self.limited_transmit_cwnd_increase.clone()
+    }
+}
+
+impl Pacing for Bbr {
+    fn get_pacing_rate(&self) -> Option<u64> {
+        match self.btl_bw() {
+            0 => None,
+            btl_bw => Some((btl_bw as f64 * self.pacing_gain) as u64),
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{AckFeedback, Bbr, CongestionControl},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::time::{Duration, Instant};
+
+    const MSS: u32 = 1000;
+
+    // Simulates a path that delivers `rate` bytes per millisecond with a round-trip time of 10 ms, for `rounds` rounds
+    // in which we keep as much in flight as cwnd and the pacing rate allow.
+    fn run(cc: &mut Box<dyn CongestionControl>, now: &mut Instant, ack_seq_no: &mut u32, rate: u32, rounds: usize) {
+        for _ in 0..rounds {
+            let paced: u32 = cc
+                .get_pacing_rate()
+                .map_or(u32::MAX, |pacing_rate| (pacing_rate / 100) as u32);
+            let in_flight: u32 = cc.get_cwnd().get().min(paced);
+            let delivered: u32 = in_flight.min(rate * 10);
+            let acks: u32 = (delivered / MSS).max(1);
+            for _ in 0..acks {
+                *now += Duration::from_micros(10_000 / acks as u64);
+                *ack_seq_no += MSS;
+                cc.on_ack_feedback(&AckFeedback {
+                    now: *now,
+                    bytes_acked: MSS,
+                    send_next: SeqNumber::from(*ack_seq_no + in_flight),
+                    ack_seq_no: SeqNumber::from(*ack_seq_no),
+                    rtt_sample: Some(Duration::from_millis(10)),
+                    ece: false,
+                    duplicate: false,
+                });
+            }
+        }
+    }
+
+    // Tests that Startup finds the bottleneck bandwidth and that BBR then paces at about that rate, with about twice the
+    // BDP as cwnd.
+    #[test]
+    fn test_bbr_finds_bottleneck_bandwidth() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Bbr::new(MSS as usize, SeqNumber::from(0), None);
+        let mut now: Instant = Instant::now();
+        let mut ack_seq_no: u32 = 0;
+        crate::ensure_eq!(cc.get_pacing_rate(), None);
+
+        // 1000 bytes per millisecond is 1 MB/s, which makes a BDP of 10 KB.
+        run(&mut cc, &mut now, &mut ack_seq_no, 1000, 30);
+        let pacing_rate: u64 = match cc.get_pacing_rate() {
+            Some(pacing_rate) => pacing_rate,
+            None => anyhow::bail!("bbr should pace once it has a bandwidth estimate"),
+        };
+        crate::ensure_eq!(pacing_rate >= 700_000 && pacing_rate <= 1_300_000, true);
+        let cwnd: u32 = cc.get_cwnd().get();
+        crate::ensure_eq!(cwnd >= 15_000 && cwnd <= 25_000, true);
+
+        Ok(())
+    }
+
+    // Tests that three duplicate ACKs trigger fast retransmit once, and that an RTO brings cwnd to one segment.
+    #[test]
+    fn test_bbr_loss() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Bbr::new(MSS as usize, SeqNumber::from(0), None);
+        let dup_ack: AckFeedback = AckFeedback {
+            now: Instant::now(),
+            bytes_acked: 0,
+            send_next: SeqNumber::from(4 * MSS),
+            ack_seq_no: SeqNumber::from(0),
+            rtt_sample: None,
+            ece: false,
+            duplicate: true,
+        };
+        for _ in 0..3 {
+            cc.on_ack_feedback(&dup_ack);
+        }
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), true);
+        cc.on_fast_retransmit();
+        cc.on_ack_feedback(&dup_ack);
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), false);
+
+        cc.on_rto(SeqNumber::from(0));
+        crate::ensure_eq!(cc.get_cwnd().get(), MSS);
+
+        Ok(())
+    }
+}
@@ -17,7 +17,7 @@ use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::layer4::tcp::{
         established::congestion_control::{
-            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, SlowStartCongestionAvoidance,
+            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, Pacing, SlowStartCongestionAvoidance,
         },
         SeqNumber,
     },
@@ -356,3 +356,5 @@ impl LimitedTransmit for Cubic {
         self.limited_transmit_cwnd_increase.clone()
     }
 }
+
+impl Pacing for Cubic {}
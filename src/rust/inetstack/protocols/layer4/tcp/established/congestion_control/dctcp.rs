@@ -0,0 +1,356 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is an implementation of Data Center TCP (DCTCP), as described in RFC 8257. DCTCP is meant for networks whose
+// switches mark packets with ECN congestion experienced (CE) as soon as their queues grow past a low threshold. It keeps
+// a moving estimate (alpha) of the fraction of bytes that are marked, and shrinks cwnd in proportion to it once per
+// window of data, instead of halving it on every congestion signal. This keeps queues short without giving up
+// throughput. Loss is handled as in NewReno (RFC 5681 and RFC 6582).
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{
+            AckFeedback, CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, Pacing,
+            SlowStartCongestionAvoidance,
+        },
+        SeqNumber,
+    },
+};
+use ::std::{
+    cmp::{max, min},
+    fmt::Debug,
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+#[derive(Debug)]
+pub struct Dctcp {
+    mss: u32,
+    // Slow Start / Congestion Avoidance State.
+    cwnd: SharedAsyncValue<u32>, // Congestion window: Max number of bytes that may be in flight to prevent congestion.
+    ssthresh: u32, // The size of cwnd at which we will change from using slow start to congestion avoidance.
+    ca_bytes_acked: u32, // Bytes acknowledged since cwnd last grew in congestion avoidance (RFC 5681, section 3.1).
+
+    // DCTCP State (RFC 8257, section 3.3).
+    g: f64,                   // Weight of new samples in the moving estimate of alpha.
+    alpha: f64,               // Estimate of the fraction of bytes that encounter congestion.
+    window_end: SeqNumber,    // End of the current observation window.
+    window_bytes_acked: u32,  // Bytes acknowledged in the current observation window.
+    window_bytes_marked: u32, // Bytes acknowledged with ECE in the current observation window.
+    reduction_end: SeqNumber, // We shrink cwnd on ECE at most once until the ACK passes this.
+    cwr_pending: bool,        // We shrank cwnd on ECE and have yet to set CWR on new data.
+
+    // Fast Recovery / Fast Retransmit State
+    duplicate_ack_count: u32, // The number of consecutive duplicate ACKs we've received.
+    fast_retransmit_now: SharedAsyncValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+    in_fast_recovery: bool,   // Are we currently in the `fast recovery` algorithm.
+    recover: SeqNumber,       // We leave fast recovery once the ACK reaches this (RFC 6582).
+
+    limited_transmit_cwnd_increase: SharedAsyncValue<u32>, // The amount by which cwnd should be increased due to the limited transit algorithm.
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Dctcp {
+    const DUP_ACK_THRESHOLD: u32 = 3;
+    // Default weight of new samples of the fraction of marked bytes, as recommended by RFC 8257, section 4.2.
+    const DEFAULT_G: f64 = 1. / 16.;
+
+    /// Updates the estimate of alpha once the ACK closes the current observation window.
+    fn update_alpha(&mut self, feedback: &AckFeedback) {
+        self.window_bytes_acked += feedback.bytes_acked;
+        if feedback.ece {
+            self.window_bytes_marked += feedback.bytes_acked;
+        }
+        if feedback.ack_seq_no > self.window_end {
+            let fraction: f64 = if self.window_bytes_acked > 0 {
+                self.window_bytes_marked as f64 / self.window_bytes_acked as f64
+            } else {
+                0.
+            };
+            self.alpha = (1. - self.g) * self.alpha + self.g * fraction;
+            self.window_bytes_acked = 0;
+            self.window_bytes_marked = 0;
+            self.window_end = feedback.send_next;
+        }
+    }
+
+    /// Shrinks cwnd in proportion to alpha, at most once per window of data (RFC 8257, section 3.3, step 9).
+    fn on_congestion_echo(&mut self, feedback: &AckFeedback) {
+        // A loss already shrank cwnd for this window.
+        if self.in_fast_recovery || feedback.ack_seq_no <= self.reduction_end {
+            return;
+        }
+        let reduced_cwnd: u32 = (self.cwnd.get() as f64 * (1. - self.alpha / 2.)) as u32;
+        let cwnd: u32 = max(reduced_cwnd, 2 * self.mss);
+        self.ssthresh = cwnd;
+        self.cwnd.set(cwnd);
+        self.ca_bytes_acked = 0;
+        self.reduction_end = feedback.send_next;
+        self.cwr_pending = true;
+    }
+
+    fn on_dup_ack_received(&mut self, feedback: &AckFeedback) {
+        self.duplicate_ack_count += 1;
+        if self.duplicate_ack_count < Self::DUP_ACK_THRESHOLD {
+            self.limited_transmit_cwnd_increase.modify(|ltci| ltci + self.mss);
+        } else if self.duplicate_ack_count == Self::DUP_ACK_THRESHOLD && !self.in_fast_recovery {
+            // RFC 5681, section 3.2, steps 2 and 3.
+            let bytes_outstanding: u32 = (feedback.send_next - feedback.ack_seq_no).into();
+            self.ssthresh = max(bytes_outstanding / 2, 2 * self.mss);
+            self.cwnd.set(self.ssthresh + Self::DUP_ACK_THRESHOLD * self.mss);
+            self.in_fast_recovery = true;
+            self.recover = feedback.send_next;
+            self.fast_retransmit_now.set(true);
+        } else if self.in_fast_recovery {
+            // RFC 5681, section 3.2, step 4.
+            self.cwnd.modify(|c| c + self.mss);
+        }
+    }
+
+    fn on_ack_received_fast_recovery(&mut self, feedback: &AckFeedback) {
+        let mss: u32 = self.mss;
+        if feedback.ack_seq_no >= self.recover {
+            // Full acknowledgement (RFC 6582, section 3.2, step 3).
+            let bytes_outstanding: u32 = (feedback.send_next - feedback.ack_seq_no).into();
+            self.cwnd.set(min(self.ssthresh, max(bytes_outstanding, mss) + mss));
+            self.ca_bytes_acked = 0;
+            self.in_fast_recovery = false;
+        } else {
+            // Partial acknowledgement (RFC 6582, section 3.2, step 4).
+            self.fast_retransmit_now.set(true);
+            let bytes_acknowledged: u32 = feedback.bytes_acked;
+            let deflation: u32 = if bytes_acknowledged >= mss {
+                bytes_acknowledged - mss
+            } else {
+                bytes_acknowledged
+            };
+            self.cwnd.modify(|c| max(c.saturating_sub(deflation), mss));
+        }
+    }
+
+    fn on_ack_received_ss_ca(&mut self, bytes_acknowledged: u32) {
+        let mss: u32 = self.mss;
+        let cwnd: u32 = self.cwnd.get();
+        if cwnd < self.ssthresh {
+            // Slow start.
+            self.cwnd.set(cwnd + min(bytes_acknowledged, mss));
+        } else {
+            // Congestion avoidance, with appropriate byte counting (RFC 3465).
+            self.ca_bytes_acked += bytes_acknowledged;
+            if self.ca_bytes_acked >= cwnd {
+                self.ca_bytes_acked -= cwnd;
+                self.cwnd.set(cwnd + mss);
+            }
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl CongestionControl for Dctcp {
+    fn new(mss: usize, seq_no: SeqNumber, options: Option<Options>) -> Box<dyn CongestionControl> {
+        let mss: u32 = mss.try_into().unwrap();
+        // The initial value of cwnd is set according to RFC5681, section 3.1, page 7.
+        let initial_cwnd: u32 = match mss {
+            0..=1095 => 4 * mss,
+            1096..=2190 => 3 * mss,
+            _ => 2 * mss,
+        };
+
+        let options: Options = options.unwrap_or_default();
+        let g: f64 = options.get_float("g").unwrap_or(Self::DEFAULT_G);
+
+        Box::new(Self {
+            mss,
+            cwnd: SharedAsyncValue::new(initial_cwnd),
+            ssthresh: u32::MAX, // According to RFC5681 ssthresh should be initialised 'arbitrarily high'.
+            ca_bytes_acked: 0,
+            g,
+            alpha: 1., // RFC 8257, section 3.3, recommends starting conservatively.
+            window_end: seq_no,
+            window_bytes_acked: 0,
+            window_bytes_marked: 0,
+            reduction_end: seq_no,
+            cwr_pending: false,
+            duplicate_ack_count: 0,
+            fast_retransmit_now: SharedAsyncValue::new(false),
+            in_fast_recovery: false,
+            recover: seq_no, // Recover set to initial send sequence number according to RFC6582.
+            limited_transmit_cwnd_increase: SharedAsyncValue::new(0),
+        })
+    }
+}
+
+impl SlowStartCongestionAvoidance for Dctcp {
+    fn get_cwnd(&self) -> SharedAsyncValue<u32> {
+        self.cwnd.clone()
+    }
+
+    fn on_send(&mut self, _rto: std::time::Duration, num_bytes_sent: u32) {
+        let new_value: u32 = self.limited_transmit_cwnd_increase.get().saturating_sub(num_bytes_sent);
+        self.limited_transmit_cwnd_increase.set_without_notify(new_value);
+    }
+
+    fn on_rto(&mut self, send_unacked: SeqNumber) {
+        // RFC 5681, section 3.1, equation 4, and RFC 6582, section 3.2, step 4.
+        let cwnd: u32 = self.cwnd.get();
+        self.ssthresh = max(cwnd / 2, 2 * self.mss);
+        self.cwnd.set(self.mss);
+        self.ca_bytes_acked = 0;
+        self.duplicate_ack_count = 0;
+        self.in_fast_recovery = false;
+        self.recover = send_unacked;
+    }
+
+    fn on_ack_feedback(&mut self, feedback: &AckFeedback) {
+        self.update_alpha(feedback);
+        if feedback.duplicate {
+            self.on_dup_ack_received(feedback);
+        } else if feedback.bytes_acked > 0 {
+            self.duplicate_ack_count = 0;
+            if self.in_fast_recovery {
+                self.on_ack_received_fast_recovery(feedback);
+            } else if !feedback.ece {
+                self.on_ack_received_ss_ca(feedback.bytes_acked);
+            }
+        }
+        if feedback.ece {
+            self.on_congestion_echo(feedback);
+        }
+    }
+
+    fn get_cwr_pending(&self) -> bool {
+        self.cwr_pending
+    }
+
+    fn on_cwr_sent(&mut self) {
+        self.cwr_pending = false;
+    }
+}
+
+impl FastRetransmitRecovery for Dctcp {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count
+    }
+
+    fn get_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
+        self.fast_retransmit_now.clone()
+    }
+
+    fn on_fast_retransmit(&mut self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Dctcp {
+    fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32> {
+        self.limited_transmit_cwnd_increase.clone()
+    }
+}
+
+// DCTCP keeps queues short through ECN alone, so it sends as fast as cwnd allows.
+impl Pacing for Dctcp {}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{AckFeedback, CongestionControl, Dctcp},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::time::Instant;
+
+    const MSS: u32 = 1000;
+
+    // Acknowledges `bytes` more bytes, with `flight` bytes still in flight after them.
+    fn ack(ack_seq_no: &mut u32, bytes: u32, flight: u32, ece: bool) -> AckFeedback {
+        *ack_seq_no += bytes;
+        AckFeedback {
+            now: Instant::now(),
+            bytes_acked: bytes,
+            send_next: SeqNumber::from(*ack_seq_no + flight),
+            ack_seq_no: SeqNumber::from(*ack_seq_no),
+            rtt_sample: None,
+            ece,
+            duplicate: false,
+        }
+    }
+
+    // Tests that marked ACKs shrink cwnd by alpha/2 at most once per window, and that alpha decays without marks.
+    #[test]
+    fn test_dctcp_reacts_to_marks_once_per_window() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Dctcp::new(MSS as usize, SeqNumber::from(0), None);
+        let mut ack_seq_no: u32 = 0;
+
+        // Grow cwnd in slow start. The first ACK closes the first observation window, which takes alpha to 15/16.
+        for _ in 0..36 {
+            cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, 100 * MSS, false));
+        }
+        crate::ensure_eq!(cc.get_cwnd().get(), 40 * MSS);
+
+        // The first mark shrinks cwnd by alpha/2, and the marks that follow within the same window do not. Only the
+        // reduction asks for CWR.
+        cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, 100 * MSS, true));
+        crate::ensure_eq!(cc.get_cwnd().get(), 40 * MSS * 17 / 32);
+        crate::ensure_eq!(cc.get_cwr_pending(), true);
+        cc.on_cwr_sent();
+        for _ in 0..10 {
+            cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, 100 * MSS, true));
+        }
+        crate::ensure_eq!(cc.get_cwnd().get(), 40 * MSS * 17 / 32);
+        crate::ensure_eq!(cc.get_cwr_pending(), false);
+
+        // After many windows without marks, a mark costs cwnd only a little.
+        for _ in 0..2000 {
+            cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, 0, false));
+        }
+        let cwnd: u32 = cc.get_cwnd().get();
+        cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, cwnd, true));
+        let reduced_cwnd: u32 = cc.get_cwnd().get();
+        crate::ensure_eq!(reduced_cwnd < cwnd, true);
+        crate::ensure_eq!(reduced_cwnd > cwnd * 95 / 100, true);
+
+        Ok(())
+    }
+
+    // Tests that three duplicate ACKs trigger fast retransmit and a full ACK deflates cwnd.
+    #[test]
+    fn test_dctcp_fast_recovery() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Dctcp::new(MSS as usize, SeqNumber::from(0), None);
+        let mut ack_seq_no: u32 = 0;
+        for _ in 0..16 {
+            cc.on_ack_feedback(&ack(&mut ack_seq_no, MSS, 0, false));
+        }
+
+        let mut dup_ack: AckFeedback = ack(&mut ack_seq_no, 0, 20 * MSS, false);
+        dup_ack.duplicate = true;
+        for _ in 0..3 {
+            cc.on_ack_feedback(&dup_ack);
+        }
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), true);
+        crate::ensure_eq!(cc.get_cwnd().get(), 13 * MSS);
+        cc.on_fast_retransmit();
+
+        cc.on_ack_feedback(&ack(&mut ack_seq_no, 20 * MSS, 0, false));
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), false);
+        crate::ensure_eq!(cc.get_cwnd().get(), 2 * MSS);
+
+        Ok(())
+    }
+}
@@ -1,19 +1,48 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod bbr;
 mod cubic;
+mod dctcp;
 mod none;
 mod options;
 
-use crate::{collections::async_value::SharedAsyncValue, inetstack::protocols::layer4::tcp::SeqNumber};
-use ::std::{fmt::Debug, time::Duration};
+use crate::{
+    collections::async_value::SharedAsyncValue, inetstack::protocols::layer4::tcp::SeqNumber,
+    runtime::network::socket::option::CongestionControlAlgorithm,
+};
+use ::std::{
+    fmt::Debug,
+    time::{Duration, Instant},
+};
 
 pub use self::{
+    bbr::Bbr,
     cubic::Cubic,
+    dctcp::Dctcp,
     none::None,
     options::{OptionValue, Options},
 };
 
+/// What we learn from an acceptable ACK, after the sender has processed it.
+#[derive(Clone, Copy, Debug)]
+pub struct AckFeedback {
+    /// Time at which the ACK arrived.
+    pub now: Instant,
+    /// Number of bytes that the ACK newly acknowledges.
+    pub bytes_acked: u32,
+    /// SND.NXT when the ACK arrived.
+    pub send_next: SeqNumber,
+    /// Acknowledgment number of the ACK, which is SND.UNA after processing it.
+    pub ack_seq_no: SeqNumber,
+    /// Round-trip time measured on the newest segment that the ACK acknowledges, if it was not retransmitted.
+    pub rtt_sample: Option<Duration>,
+    /// Whether the ACK echoes a congestion mark (ECE), on connections that negotiated ECN.
+    pub ece: bool,
+    /// Whether the ACK is a duplicate, i.e., it acknowledges nothing new and carries no data while data is in flight.
+    pub duplicate: bool,
+}
+
 pub trait SlowStartCongestionAvoidance {
     fn get_cwnd(&self) -> SharedAsyncValue<u32>;
 
@@ -34,6 +63,17 @@ pub trait SlowStartCongestionAvoidance {
 
     // Called immediately before a segment is sent for the 1st time.
     fn on_send(&mut self, _rto: Duration, _num_sent_bytes: u32) {}
+
+    // Called after the sender has processed an acceptable ACK, with what it learned from it.
+    fn on_ack_feedback(&mut self, _feedback: &AckFeedback) {}
+
+    // Whether cwnd shrank in response to ECE since we last told our peer with CWR (RFC 3168, section 6.1.2).
+    fn get_cwr_pending(&self) -> bool {
+        false
+    }
+
+    // Called once a segment with new data carries CWR.
+    fn on_cwr_sent(&mut self) {}
 }
 
 pub trait FastRetransmitRecovery
@@ -56,10 +96,38 @@ where
     fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32>;
 }
 
-pub trait CongestionControl: SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Debug {
+pub trait Pacing
+where
+    Self: SlowStartCongestionAvoidance,
+{
+    // Rate in bytes per second at which we should spread out sends, or None to send as fast as the window allows.
+    fn get_pacing_rate(&self) -> Option<u64> {
+        Option::None
+    }
+}
+
+pub trait CongestionControl:
+    SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Pacing + Debug
+{
     fn new(mss: usize, seq_no: SeqNumber, options: Option<options::Options>) -> Box<dyn CongestionControl>
     where
         Self: Sized;
 }
 
 pub type CongestionControlConstructor = fn(usize, SeqNumber, Option<options::Options>) -> Box<dyn CongestionControl>;
+
+/// Gets the constructor of a congestion control algorithm.
+pub fn get_constructor(algorithm: CongestionControlAlgorithm) -> CongestionControlConstructor {
+    match algorithm {
+        CongestionControlAlgorithm::None => None::new,
+        CongestionControlAlgorithm::Cubic => Cubic::new,
+        CongestionControlAlgorithm::Dctcp => Dctcp::new,
+        CongestionControlAlgorithm::Bbr => Bbr::new,
+    }
+}
+
+/// Checks whether a congestion control algorithm reacts to ECN marks, in which case we negotiate ECN for its
+/// connections.
+pub fn uses_ecn(algorithm: CongestionControlAlgorithm) -> bool {
+    algorithm == CongestionControlAlgorithm::Dctcp
+}
@@ -9,7 +9,7 @@ use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::layer4::tcp::{
         established::congestion_control::{
-            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, SlowStartCongestionAvoidance,
+            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, Pacing, SlowStartCongestionAvoidance,
         },
         SeqNumber,
     },
@@ -57,3 +57,4 @@ impl LimitedTransmit for None {
         self.limited_retransmit_cwnd_increase.clone()
     }
 }
+impl Pacing for None {}
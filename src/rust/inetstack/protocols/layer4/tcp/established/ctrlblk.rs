@@ -8,7 +8,7 @@
 use crate::{
     collections::{
         async_queue::{AsyncQueue, SharedAsyncQueue},
-        async_value::SharedAsyncValue,
+        async_value::{AsyncValue, SharedAsyncValue},
     },
     expect_ok,
     inetstack::protocols::{
@@ -16,18 +16,20 @@ use crate::{
         layer4::tcp::{
             constants::MSL,
             established::{
-                congestion_control::{self, CongestionControlConstructor},
+                congestion_control::{self, AckFeedback, CongestionControlConstructor},
+                sack,
                 sender::Sender,
             },
             header::TcpHeader,
             SeqNumber,
         },
-        MAX_HEADER_SIZE,
+        prepare_payload, MAX_HEADER_SIZE,
     },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
         network::{config::TcpConfig, socket::option::TcpSocketOptions},
+        types::DEMI_SGARRAY_MAXLEN,
         yield_with_timeout, SharedDemiRuntime, SharedObject,
     },
 };
@@ -43,10 +45,6 @@ use ::std::{
 // Constants
 //======================================================================================================================
 
-// TODO: We should probably have a max for this value as well. This is just the number that we allocate initially and
-// we never need to allocate more memory as long as the receive queue remains below this number.
-const MIN_RECV_QUEUE_SIZE_FRAMES: usize = 2048;
-
 // TODO: Review this value (and its purpose).  It (16 segments) seems awfully small (would make fast retransmit less
 // useful), and this mechanism isn't the best way to protect ourselves against deliberate out-of-order segment attacks.
 // Ideally, we'd limit out-of-order data to that which (along with the unread data) will fit in the receive window.
@@ -97,10 +95,11 @@ struct Receiver {
     // Sequence number of the next byte of data (or FIN) that we expect to receive.  In RFC 793 terms, this is RCV.NXT.
     receive_next_seq_no: SeqNumber,
 
-    // Sequnce number of the last byte of data (FIN).
-    fin_seq_no: SharedAsyncValue<Option<SeqNumber>>,
+    // Sequnce number of the last byte of data (FIN). Only this receiver waits on it, so it lives inline.
+    fin_seq_no: AsyncValue<Option<SeqNumber>>,
 
-    // Receive queue.  Contains in-order received (and acknowledged) data ready for the application to read.
+    // Receive queue.  Contains in-order received (and acknowledged) data ready for the application to read. It starts
+    // out empty and only allocates once data arrives, so that idle connections do not hold receive memory.
     recv_queue: AsyncQueue<DemiBuffer>,
 }
 
@@ -109,8 +108,8 @@ impl Receiver {
         Self {
             reader_next_seq_no,
             receive_next_seq_no,
-            fin_seq_no: SharedAsyncValue::new(None),
-            recv_queue: AsyncQueue::with_capacity(MIN_RECV_QUEUE_SIZE_FRAMES),
+            fin_seq_no: AsyncValue::new(None),
+            recv_queue: AsyncQueue::default(),
         }
     }
 
@@ -121,15 +120,16 @@ impl Receiver {
             if buf.len() > size {
                 buf.split_front(size)?
             } else {
+                self.chain_queued_data(&mut buf, size)?;
                 buf
             }
         } else {
             self.recv_queue.pop(None).await?
         };
 
-        match buf.len() {
+        match buf.chain_len() {
             len if len > 0 => {
-                self.reader_next_seq_no = self.reader_next_seq_no + SeqNumber::from(buf.len() as u32);
+                self.reader_next_seq_no = self.reader_next_seq_no + SeqNumber::from(len as u32);
             },
             _ => {
                 self.reader_next_seq_no = self.reader_next_seq_no + 1.into();
@@ -139,6 +139,37 @@ impl Receiver {
         Ok(buf)
     }
 
+    /// Appends data that already waits in the receive queue to `buf` as further segments, so that a large read comes
+    /// back as a multi-segment scatter-gather array instead of one segment per pop. This stops at `size` bytes, at the
+    /// maximum number of segments in a scatter-gather array, or at a FIN.
+    fn chain_queued_data(&mut self, buf: &mut DemiBuffer, size: usize) -> Result<(), Fail> {
+        // Never chain anything onto a FIN.
+        if buf.len() == 0 {
+            return Ok(());
+        }
+
+        while buf.num_segments() < DEMI_SGARRAY_MAXLEN && buf.chain_len() < size {
+            // Leave FINs and buffers that cannot be chained to this one in the queue.
+            match self.recv_queue.get_front() {
+                Some(next) if next.len() > 0 && next.is_heap_allocated() == buf.is_heap_allocated() => (),
+                _ => break,
+            }
+            // This unwrap won't panic, as we just checked that the queue is not empty.
+            let mut next: DemiBuffer = self.recv_queue.try_pop().unwrap();
+
+            // Split the buffer if it's too big and keep the rest in the queue.
+            let remaining: usize = size - buf.chain_len();
+            if next.len() > remaining {
+                let front: DemiBuffer = next.split_front(remaining)?;
+                self.recv_queue.push_front(next);
+                next = front;
+            }
+            buf.chain(next)?;
+        }
+
+        Ok(())
+    }
+
     pub fn push(&mut self, buf: DemiBuffer) {
         let buf_len: u32 = buf.len() as u32;
         self.recv_queue.push(buf);
@@ -172,8 +203,12 @@ impl Receiver {
 // Control Block
 //======================================================================================================================
 
-/// Transmission control block for representing our TCP connection.
+/// Transmission control block for representing our TCP connection. The sender and receiver state lives inline, so that
+/// the bulk of an idle connection is this one allocation, which starts on a cache line of its own. The shared async
+/// values and queues stay separate allocations, because the background coroutines of the connection wait on clones of
+/// them.
 // TODO: Make all public fields in this structure private.
+#[repr(align(64))]
 pub struct ControlBlock {
     local: SocketAddrV4,
     remote: SocketAddrV4,
@@ -243,6 +278,20 @@ pub struct ControlBlock {
     // TODO: Consider switching this to a static implementation to avoid V-table call overhead.
     congestion_control_algorithm: Box<dyn congestion_control::CongestionControl>,
 
+    // Whether both ends agreed to use ECN (RFC 3168) on this connection.
+    ecn_enabled: bool,
+
+    // Whether the last data segment that we received was marked with congestion experienced (CE). As in DCTCP (RFC 8257,
+    // section 3.2), we set ECE on our ACKs for as long as this holds, so that the sender learns how many of its bytes
+    // were marked.
+    ecn_ce_state: bool,
+
+    // Whether both ends agreed to use selective acknowledgements (RFC 2018) on this connection.
+    sack_enabled: bool,
+
+    // Start of the out-of-order segment that we received last, whose block goes first in our SACK options.
+    receive_sack_recent_seq_no: Option<SeqNumber>,
+
     // This data structure stores the number of bytes acked for each outgoing frame.
     // TODO: Change this to a single number for SND.UNA
     receive_ack_queue_frame_bytes: SharedAsyncQueue<usize>,
@@ -277,6 +326,8 @@ impl SharedControlBlock {
         sender_mss: usize,
         congestion_control_algorithm_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
+        ecn_enabled: bool,
+        sack_enabled: bool,
         recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
         receive_ack_queue_frame_bytes: SharedAsyncQueue<usize>,
         parent_passive_socket_close_queue: Option<SharedAsyncQueue<SocketAddrV4>>,
@@ -286,6 +337,8 @@ impl SharedControlBlock {
             send_window_size_frames,
             send_window_scale_shift_bits,
             sender_mss,
+            tcp_config.get_segmentation_offload(),
+            sack_enabled,
         );
         Self(SharedObject::<ControlBlock>::new(ControlBlock {
             local,
@@ -307,6 +360,10 @@ impl SharedControlBlock {
                 sender_initial_seq_no,
                 congestion_control_options,
             ),
+            ecn_enabled,
+            ecn_ce_state: false,
+            sack_enabled,
+            receive_sack_recent_seq_no: None,
             recv_queue,
             receive_ack_queue_frame_bytes,
             parent_passive_socket_close_queue,
@@ -359,6 +416,10 @@ impl SharedControlBlock {
         self.congestion_control_algorithm.get_limited_transmit_cwnd_increase()
     }
 
+    pub fn congestion_control_get_pacing_rate(&self) -> Option<u64> {
+        self.congestion_control_algorithm.get_pacing_rate()
+    }
+
     pub fn get_now(&self) -> Instant {
         self.runtime.get_now()
     }
@@ -407,20 +468,24 @@ impl SharedControlBlock {
     fn process_packet(&mut self, mut header: TcpHeader, mut data: DemiBuffer) -> Result<(), Fail> {
         let mut seg_start: SeqNumber = header.seq_num;
         let mut seg_end: SeqNumber = seg_start;
-        let mut seg_len: u32 = data.len() as u32;
+        // Coalesced segments carry their data in a chain of buffers.
+        let mut seg_len: u32 = data.chain_len() as u32;
 
         // Check if the segment is in the receive window and trim off everything else.
         self.check_segment_in_window(&mut header, &mut data, &mut seg_start, &mut seg_end, &mut seg_len)?;
         self.check_rst(&header)?;
         self.check_syn(&header)?;
-        self.process_ack(&header)?;
+        self.process_ack(&header, seg_len)?;
+        if self.ecn_enabled && seg_len > 0 {
+            self.update_ecn_ce_state(header.ce);
+        }
 
         // TODO: Check the URG bit.  If we decide to support this, how should we do it?
         if header.urg {
             warn!("Got packet with URG bit set!");
         }
 
-        if data.len() > 0 {
+        if data.chain_len() > 0 {
             self.process_data(data, seg_start, seg_end, seg_len)?;
         }
 
@@ -545,6 +610,7 @@ impl SharedControlBlock {
                         header.syn = false;
                         duplicate -= 1;
                     }
+                    Self::flatten(data)?;
                     expect_ok!(
                         data.adjust(duplicate as usize),
                         "'data' should contain at least 'duplicate' bytes"
@@ -583,6 +649,7 @@ impl SharedControlBlock {
                 header.fin = false;
                 excess -= 1;
             }
+            Self::flatten(data)?;
             expect_ok!(
                 data.trim(excess as usize),
                 "'data' should contain at least 'excess' bytes"
@@ -598,6 +665,15 @@ impl SharedControlBlock {
         Ok(())
     }
 
+    /// Copies the data of a coalesced segment into a single buffer, so that it can be trimmed or stored out of order.
+    /// This is off the fast path, where coalesced segments arrive in order and fit in the receive window.
+    fn flatten(data: &mut DemiBuffer) -> Result<(), Fail> {
+        if data.num_segments() > 1 {
+            *data = data.linearize(0)?;
+        }
+        Ok(())
+    }
+
     // Check the RST bit.
     fn check_rst(&mut self, header: &TcpHeader) -> Result<(), Fail> {
         if header.rst {
@@ -635,8 +711,19 @@ impl SharedControlBlock {
         Ok(())
     }
 
+    /// Tracks whether data segments arrive with congestion marks. When that changes while we hold back an ACK, we send it
+    /// right away with the previous state, so that the ECE flags that our peer sees cover exactly the marked bytes.
+    fn update_ecn_ce_state(&mut self, ce: bool) {
+        if ce != self.ecn_ce_state {
+            if self.receive_ack_deadline_time_secs.get().is_some() {
+                self.send_ack();
+            }
+            self.ecn_ce_state = ce;
+        }
+    }
+
     // Check the ACK bit.
-    fn process_ack(&mut self, header: &TcpHeader) -> Result<(), Fail> {
+    fn process_ack(&mut self, header: &TcpHeader, seg_len: u32) -> Result<(), Fail> {
         if !header.ack {
             // All segments on established connections should be ACKs.  Drop this segment.
             let cause: String = format!("Received non-ACK segment on established connection");
@@ -666,9 +753,34 @@ impl SharedControlBlock {
             // Does not matter when we get this since the clock will not move between the beginning of packet
             // processing and now without a call to advance_clock.
             let now: Instant = self.get_now();
-            self.sender.process_ack(header, now);
+            let rtt_sample: Option<Duration> = self.sender.process_ack(header, now);
             let nbytes: usize = Into::<u32>::into(header.ack_num - send_unacknowledged) as usize;
-            self.receive_ack_queue_frame_bytes.push(nbytes)
+            self.receive_ack_queue_frame_bytes.push(nbytes);
+
+            let bytes_acked: u32 = if header.ack_num > send_unacknowledged {
+                nbytes as u32
+            } else {
+                0
+            };
+            let feedback: AckFeedback = AckFeedback {
+                now,
+                bytes_acked,
+                send_next,
+                ack_seq_no: self.sender.get_unacked_seq_no(),
+                rtt_sample,
+                ece: self.ecn_enabled && header.ece,
+                // See the definition of a duplicate ACK in RFC 5681, section 2.
+                duplicate: header.ack_num == send_unacknowledged
+                    && send_next != send_unacknowledged
+                    && seg_len == 0
+                    && !header.syn
+                    && !header.fin,
+            };
+            self.congestion_control_algorithm.on_ack_feedback(&feedback);
+
+            // Repair the losses that this ACK revealed, as far as congestion control now lets us.
+            let mut cb: Self = self.clone();
+            self.sender.retransmit_lost(&mut cb);
         } else {
             // This segment acknowledges data we have yet to send!?  Send an ACK and drop the segment.
             // TODO: See RFC 5961, this could be a Blind Data Injection Attack.
@@ -683,7 +795,7 @@ impl SharedControlBlock {
 
     fn process_data(
         &mut self,
-        data: DemiBuffer,
+        mut data: DemiBuffer,
         seg_start: SeqNumber,
         seg_end: SeqNumber,
         seg_len: u32,
@@ -696,8 +808,10 @@ impl SharedControlBlock {
             if seg_len > 0 {
                 match self.state {
                     State::Established | State::FinWait1 | State::FinWait2 => {
+                        Self::flatten(&mut data)?;
                         debug_assert_eq!(seg_len, data.len() as u32);
                         self.store_out_of_order_segment(seg_start, seg_end, data);
+                        self.receive_sack_recent_seq_no = Some(seg_start);
                         // Sending an ACK here is only a "MAY" according to the RFCs, but helpful for fast retransmit.
                         trace!("process_data(): send ack on out-of-order segment");
                         self.send_ack();
@@ -724,6 +838,7 @@ impl SharedControlBlock {
         // Note that once we reach a synchronized state we always include a valid acknowledgement number.
         header.ack = true;
         header.ack_num = self.receiver.receive_next_seq_no;
+        header.ece = self.ecn_ce_state;
 
         // Return this header.
         header
@@ -737,16 +852,58 @@ impl SharedControlBlock {
         // TODO: Think about moving this to tcp_header() as well.
         let seq_num: SeqNumber = self.sender.get_next_seq_no();
         header.seq_num = seq_num;
+
+        // Tell our peer which out-of-order data we hold (RFC 2018). We only do so on pure ACKs, so that the option never
+        // takes room away from the payload of data segments.
+        if self.sack_enabled {
+            let ranges = self
+                .receive_out_of_order_frames
+                .iter()
+                .map(|(start, buf)| (*start, buf.len() as u32));
+            if let Some(option) = sack::build_sack_option(ranges, self.receive_sack_recent_seq_no) {
+                header.push_option(option);
+            }
+        }
         self.emit(header, None);
     }
 
     /// Transmit this message to our connected peer.
     pub fn emit(&mut self, header: TcpHeader, body: Option<DemiBuffer>) {
+        self.emit_segmented(header, body, 0)
+    }
+
+    /// Emits a segment whose payload may be larger than `mss`. Such a segment is marked so that the NIC cuts it into
+    /// `mss`-sized segments, or the network stack does so in software if the NIC cannot.
+    pub fn emit_segmented(&mut self, header: TcpHeader, body: Option<DemiBuffer>, mss: usize) {
+        self.transmit(header, body, mss, false)
+    }
+
+    /// Same as [Self::emit_segmented], for new data. If we negotiated ECN, the data goes out ECN-capable. RFC 3168,
+    /// section 6.1.5, forbids this for retransmissions and pure ACKs, which therefore go through the other functions.
+    pub fn emit_data(&mut self, mut header: TcpHeader, body: DemiBuffer, mss: usize) {
+        let ecn_capable: bool = self.ecn_enabled;
+        // Once we shrank cwnd in response to ECE, the first new data says so with CWR, which tells a receiver that
+        // latches ECE to stop echoing (RFC 3168, section 6.1.2).
+        if ecn_capable && self.congestion_control_algorithm.get_cwr_pending() {
+            header.cwr = true;
+            self.congestion_control_algorithm.on_cwr_sent();
+        }
+        self.transmit(header, Some(body), mss, ecn_capable)
+    }
+
+    fn transmit(&mut self, header: TcpHeader, body: Option<DemiBuffer>, mss: usize, ecn_capable: bool) {
+        let payload_len: usize = body.as_ref().map_or(0, |body| body.chain_len());
         // Only perform this debug print in debug builds.  debug_assertions is compiler set in non-optimized builds.
         let mut pkt = match body {
             Some(body) => {
                 debug!("Sending {} bytes + {:?}", body.len(), header);
-                body
+                match prepare_payload(body) {
+                    Ok(pkt) => pkt,
+                    Err(e) => {
+                        warn!("could not emit packet: {:?}", e);
+                        return;
+                    },
+                }
             },
             _ => {
                 debug!("Sending 0 bytes + {:?}", header);
@@ -764,12 +921,19 @@ impl SharedControlBlock {
             self.remote.ip(),
             self.tcp_config.get_tx_checksum_offload(),
         );
+        if mss > 0 && payload_len > mss {
+            pkt.set_tso_segment_size(mss as u16);
+        }
 
         // Call lower L3 layer to send the segment.
-        if let Err(e) = self
-            .layer3_endpoint
-            .transmit_tcp_packet_nonblocking(remote_ipv4_addr, pkt)
-        {
+        let result: Result<(), Fail> = if ecn_capable {
+            self.layer3_endpoint
+                .transmit_ecn_capable_tcp_packet_nonblocking(remote_ipv4_addr, pkt)
+        } else {
+            self.layer3_endpoint
+                .transmit_tcp_packet_nonblocking(remote_ipv4_addr, pkt)
+        };
+        if let Err(e) = result {
             warn!("could not emit packet: {:?}", e);
             return;
         }
@@ -942,9 +1106,16 @@ impl SharedControlBlock {
         debug_assert_eq!(seg_start, recv_next);
 
         // Push the new segment data onto the end of the receive queue.
-        let mut recv_next: SeqNumber = recv_next + SeqNumber::from(buf.len() as u32);
-        // This inserts the segment and wakes a waiting pop coroutine.
-        self.receiver.push(buf);
+        let mut recv_next: SeqNumber = recv_next + SeqNumber::from(buf.chain_len() as u32);
+        // This inserts the segment and wakes a waiting pop coroutine. The receive queue holds single buffers, so the
+        // buffers of a coalesced segment go in one by one, skipping empty ones, which would otherwise read as a FIN.
+        let mut next: Option<DemiBuffer> = Some(buf);
+        while let Some(mut buf) = next.take() {
+            next = buf.detach_tail();
+            if buf.len() > 0 {
+                self.receiver.push(buf);
+            }
+        }
 
         // Okay, we've successfully received some new data.  Check if any of the formerly out-of-order data waiting in
         // the out-of-order queue is now in-order.  If so, we can move it to the receive queue.
@@ -4,7 +4,9 @@
 mod background;
 pub mod congestion_control;
 mod ctrlblk;
+mod rack;
 mod rto;
+mod sack;
 mod sender;
 
 use crate::{
@@ -63,6 +65,8 @@ impl EstablishedSocket {
         sender_mss: usize,
         cc_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
+        ecn_enabled: bool,
+        sack_enabled: bool,
         dead_socket_tx: mpsc::UnboundedSender<QDesc>,
         socket_queue: Option<SharedAsyncQueue<SocketAddrV4>>,
     ) -> Result<Self, Fail> {
@@ -84,13 +88,15 @@ impl EstablishedSocket {
             sender_mss,
             cc_constructor,
             congestion_control_options,
+            ecn_enabled,
+            sack_enabled,
             recv_queue.clone(),
             ack_queue.clone(),
             socket_queue,
         );
         let qt: QToken = runtime.insert_background_coroutine(
             "bgc::inetstack::tcp::established::background",
-            Box::pin(background::background(cb.clone(), dead_socket_tx).fuse()),
+            background::background(cb.clone(), dead_socket_tx).fuse(),
         )?;
         Ok(Self {
             cb,
@@ -0,0 +1,239 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::inetstack::protocols::layer4::tcp::SeqNumber;
+use ::std::{
+    cmp,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Worst-case delay with which our peer may acknowledge a lone segment (WCDelAckT in RFC 8985, section 7.2).
+const WORST_CASE_DELAYED_ACK: Duration = Duration::from_millis(200);
+
+/// Probe timeout for when we have no round-trip time estimate yet (RFC 8985, section 7.2).
+const INITIAL_PROBE_TIMEOUT: Duration = Duration::from_secs(1);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// State of the Recent Acknowledgment (RACK) loss detection algorithm (RFC 8985). RACK deems a segment lost once a
+/// segment that we sent after it has been delivered, and enough time has passed since we sent it to rule out mere
+/// reordering. Unlike duplicate ACK counting, this also works when there are too few segments in flight to trigger
+/// fast retransmit, and for the retransmissions themselves.
+pub struct Rack {
+    /// Transmission time of the most recently sent segment that has been delivered (RACK.xmit_ts).
+    xmit_ts: Option<Instant>,
+    /// End of the sequence range of that segment (RACK.end_seq).
+    end_seq: SeqNumber,
+    /// Round-trip time that the delivery of that segment took (RACK.rtt).
+    rtt: Duration,
+    /// Smallest round-trip time that we have seen (RACK.min_RTT). RFC 8985 tracks this over a window of time, we keep
+    /// it for the lifetime of the connection.
+    min_rtt: Option<Duration>,
+    /// End of the highest sequence range that has been delivered (RACK.fack).
+    fack: SeqNumber,
+    /// Whether our peer has delivered segments out of order (RACK.reordering_seen).
+    reordering_seen: bool,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Rack {
+    pub fn new(seq_no: SeqNumber) -> Self {
+        Self {
+            xmit_ts: None,
+            end_seq: seq_no,
+            rtt: Duration::ZERO,
+            min_rtt: None,
+            fack: seq_no,
+            reordering_seen: false,
+        }
+    }
+
+    /// Accounts for the delivery, cumulative or selective, of a segment that we last sent at `xmit_ts` and that ends
+    /// at `end_seq` (RFC 8985, sections 6.2 and 6.3).
+    pub fn on_delivered(&mut self, xmit_ts: Instant, end_seq: SeqNumber, retransmitted: bool, now: Instant) {
+        if end_seq > self.fack {
+            self.fack = end_seq;
+        } else if end_seq < self.fack && !retransmitted {
+            self.reordering_seen = true;
+        }
+
+        let rtt: Duration = now.saturating_duration_since(xmit_ts);
+        // An ACK that comes back faster than any round trip can only be for the original transmission of a segment that
+        // we have since retransmitted, which tells us nothing about when the retransmission was delivered.
+        if retransmitted && self.min_rtt.is_some_and(|min_rtt| rtt < min_rtt) {
+            return;
+        }
+        self.min_rtt = Some(self.min_rtt.map_or(rtt, |min_rtt| cmp::min(min_rtt, rtt)));
+        self.rtt = rtt;
+        if self.xmit_ts.map_or(true, |rack_xmit_ts| {
+            Self::sent_after(xmit_ts, end_seq, rack_xmit_ts, self.end_seq)
+        }) {
+            self.xmit_ts = Some(xmit_ts);
+            self.end_seq = end_seq;
+        }
+    }
+
+    /// Computes the reordering window (RFC 8985, section 6.2), which is how long after the delivery of later segments
+    /// we wait for an earlier one. As long as we have not seen reordering, we do not wait once duplicate ACK counting
+    /// would have declared the loss.
+    pub fn reordering_window(&self, dup_threshold_reached: bool, srtt: Option<Duration>) -> Duration {
+        if !self.reordering_seen && dup_threshold_reached {
+            return Duration::ZERO;
+        }
+        let window: Duration = self.min_rtt.unwrap_or(Duration::ZERO) / 4;
+        match srtt {
+            Some(srtt) => cmp::min(window, srtt),
+            None => window,
+        }
+    }
+
+    /// Checks a segment that is neither acknowledged nor already deemed lost, which we last sent at `xmit_ts` and that
+    /// ends at `end_seq` (RFC 8985, section 6.2). Returns `None` if no later segment has been delivered yet, and how
+    /// long until the segment is lost otherwise, which is zero if it is lost already.
+    pub fn time_to_loss(
+        &self,
+        xmit_ts: Instant,
+        end_seq: SeqNumber,
+        reordering_window: Duration,
+        now: Instant,
+    ) -> Option<Duration> {
+        let rack_xmit_ts: Instant = self.xmit_ts?;
+        if !Self::sent_after(rack_xmit_ts, self.end_seq, xmit_ts, end_seq) {
+            return None;
+        }
+        let deadline: Instant = xmit_ts + self.rtt + reordering_window;
+        Some(deadline.saturating_duration_since(now))
+    }
+
+    /// Computes the probe timeout of Tail Loss Probe (RFC 8985, section 7.2), after which we resend the last segment in
+    /// flight so that a loss at the tail of a flight gets detected without waiting for the retransmission timeout.
+    pub fn probe_timeout(srtt: Option<Duration>, single_segment_in_flight: bool) -> Duration {
+        match srtt {
+            Some(srtt) if single_segment_in_flight => srtt * 2 + WORST_CASE_DELAYED_ACK,
+            Some(srtt) => srtt * 2,
+            None => INITIAL_PROBE_TIMEOUT,
+        }
+    }
+
+    /// Checks whether the segment sent at `t1` and ending at `end_seq1` was sent after the one sent at `t2` and ending
+    /// at `end_seq2`. Segments sent at the same time are ordered by their sequence numbers.
+    fn sent_after(t1: Instant, end_seq1: SeqNumber, t2: Instant, end_seq2: SeqNumber) -> bool {
+        t1 > t2 || (t1 == t2 && end_seq1 > end_seq2)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::layer4::tcp::{established::rack::Rack, SeqNumber};
+    use ::anyhow::Result;
+    use ::std::time::{Duration, Instant};
+
+    const MSS: u32 = 1000;
+
+    // Tests that a segment is lost once a later one is delivered and the reordering window has passed.
+    #[test]
+    fn test_rack_detects_loss_after_reordering_window() -> Result<()> {
+        let start: Instant = Instant::now();
+        let rtt: Duration = Duration::from_millis(40);
+        let mut rack: Rack = Rack::new(SeqNumber::from(0));
+
+        // Segments 1 and 2 go out 1 ms apart, and only the second makes it.
+        let first_tx: Instant = start;
+        let second_tx: Instant = start + Duration::from_millis(1);
+        crate::ensure_eq!(
+            rack.time_to_loss(first_tx, SeqNumber::from(MSS), Duration::ZERO, start),
+            None
+        );
+        let now: Instant = second_tx + rtt;
+        rack.on_delivered(second_tx, SeqNumber::from(2 * MSS), false, now);
+
+        // Without reordering and with enough segments acknowledged past it, the first segment is lost right away.
+        let window: Duration = rack.reordering_window(true, Some(rtt));
+        crate::ensure_eq!(window, Duration::ZERO);
+        crate::ensure_eq!(
+            rack.time_to_loss(first_tx, SeqNumber::from(MSS), window, now),
+            Some(Duration::ZERO)
+        );
+
+        // Otherwise, we give it a quarter of the minimum round-trip time.
+        let window: Duration = rack.reordering_window(false, Some(rtt));
+        crate::ensure_eq!(window, rtt / 4);
+        let remaining: Option<Duration> = rack.time_to_loss(first_tx, SeqNumber::from(MSS), window, now);
+        crate::ensure_eq!(remaining, Some(rtt / 4 - Duration::from_millis(1)));
+        crate::ensure_eq!(
+            rack.time_to_loss(first_tx, SeqNumber::from(MSS), window, now + rtt / 4),
+            Some(Duration::ZERO)
+        );
+
+        // The segment that was delivered last is never lost by its own doing.
+        crate::ensure_eq!(
+            rack.time_to_loss(second_tx, SeqNumber::from(2 * MSS), window, now),
+            None
+        );
+
+        Ok(())
+    }
+
+    // Tests that delivering segments out of order keeps the reordering window open, and that ambiguous deliveries of
+    // retransmissions are ignored.
+    #[test]
+    fn test_rack_reordering_and_retransmissions() -> Result<()> {
+        let start: Instant = Instant::now();
+        let rtt: Duration = Duration::from_millis(20);
+        let mut rack: Rack = Rack::new(SeqNumber::from(0));
+
+        let second_tx: Instant = start + Duration::from_millis(1);
+        rack.on_delivered(second_tx, SeqNumber::from(2 * MSS), false, second_tx + rtt);
+        rack.on_delivered(
+            start,
+            SeqNumber::from(MSS),
+            false,
+            start + rtt + Duration::from_millis(2),
+        );
+        crate::ensure_eq!(rack.reordering_window(true, Some(rtt)), rtt / 4);
+
+        // A retransmission that gets acknowledged too fast tells us nothing about the round-trip time.
+        let rtx_time: Instant = start + Duration::from_millis(30);
+        rack.on_delivered(
+            rtx_time,
+            SeqNumber::from(3 * MSS),
+            true,
+            rtx_time + Duration::from_millis(1),
+        );
+        crate::ensure_eq!(
+            rack.time_to_loss(
+                rtx_time - Duration::from_millis(1),
+                SeqNumber::from(4 * MSS),
+                Duration::ZERO,
+                rtx_time
+            ),
+            None
+        );
+
+        // The probe timeout is two round-trip times, and more if our peer may delay its ACK.
+        crate::ensure_eq!(Rack::probe_timeout(Some(rtt), false), rtt * 2);
+        crate::ensure_eq!(
+            Rack::probe_timeout(Some(rtt), true),
+            rtt * 2 + Duration::from_millis(200)
+        );
+
+        Ok(())
+    }
+}
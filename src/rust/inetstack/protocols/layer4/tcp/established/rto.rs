@@ -87,4 +87,13 @@ impl RtoCalculator {
     pub fn rto(&self) -> Duration {
         Duration::from_secs_f64(self.rto)
     }
+
+    /// Gets the smoothed round-trip time, if we have taken any sample yet.
+    pub fn srtt(&self) -> Option<Duration> {
+        if self.received_sample {
+            Some(Duration::from_secs_f64(self.srtt))
+        } else {
+            None
+        }
+    }
 }
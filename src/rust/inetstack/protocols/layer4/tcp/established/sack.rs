@@ -0,0 +1,183 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::inetstack::protocols::layer4::tcp::{
+    header::{SelectiveAcknowlegement, TcpOptions2},
+    SeqNumber,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Largest number of blocks that fit in a SACK option (RFC 2018, section 3).
+pub const MAX_SACK_BLOCKS: usize = 4;
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Builds the SACK option that reports the out-of-order data that we hold (RFC 2018, section 4). `ranges` are the
+/// start and length of each stored segment, sorted by start and not overlapping, and adjacent ones are merged into one
+/// block. The block holding `recent`, the start of the segment that we received last, goes first, followed by the
+/// highest ones, as those are the most likely to be new to our peer. Returns `None` if there is nothing to report.
+pub fn build_sack_option(
+    ranges: impl Iterator<Item = (SeqNumber, u32)>,
+    recent: Option<SeqNumber>,
+) -> Option<TcpOptions2> {
+    // This is only called while we are missing data, so it is off the fast path.
+    let mut blocks: Vec<SelectiveAcknowlegement> = Vec::new();
+    for (start, len) in ranges {
+        let end: SeqNumber = start + SeqNumber::from(len);
+        match blocks.last_mut() {
+            Some(block) if block.end == start => block.end = end,
+            _ => blocks.push(SelectiveAcknowlegement { begin: start, end }),
+        }
+    }
+    if blocks.is_empty() {
+        return None;
+    }
+
+    let first: usize = recent
+        .and_then(|recent| {
+            blocks
+                .iter()
+                .position(|block| block.begin <= recent && recent < block.end)
+        })
+        .unwrap_or(blocks.len() - 1);
+    let mut sacks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [blocks[first]; MAX_SACK_BLOCKS];
+    let mut num_sacks: usize = 1;
+    for (index, block) in blocks.iter().enumerate().rev() {
+        if num_sacks == MAX_SACK_BLOCKS {
+            break;
+        }
+        if index != first {
+            sacks[num_sacks] = *block;
+            num_sacks += 1;
+        }
+    }
+    Some(TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks })
+}
+
+/// Checks whether the blocks of a SACK option cover the whole of the sequence range from `start` to `end`.
+pub fn covers(blocks: &[SelectiveAcknowlegement], start: SeqNumber, end: SeqNumber) -> bool {
+    blocks
+        .iter()
+        .any(|block| block.begin <= start && end <= block.end && block.begin < block.end)
+}
+
+/// Finds where to split a segment from `start` to `end` that the blocks of a SACK option cover only in part, so that the
+/// covered sequence space ends up in segments of its own. We hand segments larger than `mss` to segmentation offload,
+/// which cuts them into `mss`-sized frames from `start` on, and those frames are what our peer acknowledges. Hence we
+/// only split on such a frame boundary. Returns the offset of the first boundary at a block edge, if any.
+pub fn split_offset(blocks: &[SelectiveAcknowlegement], start: SeqNumber, end: SeqNumber, mss: u32) -> Option<u32> {
+    let len: u32 = (end - start).into();
+    blocks
+        .iter()
+        .filter(|block| block.begin < block.end && block.begin < end && start < block.end)
+        .map(|block| {
+            if block.begin > start {
+                // The block starts within the segment, so the frames before its first whole one stay unacknowledged.
+                let offset: u32 = (block.begin - start).into();
+                offset.div_ceil(mss) * mss
+            } else {
+                // The block covers the head of the segment, up to the last whole frame in it.
+                let offset: u32 = (block.end - start).into();
+                offset / mss * mss
+            }
+        })
+        .filter(|offset| *offset > 0 && *offset < len)
+        .min()
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::layer4::tcp::{
+        established::sack::{build_sack_option, covers, split_offset, MAX_SACK_BLOCKS},
+        header::{SelectiveAcknowlegement, TcpOptions2},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+
+    fn block(begin: u32, end: u32) -> SelectiveAcknowlegement {
+        SelectiveAcknowlegement {
+            begin: SeqNumber::from(begin),
+            end: SeqNumber::from(end),
+        }
+    }
+
+    // Tests that adjacent segments make up one block, and that the block of the last segment received goes first.
+    #[test]
+    fn test_build_sack_option() -> Result<()> {
+        let ranges: Vec<(SeqNumber, u32)> = [
+            (1000, 500),
+            (1500, 500),
+            (3000, 100),
+            (4000, 100),
+            (5000, 100),
+            (6000, 1),
+        ]
+        .iter()
+        .map(|(start, len)| (SeqNumber::from(*start), *len))
+        .collect();
+
+        let (num_sacks, sacks): (usize, [SelectiveAcknowlegement; MAX_SACK_BLOCKS]) =
+            match build_sack_option(ranges.iter().cloned(), Some(SeqNumber::from(1500))) {
+                Some(TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks }) => (num_sacks, sacks),
+                option => anyhow::bail!("unexpected option: {:?}", option),
+            };
+        crate::ensure_eq!(num_sacks, MAX_SACK_BLOCKS);
+        crate::ensure_eq!(sacks[0], block(1000, 2000));
+        crate::ensure_eq!(sacks[1], block(6000, 6001));
+        crate::ensure_eq!(sacks[2], block(5000, 5100));
+        crate::ensure_eq!(sacks[3], block(4000, 4100));
+
+        crate::ensure_eq!(build_sack_option(ranges[..0].iter().cloned(), None), None);
+
+        Ok(())
+    }
+
+    // Tests that only whole segments count as selectively acknowledged, across the wrap of the sequence space.
+    #[test]
+    fn test_sack_covers() -> Result<()> {
+        let blocks: [SelectiveAcknowlegement; 2] = [block(u32::MAX - 99, 100), block(1000, 2000)];
+        crate::ensure_eq!(
+            covers(&blocks, SeqNumber::from(u32::MAX - 99), SeqNumber::from(0)),
+            true
+        );
+        crate::ensure_eq!(covers(&blocks, SeqNumber::from(0), SeqNumber::from(100)), true);
+        crate::ensure_eq!(covers(&blocks, SeqNumber::from(50), SeqNumber::from(150)), false);
+        crate::ensure_eq!(covers(&blocks, SeqNumber::from(1500), SeqNumber::from(2000)), true);
+        crate::ensure_eq!(covers(&blocks, SeqNumber::from(2000), SeqNumber::from(2100)), false);
+
+        Ok(())
+    }
+
+    // Tests that a segment that the blocks cover in part splits on the first frame boundary at a block edge.
+    #[test]
+    fn test_sack_split_offset() -> Result<()> {
+        const MSS: u32 = 1000;
+        let blocks: [SelectiveAcknowlegement; 2] = [block(2500, 5000), block(7000, 9000)];
+        let split = |start: u32, end: u32| split_offset(&blocks, SeqNumber::from(start), SeqNumber::from(end), MSS);
+
+        // The frame that holds the start of a block is only covered in part.
+        crate::ensure_eq!(split(0, 10000), Some(3000));
+        // The block covers the head of the segment.
+        crate::ensure_eq!(split(3000, 10000), Some(2000));
+        crate::ensure_eq!(split(7000, 10000), Some(2000));
+        // Blocks that cover the whole segment, or none of it, or no whole frame of it, leave it as it is.
+        crate::ensure_eq!(split(3000, 5000), None);
+        crate::ensure_eq!(split(5000, 7000), None);
+        crate::ensure_eq!(split(2000, 3000), None);
+
+        Ok(())
+    }
+}
@@ -2,13 +2,18 @@
 // Licensed under the MIT license.
 
 use crate::{
-    collections::{async_queue::SharedAsyncQueue, async_value::SharedAsyncValue},
+    collections::{
+        async_queue::SharedAsyncQueue,
+        async_value::{AsyncValue, SharedAsyncValue},
+    },
     inetstack::protocols::layer4::tcp::{
-        established::{rto::RtoCalculator, SharedControlBlock},
-        header::TcpHeader,
+        constants::MAX_SEGMENTATION_OFFLOAD_SIZE,
+        established::{rack::Rack, rto::RtoCalculator, sack, SharedControlBlock},
+        header::{SelectiveAcknowlegement, TcpHeader, TcpOptions2},
         SeqNumber,
     },
-    runtime::{conditional_yield_until, fail::Fail, memory::DemiBuffer},
+    perftools::stats,
+    runtime::{conditional_yield_until, fail::Fail, memory::DemiBuffer, yield_until},
 };
 use ::futures::{pin_mut, select_biased, FutureExt};
 use ::libc::{EBUSY, EINVAL};
@@ -27,6 +32,47 @@ pub struct UnackedSegment {
     pub bytes: Option<DemiBuffer>,
     // Set to `None` on retransmission to implement Karn's algorithm.
     pub initial_tx: Option<Instant>,
+    // Time of the latest (re)transmission, by which RACK orders segments.
+    pub last_tx: Instant,
+    // Whether our peer has told us through SACK that it holds this segment.
+    pub sacked: bool,
+    // Whether RACK deems this segment lost and it awaits retransmission.
+    pub lost: bool,
+}
+
+impl UnackedSegment {
+    fn new(bytes: Option<DemiBuffer>, now: Instant) -> Self {
+        Self {
+            bytes,
+            initial_tx: Some(now),
+            last_tx: now,
+            sacked: false,
+            lost: false,
+        }
+    }
+
+    // Gets the amount of sequence space that this segment takes up. A FIN takes up one sequence number.
+    fn len(&self) -> u32 {
+        self.bytes.as_ref().map_or(1, |bytes| bytes.len() as u32)
+    }
+
+    // Cuts off the data of this segment past `offset` into a segment of its own, which has the same transmission
+    // history.
+    fn split_back(&mut self, offset: u32) -> Self {
+        let bytes: DemiBuffer = self
+            .bytes
+            .as_mut()
+            .expect("only data segments can be split")
+            .split_back(offset as usize)
+            .expect("should be able to split within the length of the segment");
+        Self {
+            bytes: Some(bytes),
+            initial_tx: self.initial_tx,
+            last_tx: self.last_tx,
+            sacked: self.sacked,
+            lost: self.lost,
+        }
+    }
 }
 
 // Hard limit for unsent queue.
@@ -34,13 +80,9 @@ pub struct UnackedSegment {
 // not segments) and rejecting send requests that exceed that, or by limiting the user's send buffer allocations.
 const UNSENT_QUEUE_CUTOFF: usize = 1024;
 
-// Minimum size for unacknowledged queue. This number doesn't really matter very much, it just sets the initial size
-// of the unacked queue, below which memory allocation is not required.
-const MIN_UNACKED_QUEUE_SIZE_FRAMES: usize = 64;
-
-// Minimum size for unsent queue. This number doesn't really matter very much, it just sets the initial size
-// of the unacked queue, below which memory allocation is not required.
-const MIN_UNSENT_QUEUE_SIZE_FRAMES: usize = 64;
+// Number of segments past a hole that our peer must have selectively acknowledged before we stop allowing for reordering
+// (DupThresh in RFC 6675).
+const DUP_THRESHOLD: u32 = 3;
 
 // TODO: Consider moving retransmit timer and congestion control fields out of this structure.
 // TODO: Make all public fields in this structure private.
@@ -61,7 +103,8 @@ pub struct Sender {
     // Sequence Number of the oldest byte of unacknowledged sent data.  In RFC 793 terms, this is SND.UNA.
     send_unacked: SharedAsyncValue<SeqNumber>,
 
-    // Queue of unacknowledged sent data.  RFC 793 calls this the "retransmission queue".
+    // Queue of unacknowledged sent data.  RFC 793 calls this the "retransmission queue". Like the unsent queue, it
+    // only allocates once we send data, so that idle connections do not hold any send memory.
     unacked_queue: SharedAsyncQueue<UnackedSegment>,
 
     // Send timers
@@ -72,8 +115,8 @@ pub struct Sender {
     // Retransmission Timeout (RTO) calculator.
     rto_calculator: RtoCalculator,
 
-    // In RFC 793 terms, this is SND.NXT.
-    send_next_seq_no: SharedAsyncValue<SeqNumber>,
+    // In RFC 793 terms, this is SND.NXT. Only the sender waits on it, so it lives inline.
+    send_next_seq_no: AsyncValue<SeqNumber>,
 
     // Sequence number of next data to be pushed but not sent. When there is an open window, this is equivalent to
     // send_next_seq_no.
@@ -97,36 +140,89 @@ pub struct Sender {
     // Maximum Segment Size currently in use for this connection.
     // TODO: Revisit this once we support path MTU discovery.
     mss: usize,
+
+    // Largest payload that we put in a single segment. This is a multiple of the MSS when the layers below cut large
+    // segments into MSS-sized ones, and the MSS otherwise.
+    max_send_size: usize,
+
+    // Earliest time at which we may send new data, when congestion control paces sends.
+    pacing_next_send_time: Option<Instant>,
+
+    // Whether both ends agreed to use selective acknowledgements (RFC 2018) on this connection. If so, we keep a
+    // scoreboard of the segments that our peer holds in the unacknowledged queue, and detect losses with RACK-TLP.
+    sack_enabled: bool,
+
+    // Number of bytes on the unacknowledged queue that our peer has selectively acknowledged.
+    sacked_bytes: u32,
+
+    // Number of bytes on the unacknowledged queue that we deem lost and have yet to retransmit.
+    lost_bytes: u32,
+
+    // RACK loss detection state (RFC 8985).
+    rack: Rack,
+
+    // When RACK gives up waiting for segments that may merely be reordered. This and the loss probe share the recovery
+    // timer below.
+    reorder_deadline: Option<Instant>,
+
+    // SND.NXT when we sent the last tail loss probe, until an ACK covers it (TLP.end_seq in RFC 8985).
+    tlp_end_seq: Option<SeqNumber>,
+
+    // Expiration time of the RACK reordering timer or of the tail loss probe timer, whichever is armed. This always
+    // fires before the retransmission timer.
+    recovery_deadline: SharedAsyncValue<Option<Instant>>,
 }
 
 impl fmt::Debug for Sender {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         f.debug_struct("Sender")
             .field("send_unacked", &self.send_unacked)
-            .field("send_next", &self.send_next_seq_no)
+            .field("send_next", &self.send_next_seq_no.get())
             .field("send_window", &self.send_window)
             .field("window_scale", &self.send_window_scale_shift_bits)
             .field("mss", &self.mss)
+            .field("max_send_size", &self.max_send_size)
             .finish()
     }
 }
 
 impl Sender {
-    pub fn new(seq_no: SeqNumber, send_window: u32, send_window_scale_shift_bits: u8, mss: usize) -> Self {
+    pub fn new(
+        seq_no: SeqNumber,
+        send_window: u32,
+        send_window_scale_shift_bits: u8,
+        mss: usize,
+        segmentation_offload: bool,
+        sack_enabled: bool,
+    ) -> Self {
+        let max_send_size: usize = if segmentation_offload {
+            cmp::max(mss, MAX_SEGMENTATION_OFFLOAD_SIZE / mss * mss)
+        } else {
+            mss
+        };
         Self {
             send_unacked: SharedAsyncValue::new(seq_no),
-            unacked_queue: SharedAsyncQueue::with_capacity(MIN_UNACKED_QUEUE_SIZE_FRAMES),
+            unacked_queue: SharedAsyncQueue::default(),
             retransmit_deadline_time_secs: SharedAsyncValue::new(None),
             rto_calculator: RtoCalculator::new(),
-            send_next_seq_no: SharedAsyncValue::new(seq_no),
+            send_next_seq_no: AsyncValue::new(seq_no),
             unsent_next_seq_no: seq_no,
             fin_seq_no: None,
-            unsent_queue: SharedAsyncQueue::with_capacity(MIN_UNSENT_QUEUE_SIZE_FRAMES),
+            unsent_queue: SharedAsyncQueue::default(),
             send_window: SharedAsyncValue::new(send_window),
             send_window_last_update_seq: seq_no,
             send_window_last_update_ack: seq_no,
             send_window_scale_shift_bits,
             mss,
+            max_send_size,
+            pacing_next_send_time: None,
+            sack_enabled,
+            sacked_bytes: 0,
+            lost_bytes: 0,
+            rack: Rack::new(seq_no),
+            reorder_deadline: None,
+            tlp_end_seq: None,
+            recovery_deadline: SharedAsyncValue::new(None),
         }
     }
 
@@ -142,7 +238,7 @@ impl Sender {
         // Review: Move this check up the stack (i.e. closer to the user)?
         //
         let _: u32 = buf
-            .len()
+            .chain_len()
             .try_into()
             .map_err(|_| Fail::new(EINVAL, "buffer too large"))?;
 
@@ -151,9 +247,16 @@ impl Sender {
             return Err(Fail::new(EBUSY, "too many packets to send"));
         }
 
-        // Place the buffer in the unsent queue.
-        self.unsent_next_seq_no = self.unsent_next_seq_no + (buf.len() as u32).into();
-        self.unsent_queue.push(Some(buf));
+        // Place the buffer in the unsent queue. The background sender sends one segment at a time, so a chain goes in
+        // segment by segment and the whole of it is acknowledged as a single push.
+        let mut next: Option<DemiBuffer> = Some(buf);
+        while let Some(mut segment) = next {
+            next = segment.detach_tail();
+            if segment.len() > 0 {
+                self.unsent_next_seq_no = self.unsent_next_seq_no + (segment.len() as u32).into();
+                self.unsent_queue.push(Some(segment));
+            }
+        }
 
         // Wait until the sequnce number of the pushed buffer is acknowledged.
         let mut send_unacked_watched: SharedAsyncValue<SeqNumber> = self.send_unacked.clone();
@@ -208,10 +311,7 @@ impl Sender {
         self.send_next_seq_no.modify(|s| s + 1.into());
 
         // Add the FIN to our unacknowledged queue.
-        let unacked_segment = UnackedSegment {
-            bytes: None,
-            initial_tx: Some(cb.get_now()),
-        };
+        let unacked_segment = UnackedSegment::new(None, cb.get_now());
         self.unacked_queue.push(unacked_segment);
         // Set the retransmit timer.
         if self.retransmit_deadline_time_secs.get().is_none() {
@@ -241,6 +341,14 @@ impl Sender {
                 // TODO: Nagle's algorithm - We need to coalese small buffers together to send MSS sized packets.
                 // TODO: Silly window syndrome - See RFC 1122's discussion of the SWS avoidance algorithm.
 
+                // If congestion control paces sends, wait for our turn.
+                if let Some(deadline) = self.pacing_next_send_time {
+                    if deadline > cb.get_now() {
+                        yield_until(deadline).await;
+                        continue;
+                    }
+                }
+
                 // We have some window, try to send some or all of the segment.
                 let _: usize = self.send_segment(&mut buffer, cb);
                 // If the buffer is now empty, then we sent all of it.
@@ -265,10 +373,7 @@ impl Sender {
         self.send_next_seq_no.modify(|s| s + SeqNumber::from(1));
 
         // Add the probe byte (as a new separate buffer) to our unacknowledged queue.
-        let unacked_segment = UnackedSegment {
-            bytes: Some(probe.clone()),
-            initial_tx: Some(cb.get_now()),
-        };
+        let unacked_segment = UnackedSegment::new(Some(probe.clone()), cb.get_now());
         self.unacked_queue.push(unacked_segment);
 
         // Note that we loop here *forever*, exponentially backing off.
@@ -301,6 +406,13 @@ impl Sender {
             0 => return 0,
             size => size,
         };
+        // When pacing, send about a millisecond worth of data at a time, so that segmentation offload does not turn
+        // into bursts.
+        let pacing_rate: Option<u64> = cb.congestion_control_get_pacing_rate().filter(|rate| *rate > 0);
+        let max_frame_size_bytes: usize = match pacing_rate {
+            Some(rate) => cmp::min(max_frame_size_bytes, cmp::max(self.mss, (rate / 1000) as usize)),
+            None => max_frame_size_bytes,
+        };
 
         // Split the packet if necessary.
         // TODO: Use a scatter/gather array to coalesce multiple buffers into a single segment.
@@ -328,16 +440,18 @@ impl Sender {
         if do_push {
             header.psh = true;
         }
-        cb.emit(header, Some(segment_data.clone()));
+        cb.emit_data(header, segment_data.clone(), self.mss);
 
         // Update SND.NXT.
         self.send_next_seq_no.modify(|s| s + SeqNumber::from(segment_data_len));
 
+        // Space out the next send by the time that this one takes at the pacing rate.
+        self.pacing_next_send_time = pacing_rate.map(|rate| {
+            cb.get_now() + Duration::from_nanos((segment_data_len as u128 * 1_000_000_000 / rate as u128) as u64)
+        });
+
         // Put this segment on the unacknowledged list.
-        let unacked_segment = UnackedSegment {
-            bytes: Some(segment_data),
-            initial_tx: Some(cb.get_now()),
-        };
+        let unacked_segment = UnackedSegment::new(Some(segment_data), cb.get_now());
         self.unacked_queue.push(unacked_segment);
 
         // Set the retransmit timer.
@@ -345,6 +459,8 @@ impl Sender {
             let rto: Duration = self.rto_calculator.rto();
             self.retransmit_deadline_time_secs.set(Some(cb.get_now() + rto));
         }
+        // RFC 8985, section 7.2: Restart the loss probe timer after sending new data.
+        self.arm_recovery_timer(cb.get_now());
         segment_data_len as usize
     }
 
@@ -364,7 +480,7 @@ impl Sender {
         let win_sz: u32 = self.send_window.get();
 
         if Self::has_open_window(win_sz, sent_data, effective_cwnd) {
-            Self::calculate_open_window_bytes(win_sz, sent_data, self.mss, effective_cwnd)
+            Self::calculate_open_window_bytes(win_sz, sent_data, self.max_send_size, effective_cwnd)
         } else {
             0
         }
@@ -374,9 +490,9 @@ impl Sender {
         win_sz > 0 && win_sz >= sent_data && effective_cwnd >= sent_data
     }
 
-    fn calculate_open_window_bytes(win_sz: u32, sent_data: u32, mss: usize, effective_cwnd: u32) -> usize {
+    fn calculate_open_window_bytes(win_sz: u32, sent_data: u32, max_send_size: usize, effective_cwnd: u32) -> usize {
         cmp::min(
-            cmp::min((win_sz - sent_data) as usize, mss),
+            cmp::min((win_sz - sent_data) as usize, max_send_size),
             (effective_cwnd - sent_data) as usize,
         )
     }
@@ -386,6 +502,8 @@ impl Sender {
         let mut rtx_deadline_watched: SharedAsyncValue<Option<Instant>> = self.retransmit_deadline_time_secs.clone();
         // Watch the fast retransmit flag.
         let mut rtx_fast_retransmit_watched: SharedAsyncValue<bool> = cb.congestion_control_watch_retransmit_now_flag();
+        // Watch the RACK reordering and tail loss probe deadline.
+        let mut recovery_deadline_watched: SharedAsyncValue<Option<Instant>> = self.recovery_deadline.clone();
         loop {
             let rtx_deadline: Option<Instant> = rtx_deadline_watched.get();
             let rtx_fast_retransmit: bool = rtx_fast_retransmit_watched.get();
@@ -393,8 +511,20 @@ impl Sender {
                 // Notify congestion control about fast retransmit.
                 cb.congestion_control_on_fast_retransmit();
 
-                // Retransmit earliest unacknowledged segment.
-                self.retransmit(&mut cb);
+                if self.sack_enabled {
+                    // RACK has already found out which segments are missing, so only retransmit those.
+                    self.retransmit_lost(&mut cb);
+                } else {
+                    // Retransmit earliest unacknowledged segment.
+                    self.retransmit(&mut cb);
+                }
+                continue;
+            }
+
+            // The recovery timer always fires before the retransmission timer, so give it precedence.
+            let recovery_deadline: Option<Instant> = recovery_deadline_watched.get();
+            if let Some(deadline) = recovery_deadline.filter(|deadline| *deadline <= cb.get_now()) {
+                self.on_recovery_timeout(deadline, &mut cb);
                 continue;
             }
 
@@ -403,19 +533,36 @@ impl Sender {
                 select_biased!(
                     _ = rtx_deadline_watched.wait_for_change(None).fuse() => (),
                     _ = rtx_fast_retransmit_watched.wait_for_change(None).fuse() => (),
+                    _ = recovery_deadline_watched.wait_for_change(None).fuse() => (),
                 )
             };
             pin_mut!(something_changed);
-            match conditional_yield_until(something_changed, rtx_deadline).await {
+            let deadline: Option<Instant> = match (recovery_deadline, rtx_deadline) {
+                (Some(recovery_deadline), Some(rtx_deadline)) => Some(cmp::min(recovery_deadline, rtx_deadline)),
+                (recovery_deadline, rtx_deadline) => recovery_deadline.or(rtx_deadline),
+            };
+            match conditional_yield_until(something_changed, deadline).await {
                 Ok(()) => match self.fin_seq_no {
                     Some(fin_seq_no) if self.send_unacked.get() > fin_seq_no => {
                         return Err(Fail::new(libc::ECONNRESET, "connection closed"));
                     },
                     _ => continue,
                 },
+                // The recovery timer expired, which we handle on the next iteration.
+                Err(Fail { errno, cause: _ })
+                    if errno == libc::ETIMEDOUT && recovery_deadline.is_some_and(|d| d <= cb.get_now()) =>
+                {
+                    continue
+                },
                 Err(Fail { errno, cause: _ }) if errno == libc::ETIMEDOUT => {
                     // Retransmit timeout.
                     trace!("retransmit wake");
+                    stats::record_tcp_rto();
+                    // Neither RACK nor the loss probe could repair the loss, so start from scratch.
+                    self.reorder_deadline = None;
+                    self.tlp_end_seq = None;
+                    self.recovery_deadline.set(None);
+
                     // Notify congestion control about RTO.
                     // TODO: Is this the best place for this?
                     // TODO: Why call into ControlBlock to get SND.UNA when congestion_control_on_rto() has access to it?
@@ -448,6 +595,11 @@ impl Sender {
                 // tell if the ACK is for the original or the retransmission).  Remove the transmission timestamp from
                 // the entry.
                 segment.initial_tx.take();
+                segment.last_tx = cb.get_now();
+                if segment.lost {
+                    segment.lost = false;
+                    self.lost_bytes -= segment.len();
+                }
 
                 // Clone the segment data for retransmission.
                 let data: Option<DemiBuffer> = segment.bytes.as_ref().map(|b| b.clone());
@@ -463,17 +615,211 @@ impl Sender {
                 } else {
                     header.fin = true;
                 }
-                cb.emit(header, data);
+                cb.emit_segmented(header, data, self.mss);
+                stats::record_tcp_retransmits(1);
             },
             None => (),
         }
     }
 
-    // Process an ack.
-    pub fn process_ack(&mut self, header: &TcpHeader, now: Instant) {
+    /// Retransmits the segments that RACK deems lost, oldest first. We send at least one of them and keep going while
+    /// the bytes in flight stay within the congestion window (in the manner of the pipe of RFC 6675, section 4).
+    pub fn retransmit_lost(&mut self, cb: &mut SharedControlBlock) {
+        if self.lost_bytes == 0 {
+            return;
+        }
+        let now: Instant = cb.get_now();
+        let cwnd: u32 =
+            cb.congestion_control_get_cwnd().get() + cb.congestion_control_get_limited_transmit_cwnd_increase().get();
+        let mss: usize = self.mss;
+        self.take_lost_segments(cwnd, now, |seq_no: SeqNumber, data: Option<DemiBuffer>| {
+            let mut header: TcpHeader = cb.tcp_header();
+            header.seq_num = seq_no;
+            // If data exists, then this is a regular packet, otherwise, its a FIN.
+            if data.is_some() {
+                header.psh = true;
+            } else {
+                header.fin = true;
+            }
+            cb.emit_segmented(header, data, mss);
+            stats::record_tcp_retransmits(1);
+        });
+    }
+
+    // Takes the segments that RACK deems lost off the scoreboard for retransmission, as many as `cwnd` lets us send,
+    // and hands each of them to `retransmit` along with its sequence number.
+    fn take_lost_segments<F: FnMut(SeqNumber, Option<DemiBuffer>)>(
+        &mut self,
+        cwnd: u32,
+        now: Instant,
+        mut retransmit: F,
+    ) {
+        let outstanding: u32 = (self.send_next_seq_no.get() - self.send_unacked.get()).into();
+        let mut pipe: u32 = outstanding - self.sacked_bytes - self.lost_bytes;
+        let mut seq_no: SeqNumber = self.send_unacked.get();
+        let mut retransmitted: bool = false;
+        for segment in self.unacked_queue.get_mut_values() {
+            let len: u32 = segment.len();
+            if segment.lost {
+                if retransmitted && pipe + len > cwnd {
+                    break;
+                }
+                retransmitted = true;
+                segment.lost = false;
+                segment.initial_tx.take();
+                segment.last_tx = now;
+                self.lost_bytes -= len;
+                pipe += len;
+                retransmit(seq_no, segment.bytes.clone());
+            }
+            seq_no = seq_no + SeqNumber::from(len);
+        }
+    }
+
+    // Handles the expiration of the recovery timer, which was armed for either the RACK reordering window or a tail loss
+    // probe.
+    fn on_recovery_timeout(&mut self, deadline: Instant, cb: &mut SharedControlBlock) {
+        let now: Instant = cb.get_now();
+        self.recovery_deadline.set_without_notify(None);
+        if self
+            .reorder_deadline
+            .is_some_and(|reorder_deadline| reorder_deadline <= deadline)
+        {
+            // RFC 8985, section 6.3: The segments that we waited for are lost by now.
+            self.reorder_deadline = None;
+            self.detect_loss(now);
+            self.retransmit_lost(cb);
+        } else {
+            self.send_loss_probe(cb);
+        }
+        self.arm_recovery_timer(now);
+    }
+
+    // Sends a tail loss probe (RFC 8985, section 7.3). We retransmit the last segment in flight, so that its ACK reveals
+    // through SACK whatever went missing before it. RFC 8985 prefers to send new data for this, which we would have sent
+    // already if the window allowed it.
+    fn send_loss_probe(&mut self, cb: &mut SharedControlBlock) {
+        let now: Instant = cb.get_now();
+        let send_next: SeqNumber = self.send_next_seq_no.get();
+        if let Some(segment) = self.unacked_queue.get_mut_values().last() {
+            segment.initial_tx.take();
+            segment.last_tx = now;
+
+            let mut header: TcpHeader = cb.tcp_header();
+            header.seq_num = send_next - SeqNumber::from(segment.len());
+            // If data exists, then this is a regular packet, otherwise, its a FIN.
+            if segment.bytes.is_some() {
+                header.psh = true;
+            } else {
+                header.fin = true;
+            }
+            cb.emit_segmented(header, segment.bytes.clone(), self.mss);
+            stats::record_tcp_retransmits(1);
+
+            // RFC 8985, section 7.3: Make sure that the retransmission timer fires one RTO after the probe.
+            self.tlp_end_seq = Some(send_next);
+            self.retransmit_deadline_time_secs
+                .set(Some(now + self.rto_calculator.rto()));
+        }
+    }
+
+    // Arms the recovery timer (RFC 8985, sections 6.3 and 7.2). The RACK reordering timer takes precedence. Otherwise, we
+    // arm a tail loss probe, unless one is in flight already or we are repairing losses, and only if it would fire
+    // before the retransmission timer does.
+    fn arm_recovery_timer(&mut self, now: Instant) {
+        if !self.sack_enabled {
+            return;
+        }
+        let deadline: Option<Instant> = match self.reorder_deadline {
+            Some(reorder_deadline) => Some(reorder_deadline),
+            None if self.tlp_end_seq.is_none() && self.sacked_bytes == 0 && !self.unacked_queue.is_empty() => {
+                let pto: Duration = Rack::probe_timeout(self.rto_calculator.srtt(), self.unacked_queue.len() == 1);
+                Some(now + pto).filter(|deadline| {
+                    self.retransmit_deadline_time_secs
+                        .get()
+                        .map_or(true, |rtx_deadline| *deadline < rtx_deadline)
+                })
+            },
+            None => None,
+        };
+        if deadline != self.recovery_deadline.get() {
+            self.recovery_deadline.set(deadline);
+        }
+    }
+
+    // Updates the scoreboard with the SACK blocks of an ACK, and feeds the segments that they newly cover to RACK.
+    // Segments that we sent through segmentation offload span many frames, of which our peer may hold only some. We
+    // split those at the block edges, so that the scoreboard credits the frames that arrived and we retransmit only the
+    // ones that did not.
+    fn process_sack_blocks(&mut self, header: &TcpHeader, now: Instant) {
+        let mss: u32 = self.mss as u32;
+        for option in header.iter_options() {
+            if let TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks } = option {
+                let blocks: &[SelectiveAcknowlegement] = &sacks[..cmp::min(*num_sacks, sacks.len())];
+                let mut seq_no: SeqNumber = self.send_unacked.get();
+                let mut index: usize = 0;
+                while let Some(segment) = self.unacked_queue.get_mut(index) {
+                    let len: u32 = segment.len();
+                    let end_seq: SeqNumber = seq_no + SeqNumber::from(len);
+                    if !segment.sacked && segment.bytes.is_some() {
+                        if let Some(offset) = sack::split_offset(blocks, seq_no, end_seq, mss) {
+                            // The head now ends at the first block edge, so we look at it again.
+                            let tail: UnackedSegment = segment.split_back(offset);
+                            self.unacked_queue.insert(index + 1, tail);
+                            continue;
+                        }
+                    }
+                    if !segment.sacked && sack::covers(blocks, seq_no, end_seq) {
+                        segment.sacked = true;
+                        self.sacked_bytes += len;
+                        if segment.lost {
+                            segment.lost = false;
+                            self.lost_bytes -= len;
+                        }
+                        self.rack
+                            .on_delivered(segment.last_tx, end_seq, segment.initial_tx.is_none(), now);
+                    }
+                    seq_no = end_seq;
+                    index += 1;
+                }
+            }
+        }
+    }
+
+    // Marks the segments that RACK deems lost (RFC 8985, section 6.2), and the reordering timer for those that it may
+    // deem lost later.
+    fn detect_loss(&mut self, now: Instant) {
+        let dup_threshold_reached: bool = self.sacked_bytes >= DUP_THRESHOLD * self.mss as u32;
+        let reordering_window: Duration = self
+            .rack
+            .reordering_window(dup_threshold_reached, self.rto_calculator.srtt());
+        let mut timeout: Option<Duration> = None;
+        let mut seq_no: SeqNumber = self.send_unacked.get();
+        for segment in self.unacked_queue.get_mut_values() {
+            let len: u32 = segment.len();
+            seq_no = seq_no + SeqNumber::from(len);
+            if segment.sacked || segment.lost {
+                continue;
+            }
+            match self.rack.time_to_loss(segment.last_tx, seq_no, reordering_window, now) {
+                Some(remaining) if remaining.is_zero() => {
+                    segment.lost = true;
+                    self.lost_bytes += len;
+                },
+                Some(remaining) => timeout = Some(timeout.map_or(remaining, |timeout| cmp::max(timeout, remaining))),
+                None => (),
+            }
+        }
+        self.reorder_deadline = timeout.map(|timeout| now + timeout);
+    }
+
+    // Process an ack. Returns the round-trip time measured on the newest segment that it acknowledges, if that was not
+    // retransmitted.
+    pub fn process_ack(&mut self, header: &TcpHeader, now: Instant) -> Option<Duration> {
         // Start by checking that the ACK acknowledges something new.
         // TODO: Look into removing Watched types.
         let send_unacknowledged: SeqNumber = self.send_unacked.get();
+        let mut rtt_sample: Option<Duration> = None;
 
         if send_unacknowledged < header.ack_num {
             // Remove the now acknowledged data from the unacknowledged queue, update the acked sequence number
@@ -483,11 +829,21 @@ impl Sender {
             let bytes_acknowledged: u32 = (header.ack_num - self.send_unacked.get()).into();
             // Convert that into a usize for counting bytes to remove from the unacked queue.
             let mut bytes_remaining: usize = bytes_acknowledged as usize;
+            let mut seq_no: SeqNumber = send_unacknowledged;
             // Remove bytes from the unacked queue.
             while bytes_remaining != 0 {
-                bytes_remaining = match self.unacked_queue.try_pop() {
+                let segment: Option<UnackedSegment> = self.unacked_queue.try_pop();
+                if let Some(segment) = segment.as_ref() {
+                    seq_no = self.forget_acked_segment(segment, seq_no, header.ack_num, now);
+                }
+                bytes_remaining = match segment {
                     Some(segment) if segment.bytes.is_none() => self.process_acked_fin(bytes_remaining, header.ack_num),
-                    Some(segment) => self.process_acked_segment(bytes_remaining, segment, now),
+                    Some(segment) => {
+                        let (bytes_remaining, sample): (usize, Option<Duration>) =
+                            self.process_acked_segment(bytes_remaining, segment, now);
+                        rtt_sample = sample.or(rtt_sample);
+                        bytes_remaining
+                    },
                     None => {
                         unreachable!("There should be enough data in the unacked_queue for the number of bytes acked")
                     }, // Shouldn't have bytes_remaining with no segments remaining in unacked_queue.
@@ -496,6 +852,12 @@ impl Sender {
 
             // Update SND.UNA to SEG.ACK.
             self.send_unacked.set(header.ack_num);
+            if self
+                .tlp_end_seq
+                .is_some_and(|tlp_end_seq| tlp_end_seq <= header.ack_num)
+            {
+                self.tlp_end_seq = None;
+            }
 
             // Check and update send window if necessary.
             self.update_send_window(header);
@@ -513,6 +875,41 @@ impl Sender {
             // TODO: Implement fast-retransmit.  In which case, we'd increment our dup-ack counter here.
             warn!("process_ack(): received duplicate ack ({:?})", header.ack_num);
         }
+
+        // Find out from the SACK blocks which segments our peer holds, and from that which ones are lost. The caller
+        // retransmits those, as that needs congestion control to have seen this ACK first.
+        if self.sack_enabled {
+            self.process_sack_blocks(header, now);
+            if self.sacked_bytes > 0 || self.reorder_deadline.is_some() {
+                self.detect_loss(now);
+            }
+            self.arm_recovery_timer(now);
+        }
+        rtt_sample
+    }
+
+    // Takes a segment starting at `seq_no` that an ACK up to `ack_num` removed from the unacknowledged queue off the
+    // scoreboard, and feeds its delivery to RACK. Returns the sequence number that follows the segment.
+    fn forget_acked_segment(
+        &mut self,
+        segment: &UnackedSegment,
+        seq_no: SeqNumber,
+        ack_num: SeqNumber,
+        now: Instant,
+    ) -> SeqNumber {
+        let len: u32 = segment.len();
+        if segment.sacked {
+            self.sacked_bytes -= len;
+        } else if self.sack_enabled {
+            let end_seq: SeqNumber = seq_no + SeqNumber::from(len);
+            let delivered_end_seq: SeqNumber = if end_seq > ack_num { ack_num } else { end_seq };
+            self.rack
+                .on_delivered(segment.last_tx, delivered_end_seq, segment.initial_tx.is_none(), now);
+        }
+        if segment.lost {
+            self.lost_bytes -= len;
+        }
+        seq_no + SeqNumber::from(len)
     }
 
     fn process_acked_fin(&mut self, bytes_remaining: usize, ack_num: SeqNumber) -> usize {
@@ -530,12 +927,19 @@ impl Sender {
         0
     }
 
-    fn process_acked_segment(&mut self, bytes_remaining: usize, mut segment: UnackedSegment, now: Instant) -> usize {
+    // Returns the number of acknowledged bytes that remain past this segment, and the round-trip time sample it gave.
+    fn process_acked_segment(
+        &mut self,
+        bytes_remaining: usize,
+        mut segment: UnackedSegment,
+        now: Instant,
+    ) -> (usize, Option<Duration>) {
         // Add sample for RTO if we have an initial transmit time.
         // Note that in the case of repacketization, an ack for the first byte is enough for the time sample because it still represents the RTO for that single byte.
         // TODO: TCP timestamp support.
-        if let Some(initial_tx) = segment.initial_tx {
-            self.rto_calculator.add_sample(now - initial_tx);
+        let rtt_sample: Option<Duration> = segment.initial_tx.map(|initial_tx| now - initial_tx);
+        if let Some(rtt_sample) = rtt_sample {
+            self.rto_calculator.add_sample(rtt_sample);
         }
 
         let mut data: DemiBuffer = segment
@@ -550,25 +954,32 @@ impl Sender {
                         .expect("Should be able to split back because we just checked the length"),
                 ),
                 initial_tx: None,
+                last_tx: segment.last_tx,
+                sacked: segment.sacked,
+                lost: segment.lost,
             };
+            // The rest of the segment stays on the scoreboard.
+            if unacked_segment.sacked {
+                self.sacked_bytes += unacked_segment.len();
+            }
+            if unacked_segment.lost {
+                self.lost_bytes += unacked_segment.len();
+            }
             // Leave this segment on the unacknowledged queue.
             self.unacked_queue.push_front(unacked_segment);
-            0
+            (0, rtt_sample)
         } else {
-            bytes_remaining - data.len()
+            (bytes_remaining - data.len(), rtt_sample)
         }
     }
 
     fn update_retransmit_deadline(&self, now: Instant) -> Option<Instant> {
         match self.unacked_queue.get_front() {
             Some(UnackedSegment {
-                bytes: _,
                 initial_tx: Some(initial_tx),
+                ..
             }) => Some(*initial_tx + self.rto_calculator.rto()),
-            Some(UnackedSegment {
-                bytes: _,
-                initial_tx: None,
-            }) => Some(now + self.rto_calculator.rto()),
+            Some(UnackedSegment { initial_tx: None, .. }) => Some(now + self.rto_calculator.rto()),
             None => None,
         }
     }
@@ -608,3 +1019,97 @@ impl Sender {
         self.rto_calculator.rto()
     }
 }
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        inetstack::protocols::layer4::tcp::{
+            established::sender::{Sender, UnackedSegment},
+            header::{SelectiveAcknowlegement, TcpHeader, TcpOptions2},
+            SeqNumber,
+        },
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+    use ::std::time::{Duration, Instant};
+
+    const MSS: usize = 1000;
+
+    // Builds an ACK up to `ack_num` that selectively acknowledges each of the ranges in `blocks`.
+    fn sack(ack_num: u32, blocks: &[(u32, u32)]) -> TcpHeader {
+        let mut header: TcpHeader = TcpHeader::new(443, 5000);
+        header.ack = true;
+        header.ack_num = SeqNumber::from(ack_num);
+        header.window_size = u16::MAX;
+        if !blocks.is_empty() {
+            let mut sacks: [SelectiveAcknowlegement; 4] = [SelectiveAcknowlegement {
+                begin: SeqNumber::from(0),
+                end: SeqNumber::from(0),
+            }; 4];
+            for (sack, (begin, end)) in sacks.iter_mut().zip(blocks) {
+                sack.begin = SeqNumber::from(*begin);
+                sack.end = SeqNumber::from(*end);
+            }
+            header.push_option(TcpOptions2::SelectiveAcknowlegement {
+                num_sacks: blocks.len(),
+                sacks,
+            });
+        }
+        header
+    }
+
+    // Tests that SACK blocks that cover a segment sent through segmentation offload in part lead us to retransmit only
+    // the frames of it that our peer lacks.
+    #[test]
+    fn test_sack_retransmits_missing_frames_of_large_segment() -> Result<()> {
+        let start: Instant = Instant::now();
+        let mut sender: Sender = Sender::new(SeqNumber::from(0), u16::MAX as u32, 0, MSS, true, true);
+
+        // We send 64 frames at once, of which our peer misses the second and the sixth.
+        sender.send_next_seq_no.set(SeqNumber::from(64 * MSS as u32));
+        sender
+            .unacked_queue
+            .push(UnackedSegment::new(Some(DemiBuffer::new(64 * MSS as u16)), start));
+        let now: Instant = start + Duration::from_millis(20);
+        let header: TcpHeader = sack(1000, &[(2000, 5000), (6000, 64000)]);
+        crate::ensure_eq!(sender.process_ack(&header, now).is_some(), true);
+
+        // The scoreboard holds what our peer has, and RACK deems the two frames before what it has lost.
+        crate::ensure_eq!(sender.sacked_bytes, 61 * MSS as u32);
+        crate::ensure_eq!(sender.lost_bytes, 2 * MSS as u32);
+        let lengths: Vec<(u32, bool, bool)> = sender
+            .unacked_queue
+            .get_values()
+            .map(|segment| (segment.len(), segment.sacked, segment.lost))
+            .collect();
+        crate::ensure_eq!(
+            lengths,
+            vec![
+                (1000, false, true),
+                (3000, true, false),
+                (1000, false, true),
+                (58000, true, false)
+            ]
+        );
+
+        // We retransmit exactly those two frames.
+        let mut retransmitted: Vec<(u32, usize)> = Vec::new();
+        sender.take_lost_segments(u32::MAX, now, |seq_no: SeqNumber, data: Option<DemiBuffer>| {
+            retransmitted.push((u32::from(seq_no), data.map_or(0, |data| data.len())));
+        });
+        crate::ensure_eq!(retransmitted, vec![(1000, MSS), (5000, MSS)]);
+        crate::ensure_eq!(sender.lost_bytes, 0);
+
+        // Once our peer has everything, the scoreboard is empty.
+        let header: TcpHeader = sack(64000, &[]);
+        sender.process_ack(&header, now + Duration::from_millis(20));
+        crate::ensure_eq!(sender.sacked_bytes, 0);
+        crate::ensure_eq!(sender.unacked_queue.is_empty(), true);
+
+        Ok(())
+    }
+}
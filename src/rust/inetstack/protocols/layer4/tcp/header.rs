@@ -2,14 +2,19 @@
 // Licensed under the MIT license.
 
 use crate::{
-    inetstack::protocols::{layer3::ip::IpProtocol, layer4::tcp::SeqNumber},
-    runtime::{fail::Fail, memory::DemiBuffer},
+    inetstack::protocols::{
+        compute_generic_checksum, compute_segments_checksum, fold16, layer3::ip::IpProtocol, layer4::tcp::SeqNumber,
+    },
+    runtime::{
+        fail::Fail,
+        memory::{DemiBuffer, DemiBufferSegments},
+    },
 };
 use ::libc::EBADMSG;
 use ::std::{
     io::{Cursor, Read},
+    iter,
     net::Ipv4Addr,
-    slice::ChunksExact,
 };
 
 pub const MIN_TCP_HEADER_SIZE: usize = 20;
@@ -131,6 +136,10 @@ pub struct TcpHeader {
 
     pub num_options: usize,
     pub option_list: [TcpOptions2; MAX_TCP_OPTIONS],
+
+    // Whether the IPv4 header of a received segment carried a congestion experienced mark (RFC 3168). This is not part
+    // of the TCP header, so it is never serialized.
+    pub ce: bool,
 }
 
 impl TcpHeader {
@@ -155,6 +164,7 @@ impl TcpHeader {
             urgent_pointer: 0,
             num_options: 0,
             option_list: [TcpOptions2::NoOperation; MAX_TCP_OPTIONS],
+            ce: false,
         }
     }
 
@@ -202,7 +212,7 @@ impl TcpHeader {
 
         if !rx_checksum_offload {
             let checksum: u16 = u16::from_be_bytes([hdr_buf[16], hdr_buf[17]]);
-            if checksum != tcp_checksum(local_ipv4_addr, remote_ipv4_addr, hdr_buf, data_buf) {
+            if checksum != tcp_checksum(local_ipv4_addr, remote_ipv4_addr, hdr_buf, iter::once(data_buf)) {
                 return Err(Fail::new(EBADMSG, "TCP checksum mismatch"));
             }
         }
@@ -323,10 +333,12 @@ impl TcpHeader {
 
             num_options,
             option_list,
+            ce: false,
         })
     }
 
-    /// Serialize a TCP header and prepend to the packet in [buf].
+    /// Serialize a TCP header and prepend to the packet in [buf]. The payload may follow the header in the first segment
+    /// of the packet, be chained behind it in any number of segments, or both.
     pub fn serialize_and_attach(
         &self,
         pkt: &mut DemiBuffer,
@@ -336,7 +348,7 @@ impl TcpHeader {
     ) {
         let header_bytes: usize = self.compute_size();
         pkt.prepend(header_bytes).expect("Should have sufficient headroom");
-        let (hdr_buf, payload): (&mut [u8], &mut [u8]) = pkt[..].split_at_mut(header_bytes);
+        let hdr_buf: &mut [u8] = &mut pkt[..header_bytes];
 
         let fixed_buf: &mut [u8; MIN_TCP_HEADER_SIZE] = (&mut hdr_buf[..MIN_TCP_HEADER_SIZE]).try_into().unwrap();
         fixed_buf[0..2].copy_from_slice(&self.src_port.to_be_bytes());
@@ -395,13 +407,20 @@ impl TcpHeader {
         }
 
         // Alright, we've fully filled out the header, time to compute the checksum.
-        if !tx_checksum_offload {
-            let checksum: u16 = tcp_checksum(src_ipv4_addr, dst_ipv4_addr, &hdr_buf[..], &payload);
-            hdr_buf[16..18].copy_from_slice(&checksum.to_be_bytes());
+        let checksum: u16 = if !tx_checksum_offload {
+            let mut segments: DemiBufferSegments = pkt.segments();
+            // This unwrap won't panic, as a buffer always has a first segment.
+            let (hdr_buf, payload): (&[u8], &[u8]) = segments.next().unwrap().split_at(header_bytes);
+            tcp_checksum(
+                src_ipv4_addr,
+                dst_ipv4_addr,
+                hdr_buf,
+                iter::once(payload).chain(segments),
+            )
         } else {
-            hdr_buf[16] = 0;
-            hdr_buf[17] = 0;
-        }
+            0
+        };
+        pkt[16..18].copy_from_slice(&checksum.to_be_bytes());
     }
 
     // TODO: Review the use of usize here (and everywhere in inetstack, really).
@@ -430,80 +449,81 @@ impl TcpHeader {
     }
 }
 
-fn tcp_checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, header: &[u8], data: &[u8]) -> u16 {
-    let mut state: u32 = 0xffff;
-
-    // First, fold in a "pseudo-IP" header of...
-    // 1) Source address (4 bytes)
-    let src_octets: [u8; 4] = src_ipv4_addr.octets();
-    state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-    state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
-
-    // 2) Destination address (4 bytes)
-    let dst_octets: [u8; 4] = dst_ipv4_addr.octets();
-    state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-    state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-    // 3) 1 byte of zeros and TCP protocol number (1 byte)
-    state += u16::from_be_bytes([0, IpProtocol::TCP as u8]) as u32;
-
-    // 4) TCP segment length (2 bytes)
-    state += (header.len() + data.len()) as u32;
-
-    let fixed_header: &[u8; MIN_TCP_HEADER_SIZE] = header[..MIN_TCP_HEADER_SIZE].try_into().unwrap();
-
-    // Continue to the TCP header. First, for the fixed length parts, we have...
-    // 1) Source port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-    // 2) Destination port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
-
-    // 3) Sequence number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-    state += u16::from_be_bytes([fixed_header[6], fixed_header[7]]) as u32;
-
-    // 4) Acknowledgement number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[8], fixed_header[9]]) as u32;
-    state += u16::from_be_bytes([fixed_header[10], fixed_header[11]]) as u32;
-
-    // 5) Data offset (4 bits), reserved (4 bits), and flags (1 byte)
-    state += u16::from_be_bytes([fixed_header[12], fixed_header[13]]) as u32;
-
-    // 6) Window (2 bytes)
-    state += u16::from_be_bytes([fixed_header[14], fixed_header[15]]) as u32;
-
-    // 7) Checksum (all zeros, 2 bytes)
-    state += 0;
-
-    // 8) Urgent pointer (2 bytes)
-    state += u16::from_be_bytes([fixed_header[18], fixed_header[19]]) as u32;
-
-    // Next, the variable length part of the header for TCP options. Since `data_offset` is
-    // guaranteed to be aligned to a 32-bit boundary, we don't have to handle remainders.
-    if header.len() > MIN_TCP_HEADER_SIZE {
-        assert_eq!(header.len() % 2, 0);
-        for chunk in header[MIN_TCP_HEADER_SIZE..].chunks_exact(2) {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-    }
+/// Computes the checksum of a TCP segment whose payload spans the slices in `data` (e.g., the segments of a buffer
+/// chain).
+fn tcp_checksum<'a>(
+    src_ipv4_addr: &Ipv4Addr,
+    dst_ipv4_addr: &Ipv4Addr,
+    header: &[u8],
+    data: impl Iterator<Item = &'a [u8]>,
+) -> u16 {
+    // First, fold in a "pseudo-IP" header of source address, destination address, 1 byte of zeros and TCP protocol
+    // number, and TCP segment length. The length of the data is only known once we have gone over it, and the sum does
+    // not depend on the order of the words, so we add that last.
+    let mut state: u32 = compute_generic_checksum(&src_ipv4_addr.octets(), None);
+    state = compute_generic_checksum(&dst_ipv4_addr.octets(), Some(state));
+    state += IpProtocol::TCP as u32;
+
+    // Continue to the TCP header, skipping the checksum (bytes 16..18). Since `data_offset` is guaranteed to be aligned
+    // to a 32-bit boundary, the options do not need any padding.
+    state = compute_generic_checksum(&header[..16], Some(state));
+    state = compute_generic_checksum(&header[18..], Some(state));
 
     // Finally, checksum the data itself.
-    let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-    }
-    // Since the data may have an odd number of bytes, pad the last byte with zero if necessary.
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
-    }
+    let mut data_len: usize = 0;
+    state = compute_segments_checksum(data.inspect(|segment| data_len += segment.len()), Some(state));
+    state += (header.len() + data_len) as u32;
+    fold16(state)
+}
 
-    // NB: We don't need to subtract out 0xFFFF as we accumulate the sum. Since we use a u32 for
-    // intermediate state, we would need 2^16 additions to overflow. This is well beyond the reach
-    // of the largest jumbo frames. The upshot is that the compiler can then optimize this final
-    // loop into a single branchfree code.
-    while state > 0xFFFF {
-        state -= 0xFFFF;
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        inetstack::protocols::layer4::tcp::{
+            header::{TcpHeader, MIN_TCP_HEADER_SIZE},
+            SeqNumber,
+        },
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+    use ::std::net::Ipv4Addr;
+
+    // Tests that the checksum covers every segment of a payload chain, including segments of odd lengths.
+    #[test]
+    fn test_tcp_checksum_chained_payload() -> Result<()> {
+        let src_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 1);
+        let dst_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 2);
+        let mut hdr: TcpHeader = TcpHeader::new(0x32, 0x45);
+        hdr.seq_num = SeqNumber::from(0x01020304);
+        hdr.ack = true;
+        hdr.window_size = 0x1000;
+
+        // Three segments: a bit of payload behind the header, and two chained segments of odd lengths.
+        let data: Vec<u8> = (0..301).map(|i| i as u8).collect();
+        let mut pkt: DemiBuffer = DemiBuffer::from_slice_with_headroom(&data[..3], MIN_TCP_HEADER_SIZE)?;
+        pkt.chain(DemiBuffer::from_slice(&data[3..100])?)?;
+        pkt.chain(DemiBuffer::from_slice(&data[100..])?)?;
+        crate::ensure_eq!(pkt.num_segments(), 3);
+        hdr.serialize_and_attach(&mut pkt, &src_addr, &dst_addr, false);
+
+        // The checksum must be the same as that of the same segment in a single buffer.
+        let mut flat: DemiBuffer = DemiBuffer::from_slice_with_headroom(&data, MIN_TCP_HEADER_SIZE)?;
+        hdr.serialize_and_attach(&mut flat, &src_addr, &dst_addr, false);
+        crate::ensure_eq!(pkt[16..18], flat[16..18]);
+
+        // And the receive side must accept it.
+        let mut buf: DemiBuffer = pkt.linearize(0)?;
+        let parsed: TcpHeader = match TcpHeader::parse_and_strip(&dst_addr, &src_addr, &mut buf, false) {
+            Ok(parsed) => parsed,
+            Err(e) => anyhow::bail!("could not parse: {:?}", e),
+        };
+        crate::ensure_eq!(parsed.seq_num, hdr.seq_num);
+        crate::ensure_eq!(&buf[..], &data[..]);
+
+        Ok(())
     }
-    !state as u16
 }
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 mod active_open;
+mod coalescing;
 pub mod constants;
 mod established;
 pub mod header;
@@ -10,6 +11,7 @@ mod passive_open;
 pub mod peer;
 mod sequence_number;
 pub mod socket;
+mod syn_cookie;
 
 #[cfg(test)]
 mod tests;
@@ -15,12 +15,10 @@ use crate::{
         layer3::SharedLayer3Endpoint,
         layer4::tcp::{
             constants::FALLBACK_MSS,
-            established::{
-                congestion_control::{self, CongestionControl},
-                EstablishedSocket,
-            },
+            established::{congestion_control, EstablishedSocket},
             header::{TcpHeader, TcpOptions2},
             isn_generator::IsnGenerator,
+            syn_cookie::SynCookieGenerator,
             SeqNumber,
         },
         MAX_HEADER_SIZE,
@@ -40,7 +38,7 @@ use ::std::{
     collections::HashMap,
     net::{Ipv4Addr, SocketAddrV4},
     ops::{Deref, DerefMut},
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 //======================================================================================================================
@@ -64,6 +62,13 @@ pub struct PassiveSocket {
     ready: AsyncQueue<Result<EstablishedSocket, Fail>>,
     max_backlog: usize,
     isn_generator: IsnGenerator,
+    /// Answers SYNs once too many handshakes are in flight, without keeping any state for them.
+    syn_cookies: SynCookieGenerator,
+    /// Number of handshakes that have a coroutine in flight.
+    num_handshakes: usize,
+    /// When we last answered a SYN with a cookie, so that we only look for cookies in stray ACKs while one may come
+    /// back.
+    last_cookie_sent: Option<Instant>,
     local: SocketAddrV4,
     runtime: SharedDemiRuntime,
     layer3_endpoint: SharedLayer3Endpoint,
@@ -103,6 +108,9 @@ impl SharedPassiveSocket {
             ready: AsyncQueue::<Result<EstablishedSocket, Fail>>::default(),
             max_backlog,
             isn_generator: IsnGenerator::new(nonce),
+            syn_cookies: SynCookieGenerator::new(runtime.get_now()),
+            num_handshakes: 0,
+            last_cookie_sent: None,
             local,
             runtime: runtime.clone(),
             layer3_endpoint,
@@ -113,7 +121,7 @@ impl SharedPassiveSocket {
             socket_queue,
         }));
         let qt: QToken =
-            runtime.insert_background_coroutine("bgc::passive_listening::poll", Box::pin(me.clone().poll().fuse()))?;
+            runtime.insert_background_coroutine("bgc::passive_listening::poll", me.clone().poll().fuse())?;
         me.background_task_qt = Some(qt);
         Ok(me)
     }
@@ -158,6 +166,14 @@ impl SharedPassiveSocket {
                                         continue;
                                     }
 
+                                    // An ACK may complete a handshake that we answered with a SYN cookie.
+                                    if tcp_hdr.ack && !tcp_hdr.syn && !tcp_hdr.rst {
+                                        if let Some(mss) = self.validate_syn_cookie(&remote, &tcp_hdr) {
+                                            self.accept_syn_cookie(remote, mss, ipv4_addr, tcp_hdr, buf);
+                                            continue;
+                                        }
+                                    }
+
                                     // If not a SYN, then this packet is not for a new connection and we throw it away.
                                     if !tcp_hdr.syn || tcp_hdr.ack || tcp_hdr.rst {
                                         let cause: String = format!(
@@ -211,6 +227,16 @@ impl SharedPassiveSocket {
             return;
         }
 
+        // Past the threshold, answer with a SYN cookie rather than holding a coroutine and a table entry for a
+        // handshake that may never complete (RFC 4987, section 3.6). If the cookie cannot be sent right away, fall
+        // back to a regular handshake, which waits for the link-layer address of our peer.
+        if self.num_handshakes >= self.tcp_config.get_syn_cookie_threshold() {
+            match self.send_syn_cookie(&remote, &tcp_hdr) {
+                Ok(()) => return,
+                Err(e) => warn!("handle_new_syn(): could not send SYN cookie: {:?}", e),
+            }
+        }
+
         // Send SYN+ACK.
         let local: SocketAddrV4 = self.local.clone();
         let local_isn = self.isn_generator.generate(&local, &remote);
@@ -226,7 +252,7 @@ impl SharedPassiveSocket {
             .fuse();
         match self
             .runtime
-            .insert_background_coroutine("bgc::inetstack::tcp::passiveopen::background", Box::pin(future))
+            .insert_background_coroutine("bgc::inetstack::tcp::passiveopen::background", future)
         {
             Ok(qt) => qt,
             Err(e) => {
@@ -237,6 +263,93 @@ impl SharedPassiveSocket {
         };
         // TODO: Clean up the connections table once we have merged all of the routing tables into one.
         self.connections.insert(remote, recv_queue);
+        self.num_handshakes += 1;
+    }
+
+    /// Answers the SYN of `remote` with a SYN+ACK whose sequence number is a SYN cookie.
+    fn send_syn_cookie(&mut self, remote: &SocketAddrV4, tcp_hdr: &TcpHeader) -> Result<(), Fail> {
+        let mut mss: usize = FALLBACK_MSS;
+        for option in tcp_hdr.iter_options() {
+            if let TcpOptions2::MaximumSegmentSize(m) = option {
+                mss = *m as usize;
+            }
+        }
+
+        let now: Instant = self.runtime.get_now();
+        let (local_isn, mss): (SeqNumber, usize) =
+            self.syn_cookies
+                .generate(&self.local, remote, tcp_hdr.seq_num, mss, now);
+        debug!(
+            "send_syn_cookie(): answering {:?} with a SYN cookie (mss={})",
+            remote, mss
+        );
+
+        // The cookie only encodes the MSS, so turn down all other options.
+        let pkt: DemiBuffer = self.new_syn_ack(local_isn, tcp_hdr.seq_num, remote, false, false, false);
+        self.layer3_endpoint
+            .transmit_tcp_packet_nonblocking(remote.ip().clone(), pkt)?;
+        self.last_cookie_sent = Some(now);
+        Ok(())
+    }
+
+    /// Checks whether an ACK from `remote`, for which we hold no state, returns a SYN cookie that we sent. Returns the
+    /// MSS that the cookie encodes if it does.
+    fn validate_syn_cookie(&self, remote: &SocketAddrV4, tcp_hdr: &TcpHeader) -> Option<usize> {
+        let now: Instant = self.runtime.get_now();
+        match self.last_cookie_sent {
+            Some(last) if now.saturating_duration_since(last) < SynCookieGenerator::lifetime() => (),
+            _ => return None,
+        }
+        let local_isn: SeqNumber = tcp_hdr.ack_num - SeqNumber::from(1);
+        let remote_isn: SeqNumber = tcp_hdr.seq_num - SeqNumber::from(1);
+        self.syn_cookies
+            .validate(&self.local, remote, remote_isn, local_isn, now)
+    }
+
+    /// Establishes a connection from an ACK that returned a valid SYN cookie.
+    fn accept_syn_cookie(
+        &mut self,
+        remote: SocketAddrV4,
+        mss: usize,
+        ipv4_addr: Ipv4Addr,
+        tcp_hdr: TcpHeader,
+        buf: DemiBuffer,
+    ) {
+        if self.connections.len() >= self.max_backlog {
+            warn!(
+                "accept_syn_cookie(): backlog full, dropping ACK (backlog={})",
+                self.max_backlog
+            );
+            return;
+        }
+        debug!("accept_syn_cookie(): {:?} returned a valid SYN cookie", remote);
+
+        let local_isn: SeqNumber = tcp_hdr.ack_num - SeqNumber::from(1);
+        let remote_isn: SeqNumber = tcp_hdr.seq_num - SeqNumber::from(1);
+        let header_window_size: u16 = tcp_hdr.window_size;
+        let mut recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)> =
+            SharedAsyncQueue::<(Ipv4Addr, TcpHeader, DemiBuffer)>::default();
+        // If there is data with the ACK, deliver it.
+        if !buf.is_empty() {
+            recv_queue.push((ipv4_addr, tcp_hdr, buf));
+        }
+
+        let result: Result<EstablishedSocket, Fail> = self.new_established_socket(
+            recv_queue.clone(),
+            SharedAsyncQueue::<usize>::default(),
+            remote,
+            local_isn,
+            remote_isn,
+            header_window_size,
+            None,
+            mss,
+            false,
+            false,
+        );
+        if result.is_ok() {
+            self.connections.insert(remote, recv_queue);
+        }
+        self.ready.push(result);
     }
 
     /// Sends a RST segment to `remote`.
@@ -293,9 +406,26 @@ impl SharedPassiveSocket {
         recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
         ack_queue: SharedAsyncQueue<usize>,
     ) {
+        let result: Result<EstablishedSocket, Fail> = self
+            .handshake(remote, remote_isn, local_isn, tcp_hdr, recv_queue, ack_queue)
+            .await;
+        self.num_handshakes -= 1;
+        self.ready.push(result);
+    }
+
+    async fn handshake(
+        &mut self,
+        remote: SocketAddrV4,
+        remote_isn: SeqNumber,
+        local_isn: SeqNumber,
+        tcp_hdr: TcpHeader,
+        recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
+        ack_queue: SharedAsyncQueue<usize>,
+    ) -> Result<EstablishedSocket, Fail> {
         // Set up new inflight accept connection.
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_enabled: bool = false;
         for option in tcp_hdr.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
@@ -306,19 +436,27 @@ impl SharedPassiveSocket {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
                 },
+                // We agree to selective acknowledgements whenever our peer offers them (RFC 2018, section 2).
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_enabled = true;
+                },
                 _ => continue,
             }
         }
 
+        // Our peer asks for ECN by setting both ECE and CWR on its SYN, and we agree if our congestion control uses it
+        // (RFC 3168, section 6.1.1).
+        let ecn_enabled: bool =
+            tcp_hdr.ece && tcp_hdr.cwr && congestion_control::uses_ecn(self.socket_options.get_congestion_control());
+
         let mut handshake_retries: usize = self.tcp_config.get_handshake_retries();
         let handshake_timeout: Duration = self.tcp_config.get_handshake_timeout();
 
         loop {
             // Send the SYN + ACK.
-            if let Err(e) = self.send_syn_ack(local_isn, remote_isn, remote).await {
-                self.ready.push(Err(e));
-                return;
-            }
+            self.send_syn_ack(local_isn, remote_isn, remote, ecn_enabled, sack_enabled)
+                .await?;
 
             // Start ack timer.
 
@@ -332,28 +470,23 @@ impl SharedPassiveSocket {
                 tcp_hdr.window_size,
                 remote_window_scale,
                 mss,
+                ecn_enabled,
+                sack_enabled,
             );
 
             // Either we get an ack or a timeout.
             match conditional_yield_with_timeout(ack, handshake_timeout).await {
                 // Got an ack
-                Ok(result) => {
-                    self.ready.push(result);
-                    return;
-                },
+                Ok(result) => return result,
                 Err(Fail { errno, cause: _ }) if errno == ETIMEDOUT => {
                     if handshake_retries > 0 {
                         handshake_retries = handshake_retries - 1;
                         continue;
                     } else {
-                        self.ready.push(Err(Fail::new(ETIMEDOUT, "handshake timeout")));
-                        return;
+                        return Err(Fail::new(ETIMEDOUT, "handshake timeout"));
                     }
                 },
-                Err(e) => {
-                    self.ready.push(Err(e));
-                    return;
-                },
+                Err(e) => return Err(e),
             }
         }
     }
@@ -363,9 +496,29 @@ impl SharedPassiveSocket {
         local_isn: SeqNumber,
         remote_isn: SeqNumber,
         remote: SocketAddrV4,
+        ecn_enabled: bool,
+        sack_enabled: bool,
     ) -> Result<(), Fail> {
+        let dst_ipv4_addr: Ipv4Addr = remote.ip().clone();
+        let pkt: DemiBuffer = self.new_syn_ack(local_isn, remote_isn, &remote, ecn_enabled, sack_enabled, true);
+        self.layer3_endpoint
+            .transmit_tcp_packet_blocking(dst_ipv4_addr, pkt)
+            .await
+    }
+
+    /// Builds a SYN+ACK segment for `remote`. Window scaling is only offered when `window_scale_enabled` is set.
+    fn new_syn_ack(
+        &self,
+        local_isn: SeqNumber,
+        remote_isn: SeqNumber,
+        remote: &SocketAddrV4,
+        ecn_enabled: bool,
+        sack_enabled: bool,
+        window_scale_enabled: bool,
+    ) -> DemiBuffer {
         let mut tcp_hdr = TcpHeader::new(self.local.port(), remote.port());
         tcp_hdr.syn = true;
+        tcp_hdr.ece = ecn_enabled;
         tcp_hdr.seq_num = local_isn;
         tcp_hdr.ack = true;
         tcp_hdr.ack_num = remote_isn + SeqNumber::from(1);
@@ -375,11 +528,17 @@ impl SharedPassiveSocket {
         tcp_hdr.push_option(TcpOptions2::MaximumSegmentSize(mss));
         info!("Advertising MSS: {}", mss);
 
-        tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
-        info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
+        if window_scale_enabled {
+            tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
+            info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
+        }
+
+        if sack_enabled {
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+            info!("Advertising SACK permitted");
+        }
 
         debug!("Sending SYN+ACK: {:?}", tcp_hdr);
-        let dst_ipv4_addr: Ipv4Addr = remote.ip().clone();
         let mut pkt: DemiBuffer = DemiBuffer::new_with_headroom(0, MAX_HEADER_SIZE as u16);
         tcp_hdr.serialize_and_attach(
             &mut pkt,
@@ -387,9 +546,7 @@ impl SharedPassiveSocket {
             remote.ip(),
             self.tcp_config.get_rx_checksum_offload(),
         );
-        self.layer3_endpoint
-            .transmit_tcp_packet_blocking(dst_ipv4_addr, pkt)
-            .await
+        pkt
     }
 
     async fn wait_for_ack(
@@ -402,6 +559,8 @@ impl SharedPassiveSocket {
         header_window_size: u16,
         remote_window_scale: Option<u8>,
         mss: usize,
+        ecn_enabled: bool,
+        sack_enabled: bool,
     ) -> Result<EstablishedSocket, Fail> {
         let (ipv4_hdr, tcp_hdr, buf) = recv_queue.pop(None).await?;
         debug!("Received ACK: {:?}", tcp_hdr);
@@ -411,6 +570,39 @@ impl SharedPassiveSocket {
             return Err(Fail::new(EBADMSG, "invalid SYN+ACK seq num"));
         }
 
+        // If there is data with the SYN+ACK, deliver it.
+        if !buf.is_empty() {
+            recv_queue.push((ipv4_hdr, tcp_hdr, buf));
+        }
+
+        self.new_established_socket(
+            recv_queue,
+            ack_queue,
+            remote,
+            local_isn,
+            remote_isn,
+            header_window_size,
+            remote_window_scale,
+            mss,
+            ecn_enabled,
+            sack_enabled,
+        )
+    }
+
+    /// Creates the socket of a connection whose handshake has completed.
+    fn new_established_socket(
+        &self,
+        recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
+        ack_queue: SharedAsyncQueue<usize>,
+        remote: SocketAddrV4,
+        local_isn: SeqNumber,
+        remote_isn: SeqNumber,
+        header_window_size: u16,
+        remote_window_scale: Option<u8>,
+        mss: usize,
+        ecn_enabled: bool,
+        sack_enabled: bool,
+    ) -> Result<EstablishedSocket, Fail> {
         // Calculate the window.
         let (local_window_scale, remote_window_scale): (u32, u8) = match remote_window_scale {
             Some(remote_window_scale) => {
@@ -449,11 +641,6 @@ impl SharedPassiveSocket {
             local_window_scale, remote_window_scale
         );
 
-        // If there is data with the SYN+ACK, deliver it.
-        if !buf.is_empty() {
-            recv_queue.push((ipv4_hdr, tcp_hdr, buf));
-        }
-
         let new_socket: EstablishedSocket = EstablishedSocket::new(
             self.local,
             remote,
@@ -471,8 +658,10 @@ impl SharedPassiveSocket {
             remote_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            congestion_control::get_constructor(self.socket_options.get_congestion_control()),
             None,
+            ecn_enabled,
+            sack_enabled,
             self.dead_socket_tx.clone(),
             Some(self.socket_queue.clone()),
         )?;
@@ -9,13 +9,18 @@ use crate::{
     demikernel::config::Config,
     inetstack::protocols::{
         layer3::SharedLayer3Endpoint,
-        layer4::tcp::{header::TcpHeader, isn_generator::IsnGenerator, socket::SharedTcpSocket, SeqNumber},
+        layer4::tcp::{
+            coalescing::ReceiveCoalescer, header::TcpHeader, isn_generator::IsnGenerator, socket::SharedTcpSocket,
+            SeqNumber,
+        },
     },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
         network::{
             config::TcpConfig,
+            consts::MAX_RECEIVE_BATCH_SIZE,
+            flow_table::FlowTable,
             socket::{
                 option::{SocketOption, TcpSocketOptions},
                 SocketId,
@@ -24,11 +29,12 @@ use crate::{
         QDesc, SharedDemiRuntime, SharedObject,
     },
 };
+use ::arrayvec::{ArrayVec, IntoIter};
 use ::futures::channel::mpsc;
 use ::rand::{prelude::SmallRng, Rng, SeedableRng};
 
 use ::std::{
-    collections::HashMap,
+    iter::Peekable,
     net::{Ipv4Addr, SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
 };
@@ -46,7 +52,7 @@ pub struct TcpPeer {
     default_socket_options: TcpSocketOptions,
     rng: SmallRng,
     dead_socket_tx: mpsc::UnboundedSender<QDesc>,
-    addresses: HashMap<SocketId, SharedTcpSocket>,
+    addresses: FlowTable<SharedTcpSocket>,
 }
 
 #[derive(Clone)]
@@ -65,6 +71,7 @@ impl SharedTcpPeer {
     ) -> Result<Self, Fail> {
         let mut rng: SmallRng = SmallRng::from_seed(rng_seed);
         let nonce: u32 = rng.gen();
+        let flow_table_seed: u64 = rng.gen();
         let (tx, _) = mpsc::unbounded();
         Ok(Self(SharedObject::<TcpPeer>::new(TcpPeer {
             isn_generator: IsnGenerator::new(nonce),
@@ -75,7 +82,7 @@ impl SharedTcpPeer {
             default_socket_options: TcpSocketOptions::new(config)?,
             rng,
             dead_socket_tx: tx,
-            addresses: HashMap::<SocketId, SharedTcpSocket>::new(),
+            addresses: FlowTable::<SharedTcpSocket>::new(flow_table_seed),
         })))
     }
 
@@ -183,6 +190,8 @@ impl SharedTcpPeer {
         // TODO: Remove this copy after merging with the transport trait.
         // Wait for push to complete.
         socket.push(buf.clone()).await?;
+        // Clear out the original buffer, which may be a chain.
+        let _: Option<DemiBuffer> = buf.detach_tail();
         buf.trim(buf.len())
     }
 
@@ -216,24 +225,91 @@ impl SharedTcpPeer {
         Ok(())
     }
 
-    /// Processes an incoming TCP segment.
-    pub fn receive(&mut self, src_ipv4_addr: Ipv4Addr, mut buf: DemiBuffer) {
+    /// Processes an incoming TCP segment. `congestion_experienced` tells whether its IPv4 header carried a congestion
+    /// experienced mark.
+    pub fn receive(&mut self, src_ipv4_addr: Ipv4Addr, congestion_experienced: bool, buf: DemiBuffer) {
+        if let Some((tcp_hdr, buf)) = self.parse_segment(src_ipv4_addr, congestion_experienced, buf) {
+            self.dispatch_segment(src_ipv4_addr, tcp_hdr, buf)
+        }
+    }
+
+    /// Processes a burst of incoming TCP segments. With receive coalescing, back-to-back in-order segments of the same
+    /// connection reach their socket as one segment.
+    pub fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Addr, bool, DemiBuffer), MAX_RECEIVE_BATCH_SIZE>) {
+        if batch.len() == 1 {
+            for (src_ipv4_addr, congestion_experienced, buf) in batch {
+                self.receive(src_ipv4_addr, congestion_experienced, buf);
+            }
+            return;
+        }
+
+        let mut segments: ArrayVec<(Ipv4Addr, TcpHeader, DemiBuffer), MAX_RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for (src_ipv4_addr, congestion_experienced, buf) in batch {
+            if let Some((tcp_hdr, buf)) = self.parse_segment(src_ipv4_addr, congestion_experienced, buf) {
+                segments.push((src_ipv4_addr, tcp_hdr, buf));
+            }
+        }
+
+        // The flow of each segment is looked up while that of the next one is on its way into the cache.
+        if let Some((src_ipv4_addr, tcp_hdr, _)) = segments.first() {
+            self.prefetch_flow(*src_ipv4_addr, tcp_hdr);
+        }
+        let coalescing: bool = self.tcp_config.get_receive_coalescing();
+        let mut coalescer: ReceiveCoalescer = ReceiveCoalescer::default();
+        let mut pending: Peekable<IntoIter<(Ipv4Addr, TcpHeader, DemiBuffer), MAX_RECEIVE_BATCH_SIZE>> =
+            segments.into_iter().peekable();
+        while let Some((src_ipv4_addr, tcp_hdr, buf)) = pending.next() {
+            if let Some((src_ipv4_addr, tcp_hdr, _)) = pending.peek() {
+                self.prefetch_flow(*src_ipv4_addr, tcp_hdr);
+            }
+            if !coalescing {
+                self.dispatch_segment(src_ipv4_addr, tcp_hdr, buf);
+            } else if let Some((src_ipv4_addr, tcp_hdr, buf)) = coalescer.push(src_ipv4_addr, tcp_hdr, buf) {
+                self.dispatch_segment(src_ipv4_addr, tcp_hdr, buf);
+            }
+        }
+        if let Some((src_ipv4_addr, tcp_hdr, buf)) = coalescer.take() {
+            self.dispatch_segment(src_ipv4_addr, tcp_hdr, buf);
+        }
+    }
+
+    /// Parses and strips the TCP header of an incoming segment. Invalid segments are dropped.
+    fn parse_segment(
+        &self,
+        src_ipv4_addr: Ipv4Addr,
+        congestion_experienced: bool,
+        mut buf: DemiBuffer,
+    ) -> Option<(TcpHeader, DemiBuffer)> {
         // We can assume that the destination is our local IPv4 address; otherwise, the IP layer would have discarded
         // the packet already.
-        let tcp_hdr: TcpHeader = match TcpHeader::parse_and_strip(
+        match TcpHeader::parse_and_strip(
             &src_ipv4_addr,
             &self.local_ipv4_addr,
             &mut buf,
             self.tcp_config.get_rx_checksum_offload(),
         ) {
-            Ok(header) => header,
+            Ok(mut header) => {
+                header.ce = congestion_experienced;
+                debug!("TCP received {:?}", header);
+                Some((header, buf))
+            },
             Err(e) => {
                 let cause: String = format!("invalid tcp header: {:?}", e);
                 error!("receive(): {}", &cause);
-                return;
+                None
             },
-        };
-        debug!("TCP received {:?}", tcp_hdr);
+        }
+    }
+
+    /// Brings the bucket of the connection that a segment belongs to into the cache.
+    fn prefetch_flow(&self, src_ipv4_addr: Ipv4Addr, tcp_hdr: &TcpHeader) {
+        let local: SocketAddrV4 = SocketAddrV4::new(self.local_ipv4_addr, tcp_hdr.dst_port);
+        let remote: SocketAddrV4 = SocketAddrV4::new(src_ipv4_addr, tcp_hdr.src_port);
+        self.addresses.prefetch(&SocketId::Active(local, remote));
+    }
+
+    /// Hands a parsed segment over to the socket that it belongs to.
+    fn dispatch_segment(&mut self, src_ipv4_addr: Ipv4Addr, tcp_hdr: TcpHeader, buf: DemiBuffer) {
         let local: SocketAddrV4 = SocketAddrV4::new(self.local_ipv4_addr, tcp_hdr.dst_port);
         let remote: SocketAddrV4 = SocketAddrV4::new(src_ipv4_addr, tcp_hdr.src_port);
 
@@ -115,6 +115,18 @@ impl SharedTcpSocket {
             SocketOption::Linger(linger) => self.socket_options.set_linger(linger),
             SocketOption::KeepAlive(keep_alive) => self.socket_options.set_keepalive(keep_alive),
             SocketOption::NoDelay(no_delay) => self.socket_options.set_nodelay(no_delay),
+            // Connections pick their congestion control algorithm when they are set up, and accepted connections take
+            // that of the listening socket.
+            SocketOption::CongestionControl(algorithm) => match self.state {
+                SocketState::Unbound | SocketState::Bound(_) | SocketState::Listening(_) => {
+                    self.socket_options.set_congestion_control(algorithm)
+                },
+                _ => {
+                    let cause: String = format!("cannot change the congestion control of a connected socket");
+                    error!("set_socket_option(): {}", cause);
+                    return Err(Fail::new(libc::EISCONN, &cause));
+                },
+            },
         }
         Ok(())
     }
@@ -126,6 +138,9 @@ impl SharedTcpSocket {
             SocketOption::Linger(_) => Ok(SocketOption::Linger(self.socket_options.get_linger())),
             SocketOption::KeepAlive(_) => Ok(SocketOption::KeepAlive(self.socket_options.get_keepalive())),
             SocketOption::NoDelay(_) => Ok(SocketOption::NoDelay(self.socket_options.get_nodelay())),
+            SocketOption::CongestionControl(_) => Ok(SocketOption::CongestionControl(
+                self.socket_options.get_congestion_control(),
+            )),
         }
     }
 
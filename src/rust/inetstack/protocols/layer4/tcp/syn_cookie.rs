@@ -0,0 +1,194 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Stateless SYN cookies (RFC 4987, section 3.6).
+//!
+//! A listener that answers a SYN with a cookie keeps no state for the handshake: the initial sequence number of its
+//! SYN+ACK encodes what it needs to complete it, and comes back in the acknowledgement number of the final ACK. The
+//! layout is the classic one: the top 8 bits hold a coarse clock, which bounds how long a cookie stays valid, and the
+//! low 24 bits hold a keyed hash of the connection plus the index of the MSS that the peer advertised. Nothing else of
+//! the SYN survives, so connections that complete through a cookie use neither window scaling, SACK nor ECN.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::inetstack::protocols::layer4::tcp::SeqNumber;
+use ::std::{
+    hash::{BuildHasher, Hasher, RandomState},
+    net::SocketAddrV4,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// MSS values that a cookie can encode, in increasing order. A peer gets the largest one that does not exceed what it
+/// advertised. These cover the common paths: minimal IPv4, tunnels, Ethernet with options, plain Ethernet, and jumbo
+/// frames.
+const MSS_TABLE: [u16; 6] = [536, 1300, 1440, 1460, 4312, 8960];
+
+/// Number of low bits of a cookie that hold the hash and the MSS index. The remaining high bits hold the clock.
+const COOKIE_BITS: u32 = 24;
+
+/// Mask of the low bits of a cookie.
+const COOKIE_MASK: u32 = (1 << COOKIE_BITS) - 1;
+
+/// Period of the clock that cookies encode.
+const CLOCK_TICK: Duration = Duration::from_secs(64);
+
+/// Number of clock ticks for which a cookie stays valid.
+const MAX_AGE_TICKS: u32 = 2;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Generates and checks SYN cookies for a listening socket.
+pub struct SynCookieGenerator {
+    /// Secret key of the hash, so that peers cannot forge cookies.
+    key: RandomState,
+    /// Start of the clock that cookies encode.
+    epoch: Instant,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl SynCookieGenerator {
+    pub fn new(epoch: Instant) -> Self {
+        Self {
+            key: RandomState::new(),
+            epoch,
+        }
+    }
+
+    /// Returns how long a cookie stays valid once it has been sent.
+    pub fn lifetime() -> Duration {
+        CLOCK_TICK * MAX_AGE_TICKS
+    }
+
+    /// Returns the initial sequence number of a SYN+ACK that answers the SYN of `remote` with a cookie, along with the
+    /// MSS that the cookie encodes, which may be smaller than the one that the peer advertised.
+    pub fn generate(
+        &self,
+        local: &SocketAddrV4,
+        remote: &SocketAddrV4,
+        remote_isn: SeqNumber,
+        mss: usize,
+        now: Instant,
+    ) -> (SeqNumber, usize) {
+        let mss_index: usize = MSS_TABLE.iter().rposition(|&entry| entry as usize <= mss).unwrap_or(0);
+        let count: u32 = self.clock(now);
+        let cookie: u32 = self
+            .hash(local, remote, 0, 0)
+            .wrapping_add(u32::from(remote_isn))
+            .wrapping_add(count << COOKIE_BITS)
+            .wrapping_add(self.hash(local, remote, count, 1).wrapping_add(mss_index as u32) & COOKIE_MASK);
+        (SeqNumber::from(cookie), MSS_TABLE[mss_index] as usize)
+    }
+
+    /// Checks the cookie that the ACK of `remote` returns, given the initial sequence numbers that the ACK implies.
+    /// Returns the MSS that the cookie encodes if the cookie is genuine and recent enough.
+    pub fn validate(
+        &self,
+        local: &SocketAddrV4,
+        remote: &SocketAddrV4,
+        remote_isn: SeqNumber,
+        cookie: SeqNumber,
+        now: Instant,
+    ) -> Option<usize> {
+        let count: u32 = self.clock(now);
+        let cookie: u32 = u32::from(cookie)
+            .wrapping_sub(self.hash(local, remote, 0, 0))
+            .wrapping_sub(u32::from(remote_isn));
+        // The high bits tell when the cookie was made.
+        let age: u32 = count.wrapping_sub(cookie >> COOKIE_BITS) & (u32::MAX >> COOKIE_BITS);
+        if age >= MAX_AGE_TICKS {
+            return None;
+        }
+        // The low bits must hold the hash of that time plus a valid index, which a forged cookie hits only by chance.
+        let mss_index: usize =
+            (cookie.wrapping_sub(self.hash(local, remote, count.wrapping_sub(age), 1)) & COOKIE_MASK) as usize;
+        MSS_TABLE.get(mss_index).map(|&mss| mss as usize)
+    }
+
+    /// Returns the number of clock ticks since the epoch.
+    fn clock(&self, now: Instant) -> u32 {
+        (now.saturating_duration_since(self.epoch).as_secs() / CLOCK_TICK.as_secs()) as u32
+    }
+
+    /// Hashes the endpoints of a connection, along with a clock value and a salt, under the secret key.
+    fn hash(&self, local: &SocketAddrV4, remote: &SocketAddrV4, count: u32, salt: u8) -> u32 {
+        let mut hasher = self.key.build_hasher();
+        hasher.write(&remote.ip().octets());
+        hasher.write_u16(remote.port());
+        hasher.write(&local.ip().octets());
+        hasher.write_u16(local.port());
+        hasher.write_u32(count);
+        hasher.write_u8(salt);
+        hasher.finish() as u32
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{SynCookieGenerator, CLOCK_TICK, MSS_TABLE};
+    use crate::inetstack::protocols::layer4::tcp::SeqNumber;
+    use ::anyhow::Result;
+    use ::std::{
+        net::{Ipv4Addr, SocketAddrV4},
+        time::Instant,
+    };
+
+    const LOCAL: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+    const REMOTE: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 32768);
+
+    // Tests that a cookie comes back with the MSS that it encodes, rounded down to a table entry.
+    #[test]
+    fn test_syn_cookie_roundtrip() -> Result<()> {
+        let now: Instant = Instant::now();
+        let generator: SynCookieGenerator = SynCookieGenerator::new(now);
+        let remote_isn: SeqNumber = SeqNumber::from(0xfffff000);
+
+        for (advertised, expected) in [(1460, 1460), (1500, 1460), (9000, 8960), (100, MSS_TABLE[0] as usize)] {
+            let (cookie, mss): (SeqNumber, usize) = generator.generate(&LOCAL, &REMOTE, remote_isn, advertised, now);
+            crate::ensure_eq!(mss, expected);
+            crate::ensure_eq!(
+                generator.validate(&LOCAL, &REMOTE, remote_isn, cookie, now),
+                Some(expected)
+            );
+            // Cookies stay valid for a little while.
+            crate::ensure_eq!(
+                generator.validate(&LOCAL, &REMOTE, remote_isn, cookie, now + CLOCK_TICK),
+                Some(expected)
+            );
+        }
+
+        Ok(())
+    }
+
+    // Tests that stale, altered, and misdirected cookies are rejected.
+    #[test]
+    fn test_syn_cookie_rejects() -> Result<()> {
+        let now: Instant = Instant::now();
+        let generator: SynCookieGenerator = SynCookieGenerator::new(now);
+        let remote_isn: SeqNumber = SeqNumber::from(42);
+        let (cookie, _): (SeqNumber, usize) = generator.generate(&LOCAL, &REMOTE, remote_isn, 1460, now);
+
+        let later: Instant = now + SynCookieGenerator::lifetime();
+        crate::ensure_eq!(generator.validate(&LOCAL, &REMOTE, remote_isn, cookie, later), None);
+        let altered: SeqNumber = cookie + SeqNumber::from(1 << 12);
+        crate::ensure_eq!(generator.validate(&LOCAL, &REMOTE, remote_isn, altered, now), None);
+        let other: SocketAddrV4 = SocketAddrV4::new(*REMOTE.ip(), REMOTE.port() + 1);
+        crate::ensure_eq!(generator.validate(&LOCAL, &other, remote_isn, cookie, now), None);
+
+        Ok(())
+    }
+}
@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Checks how a sender that uses ECN answers a peer that keeps echoing a congestion mark until it sees CWR, as receivers
+//! that follow RFC 3168 do.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::{
+        protocols::{checksum::update_checksum, layer2::ETHERNET2_HEADER_SIZE, layer3::ip::IpProtocol},
+        test_helpers::{self, SharedEngine},
+    },
+    runtime::{
+        memory::DemiBuffer,
+        network::socket::option::{CongestionControlAlgorithm, SocketOption},
+        OperationResult, QDesc, QToken,
+    },
+};
+use ::anyhow::Result;
+use ::std::{
+    net::SocketAddrV4,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Port on which Bob accepts connections.
+const BOB_PORT: u16 = 80;
+
+/// Size of each push of the transfer.
+const PUSH_SIZE: u16 = 8192;
+
+/// Number of pushes of the transfer.
+const NUM_PUSHES: usize = 16;
+
+/// The data frame that a switch marks with CE, counting from one, after which Bob echoes the mark on every ACK.
+const MARKED_DATA_FRAME: usize = 8;
+
+/// Virtual time that passes whenever the link is idle, so that timers eventually fire.
+const IDLE_TICK: Duration = Duration::from_millis(10);
+
+/// Number of idle ticks after which the test fails.
+const MAX_IDLE_TICKS: usize = 60_000;
+
+const TCP_FLAG_ECE: u8 = 1 << 6;
+const TCP_FLAG_CWR: u8 = 1 << 7;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A link from Carrie to Bob on which Bob latches ECE, as seen by Carrie, from the marked frame until Carrie sets CWR.
+struct LatchingLink {
+    bob: SharedEngine,
+    carrie: SharedEngine,
+    now: Instant,
+    /// Whether Bob echoes a congestion mark on its ACKs.
+    latched: bool,
+    /// Number of data frames that Carrie has sent.
+    num_data_frames: usize,
+    /// Number of ACKs that carried ECE to Carrie.
+    num_ece_acks: usize,
+    /// For each data frame that Carrie has sent with CWR, the number of ECE ACKs that had reached Carrie before it.
+    cwr_frames: Vec<usize>,
+}
+
+//======================================================================================================================
+// Tests
+//======================================================================================================================
+
+/// Tests that a DCTCP sender sets CWR once, on new data after it shrank cwnd for the echo, and that this ends the echo.
+#[test]
+fn test_ecn_cwr_ends_latched_echo() -> Result<()> {
+    let mut link: LatchingLink = LatchingLink::new(Instant::now());
+    let (bob_qd, carrie_qd): (QDesc, QDesc) = link.establish()?;
+
+    let mut push_qts: Vec<QToken> = Vec::with_capacity(NUM_PUSHES);
+    for _ in 0..NUM_PUSHES {
+        push_qts.push(link.carrie.tcp_push(carrie_qd, DemiBuffer::new(PUSH_SIZE))?);
+    }
+    let mut remaining: usize = NUM_PUSHES * PUSH_SIZE as usize;
+    while remaining > 0 {
+        let qt: QToken = link.bob.tcp_pop(bob_qd)?;
+        match link.wait(false, qt)? {
+            OperationResult::Pop(_, buf) if !buf.is_empty() && buf.len() <= remaining => remaining -= buf.len(),
+            result => anyhow::bail!("pop() has failed: {:?}", result),
+        }
+    }
+    for qt in push_qts {
+        match link.wait(true, qt)? {
+            OperationResult::Push => (),
+            result => anyhow::bail!("push() has failed: {:?}", result),
+        }
+    }
+
+    // Carrie heard the echo, answered it with CWR exactly once, and Bob stopped echoing once CWR reached Bob.
+    crate::ensure_eq!(link.num_ece_acks > 0, true);
+    crate::ensure_eq!(link.cwr_frames.len(), 1);
+    crate::ensure_eq!(link.cwr_frames[0] > 0, true);
+    crate::ensure_eq!(link.cwr_frames[0], link.num_ece_acks);
+    crate::ensure_eq!(link.latched, false);
+
+    Ok(())
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl LatchingLink {
+    /// Creates a link between Bob and Carrie, whose connections both use DCTCP and thus negotiate ECN.
+    fn new(now: Instant) -> Self {
+        Self {
+            bob: test_helpers::new_bob(now),
+            carrie: test_helpers::new_carrie(now),
+            now,
+            latched: false,
+            num_data_frames: 0,
+            num_ece_acks: 0,
+            cwr_frames: Vec::new(),
+        }
+    }
+
+    /// Establishes a connection from Carrie to Bob and returns the queue descriptors of both ends.
+    fn establish(&mut self) -> Result<(QDesc, QDesc)> {
+        let bob_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, BOB_PORT);
+        let dctcp: SocketOption = SocketOption::CongestionControl(CongestionControlAlgorithm::Dctcp);
+        let listen_qd: QDesc = self.bob.tcp_socket()?;
+        self.bob.tcp_set_socket_option(listen_qd, dctcp)?;
+        self.bob.tcp_bind(listen_qd, bob_addr)?;
+        self.bob.tcp_listen(listen_qd, 1)?;
+        let accept_qt: QToken = self.bob.tcp_accept(listen_qd)?;
+
+        let carrie_qd: QDesc = self.carrie.tcp_socket()?;
+        self.carrie.tcp_set_socket_option(carrie_qd, dctcp)?;
+        let connect_qt: QToken = self.carrie.tcp_connect(carrie_qd, bob_addr)?;
+        match self.wait(true, connect_qt)? {
+            OperationResult::Connect => (),
+            result => anyhow::bail!("connect() has failed: {:?}", result),
+        }
+        match self.wait(false, accept_qt)? {
+            OperationResult::Accept((bob_qd, _)) => Ok((bob_qd, carrie_qd)),
+            result => anyhow::bail!("accept() has failed: {:?}", result),
+        }
+    }
+
+    /// Moves the frames that Carrie and Bob have transmitted to each other, and returns how many there were.
+    fn round(&mut self) -> usize {
+        self.bob.poll();
+        self.carrie.poll();
+        let mut num_frames: usize = 0;
+        for frame in self.carrie.pop_all_frames() {
+            num_frames += 1;
+            if let Some(tcp_offset) = tcp_offset(&frame) {
+                if payload_len(&frame, tcp_offset) > 0 {
+                    self.num_data_frames += 1;
+                    if frame[tcp_offset + 13] & TCP_FLAG_CWR != 0 {
+                        self.cwr_frames.push(self.num_ece_acks);
+                        self.latched = false;
+                    }
+                    if self.num_data_frames == MARKED_DATA_FRAME {
+                        self.latched = true;
+                    }
+                }
+            }
+            self.bob.push_frame(frame);
+        }
+        for mut frame in self.bob.pop_all_frames() {
+            num_frames += 1;
+            if self.latched {
+                if let Some(tcp_offset) = tcp_offset(&frame) {
+                    set_ece(&mut frame, tcp_offset);
+                    self.num_ece_acks += 1;
+                }
+            }
+            self.carrie.push_frame(frame);
+        }
+        num_frames
+    }
+
+    /// Runs the link until the operation of `qt` completes on Carrie, if `on_carrie` is set, or on Bob otherwise.
+    fn wait(&mut self, on_carrie: bool, qt: QToken) -> Result<OperationResult> {
+        let mut idle_ticks: usize = 0;
+        loop {
+            let host: &SharedEngine = if on_carrie { &self.carrie } else { &self.bob };
+            if let Some((_, result)) = host.get_runtime().get_completed_task(&qt) {
+                return Ok(result);
+            }
+            if self.round() == 0 {
+                idle_ticks += 1;
+                if idle_ticks >= MAX_IDLE_TICKS {
+                    anyhow::bail!("operation did not complete in virtual time");
+                }
+                self.now += IDLE_TICK;
+                // All hosts of a thread share one clock.
+                self.bob.advance_clock(self.now);
+            }
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Gets the offset of the TCP header in `frame`, if the frame carries an IPv4/TCP segment.
+fn tcp_offset(frame: &DemiBuffer) -> Option<usize> {
+    let ipv4_offset: usize = ETHERNET2_HEADER_SIZE;
+    if frame.len() < ipv4_offset + 20
+        || frame[12..14] != [0x08, 0x00]
+        || frame[ipv4_offset + 9] != IpProtocol::TCP as u8
+    {
+        return None;
+    }
+    Some(ipv4_offset + (frame[ipv4_offset] & 0xf) as usize * 4)
+}
+
+/// Gets the length of the TCP payload of `frame`, whose TCP header is at `tcp_offset`. The payload may reside in a
+/// segment of its own, so this goes by the lengths in the headers.
+fn payload_len(frame: &DemiBuffer, tcp_offset: usize) -> usize {
+    let ipv4_offset: usize = ETHERNET2_HEADER_SIZE;
+    let ipv4_length: usize = u16::from_be_bytes([frame[ipv4_offset + 2], frame[ipv4_offset + 3]]) as usize;
+    ipv4_length - (tcp_offset - ipv4_offset) - (frame[tcp_offset + 12] >> 4) as usize * 4
+}
+
+/// Sets ECE on the TCP segment of `frame`, whose TCP header is at `tcp_offset`, and updates its checksum.
+fn set_ece(frame: &mut DemiBuffer, tcp_offset: usize) {
+    let old: u16 = u16::from_be_bytes([frame[tcp_offset + 12], frame[tcp_offset + 13]]);
+    let new: u16 = old | TCP_FLAG_ECE as u16;
+    let checksum: u16 = u16::from_be_bytes([frame[tcp_offset + 16], frame[tcp_offset + 17]]);
+    frame[tcp_offset + 13] |= TCP_FLAG_ECE;
+    frame[tcp_offset + 16..tcp_offset + 18].copy_from_slice(&update_checksum(checksum, old, new).to_be_bytes());
+}
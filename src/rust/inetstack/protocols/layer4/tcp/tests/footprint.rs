@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Measures the memory that idle TCP connections hold, which bounds how many long-lived connections a host can keep.
+//!
+//! This is a regression bound on the footprint that connections have today, not a sign that they are minimal. Each
+//! idle connection still parks its background coroutine (the receiver, acknowledger, retransmitter and sender that it
+//! joins), and its shared async values and queues remain allocations of their own next to the control block.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::test_helpers::{
+        self,
+        engine::{SharedEngine, TIMEOUT_SECONDS},
+        CountingAllocator,
+    },
+    runtime::{OperationResult, QDesc, QToken},
+};
+use ::anyhow::Result;
+use ::std::{net::SocketAddrV4, time::Instant};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of idle connections that we measure, so that growing the tables that hold connections averages out.
+const NUM_CONNECTIONS: usize = 256;
+
+/// Port on which Bob accepts connections.
+const BOB_PORT: u16 = 80;
+
+/// Largest number of heap bytes that an idle connection may hold, counting both of its endpoints. This covers the
+/// control blocks, parked background coroutines and separate shared state of both ends, and catches any change that
+/// brings back preallocated queues, as a single queue of a few thousand slots takes more than this.
+const MAX_BYTES_PER_CONNECTION: isize = 64 * 1024;
+
+//======================================================================================================================
+// Tests
+//======================================================================================================================
+
+/// Checks the heap bytes that an established connection holds while it is idle, counting both of its endpoints.
+#[test]
+fn test_idle_connection_footprint() -> Result<()> {
+    let now: Instant = Instant::now();
+    let mut bob: SharedEngine = test_helpers::new_bob(now);
+    let mut carrie: SharedEngine = test_helpers::new_carrie(now);
+    let bob_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, BOB_PORT);
+    let listen_qd: QDesc = bob.tcp_socket()?;
+    bob.tcp_bind(listen_qd, bob_addr)?;
+    bob.tcp_listen(listen_qd, NUM_CONNECTIONS)?;
+
+    // Establish a first connection to warm up the pools that connections draw from.
+    let mut connections: Vec<(QDesc, QDesc)> = Vec::with_capacity(NUM_CONNECTIONS + 1);
+    connections.push(establish(&mut bob, &mut carrie, listen_qd, bob_addr)?);
+
+    let live_bytes_before: isize = CountingAllocator::live_bytes();
+    for _ in 0..NUM_CONNECTIONS {
+        connections.push(establish(&mut bob, &mut carrie, listen_qd, bob_addr)?);
+    }
+    // Let both stacks settle and drop whatever they still send, so that only the state of idle connections remains.
+    bob.poll();
+    carrie.poll();
+    bob.pop_all_frames();
+    carrie.pop_all_frames();
+    let live_bytes_after: isize = CountingAllocator::live_bytes();
+
+    let bytes_per_connection: isize = (live_bytes_after - live_bytes_before) / NUM_CONNECTIONS as isize;
+    crate::ensure_eq!(
+        bytes_per_connection > 0,
+        true,
+        "idle connections hold {} bytes each",
+        bytes_per_connection
+    );
+    crate::ensure_eq!(
+        bytes_per_connection <= MAX_BYTES_PER_CONNECTION,
+        true,
+        "idle connections hold {} bytes each, more than {}",
+        bytes_per_connection,
+        MAX_BYTES_PER_CONNECTION
+    );
+
+    Ok(())
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Establishes a connection from Carrie to Bob and returns the queue descriptors of both ends.
+fn establish(
+    bob: &mut SharedEngine,
+    carrie: &mut SharedEngine,
+    listen_qd: QDesc,
+    bob_addr: SocketAddrV4,
+) -> Result<(QDesc, QDesc)> {
+    let accept_qt: QToken = bob.tcp_accept(listen_qd)?;
+    let carrie_qd: QDesc = carrie.tcp_socket()?;
+    let connect_qt: QToken = carrie.tcp_connect(carrie_qd, bob_addr)?;
+
+    // SYN.
+    carrie.poll();
+    bob.push_frame(carrie.pop_frame());
+    // SYN+ACK.
+    carrie.push_frame(bob.pop_frame());
+    match carrie.wait(connect_qt, TIMEOUT_SECONDS)? {
+        (_, OperationResult::Connect) => (),
+        _ => anyhow::bail!("connect() has failed"),
+    }
+    // ACK.
+    bob.push_frame(carrie.pop_frame());
+    let bob_qd: QDesc = match bob.wait(accept_qt, TIMEOUT_SECONDS)? {
+        (_, OperationResult::Accept((qd, _))) => qd,
+        _ => anyhow::bail!("accept() has failed"),
+    };
+
+    Ok((bob_qd, carrie_qd))
+}
@@ -5,5 +5,9 @@
 // Exports
 //======================================================================================================================
 
+mod ecn;
+mod footprint;
+#[cfg(target_os = "linux")]
+mod perf;
 #[cfg(debug_assertions)]
 mod simulator;
@@ -0,0 +1,462 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Deterministic performance regression suite for the TCP datapath.
+//!
+//! Each workload runs a few stacks over a simulated link that moves frames between them in rounds, and moves a virtual
+//! clock forward only when the link is idle, so that timers fire at the same points in every run. No NIC is involved.
+//! Packet, allocation and timer counts per operation thus only change when the datapath changes, which makes them
+//! suitable to gate pull requests on. Instruction and cycle counts come from hardware counters when the host exposes
+//! them. When [REPORT_ENV_VAR] is set, each workload prints a JSON line that `tools/benchmark.py` tracks against a
+//! baseline; otherwise the suite runs quietly along with the other unit tests.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::test_helpers::{self, physical_layer::SharedTestPhysicalLayer, CountingAllocator, SharedEngine},
+    perftools::stats,
+    runtime::{memory::DemiBuffer, types::demi_stats_t, OperationResult},
+    MacAddress, QDesc, QToken,
+};
+use ::anyhow::Result;
+use ::std::{
+    collections::VecDeque,
+    env, mem,
+    net::SocketAddrV4,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Environment variable that turns on the reports of the workloads (e.g., `make run-benchmarks-sim` sets it).
+const REPORT_ENV_VAR: &str = "DEMIKERNEL_PERF_REPORT";
+
+/// Port on which Bob accepts connections.
+const BOB_PORT: u16 = 80;
+
+/// Virtual time that passes whenever the link is idle, so that timers eventually fire.
+const IDLE_TICK: Duration = Duration::from_millis(10);
+
+/// Virtual time after which a workload that makes no progress fails.
+const MAX_VIRTUAL_TIME: Duration = Duration::from_secs(600);
+
+/// Size of each push of bulk transfers.
+const BULK_PUSH_SIZE: u16 = 8192;
+
+/// Number of pushes of bulk transfers.
+const BULK_NUM_PUSHES: usize = 1024;
+
+/// One in this many frames is dropped on lossy links.
+const LOSS_PERIOD: u64 = 50;
+
+/// Number of connections that are open at the same time.
+const NUM_CONNECTIONS: usize = 10_000;
+
+/// Number of connections that are set up at once.
+const CONNECTION_BATCH: usize = 64;
+
+/// Number of connections that each sender of an incast opens to the receiver.
+const INCAST_FLOWS_PER_SENDER: usize = 16;
+
+/// Size of the response that each connection of an incast sends to the receiver.
+const INCAST_RESPONSE_SIZE: u16 = 32768;
+
+/// Number of frames that the switch port in front of the receiver of an incast buffers per round.
+const INCAST_PORT_BUFFER: usize = 32;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Hosts that exchange frames over a simulated link, along with a virtual clock.
+struct Network {
+    hosts: Vec<SharedEngine>,
+    macs: Vec<MacAddress>,
+    now: Instant,
+    /// Drop one frame in this many, if set.
+    loss_period: Option<u64>,
+    /// Most frames that a host may receive per round, if set. Frames past that are dropped.
+    port_buffer: Option<usize>,
+    /// Number of frames that hosts have transmitted, including those that the link dropped.
+    num_frames: u64,
+}
+
+/// Counters at the start of a measurement.
+struct Measurement {
+    num_frames: u64,
+    allocations: u64,
+    stats: demi_stats_t,
+    instructions: Option<(HardwareCounter, u64)>,
+    cycles: Option<(HardwareCounter, u64)>,
+}
+
+/// Hardware event counter of the calling thread, in user space only, as read through perf_event_open(2).
+struct HardwareCounter(libc::c_int);
+
+/// Leading fields of `struct perf_event_attr`, which the kernel accepts on their own (PERF_ATTR_SIZE_VER0). Only the
+/// kernel reads them.
+#[repr(C)]
+#[derive(Default)]
+#[allow(dead_code)]
+struct PerfEventAttr {
+    type_: u32,
+    size: u32,
+    config: u64,
+    sample_period: u64,
+    sample_type: u64,
+    read_format: u64,
+    flags: u64,
+    wakeup_events: u32,
+    bp_type: u32,
+    config1: u64,
+}
+
+//======================================================================================================================
+// Tests
+//======================================================================================================================
+
+/// Measures the cost of a bulk transfer from Carrie to Bob.
+#[test]
+fn test_perf_bulk_transfer() -> Result<()> {
+    let mut network: Network = Network::new(Instant::now(), false)?;
+    let (bob_qd, carrie_qd): (QDesc, QDesc) = network.establish_one(1)?;
+
+    let measurement: Measurement = Measurement::start(&network);
+    network.bulk_transfer(1, carrie_qd, 0, bob_qd, BULK_NUM_PUSHES)?;
+    measurement.report("sim-tcp-bulk", &network, BULK_NUM_PUSHES)
+}
+
+/// Measures the cost of a bulk transfer from Carrie to Bob over a link that drops frames.
+#[test]
+fn test_perf_bulk_transfer_lossy() -> Result<()> {
+    let mut network: Network = Network::new(Instant::now(), false)?;
+    let (bob_qd, carrie_qd): (QDesc, QDesc) = network.establish_one(1)?;
+
+    network.loss_period = Some(LOSS_PERIOD);
+    let measurement: Measurement = Measurement::start(&network);
+    network.bulk_transfer(1, carrie_qd, 0, bob_qd, BULK_NUM_PUSHES)?;
+    measurement.report("sim-tcp-bulk-lossy", &network, BULK_NUM_PUSHES)
+}
+
+/// Measures the cost of setting up many connections from Carrie to Bob, all of which stay open.
+#[test]
+fn test_perf_concurrent_connections() -> Result<()> {
+    let mut network: Network = Network::new(Instant::now(), false)?;
+    let listen_qd: QDesc = network.listen(NUM_CONNECTIONS)?;
+
+    let measurement: Measurement = Measurement::start(&network);
+    let mut connections: Vec<(QDesc, QDesc)> = Vec::with_capacity(NUM_CONNECTIONS);
+    while connections.len() < NUM_CONNECTIONS {
+        let batch: usize = CONNECTION_BATCH.min(NUM_CONNECTIONS - connections.len());
+        connections.extend(network.establish(1, listen_qd, batch)?);
+    }
+    measurement.report("sim-tcp-connect", &network, NUM_CONNECTIONS)
+}
+
+/// Measures the cost of an incast: Alice and Carrie answer Bob on many connections at once, through a switch port that
+/// drops what it cannot buffer.
+#[test]
+fn test_perf_incast() -> Result<()> {
+    let mut network: Network = Network::new(Instant::now(), true)?;
+    let listen_qd: QDesc = network.listen(2 * INCAST_FLOWS_PER_SENDER)?;
+    let mut flows: Vec<(usize, QDesc, QDesc)> = Vec::with_capacity(2 * INCAST_FLOWS_PER_SENDER);
+    for sender in [1, 2] {
+        for (bob_qd, sender_qd) in network.establish(sender, listen_qd, INCAST_FLOWS_PER_SENDER)? {
+            flows.push((sender, sender_qd, bob_qd));
+        }
+    }
+
+    network.port_buffer = Some(INCAST_PORT_BUFFER);
+    let measurement: Measurement = Measurement::start(&network);
+    let mut push_qts: Vec<(usize, QToken)> = Vec::with_capacity(flows.len());
+    for (sender, sender_qd, _) in flows.iter() {
+        let qt: QToken = network.hosts[*sender].tcp_push(*sender_qd, DemiBuffer::new(INCAST_RESPONSE_SIZE))?;
+        push_qts.push((*sender, qt));
+    }
+    for (_, _, bob_qd) in flows.iter() {
+        network.receive(0, *bob_qd, INCAST_RESPONSE_SIZE as usize)?;
+    }
+    for (sender, qt) in push_qts {
+        network.wait_push(sender, qt)?;
+    }
+    measurement.report("sim-tcp-incast", &network, flows.len())
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Network {
+    /// Creates a link between Bob, which is always the first host, and Carrie, and Alice if `with_alice` is set.
+    fn new(now: Instant, with_alice: bool) -> Result<Self> {
+        let mut hosts: Vec<SharedEngine> = vec![test_helpers::new_bob(now), test_helpers::new_carrie(now)];
+        let mut macs: Vec<MacAddress> = vec![test_helpers::BOB_MAC, test_helpers::CARRIE_MAC];
+        if with_alice {
+            let network: SharedTestPhysicalLayer = SharedTestPhysicalLayer::new_test(now);
+            hosts.push(SharedEngine::new(test_helpers::ALICE_CONFIG_PATH, network, now)?);
+            macs.push(test_helpers::ALICE_MAC);
+        }
+        Ok(Self {
+            hosts,
+            macs,
+            now,
+            loss_period: None,
+            port_buffer: None,
+            num_frames: 0,
+        })
+    }
+
+    /// Moves the frames that hosts have transmitted to their destinations, and returns how many there were.
+    fn round(&mut self) -> Result<usize> {
+        for host in self.hosts.iter() {
+            host.poll();
+        }
+        let mut num_received: Vec<usize> = vec![0; self.hosts.len()];
+        let mut num_sent: usize = 0;
+        for src in 0..self.hosts.len() {
+            let frames: VecDeque<DemiBuffer> = self.hosts[src].pop_all_frames();
+            for frame in frames {
+                num_sent += 1;
+                self.num_frames += 1;
+                if matches!(self.loss_period, Some(period) if self.num_frames % period == 0) {
+                    continue;
+                }
+                let dst_mac: MacAddress = MacAddress::from_bytes(&frame[0..6]);
+                if dst_mac.is_broadcast() {
+                    for dst in (0..self.hosts.len()).filter(|dst| *dst != src) {
+                        self.deliver(dst, DemiBuffer::from_slice(&frame)?, &mut num_received);
+                    }
+                } else if let Some(dst) = self.macs.iter().position(|mac| *mac == dst_mac) {
+                    self.deliver(dst, frame, &mut num_received);
+                }
+            }
+        }
+        Ok(num_sent)
+    }
+
+    /// Hands a frame to `dst`, unless its port has already received as many frames as it buffers in this round.
+    fn deliver(&mut self, dst: usize, frame: DemiBuffer, num_received: &mut [usize]) {
+        if matches!(self.port_buffer, Some(limit) if num_received[dst] >= limit) {
+            return;
+        }
+        num_received[dst] += 1;
+        self.hosts[dst].push_frame(frame);
+    }
+
+    /// Runs the link until the operation of `qt` on `host` completes, and returns its result.
+    fn wait(&mut self, host: usize, qt: QToken) -> Result<OperationResult> {
+        let deadline: Instant = self.now + MAX_VIRTUAL_TIME;
+        loop {
+            if let Some((_, result)) = self.hosts[host].get_runtime().get_completed_task(&qt) {
+                return Ok(result);
+            }
+            if self.round()? == 0 {
+                if self.now >= deadline {
+                    anyhow::bail!("operation did not complete in virtual time");
+                }
+                self.now += IDLE_TICK;
+                // All hosts of a thread share one clock.
+                self.hosts[0].advance_clock(self.now);
+            }
+        }
+    }
+
+    /// Runs the link until the push of `qt` on `host` completes.
+    fn wait_push(&mut self, host: usize, qt: QToken) -> Result<()> {
+        match self.wait(host, qt)? {
+            OperationResult::Push => Ok(()),
+            result => anyhow::bail!("push() has failed: {:?}", result),
+        }
+    }
+
+    /// Makes Bob listen for up to `backlog` connections.
+    fn listen(&mut self, backlog: usize) -> Result<QDesc> {
+        let bob_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, BOB_PORT);
+        let listen_qd: QDesc = self.hosts[0].tcp_socket()?;
+        self.hosts[0].tcp_bind(listen_qd, bob_addr)?;
+        self.hosts[0].tcp_listen(listen_qd, backlog)?;
+        Ok(listen_qd)
+    }
+
+    /// Establishes `num` connections at once from `client` to Bob, and returns the queue descriptors of both ends.
+    fn establish(&mut self, client: usize, listen_qd: QDesc, num: usize) -> Result<Vec<(QDesc, QDesc)>> {
+        let bob_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, BOB_PORT);
+        let mut pending: Vec<(QToken, QDesc, QToken)> = Vec::with_capacity(num);
+        for _ in 0..num {
+            let accept_qt: QToken = self.hosts[0].tcp_accept(listen_qd)?;
+            let client_qd: QDesc = self.hosts[client].tcp_socket()?;
+            let connect_qt: QToken = self.hosts[client].tcp_connect(client_qd, bob_addr)?;
+            pending.push((accept_qt, client_qd, connect_qt));
+        }
+
+        let mut connections: Vec<(QDesc, QDesc)> = Vec::with_capacity(num);
+        for (accept_qt, client_qd, connect_qt) in pending {
+            match self.wait(client, connect_qt)? {
+                OperationResult::Connect => (),
+                result => anyhow::bail!("connect() has failed: {:?}", result),
+            }
+            match self.wait(0, accept_qt)? {
+                OperationResult::Accept((bob_qd, _)) => connections.push((bob_qd, client_qd)),
+                result => anyhow::bail!("accept() has failed: {:?}", result),
+            }
+        }
+        Ok(connections)
+    }
+
+    /// Establishes a single connection from `client` to Bob.
+    fn establish_one(&mut self, client: usize) -> Result<(QDesc, QDesc)> {
+        let listen_qd: QDesc = self.listen(1)?;
+        match self.establish(client, listen_qd, 1)?.pop() {
+            Some(connection) => Ok(connection),
+            None => anyhow::bail!("no connection was established"),
+        }
+    }
+
+    /// Pushes `num_pushes` buffers at once from `sender` and pops them all on `receiver`.
+    fn bulk_transfer(
+        &mut self,
+        sender: usize,
+        sender_qd: QDesc,
+        receiver: usize,
+        receiver_qd: QDesc,
+        num_pushes: usize,
+    ) -> Result<()> {
+        let mut push_qts: Vec<QToken> = Vec::with_capacity(num_pushes);
+        for _ in 0..num_pushes {
+            push_qts.push(self.hosts[sender].tcp_push(sender_qd, DemiBuffer::new(BULK_PUSH_SIZE))?);
+        }
+        self.receive(receiver, receiver_qd, num_pushes * BULK_PUSH_SIZE as usize)?;
+        for qt in push_qts {
+            self.wait_push(sender, qt)?;
+        }
+        Ok(())
+    }
+
+    /// Pops `len` bytes on `host`.
+    fn receive(&mut self, host: usize, qd: QDesc, len: usize) -> Result<()> {
+        let mut remaining: usize = len;
+        while remaining > 0 {
+            let qt: QToken = self.hosts[host].tcp_pop(qd)?;
+            match self.wait(host, qt)? {
+                OperationResult::Pop(_, buf) if !buf.is_empty() && buf.len() <= remaining => remaining -= buf.len(),
+                result => anyhow::bail!("pop() has failed: {:?}", result),
+            }
+        }
+        Ok(())
+    }
+}
+
+impl Measurement {
+    fn start(network: &Network) -> Self {
+        let start =
+            |counter: Option<HardwareCounter>| counter.and_then(|counter| counter.read().map(|value| (counter, value)));
+        Self {
+            num_frames: network.num_frames,
+            allocations: CountingAllocator::allocations(),
+            stats: stats::snapshot(),
+            instructions: start(HardwareCounter::open(HardwareCounter::INSTRUCTIONS)),
+            cycles: start(HardwareCounter::open(HardwareCounter::CPU_CYCLES)),
+        }
+    }
+
+    /// Prints the costs since the start of the measurement, per operation and per packet, if [REPORT_ENV_VAR] is set.
+    /// Counters cover all hosts, and allocations include the buffers that the workload pushes.
+    fn report(self, name: &str, network: &Network, num_ops: usize) -> Result<()> {
+        let allocations: u64 = CountingAllocator::allocations() - self.allocations;
+        let now: demi_stats_t = stats::snapshot();
+        let num_frames: u64 = network.num_frames - self.num_frames;
+        crate::ensure_eq!(num_frames > 0, true);
+        if env::var_os(REPORT_ENV_VAR).is_none() {
+            return Ok(());
+        }
+
+        let timer_ops: u64 = (now.timer_arms + now.timer_cancels + now.timer_fires)
+            - (self.stats.timer_arms + self.stats.timer_cancels + self.stats.timer_fires);
+        let retransmits: u64 = now.tcp_retransmits - self.stats.tcp_retransmits;
+        let per_packet = |counter: Option<(HardwareCounter, u64)>| -> String {
+            match counter.and_then(|(counter, start)| counter.read().map(|end| end - start)) {
+                Some(count) => format!("{:.1}", count as f64 / num_frames as f64),
+                None => "null".to_string(),
+            }
+        };
+        let per_op = |count: u64| -> String { format!("{:.2}", count as f64 / num_ops as f64) };
+
+        println!(
+            "{{\"benchmark\": \"{}\", \"ops\": {}, \"packets_per_op\": {}, \"allocs_per_op\": {}, \"timer_ops_per_op\": \
+             {}, \"retransmits_per_op\": {}, \"instructions_per_packet\": {}, \"cycles_per_packet\": {}}}",
+            name,
+            num_ops,
+            per_op(num_frames),
+            per_op(allocations),
+            per_op(timer_ops),
+            per_op(retransmits),
+            per_packet(self.instructions),
+            per_packet(self.cycles),
+        );
+        Ok(())
+    }
+}
+
+impl HardwareCounter {
+    const PERF_TYPE_HARDWARE: u32 = 0;
+    const CPU_CYCLES: u64 = 0;
+    const INSTRUCTIONS: u64 = 1;
+    /// Flags that leave out the kernel and the hypervisor.
+    const EXCLUDE_KERNEL_AND_HV: u64 = (1 << 5) | (1 << 6);
+
+    /// Starts counting the hardware event `config`. Most containers and virtual machines do not expose hardware
+    /// counters, in which case this returns nothing.
+    fn open(config: u64) -> Option<Self> {
+        let attr: PerfEventAttr = PerfEventAttr {
+            type_: Self::PERF_TYPE_HARDWARE,
+            size: mem::size_of::<PerfEventAttr>() as u32,
+            config,
+            flags: Self::EXCLUDE_KERNEL_AND_HV,
+            ..Default::default()
+        };
+        // Count this thread on any CPU.
+        let fd: libc::c_long = unsafe {
+            libc::syscall(
+                libc::SYS_perf_event_open,
+                &attr as *const PerfEventAttr,
+                0 as libc::pid_t,
+                -1 as libc::c_int,
+                -1 as libc::c_int,
+                0 as libc::c_ulong,
+            )
+        };
+        if fd < 0 {
+            return None;
+        }
+        Some(Self(fd as libc::c_int))
+    }
+
+    fn read(&self) -> Option<u64> {
+        let mut value: u64 = 0;
+        let len: isize = unsafe {
+            libc::read(
+                self.0,
+                &mut value as *mut u64 as *mut libc::c_void,
+                mem::size_of::<u64>(),
+            )
+        };
+        if len != mem::size_of::<u64>() as isize {
+            return None;
+        }
+        Some(value)
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for HardwareCounter {
+    fn drop(&mut self) {
+        unsafe { libc::close(self.0) };
+    }
+}
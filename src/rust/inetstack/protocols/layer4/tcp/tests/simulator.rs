@@ -748,6 +748,7 @@ impl Simulation {
             urgent_pointer: 0,
             num_options,
             option_list,
+            ce: false,
         }
     }
 
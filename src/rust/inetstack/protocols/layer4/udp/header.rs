@@ -6,11 +6,14 @@
 //======================================================================================================================
 
 use crate::{
-    inetstack::protocols::layer3::ip::IpProtocol,
-    runtime::{fail::Fail, memory::DemiBuffer},
+    inetstack::protocols::{compute_generic_checksum, compute_segments_checksum, fold16, layer3::ip::IpProtocol},
+    runtime::{
+        fail::Fail,
+        memory::{DemiBuffer, DemiBufferSegments},
+    },
 };
 use ::libc::EBADMSG;
-use ::std::{net::Ipv4Addr, slice::ChunksExact};
+use ::std::{iter, net::Ipv4Addr};
 
 //======================================================================================================================
 // Constants
@@ -81,7 +84,7 @@ impl UdpHeader {
             // Check if we should skip checksum verification.
             if checksum != 0 {
                 // No, so check if checksum value matches what we expect.
-                if checksum != Self::checksum(src_ipv4_addr, dst_ipv4_addr, hdr_buf, payload_buf) {
+                if checksum != Self::checksum(src_ipv4_addr, dst_ipv4_addr, hdr_buf, iter::once(payload_buf)) {
                     return Err(Fail::new(EBADMSG, "UDP checksum mismatch"));
                 }
             }
@@ -93,7 +96,8 @@ impl UdpHeader {
         Ok(header)
     }
 
-    /// Serializes and prepends the UDP header on to the packet in [buf].
+    /// Serializes and prepends the UDP header on to the packet in [buf]. The payload may follow the header in the first
+    /// segment of the packet, be chained behind it in any number of segments, or both.
     pub fn serialize_and_attach(
         &self,
         buf: &mut DemiBuffer,
@@ -103,12 +107,9 @@ impl UdpHeader {
     ) {
         // Create room for the header in the packet.
         buf.prepend(UDP_HEADER_SIZE).expect("Should have enough headroom");
-        let buf_size_bytes: usize = buf.len();
+        let buf_size_bytes: usize = buf.chain_len();
 
-        // Split the packet up into two slices: one for the header and one for the payload.
-        let (hdr_buf, payload): (&mut [u8], &mut [u8]) = buf[..].split_at_mut(UDP_HEADER_SIZE);
-
-        let fixed_buf: &mut [u8; UDP_HEADER_SIZE] = (&mut hdr_buf[..UDP_HEADER_SIZE]).try_into().unwrap();
+        let fixed_buf: &mut [u8; UDP_HEADER_SIZE] = (&mut buf[..UDP_HEADER_SIZE]).try_into().unwrap();
 
         // Write source port.
         fixed_buf[0..2].copy_from_slice(&self.src_port.to_be_bytes());
@@ -123,9 +124,19 @@ impl UdpHeader {
         let checksum: u16 = if checksum_offload {
             0
         } else {
-            Self::checksum(src_ipv4_addr, dst_ipv4_addr, &fixed_buf[..], payload)
+            let mut segments: DemiBufferSegments = buf.segments();
+            // Split the first segment into the header and whatever payload follows it, which the remaining segments
+            // continue.
+            // This unwrap won't panic, as a buffer always has a first segment.
+            let (hdr_buf, payload): (&[u8], &[u8]) = segments.next().unwrap().split_at(UDP_HEADER_SIZE);
+            Self::checksum(
+                src_ipv4_addr,
+                dst_ipv4_addr,
+                hdr_buf,
+                iter::once(payload).chain(segments),
+            )
         };
-        fixed_buf[6..8].copy_from_slice(&checksum.to_be_bytes());
+        buf[6..8].copy_from_slice(&checksum.to_be_bytes());
         trace!("UDP header: {:?} packet size: {:?} bytes", self, buf_size_bytes);
     }
 
@@ -137,59 +148,24 @@ impl UdpHeader {
     /// multiple of two octets.
     ///
     /// TODO: Write a unit test for this function.
-    fn checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, udp_hdr: &[u8], data: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
-
-        // Source address (4 bytes)
-        let src_octets: [u8; 4] = src_ipv4_addr.octets();
-        state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-        state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
-
-        // Destination address (4 bytes)
-        let dst_octets: [u8; 4] = dst_ipv4_addr.octets();
-        state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-        state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-        // Padding zeros (1 byte) and UDP protocol number (1 byte)
-        state += u16::from_be_bytes([0, IpProtocol::UDP as u8]) as u32;
-
-        // UDP segment length (2 bytes)
-        state += (udp_hdr.len() + data.len()) as u32;
-
-        // Switch to UDP header.
-        let fixed_header: &[u8; UDP_HEADER_SIZE] = udp_hdr.try_into().unwrap();
-
-        // Source port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-        // Destination port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
-
-        // Payload Length (2 bytes)
-        state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-
-        // Checksum (2 bytes, all zeros)
-        state += 0;
-
-        // Payload.
-        let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-        while let Some(chunk) = chunks_iter.next() {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-        // Pad with zeros with payload has an odd number of bytes.
-        if let Some(&b) = chunks_iter.remainder().get(0) {
-            state += u16::from_be_bytes([b, 0]) as u32;
-        }
-
-        // NOTE: We don't need to subtract out 0xFFFF as we accumulate the sum.
-        // Since we use a u32 for intermediate state, we would need 2^16
-        // additions to overflow. This is well beyond the reach of the largest
-        // jumbo frames. The upshot is that the compiler can then optimize this
-        // final loop into a single branch-free code.
-        while state > 0xFFFF {
-            state -= 0xFFFF;
-        }
-        !state as u16
+    fn checksum<'a>(
+        src_ipv4_addr: &Ipv4Addr,
+        dst_ipv4_addr: &Ipv4Addr,
+        udp_hdr: &[u8],
+        data: impl Iterator<Item = &'a [u8]>,
+    ) -> u16 {
+        // Source address, destination address, padding zeros and UDP protocol number. The UDP segment length is only
+        // known once we have gone over the payload, so we add it last.
+        let mut state: u32 = compute_generic_checksum(&src_ipv4_addr.octets(), None);
+        state = compute_generic_checksum(&dst_ipv4_addr.octets(), Some(state));
+        state += IpProtocol::UDP as u32;
+
+        // UDP header without the checksum (bytes 6..8), and the payload, which may span several segments.
+        state = compute_generic_checksum(&udp_hdr[..6], Some(state));
+        let mut data_len: usize = 0;
+        state = compute_segments_checksum(data.inspect(|segment| data_len += segment.len()), Some(state));
+        state += (udp_hdr.len() + data_len) as u32;
+        fold16(state)
     }
 }
 
@@ -224,6 +200,36 @@ mod test {
         Ok(())
     }
 
+    // Tests that the checksum covers every segment of a payload chain, including segments of odd lengths.
+    #[test]
+    fn test_udp_checksum_chained_payload() -> Result<()> {
+        let src_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 1);
+        let dst_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 2);
+        let udp_hdr: UdpHeader = UdpHeader::new(0x32, 0x45);
+
+        // Three segments: a bit of payload behind the header, and two chained segments of odd lengths.
+        let data: Vec<u8> = (0..301).map(|i| i as u8).collect();
+        let mut buf: DemiBuffer = DemiBuffer::from_slice_with_headroom(&data[..3], UDP_HEADER_SIZE)?;
+        buf.chain(DemiBuffer::from_slice(&data[3..100])?)?;
+        buf.chain(DemiBuffer::from_slice(&data[100..])?)?;
+        crate::ensure_eq!(buf.num_segments(), 3);
+        udp_hdr.serialize_and_attach(&mut buf, &src_addr, &dst_addr, false);
+
+        // The checksum must be the same as that of the same datagram in a single buffer.
+        let mut flat: DemiBuffer = DemiBuffer::from_slice_with_headroom(&data, UDP_HEADER_SIZE)?;
+        udp_hdr.serialize_and_attach(&mut flat, &src_addr, &dst_addr, false);
+        crate::ensure_eq!(buf[6..8], flat[6..8]);
+
+        // And the receive side must accept it.
+        let mut buf: DemiBuffer = buf.linearize(0)?;
+        if let Err(e) = UdpHeader::parse_and_strip(&src_addr, &dst_addr, &mut buf, false) {
+            anyhow::bail!("could not parse: {:?}", e);
+        }
+        crate::ensure_eq!(&buf[..], &data[..]);
+
+        Ok(())
+    }
+
     #[test]
     fn test_udp_header_parsing() -> Result<()> {
         // Build fake IPv4 header.
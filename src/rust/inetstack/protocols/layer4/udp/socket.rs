@@ -7,7 +7,7 @@
 
 use crate::{
     collections::async_queue::AsyncQueue,
-    inetstack::protocols::{layer3::SharedLayer3Endpoint, layer4::udp::header::UdpHeader},
+    inetstack::protocols::{layer3::SharedLayer3Endpoint, layer4::udp::header::UdpHeader, prepare_payload},
     runtime::{fail::Fail, memory::DemiBuffer, network::unwrap_socketaddr, SharedObject},
 };
 use ::std::{
@@ -70,7 +70,7 @@ impl SharedUdpSocket {
         Ok(())
     }
 
-    pub async fn push(&mut self, remote: Option<SocketAddr>, mut buf: DemiBuffer) -> Result<(), Fail> {
+    pub async fn push(&mut self, remote: Option<SocketAddr>, buf: DemiBuffer) -> Result<(), Fail> {
         let remote: SocketAddrV4 = if let Some(remote) = remote {
             unwrap_socketaddr(remote)?
         } else {
@@ -88,6 +88,7 @@ impl SharedUdpSocket {
         };
         let udp_header: UdpHeader = UdpHeader::new(port, remote.port());
         debug!("UDP send {:?}", udp_header);
+        let mut buf: DemiBuffer = prepare_payload(buf)?;
         udp_header.serialize_and_attach(&mut buf, &self.local_ipv4_addr, remote.ip(), self.checksum_offload);
         // Send the packet to the lower layer.
         self.layer3_endpoint
@@ -5,16 +5,19 @@
 // Exports
 //======================================================================================================================
 
+pub mod checksum;
 pub mod layer1;
 pub mod layer2;
 pub mod layer3;
 pub mod layer4;
 
+pub use self::checksum::{compute_generic_checksum, compute_segments_checksum, fold16};
+
 //======================================================================================================================
 // Imports
 //======================================================================================================================
 
-use ::std::slice::ChunksExact;
+use crate::runtime::{fail::Fail, memory::DemiBuffer};
 
 //======================================================================================================================
 // Constants
@@ -37,35 +40,19 @@ pub enum Protocol {
 // Standalone Functions
 //======================================================================================================================
 
-/// Computes the generic checksum of a bytes array.
-///
-/// This iterates all 16-bit array elements, summing
-/// the values into a 32-bit variable. This functions
-/// paddies with zero an octet at the end (if necessary)
-/// to turn into a 16-bit element. Also, this may use
-/// an initial value depending on the parameter `"start"`.
-pub fn compute_generic_checksum(buf: &[u8], start: Option<u32>) -> u32 {
-    let mut state: u32 = match start {
-        Some(state) => state,
-        None => 0xFFFF,
-    };
-
-    let mut chunks_iter: ChunksExact<u8> = buf.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
+/// Prepares the payload of an outgoing packet to have its headers attached. DPDK-allocated payloads are sent without
+/// copying, and they are clones of application buffers or of other packets (e.g., when TCP splits or retransmits data),
+/// so their headroom is not ours to write to. Payloads in registered application memory have no headroom at all. The
+/// headers of both go into a separate segment in front of them instead.
+pub fn prepare_payload(payload: DemiBuffer) -> Result<DemiBuffer, Fail> {
+    #[cfg(feature = "libdpdk")]
+    if payload.is_dpdk_allocated() {
+        return payload.prepend_segment(MAX_HEADER_SIZE as u16);
     }
 
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
+    if payload.is_external() {
+        return payload.prepend_segment(MAX_HEADER_SIZE as u16);
     }
 
-    state
-}
-
-/// Folds 32-bit sum into 16-bit checksum value.
-pub fn fold16(mut state: u32) -> u16 {
-    while state > 0xFFFF {
-        state -= 0xFFFF;
-    }
-    !state as u16
+    Ok(payload)
 }
@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::mimalloc::MiMalloc;
+use ::std::{
+    alloc::{GlobalAlloc, Layout},
+    cell::Cell,
+};
+
+//======================================================================================================================
+// Thread local variable
+//======================================================================================================================
+
+thread_local! {
+/// Heap bytes that this thread has allocated and not yet freed.
+static LIVE_BYTES: Cell<isize> = const { Cell::new(0) };
+/// Heap allocations that this thread has made, including reallocations.
+static ALLOCATIONS: Cell<u64> = const { Cell::new(0) };
+}
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Allocator of the unit tests, which wraps the allocator of the library and counts the heap bytes and allocations of
+/// each thread, so that tests can measure the memory footprint and the allocation rate of what they build. Tests run on
+/// their own threads, so they do not see each other's allocations.
+pub struct CountingAllocator;
+
+#[global_allocator]
+static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl CountingAllocator {
+    /// Returns the heap bytes that the calling thread holds. Memory freed by another thread than the one that
+    /// allocated it makes this drift, so only differences between two readings on the same thread are meaningful.
+    pub fn live_bytes() -> isize {
+        LIVE_BYTES.with(|bytes| bytes.get())
+    }
+
+    /// Returns the number of heap allocations that the calling thread has made so far.
+    pub fn allocations() -> u64 {
+        ALLOCATIONS.with(|allocations| allocations.get())
+    }
+
+    fn track(delta: isize) {
+        // This may run while the thread is being torn down, which is fine as nobody reads the counter anymore.
+        let _ = LIVE_BYTES.try_with(|bytes| bytes.set(bytes.get() + delta));
+    }
+
+    fn track_allocation(delta: isize) {
+        Self::track(delta);
+        let _ = ALLOCATIONS.try_with(|allocations| allocations.set(allocations.get() + 1));
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr: *mut u8 = MiMalloc.alloc(layout);
+        if !ptr.is_null() {
+            Self::track_allocation(layout.size() as isize);
+        }
+        ptr
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        let ptr: *mut u8 = MiMalloc.alloc_zeroed(layout);
+        if !ptr.is_null() {
+            Self::track_allocation(layout.size() as isize);
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        MiMalloc.dealloc(ptr, layout);
+        Self::track(-(layout.size() as isize));
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new_ptr: *mut u8 = MiMalloc.realloc(ptr, layout, new_size);
+        if !new_ptr.is_null() {
+            Self::track_allocation(new_size as isize - layout.size() as isize);
+        }
+        new_ptr
+    }
+}
@@ -8,7 +8,7 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::types::MacAddress,
+        network::{socket::option::SocketOption, types::MacAddress},
         OperationResult, QDesc, QToken, SharedDemiRuntime, SharedObject,
     },
 };
@@ -127,6 +127,10 @@ impl SharedEngine {
         self.libos.listen(socket_fd, backlog)
     }
 
+    pub fn tcp_set_socket_option(&mut self, socket_fd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        self.libos.set_socket_option(socket_fd, option)
+    }
+
     pub async fn arp_query(self, ipv4_addr: Ipv4Addr) -> Result<MacAddress, Fail> {
         self.libos.get_transport().arp_query(ipv4_addr).await
     }
@@ -1,8 +1,10 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+pub mod allocator;
 pub mod engine;
 pub mod physical_layer;
+pub use allocator::CountingAllocator;
 pub use engine::SharedEngine;
 pub use physical_layer::SharedTestPhysicalLayer;
 
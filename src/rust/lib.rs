@@ -15,7 +15,6 @@ pub mod inetstack;
 mod pal;
 pub mod runtime;
 
-#[cfg(feature = "profiler")]
 pub mod perftools;
 
 extern crate test;
@@ -44,8 +43,11 @@ pub use crate::runtime::{
 
 pub mod demikernel;
 
+#[cfg(not(test))]
 use mimalloc::MiMalloc;
 
+// Unit tests wrap this allocator to count heap bytes (see inetstack::test_helpers::allocator).
+#[cfg(not(test))]
 #[global_allocator]
 static GLOBAL: MiMalloc = MiMalloc;
 
@@ -236,7 +238,7 @@ macro_rules! async_timer {
 #[macro_export]
 macro_rules! coroutine_timer {
     ($name:expr, $future:expr) => {
-        Box::pin($crate::perftools::profiler::Profiler::coroutine_scope($name, $future).fuse())
+        $crate::perftools::profiler::Profiler::coroutine_scope($name, Box::pin($future)).fuse()
     };
 }
 
@@ -82,6 +82,16 @@ pub const SOL_SOCKET: i32 = libc::SOL_SOCKET;
 #[cfg(target_os = "linux")]
 pub const SO_LINGER: i32 = libc::SO_LINGER;
 
+#[cfg(target_os = "linux")]
+pub const IPPROTO_TCP: i32 = libc::IPPROTO_TCP;
+
+#[cfg(target_os = "linux")]
+pub const TCP_CONGESTION: i32 = libc::TCP_CONGESTION;
+
+/// Longest name of a congestion control algorithm that TCP_CONGESTION returns, including the null terminator.
+#[cfg(target_os = "linux")]
+pub const TCP_CA_NAME_MAX: usize = 16;
+
 //======================================================================================================================
 // Windows data structures
 //======================================================================================================================
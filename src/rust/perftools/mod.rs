@@ -1,4 +1,6 @@
 // Copyright(c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+#[cfg(feature = "profiler")]
 pub mod profiler;
+pub mod stats;
@@ -0,0 +1,271 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Always-on counters for the Demikernel datapath.
+//!
+//! Unlike the profiler, which builds a tree of named scopes and is only compiled in with the profiler feature, these
+//! counters live in a fixed-layout block per thread and every update is a plain increment, so they are cheap enough to
+//! leave on in production. Each thread runs its own Demikernel instance and binds its own device queue, so the block
+//! of a thread holds the counters of that queue. The block has the layout of [demi_stats_t] and stays at the same
+//! address for the lifetime of the thread, so monitoring agents on other threads may read it at any time without
+//! pausing the datapath.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::types::{demi_stats_t, DEMI_STATS_POLL_BUCKETS};
+use ::std::{
+    mem,
+    sync::atomic::{AtomicU64, Ordering},
+};
+
+//======================================================================================================================
+// Thread local variable
+//======================================================================================================================
+
+thread_local! {
+/// The counters of the Demikernel instance that runs on this thread.
+static STATS: Stats = const { Stats::new() };
+}
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Live counters, which mirror the fields of [demi_stats_t]. They are atomics only so that other threads may read
+/// them: this thread is the only writer, so updates never need a read-modify-write instruction.
+#[repr(C)]
+struct Stats {
+    rx_packets: AtomicU64,
+    rx_bursts: AtomicU64,
+    rx_empty_bursts: AtomicU64,
+    tx_packets: AtomicU64,
+    tx_bursts: AtomicU64,
+    tx_drops: AtomicU64,
+    mempool_misses: AtomicU64,
+    tcp_retransmits: AtomicU64,
+    tcp_rto_fires: AtomicU64,
+    wait_any_scans: AtomicU64,
+    wait_any_scanned_qts: AtomicU64,
+    timer_arms: AtomicU64,
+    timer_cancels: AtomicU64,
+    timer_fires: AtomicU64,
+    poll_histogram: [AtomicU64; DEMI_STATS_POLL_BUCKETS],
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Stats {
+    const fn new() -> Self {
+        Self {
+            rx_packets: AtomicU64::new(0),
+            rx_bursts: AtomicU64::new(0),
+            rx_empty_bursts: AtomicU64::new(0),
+            tx_packets: AtomicU64::new(0),
+            tx_bursts: AtomicU64::new(0),
+            tx_drops: AtomicU64::new(0),
+            mempool_misses: AtomicU64::new(0),
+            tcp_retransmits: AtomicU64::new(0),
+            tcp_rto_fires: AtomicU64::new(0),
+            wait_any_scans: AtomicU64::new(0),
+            wait_any_scanned_qts: AtomicU64::new(0),
+            timer_arms: AtomicU64::new(0),
+            timer_cancels: AtomicU64::new(0),
+            timer_fires: AtomicU64::new(0),
+            poll_histogram: [const { AtomicU64::new(0) }; DEMI_STATS_POLL_BUCKETS],
+        }
+    }
+
+    /// Returns the value of all counters. Counters are read one at a time, so they may be slightly out of sync with
+    /// one another.
+    fn snapshot(&self) -> demi_stats_t {
+        let mut poll_histogram: [u64; DEMI_STATS_POLL_BUCKETS] = [0; DEMI_STATS_POLL_BUCKETS];
+        for (bucket, counter) in poll_histogram.iter_mut().zip(self.poll_histogram.iter()) {
+            *bucket = counter.load(Ordering::Relaxed);
+        }
+        demi_stats_t {
+            rx_packets: self.rx_packets.load(Ordering::Relaxed),
+            rx_bursts: self.rx_bursts.load(Ordering::Relaxed),
+            rx_empty_bursts: self.rx_empty_bursts.load(Ordering::Relaxed),
+            tx_packets: self.tx_packets.load(Ordering::Relaxed),
+            tx_bursts: self.tx_bursts.load(Ordering::Relaxed),
+            tx_drops: self.tx_drops.load(Ordering::Relaxed),
+            mempool_misses: self.mempool_misses.load(Ordering::Relaxed),
+            tcp_retransmits: self.tcp_retransmits.load(Ordering::Relaxed),
+            tcp_rto_fires: self.tcp_rto_fires.load(Ordering::Relaxed),
+            wait_any_scans: self.wait_any_scans.load(Ordering::Relaxed),
+            wait_any_scanned_qts: self.wait_any_scanned_qts.load(Ordering::Relaxed),
+            timer_arms: self.timer_arms.load(Ordering::Relaxed),
+            timer_cancels: self.timer_cancels.load(Ordering::Relaxed),
+            timer_fires: self.timer_fires.load(Ordering::Relaxed),
+            poll_histogram,
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Records a receive burst that returned `nr_received` packets.
+pub fn record_rx_burst(nr_received: usize) {
+    STATS.with(|stats| {
+        add(&stats.rx_bursts, 1);
+        match nr_received {
+            0 => add(&stats.rx_empty_bursts, 1),
+            n => add(&stats.rx_packets, n as u64),
+        }
+    })
+}
+
+/// Records a packet handed to the device.
+pub fn record_tx_packet() {
+    STATS.with(|stats| add(&stats.tx_packets, 1))
+}
+
+/// Records a transmit burst that the device accepted.
+pub fn record_tx_burst() {
+    STATS.with(|stats| add(&stats.tx_bursts, 1))
+}
+
+/// Records `nr_dropped` packets that the device did not accept.
+pub fn record_tx_drops(nr_dropped: usize) {
+    STATS.with(|stats| add(&stats.tx_drops, nr_dropped as u64))
+}
+
+/// Records a failed allocation from a memory pool.
+pub fn record_mempool_miss() {
+    STATS.with(|stats| add(&stats.mempool_misses, 1))
+}
+
+/// Records `nr_segments` TCP segments that were sent again.
+pub fn record_tcp_retransmits(nr_segments: usize) {
+    STATS.with(|stats| add(&stats.tcp_retransmits, nr_segments as u64))
+}
+
+/// Records a TCP retransmission timeout.
+pub fn record_tcp_rto() {
+    STATS.with(|stats| add(&stats.tcp_rto_fires, 1))
+}
+
+/// Records a wait that goes through a list of `num_qts` queue tokens.
+pub fn record_wait_any_scan(num_qts: usize) {
+    STATS.with(|stats| {
+        add(&stats.wait_any_scans, 1);
+        add(&stats.wait_any_scanned_qts, num_qts as u64);
+    })
+}
+
+/// Records a timer that was armed.
+pub fn record_timer_arm() {
+    STATS.with(|stats| add(&stats.timer_arms, 1))
+}
+
+/// Records a timer that was cancelled before it fired.
+pub fn record_timer_cancel() {
+    STATS.with(|stats| add(&stats.timer_cancels, 1))
+}
+
+/// Records `nr_fired` timers that fired.
+pub fn record_timer_fires(nr_fired: usize) {
+    STATS.with(|stats| add(&stats.timer_fires, nr_fired as u64))
+}
+
+/// Records a scheduler poll that ran `num_tasks` tasks.
+pub fn record_poll(num_tasks: usize) {
+    STATS.with(|stats| add(&stats.poll_histogram[poll_bucket(num_tasks)], 1))
+}
+
+/// Returns the value of the counters of this thread.
+pub fn snapshot() -> demi_stats_t {
+    STATS.with(|stats| stats.snapshot())
+}
+
+/// Returns the address of the counters of this thread, which stays valid until the thread exits. Other threads must
+/// only read whole fields from it.
+pub fn as_ptr() -> *const demi_stats_t {
+    const { assert!(mem::size_of::<Stats>() == mem::size_of::<demi_stats_t>()) };
+    STATS.with(|stats| stats as *const Stats as *const demi_stats_t)
+}
+
+/// Increments `counter` by `n`. Only the owner thread writes counters, so a load and a store are enough.
+fn add(counter: &AtomicU64, n: u64) {
+    counter.store(counter.load(Ordering::Relaxed).wrapping_add(n), Ordering::Relaxed);
+}
+
+/// Returns the histogram bucket of a poll that ran `num_tasks` tasks.
+fn poll_bucket(num_tasks: usize) -> usize {
+    ((usize::BITS - num_tasks.leading_zeros()) as usize).min(DEMI_STATS_POLL_BUCKETS - 1)
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::{
+        perftools::stats::{self, poll_bucket},
+        runtime::types::{demi_stats_t, DEMI_STATS_POLL_BUCKETS},
+    };
+    use ::anyhow::Result;
+
+    // Tests that polls land in power-of-two buckets.
+    #[test]
+    fn test_poll_buckets() -> Result<()> {
+        crate::ensure_eq!(poll_bucket(0), 0);
+        crate::ensure_eq!(poll_bucket(1), 1);
+        crate::ensure_eq!(poll_bucket(2), 2);
+        crate::ensure_eq!(poll_bucket(3), 2);
+        crate::ensure_eq!(poll_bucket(4), 3);
+        crate::ensure_eq!(poll_bucket(63), 6);
+        crate::ensure_eq!(poll_bucket(64), DEMI_STATS_POLL_BUCKETS - 1);
+        crate::ensure_eq!(poll_bucket(usize::MAX), DEMI_STATS_POLL_BUCKETS - 1);
+        Ok(())
+    }
+
+    // Tests that recorded events show up both in snapshots and through the live block.
+    #[test]
+    fn test_record_and_snapshot() -> Result<()> {
+        let before: demi_stats_t = stats::snapshot();
+        stats::record_rx_burst(0);
+        stats::record_rx_burst(32);
+        stats::record_tx_packet();
+        stats::record_tx_burst();
+        stats::record_tx_drops(3);
+        stats::record_mempool_miss();
+        stats::record_tcp_retransmits(2);
+        stats::record_tcp_rto();
+        stats::record_wait_any_scan(16);
+        stats::record_timer_arm();
+        stats::record_timer_cancel();
+        stats::record_timer_fires(4);
+        stats::record_poll(5);
+        let after: demi_stats_t = stats::snapshot();
+
+        crate::ensure_eq!(after.rx_bursts - before.rx_bursts, 2);
+        crate::ensure_eq!(after.rx_empty_bursts - before.rx_empty_bursts, 1);
+        crate::ensure_eq!(after.rx_packets - before.rx_packets, 32);
+        crate::ensure_eq!(after.tx_packets - before.tx_packets, 1);
+        crate::ensure_eq!(after.tx_bursts - before.tx_bursts, 1);
+        crate::ensure_eq!(after.tx_drops - before.tx_drops, 3);
+        crate::ensure_eq!(after.mempool_misses - before.mempool_misses, 1);
+        crate::ensure_eq!(after.tcp_retransmits - before.tcp_retransmits, 2);
+        crate::ensure_eq!(after.tcp_rto_fires - before.tcp_rto_fires, 1);
+        crate::ensure_eq!(after.wait_any_scans - before.wait_any_scans, 1);
+        crate::ensure_eq!(after.wait_any_scanned_qts - before.wait_any_scanned_qts, 16);
+        crate::ensure_eq!(after.timer_arms - before.timer_arms, 1);
+        crate::ensure_eq!(after.timer_cancels - before.timer_cancels, 1);
+        crate::ensure_eq!(after.timer_fires - before.timer_fires, 4);
+        crate::ensure_eq!(after.poll_histogram[3] - before.poll_histogram[3], 1);
+
+        // Safety: the block lives as long as this thread.
+        let live: demi_stats_t = unsafe { *stats::as_ptr() };
+        crate::ensure_eq!(live, after);
+
+        Ok(())
+    }
+}
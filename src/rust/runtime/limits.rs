@@ -8,3 +8,7 @@ pub const RECVBUF_SIZE_MAX: usize = 8192;
 /// Maximum size for a fixed-size pop operation.
 /// This is set to be at most `RECVBUF_SIZE_MAX`.
 pub const POP_SIZE_MAX: usize = RECVBUF_SIZE_MAX;
+
+/// Maximum amount of a file that a push-file operation maps and hands to the transport at once.
+/// This bounds the memory that a single operation holds in flight, while leaving room for a TCP send window.
+pub const PUSH_FILE_WINDOW_SIZE: usize = 4 * 1024 * 1024;
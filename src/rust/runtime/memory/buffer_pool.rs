@@ -26,9 +26,12 @@ pub struct BufferPool(Rc<MemoryPool>);
 //======================================================================================================================
 
 impl BufferPool {
+    /// Number of bytes at the start of every pool buffer that hold the metadata of the [`DemiBuffer`] built on it.
+    pub const METADATA_SIZE: usize = std::mem::size_of::<MetaData>();
+
     pub fn new(buffer_data_size: u16) -> Result<Self, LayoutError> {
         Ok(Self(MemoryPool::new(
-            NonZeroUsize::new(std::mem::size_of::<MetaData>() + buffer_data_size as usize).unwrap(),
+            NonZeroUsize::new(Self::METADATA_SIZE + buffer_data_size as usize).unwrap(),
             NonZeroUsize::new(CPU_DATA_CACHE_LINE_SIZE_IN_BYTES).unwrap(),
         )?))
     }
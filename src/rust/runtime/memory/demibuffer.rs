@@ -13,10 +13,10 @@
 // Note: if compiled without the "libdpdk" feature defined, the DPDK-specific functionality won't be present.
 
 // Note on buffer chain support:
-// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  While the
-// DemiBuffer routines for heap-allocated buffers also now support this functionality, it isn't yet exposed via the
-// DemiBuffer interface.
-// TODO: Expose buffer chain support once we have a solid use case.
+// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  The DemiBuffer
+// routines for heap-allocated buffers support this functionality as well.  Chains are exposed via chain(),
+// detach_tail(), and segments(), and are used to back multi-segment scatter-gather arrays.  Note that len() and the
+// slice returned by deref() only cover the first segment of a chain.
 
 // Note on intrusive queueing:
 // Since all DemiBuffer types keep the metadata for each "view" in a separate allocated region, they can be queued
@@ -30,8 +30,8 @@
 
 #[cfg(feature = "libdpdk")]
 use crate::runtime::libdpdk::{
-    rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_adj, rte_pktmbuf_clone, rte_pktmbuf_free, rte_pktmbuf_prepend,
-    rte_pktmbuf_trim,
+    rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_adj, rte_pktmbuf_alloc, rte_pktmbuf_chain, rte_pktmbuf_clone,
+    rte_pktmbuf_free, rte_pktmbuf_prepend, rte_pktmbuf_trim,
 };
 use crate::{
     pal::CPU_DATA_CACHE_LINE_SIZE_IN_BYTES,
@@ -40,6 +40,7 @@ use crate::{
         memory::{
             buffer_pool::BufferPool,
             memory_pool::{MemoryPool, PoolBuf},
+            region::MemoryRegion,
         },
     },
 };
@@ -110,11 +111,12 @@ pub(super) struct MetaData {
     // Pointer to the MetaData of the next segment in this packet's chain (must be NULL in last segment).
     next: Option<NonNull<MetaData>>,
 
-    // Various fields for TX offload.
-    _tx_offload: MaybeUninit<u64>,
+    // Various fields for TX offload. Demikernel only uses the TCP segment size (see TX_OFFLOAD_TSO_SEGSZ_SHIFT).
+    tx_offload: u64,
 
-    // Pointer to shared info. Used to manage external buffers.
-    _shinfo: MaybeUninit<u64>,
+    // Pointer to shared info. Used to manage external buffers: it holds the registered memory region that the data of
+    // an external buffer resides in.
+    shinfo: Option<Rc<MemoryRegion>>,
 
     // Size of private data (between rte_mbuf struct and the data) in direct MBufs.
     _priv_size: MaybeUninit<u16>,
@@ -156,6 +158,9 @@ struct DemiMetaData {
 
     // Pointer to the MetaData of the next segment in this packet's chain (must be NULL in last segment).
     next: Option<NonNull<MetaData>>,
+
+    // Registered memory region that the data of an external buffer resides in.
+    shinfo: Option<Rc<MemoryRegion>>,
 }
 
 // Check MetaData structure alignment and size at compile time.
@@ -164,6 +169,7 @@ struct DemiMetaData {
 const _: () = assert!(std::mem::align_of::<MetaData>() == CPU_DATA_CACHE_LINE_SIZE_IN_BYTES);
 const _: () = assert!(std::mem::size_of::<MetaData>() == 2 * CPU_DATA_CACHE_LINE_SIZE_IN_BYTES);
 const _: () = assert!(std::mem::size_of::<Option<Rc<MemoryPool>>>() == std::mem::size_of::<*const ()>());
+const _: () = assert!(std::mem::size_of::<Option<Rc<MemoryRegion>>>() == std::mem::size_of::<u64>());
 
 // MetaData "offload flags".  These exactly mimic those of DPDK MBufs.
 
@@ -171,6 +177,14 @@ const _: () = assert!(std::mem::size_of::<Option<Rc<MemoryPool>>>() == std::mem:
 // points to another MetaData's directly attached data.
 const METADATA_F_INDIRECT: u64 = 1 << 62;
 
+// Indicates this MetaData struct doesn't have the actual data directly attached, but rather this MetaData's buf_addr
+// points to application memory in a registered memory region, which shinfo keeps alive.
+const METADATA_F_EXTERNAL: u64 = 1 << 61;
+
+// Position of the TCP segment size in the TX offload fields. This mimics the tso_segsz bit field of DPDK MBufs, which
+// follows the 7-bit L2, 9-bit L3 and 8-bit L4 header lengths.
+const TX_OFFLOAD_TSO_SEGSZ_SHIFT: u64 = 24;
+
 impl MetaData {
     // Note on Reference Counts:
     // Since we are currently single-threaded, there is no need to use atomic operations for refcnt manipulations.
@@ -191,17 +205,17 @@ impl MetaData {
             buf_len: values.buf_len,
             pool: values.pool,
             next: values.next,
+            shinfo: values.shinfo,
+            tx_offload: 0,
 
             // Unused fields
             _buf_iova: MaybeUninit::uninit(),
             _port: MaybeUninit::uninit(),
             _packet_type: MaybeUninit::uninit(),
-            _shinfo: MaybeUninit::uninit(),
             _vlan_tci: MaybeUninit::uninit(),
             _various1: MaybeUninit::uninit(),
             _various2: MaybeUninit::uninit(),
             _vlan_tci_outer: MaybeUninit::uninit(),
-            _tx_offload: MaybeUninit::uninit(),
             _timesync: MaybeUninit::uninit(),
             _dynfield: MaybeUninit::uninit(),
 
@@ -292,6 +306,14 @@ pub struct DemiBuffer {
     _phantom: PhantomData<MetaData>,
 }
 
+/// Iterator over the data of each segment in a `DemiBuffer` chain.
+pub struct DemiBufferSegments<'a> {
+    // Pointer to the MetaData of the next segment to visit.
+    next: Option<NonNull<MetaData>>,
+    // The iterator borrows the DemiBuffer that owns the chain.
+    _phantom: PhantomData<&'a DemiBuffer>,
+}
+
 // Safety: Technically, DemiBuffer's aren't safe to Send between threads in their current implementation, as the
 // reference counting on the data region isn't performed using (expensive) atomic operations, for performance reasons.
 // This is okay in practice, as we currently run Demikernel single-threaded.  If this changes, the reference counting
@@ -366,6 +388,42 @@ impl DemiBuffer {
         ))
     }
 
+    /// Creates a new (Heap-allocated) `DemiBuffer` that references `len` bytes of application memory, starting at
+    /// `data`, without copying them. The buffer holds a reference to `region`, which keeps the registered memory region
+    /// that the data resides in from being unregistered.
+    ///
+    /// # Safety
+    ///
+    /// `data` must point to `len` bytes of memory inside `region`, which must remain valid while the region is
+    /// registered.
+    pub unsafe fn from_external(data: NonNull<u8>, len: u16, region: Rc<MemoryRegion>) -> Self {
+        // Allocate space for a new MetaData struct without any direct data.
+        let (temp, _): (&mut MaybeUninit<MetaData>, _) = allocate_metadata_data(0);
+
+        let metadata: NonNull<MetaData> = NonNull::from(temp.write(MetaData::new(DemiMetaData {
+            buf_addr: data.as_ptr(),
+            data_off: 0,
+            refcnt: 1,
+            nb_segs: 1,
+            ol_flags: METADATA_F_EXTERNAL,
+            pkt_len: len as u32,
+            data_len: len,
+            buf_len: len,
+            next: None,
+            pool: None,
+            shinfo: Some(region),
+        })));
+
+        // Embed the buffer type into the lower bits of the pointer.
+        let tagged: NonNull<MetaData> = metadata.with_addr(metadata.addr() | Tag::Heap);
+
+        // Return the new DemiBuffer.
+        DemiBuffer {
+            tagged_ptr: tagged,
+            _phantom: PhantomData,
+        }
+    }
+
     /// Create a new DemiBuffer in the specified memory, with relevant configuration values.
     fn new_from_parts(
         metadata_buf: &mut MaybeUninit<MetaData>,
@@ -394,6 +452,7 @@ impl DemiBuffer {
             buf_len: (capacity + headroom),
             next: None,
             pool,
+            shinfo: None,
         })));
 
         // Embed the buffer type into the lower bits of the pointer.
@@ -451,6 +510,7 @@ impl DemiBuffer {
             buf_len: size as u16,
             next: None,
             pool: None,
+            shinfo: None,
         })));
 
         // Embed the buffer type into the lower bits of the pointer.
@@ -502,6 +562,31 @@ impl DemiBuffer {
         self.get_tag() == Tag::Dpdk
     }
 
+    /// Returns the payload size of the TCP segments that this `DemiBuffer` is to be cut into when it is transmitted, or
+    /// zero if it is to be transmitted as is.
+    pub fn tso_segment_size(&self) -> u16 {
+        // Since MetaData and MBuf are laid out the same, this works for both types of buffers.
+        (self.as_metadata().tx_offload >> TX_OFFLOAD_TSO_SEGSZ_SHIFT) as u16
+    }
+
+    /// Marks this `DemiBuffer`, which holds a TCP segment, to be cut into segments with `size` bytes of payload when it
+    /// is transmitted.
+    pub fn set_tso_segment_size(&mut self, size: u16) {
+        let metadata: &mut MetaData = self.as_metadata();
+        metadata.tx_offload = (metadata.tx_offload & !(0xffff << TX_OFFLOAD_TSO_SEGSZ_SHIFT))
+            | ((size as u64) << TX_OFFLOAD_TSO_SEGSZ_SHIFT);
+    }
+
+    /// Returns `true` if the first segment of this `DemiBuffer` references application memory in a registered memory
+    /// region, and `false` otherwise.
+    pub fn is_external(&self) -> bool {
+        match self.get_tag() {
+            Tag::Heap => self.as_metadata().ol_flags & METADATA_F_EXTERNAL != 0,
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => false,
+        }
+    }
+
     /// Returns the length of the data stored in the `DemiBuffer`.
     // Note that while we return a usize here (for convenience), the value is guaranteed to never exceed u16::MAX.
     pub fn len(&self) -> usize {
@@ -627,6 +712,187 @@ impl DemiBuffer {
         Ok(())
     }
 
+    /// Returns the number of segments in the `DemiBuffer` chain.
+    pub fn num_segments(&self) -> usize {
+        // Since MetaData and MBuf are laid out the same, this works for both types of buffers.
+        self.as_metadata().nb_segs as usize
+    }
+
+    /// Returns the length of the data stored across all segments of the `DemiBuffer` chain.
+    pub fn chain_len(&self) -> usize {
+        // Since MetaData and MBuf are laid out the same, this works for both types of buffers.
+        self.as_metadata().pkt_len as usize
+    }
+
+    /// Returns an iterator over the data of each segment in the `DemiBuffer` chain.
+    pub fn segments(&self) -> DemiBufferSegments<'_> {
+        DemiBufferSegments {
+            next: Some(self.get_ptr::<MetaData>()),
+            _phantom: PhantomData,
+        }
+    }
+
+    ///
+    /// **Description**
+    ///
+    /// Appends `tail` to the end of the target [DemiBuffer] chain. The target takes over the reference that `tail`
+    /// holds on its data.
+    ///
+    /// **Return Value**
+    ///
+    /// On successful completion, `Ok(())` is returned. On failure, a [Fail] structure encoding the failure condition is
+    /// returned instead and `tail` is released.
+    ///
+    /// **Notes**
+    ///
+    /// - Both buffers must have the same underlying type (i.e. both heap-allocated or both DPDK-allocated).
+    ///
+    pub fn chain(&mut self, tail: DemiBuffer) -> Result<(), Fail> {
+        if self.get_tag() != tail.get_tag() {
+            let cause: String = format!("cannot chain buffers of different types");
+            error!("chain(): {}", &cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        match self.get_tag() {
+            Tag::Heap => {
+                let md_first: &mut MetaData = self.as_metadata();
+                let md_tail: &mut MetaData = tail.as_metadata();
+                let nb_segs: usize = md_first.nb_segs as usize + md_tail.nb_segs as usize;
+                if nb_segs > u16::MAX as usize {
+                    let cause: String = format!("too many segments in buffer chain (nb_segs={:?})", nb_segs);
+                    error!("chain(): {}", &cause);
+                    return Err(Fail::new(libc::EOVERFLOW, &cause));
+                }
+                md_first.nb_segs = nb_segs as u16;
+                md_first.pkt_len += md_tail.pkt_len;
+                md_first.get_last_segment().next = Some(tail.get_ptr::<MetaData>());
+            },
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => {
+                // Safety: rte_pktmbuf_chain is a FFI, which is safe since we call it with actual MBuf pointers.
+                let ret: libc::c_int = unsafe { rte_pktmbuf_chain(self.as_mbuf(), tail.as_mbuf()) };
+                if ret != 0 {
+                    let cause: String = format!("failed to chain mbufs: {:?}", ret);
+                    error!("chain(): {}", &cause);
+                    return Err(Fail::new(libc::EOVERFLOW, &cause));
+                }
+            },
+        }
+
+        // The chain now owns the tail, so don't run its destructor.
+        mem::forget(tail);
+        Ok(())
+    }
+
+    ///
+    /// **Description**
+    ///
+    /// Detaches every segment but the first one from the target [DemiBuffer] chain.
+    ///
+    /// **Return Value**
+    ///
+    /// If the target [DemiBuffer] has multiple segments, a new [DemiBuffer] holding the detached segments is returned.
+    /// Otherwise, `None` is returned instead.
+    ///
+    pub fn detach_tail(&mut self) -> Option<Self> {
+        // Since MetaData and MBuf are laid out the same, this works for both types of buffers.
+        let md_first: &mut MetaData = self.as_metadata();
+        let mut tail: NonNull<MetaData> = md_first.next.take()?;
+
+        // Safety: The call to as_mut is safe, as the pointer is aligned and dereferenceable, and the MetaData struct it
+        // points to is initialized properly.
+        let md_tail: &mut MetaData = unsafe { tail.as_mut() };
+        md_tail.nb_segs = md_first.nb_segs - 1;
+        md_tail.pkt_len = md_first.pkt_len - md_first.data_len as u32;
+        md_first.nb_segs = 1;
+        md_first.pkt_len = md_first.data_len as u32;
+
+        // The detached segments inherit the type of the chain.
+        let tagged: NonNull<MetaData> = tail.with_addr(tail.addr() | self.get_tag());
+        Some(DemiBuffer {
+            tagged_ptr: tagged,
+            _phantom: PhantomData,
+        })
+    }
+
+    ///
+    /// **Description**
+    ///
+    /// Places a new, empty segment with `headroom` bytes of headroom in front of the target [DemiBuffer]. Headers may
+    /// then be prepended to the returned chain without writing to the headroom of the target [DemiBuffer], which may
+    /// be shared with other references to the same data. The new segment is of the same type as the target
+    /// [DemiBuffer]. DPDK-allocated segments come from the same pool as the target [DemiBuffer].
+    ///
+    /// **Return Value**
+    ///
+    /// On successful completion, the new buffer chain is returned. On failure, a [Fail] structure encoding the failure
+    /// condition is returned instead.
+    ///
+    pub fn prepend_segment(self, headroom: u16) -> Result<Self, Fail> {
+        let mut head: DemiBuffer = match self.get_tag() {
+            Tag::Heap => DemiBuffer::new_with_headroom(0, headroom),
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => {
+                // Safety: it is safe to dereference the result of `as_mbuf()` as it is known to point to a valid MBuf.
+                let mempool_ptr: *mut rte_mempool = unsafe { (*self.as_mbuf()).pool };
+                // Safety: rte_pktmbuf_alloc is a FFI, which is safe to call since we call it with a valid pool and
+                // properly check its return value for null (failure) before using.
+                let mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(mempool_ptr) };
+                if mbuf_ptr.is_null() {
+                    let rte_errno: libc::c_int = unsafe { rte_errno() };
+                    let cause: String = format!("cannot allocate an mbuf at this time: {:?}", rte_errno);
+                    warn!("prepend_segment(): {}", cause);
+                    return Err(Fail::new(libc::ENOMEM, &cause));
+                }
+
+                // Safety: it is safe to dereference "mbuf_ptr" as it is known to point to a valid MBuf.
+                unsafe {
+                    if (*mbuf_ptr).buf_len < headroom {
+                        rte_pktmbuf_free(mbuf_ptr);
+                        let cause: String = format!("insufficient room for headroom (headroom={:?})", headroom);
+                        error!("prepend_segment(): {}", cause);
+                        return Err(Fail::new(libc::EINVAL, &cause));
+                    }
+                    (*mbuf_ptr).data_off = headroom;
+                    DemiBuffer::from_mbuf(mbuf_ptr)
+                }
+            },
+        };
+
+        head.chain(self)?;
+        Ok(head)
+    }
+
+    ///
+    /// **Description**
+    ///
+    /// Copies the data of all segments in the target [DemiBuffer] chain into a new single-segment (heap-allocated)
+    /// [DemiBuffer] that reserves `headroom` bytes in front of the data.
+    ///
+    /// **Return Value**
+    ///
+    /// On successful completion, the new [DemiBuffer] is returned. On failure, a [Fail] structure encoding the failure
+    /// condition is returned instead.
+    ///
+    pub fn linearize(&self, headroom: u16) -> Result<Self, Fail> {
+        let len: usize = self.chain_len();
+        if len + headroom as usize > u16::MAX as usize {
+            let cause: String = format!("buffer chain is too large to linearize (len={:?})", len);
+            error!("linearize(): {}", &cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let mut buf: DemiBuffer = DemiBuffer::new_with_headroom(len as u16, headroom);
+        let mut offset: usize = 0;
+        for segment in self.segments() {
+            buf[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
+        debug_assert_eq!(offset, len);
+        Ok(buf)
+    }
+
     ///
     /// **Description**
     ///
@@ -954,9 +1220,15 @@ impl Clone for DemiBuffer {
                         };
 
                         // Add indirect flag to clone for non-empty buffers. Empty buffers don't reference any data, so
-                        // aren't indirect.
-                        let ol_flags: u64 =
-                            original.ol_flags | if original.buf_len != 0 { METADATA_F_INDIRECT } else { 0 };
+                        // aren't indirect. External buffers stay external, as their data is not directly attached to
+                        // any MetaData struct.
+                        let external: bool = original.ol_flags & METADATA_F_EXTERNAL != 0;
+                        let ol_flags: u64 = original.ol_flags
+                            | if original.buf_len != 0 && !external {
+                                METADATA_F_INDIRECT
+                            } else {
+                                0
+                            };
 
                         // Copy other relevant fields from our progenitor.
                         let values: DemiMetaData = DemiMetaData {
@@ -971,6 +1243,7 @@ impl Clone for DemiBuffer {
                             data_len: original.data_len,
                             ol_flags,
                             pool: None,
+                            shinfo: original.shinfo.clone(),
                         };
 
                         clone.write(MetaData::new(values));
@@ -982,6 +1255,13 @@ impl Clone for DemiBuffer {
                             // Instead we just create a new zero-length direct buffer.
                             continue;
                         }
+
+                        // Special case for external buffers.
+                        if external {
+                            // The clone holds its own reference on the memory region that the data resides in, so
+                            // there is no reference count to increment.
+                            continue;
+                        }
                     }
 
                     // Increment the reference count on the data.  It resides in the MetaData structure that the data
@@ -1064,6 +1344,30 @@ impl DerefMut for DemiBuffer {
     }
 }
 
+/// Iterator Trait Implementation for `DemiBufferSegments`.
+impl<'a> Iterator for DemiBufferSegments<'a> {
+    type Item = &'a [u8];
+
+    fn next(&mut self) -> Option<Self::Item> {
+        // Safety: The call to as_ref is safe, as the pointer is aligned and dereferenceable, and the MetaData struct it
+        // points to is initialized properly.  Since MetaData and MBuf are laid out the same, this works for both.
+        let metadata: &MetaData = unsafe { self.next?.as_ref() };
+        self.next = metadata.next;
+
+        if metadata.data_len == 0 {
+            return Some(&[]);
+        }
+        // Safety: the call to from_raw_parts is safe, as its arguments refer to a valid readable memory region
+        // of the size specified and is contained within a single allocated object.
+        Some(unsafe {
+            slice::from_raw_parts(
+                metadata.buf_addr.offset(metadata.data_off as isize),
+                metadata.data_len as usize,
+            )
+        })
+    }
+}
+
 /// Drop Trait Implementation for `DemiBuffer`.
 impl Drop for DemiBuffer {
     fn drop(&mut self) {
@@ -1112,6 +1416,13 @@ impl Drop for DemiBuffer {
                                 // Free the direct buffer.
                                 free_metadata_data(allocation);
                             }
+                        } else if metadata.ol_flags & METADATA_F_EXTERNAL != 0 {
+                            // This is an external buffer. The data belongs to the application, so we only drop our
+                            // reference to the memory region that it resides in.
+                            metadata.buf_addr = null_mut();
+                            metadata.buf_len = 0;
+                            metadata.ol_flags = metadata.ol_flags & !METADATA_F_EXTERNAL;
+                            metadata.shinfo = None;
                         }
 
                         // Free this buffer.
@@ -1173,6 +1484,7 @@ impl TryFrom<&[u8]> for DemiBuffer {
             buf_len: size,
             next: None,
             pool: None,
+            shinfo: None,
         })));
 
         // Embed the buffer type into the lower bits of the pointer.
@@ -1382,4 +1694,96 @@ mod tests {
 
         Ok(())
     }
+
+    // Test chaining, iterating over, cloning, and detaching buffer segments.
+    #[test]
+    fn chain() -> Result<()> {
+        let str: &str = "word one two three four five six seven eight nine";
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(&str.as_bytes()[..20])?;
+        let tail: DemiBuffer = DemiBuffer::from_slice(&str.as_bytes()[20..])?;
+
+        // Chain the buffers together.
+        crate::ensure_eq!(buf.chain(tail).is_ok(), true);
+        crate::ensure_eq!(buf.num_segments(), 2);
+        crate::ensure_eq!(buf.len(), 20);
+        crate::ensure_eq!(buf.chain_len(), str.len());
+
+        // Check the contents of each segment and of the linearized chain.
+        let segments: Vec<&[u8]> = buf.segments().collect();
+        crate::ensure_eq!(segments.len(), 2);
+        crate::ensure_eq!(segments[0], &str.as_bytes()[..20]);
+        crate::ensure_eq!(segments[1], &str.as_bytes()[20..]);
+        let linear: DemiBuffer = buf.linearize(0)?;
+        crate::ensure_eq!(linear.num_segments(), 1);
+        crate::ensure_eq!(&linear[..], str.as_bytes());
+
+        // A clone of the chain has the same segments.
+        let mut clone: DemiBuffer = buf.clone();
+        crate::ensure_eq!(clone.num_segments(), 2);
+        crate::ensure_eq!(clone.chain_len(), str.len());
+
+        // Detach the tail of the clone.
+        let detached: DemiBuffer = match clone.detach_tail() {
+            Some(detached) => detached,
+            None => anyhow::bail!("DemiBuffer::detach_tail shouldn't fail for a chain"),
+        };
+        crate::ensure_eq!(clone.num_segments(), 1);
+        crate::ensure_eq!(clone.chain_len(), 20);
+        crate::ensure_eq!(detached.num_segments(), 1);
+        crate::ensure_eq!(&detached[..], &str.as_bytes()[20..]);
+        crate::ensure_eq!(clone.detach_tail().is_none(), true);
+
+        // The original chain is unaffected.
+        crate::ensure_eq!(buf.num_segments(), 2);
+        crate::ensure_eq!(buf.chain_len(), str.len());
+
+        Ok(())
+    }
+
+    // Tests prepending a header segment to a buffer.
+    #[test]
+    fn prepend_segment() -> Result<()> {
+        let data: DemiBuffer = DemiBuffer::from_slice(b"payload")?;
+        let token: *const u8 = data.as_ptr();
+
+        // Prepend a header segment and write a header into it.
+        let mut pkt: DemiBuffer = data.clone().prepend_segment(16)?;
+        crate::ensure_eq!(pkt.num_segments(), 2);
+        crate::ensure_eq!(pkt.len(), 0);
+        pkt.prepend(4)?;
+        pkt.copy_from_slice(b"head");
+        crate::ensure_eq!(pkt.chain_len(), 11);
+
+        // The payload is not copied and its headroom is left untouched.
+        let segments: Vec<&[u8]> = pkt.segments().collect();
+        crate::ensure_eq!(segments[0], b"head");
+        crate::ensure_eq!(segments[1], b"payload");
+        crate::ensure_eq!(segments[1].as_ptr(), token);
+        crate::ensure_eq!(&data[..], b"payload");
+
+        // We can't prepend more than the requested headroom.
+        crate::ensure_eq!(pkt.prepend(13).is_err(), true);
+
+        Ok(())
+    }
+
+    // Tests marking a buffer to be cut into TCP segments on transmission.
+    #[test]
+    fn tso_segment_size() -> Result<()> {
+        let mut buf: DemiBuffer = DemiBuffer::new_with_headroom(4096, 64);
+        crate::ensure_eq!(buf.tso_segment_size(), 0);
+
+        // The mark sticks to the buffer as headers are prepended.
+        buf.set_tso_segment_size(1448);
+        buf.prepend(54)?;
+        crate::ensure_eq!(buf.tso_segment_size(), 1448);
+
+        // Clones are not marked.
+        crate::ensure_eq!(buf.clone().tso_segment_size(), 0);
+
+        buf.set_tso_segment_size(0);
+        crate::ensure_eq!(buf.tso_segment_size(), 0);
+
+        Ok(())
+    }
 }
@@ -4,6 +4,7 @@
 mod buffer_pool;
 mod demibuffer;
 mod memory_pool;
+mod region;
 
 //======================================================================================================================
 // Imports
@@ -11,7 +12,7 @@ mod memory_pool;
 
 use crate::runtime::{
     fail::Fail,
-    types::{demi_sgarray_t, demi_sgaseg_t},
+    types::{demi_sgarray_t, demi_sgaseg_t, DEMI_SGARRAY_MAXLEN},
 };
 use ::libc::c_void;
 use ::std::{
@@ -23,7 +24,7 @@ use ::std::{
 // Exports
 //======================================================================================================================
 
-pub use self::{buffer_pool::*, demibuffer::*};
+pub use self::{buffer_pool::*, demibuffer::*, region::*};
 
 //======================================================================================================================
 // Traits
@@ -36,136 +37,194 @@ pub use self::{buffer_pool::*, demibuffer::*};
 pub trait MemoryRuntime {
     /// Converts a buffer into a scatter-gather array.
     fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        buffer_into_sgarray(buf)
     }
 
     /// Allocates a scatter-gather array.
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
+        // Allocate one heap-managed buffer per segment.
+        let buf: DemiBuffer = alloc_buffer_chain(size, u16::MAX, |segment_size: u16| -> Result<DemiBuffer, Fail> {
+            Ok(DemiBuffer::new(segment_size))
+        })?;
+        buffer_into_sgarray(buf)
+    }
 
-        // We can't allocate a zero-sized buffer.
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
+    /// Releases a scatter-gather array.
+    fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
+        free_sgarray(sga)
+    }
 
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
+    /// Clones a scatter-gather array.
+    fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+        clone_sgarray(sga)
+    }
+}
 
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = DemiBuffer::new(size as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Allocates a buffer chain that holds `size` bytes. Each segment holds at most `max_segment_size` bytes, is allocated
+/// with `alloc_segment`, and backs one segment of a scatter-gather array.
+pub fn alloc_buffer_chain<F>(size: usize, max_segment_size: u16, mut alloc_segment: F) -> Result<DemiBuffer, Fail>
+where
+    F: FnMut(u16) -> Result<DemiBuffer, Fail>,
+{
+    // We can't allocate a zero-sized buffer.
+    if size == 0 {
+        let cause: String = format!("cannot allocate a zero-sized buffer");
+        error!("sgaalloc(): {}", cause);
+        return Err(Fail::new(libc::EINVAL, &cause));
     }
 
-    /// Releases a scatter-gather array.
-    fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
+    // We can't allocate more than fits in a scatter-gather array.
+    if size > DEMI_SGARRAY_MAXLEN * max_segment_size as usize {
+        let cause: String = format!("size too large for a demi_sgarray_t (size={:?})", size);
+        error!("sgaalloc(): {}", cause);
+        return Err(Fail::new(libc::EINVAL, &cause));
+    }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    let mut remaining: usize = size;
+    let mut buf: Option<DemiBuffer> = None;
+    while remaining > 0 {
+        let segment_size: u16 = remaining.min(max_segment_size as usize) as u16;
+        let segment: DemiBuffer = alloc_segment(segment_size)?;
+        remaining -= segment_size as usize;
+        match buf.as_mut() {
+            Some(buf) => buf.chain(segment)?,
+            None => buf = Some(segment),
         }
+    }
 
-        // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        drop(buf);
+    // This unwrap won't panic, as we have checked that size is not zero above.
+    Ok(buf.unwrap())
+}
 
-        Ok(())
+/// Converts a buffer chain into a scatter-gather array with one segment per buffer in the chain. The scatter-gather
+/// array inherits the buffer's reference.
+pub fn buffer_into_sgarray(buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
+    let num_segments: usize = buf.num_segments();
+    if num_segments > DEMI_SGARRAY_MAXLEN {
+        let cause: String = format!(
+            "too many segments for a demi_sgarray_t (num_segments={:?})",
+            num_segments
+        );
+        error!("into_sgarray(): {}", cause);
+        return Err(Fail::new(libc::EINVAL, &cause));
     }
 
-    /// Clones a scatter-gather array.
-    fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
+    // Create a scatter-gather segment for each buffer in the chain to expose it to the user.
+    let mut sga_segs: [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN] = [demi_sgaseg_t {
+        sgaseg_buf: ptr::null_mut(),
+        sgaseg_len: 0,
+    }; DEMI_SGARRAY_MAXLEN];
+    for (sga_seg, segment) in sga_segs.iter_mut().zip(buf.segments()) {
+        sga_seg.sgaseg_buf = segment.as_ptr() as *mut c_void;
+        sga_seg.sgaseg_len = segment.len() as u32;
+    }
+
+    // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
+    Ok(demi_sgarray_t {
+        sga_buf: buf.into_raw().as_ptr() as *mut c_void,
+        sga_numsegs: num_segments as u32,
+        sga_segs,
+        sga_addr: unsafe { mem::zeroed() },
+    })
+}
+
+/// Releases a scatter-gather array and the buffer chain that backs it.
+pub fn free_sgarray(sga: demi_sgarray_t) -> Result<(), Fail> {
+    let buf: DemiBuffer = sgarray_to_buffer(&sga)?;
+    drop(buf);
+    Ok(())
+}
+
+/// Clones a scatter-gather array into a buffer chain with one buffer per segment. The scatter-gather array keeps its
+/// reference, so the data is not copied.
+pub fn clone_sgarray(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+    let buf: DemiBuffer = sgarray_to_buffer(sga)?;
+    let clone: DemiBuffer = buf.clone();
+
+    // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
+    mem::forget(buf);
+
+    let num_segments: usize = sga.sga_numsegs as usize;
+    if clone.num_segments() != num_segments {
+        return Err(Fail::new(
+            libc::EINVAL,
+            "demi_sgarray_t segment count does not match backing buffer",
+        ));
+    }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    // Match each buffer in the cloned chain to its scatter-gather segment and put the chain back together.
+    let mut remaining: Option<DemiBuffer> = Some(clone);
+    let mut result: Option<DemiBuffer> = None;
+    for i in 0..num_segments {
+        // This unwrap won't panic, as we have checked the number of segments in the chain above.
+        let mut segment: DemiBuffer = remaining.take().unwrap();
+        remaining = segment.detach_tail();
+        match_sgaseg(&mut segment, &sga.sga_segs[i])?;
+        match result.as_mut() {
+            Some(result) => result.chain(segment)?,
+            None => result = Some(segment),
         }
+    }
+
+    // This unwrap won't panic, as we have checked that the scatter-gather array has at least one segment.
+    Ok(result.unwrap())
+}
+
+/// Gets the buffer chain that backs a scatter-gather array.
+fn sgarray_to_buffer(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+    // Check arguments.
+    if sga.sga_numsegs == 0 || sga.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+    }
+
+    if sga.sga_buf == ptr::null_mut() {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    }
 
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the DemiBuffer's allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
+    // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
+    let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
+    // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
+    // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
+    Ok(unsafe { DemiBuffer::from_raw(token) })
+}
+
+/// Adjusts a single-segment buffer to match the scatter-gather segment that describes it.
+fn match_sgaseg(buf: &mut DemiBuffer, sga_seg: &demi_sgaseg_t) -> Result<(), Fail> {
+    // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
+    // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
+    // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
+    let sga_data: *const u8 = sga_seg.sgaseg_buf as *const u8;
+    let sga_len: usize = sga_seg.sgaseg_len as usize;
+    let buf_data: *const u8 = buf.as_ptr();
+    let mut buf_len: usize = buf.len();
+    if sga_data != buf_data || sga_len != buf_len {
+        // We need to adjust the DemiBuffer to match the user's changes.
+
+        // First check that the user didn't do something non-sensical, like change the buffer description to
+        // reference address space outside of the DemiBuffer's allocated memory area.
+        if sga_data < buf_data || sga_data.addr() + sga_len > buf_data.addr() + buf_len {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "demi_sgarray_t describes data outside backing buffer's allocated region",
+            ));
         }
 
-        // Return the clone.
-        Ok(clone)
+        // Calculate the amount the new starting address is ahead of the old.  And then adjust `buf` to match.
+        let adjustment_amount: usize = sga_data.addr() - buf_data.addr();
+        buf.adjust(adjustment_amount)?;
+
+        // An adjustment above would have reduced buf.len() by the adjustment amount.
+        buf_len -= adjustment_amount;
+        debug_assert_eq!(buf_len, buf.len());
+
+        // Trim the buffer down to size.
+        let trim_amount: usize = buf_len - sga_len;
+        buf.trim(trim_amount)?;
     }
+
+    Ok(())
 }
@@ -0,0 +1,365 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::{
+    fail::Fail,
+    memory::DemiBuffer,
+    types::{demi_sgarray_t, DEMI_SGARRAY_MAXLEN},
+};
+use ::std::{collections::BTreeMap, ptr::NonNull, rc::Rc};
+
+#[cfg(target_os = "linux")]
+use ::std::{io, mem, ptr};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A memory region that the application registered for zero-copy I/O, or that Demikernel mapped from a file. Buffers
+/// that reference data in the region hold a reference to it, so that the region cannot be unregistered or unmapped
+/// while Demikernel still uses its data.
+#[derive(Debug)]
+pub struct MemoryRegion {
+    /// Start address of the region.
+    addr: usize,
+    /// Length of the region in bytes.
+    len: usize,
+    /// Whether Demikernel mapped the region from a file, in which case it unmaps it once no buffer references it.
+    mapped: bool,
+}
+
+/// The set of memory regions that the application registered for zero-copy I/O, indexed by their start address.
+#[derive(Debug, Default)]
+pub struct MemoryRegistry {
+    regions: BTreeMap<usize, Rc<MemoryRegion>>,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+impl MemoryRegion {
+    /// Maps `len` bytes of the file `fd`, starting at `offset`, into memory and wraps them into a buffer chain, without
+    /// copying them. The mapping is read-only, shares the page cache of the file, and goes away once the last buffer
+    /// that references it is released.
+    #[cfg(target_os = "linux")]
+    pub fn map_file(fd: libc::c_int, offset: u64, len: usize) -> Result<DemiBuffer, Fail> {
+        // Touching a mapped page past the end of the file raises SIGBUS, so check that the file holds the whole range.
+        let mut stat: libc::stat = unsafe { mem::zeroed() };
+        // Safety: `stat` is a valid location to store the status of the file.
+        if unsafe { libc::fstat(fd, &mut stat) } != 0 {
+            let errno: i32 = io::Error::last_os_error().raw_os_error().unwrap_or(libc::EBADF);
+            let cause: String = format!("failed to get file status (fd={:?}, errno={:?})", fd, errno);
+            error!("map_file(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        let file_size: u64 = stat.st_size as u64;
+        if stat.st_mode & libc::S_IFMT != libc::S_IFREG
+            || len == 0
+            || offset.checked_add(len as u64).map_or(true, |end| end > file_size)
+        {
+            let cause: String = format!(
+                "invalid file range (fd={:?}, offset={:?}, len={:?}, file_size={:?})",
+                fd, offset, len, file_size
+            );
+            error!("map_file(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        // Mappings start at a page boundary, so map the start of the page that holds the first byte too.
+        // Safety: sysconf() has no preconditions.
+        let page_size: u64 = unsafe { libc::sysconf(libc::_SC_PAGESIZE) } as u64;
+        let map_offset: u64 = offset - offset % page_size;
+        let map_len: usize = (offset - map_offset) as usize + len;
+        // Safety: we ask the kernel for a new mapping, which does not alias any memory that we hold.
+        let addr: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                map_len,
+                libc::PROT_READ,
+                libc::MAP_SHARED,
+                fd,
+                map_offset as libc::off_t,
+            )
+        };
+        if addr == libc::MAP_FAILED {
+            let errno: i32 = io::Error::last_os_error().raw_os_error().unwrap_or(libc::ENOMEM);
+            let cause: String = format!("failed to map file (fd={:?}, errno={:?})", fd, errno);
+            error!("map_file(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        // The data goes out in order, so let the kernel read ahead of us. This is only a hint, so ignore failures.
+        // Safety: the range is the mapping that we just created.
+        unsafe { libc::madvise(addr, map_len, libc::MADV_SEQUENTIAL) };
+
+        let region: Rc<MemoryRegion> = Rc::new(MemoryRegion {
+            addr: addr as usize,
+            len: map_len,
+            mapped: true,
+        });
+        let mut result: Option<DemiBuffer> = None;
+        region.wrap(addr as usize + (offset - map_offset) as usize, len, &mut result)?;
+        match result {
+            Some(buf) => Ok(buf),
+            None => Err(Fail::new(libc::EINVAL, "zero-length buffer")),
+        }
+    }
+
+    /// Mapping files is only supported on Linux.
+    #[cfg(not(target_os = "linux"))]
+    pub fn map_file(fd: libc::c_int, offset: u64, len: usize) -> Result<DemiBuffer, Fail> {
+        let cause: String = format!(
+            "mapping files is not supported (fd={:?}, offset={:?}, len={:?})",
+            fd, offset, len
+        );
+        error!("map_file(): {}", cause);
+        Err(Fail::new(libc::ENOTSUP, &cause))
+    }
+
+    /// Checks if the region holds the `len` bytes that start at `addr`.
+    fn contains(&self, addr: usize, len: usize) -> bool {
+        addr >= self.addr && addr - self.addr + len <= self.len
+    }
+
+    /// Wraps the `len` bytes of the region that start at `addr` into buffers, without copying them, and appends them to
+    /// `result`. Data that does not fit in a single buffer spans multiple buffers.
+    fn wrap(self: &Rc<Self>, mut addr: usize, len: usize, result: &mut Option<DemiBuffer>) -> Result<(), Fail> {
+        debug_assert!(self.contains(addr, len));
+        let mut remaining: usize = len;
+        while remaining > 0 {
+            let len: u16 = remaining.min(u16::MAX as usize) as u16;
+            // Safety: `addr` is not null, and the region holds `len` bytes starting at it.
+            let buf: DemiBuffer =
+                unsafe { DemiBuffer::from_external(NonNull::new_unchecked(addr as *mut u8), len, self.clone()) };
+            addr += len as usize;
+            remaining -= len as usize;
+            match result.as_mut() {
+                Some(result) => result.chain(buf)?,
+                None => *result = Some(buf),
+            }
+        }
+        Ok(())
+    }
+}
+
+impl MemoryRegistry {
+    /// Registers the memory region of `len` bytes that starts at `addr`.
+    pub fn register(&mut self, addr: *const u8, len: usize) -> Result<(), Fail> {
+        let start: usize = addr as usize;
+        if addr.is_null() || len == 0 || start.checked_add(len).is_none() {
+            let cause: String = format!("invalid memory region (addr={:?}, len={:?})", addr, len);
+            error!("register(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        // Regions cannot overlap, so that every address maps to a single region.
+        let overlaps_prev: bool = match self.regions.range(..start).next_back() {
+            Some((_, prev)) => prev.addr + prev.len > start,
+            None => false,
+        };
+        let overlaps_next: bool = match self.regions.range(start..).next() {
+            Some((_, next)) => next.addr < start + len,
+            None => false,
+        };
+        if overlaps_prev || overlaps_next {
+            let cause: String = format!(
+                "memory region overlaps a registered region (addr={:?}, len={:?})",
+                addr, len
+            );
+            error!("register(): {}", cause);
+            return Err(Fail::new(libc::EEXIST, &cause));
+        }
+
+        self.regions.insert(
+            start,
+            Rc::new(MemoryRegion {
+                addr: start,
+                len,
+                mapped: false,
+            }),
+        );
+        Ok(())
+    }
+
+    /// Unregisters the memory region that starts at `addr`.
+    pub fn unregister(&mut self, addr: *const u8) -> Result<(), Fail> {
+        let start: usize = addr as usize;
+        let region: &Rc<MemoryRegion> = match self.regions.get(&start) {
+            Some(region) => region,
+            None => {
+                let cause: String = format!("memory region is not registered (addr={:?})", addr);
+                error!("unregister(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            },
+        };
+
+        // Check if any buffer still references data in this region.
+        if Rc::strong_count(region) > 1 {
+            let cause: String = format!("memory region is in use (addr={:?})", addr);
+            error!("unregister(): {}", cause);
+            return Err(Fail::new(libc::EBUSY, &cause));
+        }
+
+        self.regions.remove(&start);
+        Ok(())
+    }
+
+    /// Returns the registered region that holds the `len` bytes that start at `addr`, if any.
+    fn lookup(&self, addr: usize, len: usize) -> Option<&Rc<MemoryRegion>> {
+        match self.regions.range(..=addr).next_back() {
+            Some((_, region)) if region.contains(addr, len) => Some(region),
+            _ => None,
+        }
+    }
+
+    /// Wraps the segments of a scatter-gather array that the application built on top of registered memory into a
+    /// buffer chain, without copying them. Segments that do not fit in a single buffer span multiple buffers.
+    pub fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+        if sga.sga_numsegs == 0 || sga.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
+            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+        }
+
+        let mut result: Option<DemiBuffer> = None;
+        for sga_seg in &sga.sga_segs[..sga.sga_numsegs as usize] {
+            let addr: usize = sga_seg.sgaseg_buf as usize;
+            let len: usize = sga_seg.sgaseg_len as usize;
+            let region: &Rc<MemoryRegion> = match self.lookup(addr, len) {
+                Some(region) => region,
+                None => {
+                    let cause: String = format!("demi_sgarray_t segment is not in a registered memory region");
+                    error!("clone_sgarray(): {}", cause);
+                    return Err(Fail::new(libc::EINVAL, &cause));
+                },
+            };
+            region.wrap(addr, len, &mut result)?;
+        }
+
+        match result {
+            Some(buf) => Ok(buf),
+            None => Err(Fail::new(libc::EINVAL, "zero-length buffer")),
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for MemoryRegion {
+    fn drop(&mut self) {
+        if !self.mapped {
+            return;
+        }
+        // Safety: the region is a mapping that we created, and no buffer references it anymore.
+        #[cfg(target_os = "linux")]
+        if unsafe { libc::munmap(self.addr as *mut libc::c_void, self.len) } != 0 {
+            warn!(
+                "drop(): failed to unmap file (addr={:#x}, len={:?})",
+                self.addr, self.len
+            );
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::runtime::{
+        memory::{DemiBuffer, MemoryRegistry},
+        types::{demi_sgarray_t, demi_sgaseg_t, DEMI_SGARRAY_MAXLEN},
+    };
+    use ::anyhow::Result;
+    use ::libc::c_void;
+    use ::std::{mem, ptr};
+
+    #[cfg(target_os = "linux")]
+    use crate::runtime::memory::MemoryRegion;
+    #[cfg(target_os = "linux")]
+    use ::std::{
+        env,
+        fs::{self, File},
+        os::fd::AsRawFd,
+        path::PathBuf,
+        process,
+    };
+
+    // Builds a single-segment scatter-gather array that describes `data`.
+    fn mksga(data: &mut [u8]) -> demi_sgarray_t {
+        let mut sga: demi_sgarray_t = unsafe { mem::zeroed() };
+        sga.sga_buf = ptr::null_mut();
+        sga.sga_numsegs = 1;
+        sga.sga_segs = [demi_sgaseg_t {
+            sgaseg_buf: ptr::null_mut(),
+            sgaseg_len: 0,
+        }; DEMI_SGARRAY_MAXLEN];
+        sga.sga_segs[0].sgaseg_buf = data.as_mut_ptr() as *mut c_void;
+        sga.sga_segs[0].sgaseg_len = data.len() as u32;
+        sga
+    }
+
+    // Tests registering, using, and unregistering a memory region.
+    #[test]
+    fn register_and_clone() -> Result<()> {
+        let mut memory: Vec<u8> = (0..128).collect();
+        let mut registry: MemoryRegistry = MemoryRegistry::default();
+
+        // Data outside registered memory is rejected.
+        crate::ensure_eq!(registry.clone_sgarray(&mksga(&mut memory[..])).is_err(), true);
+
+        registry.register(memory.as_ptr(), memory.len())?;
+        crate::ensure_eq!(registry.register(memory[64..].as_ptr(), 8).is_err(), true);
+
+        // Data inside registered memory is wrapped, not copied.
+        let buf: DemiBuffer = registry.clone_sgarray(&mksga(&mut memory[16..48]))?;
+        crate::ensure_eq!(buf.as_ptr(), memory[16..].as_ptr());
+        crate::ensure_eq!(&buf[..], &memory[16..48]);
+
+        // Clones keep the region in use, too.
+        let clone: DemiBuffer = buf.clone();
+        drop(buf);
+        crate::ensure_eq!(registry.unregister(memory.as_ptr()).is_err(), true);
+        drop(clone);
+        registry.unregister(memory.as_ptr())?;
+
+        // The region can't be used after it is unregistered.
+        crate::ensure_eq!(registry.clone_sgarray(&mksga(&mut memory[16..48])).is_err(), true);
+
+        Ok(())
+    }
+
+    // Tests mapping a range of a file that neither starts at a page boundary nor fits in a single buffer.
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn map_file() -> Result<()> {
+        const FILE_SIZE: usize = 3 * u16::MAX as usize;
+        const OFFSET: usize = 4097;
+        let contents: Vec<u8> = (0..FILE_SIZE).map(|i| (i % 251) as u8).collect();
+        let path: PathBuf = env::temp_dir().join(format!("demikernel-map-file-{}", process::id()));
+        fs::write(&path, &contents)?;
+        let file: File = File::open(&path)?;
+        fs::remove_file(&path)?;
+
+        let len: usize = FILE_SIZE - OFFSET;
+        let buf: DemiBuffer = MemoryRegion::map_file(file.as_raw_fd(), OFFSET as u64, len)?;
+        crate::ensure_eq!(buf.chain_len(), len);
+        crate::ensure_eq!(buf.num_segments(), 3);
+        let mapped: Vec<u8> = buf.segments().flatten().copied().collect();
+        crate::ensure_eq!(&mapped[..], &contents[OFFSET..]);
+
+        // Ranges that the file does not hold are rejected.
+        crate::ensure_eq!(
+            MemoryRegion::map_file(file.as_raw_fd(), OFFSET as u64, FILE_SIZE).is_err(),
+            true
+        );
+        crate::ensure_eq!(MemoryRegion::map_file(file.as_raw_fd(), 0, 0).is_err(), true);
+
+        Ok(())
+    }
+}
@@ -35,13 +35,14 @@ use crate::coroutine_timer;
 
 use crate::{
     expect_some,
+    perftools::stats,
     runtime::{
         fail::Fail,
         network::socket::SocketId,
         network::SocketIdToQDescMap,
         poll::PollFuture,
-        queue::{IoQueue, IoQueueTable},
-        scheduler::{SharedScheduler, TaskWithResult},
+        queue::{IoQueue, IoQueueTable, QTokenSetTable},
+        scheduler::{SharedScheduler, Task, TaskAllocator, TaskWithResult},
     },
 };
 use ::futures::{future::FusedFuture, select_biased, Future, FutureExt};
@@ -55,7 +56,6 @@ use ::std::{
     rc::Rc,
     time::{Duration, Instant, SystemTime},
 };
-use std::pin::Pin;
 
 //======================================================================================================================
 // Constants
@@ -78,6 +78,10 @@ pub struct DemiRuntime {
     ts_iters: usize,
     /// Tasks that have been completed and removed from the
     completed_tasks: HashMap<QToken, (QDesc, OperationResult)>,
+    /// Persistent queue token sets, which track completed tasks as they are removed from the scheduler.
+    qtoken_sets: QTokenSetTable,
+    /// Time at which the wait that is in progress times out, or None if we are not in a wait.
+    wait_deadline: Option<Instant>,
 }
 
 #[derive(Clone)]
@@ -113,6 +117,8 @@ impl SharedDemiRuntime {
             socket_id_to_qdesc_map: SocketIdToQDescMap::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            qtoken_sets: QTokenSetTable::default(),
+            wait_deadline: None,
         }))
     }
 
@@ -120,7 +126,7 @@ impl SharedDemiRuntime {
     pub fn insert_io_coroutine<F: FusedFuture<Output = (QDesc, OperationResult)> + 'static>(
         &mut self,
         task_name: &'static str,
-        coroutine: Pin<Box<F>>,
+        coroutine: F,
     ) -> Result<QToken, Fail> {
         self.insert_coroutine(task_name, coroutine)
     }
@@ -129,16 +135,16 @@ impl SharedDemiRuntime {
     pub fn insert_background_coroutine<F: FusedFuture<Output = ()> + 'static>(
         &mut self,
         task_name: &'static str,
-        coroutine: Pin<Box<F>>,
+        coroutine: F,
     ) -> Result<QToken, Fail> {
         self.insert_coroutine(task_name, coroutine)
     }
 
-    /// Inserts a coroutine of type T and task
+    /// Inserts a coroutine of type T and task. The coroutine is moved into a pooled slot, so callers should not box it.
     pub fn insert_coroutine<F: FusedFuture + 'static>(
         &mut self,
         task_name: &'static str,
-        coroutine: Pin<Box<F>>,
+        coroutine: F,
     ) -> Result<QToken, Fail>
     where
         F::Output: Unpin + Clone + Any,
@@ -179,25 +185,23 @@ impl SharedDemiRuntime {
         }
 
         // 2. None of the tasks have already completed, so start a timer and move the clock.
+        self.start_wait(match abstime {
+            Some(abstime) => abstime.duration_since(SystemTime::now()).unwrap_or_default(),
+            None => Duration::MAX,
+        });
         self.advance_clock_to_now();
 
         loop {
             if let Some(boxed_task) = self.scheduler.get_next_completed_task(TIMER_RESOLUTION) {
-                // Perform bookkeeping for the completed and removed task.
-                trace!("Removing coroutine: {:?}", boxed_task.get_name());
-                let completed_qt: QToken = boxed_task.get_id().into();
                 // If an operation task (and not a background task), then check the task to see if it is one of ours.
-                if let Ok(mut operation_task) = OperationTask::try_from(boxed_task.as_any()) {
-                    let (qd, result): (QDesc, OperationResult) =
-                        expect_some!(operation_task.get_result(), "coroutine not finished");
-
+                if let Some((completed_qt, qd, result)) = self.take_operation_result(boxed_task) {
                     // Check whether it matches any of the queue tokens that we are waiting on.
                     if completed_qt == qt {
                         return Ok((qd, result));
                     }
 
                     // If not a queue token that we are waiting on, then insert into our list of completed tasks.
-                    self.completed_tasks.insert(qt, (qd, result));
+                    self.completed_tasks.insert(completed_qt, (qd, result));
                 }
             }
             // Check the timeout.
@@ -218,6 +222,7 @@ impl SharedDemiRuntime {
         qts: &[QToken],
         timeout: Duration,
     ) -> Result<(usize, QToken, QDesc, OperationResult), Fail> {
+        stats::record_wait_any_scan(qts.len());
         for (i, qt) in qts.iter().enumerate() {
             // 1. Check if any of these queue tokens point to already completed tasks.
             if let Some((qd, result)) = self.get_completed_task(&qt) {
@@ -233,6 +238,7 @@ impl SharedDemiRuntime {
         }
 
         // 3. None of the tasks have already completed, so start a timer and move the clock.
+        self.start_wait(timeout);
         self.advance_clock_to_now();
         let mut prev_time: Instant = self.get_now();
         let mut remaining_time: Duration = timeout;
@@ -261,6 +267,78 @@ impl SharedDemiRuntime {
         self.completed_tasks.remove(qt)
     }
 
+    /// Allocates a new empty queue token set and returns its identifier.
+    pub fn alloc_qtoken_set(&mut self) -> usize {
+        self.qtoken_sets.alloc()
+    }
+
+    /// Releases the queue token set identified by `set`.
+    pub fn free_qtoken_set(&mut self, set: usize) -> Result<(), Fail> {
+        self.qtoken_sets.free(set)
+    }
+
+    /// Inserts `qt` into the queue token set identified by `set`. The queue token leaves the set once its result is
+    /// returned by any wait.
+    pub fn insert_into_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        let completed: bool = self.completed_tasks.contains_key(&qt);
+        if !completed && !self.scheduler.is_valid_task(&TaskId::from(qt)) {
+            let cause: String = format!("{:?} is not a valid queue token", qt);
+            warn!("insert_into_qtoken_set(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        self.qtoken_sets.insert(set, qt, completed)
+    }
+
+    /// Removes the pending queue token `qt` from the queue token set identified by `set`.
+    pub fn remove_from_qtoken_set(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        self.qtoken_sets.remove(set, qt)
+    }
+
+    /// Waits until one of the tasks in the queue token set identified by `set` has completed and returns the result.
+    /// Unlike wait_any(), this does not look at the tasks in the set that have not completed.
+    pub fn wait_any_set(&mut self, set: usize, timeout: Duration) -> Result<(QToken, QDesc, OperationResult), Fail> {
+        self.start_wait(timeout);
+        self.advance_clock_to_now();
+        let mut prev_time: Instant = self.get_now();
+        let mut remaining_time: Duration = timeout;
+
+        loop {
+            // 1. Return the first completed task in the set. Its result may have been returned by another wait already.
+            loop {
+                match self.qtoken_sets.pop_ready(set)? {
+                    (Some(qt), _) => {
+                        if let Some((qd, result)) = self.completed_tasks.remove(&qt) {
+                            return Ok((qt, qd, result));
+                        }
+                    },
+                    (None, true) => break,
+                    (None, false) => {
+                        let cause: String = format!("queue token set has no pending tasks (set={:?})", set);
+                        warn!("wait_any_set(): {}", cause);
+                        return Err(Fail::new(libc::EINVAL, &cause));
+                    },
+                }
+            }
+
+            // 2. Run for one quanta. Completed tasks are moved to the ready list of their set, if any.
+            if let Some((qt, qd, result)) = self.run_next(remaining_time) {
+                self.completed_tasks.insert(qt, (qd, result));
+            }
+
+            // 3. Move time forward.
+            self.advance_clock_to_now();
+            let now: Instant = self.get_now();
+            let time_elapsed: Duration = now - prev_time;
+
+            if time_elapsed > remaining_time {
+                return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
+            } else {
+                remaining_time = remaining_time - time_elapsed;
+                prev_time = now;
+            }
+        }
+    }
+
     /// Waits until the next task is complete, passing the result to `acceptor`. The acceptor may return true to
     /// continue waiting or false to exit the wait. The method will return when either the acceptor returns false
     /// (returning Ok) or the timeout has expired (returning a Fail indicating timeout).
@@ -277,6 +355,7 @@ impl SharedDemiRuntime {
         }
 
         // 2. None of the tasks have already completed, so start a timer and move the clock.
+        self.start_wait(timeout);
         self.advance_clock_to_now();
         let mut prev_time: Instant = self.get_now();
         let mut remaining_time: Duration = timeout;
@@ -303,6 +382,20 @@ impl SharedDemiRuntime {
         }
     }
 
+    /// Polls the scheduler once and passes the results of all completed tasks to `acceptor`, without waiting. The
+    /// acceptor may return false to stop early, in which case the remaining results are kept for later.
+    pub fn take_completed_n<Acceptor: FnMut(QToken, QDesc, OperationResult) -> bool>(
+        &mut self,
+        mut acceptor: Acceptor,
+    ) {
+        self.poll();
+        for (qt, (qd, result)) in self.completed_tasks.extract_if(|_, _| true) {
+            if acceptor(qt, qd, result) == false {
+                return;
+            }
+        }
+    }
+
     /// Runs the scheduler for one [TIMER_RESOLUTION] quanta, returning any task in `qts`. Importantly does not modify
     /// the clock.
     pub fn run_any(&mut self, qts: &[QToken], timeout: Duration) -> Option<(usize, QDesc, OperationResult)> {
@@ -328,33 +421,35 @@ impl SharedDemiRuntime {
             timeout if timeout.as_secs() > 0 => TIMER_RESOLUTION,
             _ => TIMER_FINER_RESOLUTION,
         };
-        if let Some(boxed_task) = self.scheduler.get_next_completed_task(iterations) {
-            // Perform bookkeeping for the completed and removed task.
-            trace!("Removing coroutine: {:?}", boxed_task.get_name());
-            let qt: QToken = boxed_task.get_id().into();
+        let boxed_task: Box<dyn Task, TaskAllocator> = self.scheduler.get_next_completed_task(iterations)?;
+        self.take_operation_result(boxed_task)
+    }
 
-            // If an operation task, then take a look at the result.
-            if let Ok(mut operation_task) = OperationTask::try_from(boxed_task.as_any()) {
-                let (qd, result): (QDesc, OperationResult) =
-                    expect_some!(operation_task.get_result(), "coroutine not finished");
+    /// Performs bookkeeping for a task that was completed and removed from the scheduler. If it is an operation task,
+    /// marks its queue token as ready in its queue token set and returns the result.
+    fn take_operation_result(
+        &mut self,
+        mut boxed_task: Box<dyn Task, TaskAllocator>,
+    ) -> Option<(QToken, QDesc, OperationResult)> {
+        trace!("Removing coroutine: {:?}", boxed_task.get_name());
+        let qt: QToken = boxed_task.get_id().into();
 
-                return Some((qt, qd, result));
-            }
-        }
+        // If an operation task, then take a look at the result. The task goes back to the pool when we return.
+        let operation_task: &mut OperationTask = boxed_task.as_any_mut().downcast_mut::<OperationTask>()?;
+        let (qd, result): (QDesc, OperationResult) =
+            expect_some!(operation_task.get_result(), "coroutine not finished");
+        self.qtoken_sets.notify(qt);
 
-        None
+        Some((qt, qd, result))
     }
 
     /// Performs a single pool on the underlying scheduler.
     pub fn poll(&mut self) {
+        // Polling never blocks.
+        self.wait_deadline = None;
         // For all ready tasks that were removed from the scheduler, add to our completed task list.
         for boxed_task in self.scheduler.poll_all() {
-            trace!("Completed while polling coroutine: {:?}", boxed_task.get_name());
-            let qt: QToken = boxed_task.get_id().into();
-
-            if let Ok(mut operation_task) = OperationTask::try_from(boxed_task.as_any()) {
-                let (qd, result): (QDesc, OperationResult) =
-                    expect_some!(operation_task.get_result(), "coroutine not finished");
+            if let Some((qt, qd, result)) = self.take_operation_result(boxed_task) {
                 self.completed_tasks.insert(qt, (qd, result));
             }
         }
@@ -395,6 +490,28 @@ impl SharedDemiRuntime {
         self.qtable.get_type(qd)
     }
 
+    /// Gets how long coroutines may block the thread while there is nothing else to do, which is until the next timer
+    /// fires or the wait that is in progress times out, but no longer than `max`. Returns None if we are not in a wait
+    /// or other coroutines are ready to run, in which case coroutines must not block at all.
+    pub fn get_idle_timeout(&self, max: Duration) -> Option<Duration> {
+        let wait_deadline: Instant = self.wait_deadline?;
+        if self.scheduler.has_ready_tasks() {
+            return None;
+        }
+        let deadline: Instant = match timer::global_next_deadline() {
+            Some(timer_deadline) => timer_deadline.min(wait_deadline),
+            None => wait_deadline,
+        };
+        Some(deadline.saturating_duration_since(Instant::now()).min(max))
+    }
+
+    /// Records when the wait that is starting times out.
+    fn start_wait(&mut self, timeout: Duration) {
+        let now: Instant = Instant::now();
+        // Waits that do not time out are bounded by the next timer and the caller of get_idle_timeout() instead.
+        self.wait_deadline = Some(now.checked_add(timeout).unwrap_or(now + Duration::from_secs(86400)));
+    }
+
     /// Moves time forward deterministically.
     pub fn advance_clock(&mut self, now: Instant) {
         timer::global_advance_clock(now)
@@ -476,6 +593,11 @@ pub async fn yield_with_timeout(timeout: Duration) {
     timer::wait(timeout).await
 }
 
+/// Yield until the [expiry] time passes.
+pub async fn yield_until(expiry: Instant) {
+    timer::wait_until(expiry).await
+}
+
 /// Yield until either the condition completes or we time out. If the timeout is 0, then run
 pub async fn conditional_yield_with_timeout<F: Future>(condition: F, timeout: Duration) -> Result<F::Output, Fail> {
     select_biased! {
@@ -516,6 +638,8 @@ impl Default for SharedDemiRuntime {
             socket_id_to_qdesc_map: SocketIdToQDescMap::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            qtoken_sets: QTokenSetTable::default(),
+            wait_deadline: None,
         }))
     }
 }
@@ -608,12 +732,16 @@ impl DerefMut for SharedDemiRuntime {
 pub trait Runtime: Clone + Unpin + 'static {}
 
 //======================================================================================================================
-// Benchmarks
+// Unit Tests
 //======================================================================================================================
 
 #[cfg(test)]
 mod tests {
-    use crate::runtime::{poll_yield, OperationResult, QDesc, QToken, SharedDemiRuntime};
+    use crate::{
+        expect_ok,
+        runtime::{poll_yield, scheduler::TaskAllocator, OperationResult, QDesc, QToken, SharedDemiRuntime},
+    };
+    use ::anyhow::Result;
     use ::std::time::Duration;
     use futures::FutureExt;
     use test::Bencher;
@@ -635,7 +763,41 @@ mod tests {
     fn benchmark_insert_io_coroutine(b: &mut Bencher) {
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
 
-        b.iter(|| runtime.insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(10).fuse())));
+        b.iter(|| runtime.insert_io_coroutine("dummy coroutine", dummy_coroutine(10).fuse()));
+    }
+
+    #[bench]
+    fn benchmark_insert_and_wait_io_coroutine(b: &mut Bencher) {
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+
+        b.iter(|| {
+            let qt: QToken = expect_ok!(
+                runtime.insert_io_coroutine("dummy coroutine", dummy_coroutine(1).fuse()),
+                "should be able to insert tasks"
+            );
+            expect_ok!(runtime.wait(qt, Duration::from_secs(1)), "task should complete")
+        });
+    }
+
+    /// Tests that I/O coroutines reuse the task slots of the ones that came before them, so that the steady-state path
+    /// of an operation does not allocate tasks and coroutines from the heap.
+    #[test]
+    fn io_coroutines_reuse_task_slots() -> Result<()> {
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let mut run_coroutine = || -> Result<()> {
+            let qt: QToken = runtime.insert_io_coroutine("dummy coroutine", dummy_coroutine(1).fuse())?;
+            runtime.wait(qt, Duration::from_secs(1))?;
+            Ok(())
+        };
+
+        run_coroutine()?;
+        let num_heap_allocations: usize = TaskAllocator::num_heap_allocations();
+        for _ in 0..128 {
+            run_coroutine()?;
+        }
+        crate::ensure_eq!(TaskAllocator::num_heap_allocations(), num_heap_allocations);
+
+        Ok(())
     }
 
     #[bench]
@@ -643,10 +805,7 @@ mod tests {
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
 
         b.iter(|| {
-            runtime.insert_background_coroutine(
-                "dummy background coroutine",
-                Box::pin(dummy_background_coroutine().fuse()),
-            )
+            runtime.insert_background_coroutine("dummy background coroutine", dummy_background_coroutine().fuse())
         });
     }
 
@@ -659,7 +818,7 @@ mod tests {
         for i in 0..NUM_TASKS {
             // Make the arg big enough that the coroutine doesn't exit.
             qts[i] = runtime
-                .insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(1000000000).fuse()))
+                .insert_io_coroutine("dummy coroutine", dummy_coroutine(1000000000).fuse())
                 .expect("should be able to insert tasks");
         }
 
@@ -676,7 +835,7 @@ mod tests {
         for i in 0..NUM_TASKS {
             // Make the arg big enough that the coroutine doesn't exit.
             qts[i] = runtime
-                .insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(1000000000).fuse()))
+                .insert_io_coroutine("dummy coroutine", dummy_coroutine(1000000000).fuse())
                 .expect("should be able to insert tasks");
         }
 
@@ -693,7 +852,7 @@ mod tests {
         for i in 0..NUM_TASKS {
             // Make the arg big enough that the coroutine doesn't exit.
             qts[i] = runtime
-                .insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(1000000000).fuse()))
+                .insert_io_coroutine("dummy coroutine", dummy_coroutine(1000000000).fuse())
                 .expect("should be able to insert tasks");
         }
 
@@ -701,6 +860,35 @@ mod tests {
         b.iter(|| runtime.run_any(&qts, Duration::from_secs(1)));
     }
 
+    #[test]
+    fn wait_any_set() -> Result<()> {
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let set: usize = runtime.alloc_qtoken_set();
+        let idle_qt: QToken = runtime.insert_io_coroutine("dummy coroutine", dummy_coroutine(1000000000).fuse())?;
+        let ready_qt: QToken = runtime.insert_io_coroutine("dummy coroutine", dummy_coroutine(2).fuse())?;
+        runtime.insert_into_qtoken_set(set, idle_qt)?;
+        runtime.insert_into_qtoken_set(set, ready_qt)?;
+        crate::ensure_eq!(runtime.insert_into_qtoken_set(set, ready_qt).is_err(), true);
+
+        // Only the completed task is returned, and it leaves the set.
+        let (qt, _, _) = runtime.wait_any_set(set, Duration::from_secs(1))?;
+        crate::ensure_eq!(qt, ready_qt);
+        crate::ensure_eq!(
+            runtime.wait_any_set(set, Duration::ZERO).err().map(|e| e.errno),
+            Some(libc::ETIMEDOUT)
+        );
+
+        // Waiting on a set without pending tasks fails.
+        runtime.remove_from_qtoken_set(set, idle_qt)?;
+        crate::ensure_eq!(
+            runtime.wait_any_set(set, Duration::ZERO).err().map(|e| e.errno),
+            Some(libc::EINVAL)
+        );
+        runtime.free_qtoken_set(set)?;
+
+        Ok(())
+    }
+
     #[bench]
     fn benchmark_run_any_background_long(b: &mut Bencher) {
         const NUM_TASKS: usize = 1024;
@@ -709,14 +897,30 @@ mod tests {
         // Insert a large number of coroutines.
         for i in 0..NUM_TASKS {
             qts[i] = runtime
-                .insert_background_coroutine(
-                    "dummy background coroutine",
-                    Box::pin(dummy_background_coroutine().fuse()),
-                )
+                .insert_background_coroutine("dummy background coroutine", dummy_background_coroutine().fuse())
                 .expect("should be able to insert tasks");
         }
 
         // Run all of the tasks for one quanta
         b.iter(|| runtime.run_any(&qts, Duration::from_secs(1)));
     }
+    #[bench]
+    fn benchmark_wait_any_set_idle(b: &mut Bencher) {
+        const NUM_TASKS: usize = 1024;
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let set: usize = runtime.alloc_qtoken_set();
+        // Insert a large number of coroutines.
+        for _ in 0..NUM_TASKS {
+            // Make the arg big enough that the coroutine doesn't exit.
+            let qt: QToken = runtime
+                .insert_io_coroutine("dummy coroutine", dummy_coroutine(1000000000).fuse())
+                .expect("should be able to insert tasks");
+            runtime
+                .insert_into_qtoken_set(set, qt)
+                .expect("should be able to insert queue tokens");
+        }
+
+        // Wait on all of the tasks for one small quanta.
+        b.iter(|| runtime.wait_any_set(set, Duration::ZERO));
+    }
 }
@@ -30,6 +30,12 @@ pub struct TcpConfig {
     ack_delay_timeout: Duration,
     rx_checksum_offload: bool,
     tx_checksum_offload: bool,
+    /// Send segments larger than the MSS and let the layers below cut them.
+    segmentation_offload: bool,
+    /// Merge back-to-back in-order segments that arrive in the same receive burst.
+    receive_coalescing: bool,
+    /// Handshakes that a listening socket keeps in flight before it answers further SYNs with SYN cookies.
+    syn_cookie_threshold: usize,
 }
 
 //======================================================================================================================
@@ -49,6 +55,15 @@ impl TcpConfig {
             options.rx_checksum_offload = value;
             options.tx_checksum_offload = value;
         }
+        if let Ok(value) = config.tcp_segmentation_offload() {
+            options.segmentation_offload = value;
+        }
+        if let Ok(value) = config.tcp_receive_coalescing() {
+            options.receive_coalescing = value;
+        }
+        if let Ok(value) = config.tcp_syn_cookie_threshold() {
+            options.syn_cookie_threshold = value;
+        }
 
         Ok(options)
     }
@@ -84,6 +99,18 @@ impl TcpConfig {
     pub fn get_rx_checksum_offload(&self) -> bool {
         self.rx_checksum_offload
     }
+
+    pub fn get_segmentation_offload(&self) -> bool {
+        self.segmentation_offload
+    }
+
+    pub fn get_receive_coalescing(&self) -> bool {
+        self.receive_coalescing
+    }
+
+    pub fn get_syn_cookie_threshold(&self) -> usize {
+        self.syn_cookie_threshold
+    }
 }
 
 //======================================================================================================================
@@ -101,6 +128,9 @@ impl Default for TcpConfig {
             window_scale: 0,
             rx_checksum_offload: false,
             tx_checksum_offload: false,
+            segmentation_offload: false,
+            receive_coalescing: false,
+            syn_cookie_threshold: 256,
         }
     }
 }
@@ -125,6 +155,9 @@ mod tests {
         crate::ensure_eq!(config.get_window_scale(), 0);
         crate::ensure_eq!(config.get_rx_checksum_offload(), false);
         crate::ensure_eq!(config.get_tx_checksum_offload(), false);
+        crate::ensure_eq!(config.get_segmentation_offload(), false);
+        crate::ensure_eq!(config.get_receive_coalescing(), false);
+        crate::ensure_eq!(config.get_syn_cookie_threshold(), 256);
 
         Ok(())
     }
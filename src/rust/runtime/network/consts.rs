@@ -36,10 +36,17 @@ pub const TCP_HANDSHAKE_TIMEOUT: Duration = Duration::from_secs(3);
 /// TODO: Auto-Discovery MTU Size
 pub const DEFAULT_MSS: usize = 1450;
 
-/// Length of a [crate::memory::DemiBuffer] batch.
-///
-/// TODO: This Should be Generic
-pub const RECEIVE_BATCH_SIZE: usize = 4;
+/// Capacity of a [crate::memory::DemiBuffer] receive batch. This bounds the configurable receive burst size.
+pub const MAX_RECEIVE_BATCH_SIZE: usize = 64;
+
+/// Receive burst size used when the configuration file does not set one.
+pub const DEFAULT_RECEIVE_BATCH_SIZE: usize = 32;
+
+/// Maximum number of outgoing packets that a physical layer stages before handing them to the device in one burst.
+pub const TRANSMIT_BATCH_SIZE: usize = 32;
+
+/// Maximum time that an outgoing packet may sit in a transmit batch before the batch is flushed.
+pub const TRANSMIT_BATCH_TIMEOUT: Duration = Duration::from_micros(10);
 
 /// Maximum local and remote window scaling factor.
 /// See: RFC 1323, Section 2.3.
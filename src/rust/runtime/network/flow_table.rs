@@ -0,0 +1,310 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::network::socket::SocketId;
+#[cfg(target_arch = "x86_64")]
+use ::std::arch::x86_64::{_mm_prefetch, _MM_HINT_T0};
+use ::std::{mem, net::SocketAddrV4};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of buckets of an empty table, as a power of two.
+const MIN_CAPACITY: usize = 64;
+/// Marks a bucket that holds no flow. The hashes of flows always have their top bit set, so they never take this value.
+const EMPTY: u32 = 0;
+const OCCUPIED: u32 = 1 << 31;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Table of flows, keyed on their addresses. This is an open-addressing hash table with linear probing: the hashes of
+/// the flows are kept in an array of their own, so that a lookup mostly scans one cache line of hashes and touches a
+/// single entry, and removals shift the following entries back instead of leaving tombstones. The table grows as flows
+/// come and shrinks back as they go. Keys are hashed with a cheap keyed mix of the address 4-tuple.
+pub struct FlowTable<V> {
+    /// Hashes of the flows in each bucket, or [EMPTY].
+    hashes: Vec<u32>,
+    /// Flows in each bucket.
+    entries: Vec<Option<(SocketId, V)>>,
+    /// Number of flows in the table.
+    len: usize,
+    /// Key of the hash function, so that remote peers cannot pick addresses that collide.
+    seed: u64,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl<V> FlowTable<V> {
+    /// Creates an empty table whose hash function is keyed with `seed`.
+    pub fn new(seed: u64) -> Self {
+        Self {
+            hashes: vec![EMPTY; MIN_CAPACITY],
+            entries: (0..MIN_CAPACITY).map(|_| None).collect(),
+            len: 0,
+            seed,
+        }
+    }
+
+    /// Gets the number of flows in the table.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Gets a reference to the value of a flow.
+    pub fn get(&self, key: &SocketId) -> Option<&V> {
+        let index: usize = self.find(key)?;
+        self.entries[index].as_ref().map(|(_, value)| value)
+    }
+
+    /// Gets a mutable reference to the value of a flow.
+    pub fn get_mut(&mut self, key: &SocketId) -> Option<&mut V> {
+        let index: usize = self.find(key)?;
+        self.entries[index].as_mut().map(|(_, value)| value)
+    }
+
+    /// Inserts a flow and returns the value that it had before, if any.
+    pub fn insert(&mut self, key: SocketId, value: V) -> Option<V> {
+        if let Some(index) = self.find(&key) {
+            return self.entries[index]
+                .as_mut()
+                .map(|(_, old_value)| mem::replace(old_value, value));
+        }
+        // Keep the load factor under 3/4, so that probe sequences stay short.
+        if (self.len + 1) * 4 > self.hashes.len() * 3 {
+            self.resize(self.hashes.len() * 2);
+        }
+        let hash: u32 = self.hash(&key);
+        self.place(hash, key, value);
+        self.len += 1;
+        None
+    }
+
+    /// Removes a flow and returns its value.
+    pub fn remove(&mut self, key: &SocketId) -> Option<V> {
+        let mut hole: usize = self.find(key)?;
+        let value: Option<V> = self.entries[hole].take().map(|(_, value)| value);
+        self.hashes[hole] = EMPTY;
+        self.len -= 1;
+
+        // Shift back the entries that follow in the same run, unless they would end up before their home bucket.
+        let mask: usize = self.mask();
+        let mut index: usize = (hole + 1) & mask;
+        while self.hashes[index] != EMPTY {
+            let home: usize = self.hashes[index] as usize & mask;
+            if (index.wrapping_sub(home) & mask) >= (index.wrapping_sub(hole) & mask) {
+                self.hashes[hole] = mem::replace(&mut self.hashes[index], EMPTY);
+                self.entries[hole] = self.entries[index].take();
+                hole = index;
+            }
+            index = (index + 1) & mask;
+        }
+
+        // Give back the memory of a burst of flows once most of them are gone. This shrinks at a quarter of the load
+        // factor at which we grow, so that a table that hovers around either threshold does not keep rehashing.
+        if self.hashes.len() > MIN_CAPACITY && self.len * 16 < self.hashes.len() * 3 {
+            self.resize(self.hashes.len() / 2);
+        }
+        value
+    }
+
+    /// Iterates over the flows in the table.
+    pub fn iter(&self) -> impl Iterator<Item = (&SocketId, &V)> {
+        self.entries
+            .iter()
+            .filter_map(|entry| entry.as_ref().map(|(key, value)| (key, value)))
+    }
+
+    /// Hints the CPU to bring the home bucket of a flow into the cache, so that a lookup shortly after does not stall
+    /// on it.
+    pub fn prefetch(&self, key: &SocketId) {
+        #[cfg(target_arch = "x86_64")]
+        {
+            let index: usize = self.hash(key) as usize & self.mask();
+            // Safety: prefetching has no side effects, and both pointers are within their arrays.
+            unsafe {
+                _mm_prefetch(self.hashes.as_ptr().add(index) as *const i8, _MM_HINT_T0);
+                _mm_prefetch(self.entries.as_ptr().add(index) as *const i8, _MM_HINT_T0);
+            }
+        }
+        #[cfg(not(target_arch = "x86_64"))]
+        let _ = key;
+    }
+
+    /// Finds the bucket of a flow.
+    fn find(&self, key: &SocketId) -> Option<usize> {
+        let hash: u32 = self.hash(key);
+        let mask: usize = self.mask();
+        let mut index: usize = hash as usize & mask;
+        loop {
+            match self.hashes[index] {
+                EMPTY => return None,
+                h if h == hash => match &self.entries[index] {
+                    Some((k, _)) if k == key => return Some(index),
+                    _ => (),
+                },
+                _ => (),
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    /// Puts a flow that is not in the table into the first empty bucket of its probe sequence.
+    fn place(&mut self, hash: u32, key: SocketId, value: V) {
+        let mask: usize = self.mask();
+        let mut index: usize = hash as usize & mask;
+        while self.hashes[index] != EMPTY {
+            index = (index + 1) & mask;
+        }
+        self.hashes[index] = hash;
+        self.entries[index] = Some((key, value));
+    }
+
+    /// Changes the number of buckets to `capacity`, which must be a power of two that fits all flows, and rehashes all
+    /// flows.
+    fn resize(&mut self, capacity: usize) {
+        debug_assert!(capacity.is_power_of_two() && capacity > self.len);
+        let hashes: Vec<u32> = mem::replace(&mut self.hashes, vec![EMPTY; capacity]);
+        let entries: Vec<Option<(SocketId, V)>> =
+            mem::replace(&mut self.entries, (0..capacity).map(|_| None).collect());
+        for (hash, entry) in hashes.into_iter().zip(entries) {
+            if let Some((key, value)) = entry {
+                self.place(hash, key, value);
+            }
+        }
+    }
+
+    fn mask(&self) -> usize {
+        self.hashes.len() - 1
+    }
+
+    /// Hashes the addresses of a flow. This is a multiply-xorshift mix of the 4-tuple, which takes a handful of cycles.
+    fn hash(&self, key: &SocketId) -> u32 {
+        const K: u64 = 0x9e37_79b9_7f4a_7c15;
+        let pack = |addr: &SocketAddrV4| -> u64 { (u32::from(*addr.ip()) as u64) << 16 | addr.port() as u64 };
+        let (local, remote): (u64, u64) = match key {
+            SocketId::Active(local, remote) => (pack(local), pack(remote)),
+            // Passive flows have no remote address, which is distinct from any that an active flow may have.
+            SocketId::Passive(local) => (pack(local), u64::MAX),
+        };
+        let mut h: u64 = (local ^ self.seed).wrapping_mul(K);
+        h = (h ^ (h >> 32) ^ remote).wrapping_mul(K);
+        h ^= h >> 29;
+        (h as u32) | OCCUPIED
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Creates an empty table whose hash function is keyed with a random seed, so that no two tables collide on the same
+/// addresses.
+impl<V> Default for FlowTable<V> {
+    fn default() -> Self {
+        Self::new(::rand::random())
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::runtime::network::{
+        flow_table::{FlowTable, MIN_CAPACITY},
+        socket::SocketId,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        collections::HashMap,
+        net::{Ipv4Addr, SocketAddrV4},
+    };
+
+    fn active(i: u32) -> SocketId {
+        SocketId::Active(
+            SocketAddrV4::new(Ipv4Addr::new(10, 0, 0, 1), 80),
+            SocketAddrV4::new(Ipv4Addr::from(0x0a01_0000 + i / 1000), (i % 1000) as u16),
+        )
+    }
+
+    // Tests that the table agrees with a hash map across insertions, replacements, removals and growth.
+    #[test]
+    fn test_flow_table_matches_hash_map() -> Result<()> {
+        let mut table: FlowTable<u32> = FlowTable::new(0x5eed);
+        let mut reference: HashMap<SocketId, u32> = HashMap::new();
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(10, 0, 0, 1), 80);
+
+        crate::ensure_eq!(table.insert(SocketId::Passive(local), 0), None);
+        reference.insert(SocketId::Passive(local), 0);
+        let mut state: u32 = 1;
+        for step in 0..20000u32 {
+            state = state.wrapping_mul(1664525).wrapping_add(1013904223);
+            let key: u32 = (state >> 8) % 3000;
+            if step % 3 == 2 {
+                crate::ensure_eq!(table.remove(&active(key)), reference.remove(&active(key)));
+            } else {
+                crate::ensure_eq!(table.insert(active(key), step), reference.insert(active(key), step));
+            }
+            crate::ensure_eq!(table.len(), reference.len());
+        }
+        for key in 0..3000 {
+            crate::ensure_eq!(table.get(&active(key)), reference.get(&active(key)));
+        }
+        crate::ensure_eq!(table.get(&SocketId::Passive(local)), Some(&0));
+        crate::ensure_eq!(table.iter().count(), reference.len());
+
+        Ok(())
+    }
+
+    // Tests that removing every flow leaves the table empty and usable.
+    #[test]
+    fn test_flow_table_remove_all() -> Result<()> {
+        let mut table: FlowTable<u32> = FlowTable::default();
+        for key in 0..500 {
+            table.insert(active(key), key);
+        }
+        for key in (0..500).rev() {
+            crate::ensure_eq!(table.remove(&active(key)), Some(key));
+            crate::ensure_eq!(table.get(&active(key)), None);
+        }
+        crate::ensure_eq!(table.len(), 0);
+        crate::ensure_eq!(table.insert(active(7), 7), None);
+        if let Some(value) = table.get_mut(&active(7)) {
+            *value = 8;
+        }
+        crate::ensure_eq!(table.get(&active(7)), Some(&8));
+
+        Ok(())
+    }
+
+    // Tests that the table gives back its buckets once a burst of flows is gone, and keeps the flows that remain.
+    #[test]
+    fn test_flow_table_shrinks() -> Result<()> {
+        let mut table: FlowTable<u32> = FlowTable::default();
+        for key in 0..10000 {
+            table.insert(active(key), key);
+        }
+        let capacity: usize = table.hashes.len();
+        for key in 10..10000 {
+            crate::ensure_eq!(table.remove(&active(key)), Some(key));
+        }
+        crate::ensure_eq!(table.len(), 10);
+        crate::ensure_eq!(table.hashes.len() < capacity / 64, true);
+        crate::ensure_eq!(table.hashes.len() >= MIN_CAPACITY, true);
+        for key in 0..10 {
+            crate::ensure_eq!(table.get(&active(key)), Some(&key));
+        }
+
+        Ok(())
+    }
+}
@@ -7,6 +7,7 @@
 
 pub mod config;
 pub mod consts;
+pub mod flow_table;
 pub mod ring;
 pub mod socket;
 pub mod transport;
@@ -17,7 +18,10 @@ pub mod types;
 //======================================================================================================================
 
 use crate::{
-    runtime::{network::socket::SocketId, Fail},
+    runtime::{
+        network::{flow_table::FlowTable, socket::SocketId},
+        Fail,
+    },
     QDesc,
 };
 use ::std::{
@@ -30,7 +34,10 @@ use ::std::{
 //======================================================================================================================
 
 pub struct SocketIdToQDescMap {
-    mappings: HashMap<SocketId, QDesc>,
+    mappings: FlowTable<QDesc>,
+    /// Number of sockets in `mappings` bound to each local address, so that we can tell whether one is in use without
+    /// going over all sockets.
+    local_addrs: HashMap<SocketAddrV4, usize>,
 }
 
 //======================================================================================================================
@@ -43,21 +50,34 @@ impl SocketIdToQDescMap {
     }
 
     pub fn insert(&mut self, socket_id: SocketId, qd: QDesc) -> Option<QDesc> {
-        self.mappings.insert(socket_id, qd)
+        let local: SocketAddrV4 = Self::local_addr(&socket_id);
+        let old_qd: Option<QDesc> = self.mappings.insert(socket_id, qd);
+        if old_qd.is_none() {
+            *self.local_addrs.entry(local).or_insert(0) += 1;
+        }
+        old_qd
     }
 
     pub fn remove(&mut self, socket_id: &SocketId) -> Option<QDesc> {
-        self.mappings.remove(socket_id)
+        let qd: QDesc = self.mappings.remove(socket_id)?;
+        let local: SocketAddrV4 = Self::local_addr(socket_id);
+        if let Some(count) = self.local_addrs.get_mut(&local) {
+            *count -= 1;
+            if *count == 0 {
+                self.local_addrs.remove(&local);
+            }
+        }
+        Some(qd)
     }
 
     pub fn is_in_use(&self, socket_addrv4: SocketAddrV4) -> bool {
-        for (socket_id, _) in &self.mappings {
-            match socket_id {
-                SocketId::Passive(addr) | SocketId::Active(addr, _) if *addr == socket_addrv4 => return true,
-                _ => continue,
-            }
+        self.local_addrs.contains_key(&socket_addrv4)
+    }
+
+    fn local_addr(socket_id: &SocketId) -> SocketAddrV4 {
+        match socket_id {
+            SocketId::Passive(addr) | SocketId::Active(addr, _) => *addr,
         }
-        false
     }
 }
 
@@ -68,7 +88,8 @@ impl SocketIdToQDescMap {
 impl Default for SocketIdToQDescMap {
     fn default() -> Self {
         Self {
-            mappings: HashMap::<SocketId, QDesc>::new(),
+            mappings: FlowTable::<QDesc>::default(),
+            local_addrs: HashMap::<SocketAddrV4, usize>::new(),
         }
     }
 }
@@ -8,7 +8,7 @@
 //======================================================================================================================
 
 use crate::{demikernel::config::Config, pal::KeepAlive, runtime::fail::Fail};
-use ::std::time::Duration;
+use ::std::{fmt, str::FromStr, time::Duration};
 #[cfg(target_os = "windows")]
 use ::windows::Win32::Networking::WinSock::tcp_keepalive;
 
@@ -26,6 +26,7 @@ const DEFAULT_KEEP_ALIVE: tcp_keepalive = tcp_keepalive {
     keepaliveinterval: 1000,
 };
 const DEFAULT_NO_DELAY: bool = true;
+const DEFAULT_CONGESTION_CONTROL: CongestionControlAlgorithm = CongestionControlAlgorithm::None;
 
 //======================================================================================================================
 // Structures
@@ -37,6 +38,21 @@ pub enum SocketOption {
     Linger(Option<Duration>),
     KeepAlive(KeepAlive),
     NoDelay(bool),
+    CongestionControl(CongestionControlAlgorithm),
+}
+
+/// Congestion control algorithms that TCP connections may use (TCP_CONGESTION). Only the network stack of Demikernel
+/// implements these.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CongestionControlAlgorithm {
+    /// No congestion control: the sender is only limited by the window of the receiver.
+    None,
+    /// CUBIC (RFC 8312).
+    Cubic,
+    /// Data Center TCP (RFC 8257), which reacts to the extent of ECN marks instead of to losses.
+    Dctcp,
+    /// BBR, which paces at the bottleneck bandwidth and sizes the window to the path's bandwidth-delay product.
+    Bbr,
 }
 
 #[derive(Debug, Clone, Copy)]
@@ -44,6 +60,7 @@ pub struct TcpSocketOptions {
     linger: Option<Duration>,
     keep_alive: KeepAlive,
     no_delay: bool,
+    congestion_control: CongestionControlAlgorithm,
 }
 
 impl TcpSocketOptions {
@@ -52,6 +69,7 @@ impl TcpSocketOptions {
             linger: config.linger().unwrap_or(DEFAULT_LINGER),
             keep_alive: config.tcp_keepalive().unwrap_or(DEFAULT_KEEP_ALIVE),
             no_delay: config.no_delay().unwrap_or(DEFAULT_NO_DELAY),
+            congestion_control: config.congestion_control()?.unwrap_or(DEFAULT_CONGESTION_CONTROL),
         })
     }
 
@@ -78,6 +96,26 @@ impl TcpSocketOptions {
     pub fn set_nodelay(&mut self, nodelay: bool) {
         self.no_delay = nodelay;
     }
+
+    pub fn get_congestion_control(&self) -> CongestionControlAlgorithm {
+        self.congestion_control
+    }
+
+    pub fn set_congestion_control(&mut self, congestion_control: CongestionControlAlgorithm) {
+        self.congestion_control = congestion_control;
+    }
+}
+
+impl CongestionControlAlgorithm {
+    /// Gets the name of the algorithm, as TCP_CONGESTION takes it.
+    pub fn name(&self) -> &'static str {
+        match self {
+            CongestionControlAlgorithm::None => "none",
+            CongestionControlAlgorithm::Cubic => "cubic",
+            CongestionControlAlgorithm::Dctcp => "dctcp",
+            CongestionControlAlgorithm::Bbr => "bbr",
+        }
+    }
 }
 
 impl Default for TcpSocketOptions {
@@ -86,6 +124,31 @@ impl Default for TcpSocketOptions {
             linger: DEFAULT_LINGER,
             keep_alive: DEFAULT_KEEP_ALIVE,
             no_delay: DEFAULT_NO_DELAY,
+            congestion_control: DEFAULT_CONGESTION_CONTROL,
+        }
+    }
+}
+
+impl FromStr for CongestionControlAlgorithm {
+    type Err = Fail;
+
+    fn from_str(name: &str) -> Result<Self, Fail> {
+        match name {
+            "none" => Ok(CongestionControlAlgorithm::None),
+            "cubic" => Ok(CongestionControlAlgorithm::Cubic),
+            "dctcp" => Ok(CongestionControlAlgorithm::Dctcp),
+            "bbr" => Ok(CongestionControlAlgorithm::Bbr),
+            _ => {
+                let cause: String = format!("unknown congestion control algorithm (name={:?})", name);
+                error!("from_str(): {}", cause);
+                Err(Fail::new(libc::ENOENT, &cause))
+            },
         }
     }
 }
+
+impl fmt::Display for CongestionControlAlgorithm {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "{}", self.name())
+    }
+}
@@ -7,7 +7,8 @@
 
 use crate::runtime::{
     fail::Fail,
-    memory::{DemiBuffer, MemoryRuntime},
+    limits,
+    memory::{DemiBuffer, MemoryRegion, MemoryRuntime},
     network::socket::option::SocketOption,
     SharedDemiRuntime,
 };
@@ -73,6 +74,33 @@ pub trait NetworkTransport: Clone + 'static + MemoryRuntime {
         addr: Option<SocketAddr>,
     ) -> impl std::future::Future<Output = Result<(), Fail>>;
 
+    /// Push `len` bytes of the file `fd`, starting at `offset`, to a connected socket. By default, the file is mapped
+    /// into memory one window at a time, and each window is pushed segment by segment without copying it, so a single
+    /// operation never holds more than a window of the file. Transports that can do better override this.
+    fn push_file(
+        &mut self,
+        sd: &mut Self::SocketDescriptor,
+        fd: libc::c_int,
+        offset: u64,
+        len: usize,
+    ) -> impl std::future::Future<Output = Result<(), Fail>> {
+        async move {
+            let mut offset: u64 = offset;
+            let mut remaining: usize = len;
+            while remaining > 0 {
+                let window: usize = remaining.min(limits::PUSH_FILE_WINDOW_SIZE);
+                let mut next: Option<DemiBuffer> = Some(MemoryRegion::map_file(fd, offset, window)?);
+                while let Some(mut segment) = next {
+                    next = segment.detach_tail();
+                    self.push(sd, &mut segment, None).await?;
+                }
+                offset += window as u64;
+                remaining -= window;
+            }
+            Ok(())
+        }
+    }
+
     /// Pop data from a connected socket.
     fn pop(
         &mut self,
@@ -83,6 +111,10 @@ pub trait NetworkTransport: Clone + 'static + MemoryRuntime {
     /// Asynchronously close a socket.
     fn close(&mut self, sd: &mut Self::SocketDescriptor) -> impl std::future::Future<Output = Result<(), Fail>>;
 
+    /// Flushes any outgoing data that the transport has staged but not yet handed to the device. This is called before
+    /// control returns to the application so that nothing sits in a staging buffer while the libOS is not polled.
+    fn flush(&mut self) {}
+
     /// Pull the common runtime out of the transport. We only need this because traits do not support members.
     fn get_runtime(&self) -> &SharedDemiRuntime;
 }
@@ -4,6 +4,7 @@
 mod operation_result;
 mod qdesc;
 mod qtoken;
+mod qtoken_set;
 mod qtype;
 
 //======================================================================================================================
@@ -19,7 +20,9 @@ use ::std::{any::Any, net::SocketAddrV4};
 // Exports
 //======================================================================================================================
 
-pub use self::{operation_result::OperationResult, qdesc::QDesc, qtoken::QToken, qtype::QType};
+pub use self::{
+    operation_result::OperationResult, qdesc::QDesc, qtoken::QToken, qtoken_set::QTokenSetTable, qtype::QType,
+};
 
 // Coroutine for running an operation on an I/O Queue.
 pub type Operation = dyn FusedFuture<Output = (QDesc, OperationResult)>;
@@ -0,0 +1,197 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::{fail::Fail, queue::QToken};
+use ::slab::Slab;
+use ::std::collections::{HashMap, HashSet, VecDeque};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A persistent set of queue tokens that an application waits on repeatedly.
+#[derive(Default)]
+struct QTokenSet {
+    /// Queue tokens in the set whose operations have not completed yet.
+    pending: HashSet<QToken>,
+    /// Queue tokens in the set whose operations have completed, in completion order.
+    ready: VecDeque<QToken>,
+}
+
+/// Table of queue token sets.
+///
+/// The runtime notifies this table whenever an operation completes, which moves the queue token of that operation to
+/// the ready list of the set that it belongs to. Waiting on a set then only looks at the ready list, so its cost
+/// depends on the number of completed operations and not on the number of queue tokens in the set.
+#[derive(Default)]
+pub struct QTokenSetTable {
+    sets: Slab<QTokenSet>,
+    /// Maps each queue token, pending or ready, to the set that it belongs to. A queue token belongs to at most one set
+    /// until a wait takes it from the ready list.
+    members: HashMap<QToken, usize>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl QTokenSetTable {
+    /// Allocates a new empty set and returns its identifier.
+    pub fn alloc(&mut self) -> usize {
+        self.sets.insert(QTokenSet::default())
+    }
+
+    /// Releases the set identified by `set`. Queue tokens in the set are left untouched.
+    pub fn free(&mut self, set: usize) -> Result<(), Fail> {
+        let qtset: QTokenSet = match self.sets.try_remove(set) {
+            Some(qtset) => qtset,
+            None => return Err(Self::bad_set("free", set)),
+        };
+        for qt in qtset.pending.iter().chain(qtset.ready.iter()) {
+            self.members.remove(qt);
+        }
+        Ok(())
+    }
+
+    /// Inserts `qt` into the set identified by `set`. If `completed` is set, the operation of `qt` has already
+    /// completed and `qt` is made ready immediately.
+    pub fn insert(&mut self, set: usize, qt: QToken, completed: bool) -> Result<(), Fail> {
+        if self.members.contains_key(&qt) {
+            let cause: String = format!("queue token already belongs to a set (qt={:?})", qt);
+            error!("insert(): {}", cause);
+            return Err(Fail::new(libc::EEXIST, &cause));
+        }
+        let qtset: &mut QTokenSet = match self.sets.get_mut(set) {
+            Some(qtset) => qtset,
+            None => return Err(Self::bad_set("insert", set)),
+        };
+        if completed {
+            qtset.ready.push_back(qt);
+        } else {
+            qtset.pending.insert(qt);
+        }
+        self.members.insert(qt, set);
+        Ok(())
+    }
+
+    /// Removes the pending queue token `qt` from the set identified by `set`.
+    pub fn remove(&mut self, set: usize, qt: QToken) -> Result<(), Fail> {
+        let qtset: &mut QTokenSet = match self.sets.get_mut(set) {
+            Some(qtset) => qtset,
+            None => return Err(Self::bad_set("remove", set)),
+        };
+        if !qtset.pending.remove(&qt) {
+            let cause: String = format!("queue token is not pending in set (qt={:?}, set={:?})", qt, set);
+            error!("remove(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        self.members.remove(&qt);
+        Ok(())
+    }
+
+    /// Notifies the table that the operation of `qt` has completed.
+    pub fn notify(&mut self, qt: QToken) {
+        if let Some(&set) = self.members.get(&qt) {
+            // The set must exist, as freeing a set drops all its members.
+            let qtset: &mut QTokenSet = &mut self.sets[set];
+            if qtset.pending.remove(&qt) {
+                qtset.ready.push_back(qt);
+            }
+        }
+    }
+
+    /// Takes the next ready queue token from the set identified by `set`. On success, returns the queue token, if any,
+    /// and whether the set still has pending queue tokens.
+    pub fn pop_ready(&mut self, set: usize) -> Result<(Option<QToken>, bool), Fail> {
+        match self.sets.get_mut(set) {
+            Some(qtset) => {
+                let qt: Option<QToken> = qtset.ready.pop_front();
+                if let Some(qt) = qt {
+                    self.members.remove(&qt);
+                }
+                Ok((qt, !qtset.pending.is_empty()))
+            },
+            None => Err(Self::bad_set("pop_ready", set)),
+        }
+    }
+
+    fn bad_set(fn_name: &str, set: usize) -> Fail {
+        let cause: String = format!("invalid queue token set (set={:?})", set);
+        error!("{}(): {}", fn_name, cause);
+        Fail::new(libc::EBADF, &cause)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::runtime::queue::{qtoken_set::QTokenSetTable, QToken};
+    use ::anyhow::Result;
+
+    // Tests that completed queue tokens show up in completion order, and only in their own set.
+    #[test]
+    fn notify_and_pop() -> Result<()> {
+        let mut table: QTokenSetTable = QTokenSetTable::default();
+        let set: usize = table.alloc();
+        let other: usize = table.alloc();
+        for i in 0..4 {
+            table.insert(set, QToken::from(i), false)?;
+        }
+        table.insert(other, QToken::from(4), false)?;
+        crate::ensure_eq!(table.insert(other, QToken::from(0), false).is_err(), true);
+
+        table.notify(QToken::from(2));
+        table.notify(QToken::from(4));
+        table.notify(QToken::from(1));
+        table.notify(QToken::from(100));
+        crate::ensure_eq!(table.pop_ready(set)?, (Some(QToken::from(2)), true));
+        crate::ensure_eq!(table.pop_ready(set)?, (Some(QToken::from(1)), true));
+        crate::ensure_eq!(table.pop_ready(set)?, (None, true));
+        crate::ensure_eq!(table.pop_ready(other)?, (Some(QToken::from(4)), false));
+
+        // Removed queue tokens no longer become ready.
+        table.remove(set, QToken::from(0))?;
+        table.remove(set, QToken::from(3))?;
+        table.notify(QToken::from(0));
+        crate::ensure_eq!(table.pop_ready(set)?, (None, false));
+
+        table.free(set)?;
+        crate::ensure_eq!(table.pop_ready(set).is_err(), true);
+
+        Ok(())
+    }
+
+    // Tests that a queue token that has already completed belongs to its set until a wait takes it.
+    #[test]
+    fn insert_completed() -> Result<()> {
+        let mut table: QTokenSetTable = QTokenSetTable::default();
+        let set: usize = table.alloc();
+        let other: usize = table.alloc();
+        table.insert(set, QToken::from(0), true)?;
+        crate::ensure_eq!(table.insert(other, QToken::from(0), false).is_err(), true);
+        crate::ensure_eq!(table.insert(set, QToken::from(0), true).is_err(), true);
+
+        // A late notification does not make the queue token ready twice.
+        table.notify(QToken::from(0));
+        crate::ensure_eq!(table.pop_ready(set)?, (Some(QToken::from(0)), false));
+        crate::ensure_eq!(table.pop_ready(set)?, (None, false));
+
+        // Once taken, the queue token may join another set.
+        table.insert(other, QToken::from(0), true)?;
+        crate::ensure_eq!(table.pop_ready(other)?, (Some(QToken::from(0)), false));
+
+        // Freeing a set releases its ready queue tokens too.
+        table.insert(set, QToken::from(1), true)?;
+        table.free(set)?;
+        table.insert(other, QToken::from(1), false)?;
+
+        Ok(())
+    }
+}
@@ -16,6 +16,7 @@ use crate::{
     expect_some,
     runtime::scheduler::{
         page::{WakerPageRef, WakerRef},
+        pool::TaskAllocator,
         scheduler::InternalId,
         waker64::{WAKER_BIT_LENGTH, WAKER_BIT_LENGTH_SHIFT},
         Task, TaskId,
@@ -39,7 +40,7 @@ use ::std::{
 pub struct TaskGroup {
     ids: IdMap<TaskId, InternalId>,
     /// Stores all the tasks that are held by the scheduler.
-    tasks: PinSlab<Box<dyn Task>>,
+    tasks: PinSlab<Box<dyn Task, TaskAllocator>>,
     /// Holds the waker bits for controlling task scheduling.
     waker_page_refs: Vec<WakerPageRef>,
 }
@@ -50,7 +51,7 @@ pub struct TaskGroup {
 
 impl TaskGroup {
     /// Given a handle to a task, remove it from the scheduler
-    pub fn remove(&mut self, task_id: TaskId) -> Option<Box<dyn Task>> {
+    pub fn remove(&mut self, task_id: TaskId) -> Option<Box<dyn Task, TaskAllocator>> {
         // We should not have a scheduler handle that refers to an invalid id, so unwrap and expect are safe here.
         let pin_slab_index: usize =
             expect_some!(self.ids.remove(&task_id), "Token should be in the token table").into();
@@ -77,7 +78,7 @@ impl TaskGroup {
     }
 
     /// Insert a new task into our scheduler returning a handle corresponding to it.
-    pub fn insert(&mut self, task: Box<dyn Task>) -> Option<TaskId> {
+    pub fn insert(&mut self, task: Box<dyn Task, TaskAllocator>) -> Option<TaskId> {
         let task_name: &'static str = task.get_name();
         // The pin slab index can be reverse-computed in a page index and an offset within the page.
         let pin_slab_index: usize = self.tasks.insert(task)?;
@@ -134,18 +135,22 @@ impl TaskGroup {
         (waker_page_index << WAKER_BIT_LENGTH_SHIFT) + waker_page_offset
     }
 
-    pub fn get_offsets_for_ready_tasks(&mut self) -> Vec<InternalId> {
-        let mut result: Vec<InternalId> = vec![];
+    /// Appends the tasks that have been notified to `ready_tasks`, which the caller reuses to avoid allocating.
+    pub fn get_offsets_for_ready_tasks(&mut self, ready_tasks: &mut Vec<InternalId>) {
         for i in 0..self.get_num_waker_pages() {
             // Grab notified bits.
             let notified: u64 = self.waker_page_refs[i].take_notified();
             // Turn into bit iter.
-            let mut offset: Vec<InternalId> = BitIter::from(notified)
-                .map(|x| Self::get_pin_slab_index(i, x).into())
-                .collect();
-            result.append(&mut offset);
+            ready_tasks.extend(BitIter::from(notified).map(|x| InternalId::from(Self::get_pin_slab_index(i, x))));
         }
-        result
+    }
+
+    /// Checks whether any task in the group has been notified since the last call to
+    /// [get_offsets_for_ready_tasks](Self::get_offsets_for_ready_tasks).
+    pub fn has_ready_tasks(&self) -> bool {
+        self.waker_page_refs
+            .iter()
+            .any(|waker_page_ref| waker_page_ref.has_notified())
     }
 
     /// Translates an internal task id to an external one. Expects the task to exist.
@@ -157,7 +162,7 @@ impl TaskGroup {
         expect_some!(self.ids.get(task_id), "Invalid id: {:?}", task_id)
     }
 
-    fn get_pinned_task_ptr(&mut self, pin_slab_index: usize) -> Pin<&mut Box<dyn Task>> {
+    fn get_pinned_task_ptr(&mut self, pin_slab_index: usize) -> Pin<&mut Box<dyn Task, TaskAllocator>> {
         // Get the pinned ref.
         expect_some!(
             self.tasks.get_pin_mut(pin_slab_index),
@@ -173,7 +178,10 @@ impl TaskGroup {
         Some(unsafe { Waker::from_raw(WakerRef::new(raw_waker).into()) })
     }
 
-    pub fn poll_notified_task_and_remove_if_ready(&mut self, internal_task_id: InternalId) -> Option<Box<dyn Task>> {
+    pub fn poll_notified_task_and_remove_if_ready(
+        &mut self,
+        internal_task_id: InternalId,
+    ) -> Option<Box<dyn Task, TaskAllocator>> {
         // Perform the actual work of running the task.
         let poll_result: Poll<()> = {
             let waker: Waker = self.get_waker(internal_task_id)?;
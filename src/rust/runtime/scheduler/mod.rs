@@ -32,6 +32,7 @@
 
 mod group;
 mod page;
+mod pool;
 pub mod scheduler;
 pub mod task;
 mod waker64;
@@ -41,6 +42,7 @@ mod waker64;
 //======================================================================================================================
 
 pub use self::{
+    pool::TaskAllocator,
     scheduler::SharedScheduler,
     task::{Task, TaskId, TaskWithResult},
 };
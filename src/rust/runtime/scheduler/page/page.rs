@@ -53,6 +53,11 @@ impl WakerPage {
         self.notified.swap(0)
     }
 
+    /// Checks whether any future in the target [WakerPage] has been notified, without resetting the flags.
+    pub fn has_notified(&self) -> bool {
+        self.notified.load() != 0
+    }
+
     /// Resets all flags in the target [WakerPage].
     /// The reference count for the target page is reset to one.
     pub fn reset(&mut self) {
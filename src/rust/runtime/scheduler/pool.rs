@@ -0,0 +1,230 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Size-classed pool of memory slots for tasks and their coroutines.
+//!
+//! Every I/O operation allocates a task and its coroutine, and frees them once the application takes the result, so
+//! the scheduler would otherwise hit the global allocator at least twice per operation. Instead, tasks and coroutines
+//! are boxed with the [TaskAllocator], which keeps the slots that they free in a per-thread free list for each size
+//! class and hands them out again. Once the pool has warmed up, inserting and completing coroutines of the common
+//! sizes does not allocate from the heap at all. The scheduler is single-threaded and tasks never cross threads, so
+//! slots always go back to the pool of the thread that allocated them.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::{
+    alloc::{AllocError, Allocator, Global, Layout},
+    cell::RefCell,
+    ptr::NonNull,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Size of the slots of the smallest size class, as a power of two. Each class doubles the size of the previous one.
+const MIN_SLOT_SIZE_SHIFT: u32 = 6;
+/// Number of size classes, so the largest slots are 8 KB. Anything larger goes straight to the global allocator.
+const NUM_SIZE_CLASSES: usize = 8;
+/// Alignment of all slots, which is that of a cache line so that no two tasks share one.
+const SLOT_ALIGNMENT: usize = 64;
+/// Largest number of free slots that we keep for each size class. Slots freed beyond this after a burst of tasks go
+/// back to the global allocator.
+const MAX_FREE_SLOTS: usize = 1024;
+
+//======================================================================================================================
+// Thread local variable
+//======================================================================================================================
+
+thread_local! {
+/// The pool of the scheduler that runs on this thread.
+static TASK_POOL: RefCell<TaskPool> = RefCell::new(TaskPool::default());
+}
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Allocator for tasks and coroutines that recycles their memory through the [TaskPool] of the current thread.
+#[derive(Clone, Copy, Default, Debug)]
+pub struct TaskAllocator;
+
+/// Header that we write into a free slot to link it to the next one.
+struct FreeSlot {
+    next: Option<NonNull<FreeSlot>>,
+}
+
+/// Free lists of a size class.
+#[derive(Default)]
+struct SizeClass {
+    /// First slot of the free list.
+    head: Option<NonNull<FreeSlot>>,
+    /// Number of slots in the free list.
+    len: usize,
+}
+
+#[derive(Default)]
+struct TaskPool {
+    classes: [SizeClass; NUM_SIZE_CLASSES],
+    /// Number of slots that we had to take from the global allocator, for benchmarks and tests.
+    num_heap_allocations: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl TaskAllocator {
+    /// Returns how many slots the pool of this thread has taken from the global allocator so far. This stays put
+    /// while the scheduler runs in steady state.
+    pub fn num_heap_allocations() -> usize {
+        TASK_POOL.with(|pool| pool.borrow().num_heap_allocations)
+    }
+
+    /// Returns the size class that serves `layout`, if any.
+    fn size_class(layout: Layout) -> Option<usize> {
+        if layout.align() > SLOT_ALIGNMENT {
+            return None;
+        }
+        let size: usize = layout.size().max(1 << MIN_SLOT_SIZE_SHIFT).next_power_of_two();
+        let class: usize = (size.trailing_zeros() - MIN_SLOT_SIZE_SHIFT) as usize;
+        if class < NUM_SIZE_CLASSES {
+            Some(class)
+        } else {
+            None
+        }
+    }
+
+    /// Returns the layout of the slots of a size class.
+    fn slot_layout(class: usize) -> Layout {
+        // This cannot fail, because slot sizes are powers of two that are a multiple of the alignment.
+        unsafe { Layout::from_size_align_unchecked(1 << (class as u32 + MIN_SLOT_SIZE_SHIFT), SLOT_ALIGNMENT) }
+    }
+}
+
+impl TaskPool {
+    /// Takes a slot of a size class, from the free list if possible.
+    fn allocate(&mut self, class: usize) -> Result<NonNull<u8>, AllocError> {
+        let size_class: &mut SizeClass = &mut self.classes[class];
+        match size_class.head {
+            Some(slot) => {
+                // Safety: slots in the free list are unused and start with a header that we wrote.
+                size_class.head = unsafe { slot.as_ref().next };
+                size_class.len -= 1;
+                Ok(slot.cast())
+            },
+            None => {
+                self.num_heap_allocations += 1;
+                Ok(Global.allocate(TaskAllocator::slot_layout(class))?.cast())
+            },
+        }
+    }
+
+    /// Gives back a slot of a size class.
+    ///
+    /// # Safety
+    ///
+    /// The slot must have been allocated for this size class and must no longer be used.
+    unsafe fn deallocate(&mut self, ptr: NonNull<u8>, class: usize) {
+        let size_class: &mut SizeClass = &mut self.classes[class];
+        if size_class.len == MAX_FREE_SLOTS {
+            Global.deallocate(ptr, TaskAllocator::slot_layout(class));
+            return;
+        }
+        let slot: NonNull<FreeSlot> = ptr.cast();
+        slot.as_ptr().write(FreeSlot { next: size_class.head });
+        size_class.head = Some(slot);
+        size_class.len += 1;
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+unsafe impl Allocator for TaskAllocator {
+    fn allocate(&self, layout: Layout) -> Result<NonNull<[u8]>, AllocError> {
+        match Self::size_class(layout) {
+            Some(class) => {
+                let ptr: NonNull<u8> = TASK_POOL.with(|pool| pool.borrow_mut().allocate(class))?;
+                Ok(NonNull::slice_from_raw_parts(ptr, layout.size()))
+            },
+            None => Global.allocate(layout),
+        }
+    }
+
+    unsafe fn deallocate(&self, ptr: NonNull<u8>, layout: Layout) {
+        match Self::size_class(layout) {
+            // Tasks that the thread still holds when it exits are dropped after its pool, so they bypass it.
+            Some(class) => {
+                if TASK_POOL
+                    .try_with(|pool| pool.borrow_mut().deallocate(ptr, class))
+                    .is_err()
+                {
+                    Global.deallocate(ptr, Self::slot_layout(class));
+                }
+            },
+            None => Global.deallocate(ptr, layout),
+        }
+    }
+}
+
+impl Drop for TaskPool {
+    fn drop(&mut self) {
+        for class in 0..NUM_SIZE_CLASSES {
+            let mut next: Option<NonNull<FreeSlot>> = self.classes[class].head.take();
+            while let Some(slot) = next {
+                // Safety: slots in the free list are unused and start with a header that we wrote.
+                unsafe {
+                    next = slot.as_ref().next;
+                    Global.deallocate(slot.cast(), TaskAllocator::slot_layout(class));
+                }
+            }
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::runtime::scheduler::pool::{TaskAllocator, NUM_SIZE_CLASSES};
+    use ::anyhow::Result;
+    use ::std::alloc::Layout;
+
+    // Tests that layouts map to the smallest size class that fits them.
+    #[test]
+    fn test_size_classes() -> Result<()> {
+        crate::ensure_eq!(TaskAllocator::size_class(Layout::new::<u8>()), Some(0));
+        crate::ensure_eq!(TaskAllocator::size_class(Layout::new::<[u8; 64]>()), Some(0));
+        crate::ensure_eq!(TaskAllocator::size_class(Layout::new::<[u8; 65]>()), Some(1));
+        crate::ensure_eq!(
+            TaskAllocator::size_class(Layout::new::<[u8; 8192]>()),
+            Some(NUM_SIZE_CLASSES - 1)
+        );
+        crate::ensure_eq!(TaskAllocator::size_class(Layout::new::<[u8; 8193]>()), None);
+        crate::ensure_eq!(TaskAllocator::size_class(Layout::from_size_align(64, 128)?), None);
+        Ok(())
+    }
+
+    // Tests that freed slots get reused instead of allocating new ones.
+    #[test]
+    fn test_slots_are_recycled() -> Result<()> {
+        let first: Box<[u8; 200], TaskAllocator> = Box::new_in([1; 200], TaskAllocator);
+        let first_addr: usize = first.as_ptr().addr();
+        drop(first);
+
+        let num_heap_allocations: usize = TaskAllocator::num_heap_allocations();
+        for _ in 0..16 {
+            let slot: Box<[u8; 200], TaskAllocator> = Box::new_in([2; 200], TaskAllocator);
+            crate::ensure_eq!(slot.as_ptr().addr(), first_addr);
+        }
+        crate::ensure_eq!(TaskAllocator::num_heap_allocations(), num_heap_allocations);
+
+        Ok(())
+    }
+}
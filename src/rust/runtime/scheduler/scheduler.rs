@@ -14,8 +14,9 @@
 use crate::{
     collections::id_map::IdMap,
     expect_some,
+    perftools::stats,
     runtime::{
-        scheduler::{group::TaskGroup, Task, TaskId},
+        scheduler::{group::TaskGroup, pool::TaskAllocator, Task, TaskId},
         SharedObject,
     },
 };
@@ -101,7 +102,7 @@ impl Scheduler {
     /// The parent id can either be the id of the group or another task in the same group.
     pub fn insert_task<T: Task>(&mut self, task: T) -> Option<TaskId> {
         let group: &mut TaskGroup = self.groups.get_mut(self.current_group_id.into())?;
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
+        let new_task_id: TaskId = group.insert(Box::new_in(task, TaskAllocator))?;
         // Add a mapping so we can use this new task id to find the task in the future.
         if let Some(existing) = self.ids.insert(new_task_id, self.current_group_id) {
             panic!("should not exist an id: {:?}", existing);
@@ -113,20 +114,20 @@ impl Scheduler {
     pub fn insert_task_with_group_id<T: Task>(&mut self, group_id: TaskId, task: T) -> Option<TaskId> {
         let group_id: InternalId = self.ids.get(&group_id)?;
         let group: &mut TaskGroup = self.groups.get_mut(group_id.into())?;
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
+        let new_task_id: TaskId = group.insert(Box::new_in(task, TaskAllocator))?;
         // Add a mapping so we can use this new task id to find the task in the future.
         self.ids.insert(new_task_id, group_id);
         Some(new_task_id)
     }
 
-    pub fn remove_task(&mut self, task_id: TaskId) -> Option<Box<dyn Task>> {
+    pub fn remove_task(&mut self, task_id: TaskId) -> Option<Box<dyn Task, TaskAllocator>> {
         let group: &mut TaskGroup = self.get_mut_group(&task_id)?;
-        let task: Box<dyn Task> = group.remove(task_id)?;
+        let task: Box<dyn Task, TaskAllocator> = group.remove(task_id)?;
         self.ids.remove(&task_id)?;
         Some(task)
     }
 
-    fn poll_notified_task_and_remove_if_ready(&mut self) -> Option<Box<dyn Task>> {
+    fn poll_notified_task_and_remove_if_ready(&mut self) -> Option<Box<dyn Task, TaskAllocator>> {
         let group: &mut TaskGroup = expect_some!(
             self.groups.get_mut(self.current_group_id.into()),
             "task group should exist: "
@@ -134,7 +135,8 @@ impl Scheduler {
         assert!(self.current_running_task.is_none());
         *self.current_running_task = Some(group.unchecked_internal_to_external_id(self.current_task_id));
         assert!(self.current_running_task.is_some());
-        let result: Option<Box<dyn Task>> = group.poll_notified_task_and_remove_if_ready(self.current_task_id);
+        let result: Option<Box<dyn Task, TaskAllocator>> =
+            group.poll_notified_task_and_remove_if_ready(self.current_task_id);
         assert!(self.current_running_task.is_some());
         // Expect is safe here because we just looked up the external id.
         let task_id: TaskId = self
@@ -152,9 +154,10 @@ impl Scheduler {
 
     /// Poll all tasks which are ready to run for [max_iterations]. This does the same thing as get_next_completed task
     /// but does not stop until it has reached [max_iterations] and collects all of the
-    pub fn poll_all(&mut self) -> Vec<Box<dyn Task>> {
-        let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
+    pub fn poll_all(&mut self) -> Vec<Box<dyn Task, TaskAllocator>> {
+        let mut completed_tasks: Vec<Box<dyn Task, TaskAllocator>> = vec![];
         let start_group = self.current_group_id;
+        let mut num_polled: usize = 0;
         loop {
             self.current_task_id = {
                 match self.current_ready_tasks.pop() {
@@ -166,24 +169,26 @@ impl Scheduler {
                         }
                         match self.current_ready_tasks.pop() {
                             Some(index) => index,
-                            None => return completed_tasks,
+                            None => break,
                         }
                     },
                 }
             };
 
             // Now that we have a runnable task, actually poll it.
+            num_polled += 1;
             if let Some(task) = self.poll_notified_task_and_remove_if_ready() {
                 completed_tasks.push(task);
             }
         }
+        stats::record_poll(num_polled);
         completed_tasks
     }
 
     /// Poll all tasks until one completes. Remove that task and return it or fail after polling [max_iteration] number
     /// of tasks.
-    pub fn get_next_completed_task(&mut self, max_iterations: usize) -> Option<Box<dyn Task>> {
-        for _ in 0..max_iterations {
+    pub fn get_next_completed_task(&mut self, max_iterations: usize) -> Option<Box<dyn Task, TaskAllocator>> {
+        for num_polled in 0..max_iterations {
             self.current_task_id = {
                 match self.current_ready_tasks.pop() {
                     Some(index) => index,
@@ -191,7 +196,10 @@ impl Scheduler {
                         self.next_runnable_group();
                         match self.current_ready_tasks.pop() {
                             Some(index) => index,
-                            None => return None,
+                            None => {
+                                stats::record_poll(num_polled);
+                                return None;
+                            },
                         }
                     },
                 }
@@ -199,9 +207,11 @@ impl Scheduler {
 
             // Now that we have a runnable task, actually poll it.
             if let Some(task) = self.poll_notified_task_and_remove_if_ready() {
+                stats::record_poll(num_polled + 1);
                 return Some(task);
             }
         }
+        stats::record_poll(max_iterations);
         None
     }
 
@@ -212,7 +222,7 @@ impl Scheduler {
         self.current_group_id = self.get_next_group_index();
 
         loop {
-            self.current_ready_tasks = self.groups[self.current_group_id.into()].get_offsets_for_ready_tasks();
+            self.groups[self.current_group_id.into()].get_offsets_for_ready_tasks(&mut self.current_ready_tasks);
             if !self.current_ready_tasks.is_empty() {
                 return;
             }
@@ -240,6 +250,11 @@ impl Scheduler {
         }
     }
 
+    /// Checks whether any task other than the one that is running is ready to run.
+    pub fn has_ready_tasks(&self) -> bool {
+        !self.current_ready_tasks.is_empty() || self.groups.iter().any(|(_, group)| group.has_ready_tasks())
+    }
+
     /// Returns the current running task id if we are in the scheduler, otherwise None.
     pub fn get_task_id(&self) -> Option<TaskId> {
         *self.current_running_task.clone()
@@ -341,6 +356,7 @@ mod tests {
         runtime::scheduler::{
             scheduler::{Scheduler, TaskId},
             task::TaskWithResult,
+            TaskAllocator,
         },
     };
     use ::anyhow::Result;
@@ -390,13 +406,13 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         // Insert a task and make sure the task id is not a simple counter.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
 
         // Insert another task and make sure the task id is not sequentially after the previous one.
-        let task2: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task2: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id2) = scheduler.insert_task(task2) else {
             anyhow::bail!("insert() failed")
         };
@@ -411,7 +427,7 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         // Insert a single future in the scheduler. This future shall complete with a single poll operation.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
@@ -431,7 +447,7 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         // Insert a single future in the scheduler. This future shall complete with a single poll operation.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
@@ -452,7 +468,7 @@ mod tests {
 
         // Insert a single future in the scheduler. This future shall complete
         // with two poll operations.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(1).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(1).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
@@ -478,7 +494,7 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         // Insert a single future in the scheduler. This future shall complete with a single poll operation.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
@@ -499,7 +515,7 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         // Create and run a task.
-        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id) = scheduler.insert_task(task) else {
             anyhow::bail!("insert() failed")
         };
@@ -511,7 +527,7 @@ mod tests {
         }
 
         // Create another task.
-        let task2: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let task2: DummyTask = DummyTask::new("testing", DummyCoroutine::new(0).fuse());
         let Some(task_id2) = scheduler.insert_task(task2) else {
             anyhow::bail!("insert() failed")
         };
@@ -533,7 +549,7 @@ mod tests {
         crate::ensure_eq!(scheduler.num_tasks(), 0);
 
         for val in 0..NUM_TASKS {
-            let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(val).fuse()));
+            let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(val).fuse());
             let Some(task_id) = scheduler.insert_task(task) else {
                 panic!("insert() failed");
             };
@@ -563,12 +579,29 @@ mod tests {
         let mut scheduler: Scheduler = Scheduler::default();
 
         b.iter(|| {
-            let task: DummyTask = DummyTask::new("testing", Box::pin(black_box(DummyCoroutine::default().fuse())));
+            let task: DummyTask = DummyTask::new("testing", black_box(DummyCoroutine::default().fuse()));
             let task_id: TaskId = expect_some!(scheduler.insert_task(task), "couldn't insert future in scheduler");
             black_box(task_id);
         });
     }
 
+    #[bench]
+    fn benchmark_insert_and_complete(b: &mut Bencher) {
+        let mut scheduler: Scheduler = Scheduler::default();
+        let mut run_task = || {
+            let task: DummyTask = DummyTask::new("testing", black_box(DummyCoroutine::default().fuse()));
+            let task_id: TaskId = expect_some!(scheduler.insert_task(task), "couldn't insert future in scheduler");
+            let task = expect_some!(scheduler.get_next_completed_task(1), "task should have completed");
+            assert_eq!(task.get_id(), task_id);
+        };
+
+        // Once the task pool has free slots, running tasks to completion should not allocate them from the heap.
+        run_task();
+        let num_heap_allocations: usize = TaskAllocator::num_heap_allocations();
+        b.iter(&mut run_task);
+        assert_eq!(TaskAllocator::num_heap_allocations(), num_heap_allocations);
+    }
+
     #[bench]
     fn benchmark_poll(b: &mut Bencher) {
         let mut scheduler: Scheduler = Scheduler::default();
@@ -576,7 +609,7 @@ mod tests {
         let mut task_ids: Vec<TaskId> = Vec::<TaskId>::with_capacity(NUM_TASKS);
 
         for val in 0..NUM_TASKS {
-            let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(val).fuse()));
+            let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(val).fuse());
             let Some(task_id) = scheduler.insert_task(task) else {
                 panic!("insert() failed");
             };
@@ -595,7 +628,7 @@ mod tests {
         let mut task_ids: Vec<TaskId> = Vec::<TaskId>::with_capacity(NUM_TASKS);
 
         for val in 0..NUM_TASKS {
-            let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(val).fuse()));
+            let task: DummyTask = DummyTask::new("testing", DummyCoroutine::new(val).fuse());
             let Some(task_id) = scheduler.insert_task(task) else {
                 panic!("insert() failed");
             };
@@ -1,7 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-use crate::expect_some;
+use crate::{expect_some, runtime::scheduler::pool::TaskAllocator};
 /// A Task is the abstraction that represents processes in Demikernel. Each Task runs a single async function, which
 /// represents a coroutine, until it completes. The Task then stores the result until get_result is called.
 ///
@@ -48,7 +48,7 @@ pub struct TaskId(pub u64);
 /// never directly returns anything.
 pub trait Task: FusedFuture<Output = ()> + Unpin + Any {
     fn get_name(&self) -> &'static str;
-    fn as_any(self: Box<Self>) -> Box<dyn Any>;
+    fn as_any_mut(&mut self) -> &mut dyn Any;
     fn get_id(&self) -> TaskId;
     fn set_id(&mut self, id: TaskId);
 }
@@ -74,11 +74,12 @@ pub struct TaskWithResult<R: Unpin + Clone + Any> {
 //======================================================================================================================
 
 impl<R: Unpin + Clone + Any> TaskWithResult<R> {
-    pub fn new(name: &'static str, coroutine: Pin<<Self as TaskWith>::Coroutine>) -> Self {
+    /// Creates a task that runs `coroutine`, which is moved into a slot of the [TaskAllocator].
+    pub fn new<F: FusedFuture<Output = R> + 'static>(name: &'static str, coroutine: F) -> Self {
         Self {
             name,
             task_id: None,
-            coroutine,
+            coroutine: Box::pin_in(coroutine, TaskAllocator),
             result: None,
         }
     }
@@ -107,7 +108,7 @@ impl From<TaskId> for u64 {
 
 /// Define the Coroutine type and returned ResultType.
 impl<R: Unpin + Clone + Any> TaskWith for TaskWithResult<R> {
-    type Coroutine = Box<dyn FusedFuture<Output = R>>;
+    type Coroutine = Box<dyn FusedFuture<Output = R>, TaskAllocator>;
     type ResultType = R;
 }
 
@@ -128,7 +129,7 @@ impl<R: Unpin + Clone + Any> Task for TaskWithResult<R> {
         self.name
     }
 
-    fn as_any(self: Box<Self>) -> Box<dyn Any> {
+    fn as_any_mut(&mut self) -> &mut dyn Any {
         self
     }
 
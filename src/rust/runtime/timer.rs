@@ -7,17 +7,31 @@
 //======================================================================================================================
 // Imports
 //======================================================================================================================
-use crate::{expect_some, runtime::SharedObject};
-use ::core::cmp::Reverse;
+use crate::{perftools::stats, runtime::SharedObject};
 use ::std::{
-    collections::BinaryHeap,
     future::Future,
+    mem,
     ops::{Deref, DerefMut},
     pin::Pin,
     task::{Context, Poll, Waker},
     time::{Duration, Instant},
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Granularity of the timer wheel. Timers still fire at their exact expiry, this only determines how they are bucketed.
+const TICK_NANOS: u128 = 1_000_000;
+/// Number of slots in each level of the timer wheel, as a power of two.
+const SLOT_BITS: u32 = 6;
+const NUM_SLOTS: usize = 1 << SLOT_BITS;
+const SLOT_MASK: u64 = NUM_SLOTS as u64 - 1;
+/// Number of levels of the timer wheel. Level `l` has slots that are `NUM_SLOTS^l` ticks wide, so with 1 ms ticks the
+/// wheel spans about two years. Timers that expire later than that are kept at the last level until they get closer.
+const NUM_LEVELS: usize = 6;
+const MAX_TICKS: u64 = 1 << (SLOT_BITS * NUM_LEVELS as u32);
+
 //======================================================================================================================
 // Thread local variable
 //======================================================================================================================
@@ -38,8 +52,12 @@ enum YieldState {
     Yielded(YieldPointId),
 }
 
+/// Identifies a timer by its index in the timer table and the generation of that entry when the timer was armed.
 #[derive(Eq, PartialEq, Clone, Copy)]
-struct YieldPointId(u64);
+struct YieldPointId {
+    index: u32,
+    generation: u32,
+}
 
 struct YieldPoint {
     /// The time out.
@@ -48,19 +66,40 @@ struct YieldPoint {
     state: YieldState,
 }
 
-struct TimerQueueEntry {
-    expiry: Instant,
-    id: YieldPointId,
-    waker: Waker,
+/// An entry of the timer table. Its generation changes whenever the timer that it holds fires or is cancelled, so that
+/// references to the timer that are left in the wheel can be told apart from those to the next timer in the entry.
+struct TimerEntry {
+    generation: u32,
+    timer: Option<(Instant, Waker)>,
 }
 
-/// Timer that holds one or more events for future wake up.
+/// One level of the timer wheel.
+struct TimerLevel {
+    /// Timers of each slot. These may include stale references to timers that have been cancelled.
+    slots: [Vec<YieldPointId>; NUM_SLOTS],
+    /// Bitmap of the slots that hold references.
+    occupied: u64,
+}
+
+/// Timer that holds one or more events for future wake up. This is a hashed hierarchical timer wheel: arming a timer
+/// puts it in the slot of the level whose span covers its expiry, and time moving forward cascades the timers of a
+/// slot of a higher level down to the lower levels until they fire from level zero. Arming, cancelling and firing a
+/// timer are O(1). Cancelling a timer only frees its entry in the timer table and leaves its reference in the wheel to be
+/// skipped when its slot comes up.
 pub struct Timer {
     now: Instant,
-    // Use a reverse to get a min heap.
-    heap: BinaryHeap<Reverse<TimerQueueEntry>>,
-    // Monotonically increasing identifier for yield points.
-    last_id: YieldPointId,
+    /// Start of tick zero.
+    origin: Instant,
+    /// Number of ticks that the wheel has advanced to.
+    elapsed: u64,
+    levels: [TimerLevel; NUM_LEVELS],
+    /// Table of timers, along with a list of its free entries.
+    entries: Vec<TimerEntry>,
+    free_entries: Vec<u32>,
+    /// Number of armed timers.
+    num_timers: usize,
+    /// Wakers of the timers that fire on an advance of the clock, which we wake once we are done with the wheel.
+    expired: Vec<Waker>,
 }
 
 #[derive(Clone)]
@@ -70,32 +109,85 @@ pub struct SharedTimer(SharedObject<Timer>);
 // Associated Functions
 //======================================================================================================================
 
-impl YieldPointId {
-    pub fn increment(&mut self) {
-        self.0 = self.0 + 1;
-    }
-}
-
 impl SharedTimer {
     /// This sets the time but is only used for initialization.
     fn set_time(&mut self, now: Instant) {
         // Clear out existing timers because they are meaningless once time has been moved in a non-monotonically
         // increasing manner.
-        self.heap.clear();
+        for index in 0..self.entries.len() {
+            if self.entries[index].timer.is_some() {
+                self.release_entry(index as u32);
+            }
+        }
+        for level in self.levels.iter_mut() {
+            level.clear();
+        }
         self.now = now;
+        self.origin = now;
+        self.elapsed = 0;
     }
 
     fn advance_clock(&mut self, now: Instant) {
         assert!(self.now <= now);
-        while let Some(Reverse(entry)) = self.heap.peek() {
-            if now < entry.expiry {
+        self.now = now;
+        let target: u64 = self.tick_of(now);
+
+        if self.num_timers == 0 {
+            // Only stale references can be left in the wheel, so we can drop them and skip straight to the target.
+            for level in self.levels.iter_mut().filter(|level| level.occupied != 0) {
+                level.clear();
+            }
+            self.elapsed = target;
+            return;
+        }
+
+        // Timers in the slot of the target tick may not have expired yet, so we put them back once we are done.
+        let mut not_expired: Vec<YieldPointId> = Vec::new();
+        while let Some((level, slot, deadline)) = self.next_expiration() {
+            if deadline > target {
                 break;
             }
-            let entry: TimerQueueEntry =
-                expect_some!(self.heap.pop(), "should have an entry because we were able to peek").0;
-            entry.waker.wake_by_ref();
+            self.elapsed = deadline;
+            let mut ids: Vec<YieldPointId> = self.levels[level].take_slot(slot);
+            for id in ids.drain(..) {
+                let expiry: Instant = match self.entries[id.index as usize] {
+                    TimerEntry {
+                        generation,
+                        timer: Some((expiry, _)),
+                    } if generation == id.generation => expiry,
+                    // The timer was cancelled.
+                    _ => continue,
+                };
+                if expiry <= now {
+                    let waker: Waker = self.release_entry(id.index);
+                    self.expired.push(waker);
+                } else if level == 0 {
+                    not_expired.push(id);
+                } else {
+                    self.insert(id, expiry);
+                }
+            }
+            // Nothing goes back into the slot while we process it, so we can give it its buffer back.
+            self.levels[level].slots[slot] = ids;
         }
-        self.now = now;
+        self.elapsed = target;
+        for id in not_expired {
+            let expiry: Instant = match self.entries[id.index as usize].timer {
+                Some((expiry, _)) => expiry,
+                None => unreachable!("timer should still be armed"),
+            };
+            self.insert(id, expiry);
+        }
+
+        // Wake the coroutines without holding on to the wheel, as they may arm new timers.
+        if !self.expired.is_empty() {
+            stats::record_timer_fires(self.expired.len());
+        }
+        let mut expired: Vec<Waker> = mem::take(&mut self.expired);
+        for waker in expired.drain(..) {
+            waker.wake();
+        }
+        self.expired = expired;
     }
 
     fn now(&self) -> Instant {
@@ -103,16 +195,119 @@ impl SharedTimer {
     }
 
     fn add_timeout(&mut self, expiry: Instant, waker: Waker) -> YieldPointId {
-        let id = self.last_id;
-        self.last_id.increment();
-
-        let entry: TimerQueueEntry = TimerQueueEntry { expiry, id, waker };
-        self.heap.push(Reverse(entry));
+        let index: u32 = match self.free_entries.pop() {
+            Some(index) => index,
+            None => {
+                self.entries.push(TimerEntry {
+                    generation: 0,
+                    timer: None,
+                });
+                (self.entries.len() - 1) as u32
+            },
+        };
+        let entry: &mut TimerEntry = &mut self.entries[index as usize];
+        entry.timer = Some((expiry, waker));
+        let id: YieldPointId = YieldPointId {
+            index,
+            generation: entry.generation,
+        };
+        self.num_timers += 1;
+        self.insert(id, expiry);
+        stats::record_timer_arm();
         id
     }
 
     fn remove_timeout(&mut self, id: YieldPointId) {
-        self.heap.retain(|entry| entry.0.id != id);
+        // The timer may have fired or been cleared already, in which case the entry is gone or holds another timer.
+        match self.entries.get(id.index as usize) {
+            Some(entry) if entry.generation == id.generation && entry.timer.is_some() => {
+                self.release_entry(id.index);
+                stats::record_timer_cancel();
+            },
+            _ => (),
+        }
+    }
+
+    /// Puts a reference to a timer in the slot that covers its expiry.
+    fn insert(&mut self, id: YieldPointId, expiry: Instant) {
+        let deadline: u64 = self.tick_of(expiry).max(self.elapsed);
+        // The level is given by the most significant bit in which the deadline differs from the current tick.
+        let masked: u64 = ((self.elapsed ^ deadline) | SLOT_MASK).min(MAX_TICKS - 1);
+        let level: usize = ((u64::BITS - 1 - masked.leading_zeros()) / SLOT_BITS) as usize;
+        let deadline: u64 = deadline.min(self.elapsed + MAX_TICKS - 1);
+        let slot: usize = ((deadline >> (level as u32 * SLOT_BITS)) & SLOT_MASK) as usize;
+        self.levels[level].slots[slot].push(id);
+        self.levels[level].occupied |= 1 << slot;
+    }
+
+    /// Finds the next slot of the wheel that holds references, and returns its level, index and the tick at which it
+    /// starts. Slots of lower levels always come before those of higher levels, so the first level that has an
+    /// occupied slot has the next one.
+    fn next_expiration(&self) -> Option<(usize, usize, u64)> {
+        for (level, timer_level) in self.levels.iter().enumerate() {
+            if timer_level.occupied == 0 {
+                continue;
+            }
+            let shift: u32 = level as u32 * SLOT_BITS;
+            let level_range: u64 = 1 << (shift + SLOT_BITS);
+            let position: u32 = ((self.elapsed >> shift) & SLOT_MASK) as u32;
+            let slot: u32 =
+                (position + timer_level.occupied.rotate_right(position).trailing_zeros()) % NUM_SLOTS as u32;
+            let level_start: u64 = self.elapsed & !(level_range - 1);
+            let mut deadline: u64 = level_start + ((slot as u64) << shift);
+            // Only timers of the last level may wrap around into the next turn of the wheel.
+            if slot < position {
+                deadline += level_range;
+            }
+            return Some((level, slot as usize, deadline));
+        }
+        None
+    }
+
+    /// Gets a time that is no later than the expiry of the next timer, if any timer is armed. This is the start of the
+    /// next occupied slot, so it may be up to a slot width early, or earlier yet if that slot only holds references to
+    /// cancelled timers.
+    fn next_deadline(&self) -> Option<Instant> {
+        if self.num_timers == 0 {
+            return None;
+        }
+        let (_, _, deadline): (usize, usize, u64) = self.next_expiration()?;
+        Some(self.origin + Duration::from_nanos(deadline * TICK_NANOS as u64))
+    }
+
+    /// Frees the entry of a timer and returns its waker.
+    fn release_entry(&mut self, index: u32) -> Waker {
+        let entry: &mut TimerEntry = &mut self.entries[index as usize];
+        entry.generation = entry.generation.wrapping_add(1);
+        let waker: Waker = match entry.timer.take() {
+            Some((_, waker)) => waker,
+            None => unreachable!("released a timer entry that is not armed"),
+        };
+        self.free_entries.push(index);
+        self.num_timers -= 1;
+        waker
+    }
+
+    /// Gets the tick that `instant` falls in.
+    fn tick_of(&self, instant: Instant) -> u64 {
+        let ticks: u128 = instant.saturating_duration_since(self.origin).as_nanos() / TICK_NANOS;
+        ticks.min(u64::MAX as u128) as u64
+    }
+}
+
+impl TimerLevel {
+    /// Takes the references of a slot.
+    fn take_slot(&mut self, slot: usize) -> Vec<YieldPointId> {
+        self.occupied &= !(1 << slot);
+        mem::take(&mut self.slots[slot])
+    }
+
+    /// Drops all references of this level.
+    fn clear(&mut self) {
+        for slot in self.slots.iter_mut() {
+            slot.clear();
+        }
+        self.occupied = 0;
     }
 }
 
@@ -139,6 +334,11 @@ pub fn global_get_time() -> Instant {
     THREAD_TIME.with(|s| s.now())
 }
 
+/// Gets a time that is no later than the expiry of the next timer in the Demikernel system, if any timer is armed.
+pub fn global_next_deadline() -> Option<Instant> {
+    THREAD_TIME.with(|s| s.next_deadline())
+}
+
 /// Blocks until the system time moves
 pub async fn wait(timeout: Duration) {
     let now: Instant = global_get_time();
@@ -159,14 +359,29 @@ pub async fn wait_until(expiry: Instant) {
 
 impl Default for SharedTimer {
     fn default() -> Self {
+        let now: Instant = Instant::now();
         Self(SharedObject::<Timer>::new(Timer {
-            now: Instant::now(),
-            heap: BinaryHeap::new(),
-            last_id: YieldPointId(0),
+            now,
+            origin: now,
+            elapsed: 0,
+            levels: ::std::array::from_fn(|_| TimerLevel::default()),
+            entries: Vec::new(),
+            free_entries: Vec::new(),
+            num_timers: 0,
+            expired: Vec::new(),
         }))
     }
 }
 
+impl Default for TimerLevel {
+    fn default() -> Self {
+        Self {
+            slots: ::std::array::from_fn(|_| Vec::new()),
+            occupied: 0,
+        }
+    }
+}
+
 impl Deref for SharedTimer {
     type Target = Timer;
 
@@ -181,29 +396,6 @@ impl DerefMut for SharedTimer {
     }
 }
 
-impl PartialEq for TimerQueueEntry {
-    fn eq(&self, other: &TimerQueueEntry) -> bool {
-        // This is technically not correct. However for the usage in this module
-        // we only need to compare timers by expiration.
-        self.expiry == other.expiry
-    }
-}
-
-impl Eq for TimerQueueEntry {}
-
-impl PartialOrd for TimerQueueEntry {
-    fn partial_cmp(&self, other: &TimerQueueEntry) -> Option<core::cmp::Ordering> {
-        // Compare timer queue entries by expiration time
-        self.expiry.partial_cmp(&other.expiry)
-    }
-}
-
-impl Ord for TimerQueueEntry {
-    fn cmp(&self, other: &TimerQueueEntry) -> core::cmp::Ordering {
-        self.expiry.cmp(&other.expiry)
-    }
-}
-
 impl Future for YieldPoint {
     type Output = ();
 
@@ -247,16 +439,36 @@ impl Drop for YieldPoint {
 
 #[cfg(test)]
 mod tests {
-    use crate::runtime::timer::{global_advance_clock, wait};
+    use crate::runtime::timer::{global_advance_clock, wait, SharedTimer, YieldPointId};
     use ::anyhow::Result;
     use futures::task::noop_waker_ref;
     use std::{
         future::Future,
         pin::Pin,
-        task::Context,
+        sync::{
+            atomic::{AtomicBool, Ordering},
+            Arc,
+        },
+        task::{Context, Wake, Waker},
         time::{Duration, Instant},
     };
 
+    /// A waker that remembers whether it was woken.
+    #[derive(Default)]
+    struct TestWaker(AtomicBool);
+
+    impl Wake for TestWaker {
+        fn wake(self: Arc<Self>) {
+            self.0.store(true, Ordering::Relaxed);
+        }
+    }
+
+    impl TestWaker {
+        fn was_woken(&self) -> bool {
+            self.0.load(Ordering::Relaxed)
+        }
+    }
+
     #[test]
     fn test_timer() -> Result<()> {
         let mut ctx = Context::from_waker(noop_waker_ref());
@@ -315,4 +527,107 @@ mod tests {
 
         Ok(())
     }
+
+    // Tests that timers across all levels of the wheel fire once time reaches their expiry and not before.
+    #[test]
+    fn test_timer_wheel_expiry() -> Result<()> {
+        let mut timer: SharedTimer = SharedTimer::default();
+        let start: Instant = Instant::now();
+        timer.set_time(start);
+
+        // Expiries from sub-millisecond to several days out, with plenty of them sharing ticks.
+        let mut timers: Vec<(Instant, Arc<TestWaker>)> = Vec::new();
+        let mut offset: u64 = 1;
+        for i in 0..2000u64 {
+            offset = offset
+                .wrapping_mul(6364136223846793005)
+                .wrapping_add(1442695040888963407)
+                % (1 << (10 + i % 30));
+            let expiry: Instant = start + Duration::from_micros(offset + 1);
+            let waker: Arc<TestWaker> = Arc::new(TestWaker::default());
+            timer.add_timeout(expiry, Waker::from(waker.clone()));
+            timers.push((expiry, waker));
+        }
+
+        // Move time forward in uneven steps, some shorter than a tick and some that skip many levels.
+        let mut now: Instant = start;
+        let mut step: Duration = Duration::from_micros(300);
+        while now < start + Duration::from_secs(1 << 20) {
+            now += step;
+            step = step * 3 / 2;
+            timer.advance_clock(now);
+            for (expiry, waker) in &timers {
+                crate::ensure_eq!(waker.was_woken(), *expiry <= now);
+            }
+        }
+        crate::ensure_eq!(timer.num_timers, 0);
+
+        Ok(())
+    }
+
+    // Tests that cancelled timers do not fire, and that cancelling a timer that has fired leaves the timer that took
+    // over its entry alone.
+    #[test]
+    fn test_timer_wheel_cancel() -> Result<()> {
+        let mut timer: SharedTimer = SharedTimer::default();
+        let start: Instant = Instant::now();
+        timer.set_time(start);
+
+        let cancelled: Arc<TestWaker> = Arc::new(TestWaker::default());
+        let id: YieldPointId = timer.add_timeout(start + Duration::from_secs(1), Waker::from(cancelled.clone()));
+        timer.remove_timeout(id);
+        crate::ensure_eq!(timer.num_timers, 0);
+
+        let fired: Arc<TestWaker> = Arc::new(TestWaker::default());
+        let fired_id: YieldPointId = timer.add_timeout(start + Duration::from_secs(1), Waker::from(fired.clone()));
+        timer.advance_clock(start + Duration::from_secs(2));
+        crate::ensure_eq!(cancelled.was_woken(), false);
+        crate::ensure_eq!(fired.was_woken(), true);
+
+        // The next timer reuses the entry of the one that fired.
+        let armed: Arc<TestWaker> = Arc::new(TestWaker::default());
+        let armed_id: YieldPointId = timer.add_timeout(start + Duration::from_secs(3), Waker::from(armed.clone()));
+        crate::ensure_eq!(armed_id.index, fired_id.index);
+        timer.remove_timeout(fired_id);
+        timer.advance_clock(start + Duration::from_secs(3));
+        crate::ensure_eq!(armed.was_woken(), true);
+
+        Ok(())
+    }
+
+    // Tests that the next deadline never comes after the expiry of the next timer, and comes within a tick of it.
+    #[test]
+    fn test_timer_wheel_next_deadline() -> Result<()> {
+        let mut timer: SharedTimer = SharedTimer::default();
+        let start: Instant = Instant::now();
+        timer.set_time(start);
+        crate::ensure_eq!(timer.next_deadline(), None);
+
+        let mut expiries: Vec<Instant> = Vec::new();
+        for offset in [5_000_000u64, 250_300, 70_000_000, 1_700] {
+            let expiry: Instant = start + Duration::from_micros(offset);
+            timer.add_timeout(expiry, Waker::from(Arc::new(TestWaker::default())));
+            expiries.push(expiry);
+        }
+        expiries.sort();
+
+        let mut now: Instant = start;
+        for expiry in expiries {
+            let deadline: Option<Instant> = timer.next_deadline();
+            crate::ensure_eq!(deadline.is_some_and(|deadline| deadline <= expiry), true);
+            // Once time gets close to the timer, it sits in a slot of the lowest level.
+            now = now.max(expiry - Duration::from_micros(500));
+            timer.advance_clock(now);
+            let deadline: Option<Instant> = timer.next_deadline();
+            crate::ensure_eq!(
+                deadline.is_some_and(|deadline| deadline <= expiry && expiry - deadline < Duration::from_millis(1)),
+                true
+            );
+            now = expiry;
+            timer.advance_clock(now);
+        }
+        crate::ensure_eq!(timer.next_deadline(), None);
+
+        Ok(())
+    }
 }
@@ -6,14 +6,15 @@
 //======================================================================================================================
 
 /// Maximum Length for Scatter-Gather Arrays
-pub const DEMI_SGARRAY_MAXLEN: usize = 1;
+pub const DEMI_SGARRAY_MAXLEN: usize = 16;
 
 //======================================================================================================================
 // Structures
 //======================================================================================================================
 
 /// Scatter-Gather Array Segment
-#[repr(C, packed)]
+#[cfg_attr(not(feature = "abi-aligned"), repr(C, packed))]
+#[cfg_attr(feature = "abi-aligned", repr(C))]
 #[derive(Copy, Clone)]
 pub struct demi_sgaseg_t {
     /// Underlying data.
@@ -23,7 +24,8 @@ pub struct demi_sgaseg_t {
 }
 
 /// Scatter-Gather Array
-#[repr(C, packed)]
+#[cfg_attr(not(feature = "abi-aligned"), repr(C, packed))]
+#[cfg_attr(feature = "abi-aligned", repr(C))]
 #[derive(Copy, Clone)]
 pub struct demi_sgarray_t {
     /// Reserved.
@@ -46,6 +48,12 @@ mod test {
     use crate::runtime::types::memory::*;
     use std::mem;
 
+    // Padding after a u32 that is followed by a pointer.
+    #[cfg(not(feature = "abi-aligned"))]
+    const PAD_SIZE: usize = 0;
+    #[cfg(feature = "abi-aligned")]
+    const PAD_SIZE: usize = 4;
+
     /// Tests if the `demi_sgaseg_t` structure has the expected size.
     #[test]
     fn test_size_demi_sgaseg_t() -> Result<(), anyhow::Error> {
@@ -54,7 +62,10 @@ mod test {
         // Size of a u32.
         const SGASEG_LEN_SIZE: usize = 4;
         // Size of a demi_sgaseg_t structure.
-        crate::ensure_eq!(mem::size_of::<demi_sgaseg_t>(), SGASEG_BUF_SIZE + SGASEG_LEN_SIZE);
+        crate::ensure_eq!(
+            mem::size_of::<demi_sgaseg_t>(),
+            SGASEG_BUF_SIZE + SGASEG_LEN_SIZE + PAD_SIZE
+        );
         Ok(())
     }
 
@@ -72,7 +83,7 @@ mod test {
         // Size of a demi_sgarray_t structure.
         crate::ensure_eq!(
             mem::size_of::<demi_sgarray_t>(),
-            SGA_BUF_SIZE + SGA_NUMSEGS_SIZE + SGA_SEGS_SIZE + SGA_ADDR_SIZE
+            SGA_BUF_SIZE + SGA_NUMSEGS_SIZE + PAD_SIZE + SGA_SEGS_SIZE + SGA_ADDR_SIZE
         );
         Ok(())
     }
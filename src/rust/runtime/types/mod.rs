@@ -6,6 +6,7 @@
 mod memory;
 mod ops;
 mod queue;
+mod stats;
 
 //======================================================================================================================
 // Exports
@@ -13,8 +14,12 @@ mod queue;
 
 pub use self::{
     memory::{demi_sgarray_t, demi_sgaseg_t, DEMI_SGARRAY_MAXLEN},
-    ops::{demi_accept_result_t, demi_opcode_t, demi_qr_value_t, demi_qresult_t},
+    ops::{
+        demi_accept_result_t, demi_cqring_t, demi_opcode_t, demi_qr_value_t, demi_qresult_t, write_qresult,
+        DEMI_QRESULT_T_SIZE,
+    },
     queue::demi_qtoken_t,
+    stats::{demi_stats_t, DEMI_STATS_POLL_BUCKETS},
 };
 
 //======================================================================================================================
@@ -25,7 +30,8 @@ pub use self::{
 pub type demi_callback_t = extern "C" fn(*const std::ffi::c_char, u32, u64);
 
 /// Demikernel Arguments
-#[repr(C, packed)]
+#[cfg_attr(not(feature = "abi-aligned"), repr(C, packed))]
+#[cfg_attr(feature = "abi-aligned", repr(C))]
 pub struct demi_args_t {
     pub argc: core::ffi::c_int,
     pub argv: *const *const core::ffi::c_char,
@@ -60,7 +66,11 @@ mod test {
         const DEMIARGS_CALLBACK_SIZE: usize = 8;
 
         // The expected size of the `DemiArgs` structure.
+        #[cfg(not(feature = "abi-aligned"))]
         const DEMIARGS_SIZE: usize = DEMIARGS_ARGC_SIZE + DEMIARGS_ARGV_SIZE + DEMIARGS_CALLBACK_SIZE;
+        // In the aligned layout, the pointers and the structure itself are 8-byte aligned.
+        #[cfg(feature = "abi-aligned")]
+        const DEMIARGS_SIZE: usize = (8 + DEMIARGS_ARGV_SIZE + DEMIARGS_CALLBACK_SIZE).next_multiple_of(8);
 
         // Check if the sizes match.
         assert_eq!(std::mem::size_of::<crate::runtime::types::demi_args_t>(), DEMIARGS_SIZE);
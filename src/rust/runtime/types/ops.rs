@@ -6,6 +6,7 @@
 //======================================================================================================================
 
 use crate::runtime::types::{memory::demi_sgarray_t, queue::demi_qtoken_t};
+use ::std::{mem, ptr};
 
 //======================================================================================================================
 // Structures
@@ -24,7 +25,8 @@ pub enum demi_opcode_t {
     DEMI_OPC_FAILED,
 }
 
-#[repr(C, packed)]
+#[cfg_attr(not(feature = "abi-aligned"), repr(C, packed))]
+#[cfg_attr(feature = "abi-aligned", repr(C))]
 #[derive(Copy, Clone)]
 pub struct demi_accept_result_t {
     pub qd: i32,
@@ -38,7 +40,11 @@ pub union demi_qr_value_t {
 }
 
 /// Result
-#[repr(C)]
+///
+/// The C structure is packed, but this one keeps natural alignment so that its fields can be borrowed. It therefore
+/// has trailing padding, and must be written to C memory with [write_qresult].
+#[cfg_attr(not(feature = "abi-aligned"), repr(C))]
+#[cfg_attr(feature = "abi-aligned", repr(C, align(64)))]
 pub struct demi_qresult_t {
     pub qr_opcode: demi_opcode_t,
     pub qr_qd: u32,
@@ -47,6 +53,54 @@ pub struct demi_qresult_t {
     pub qr_value: demi_qr_value_t,
 }
 
+/// Size of a [demi_qresult_t] in the C ABI, which is also the distance between consecutive results in C arrays.
+#[cfg(not(feature = "abi-aligned"))]
+pub const DEMI_QRESULT_T_SIZE: usize = mem::offset_of!(demi_qresult_t, qr_value) + mem::size_of::<demi_qr_value_t>();
+#[cfg(feature = "abi-aligned")]
+pub const DEMI_QRESULT_T_SIZE: usize = mem::size_of::<demi_qresult_t>();
+
+// Results are copied out with [write_qresult], which reads `DEMI_QRESULT_T_SIZE` bytes of a Rust result and steps
+// through C arrays by the same amount. Getting this wrong corrupts the memory of the application, so we refuse to build
+// rather than wait for a unit test to catch it.
+const DEMI_QRESULT_T_FIELDS_SIZE: usize = mem::size_of::<demi_opcode_t>()
+    + mem::size_of::<u32>()
+    + mem::size_of::<demi_qtoken_t>()
+    + mem::size_of::<i64>()
+    + mem::size_of::<demi_qr_value_t>();
+#[cfg(not(feature = "abi-aligned"))]
+const _: () = assert!(DEMI_QRESULT_T_SIZE == DEMI_QRESULT_T_FIELDS_SIZE);
+#[cfg(feature = "abi-aligned")]
+const _: () = assert!(DEMI_QRESULT_T_SIZE == DEMI_QRESULT_T_FIELDS_SIZE.next_multiple_of(64));
+const _: () = assert!(DEMI_QRESULT_T_SIZE <= mem::size_of::<demi_qresult_t>());
+
+/// Completion Ring
+///
+/// The application owns the ring and its entries. Demikernel writes results at `cq_tail` and the application consumes
+/// them from `cq_head`. Both indexes wrap around, and `cq_size` must be a power of two.
+#[cfg_attr(not(feature = "abi-aligned"), repr(C, packed))]
+#[cfg_attr(feature = "abi-aligned", repr(C))]
+pub struct demi_cqring_t {
+    pub cq_head: u32,
+    pub cq_tail: u32,
+    pub cq_size: u32,
+    pub cq_entries: *mut demi_qresult_t,
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Writes `qr` to the entry at `index` in the C array of results that starts at `qr_out`.
+///
+/// # Safety
+///
+/// `qr_out` must point to a C array of results that has more than `index` entries.
+pub unsafe fn write_qresult(qr_out: *mut demi_qresult_t, index: usize, qr: demi_qresult_t) {
+    // Only copy the bytes that exist in the C structure, as results may be packed in C.
+    let dst: *mut u8 = (qr_out as *mut u8).add(index * DEMI_QRESULT_T_SIZE);
+    ptr::copy_nonoverlapping(&qr as *const demi_qresult_t as *const u8, dst, DEMI_QRESULT_T_SIZE);
+}
+
 //======================================================================================================================
 // Unit Tests
 //======================================================================================================================
@@ -81,7 +135,7 @@ mod test {
         Ok(())
     }
 
-    /// Tests if `demi_qresult_t` has the expected size.
+    /// Tests if `demi_qresult_t` has the expected size in the C ABI.
     #[test]
     fn test_size_demi_qresult_t() -> Result<(), anyhow::Error> {
         // Size of a demi_opcode_t enum.
@@ -94,10 +148,33 @@ mod test {
         const QR_RET_SIZE: usize = 8;
         // Size of a demi_qr_value_t structure.
         const QR_VALUE_SIZE: usize = mem::size_of::<demi_qr_value_t>();
-        // Size of a demi_qresult_t structure.
+        // Size of the fields of a demi_qresult_t structure.
+        const QR_SIZE: usize = QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE;
+        // Size of a demi_qresult_t structure, which is padded to a cache line in the aligned layout.
+        #[cfg(not(feature = "abi-aligned"))]
+        crate::ensure_eq!(DEMI_QRESULT_T_SIZE, QR_SIZE);
+        #[cfg(feature = "abi-aligned")]
+        crate::ensure_eq!(DEMI_QRESULT_T_SIZE, QR_SIZE.next_multiple_of(64));
+        crate::ensure_eq!(DEMI_QRESULT_T_SIZE <= mem::size_of::<demi_qresult_t>(), true);
+        Ok(())
+    }
+
+    /// Tests if `demi_cqring_t` has the expected size.
+    #[test]
+    fn test_size_demi_cqring_t() -> Result<(), anyhow::Error> {
+        // Size of a u32.
+        const CQ_INDEX_SIZE: usize = 4;
+        // Size of a pointer.
+        const CQ_ENTRIES_SIZE: usize = 8;
+        // Size of a demi_cqring_t structure.
+        // Padding after the indexes in the aligned layout.
+        #[cfg(not(feature = "abi-aligned"))]
+        const CQ_PAD_SIZE: usize = 0;
+        #[cfg(feature = "abi-aligned")]
+        const CQ_PAD_SIZE: usize = 4;
         crate::ensure_eq!(
-            mem::size_of::<demi_qresult_t>(),
-            QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE
+            mem::size_of::<demi_cqring_t>(),
+            3 * CQ_INDEX_SIZE + CQ_PAD_SIZE + CQ_ENTRIES_SIZE
         );
         Ok(())
     }
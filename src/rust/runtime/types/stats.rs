@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of buckets in the histogram of scheduler polls.
+pub const DEMI_STATS_POLL_BUCKETS: usize = 8;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Counters of a Demikernel thread
+///
+/// Unlike other public structures, this one is never packed: all fields are naturally aligned 64-bit counters, so that
+/// another thread may read each of them with a single load while Demikernel updates them.
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug, PartialEq, Eq)]
+pub struct demi_stats_t {
+    /// Number of packets received from the device.
+    pub rx_packets: u64,
+    /// Number of receive bursts, including empty ones.
+    pub rx_bursts: u64,
+    /// Number of receive bursts that came back empty.
+    pub rx_empty_bursts: u64,
+    /// Number of packets handed to the device.
+    pub tx_packets: u64,
+    /// Number of transmit bursts that the device accepted.
+    pub tx_bursts: u64,
+    /// Number of packets dropped because the transmit ring was full.
+    pub tx_drops: u64,
+    /// Number of buffers that could not be taken from a memory pool.
+    pub mempool_misses: u64,
+    /// Number of TCP segments that were sent again.
+    pub tcp_retransmits: u64,
+    /// Number of TCP retransmission timeouts.
+    pub tcp_rto_fires: u64,
+    /// Number of times that a wait went through a list of queue tokens.
+    pub wait_any_scans: u64,
+    /// Total number of queue tokens in the lists that these scans went through.
+    pub wait_any_scanned_qts: u64,
+    /// Number of timers that were armed.
+    pub timer_arms: u64,
+    /// Number of timers that were cancelled before they fired.
+    pub timer_cancels: u64,
+    /// Number of timers that fired.
+    pub timer_fires: u64,
+    /// Number of scheduler polls by number of tasks run. Bucket 0 counts polls that ran no task, and bucket `i` counts
+    /// polls that ran between `2^(i-1)` and `2^i - 1` tasks. The last bucket counts all larger polls.
+    pub poll_histogram: [u64; DEMI_STATS_POLL_BUCKETS],
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+
+    use crate::runtime::types::stats::*;
+    use ::std::mem;
+
+    /// Tests if `demi_stats_t` has the expected size and alignment.
+    #[test]
+    fn test_size_demi_stats_t() -> Result<(), anyhow::Error> {
+        // Number of scalar counters.
+        const NUM_COUNTERS: usize = 14;
+        // Size of a u64.
+        const COUNTER_SIZE: usize = 8;
+        crate::ensure_eq!(
+            mem::size_of::<demi_stats_t>(),
+            (NUM_COUNTERS + DEMI_STATS_POLL_BUCKETS) * COUNTER_SIZE
+        );
+        crate::ensure_eq!(mem::align_of::<demi_stats_t>(), COUNTER_SIZE);
+        Ok(())
+    }
+}
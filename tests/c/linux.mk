@@ -28,7 +28,7 @@ export COMPILE_CMD = $(CC) $(CFLAGS) $@.o -o $(BINDIR)/$@.$(EXEC_SUFFIX) $(LIBS)
 #=======================================================================================================================
 
 # Builds everything.
-all: sizes syscalls
+all: sizes sizes-aligned syscalls
 
 make-dirs:
 	mkdir -p $(BINDIR)
@@ -37,6 +37,10 @@ make-dirs:
 sizes: make-dirs sizes.o
 	$(COMPILE_CMD)
 
+# Builds 'sizes' test for the aligned layout of public structures.
+sizes-aligned: make-dirs
+	$(CC) $(CFLAGS) -DDEMI_ABI_ALIGNED sizes.c -o $(BINDIR)/$@.$(EXEC_SUFFIX) $(LIBS)
+
 # Builds system call test.
 syscalls: make-dirs syscalls.o
 	$(COMPILE_CMD)
@@ -45,6 +49,7 @@ syscalls: make-dirs syscalls.o
 clean:
 	@rm -rf $(OBJ)
 	@rm -rf $(BINDIR)/sizes.$(EXEC_SUFFIX)
+	@rm -rf $(BINDIR)/sizes-aligned.$(EXEC_SUFFIX)
 	@rm -rf $(BINDIR)/syscalls.$(EXEC_SUFFIX)
 
 # Builds a C source file.
@@ -8,6 +8,7 @@
  *====================================================================================================================*/
 
 #include <demi/types.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -25,6 +26,16 @@
  */
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
+/**
+ * @brief Rounds a size up to a multiple of an alignment.
+ *
+ * @param a Size.
+ * @param b Alignment.
+ *
+ * @returns The smallest multiple of 'b' that is not smaller than 'a'.
+ */
+#define ROUND_UP(a, b) ((((a) + (b)-1) / (b)) * (b))
+
 /**
  * @brief Asserts if 'a' and 'b' agree on size.
  *
@@ -45,14 +56,23 @@
  *====================================================================================================================*/
 
 // The following sizes are intentionally hardcoded.
+#ifdef DEMI_ABI_ALIGNED
+// In the aligned layout, structures are padded so that each field is naturally aligned.
+#define PTR_ALIGN 8
+#define QR_ALIGN DEMI_CACHE_LINE_SIZE
+#else
+#define PTR_ALIGN 1
+#define QR_ALIGN 1
+#endif
 #define SGASEG_BUF_SIZE 8
 #define SGASEG_LEN_SIZE 4
-#define DEMI_SGASEG_T_SIZE (SGASEG_BUF_SIZE + SGASEG_LEN_SIZE)
+#define DEMI_SGASEG_T_SIZE ROUND_UP(SGASEG_BUF_SIZE + SGASEG_LEN_SIZE, PTR_ALIGN)
 #define SGA_BUF_SIZE 8
 #define SGA_NUMSEGS_SIZE 4
-#define SGA_SEGS_SIZE (DEMI_SGASEG_T_SIZE * DEMI_SGARRAY_MAXSIZE)
+#define SGA_NUMSEGS_MAX 16
+#define SGA_SEGS_SIZE (DEMI_SGASEG_T_SIZE * SGA_NUMSEGS_MAX)
 #define SGA_ADDR_SIZE 16
-#define DEMI_SGARRAY_T_SIZE (SGA_BUF_SIZE + SGA_NUMSEGS_SIZE + SGA_SEGS_SIZE + SGA_ADDR_SIZE)
+#define DEMI_SGARRAY_T_SIZE (ROUND_UP(SGA_BUF_SIZE + SGA_NUMSEGS_SIZE, PTR_ALIGN) + SGA_SEGS_SIZE + SGA_ADDR_SIZE)
 #define QD_SIZE 4
 #define SADDR_SIZE 16
 #define DEMI_ACCEPT_RESULT_T_SIZE (QD_SIZE + SADDR_SIZE)
@@ -61,11 +81,18 @@
 #define QR_QT_SIZE 8
 #define QR_RET_SIZE 8
 #define QR_VALUE_SIZE (MAX(DEMI_ACCEPT_RESULT_T_SIZE, DEMI_SGARRAY_T_SIZE))
-#define DEMI_QRESULT_T_SIZE (QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE)
+#define DEMI_QRESULT_T_SIZE                                                                                            \
+    ROUND_UP(QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE, QR_ALIGN)
+#define CQ_HEAD_SIZE 4
+#define CQ_TAIL_SIZE 4
+#define CQ_SIZE_SIZE 4
+#define CQ_ENTRIES_SIZE 8
+#define DEMI_CQRING_T_SIZE (ROUND_UP(CQ_HEAD_SIZE + CQ_TAIL_SIZE + CQ_SIZE_SIZE, PTR_ALIGN) + CQ_ENTRIES_SIZE)
 #define DEMI_ARGS_ARGC_SIZE 4
 #define DEMI_ARGS_ARGV_SIZE 8
 #define DEMI_ARGS_CALLBACK_SIZE 8
-#define DEMI_ARGS_SIZE (DEMI_ARGS_ARGC_SIZE + DEMI_ARGS_ARGV_SIZE + DEMI_ARGS_CALLBACK_SIZE)
+#define DEMI_ARGS_SIZE                                                                                                 \
+    ROUND_UP(ROUND_UP(DEMI_ARGS_ARGC_SIZE, PTR_ALIGN) + DEMI_ARGS_ARGV_SIZE + DEMI_ARGS_CALLBACK_SIZE, PTR_ALIGN)
 
 /*====================================================================================================================*
  * Private Functions                                                                                                  *
@@ -115,6 +142,34 @@ static void test_size_demi_qresult_t(void)
     printf("sizeof(demi_qresult_t) = %zu\n", sizeof(demi_qresult_t));
 }
 
+/**
+ * @brief Tests if the leading fields of demi_qresult_t fit in the first cache line of a result.
+ *
+ * @note This is a compile-time-test.
+ */
+static void test_layout_demi_qresult_t(void)
+{
+    // Place a result after a single byte to find out its alignment.
+    struct probe
+    {
+        char c;
+        demi_qresult_t qr;
+    };
+
+    KASSERT_SIZE(offsetof(struct probe, qr), QR_ALIGN);
+    KASSERT_SIZE(offsetof(demi_qresult_t, qr_value) <= DEMI_CACHE_LINE_SIZE, 1);
+    printf("alignof(demi_qresult_t) = %zu\n", offsetof(struct probe, qr));
+}
+
+/**
+ * @brief Tests if demi_cqring_t has the expected size.
+ */
+static void test_size_demi_cqring_t(void)
+{
+    KASSERT_SIZE(sizeof(demi_cqring_t), DEMI_CQRING_T_SIZE);
+    printf("sizeof(demi_cqring_t) = %zu\n", sizeof(demi_cqring_t));
+}
+
 /**
  * @brief Tests if demi_args_t has the expected size.
  */
@@ -148,6 +203,8 @@ int main(int argc, char *const argv[])
     test_size_sga_t();
     test_size_demi_accept_result_t();
     test_size_demi_qresult_t();
+    test_layout_demi_qresult_t();
+    test_size_demi_cqring_t();
     test_size_demi_args_t();
 
     return (EXIT_SUCCESS);
@@ -4,6 +4,8 @@
  */
 
 #include <assert.h>
+#include <demi/channel.h>
+#include <demi/stats.h>
 #include <demi/libos.h>
 #include <demi/sga.h>
 #include <demi/wait.h>
@@ -19,6 +21,21 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnonnull"
 
+/**
+ * @brief Issues an invalid call to demi_init_on_queue().
+ */
+static bool inval_init_on_queue(void)
+{
+    const struct demi_args args = {
+        .argc = 0,
+        .argv = NULL,
+        .callback = NULL,
+    };
+
+    /* Demikernel is already initialized on this thread. */
+    return (demi_init_on_queue(&args, 0) != 0);
+}
+
 /**
  * @brief Issues an invalid call to demi_socket().
  */
@@ -66,6 +83,19 @@ static bool inval_accept(void)
     return (demi_accept(qt, sockqd) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_accept_batch().
+ */
+static bool inval_accept_batch(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int sockqd = -1;
+    int num = -1;
+    int *num_out = NULL;
+
+    return (demi_accept_batch(qts, sockqd, num, num_out) != 0);
+}
+
 /**
  * @brief Issues an invalid call to demi_connect().
  */
@@ -101,6 +131,20 @@ static bool inval_push(void)
     return (demi_push(qt, qd, sga) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_push_file().
+ */
+static bool inval_push_file(void)
+{
+    demi_qtoken_t *qt = NULL;
+    int qd = -1;
+    int fd = -1;
+    uint64_t offset = 0;
+    size_t len = 0;
+
+    return (demi_push_file(qt, qd, fd, offset, len) != 0);
+}
+
 /**
  * @brief Issues an invalid call to demi_pushto().
  */
@@ -126,6 +170,33 @@ static bool inval_pop(void)
     return (demi_pop(qt, qd) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_push_batch().
+ */
+static bool inval_push_batch(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    demi_sgarray_t *sgas = NULL;
+    int num = -1;
+    int *num_out = NULL;
+
+    return (demi_push_batch(qts, qds, sgas, num, num_out) != 0);
+}
+
+/**
+ * @brief Issues an invalid call to demi_pop_batch().
+ */
+static bool inval_pop_batch(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    int num = -1;
+    int *num_out = NULL;
+
+    return (demi_pop_batch(qts, qds, num, num_out) != 0);
+}
+
 /**
  * @brief Issues an invalid call to demi_setsockopt().
  */
@@ -189,6 +260,27 @@ static bool inval_sgafree(void)
     return (demi_sgafree(sga) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_mem_register().
+ */
+static bool inval_mem_register(void)
+{
+    void *addr = NULL;
+    size_t len = 0;
+
+    return (demi_mem_register(addr, len) != 0);
+}
+
+/**
+ * @brief Issues an invalid call to demi_mem_unregister().
+ */
+static bool inval_mem_unregister(void)
+{
+    void *addr = NULL;
+
+    return (demi_mem_unregister(addr) != 0);
+}
+
 /*===================================================================================================================*
  * System Calls in demi/wait.h                                                                                       *
  *===================================================================================================================*/
@@ -219,6 +311,117 @@ static bool inval_wait_any(void)
     return (demi_wait_any(qr, ready_offset, qts, num_qts, timeout) != 0);
 }
 
+/**
+ * @brief Issues an invalid system call to demi_wait_ring().
+ */
+static bool inval_wait_ring(void)
+{
+    demi_cqring_t *cq = NULL;
+    struct timespec *timeout = NULL;
+
+    return (demi_wait_ring(cq, timeout) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_qtset_add().
+ */
+static bool inval_qtset_add(void)
+{
+    int set = -1;
+    demi_qtoken_t qt = -1;
+
+    return (demi_qtset_add(set, qt) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_wait_set().
+ */
+static bool inval_wait_set(void)
+{
+    demi_qresult_t *qr = NULL;
+    int set = -1;
+    struct timespec *timeout = NULL;
+
+    return (demi_wait_set(qr, set, timeout) != 0);
+}
+
+/*===================================================================================================================*
+ * System Calls in demi/channel.h                                                                                    *
+ *===================================================================================================================*/
+
+/**
+ * @brief Issues an invalid system call to demi_channel_create().
+ */
+static bool inval_channel_create(void)
+{
+    demi_channel_t **ch = NULL;
+    uint32_t num_entries = 0;
+
+    return (demi_channel_create(ch, num_entries) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_channel_push().
+ */
+static bool inval_channel_push(void)
+{
+    demi_channel_t *ch = NULL;
+    int qd = -1;
+    demi_sgarray_t *sga = NULL;
+    uint64_t tag = 0;
+
+    return (demi_channel_push(ch, qd, sga, tag) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_channel_pop().
+ */
+static bool inval_channel_pop(void)
+{
+    demi_channel_t *ch = NULL;
+    int qd = -1;
+    uint64_t tag = 0;
+
+    return (demi_channel_pop(ch, qd, tag) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_channel_reap().
+ */
+static bool inval_channel_reap(void)
+{
+    demi_channel_t *ch = NULL;
+    demi_qresult_t *qr = NULL;
+    int num_qrs = 0;
+    int *num_qrs_out = NULL;
+
+    return (demi_channel_reap(ch, qr, num_qrs, num_qrs_out) != 0);
+}
+
+/*===================================================================================================================*
+ * System Calls in demi/stats.h                                                                                      *
+ *===================================================================================================================*/
+
+/**
+ * @brief Issues an invalid system call to demi_get_stats().
+ */
+static bool inval_get_stats(void)
+{
+    demi_stats_t *stats = NULL;
+
+    return (demi_get_stats(stats) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_stats_map().
+ */
+static bool inval_stats_map(void)
+{
+    const demi_stats_t **stats = NULL;
+
+    return (demi_stats_map(stats) != 0);
+}
+
 #pragma GCC diagnostic pop
 
 /*===================================================================================================================*
@@ -237,23 +440,46 @@ struct test
 /**
  * @brief Tests for system calls in demi/libos.h
  */
-static struct test tests_libos[] = {{inval_socket, "invalid demi_socket()"},   {inval_accept, "invalid demi_accept()"},
+static struct test tests_libos[] = {{inval_init_on_queue, "invalid demi_init_on_queue()"},
+                                    {inval_socket, "invalid demi_socket()"},   {inval_accept, "invalid demi_accept()"},
                                     {inval_bind, "invalid demi_bind()"},       {inval_close, "invalid_demi_close()"},
                                     {inval_connect, "invalid demi_connect()"}, {inval_listen, "invalid demi_listen()"},
                                     {inval_pop, "invalid demi_pop()"},         {inval_push, "invalid demi_push()"},
                                     {inval_pushto, "invalid demi_pushto()"},   {inval_getpeername, "invalid demi_getpeername()"},
-                                    {inval_setsockopt, "invalid demi_setsockopt()"}, {inval_getsockopt, "invalid demi_getsockopt()}"}};
+                                    {inval_setsockopt, "invalid demi_setsockopt()"}, {inval_getsockopt, "invalid demi_getsockopt()}"},
+                                    {inval_push_batch, "invalid demi_push_batch()"}, {inval_pop_batch, "invalid demi_pop_batch()"},
+                                    {inval_push_file, "invalid demi_push_file()"}, {inval_accept_batch, "invalid demi_accept_batch()"}};
 
 /**
  * @brief Tests for system calls in demi/sga.h
  */
 static struct test tests_sga[] = {{inval_sgaalloc, "invalid demi_sgaalloc()"},
-                                  {inval_sgafree, "invalid demi_sgafree()"}};
+                                  {inval_sgafree, "invalid demi_sgafree()"},
+                                  {inval_mem_register, "invalid demi_mem_register()"},
+                                  {inval_mem_unregister, "invalid demi_mem_unregister()"}};
 
 /**
  * @brief Tests for system calls in demi/wait.h
  */
-static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"}, {inval_wait_any, "invalid demi_wait_any()"}};
+static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"},
+                                   {inval_wait_any, "invalid demi_wait_any()"},
+                                   {inval_wait_ring, "invalid demi_wait_ring()"},
+                                   {inval_qtset_add, "invalid demi_qtset_add()"},
+                                   {inval_wait_set, "invalid demi_wait_set()"}};
+
+/**
+ * @brief Tests for system calls in demi/channel.h
+ */
+static struct test tests_channel[] = {{inval_channel_create, "invalid demi_channel_create()"},
+                                      {inval_channel_push, "invalid demi_channel_push()"},
+                                      {inval_channel_pop, "invalid demi_channel_pop()"},
+                                      {inval_channel_reap, "invalid demi_channel_reap()"}};
+
+/**
+ * @brief Tests for system calls in demi/stats.h
+ */
+static struct test tests_stats[] = {{inval_get_stats, "invalid demi_get_stats()"},
+                                    {inval_stats_map, "invalid demi_stats_map()"}};
 
 /**
  * @brief Drives the application.
@@ -317,5 +543,29 @@ int main(int argc, char *const argv[])
         }
     }
 
+    /* System calls in demi/channel.h */
+    for (size_t i = 0; i < sizeof(tests_channel) / sizeof(struct test); i++)
+    {
+        if (tests_channel[i].fn() == true)
+            fprintf(stderr, "test result: passed %s\n", tests_channel[i].name);
+        else
+        {
+            fprintf(stderr, "test result: FAILED %s\n", tests_channel[i].name);
+            return (EXIT_FAILURE);
+        }
+    }
+
+    /* System calls in demi/stats.h */
+    for (size_t i = 0; i < sizeof(tests_stats) / sizeof(struct test); i++)
+    {
+        if (tests_stats[i].fn() == true)
+            fprintf(stderr, "test result: passed %s\n", tests_stats[i].name);
+        else
+        {
+            fprintf(stderr, "test result: FAILED %s\n", tests_stats[i].name);
+            return (EXIT_FAILURE);
+        }
+    }
+
     return (EXIT_SUCCESS);
 }
@@ -3,16 +3,20 @@
 
 CC = cl
 
-all: sizes syscalls
+all: sizes sizes-aligned syscalls
 
 sizes: make-dirs sizes.obj
 	$(CC) sizes.obj $(LIBS) /Fe: $(BINDIR)\sizes.exe
 
+sizes-aligned: make-dirs
+	$(CC) /I $(INCDIR) /D DEMI_ABI_ALIGNED tests\c\sizes.c $(LIBS) /Fo: sizes-aligned.obj /Fe: $(BINDIR)\sizes-aligned.exe
+
 syscalls: make-dirs syscalls.obj
 	$(CC) syscalls.obj $(LIBS) /Fe: $(BINDIR)\syscalls.exe
 
 clean:
 	IF EXIST sizes.obj del /Q sizes.obj
+	IF EXIST sizes-aligned.obj del /Q sizes-aligned.obj
 	IF EXIST syscalls.obj del /Q syscalls.obj
 	IF EXIST $(BINDIR)\syscalls.exe del /S /Q $(BINDIR)\syscalls.exe
 
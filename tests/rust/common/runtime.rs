@@ -7,21 +7,16 @@
 
 use ::arrayvec::ArrayVec;
 use ::demikernel::{
-    demi_sgarray_t, demi_sgaseg_t,
+    demi_sgarray_t,
     inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
-        memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        memory::{alloc_buffer_chain, buffer_into_sgarray, DemiBuffer, MemoryRuntime},
+        network::consts::MAX_RECEIVE_BATCH_SIZE,
         SharedObject,
     },
 };
-use ::libc::c_void;
-use ::log::error;
-use ::std::{
-    mem,
-    ops::{Deref, DerefMut},
-};
+use ::std::ops::{Deref, DerefMut};
 
 //======================================================================================================================
 // Structures
@@ -64,6 +59,8 @@ impl SharedDummyRuntime {
 /// Network Runtime Trait Implementation for Dummy Runtime
 impl PhysicalLayer for SharedDummyRuntime {
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        // Receivers parse contiguous frames, so gather packets that carry their payload in a separate segment.
+        let pkt: DemiBuffer = if pkt.num_segments() > 1 { pkt.linearize(0)? } else { pkt };
         // The packet header and body must fit into whatever physical media we're transmitting over.
         // For this test harness, we 2^16 bytes (u16::MAX) as our limit.
         assert!(pkt.len() < u16::MAX as usize);
@@ -77,50 +74,34 @@ impl PhysicalLayer for SharedDummyRuntime {
         }
     }
 
-    fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
-        let mut out = ArrayVec::new();
-        if let Some(buf) = self.incoming.try_recv().ok() {
-            out.push(buf);
+    fn receive(
+        &mut self,
+        batch: &mut ArrayVec<DemiBuffer, MAX_RECEIVE_BATCH_SIZE>,
+        burst_size: usize,
+    ) -> Result<(), Fail> {
+        let burst_size: usize = burst_size.min(batch.remaining_capacity());
+        for _ in 0..burst_size {
+            match self.incoming.try_recv() {
+                Ok(buf) => batch.push(buf),
+                Err(_) => break,
+            }
         }
-        Ok(out)
+        Ok(())
     }
 }
 
 impl MemoryRuntime for SharedDummyRuntime {
     /// Allocates a scatter-gather array.
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate a zero-sized buffer.
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
         // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        let buf: DemiBuffer = alloc_buffer_chain(
+            size,
+            u16::MAX - MAX_HEADER_SIZE as u16,
+            |segment_size: u16| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(segment_size, MAX_HEADER_SIZE as u16))
+            },
+        )?;
+        buffer_into_sgarray(buf)
     }
 }
 
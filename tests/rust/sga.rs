@@ -18,6 +18,9 @@ const SGA_SIZE_SMALL: usize = 64;
 /// Size for big scatter-gather arrays.
 const SGA_SIZE_BIG: usize = 1280;
 
+/// Size for scatter-gather arrays that do not fit into a single segment.
+const SGA_SIZE_MULTI_SEGMENT: usize = 256 * 1024;
+
 //======================================================================================================================
 // test_unit_sga_alloc_free_single()
 //======================================================================================================================
@@ -55,6 +58,12 @@ fn test_unit_sga_alloc_free_single_big() -> Result<()> {
     do_test_unit_sga_alloc_free_single(SGA_SIZE_BIG)
 }
 
+/// Tests a single allocation and deallocation of a multi-segment scatter-gather array.
+#[test]
+fn test_unit_sga_alloc_free_single_multi_segment() -> Result<()> {
+    do_test_unit_sga_alloc_free_single(SGA_SIZE_MULTI_SEGMENT)
+}
+
 //======================================================================================================================
 // test_unit_sga_alloc_free_loop_tight()
 //======================================================================================================================
@@ -2,22 +2,37 @@
 # Licensed under the MIT license.
 
 import argparse
+import json
 from os import mkdir
 from shutil import move, rmtree
-from os.path import isdir
+from os.path import isdir, isfile
 import yaml
-from ci.job.linux import CheckoutJobOnLinux, CleanupJobOnLinux, CompileJobOnLinux, TcpEchoTest
+from ci.job.linux import CheckoutJobOnLinux, CleanupJobOnLinux, CompileJobOnLinux, TcpEchoTest, \
+    MicrobenchmarkJobOnLinux, SimulatorBenchmarkJobOnLinux, TcpPingPongBenchmark, UdpPingPongBenchmark
 from ci.job.utils import set_commit_hash, set_libos
 import ci.git as git
 
 # =====================================================================================================================
 
+# Metrics that benchmarks report and that we track for regressions, along with their units. Lower is better for all of
+# them. Cycle counts of the simulator benchmarks are left out, as they vary too much between runs to gate on.
+TRACKED_METRICS: dict[str, str] = {
+    "p50": " ns",
+    "p99": " ns",
+    "p99.9": " ns",
+    "packets_per_op": "",
+    "allocs_per_op": "",
+    "timer_ops_per_op": "",
+    "retransmits_per_op": "",
+    "instructions_per_packet": "",
+}
+
 
 # Runs the CI pipeline.
 def run_pipeline(
         repository: str, branch: str, libos: str, is_debug: bool, server: str, client: str,
         server_addr: str, client_addr: str, delay: float, config_path: str,
-        output_dir: str, enable_nfs: bool) -> int:
+        output_dir: str, enable_nfs: bool, baseline_path: str, threshold: float, update_baseline: bool) -> int:
     is_sudo: bool = True if libos == "catnip" or libos == "catpowder" else False
     status: dict[str, bool] = {}
 
@@ -67,14 +82,96 @@ def run_pipeline(
         if 'tcp_echo' in ci_map[libos]:
             for scenario in ci_map[libos]['tcp_echo']:
                 status["tcp_echo"] = TcpEchoTest(
-                    config, scenario['run_mode'], scenario['nclients'], scenario['bufsize'], scenario['nrequests']).execute()
-
-    # Setp 5: Clean up.
+                    config, scenario['run_mode'], scenario['nclients'], scenario['bufsize'], scenario['nrequests'],
+                    scenario.get('nthreads', 1)).execute()
+
+        results: dict = {}
+
+        # STEP 5: Run C benchmarks and track their latency distributions.
+        if 'c_benchmarks' in ci_map[libos]:
+            data_size: int = ci_map[libos]['c_benchmarks']['data_size']
+            niterations: int = ci_map[libos]['c_benchmarks']['niterations']
+
+            # The microbenchmarks send datagrams to themselves, which only LibOSes that loop them back can run.
+            if ci_map[libos]['c_benchmarks'].get('micro', True):
+                status["benchmark_c_micro"] = MicrobenchmarkJobOnLinux(config).execute()
+                results.update(collect_results(f"{log_directory}/benchmark-c-micro-server-{server}.stdout.txt"))
+            status["benchmark_c_tcp_ping_pong"] = TcpPingPongBenchmark(config, data_size, niterations).execute()
+            results.update(collect_results(f"{log_directory}/benchmark-c-tcp-ping-pong-client-{client}.stdout.txt"))
+            status["benchmark_c_udp_ping_pong"] = UdpPingPongBenchmark(config, data_size, niterations).execute()
+            results.update(collect_results(f"{log_directory}/benchmark-c-udp-ping-pong-client-{client}.stdout.txt"))
+
+        # STEP 6: Replay the workloads of the network simulator and track the datapath costs that they report.
+        if 'simulator_benchmarks' in ci_map[libos]:
+            test_filter: str = ci_map[libos]['simulator_benchmarks']['filter']
+            status["benchmark_sim"] = SimulatorBenchmarkJobOnLinux(config, test_filter).execute()
+            results.update(collect_results(f"{log_directory}/benchmark-sim-server-{server}.stdout.txt"))
+
+        if 'c_benchmarks' in ci_map[libos] or 'simulator_benchmarks' in ci_map[libos]:
+            status["benchmark_regressions"] = report_results(
+                libos, results, log_directory, baseline_path, threshold, update_baseline)
+
+    # Setp 7: Clean up.
     status["cleanup"] = CleanupJobOnLinux(config).execute()
 
     return status
 
 
+# Collects the results that benchmarks report as JSON lines in a log file.
+def collect_results(log_file: str) -> dict:
+    results: dict = {}
+    if not isfile(log_file):
+        return results
+    with open(log_file) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("{\"benchmark\""):
+                entry: dict = json.loads(line)
+                results[entry["benchmark"]] = entry
+    return results
+
+
+# Compares results against those of a baseline and returns the regressions that exceed a threshold.
+def find_regressions(results: dict, baseline: dict, threshold: float) -> list[str]:
+    regressions: list[str] = []
+    for name, entry in results.items():
+        if name not in baseline:
+            continue
+        for key, unit in TRACKED_METRICS.items():
+            # Metrics may be missing, such as hardware counts on hosts that do not expose them.
+            old = baseline[name].get(key)
+            new = entry.get(key)
+            if old is None or new is None:
+                continue
+            if old > 0 and new > old * (1.0 + threshold / 100.0):
+                regressions.append("{} {}: {}{} -> {}{} ({:+.1f}%)".format(
+                    name, key, old, unit, new, unit, 100.0 * (new - old) / old))
+    return regressions
+
+
+# Stores the results of benchmarks, compares them against a per-LibOS baseline and optionally updates it.
+def report_results(libos: str, results: dict, log_directory: str, baseline_path: str, threshold: float,
+                   update_baseline: bool) -> bool:
+    with open(log_directory + "/benchmark-results.json", "w") as f:
+        json.dump({"libos": libos, "results": results}, f, indent=2)
+
+    baselines: dict = {}
+    if baseline_path is not None and isfile(baseline_path):
+        with open(baseline_path) as f:
+            baselines = json.load(f)
+
+    regressions: list[str] = find_regressions(results, baselines.get(libos, {}), threshold)
+    for regression in regressions:
+        print("[REGRESSION] {} {}".format(libos, regression))
+
+    if update_baseline and baseline_path is not None:
+        baselines[libos] = results
+        with open(baseline_path, "w") as f:
+            json.dump(baselines, f, indent=2)
+
+    return len(regressions) == 0
+
+
 def read_yaml():
     path = "tools/ci/config/benchmark.yaml"
     yaml_str = ""
@@ -120,6 +217,14 @@ def read_args() -> argparse.Namespace:
     parser.add_argument("--config-path", required=False,
                         default="\$HOME/config.yaml", help="sets config path")
 
+    # Regression tracking options.
+    parser.add_argument("--baseline", required=False, default=None,
+                        help="set JSON file with the per-libos baseline for benchmarks")
+    parser.add_argument("--threshold", default=10.0, type=float, required=False,
+                        help="set tolerated regression of benchmark metrics, in percent")
+    parser.add_argument("--update-baseline", required=False, default=False,
+                        action="store_true", help="store the results of benchmarks in the baseline")
+
     # Other options.
     parser.add_argument("--output-dir", required=False,
                         default=".", help="output directory for logs")
@@ -150,6 +255,11 @@ def main():
     server_addr: str = args.server_addr
     client_addr: str = args.client_addr
 
+    # Extract regression tracking options.
+    baseline_path: str = args.baseline
+    threshold: float = args.threshold
+    update_baseline: bool = args.update_baseline
+
     # Output directory.
     output_dir: str = args.output_dir
 
@@ -160,7 +270,7 @@ def main():
 
     run_pipeline(repository, branch, libos, is_debug, server,
                  client, server_addr,
-                 client_addr, delay, config_path, output_dir, enable_nfs)
+                 client_addr, delay, config_path, output_dir, enable_nfs, baseline_path, threshold, update_baseline)
 
 
 if __name__ == "__main__":
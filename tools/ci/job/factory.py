@@ -47,6 +47,8 @@ class JobFactory:
         else:
             if test_name == "test-unit-rust":
                 return linux.UnitTestRustJobOnLinux(self.config)
+            elif test_name == "test-unit-rust-backend":
+                return linux.UnitTestRustBackendJobOnLinux(self.config)
             elif test_name == "test-unit-c":
                 return linux.UnitTestCJobOnLinux(self.config)
             else:
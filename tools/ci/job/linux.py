@@ -85,6 +85,14 @@ class UnitTestRustJobOnLinux(UnitTestJobOnLinux):
         return super().execute()
 
 
+class UnitTestRustBackendJobOnLinux(UnitTestJobOnLinux):
+    def __init__(self, config: dict):
+        super().__init__(config, "test-unit-rust-backend")
+
+    def execute(self) -> bool:
+        return super().execute()
+
+
 class UnitTestCJobOnLinux(UnitTestJobOnLinux):
     def __init__(self, config: dict):
         super().__init__(config, "test-unit-c")
@@ -197,6 +205,61 @@ class UdpPushPopTest(SystemTestJobOnLinux):
         super().__init__(config)
 
 
+class MicrobenchmarkJobOnLinux(BaseLinuxJob):
+    def __init__(self, config: dict):
+        super().__init__(config, "benchmark-c-micro")
+
+    def execute(self) -> bool:
+        args: str = f"--micro {super().server_addr()} 12345"
+        server_cmd: str = f"run-benchmarks-c LIBOS={super().libos()} ARGS=\\\"{args}\\\""
+        serverTask: RunOnLinux = RunOnLinux(
+            super().server(), super().repository(), server_cmd, super().is_debug(), super().is_sudo(), super().config_path())
+        return super().execute(serverTask)
+
+
+class SimulatorBenchmarkJobOnLinux(BaseLinuxJob):
+    def __init__(self, config: dict, test_filter: str):
+        super().__init__(config, "benchmark-sim")
+        self.test_filter = test_filter
+
+    def execute(self) -> bool:
+        server_cmd: str = f"run-benchmarks-sim LIBOS={super().libos()} TEST_UNIT={self.test_filter}"
+        serverTask: RunOnLinux = RunOnLinux(
+            super().server(), super().repository(), server_cmd, super().is_debug(), super().is_sudo(), super().config_path())
+        return super().execute(serverTask)
+
+
+class PingPongBenchmarkJobOnLinux(EndToEndTestJobOnLinux):
+    def __init__(self, config: dict):
+        self.server_args = config["server_args"]
+        self.client_args = config["client_args"]
+        self.test_name = config["test_name"]
+        super().__init__(config, f"benchmark-c-{config['test_name']}")
+
+    def execute(self) -> bool:
+        server_cmd: str = f"test-system-c LIBOS={super().libos()} TEST={self.test_name} ARGS=\\\"{self.server_args}\\\""
+        client_cmd: str = f"run-benchmarks-c LIBOS={super().libos()} ARGS=\\\"{self.client_args}\\\""
+        return super().execute(server_cmd, client_cmd)
+
+
+class TcpPingPongBenchmark(PingPongBenchmarkJobOnLinux):
+    def __init__(self, config: dict, data_size: int, niterations: int):
+        config["test_name"] = "tcp-ping-pong"
+        config["all_pass"] = True
+        config["server_args"] = f"--server {config['server_addr']} 12345 {data_size} {niterations}"
+        config["client_args"] = f"--tcp-ping-pong {config['server_addr']} 12345 {data_size} {niterations}"
+        super().__init__(config)
+
+
+class UdpPingPongBenchmark(PingPongBenchmarkJobOnLinux):
+    def __init__(self, config: dict, data_size: int, niterations: int):
+        config["test_name"] = "udp-ping-pong"
+        config["all_pass"] = False
+        config["server_args"] = f"--server {config['server_addr']} 12345 {config['client_addr']} 23456 {data_size} {niterations}"
+        config["client_args"] = f"--udp-ping-pong {config['client_addr']} 23456 {config['server_addr']} 12345 {data_size} {niterations}"
+        super().__init__(config)
+
+
 class IntegrationTestJobOnLinux(BaseLinuxJob):
     def __init__(self, config: dict, test_name: str):
         config["all_pass"] = True
@@ -68,6 +68,9 @@ def run_pipeline(
             status["unit_tests"] = True
             status["unit_tests"] &= factory.unit_test(test_name="test-unit-rust").execute()
             status["unit_tests"] &= factory.unit_test(test_name="test-unit-c").execute()
+            # Optional Linux backends are not part of the default build, so build and test them on their own.
+            if config["platform"] == "linux" and libos in ["catnap", "catpowder"]:
+                status["unit_tests"] &= factory.unit_test(test_name="test-unit-rust-backend").execute()
 
     # STEP 4: Run integration tests.
     if test_integration:
@@ -257,6 +257,7 @@ test-unit-c-sizes: all-tests-c
 	set RUST_LOG=$(RUST_LOG)
 	set RUSTFLAGS=$(RUSTFLAGS)
 	$(BINDIR)\sizes.exe
+	$(BINDIR)\sizes-aligned.exe
 
 test-unit-c-syscalls: all-tests-c
 	set RUST_LOG=$(RUST_LOG)